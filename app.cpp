@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <array>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <memory>
@@ -104,7 +105,7 @@ bool run_app(std::vector<std::string> const& vargs)
     shell.initialize_upscaled_processing_extension(example_postprocess.get());
 #endif
 
-#ifdef ENABLE_OIDN
+#if defined(ENABLE_OIDN) || defined(ENABLE_DL_DENOISING)
     std::unique_ptr<RenderExtension> denoise_postprocess = renderer->create_processing_step(RenderProcessingStep::DLDenoising);
     shell.initialize_upscaled_processing_extension(denoise_postprocess.get());
 #endif
@@ -148,19 +149,19 @@ bool run_app(std::vector<std::string> const& vargs)
     }
 
     SceneDescription scene_desc;
-    {
+    auto load_scene = [&](std::vector<std::string> const& scene_files) {
         ProfilingScope profile_scene("Initialize Scene");
 
         SceneLoaderParams scene_loader_params;
-        imstate_scene_loader_parameters(scene_loader_params, config_args.scene_files);
+        imstate_scene_loader_parameters(scene_loader_params, scene_files);
         if (config_args.deduplicate_scene)
             scene_loader_params.use_deduplication = true;
 
         ProfilingScope profile_read("Read Scene");
-        Scene scene(config_args.scene_files, scene_loader_params);
+        Scene scene(scene_files, scene_loader_params);
         profile_read.end();
 
-        scene_desc = SceneDescription(config_args.scene_files, scene);
+        scene_desc = SceneDescription(scene_files, scene);
         println(CLL::VERBOSE, "%s\n", scene_desc.info.c_str());
 
         {
@@ -172,7 +173,8 @@ bool run_app(std::vector<std::string> const& vargs)
 
             apply_selected_camera(config_args, scene);
         }
-    }
+    };
+    load_scene(config_args.scene_files);
 
     profile_init.end();
     log_profiling_times();
@@ -231,7 +233,11 @@ bool run_app(std::vector<std::string> const& vargs)
     unsigned last_initialization_generation = 0;
 
     double motion_time = 0.0;
+    double camera_path_time = -1.0;
     bool show_ui = !config_args.disable_ui && app_state.interactive();
+    // validation and profiling runs need every frame rendered with the requested configuration
+    renderer->allow_fallback_pipelines = app_state.interactive();
+    bool adapting_frame_time = false;
     uint64_t output_image_index = 0;
     std::string output_image_basename = "rptr_";
     {
@@ -240,6 +246,64 @@ bool run_app(std::vector<std::string> const& vargs)
         output_image_basename += std::to_string(ms_since_epoch);
     }
     auto last_working_renderer_options = renderer->options;
+
+    // server mode: jobs start from the initial settings and only reload changed scenes
+    std::string server_base_settings = config_args.server_socket + ".base.ini";
+    std::string server_job_settings = config_args.server_socket + ".job.ini";
+    std::vector<std::string> server_scene_files = config_args.scene_files;
+    std::vector<unsigned long long> server_scene_timestamps;
+    if (app_state.server_mode) {
+        ImState::SettingsWriter writer;
+        writer.to_file = server_base_settings.c_str();
+        while (writer.next())
+            settings_serialization();
+        for (auto& file : server_scene_files)
+            server_scene_timestamps.push_back(get_last_modified(file.c_str()));
+    }
+    auto start_server_job = [&](RenderServer::QueuedJob const& queued) {
+        RenderJob const& job = queued.job;
+        if (!job.scene_files.empty()) {
+            std::vector<std::string> scene_files = job.scene_files;
+            std::vector<unsigned long long> timestamps;
+            for (auto& file : scene_files) {
+                canonicalize_path(file);
+                if (!file_exists(file))
+                    throw_error("Cannot find scene file %s", file.c_str());
+                timestamps.push_back(get_last_modified(file.c_str()));
+            }
+            if (scene_files != server_scene_files || timestamps != server_scene_timestamps) {
+                println(CLL::INFORMATION, "Render job %llu: loading new scene", (unsigned long long) job.id);
+                load_scene(scene_files);
+                server_scene_files = scene_files;
+                server_scene_timestamps = timestamps;
+                // scene cameras apply unless overridden by the job
+                camera = OrientedCamera(config_args.up, config_args.eye, glm::quat_cast( glm::lookAt(config_args.eye, config_args.center, config_args.up) ));
+            }
+        }
+
+        // job settings apply on top of the initial settings, never those of earlier jobs
+        ImState::AppendFrame(0.0);
+        ImState::LoadSettings(server_base_settings.c_str());
+        if (!job.config.empty()) {
+            std::ofstream file(server_job_settings, std::ios::binary | std::ios::trunc);
+            file << job.config;
+            file.close();
+            if (!file)
+                throw_error("Cannot write job settings to %s", server_job_settings.c_str());
+            ImState::LoadSettings(server_job_settings.c_str());
+        }
+        for (ImState::SettingsHandler it; it.next(); )
+            settings_serialization();
+
+        if (job.has_camera) {
+            camera.set_position(glm::make_vec3(job.eye));
+            camera.set_direction(glm::make_vec3(job.dir), glm::make_vec3(job.up));
+            config_args.fov_y = job.fov_y;
+        }
+        camera_changed = true;
+        app_state.begin_server_job(queued);
+    };
+
     while (!app_state.done) {
         bool new_frame = app_state.request_new_frame();
         bool new_shot = false;
@@ -249,6 +313,10 @@ bool run_app(std::vector<std::string> const& vargs)
                 new_shot = ImState::NewSettingsSource(current_settings_source);
             }
         }
+        if (app_state.skips_frame()) {
+            app_state.skip_frame();
+            continue;
+        }
 
         Shell::Event event;
         while (shell.poll_event(&event))
@@ -258,6 +326,18 @@ bool run_app(std::vector<std::string> const& vargs)
 
         camera_changed |= default_camera_movement(camera, shell, io, config_args);
 
+        // camera paths follow the (fixed-step in non-interactive modes) timeline
+        if (!shell.camera_path.empty() && app_state.current_time != camera_path_time
+         && !(app_state.freeze_frame && camera_path_time >= 0.0)) {
+            CameraPathKey pose = shell.camera_path.evaluate(app_state.current_time);
+            camera.set_position(pose.position);
+            camera.set_direction(pose.dir(), pose.up());
+            if (pose.fov_y > 0.0f)
+                config_args.fov_y = pose.fov_y;
+            camera_path_time = app_state.current_time;
+            camera_changed = true;
+        }
+
         bool save_image = false;
         if (show_ui) {
             scene_state_xi();
@@ -309,6 +389,19 @@ bool run_app(std::vector<std::string> const& vargs)
 #endif
         }
 
+        // samples and resolution follow the target frame time, starting from the current settings
+        {
+            auto& controller = app_state.frame_time_controller;
+            bool adapt = app_state.interactive() && controller.enabled();
+            if (adapt && !adapting_frame_time)
+                controller.reset({ renderer->params.batch_spp, renderer->options.render_upscale_factor });
+            adapting_frame_time = adapt;
+            if (adapt && renderer->options.render_upscale_factor != controller.current.upscale_factor) {
+                renderer->options.render_upscale_factor = controller.current.upscale_factor;
+                app_state.renderer_changed = true;
+            }
+        }
+
         bool reset_render =
             app_state.renderer_changed
          || new_shot
@@ -349,10 +442,12 @@ bool run_app(std::vector<std::string> const& vargs)
         RenderStats stats;
         if (app_state.needs_render()) {
             int backup_batch_spp = renderer->params.batch_spp;
+            if (adapting_frame_time)
+                renderer->params.batch_spp = app_state.frame_time_controller.current.batch_spp;
 #ifdef ENABLE_REALTIME_RESOLVE
             if (renderer->params.reprojection_mode == 0)
 #endif
-                renderer->params.batch_spp = app_state.next_frame_spp(backup_batch_spp);
+                renderer->params.batch_spp = app_state.next_frame_spp(renderer->params.batch_spp);
 
             RenderCameraParams camera_config = { camera.eye(), camera.dir(), camera.up(), config_args.fov_y };
             RenderConfiguration config = { camera_config };
@@ -360,6 +455,9 @@ bool run_app(std::vector<std::string> const& vargs)
             config.reset_accumulation = app_state.accumulated_spp == 0;
             config.freeze_frame = app_state.freeze_frame;
             config.time = motion_time;
+            // offline frames do not depend on the samples of the frames rendered before them
+            if (app_state.data_capture_mode)
+                config.sample_sequence_offset = int64_t(offline_frame_sample_offset(app_state.fixed_step_index, app_state.target_spp));
 
             bool synchronous_rendering = app_state.synchronous_rendering;
 
@@ -372,7 +470,7 @@ bool run_app(std::vector<std::string> const& vargs)
 #ifdef ENABLE_OIDN2
             oidn2_postprocess->mute_flag = !app_state.enable_denoising;
 #endif
-#ifdef ENABLE_OIDN
+#if defined(ENABLE_OIDN) || defined(ENABLE_DL_DENOISING)
             denoise_postprocess->mute_flag = !app_state.enable_denoising;
 #ifdef ENABLE_OIDN2
             oidn2_postprocess->mute_flag |= renderer->options.render_upscale_factor != 1;
@@ -475,6 +573,10 @@ bool run_app(std::vector<std::string> const& vargs)
 
             if (stats.has_valid_frame_stats)
                 stats.render_time += extension_timer.elapsedMS();
+            // frames truncated to reach the target spp do not represent the chosen sample count
+            if (adapting_frame_time && stats.has_valid_frame_stats
+             && renderer->params.batch_spp == app_state.frame_time_controller.current.batch_spp)
+                app_state.frame_time_controller.update(stats.render_time);
 
             bool moving_average = false;
 #ifdef ENABLE_REALTIME_RESOLVE
@@ -488,7 +590,7 @@ bool run_app(std::vector<std::string> const& vargs)
             if (!oidn2_postprocess->mute_flag)
                 oidn2_postprocess->process(render_stream);
 #endif
-#ifdef ENABLE_OIDN
+#if defined(ENABLE_OIDN) || defined(ENABLE_DL_DENOISING)
             if (!denoise_postprocess->mute_flag)
                 denoise_postprocess->process(render_stream);
 #endif
@@ -500,7 +602,7 @@ bool run_app(std::vector<std::string> const& vargs)
             example_postprocess->process(render_stream);
 #endif
 
-#ifndef ENABLE_OIDN
+#if !defined(ENABLE_OIDN) && !defined(ENABLE_DL_DENOISING)
             // todo: fix DoF + denoising
             depthOfFieldExtension->process(render_stream);
 #endif
@@ -570,6 +672,22 @@ bool run_app(std::vector<std::string> const& vargs)
 
         app_state.handle_mode_actions(shell, renderer.get());
 
+        if (app_state.server_mode) {
+            // wait for jobs while idle
+            app_state.server->poll(app_state.server_job_active ? 0 : 100);
+            RenderServer::QueuedJob queued;
+            if (!app_state.server_job_active && app_state.server->next_job(&queued)) {
+                try {
+                    start_server_job(queued);
+                } catch (std::exception const& e) {
+                    RenderJobResult result;
+                    result.id = queued.job.id;
+                    result.error = e.what();
+                    app_state.server->send_result(queued.connection, result);
+                }
+            }
+        }
+
         // to limit frame rate: shell.pad_frame_time(1000 / 15);
         if (app_state.pause_rendering)
             shell.pad_frame_time(1000 / 11);
@@ -9,9 +9,14 @@ namespace command_line {
 
 static char const* const s_usage =
     "usage: %s <scene_file> [<scene_file>...] [options]\n"
+    "Scene files are .vks/.vkrs scenes, an equirectangular .hdr or .exr file replaces\n"
+    "sky and sun as environment map.\n"
     "Options:\n"
     "\t--img <x> <y>                Specify the window dimensions. Defaults to 1920x1080.\n"
     "\t--upscale <n>                Specify the render upscale factor. Defaults to 1.\n"
+    "\t--target-frame-time <ms>     Adapt the samples per frame and the render upscale factor\n"
+    "\t                             between frames to the given GPU frame time. Upscaling is\n"
+    "\t                             limited to the factor given by --upscale, if any, else 2.\n"
     "\t--eye <x> <y> <z>            Set the camera position\n"
     "\t--center <x> <y> <z>         Set the camera focus point\n"
     "\t--up <x> <y> <z>             Set the camera up vector\n"
@@ -19,6 +24,8 @@ static char const* const s_usage =
     "\t--camera <n>                 If the scene contains multiple cameras, specify which\n"
     "\t                             should be used. Defaults to the first camera\n"
     "\t                             and overrides any config files.\n"
+    "\t--camera-path <file>         Play back the given camera path on the animation timeline,\n"
+    "\t                             overriding the camera of scene and config files.\n"
     "\t--config <file>              Load the given .ini file as an additional config file.\n"
     "\t--keyframe [<length>:]<file> Append the given .ini file as an additional keyframe, hold \n"
     "\t                             for <length> s (default 1 s) if given config is static.\n"
@@ -66,6 +73,8 @@ static char const* const s_usage =
     "\t                             Defaults to 60. Ignored unless in profiling mode.\n"
     "\t--profiling-img <prefix>     Also store the framebuffer after each keyframe in\n"
     "\t                             prefix_<keyframe>.pfm. Ignored unless in profiling mode.\n"
+    "\t--profiling-img-every-frame  Store the framebuffer after every frame in prefix_<frame>.pfm\n"
+    "\t                             instead, e.g. for image sequences of camera paths.\n"
     "\n"
     "Example for running 3 frames of a given config in profiling mode:\n"
     "\t./rptr path/to/scene.vks --profiling example_prefix --profiling-fps 3 --config path/to/example_config.ini\n"
@@ -73,6 +82,12 @@ static char const* const s_usage =
     "Example for running 7 frames for each of 3 given configs:\n"
     "\t./rptr path/to/scene.vks --profiling example_prefix --profiling-fps 7 --keyframe example_config1.ini --keyframe example_config2.ini --keyframe example_config3.ini\n"
     "\n"
+    "Example for rendering every frame of a camera path at 30 fps:\n"
+    "\t./rptr path/to/scene.vks --profiling example_prefix --profiling-fps 30 --camera-path path/to/flythrough.campath --profiling-img frame --profiling-img-every-frame\n"
+    "\n"
+    "Camera paths run to their last key in profiling and data capture mode, with times\n"
+    "advancing in exact multiples of the frame time.\n"
+    "\n"
     "Data capture mode:\n"
     "\n"
     "By default, data capture mode runs for one logical second (on the animation timeline).\n"
@@ -96,11 +111,24 @@ static char const* const s_usage =
     "\t--data-capture-albedo-roughness   Store the albedo (RGB) and roughness (A) aovs.\n"
     "\t--data-capture-normal-depth       Store the normal (RGB) and depth (A) aovs.\n"
     "\t--data-capture-motion             Store the motion vector (RGB) aovs\n"
+    "\t--distributed <n>                 Render the frames in n local worker processes and\n"
+    "\t                                  merge their outputs in frame order. Crashed workers\n"
+    "\t                                  are relaunched at their first missing frame. Staged\n"
+    "\t                                  in <prefix>.staging.\n"
+    "\t                                  Motion vectors cannot be captured this way.\n"
     "\n"
     "\t By default, the rgba buffer and all aovs are stored.\n"
     "\t The order of the arguments on the command line matters. This way, you can render\n"
     "\t individual aovs using, for example,\n"
     "\t    --data-capture-no-aovs --data-capture-albedo-roughness\n"
+    "\n"
+    "Server mode:\n"
+    "\t--server <socket>            Keep the backend and the scene resident and render jobs\n"
+    "\t                             received on the given Unix domain socket, returning the\n"
+    "\t                             requested AOVs as EXR images. Jobs are rendered in the\n"
+    "\t                             order received, scenes are only reloaded if their files\n"
+    "\t                             change. Submit jobs using the render_client tool.\n"
+    "\t                             Cannot be used with any of the other modes.\n"
     "\n";
 
 struct ApiDescriptor {
@@ -310,6 +338,11 @@ ProgramArgs parse(Shell::DefaultArgs* optional_shell_args, std::vector<std::stri
       else
         args.have_upscale_factor = true;
     }
+    else if (vargs[i] == "--target-frame-time") {
+      consume(vargs, i, shell.target_frame_time_ms);
+      if (shell.target_frame_time_ms < 0.0f)
+        shell.target_frame_time_ms = 0.0f;
+    }
     else if (vargs[i] == "--config") {
       std::string config;
       consume(vargs, i, config);
@@ -350,6 +383,10 @@ ProgramArgs parse(Shell::DefaultArgs* optional_shell_args, std::vector<std::stri
     else if (vargs[i] == "--camera") {
       consume(vargs, i, shell.camera_id);
     }
+    else if (vargs[i] == "--camera-path") {
+      consume(vargs, i, shell.camera_path_file);
+      canonicalize_path(shell.camera_path_file);
+    }
     else if (vargs[i] == "--vulkan-device") {
       consume(vargs, i, args.device_override);
     }
@@ -403,6 +440,11 @@ ProgramArgs parse(Shell::DefaultArgs* optional_shell_args, std::vector<std::stri
         have_profiling_options = true;
         consume(vargs, i, shell.profiling_img_prefix);
     }
+    else if (vargs[i] == "--profiling-img-every-frame")
+    {
+        have_profiling_options = true;
+        shell.profiling_img_every_frame = true;
+    }
     else if (vargs[i] == "--benchmark-file")
     {
       println(CLL::CRITICAL, "--benchmark-file <name>.csv is now --profiling <name>");
@@ -447,6 +489,29 @@ ProgramArgs parse(Shell::DefaultArgs* optional_shell_args, std::vector<std::stri
     {
         shell.data_capture.motion = true;
     }
+    else if (vargs[i] == "--distributed")
+    {
+        consume(vargs, i, shell.distributed_workers);
+        if (shell.distributed_workers < 1)
+            shell.distributed_workers = 1;
+    }
+    else if (vargs[i] == "--distributed-worker")
+    {
+        // internal, appended by the coordinator of distributed rendering
+        size_t first_frame = 0;
+        consume(vargs, i, shell.distributed_worker.slot, shell.distributed_worker.worker_count, first_frame);
+        consume(vargs, i, shell.distributed_worker.staging_dir);
+        shell.distributed_worker.first_frame = first_frame;
+    }
+    else if (vargs[i] == "--server")
+    {
+        consume(vargs, i, shell.server_socket);
+        shell.server_mode = true;
+#ifdef _WIN32
+        println(CLL::CRITICAL, "server mode is not supported on Windows");
+        throw -1;
+#endif
+    }
     else if (vargs[i] == "--exr")
     {
         shell.image_format = OUTPUT_IMAGE_FORMAT_EXR;
@@ -478,13 +543,27 @@ ProgramArgs parse(Shell::DefaultArgs* optional_shell_args, std::vector<std::stri
 
   if (int(shell.validation_mode) 
    +  int(shell.profiling_mode)
-   +  int(shell.data_capture_mode)  > 1)
+   +  int(shell.data_capture_mode)
+   +  int(shell.server_mode)  > 1)
 
   {
-      println(CLL::CRITICAL, "validation mode, profiling mode and data capture mode are "
+      println(CLL::CRITICAL, "validation mode, profiling mode, data capture mode and server mode are "
               "mutually exclusive");
       throw -1;
   }
+  if ((shell.distributed_workers > 0 || shell.distributed_worker.active()) && !shell.data_capture_mode)
+  {
+      println(CLL::CRITICAL, "distributed rendering requires data capture mode, "
+              "enable it using --data-capture <prefix>");
+      throw -1;
+  }
+  if ((shell.distributed_workers > 0 || shell.distributed_worker.active()) && shell.data_capture.motion)
+  {
+      // workers skip the frames of other workers, motion would refer to their own last frame
+      println(CLL::CRITICAL, "distributed rendering cannot capture motion vectors, "
+              "select the aovs using --data-capture-no-aovs followed by the others");
+      throw -1;
+  }
   if (have_profiling_options && !shell.profiling_mode)
   {
       println(CLL::CRITICAL, "got profiling automation options without "
@@ -2,6 +2,7 @@
 # SPDX-License-Identifier: MIT
 
 import bpy
+import math
 import mathutils
 
 def write_camera_matrix(stream, m):
@@ -20,6 +21,29 @@ def write_camera_matrix(stream, m):
     stream.write(f"up= {-u[0]} {u[2]} {u[1]}\n")
     stream.write("..\n")
 
+def write_camera_path_keys(context, filepath, frame_range, key_step, camera):
+    s = bpy.context.scene
+    seconds_per_frame = s.render.fps_base / s.render.fps
+    old_frame = s.frame_current
+    with open(filepath, 'w', encoding='utf-8') as f:
+        f.write("# key <time> <position> <direction> <up> [<fov_y>]\n")
+        frames = list(range(frame_range[0], frame_range[1]+1, max(key_step, 1)))
+        if frames[-1] != frame_range[1]:
+            frames.append(frame_range[1])
+        for frame in frames:
+            s.frame_set(frame)
+            m = camera.matrix_world
+            p = m @ mathutils.Vector((0, 0, 0))
+            u = m.to_quaternion() @ mathutils.Vector((0, 1, 0))
+            d = m.to_quaternion() @ mathutils.Vector((0, 0, -1))
+            t = (frame - frame_range[0]) * seconds_per_frame
+            # Same rotation into the Vulkan coordinate frame as write_camera_matrix.
+            f.write(f"key {t} {-p[0]} {p[2]} {p[1]} {-d[0]} {d[2]} {d[1]} {-u[0]} {u[2]} {u[1]} {math.degrees(camera.data.angle_y)}\n")
+
+    s.frame_set(old_frame)
+
+    return {'FINISHED'}
+
 def write_camera_path(context, filepath, frame_range, intent, camera):
     s = bpy.context.scene
     time_delta = ""
@@ -42,7 +66,7 @@ def write_camera_path(context, filepath, frame_range, intent, camera):
 # ExportHelper is a helper class, defines filename and
 # invoke() function which calls the file selector.
 from bpy_extras.io_utils import ExportHelper
-from bpy.props import StringProperty, BoolProperty, EnumProperty, IntVectorProperty
+from bpy.props import StringProperty, BoolProperty, EnumProperty, IntProperty, IntVectorProperty
 from bpy.types import Operator
 
 
@@ -70,12 +94,20 @@ class ExportCameraPath(Operator, ExportHelper):
         items=(
             ('REAL_TIME', "Real-time", "The camera path will be exported with timestamps. This is most suitable for real-time rendering."),
             ('PROFILING', "Profiling", "The camera path will be exported without timestamps. This is most suitable for FPS-locked profiling."),
+            ('CAMERA_PATH', "Camera path", "The camera path will be exported as spline keys in one .campath file, played back with --camera-path."),
         ),
         name="Intent",
         description="Indicate whether the path is intended for real-time rendering or (fps-locked) profiling.",
         default="REAL_TIME"
     )
 
+    key_step: IntProperty(
+        name="Key Step",
+        description="Export every n-th frame as a spline key (camera path intent only)",
+        default=1,
+        min=1
+    )
+
     def invoke(self, context, _event):
         self.frame_range = (bpy.context.scene.frame_start, bpy.context.scene.frame_end)
         self.cameras = [ c for c in bpy.context.selected_objects if c.type == 'CAMERA' ]
@@ -88,6 +120,10 @@ class ExportCameraPath(Operator, ExportHelper):
 
     def execute(self, context):
         cam = self.cameras[0]
+        if self.intent == "CAMERA_PATH":
+            filepath = bpy.path.ensure_ext(self.filepath[:-len(self.filename_ext)] if self.filepath.endswith(self.filename_ext) else self.filepath, ".campath")
+            return write_camera_path_keys(context, filepath, self.frame_range,
+                self.key_step, cam)
         return write_camera_path(context, self.filepath, self.frame_range,
             self.intent, self.cameras[0])
 
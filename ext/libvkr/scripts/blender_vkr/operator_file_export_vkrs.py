@@ -1597,8 +1597,9 @@ def write_scene_data(context, filepath, scene_data, format_version, store_index_
         f.seek(tuple_table_offset_fpos)
         f.write(struct.pack('q', fpos))
         f.seek(fpos)
-        # Write the tuple index table
-        tuple_indices.tofile(f)
+        # Write the table of bone index tuples (the per-vertex tuple indices
+        # are part of the blend attributes)
+        np.asarray(tuple_table, dtype=np.uint16).tofile(f)
 
     if format_version >= 4:
         fpos = f.tell()
@@ -26,6 +26,15 @@
 
 #include <meshoptimizer.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 #endif // VKR_BUILD_TOOLS
 
 #include <assert.h>
@@ -1126,6 +1135,12 @@ VkrResult vkr_load_scene(FILE *f, VkrScene *v, char const* filename,
     const uint64_t normalUvBufferSize = sizeof(uint64_t) * 3 * mesh->numTriangles;
     offset += normalUvBufferSize;
 
+    if (mesh->flags & VKR_MESH_FLAGS_BLEND_ATTRIBUTES) {
+      mesh->blendAttributeBufferOffset = offset;
+      const uint64_t blendAttributeBufferSize = sizeof(uint32_t) * 3 * mesh->numTriangles;
+      offset += blendAttributeBufferSize;
+    }
+
     mesh->materialIdBufferOffset = offset;
     mesh->materialIdSize = (mesh->numMaterialsInRange <= 0xFF + 1 || mesh->numSegments > 1)
       ? VKR_MATERIAL_ID_8_BITS
@@ -2134,5 +2149,1003 @@ VkrResult vkr_convert_texture(
   return result;
 }
 
+/*
+ * Scene writer. The header layout mirrors vkr_load_scene() for the latest
+ * file version, see also the Blender exporter.
+ */
+
+#define VKR_WRITE_VERSION VKR_MAX_VERSION
+#define VKR_WRITE_MAX_THREADS 64
+#define VKR_WRITE_MIN_ITEMS_PER_THREAD 4096
+#define VKR_WRITE_COPY_CHUNK_SIZE (4 << 20)
+#define VKR_WRITE_DATA_POSTFIX ".data"
+
+typedef void (*VkrParallelTask)(void *context, uint64_t begin, uint64_t end,
+    uint32_t threadIndex);
+
+typedef struct {
+  VkrParallelTask task;
+  void *context;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t threadIndex;
+} VkrParallelChunk;
+
+#if defined(_WIN32)
+static DWORD WINAPI vkr_parallel_thread(LPVOID param)
+#else
+static void *vkr_parallel_thread(void *param)
+#endif
+{
+  VkrParallelChunk *chunk = (VkrParallelChunk *) param;
+  chunk->task(chunk->context, chunk->begin, chunk->end, chunk->threadIndex);
+  return 0;
+}
+
+static uint32_t vkr_default_thread_count(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  long count = (long) info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (count < 1)
+    return 1;
+  return count < VKR_WRITE_MAX_THREADS ? (uint32_t) count : VKR_WRITE_MAX_THREADS;
+}
+
+/*
+ * Runs task on contiguous chunks of [0, count) on up to numThreads threads.
+ * The calling thread takes the first chunk, chunks of threads that could not
+ * be started are processed serially afterwards.
+ */
+static uint32_t vkr_parallel_for(uint64_t count, uint32_t numThreads,
+    VkrParallelTask task, void *context)
+{
+  uint64_t maxThreads = (count + VKR_WRITE_MIN_ITEMS_PER_THREAD - 1)
+    / VKR_WRITE_MIN_ITEMS_PER_THREAD;
+  if (numThreads > maxThreads)
+    numThreads = (uint32_t) maxThreads;
+  if (numThreads > VKR_WRITE_MAX_THREADS)
+    numThreads = VKR_WRITE_MAX_THREADS;
+  if (numThreads < 1)
+    numThreads = 1;
+
+  VkrParallelChunk chunks[VKR_WRITE_MAX_THREADS];
+#if defined(_WIN32)
+  HANDLE threads[VKR_WRITE_MAX_THREADS];
+#else
+  pthread_t threads[VKR_WRITE_MAX_THREADS];
+#endif
+  int started[VKR_WRITE_MAX_THREADS] = { 0 };
+
+  for (uint32_t i = 0; i < numThreads; ++i) {
+    chunks[i].task = task;
+    chunks[i].context = context;
+    chunks[i].begin = count * i / numThreads;
+    chunks[i].end = count * (i + 1) / numThreads;
+    chunks[i].threadIndex = i;
+  }
+  for (uint32_t i = 1; i < numThreads; ++i) {
+#if defined(_WIN32)
+    threads[i] = CreateThread(NULL, 0, vkr_parallel_thread, chunks + i, 0, NULL);
+    started[i] = threads[i] != NULL;
+#else
+    started[i] = pthread_create(threads + i, NULL, vkr_parallel_thread, chunks + i) == 0;
+#endif
+  }
+  vkr_parallel_thread(chunks);
+  for (uint32_t i = 1; i < numThreads; ++i) {
+    if (!started[i]) {
+      vkr_parallel_thread(chunks + i);
+      continue;
+    }
+#if defined(_WIN32)
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], NULL);
+#endif
+  }
+  return numThreads;
+}
+
+/*
+ * Quantization, inverse to vkr_dequantize_vertices() and
+ * vkr_dequantize_normal_uv(). The file stores x, y, z as -x, z, y.
+ */
+static inline void vkr_to_file_space(float *b, const float *v)
+{
+  b[0] = -v[0];
+  b[1] = v[2];
+  b[2] = v[1];
+}
+
+static inline uint64_t vkr_quantize_position(const float *p,
+    const float *base, const float *scaling)
+{
+  float b[3];
+  vkr_to_file_space(b, p);
+  uint64_t q = 0;
+  for (int i = 2; i >= 0; --i) {
+    float x = (b[i] - base[i]) * scaling[i];
+    // Also maps NaN to 0
+    uint64_t qi = x > 0.0f ? (uint64_t) (x < (float) 0x1FFFFF ? x : (float) 0x1FFFFF) : 0;
+    q = (q << 21u) | qi;
+  }
+  return q;
+}
+
+// Octahedral mapping, represents 0, -1 and 1 precisely by integers
+static inline uint32_t vkr_quantize_normal(const float *n)
+{
+  float b[3];
+  vkr_to_file_space(b, n);
+  float nl1 = fabsf(b[0]) + fabsf(b[1]) + fabsf(b[2]);
+  if (!(nl1 > 0.0f)) {
+    b[0] = b[1] = 0.0f;
+    b[2] = nl1 = 1.0f;
+  }
+  float px = b[0] / nl1;
+  float py = b[1] / nl1;
+  if (b[2] <= 0.0f) {
+    const float fx = copysignf(1.0f - fabsf(py), px);
+    const float fy = copysignf(1.0f - fabsf(px), py);
+    px = fx;
+    py = fy;
+  }
+  int32_t qx = (int32_t) floorf(px * (float) 0x7FFF + 0.5f);
+  int32_t qy = (int32_t) floorf(py * (float) 0x7FFF + 0.5f);
+  qx = qx < -0x7FFF ? -0x7FFF : qx > 0x7FFF ? 0x7FFF : qx;
+  qy = qy < -0x7FFF ? -0x7FFF : qy > 0x7FFF ? 0x7FFF : qy;
+  return (uint32_t) (qx + 0x8000) | (uint32_t) (qy + 0x8000) << 16u;
+}
+
+/*
+ * UVs of one triangle. Each triangle is shifted into the positive domain by
+ * integer offsets, which works since textures repeat (extents should be < 8).
+ */
+static inline void vkr_quantize_triangle_uvs(uint32_t *q,
+    const float *uv0, const float *uv1, const float *uv2)
+{
+  const float *uvs[3] = { uv0, uv1, uv2 };
+  float b[3][2];
+  for (int c = 0; c < 3; ++c) {
+    b[c][0] = uvs[c][0];
+    b[c][1] = 8.0f / (float) 0xFFFF - uvs[c][1];
+  }
+  for (int j = 0; j < 2; ++j) {
+    float origin = floorf(fminf(b[0][j], fminf(b[1][j], b[2][j])));
+    if (!isfinite(origin))
+      origin = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+      float x = (b[c][j] - origin) * ((float) 0xFFFF / 8.0f) + 0.5f;
+      uint32_t qj = x > 0.0f ? (uint32_t) (x < (float) 0x7FFFFFFF ? x : (float) 0x7FFFFFFF) : 0;
+      q[c] |= (qj & 0xFFFFu) << (16u * j);
+    }
+  }
+}
+
+typedef struct {
+  float vertexScale[3];
+  float vertexOffset[3];
+  uint32_t flags;
+  uint64_t numTriangles;
+  int32_t materialIdBufferBase;
+  uint32_t numMaterialsInRange;
+  uint64_t numSegments;
+  uint64_t *segmentNumTriangles;
+  int32_t *segmentMaterialBaseOffsets;
+  char *name;
+  uint64_t dataOffset; // In bytes, in the staged data.
+  int64_t vertexBufferOffsetPos; // In bytes, in the output file.
+} VkrWriterMesh;
+
+typedef struct {
+  char *name;
+  int64_t meshId;
+  uint64_t numInstances;
+  uint32_t firstTransform;
+} VkrWriterInstanceGroup;
+
+struct VkrSceneWriter {
+  char *filename;
+  char *dataFilename;
+  FILE *file;
+  FILE *dataFile;
+  uint64_t dataSize;
+  uint32_t flags;
+  uint32_t numThreads;
+  VkrErrorHandler eh;
+  VkrResult result; // The first error, further calls fail with it.
+
+  uint64_t numMaterials;
+  uint64_t materialCapacity;
+  char **materialNames;
+  uint64_t numReferencedMaterials; // 1 + the largest material ID in use.
+
+  uint64_t numMeshes;
+  uint64_t meshCapacity;
+  VkrWriterMesh *meshes;
+  uint64_t numTriangles;
+
+  uint64_t numGroups;
+  uint64_t groupCapacity;
+  VkrWriterInstanceGroup *groups;
+
+  uint64_t numTransforms;
+  uint64_t transformCapacity;
+  unsigned char *transforms; // VKR_QUANTIZED_TRANSFORM_SIZE bytes each.
+};
+
+static char *vkr_copy_string(const char *s)
+{
+  if (!s)
+    s = "";
+  const size_t len = strlen(s);
+  char *copy = (char *) malloc(len + 1);
+  if (copy)
+    memcpy(copy, s, len + 1);
+  return copy;
+}
+
+static int vkr_reserve_array(void **array, uint64_t *capacity,
+    uint64_t required, size_t elementSize)
+{
+  if (required <= *capacity)
+    return 1;
+  uint64_t newCapacity = *capacity ? 2 * *capacity : 16;
+  while (newCapacity < required)
+    newCapacity *= 2;
+  void *grown = realloc(*array, newCapacity * elementSize);
+  if (!grown)
+    return 0;
+  *array = grown;
+  *capacity = newCapacity;
+  return 1;
+}
+
+static VkrResult vkr_writer_fail(VkrSceneWriter *w, VkrResult result,
+    const char *fmt, const char *arg)
+{
+  if (w->result == VKR_SUCCESS)
+    w->result = result;
+  return reportError(w->eh, result, fmt, arg);
+}
+
+static void vkr_free_writer(VkrSceneWriter *w)
+{
+  if (w->file)
+    fclose(w->file);
+  if (w->dataFile)
+    fclose(w->dataFile);
+  if (w->dataFilename)
+    remove(w->dataFilename);
+  for (uint64_t i = 0; i < w->numMaterials; ++i)
+    free(w->materialNames[i]);
+  free(w->materialNames);
+  for (uint64_t i = 0; i < w->numMeshes; ++i) {
+    free(w->meshes[i].name);
+    free(w->meshes[i].segmentNumTriangles);
+    free(w->meshes[i].segmentMaterialBaseOffsets);
+  }
+  free(w->meshes);
+  for (uint64_t i = 0; i < w->numGroups; ++i)
+    free(w->groups[i].name);
+  free(w->groups);
+  free(w->transforms);
+  free(w->filename);
+  free(w->dataFilename);
+  free(w);
+}
+
+VkrResult vkr_begin_scene(const char *filename, uint32_t flags,
+    uint32_t numThreads, VkrSceneWriter **writer, VkrErrorHandler eh)
+{
+  if (!filename || !writer) {
+    return reportError(eh, VKR_INVALID_ARGUMENT,
+        "Invalid argument to vkr_begin_scene.");
+  }
+  *writer = NULL;
+
+  VkrSceneWriter *w = (VkrSceneWriter *) calloc(1, sizeof(VkrSceneWriter));
+  if (!w) {
+    return reportError(eh, VKR_ALLOCATION_ERROR,
+        "Failed to allocate scene writer.");
+  }
+  w->flags = flags;
+  w->numThreads = numThreads ? numThreads : vkr_default_thread_count();
+  w->eh = eh;
+  w->filename = vkr_copy_string(filename);
+  w->dataFilename = (char *) strcat4(filename, VKR_WRITE_DATA_POSTFIX, "", "");
+  if (!w->filename || !w->dataFilename) {
+    vkr_free_writer(w);
+    return reportError(eh, VKR_ALLOCATION_ERROR,
+        "Failed to allocate scene writer.");
+  }
+
+  w->file = fopen(filename, "wb");
+  if (!w->file) {
+    vkr_free_writer(w);
+    return reportError(eh, VKR_INVALID_FILE_NAME,
+        "Cannot open %s for writing.", filename);
+  }
+  w->dataFile = fopen(w->dataFilename, "w+b");
+  if (!w->dataFile) {
+    VkrResult r = reportError(eh, VKR_INVALID_FILE_NAME,
+        "Cannot open %s for writing.", w->dataFilename);
+    vkr_discard_scene(w);
+    return r;
+  }
+
+  *writer = w;
+  return VKR_SUCCESS;
+}
+
+VkrResult vkr_write_material(VkrSceneWriter *w, const char *name)
+{
+  if (!w || !name) {
+    return reportError(w ? w->eh : NULL, VKR_INVALID_ARGUMENT,
+        "Invalid argument to vkr_write_material.");
+  }
+  if (w->result != VKR_SUCCESS)
+    return w->result;
+
+  char *copy = vkr_copy_string(name);
+  if (!copy || !vkr_reserve_array((void **) &w->materialNames,
+        &w->materialCapacity, w->numMaterials + 1, sizeof(char *))) {
+    free(copy);
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate material %s.", name);
+  }
+  w->materialNames[w->numMaterials++] = copy;
+  return VKR_SUCCESS;
+}
+
+typedef struct {
+  const VkrMeshData *mesh;
+  float boundsMin[VKR_WRITE_MAX_THREADS][3];
+  float boundsMax[VKR_WRITE_MAX_THREADS][3];
+  float quantizationBase[3];
+  float quantizationScaling[3];
+  const uint32_t *order; // Output triangle -> input triangle.
+  const int32_t *triangleMaterialBase;
+  uint64_t *vertices;
+  uint64_t *normalUvs;
+  uint8_t *materialIds;
+} VkrMeshQuantization;
+
+static void vkr_mesh_bounds_task(void *context, uint64_t begin, uint64_t end,
+    uint32_t threadIndex)
+{
+  VkrMeshQuantization *mq = (VkrMeshQuantization *) context;
+  float *bmin = mq->boundsMin[threadIndex];
+  float *bmax = mq->boundsMax[threadIndex];
+  for (int j = 0; j < 3; ++j) {
+    bmin[j] = INFINITY;
+    bmax[j] = -INFINITY;
+  }
+  for (uint64_t i = begin; i < end; ++i) {
+    float b[3];
+    vkr_to_file_space(b, mq->mesh->positions + 3 * i);
+    for (int j = 0; j < 3; ++j) {
+      bmin[j] = fminf(bmin[j], b[j]);
+      bmax[j] = fmaxf(bmax[j], b[j]);
+    }
+  }
+}
+
+static void vkr_mesh_quantization_task(void *context, uint64_t begin,
+    uint64_t end, uint32_t threadIndex)
+{
+  (void) threadIndex; /* triangles are written to disjoint ranges, no per-thread state */
+  VkrMeshQuantization *mq = (VkrMeshQuantization *) context;
+  const VkrMeshData *mesh = mq->mesh;
+  static const float zeroUv[2] = { 0.0f, 0.0f };
+
+  for (uint64_t t = begin; t < end; ++t) {
+    const uint64_t src = mq->order[t];
+    const uint32_t *idx = mesh->indices + 3 * src;
+    const float *p[3];
+    for (int c = 0; c < 3; ++c) {
+      p[c] = mesh->positions + 3 * (uint64_t) idx[c];
+      mq->vertices[3 * t + c] = vkr_quantize_position(p[c],
+          mq->quantizationBase, mq->quantizationScaling);
+    }
+
+    uint32_t qn[3];
+    if (mesh->normals) {
+      for (int c = 0; c < 3; ++c)
+        qn[c] = vkr_quantize_normal(mesh->normals + 3 * (uint64_t) idx[c]);
+    }
+    else {
+      float e1[3], e2[3];
+      for (int j = 0; j < 3; ++j) {
+        e1[j] = p[1][j] - p[0][j];
+        e2[j] = p[2][j] - p[0][j];
+      }
+      float n[3] = {
+        e1[1] * e2[2] - e1[2] * e2[1],
+        e1[2] * e2[0] - e1[0] * e2[2],
+        e1[0] * e2[1] - e1[1] * e2[0]
+      };
+      qn[0] = qn[1] = qn[2] = vkr_quantize_normal(n);
+    }
+
+    uint32_t quv[3] = { 0, 0, 0 };
+    if (mesh->uvs) {
+      vkr_quantize_triangle_uvs(quv,
+          mesh->uvs + 2 * (uint64_t) idx[0],
+          mesh->uvs + 2 * (uint64_t) idx[1],
+          mesh->uvs + 2 * (uint64_t) idx[2]);
+    }
+    else
+      vkr_quantize_triangle_uvs(quv, zeroUv, zeroUv, zeroUv);
+
+    for (int c = 0; c < 3; ++c)
+      mq->normalUvs[3 * t + c] = (uint64_t) qn[c] | (uint64_t) quv[c] << 32u;
+
+    const int32_t material = mesh->materialIds ? (int32_t) mesh->materialIds[src] : 0;
+    mq->materialIds[t] = (uint8_t) (material - mq->triangleMaterialBase[t]);
+  }
+}
+
+static int vkr_compare_uint64(const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *) a;
+  const uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Triangle order and segments of a mesh: one segment if all material IDs fit
+ * into 8 bit relative to the smallest one, one segment per material otherwise.
+ */
+static VkrResult vkr_segment_mesh(VkrSceneWriter *w, const VkrMeshData *mesh,
+    uint32_t minMaterial, uint32_t maxMaterial,
+    uint32_t *order, int32_t *triangleMaterialBase, VkrWriterMesh *out)
+{
+  const uint64_t n = mesh->numTriangles;
+  if (!mesh->materialIds || maxMaterial - minMaterial <= 0xFF) {
+    out->numSegments = 1;
+    out->segmentNumTriangles = (uint64_t *) malloc(sizeof(uint64_t));
+    out->segmentMaterialBaseOffsets = (int32_t *) malloc(sizeof(int32_t));
+    if (!out->segmentNumTriangles || !out->segmentMaterialBaseOffsets)
+      return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+          "Failed to allocate segments for mesh %s.", mesh->name);
+    out->segmentNumTriangles[0] = n;
+    out->segmentMaterialBaseOffsets[0] = (int32_t) minMaterial;
+    for (uint64_t t = 0; t < n; ++t) {
+      order[t] = (uint32_t) t;
+      triangleMaterialBase[t] = (int32_t) minMaterial;
+    }
+    return VKR_SUCCESS;
+  }
+
+  // Stable sort by material, the renderer binds one material per segment
+  uint64_t *keys = (uint64_t *) malloc(sizeof(uint64_t) * n);
+  if (!keys)
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate segments for mesh %s.", mesh->name);
+  for (uint64_t t = 0; t < n; ++t)
+    keys[t] = (uint64_t) mesh->materialIds[t] << 32u | t;
+  qsort(keys, n, sizeof(uint64_t), vkr_compare_uint64);
+
+  uint64_t numSegments = 0;
+  for (uint64_t t = 0; t < n; ++t) {
+    if (t == 0 || (keys[t] >> 32u) != (keys[t - 1] >> 32u))
+      ++numSegments;
+  }
+  out->numSegments = numSegments;
+  out->segmentNumTriangles = (uint64_t *) calloc(numSegments, sizeof(uint64_t));
+  out->segmentMaterialBaseOffsets = (int32_t *) calloc(numSegments, sizeof(int32_t));
+  if (!out->segmentNumTriangles || !out->segmentMaterialBaseOffsets) {
+    free(keys);
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate segments for mesh %s.", mesh->name);
+  }
+
+  uint64_t segment = 0;
+  for (uint64_t t = 0; t < n; ++t) {
+    const uint32_t material = (uint32_t) (keys[t] >> 32u);
+    if (t > 0 && material != (uint32_t) (keys[t - 1] >> 32u))
+      ++segment;
+    out->segmentMaterialBaseOffsets[segment] = (int32_t) material;
+    ++out->segmentNumTriangles[segment];
+    order[t] = (uint32_t) keys[t];
+    triangleMaterialBase[t] = (int32_t) material;
+  }
+  free(keys);
+  return VKR_SUCCESS;
+}
+
+/*
+ * Vertex cache optimization reorders the triangles of each segment. Since the
+ * renderer uses implicit indices, the fetch order follows the triangle order.
+ */
+static VkrResult vkr_optimize_segments(VkrSceneWriter *w,
+    const VkrMeshData *mesh, const VkrWriterMesh *out, uint32_t *order)
+{
+  uint64_t maxSegmentTriangles = 0;
+  for (uint64_t s = 0; s < out->numSegments; ++s) {
+    if (out->segmentNumTriangles[s] > maxSegmentTriangles)
+      maxSegmentTriangles = out->segmentNumTriangles[s];
+  }
+  uint32_t *indices = (uint32_t *) malloc(sizeof(uint32_t) * 3 * maxSegmentTriangles);
+  uint32_t *remap = (uint32_t *) malloc(sizeof(uint32_t) * maxSegmentTriangles);
+  uint32_t *segmentOrder = (uint32_t *) malloc(sizeof(uint32_t) * maxSegmentTriangles);
+  if (!indices || !remap || !segmentOrder) {
+    free(indices);
+    free(remap);
+    free(segmentOrder);
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate optimization buffers for mesh %s.", mesh->name);
+  }
+
+  VkrResult result = VKR_SUCCESS;
+  uint64_t base = 0;
+  for (uint64_t s = 0; s < out->numSegments && result == VKR_SUCCESS; ++s) {
+    const uint64_t n = out->segmentNumTriangles[s];
+    for (uint64_t t = 0; t < n; ++t)
+      memcpy(indices + 3 * t, mesh->indices + 3 * (uint64_t) order[base + t],
+          3 * sizeof(uint32_t));
+    result = vkr_optimize_mesh(n, indices, mesh->numVertices, remap, w->eh);
+    if (result == VKR_SUCCESS) {
+      for (uint64_t t = 0; t < n; ++t)
+        segmentOrder[t] = order[base + remap[t]];
+      memcpy(order + base, segmentOrder, sizeof(uint32_t) * n);
+    }
+    base += n;
+  }
+
+  free(indices);
+  free(remap);
+  free(segmentOrder);
+  if (result != VKR_SUCCESS && w->result == VKR_SUCCESS)
+    w->result = result;
+  return result;
+}
+
+/*
+ * Vertex sharing indices point to the first corner in the same segment that
+ * references the same vertex. meshopt_optimizeVertexFetchRemap numbers the
+ * vertices of a segment in order of first use, which keeps the lookup table
+ * compact and its accesses mostly sequential.
+ */
+static VkrResult vkr_build_sharing_indices(VkrSceneWriter *w,
+    const VkrMeshData *mesh, const VkrWriterMesh *out, const uint32_t *order,
+    uint32_t *sharing)
+{
+  uint64_t maxSegmentTriangles = 0;
+  for (uint64_t s = 0; s < out->numSegments; ++s) {
+    if (out->segmentNumTriangles[s] > maxSegmentTriangles)
+      maxSegmentTriangles = out->segmentNumTriangles[s];
+  }
+  uint32_t *indices = (uint32_t *) malloc(sizeof(uint32_t) * 3 * maxSegmentTriangles);
+  uint32_t *fetchRemap = (uint32_t *) malloc(sizeof(uint32_t) * mesh->numVertices);
+  uint32_t *firstCorner = (uint32_t *) malloc(sizeof(uint32_t) * 3 * maxSegmentTriangles);
+  if (!indices || !fetchRemap || !firstCorner) {
+    free(indices);
+    free(fetchRemap);
+    free(firstCorner);
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate index buffers for mesh %s.", mesh->name);
+  }
+
+  uint64_t base = 0;
+  for (uint64_t s = 0; s < out->numSegments; ++s) {
+    const uint64_t n = out->segmentNumTriangles[s];
+    for (uint64_t t = 0; t < n; ++t)
+      memcpy(indices + 3 * t, mesh->indices + 3 * (uint64_t) order[base + t],
+          3 * sizeof(uint32_t));
+    const size_t numUsed = meshopt_optimizeVertexFetchRemap(fetchRemap,
+        indices, 3 * n, mesh->numVertices);
+    memset(firstCorner, 0xFF, sizeof(uint32_t) * numUsed);
+    for (uint64_t c = 0; c < 3 * n; ++c) {
+      uint32_t *first = firstCorner + fetchRemap[indices[c]];
+      if (*first == UINT32_MAX)
+        *first = (uint32_t) (3 * base + c);
+      sharing[3 * base + c] = *first;
+    }
+    base += n;
+  }
+
+  free(indices);
+  free(fetchRemap);
+  free(firstCorner);
+  return VKR_SUCCESS;
+}
+
+static int vkr_write_data(VkrSceneWriter *w, const void *data, size_t size)
+{
+  if (size > 0 && fwrite(data, 1, size, w->dataFile) != size)
+    return 0;
+  w->dataSize += size;
+  return 1;
+}
+
+VkrResult vkr_write_mesh(VkrSceneWriter *w, const VkrMeshData *mesh,
+    int64_t *meshId)
+{
+  if (!w || !mesh || !mesh->positions || !mesh->indices
+   || mesh->numVertices == 0 || mesh->numTriangles == 0) {
+    return reportError(w ? w->eh : NULL, VKR_INVALID_ARGUMENT,
+        "Invalid argument to vkr_write_mesh.");
+  }
+  if (w->result != VKR_SUCCESS)
+    return w->result;
+  const char *name = mesh->name ? mesh->name : "";
+  // Sharing indices address the 3 * numTriangles implicit vertices
+  if (mesh->numTriangles > UINT32_MAX / 3 || mesh->numVertices > UINT32_MAX)
+    return vkr_writer_fail(w, VKR_INVALID_ARGUMENT,
+        "Mesh %s exceeds 32-bit vertex indices.", name);
+
+  const uint64_t n = mesh->numTriangles;
+  for (uint64_t i = 0; i < 3 * n; ++i) {
+    if (mesh->indices[i] >= mesh->numVertices)
+      return vkr_writer_fail(w, VKR_INVALID_ARGUMENT,
+          "Invalid index buffer for mesh %s.", name);
+  }
+  uint32_t minMaterial = 0, maxMaterial = 0;
+  if (mesh->materialIds) {
+    minMaterial = maxMaterial = mesh->materialIds[0];
+    for (uint64_t t = 1; t < n; ++t) {
+      const uint32_t m = mesh->materialIds[t];
+      minMaterial = m < minMaterial ? m : minMaterial;
+      maxMaterial = m > maxMaterial ? m : maxMaterial;
+    }
+    if (maxMaterial > INT32_MAX)
+      return vkr_writer_fail(w, VKR_INVALID_ARGUMENT,
+          "Invalid material IDs for mesh %s.", name);
+  }
+
+  if (!vkr_reserve_array((void **) &w->meshes, &w->meshCapacity,
+        w->numMeshes + 1, sizeof(VkrWriterMesh)))
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate mesh %s.", name);
+  VkrWriterMesh *out = w->meshes + w->numMeshes;
+  memset(out, 0, sizeof(VkrWriterMesh));
+
+  VkrMeshQuantization *mq = (VkrMeshQuantization *) calloc(1, sizeof(VkrMeshQuantization));
+  uint32_t *order = (uint32_t *) malloc(sizeof(uint32_t) * n);
+  int32_t *triangleMaterialBase = (int32_t *) malloc(sizeof(int32_t) * n);
+  uint64_t *vertices = (uint64_t *) malloc(sizeof(uint64_t) * 3 * n);
+  uint64_t *normalUvs = (uint64_t *) malloc(sizeof(uint64_t) * 3 * n);
+  uint8_t *materialIds = (uint8_t *) malloc(n);
+  uint32_t *sharing = (w->flags & VKR_WRITE_FLAGS_INDICES)
+    ? (uint32_t *) malloc(sizeof(uint32_t) * 3 * n) : NULL;
+  out->name = vkr_copy_string(name);
+
+  VkrResult result = VKR_SUCCESS;
+  if (!mq || !order || !triangleMaterialBase || !vertices || !normalUvs
+   || !materialIds || !out->name
+   || (!sharing && (w->flags & VKR_WRITE_FLAGS_INDICES)))
+    result = vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate buffers for mesh %s.", name);
+
+  if (result == VKR_SUCCESS)
+    result = vkr_segment_mesh(w, mesh, minMaterial, maxMaterial,
+        order, triangleMaterialBase, out);
+  if (result == VKR_SUCCESS && (w->flags & VKR_WRITE_FLAGS_OPTIMIZE_MESHES))
+    result = vkr_optimize_segments(w, mesh, out, order);
+
+  if (result == VKR_SUCCESS) {
+    mq->mesh = mesh;
+    const uint32_t numChunks = vkr_parallel_for(mesh->numVertices,
+        w->numThreads, vkr_mesh_bounds_task, mq);
+    float bmin[3] = { INFINITY, INFINITY, INFINITY };
+    float bmax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = 0; i < numChunks; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        bmin[j] = fminf(bmin[j], mq->boundsMin[i][j]);
+        bmax[j] = fmaxf(bmax[j], mq->boundsMax[i][j]);
+      }
+    }
+    for (int j = 0; j < 3; ++j) {
+      if (!isfinite(bmin[j]) || !isfinite(bmax[j]))
+        bmin[j] = bmax[j] = 0.0f;
+      const float extent = fmaxf(bmax[j] - bmin[j], 1.e-6f);
+      mq->quantizationBase[j] = bmin[j];
+      mq->quantizationScaling[j] = (float) 0x200000 / extent;
+      out->vertexScale[j] = extent / (float) 0x200000;
+      out->vertexOffset[j] = bmin[j] + 0.5f * out->vertexScale[j];
+    }
+
+    mq->order = order;
+    mq->triangleMaterialBase = triangleMaterialBase;
+    mq->vertices = vertices;
+    mq->normalUvs = normalUvs;
+    mq->materialIds = materialIds;
+    vkr_parallel_for(n, w->numThreads, vkr_mesh_quantization_task, mq);
+  }
+
+  if (result == VKR_SUCCESS && sharing)
+    result = vkr_build_sharing_indices(w, mesh, out, order, sharing);
+
+  if (result == VKR_SUCCESS) {
+    out->flags = sharing ? VKR_MESH_FLAGS_INDICES : VKR_MESH_FLAGS_NONE;
+    out->numTriangles = n;
+    out->materialIdBufferBase = (int32_t) minMaterial;
+    out->numMaterialsInRange = maxMaterial + 1 - minMaterial;
+    out->dataOffset = w->dataSize;
+    if (!vkr_write_data(w, vertices, sizeof(uint64_t) * 3 * n)
+     || !vkr_write_data(w, normalUvs, sizeof(uint64_t) * 3 * n)
+     || !vkr_write_data(w, materialIds, n)
+     || (sharing && !vkr_write_data(w, sharing, sizeof(uint32_t) * 3 * n)))
+      result = vkr_writer_fail(w, VKR_INVALID_FILE_NAME,
+          "Failed to write mesh data to %s.", w->dataFilename);
+  }
+
+  free(mq);
+  free(order);
+  free(triangleMaterialBase);
+  free(vertices);
+  free(normalUvs);
+  free(materialIds);
+  free(sharing);
+
+  if (result != VKR_SUCCESS) {
+    free(out->name);
+    free(out->segmentNumTriangles);
+    free(out->segmentMaterialBaseOffsets);
+    return result;
+  }
+
+  if (meshId)
+    *meshId = (int64_t) w->numMeshes;
+  ++w->numMeshes;
+  w->numTriangles += n;
+  if (maxMaterial + 1 > w->numReferencedMaterials)
+    w->numReferencedMaterials = maxMaterial + 1;
+  return VKR_SUCCESS;
+}
+
+VkrResult vkr_write_instances(VkrSceneWriter *w, int64_t meshId,
+    const char *name, uint64_t numInstances, const float (*transforms)[4][3])
+{
+  if (!w || (transforms && numInstances == 0)) {
+    return reportError(w ? w->eh : NULL, VKR_INVALID_ARGUMENT,
+        "Invalid argument to vkr_write_instances.");
+  }
+  if (w->result != VKR_SUCCESS)
+    return w->result;
+  if (!name)
+    name = "";
+  if (meshId < 0 || (uint64_t) meshId >= w->numMeshes)
+    return vkr_writer_fail(w, VKR_INVALID_ARGUMENT,
+        "Invalid mesh for instances %s.", name);
+  if (!transforms)
+    numInstances = 1;
+  if (numInstances > UINT32_MAX - w->numTransforms)
+    return vkr_writer_fail(w, VKR_INVALID_ARGUMENT,
+        "Too many transforms for instances %s.", name);
+
+  char *copy = vkr_copy_string(name);
+  if (!copy
+   || !vkr_reserve_array((void **) &w->groups, &w->groupCapacity,
+        w->numGroups + 1, sizeof(VkrWriterInstanceGroup))
+   || !vkr_reserve_array((void **) &w->transforms, &w->transformCapacity,
+        w->numTransforms + numInstances, VKR_QUANTIZED_TRANSFORM_SIZE)) {
+    free(copy);
+    return vkr_writer_fail(w, VKR_ALLOCATION_ERROR,
+        "Failed to allocate instances %s.", name);
+  }
+
+  static const float identity[4][3] = {
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, 0.0f },
+  };
+  for (uint64_t i = 0; i < numInstances; ++i) {
+    vkr_quantize_transform(w->transforms
+        + VKR_QUANTIZED_TRANSFORM_SIZE * (w->numTransforms + i),
+        transforms ? transforms[i] : identity);
+  }
+
+  VkrWriterInstanceGroup *group = w->groups + w->numGroups++;
+  group->name = copy;
+  group->meshId = meshId;
+  group->numInstances = numInstances;
+  group->firstTransform = (uint32_t) w->numTransforms;
+  w->numTransforms += numInstances;
+  return VKR_SUCCESS;
+}
+
+/*
+ * Output with position tracking and deferred offsets, I/O errors are sticky.
+ */
+typedef struct {
+  FILE *f;
+  int64_t pos;
+  int failed;
+} VkrOutputStream;
+
+static void vkr_put(VkrOutputStream *o, const void *data, size_t size)
+{
+  if (!o->failed && size > 0 && fwrite(data, 1, size, o->f) != size)
+    o->failed = 1;
+  o->pos += (int64_t) size;
+}
+
+static void vkr_put_u64(VkrOutputStream *o, uint64_t v) { vkr_put(o, &v, sizeof(v)); }
+static void vkr_put_i64(VkrOutputStream *o, int64_t v) { vkr_put(o, &v, sizeof(v)); }
+static void vkr_put_u32(VkrOutputStream *o, uint32_t v) { vkr_put(o, &v, sizeof(v)); }
+static void vkr_put_i32(VkrOutputStream *o, int32_t v) { vkr_put(o, &v, sizeof(v)); }
+static void vkr_put_f32(VkrOutputStream *o, float v) { vkr_put(o, &v, sizeof(v)); }
+
+static void vkr_put_string(VkrOutputStream *o, const char *s)
+{
+  const uint64_t len = strlen(s);
+  vkr_put_u64(o, len);
+  vkr_put(o, s, len + 1);
+}
+
+// Writes a placeholder offset and returns its position
+static int64_t vkr_put_offset(VkrOutputStream *o)
+{
+  const int64_t pos = o->pos;
+  vkr_put_i64(o, 0);
+  return pos;
+}
+
+// Offsets are only patched within the header, which is small
+static void vkr_patch_offset(VkrOutputStream *o, int64_t pos, int64_t value)
+{
+  if (o->failed)
+    return;
+  if (fseek(o->f, (long) pos, SEEK_SET) != 0
+   || fwrite(&value, sizeof(value), 1, o->f) != 1
+   || fseek(o->f, 0, SEEK_END) != 0)
+    o->failed = 1;
+}
+
+static void vkr_put_scene(VkrSceneWriter *w, VkrOutputStream *o)
+{
+  vkr_put_i32(o, VKR_MAGIC_NUMBER);
+  vkr_put_i32(o, VKR_WRITE_VERSION);
+  vkr_put_u64(o, 0); // flags
+  const int64_t headerSizePos = vkr_put_offset(o);
+  const int64_t dataOffsetPos = vkr_put_offset(o);
+  uint64_t numInstances = 0;
+  for (uint64_t i = 0; i < w->numGroups; ++i)
+    numInstances += w->groups[i].numInstances;
+  vkr_put_u64(o, w->numMeshes);
+  vkr_put_u64(o, numInstances);
+  vkr_put_u64(o, w->numMaterials);
+  vkr_put_u64(o, w->numTriangles);
+  vkr_put_u64(o, w->numGroups);
+  vkr_put_u64(o, 1); // LoD groups, only the catch-all group
+  const int64_t lodGroupsOffsetPos = vkr_put_offset(o);
+  vkr_put_u64(o, 0); // bone index tuples
+  vkr_put_i64(o, 0);
+  vkr_put_f32(o, 0.0f); // animation start and step
+  vkr_put_f32(o, 0.0f);
+  vkr_put_u64(o, 1); // frames
+  vkr_put_u64(o, w->numTransforms); // static transforms
+  vkr_put_u64(o, 0); // animated transforms
+  const int64_t animationOffsetPos = vkr_put_offset(o);
+  vkr_patch_offset(o, headerSizePos, o->pos);
+
+  for (uint64_t i = 0; i < w->numMeshes; ++i) {
+    VkrWriterMesh *mesh = w->meshes + i;
+    vkr_put(o, mesh->vertexScale, sizeof(mesh->vertexScale));
+    vkr_put(o, mesh->vertexOffset, sizeof(mesh->vertexOffset));
+    vkr_put_u64(o, mesh->flags);
+    const int64_t headerEndPos = vkr_put_offset(o);
+    mesh->vertexBufferOffsetPos = vkr_put_offset(o);
+    vkr_put_u64(o, mesh->numSegments);
+    vkr_put_u64(o, mesh->numTriangles);
+    vkr_put_i32(o, mesh->materialIdBufferBase);
+    vkr_put_u32(o, mesh->numMaterialsInRange);
+    vkr_put_i64(o, 0); // LoD group
+    for (int j = 0; j < 4; ++j)
+      vkr_put_u64(o, 0); // reserved
+    vkr_put(o, mesh->segmentNumTriangles, sizeof(uint64_t) * mesh->numSegments);
+    vkr_put(o, mesh->segmentMaterialBaseOffsets, sizeof(int32_t) * mesh->numSegments);
+    vkr_put_string(o, mesh->name);
+    vkr_patch_offset(o, headerEndPos, o->pos);
+  }
+
+  for (uint64_t i = 0; i < w->numGroups; ++i) {
+    const VkrWriterInstanceGroup *group = w->groups + i;
+    vkr_put_u32(o, 0); // flags
+    vkr_put_i32(o, (int32_t) group->meshId);
+    const int64_t headerEndPos = vkr_put_offset(o);
+    const int64_t groupDataOffsetPos = vkr_put_offset(o);
+    vkr_put_u64(o, group->numInstances);
+    vkr_put_string(o, group->name);
+    vkr_patch_offset(o, groupDataOffsetPos, o->pos);
+    for (uint64_t j = 0; j < group->numInstances; ++j)
+      vkr_put_u32(o, group->firstTransform + (uint32_t) j);
+    vkr_patch_offset(o, headerEndPos, o->pos);
+  }
+
+  vkr_patch_offset(o, lodGroupsOffsetPos, o->pos);
+  vkr_put_u64(o, 0); // catch-all group has no levels of detail
+
+  vkr_patch_offset(o, dataOffsetPos, o->pos);
+  for (uint64_t i = 0; i < w->numMaterials; ++i)
+    vkr_put_string(o, w->materialNames[i]);
+
+  const int64_t meshDataOffset = o->pos;
+  for (uint64_t i = 0; i < w->numMeshes; ++i)
+    vkr_patch_offset(o, w->meshes[i].vertexBufferOffsetPos,
+        meshDataOffset + (int64_t) w->meshes[i].dataOffset);
+  vkr_patch_offset(o, animationOffsetPos, meshDataOffset + (int64_t) w->dataSize);
+}
+
+static int vkr_copy_staged_data(VkrSceneWriter *w, VkrOutputStream *o)
+{
+  char *chunk = (char *) malloc(VKR_WRITE_COPY_CHUNK_SIZE);
+  if (!chunk || fflush(w->dataFile) != 0 || fseek(w->dataFile, 0, SEEK_SET) != 0) {
+    free(chunk);
+    o->failed = 1;
+    return 0;
+  }
+  uint64_t remaining = w->dataSize;
+  while (remaining > 0 && !o->failed) {
+    const size_t size = remaining < VKR_WRITE_COPY_CHUNK_SIZE
+      ? (size_t) remaining : VKR_WRITE_COPY_CHUNK_SIZE;
+    if (fread(chunk, 1, size, w->dataFile) != size)
+      break;
+    vkr_put(o, chunk, size);
+    remaining -= size;
+  }
+  free(chunk);
+  if (remaining > 0)
+    o->failed = 1;
+  return !o->failed;
+}
+
+VkrResult vkr_end_scene(VkrSceneWriter *w)
+{
+  if (!w) {
+    return reportError(NULL, VKR_INVALID_ARGUMENT,
+        "Invalid argument to vkr_end_scene.");
+  }
+
+  VkrResult result = w->result;
+  if (result == VKR_SUCCESS && (w->numMeshes == 0 || w->numGroups == 0))
+    result = reportError(w->eh, VKR_INVALID_ARGUMENT,
+        "Scene %s needs at least one mesh and one instance.", w->filename);
+  if (result == VKR_SUCCESS && w->numReferencedMaterials > w->numMaterials)
+    result = reportError(w->eh, VKR_INVALID_ARGUMENT,
+        "Meshes in %s reference %" PRIu64 " materials, but only %" PRIu64
+        " were written.", w->filename, w->numReferencedMaterials, w->numMaterials);
+
+  if (result == VKR_SUCCESS) {
+    VkrOutputStream o = { w->file, 0, 0 };
+    vkr_put_scene(w, &o);
+    if (vkr_copy_staged_data(w, &o))
+      vkr_put(&o, w->transforms, VKR_QUANTIZED_TRANSFORM_SIZE * w->numTransforms);
+    if (o.failed)
+      result = reportError(w->eh, VKR_INVALID_FILE_NAME,
+          "Failed to write %s.", w->filename);
+  }
+
+  if (fclose(w->file) != 0 && result == VKR_SUCCESS)
+    result = reportError(w->eh, VKR_INVALID_FILE_NAME,
+        "Failed to write %s.", w->filename);
+  w->file = NULL;
+  if (result != VKR_SUCCESS)
+    remove(w->filename);
+
+  vkr_free_writer(w);
+  return result;
+}
+
+void vkr_discard_scene(VkrSceneWriter *w)
+{
+  if (!w)
+    return;
+  fclose(w->file);
+  w->file = NULL;
+  remove(w->filename);
+  vkr_free_writer(w);
+}
+
 #endif // VKR_BUILD_TOOLS
 
@@ -128,7 +128,7 @@ typedef enum {
 /*
  * A tensor definition.
  */
-typedef struct {
+typedef struct VkrTensor {
   #define VkrTensorMaxDimensionality 4
   uint64_t dimensionality;
   VkrTensorFormat format;
@@ -204,6 +204,10 @@ typedef struct {
   int64_t vertexBufferOffset; // In bytes, in the file.
   int64_t normalUvBufferOffset; // In bytes, in the file.
 
+  // With VKR_MESH_FLAGS_BLEND_ATTRIBUTES, there are 3 * numTriangles 32-bit
+  // codes for blend weights and an index into the bone index tuple table.
+  int64_t blendAttributeBufferOffset; // In bytes, in the file.
+
   // There are numTriangles material IDs.
   int64_t materialIdBufferOffset; // In bytes, in the file.
   VkrMaterialIdSize materialIdSize; // In bytes (one id is this big).
@@ -455,6 +459,84 @@ VkrResult vkr_convert_texture(
     VkrTextureFormat outputFormat, VkrTextureFormat opaqueOutputFormat,
     VkrErrorHandler errorHandler);
 
+/*
+ * Flags for vkr_begin_scene().
+ */
+typedef enum {
+  VKR_WRITE_FLAGS_NONE            = 0,
+  // Reorder triangles for vertex cache locality, see vkr_optimize_mesh().
+  VKR_WRITE_FLAGS_OPTIMIZE_MESHES = 0x1,
+  // Store vertex sharing indices with each mesh (VKR_MESH_FLAGS_INDICES).
+  VKR_WRITE_FLAGS_INDICES         = 0x2,
+  VKR_WRITE_FLAGS_MAX_ENUM        = 0x7FFFFFFF
+} VkrWriteFlags;
+
+/*
+ * An indexed mesh to be written with vkr_write_mesh(). Positions, normals and
+ * UVs use the conventions of vkr_dequantize_vertices() and
+ * vkr_dequantize_normal_uv(), such that reading the scene back reproduces
+ * them up to quantization error (UVs up to integer offsets per triangle).
+ */
+typedef struct {
+  const char *name;
+  uint64_t numVertices;
+  const float *positions; // 3 * numVertices
+  const float *normals; // 3 * numVertices, NULL for face normals
+  const float *uvs; // 2 * numVertices, NULL for zero UVs
+  uint64_t numTriangles;
+  const uint32_t *indices; // 3 * numTriangles
+  const uint32_t *materialIds; // numTriangles scene material IDs, NULL for 0
+} VkrMeshData;
+
+/*
+ * Writes a .vks scene file incrementally. Meshes are quantized (in parallel)
+ * and streamed out as they are added, such that only one mesh needs to be
+ * kept in memory at a time. Quantized mesh data is staged in a file next to
+ * the output file until vkr_end_scene() assembles the final scene.
+ */
+typedef struct VkrSceneWriter VkrSceneWriter;
+
+/*
+ * Start writing the scene file pointed to by filename.
+ * flags is a combination of VkrWriteFlags, numThreads 0 uses all cores.
+ */
+VkrResult vkr_begin_scene(const char *filename, uint32_t flags,
+    uint32_t numThreads, VkrSceneWriter **writer,
+    VkrErrorHandler errorHandler);
+
+/*
+ * Add a material, material IDs are assigned in order starting at 0.
+ * Textures are found by name in the scene's texture directory when loading.
+ */
+VkrResult vkr_write_material(VkrSceneWriter *writer, const char *name);
+
+/*
+ * Quantize and write the given mesh, meshId receives its index (optional).
+ * Meshes whose material IDs span more than 256 materials are split into one
+ * segment per material.
+ */
+VkrResult vkr_write_mesh(VkrSceneWriter *writer, const VkrMeshData *mesh,
+    int64_t *meshId);
+
+/*
+ * Add a group of numInstances instances of the given mesh. Transforms use
+ * the conventions of vkr_quantize_transform(), NULL places a single instance
+ * with the identity transform.
+ */
+VkrResult vkr_write_instances(VkrSceneWriter *writer, int64_t meshId,
+    const char *name, uint64_t numInstances, const float (*transforms)[4][3]);
+
+/*
+ * Write the scene header and assemble the scene file. Frees the writer, also
+ * on failure, in which case the output file is removed.
+ */
+VkrResult vkr_end_scene(VkrSceneWriter *writer);
+
+/*
+ * Free the writer without completing the scene file.
+ */
+void vkr_discard_scene(VkrSceneWriter *writer);
+
 #if defined(__cplusplus)
 } // extern "C" {
 #endif
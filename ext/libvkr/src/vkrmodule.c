@@ -155,7 +155,7 @@ PyObject *convertVkrMeshRecord(const VkrMesh *m)
   memcpy(d, m->scaleBoundsMax, v_dim * sizeof(float));
 
   PyObject *s = Py_BuildValue(
-    "{s:s,s:O,s:O,s:O,s:O,s:i,s:K,s:K,s:K,s:L,s:L,s:L,s:i,s:L}",
+    "{s:s,s:O,s:O,s:O,s:O,s:i,s:K,s:K,s:K,s:L,s:L,s:L,s:L,s:i,s:L}",
     "name", m->name,
     "vertexScale", vertexScale,
     "vertexOffset", vertexOffset,
@@ -167,6 +167,7 @@ PyObject *convertVkrMeshRecord(const VkrMesh *m)
     "lodGroup", m->lodGroup,
     "vertexBufferOffset", m->vertexBufferOffset,
     "normalUvBufferOffset", m->normalUvBufferOffset,
+    "blendAttributeBufferOffset", m->blendAttributeBufferOffset,
     "materialIdBufferOffset", m->materialIdBufferOffset,
     "materialIdSize", m->materialIdSize,
     "indexBufferOffset", m->indexBufferOffset
@@ -0,0 +1,165 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+/*
+ * Converts Wavefront .obj files into .vks scenes, with one mesh and one
+ * instance per object. Material textures are not converted, see vktconvert.
+ */
+
+#include "vkr.h"
+#include <meshoptimizer.h>
+
+#define FAST_OBJ_IMPLEMENTATION
+#include "fast_obj.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void errorHandler(VkrResult result, const char *msg)
+{
+  printf("error: %s\n", msg);
+}
+
+/*
+ * Triangulates the faces of one object as fans and welds corners with equal
+ * position, UV and normal indices into shared vertices.
+ */
+VkrResult convert_object(VkrSceneWriter *writer, const fastObjMesh *obj,
+    const fastObjGroup *object, int64_t *meshId)
+{
+  uint64_t numTriangles = 0;
+  for (unsigned int f = 0; f < object->face_count; ++f) {
+    const unsigned int numCorners = obj->face_vertices[object->face_offset + f];
+    if (numCorners >= 3)
+      numTriangles += numCorners - 2;
+  }
+  if (numTriangles == 0) {
+    *meshId = -1;
+    return VKR_SUCCESS;
+  }
+
+  const size_t numIndices = 3 * numTriangles;
+  fastObjIndex *corners = (fastObjIndex *) malloc(sizeof(fastObjIndex) * numIndices);
+  uint32_t *materialIds = (uint32_t *) malloc(sizeof(uint32_t) * numTriangles);
+  uint32_t *remap = (uint32_t *) malloc(sizeof(uint32_t) * numIndices);
+  float *positions = (float *) malloc(sizeof(float) * 3 * numIndices);
+  float *normals = (float *) malloc(sizeof(float) * 3 * numIndices);
+  float *uvs = (float *) malloc(sizeof(float) * 2 * numIndices);
+  VkrResult result = VKR_SUCCESS;
+  if (!corners || !materialIds || !remap || !positions || !normals || !uvs) {
+    result = VKR_ALLOCATION_ERROR;
+    errorHandler(result, "Failed to allocate mesh buffers.");
+  }
+
+  if (result == VKR_SUCCESS) {
+    uint64_t t = 0;
+    const fastObjIndex *faceCorners = obj->indices + object->index_offset;
+    for (unsigned int f = 0; f < object->face_count; ++f) {
+      const unsigned int face = object->face_offset + f;
+      const unsigned int numCorners = obj->face_vertices[face];
+      for (unsigned int c = 2; c < numCorners; ++c, ++t) {
+        corners[3 * t + 0] = faceCorners[0];
+        corners[3 * t + 1] = faceCorners[c - 1];
+        corners[3 * t + 2] = faceCorners[c];
+        materialIds[t] = obj->material_count > 0 ? obj->face_materials[face] : 0;
+      }
+      faceCorners += numCorners;
+    }
+
+    const size_t numVertices = meshopt_generateVertexRemap(remap, NULL,
+        numIndices, corners, numIndices, sizeof(fastObjIndex));
+    // Index 0 is the dummy element of fast_obj, missing normals get face normals
+    int haveNormals = 1;
+    for (size_t i = 0; i < numIndices; ++i) {
+      const fastObjIndex *c = corners + i;
+      const uint32_t v = remap[i];
+      memcpy(positions + 3 * v, obj->positions + 3 * c->p, 3 * sizeof(float));
+      memcpy(normals + 3 * v, obj->normals + 3 * c->n, 3 * sizeof(float));
+      // .obj UVs have v pointing up, libvkr's point down
+      uvs[2 * v] = obj->texcoords[2 * c->t];
+      uvs[2 * v + 1] = 1.0f - obj->texcoords[2 * c->t + 1];
+      haveNormals &= c->n != 0;
+    }
+
+    VkrMeshData mesh = {
+      .name = object->name ? object->name : "",
+      .numVertices = numVertices,
+      .positions = positions,
+      .normals = haveNormals ? normals : NULL,
+      .uvs = uvs,
+      .numTriangles = numTriangles,
+      .indices = remap,
+      .materialIds = materialIds,
+    };
+    result = vkr_write_mesh(writer, &mesh, meshId);
+  }
+
+  free(corners);
+  free(materialIds);
+  free(remap);
+  free(positions);
+  free(normals);
+  free(uvs);
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t flags = VKR_WRITE_FLAGS_OPTIMIZE_MESHES;
+  uint32_t numThreads = 0;
+  const char *files[2] = { NULL, NULL };
+  int numFiles = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--no-optimize") == 0)
+      flags &= ~VKR_WRITE_FLAGS_OPTIMIZE_MESHES;
+    else if (strcmp(argv[i], "--indices") == 0)
+      flags |= VKR_WRITE_FLAGS_INDICES;
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      numThreads = (uint32_t) atoi(argv[++i]);
+    else if (numFiles < 2 && argv[i][0] != '-')
+      files[numFiles++] = argv[i];
+    else
+      numFiles = -1;
+  }
+  if (numFiles != 2) {
+    printf("usage: %s INPUT.obj OUTPUT.vks [--no-optimize] [--indices] [--threads N]\n", argv[0]);
+    return -1;
+  }
+
+  printf("converting %s to %s ...\n", files[0], files[1]);
+  fastObjMesh *obj = fast_obj_read(files[0]);
+  if (!obj) {
+    printf("error: Failed to read %s\n", files[0]);
+    return 1;
+  }
+
+  VkrSceneWriter *writer = NULL;
+  VkrResult result = vkr_begin_scene(files[1], flags, numThreads, &writer,
+      errorHandler);
+  if (result == VKR_SUCCESS) {
+    for (unsigned int i = 0; i < obj->material_count && result == VKR_SUCCESS; ++i)
+      result = vkr_write_material(writer, obj->materials[i].name);
+    if (obj->material_count == 0 && result == VKR_SUCCESS)
+      result = vkr_write_material(writer, "default");
+
+    // Files without objects are one object
+    fastObjGroup whole = { NULL, obj->face_count, 0, 0 };
+    const fastObjGroup *objects = obj->object_count > 0 ? obj->objects : &whole;
+    const unsigned int numObjects = obj->object_count > 0 ? obj->object_count : 1;
+    for (unsigned int i = 0; i < numObjects && result == VKR_SUCCESS; ++i) {
+      int64_t meshId = -1;
+      result = convert_object(writer, obj, objects + i, &meshId);
+      if (result == VKR_SUCCESS && meshId >= 0)
+        result = vkr_write_instances(writer, meshId, objects[i].name, 0, NULL);
+    }
+
+    if (result == VKR_SUCCESS)
+      result = vkr_end_scene(writer);
+    else
+      vkr_discard_scene(writer);
+  }
+
+  fast_obj_destroy(obj);
+  return result == VKR_SUCCESS ? 0 : 1;
+}
@@ -879,6 +879,20 @@ void PadFrames(int minNumAfterStart) {
     // refresh pointers to variable-size state
     apply_application_settings(context.state, context.next_settings_index);
 }
+void ExtendTimeline(double timecode) {
+    auto& context = *application_settings_context;
+
+    double timeline_constraint = 0.0;
+    if (!context.state.settings.empty())
+        timeline_constraint = context.state.settings.back().timeline_constraint;
+    // the last keyframe marks the end in non-interactive modes
+    if (timeline_constraint >= timecode)
+        return;
+    add_settings_frame(context.state, timecode);
+
+    // refresh pointers to variable-size state
+    apply_application_settings(context.state, context.next_settings_index);
+}
 int NumKeyframes() {
     auto& context = *application_settings_context;
     return (int) context.state.settings.size();
@@ -48,6 +48,7 @@ void HandledNewSettings();
 
 void AppendFrame(double delay);
 void PadFrames(int minNumAfterStart = 1);
+void ExtendTimeline(double timecode);
 int NumKeyframes();
 int CurrentKeyframe();
 bool LastKeyframeComingUp(double timecode);
@@ -38,11 +38,27 @@ bool BasicApplicationState::state(RenderBackend *renderer)
         }
     }
     renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "batch spp", &renderer->params.batch_spp, 1, 16);
+    other_changes |= IMGUI_STATE(ImGui::SliderFloat, "target frame time (ms)", &frame_time_controller.settings.target_ms, 0.0f, 100.0f);
+    other_changes |= IMGUI_STATE(ImGui::SliderInt, "target frame time max spp", &frame_time_controller.settings.max_spp, 1, 16);
+    if (frame_time_controller.enabled())
+        IMGUI_VOLATILE(ImGui::Text("adapted: %d spp, %dx upscaling", frame_time_controller.current.batch_spp, frame_time_controller.current.upscale_factor));
     other_changes |= IMGUI_STATE(ImGui::Checkbox, "pause rendering", &pause_rendering);
     IMGUI_VOLATILE(ImGui::SameLine());
     other_changes |= IMGUI_STATE(ImGui::Checkbox, "continuous restart", &continuous_restart);
     renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "max path depth", &renderer->params.max_path_depth, 1, MAX_PATH_DEPTH);
 
+    bool adaptive_sampling = static_cast<bool>(renderer->params.adaptive_sampling);
+    renderer_changed |= IMGUI_STATE(ImGui::Checkbox, "adaptive sampling", &adaptive_sampling);
+    renderer->params.adaptive_sampling = static_cast<int>(adaptive_sampling);
+    renderer_changed |= IMGUI_STATE(ImGui::SliderFloat, "adaptive error threshold", &renderer->params.adaptive_error_threshold, 0.001f, 0.1f);
+    renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "adaptive min spp", &renderer->params.adaptive_min_spp, 1, 256);
+    renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "adaptive max spp", &renderer->params.adaptive_max_spp, 1, 256);
+
+    bool path_guiding = static_cast<bool>(renderer->params.path_guiding);
+    renderer_changed |= IMGUI_STATE(ImGui::Checkbox, "path guiding", &path_guiding);
+    renderer->params.path_guiding = static_cast<int>(path_guiding);
+    renderer_changed |= IMGUI_STATE(ImGui::SliderFloat, "path guiding probability", &renderer->params.path_guiding_selection_probability, 0.0f, 0.9f);
+
     bool russian_roulette_override;
     // for legacy configs
     if (IMGUI_OFFER(IMGUI_NO_UI, "enable russian roulette", &russian_roulette_override)) {
@@ -65,6 +81,10 @@ bool BasicApplicationState::state(RenderBackend *renderer)
     renderer_changed |= IMGUI_STATE(ImGui::Checkbox, "force bvh rebuild", &renderer->options.force_bvh_rebuild);
     renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "rebuild triangle budget", &renderer->options.rebuild_triangle_budget, 0, 10000000);
 #endif
+    // note: paging only applies to scenes that were loaded with a budget
+    renderer_changed |= IMGUI_STATE(ImGui::SliderInt, "BLAS budget (MB)", &renderer->options.blas_budget_mb, 0, 16384);
+    // note: applies to meshes uploaded after the change
+    renderer_changed |= IMGUI_STATE(ImGui::Checkbox, "bake opacity states", &renderer->options.bake_opacity_states);
 
     // todo: move to extension?
 
@@ -164,7 +184,7 @@ bool BasicApplicationState::state(RenderBackend *renderer)
             IMGUI_STATE_END(ImGui::EndCombo, reprojection_operators);
         }
 
-#if defined(ENABLE_OIDN) || defined(ENABLE_OIDN2)
+#if defined(ENABLE_OIDN) || defined(ENABLE_OIDN2) || defined(ENABLE_DL_DENOISING)
         renderer_changed |= IMGUI_STATE(ImGui::Checkbox, "enable denoising", &enable_denoising);
 #endif
 
@@ -225,6 +245,11 @@ void BasicApplicationState::begin_after_initialization(
     if (config_args.freeze_frame)
         this->freeze_frame = true;
 
+    if (config_args.target_frame_time_ms > 0.0f)
+        frame_time_controller.settings.target_ms = config_args.target_frame_time_ms;
+    if (config_args.fixed_upscale_factor >= 1)
+        frame_time_controller.settings.max_upscale_factor = config_args.fixed_upscale_factor;
+
     if (config_args.validation_mode) {
         println(CLL::INFORMATION, "Validation mode active");
         target_spp = config_args.validation_target_spp;
@@ -236,6 +261,7 @@ void BasicApplicationState::begin_after_initialization(
         println(CLL::INFORMATION, "Profiling mode active");
         profiling_delta_time = 1.f / config_args.profiling_fps;
         profiling_img_prefix = config_args.profiling_img_prefix;
+        profiling_img_every_frame = config_args.profiling_img_every_frame;
         profiling_mode = true;
     }
 
@@ -245,6 +271,17 @@ void BasicApplicationState::begin_after_initialization(
         data_capture_delta_time = 1.f / config_args.data_capture.fps;
         target_spp = config_args.data_capture.target_spp;
         data_capture = config_args.data_capture;
+        distributed_worker = config_args.distributed_worker;
+        distributed_staging.staging_dir = distributed_worker.staging_dir;
+    }
+
+    else if (config_args.server_mode) {
+        println(CLL::INFORMATION, "Server mode active");
+        server_mode = true;
+        server = std::make_unique<RenderServer>(config_args.server_socket);
+        // idle until the first job arrives
+        target_spp = 0;
+        done_accumulating = true;
     }
 
     send_launch_signal(0);
@@ -266,7 +303,7 @@ bool BasicApplicationState::request_new_frame() {
 
     bool new_frame = false;
 
-    if (validation_mode) {
+    if (validation_mode || server_mode) {
         // In validation mode, we render at a fixed time.
         // TODO: Support seeking in time and a validation time command line
         //       switch.
@@ -293,20 +330,21 @@ void BasicApplicationState::progress_time()
     double next_real_time = shell.get_time();
     delta_real_time = next_real_time - last_real_time;
 
-    if (validation_mode) {
+    if (validation_mode || server_mode) {
         // In validation mode, we render at a fixed time.
         delta_time = 0.0f;
     }
     else if (profiling_mode) {
         // In profiling mode, time progresses at a fixed, non-realtime
-        // framerate.
+        // framerate. Multiply instead of accumulating, such that frame times
+        // do not drift and match between runs of different lengths.
         delta_time = profiling_delta_time;
-        current_time += profiling_delta_time;
+        current_time = double(++fixed_step_index) * profiling_delta_time;
     }
     else if (data_capture_mode) {
         if (frame_ready) {
             delta_time = data_capture_delta_time;
-            current_time += data_capture_delta_time;
+            current_time = double(++fixed_step_index) * data_capture_delta_time;
             if (done_accumulating)
                 reset_render();
         } else {
@@ -321,6 +359,15 @@ void BasicApplicationState::progress_time()
     last_real_time = next_real_time;
 }
 
+void BasicApplicationState::skip_frame()
+{
+    // the sequence ends as if the frame had been rendered
+    if (ImState::LastKeyframeComingUp(current_time + data_capture_delta_time))
+        done = true;
+    delta_time = data_capture_delta_time;
+    current_time = double(++fixed_step_index) * data_capture_delta_time;
+}
+
 void BasicApplicationState::handle_shell_updates(Shell& shell)
 {
     done |= shell.wants_quit;
@@ -388,7 +435,8 @@ bool BasicApplicationState::save_framebuffer_pfm(const char *prefix,
 }
 
 bool BasicApplicationState::save_framebuffer_exr(const char *prefix,
-    RenderBackend *renderer, ExrCompression compression)
+    RenderBackend *renderer, ExrCompression compression,
+    std::vector<unsigned char> *encoded)
 {
     glm::uvec3 fbSize = renderer->get_framebuffer_size();
     const size_t bufferSize = fbSize.x * static_cast<size_t>(fbSize.y) * fbSize.z;
@@ -408,7 +456,10 @@ bool BasicApplicationState::save_framebuffer_exr(const char *prefix,
 
     BasicProfilingScope saveScope;
     saveScope.begin();
-    const bool written = WriteImage::write_exr(prefix, fbSize.x, fbSize.y, fbSize.z,
+    const bool written = encoded
+        ? WriteImage::encode_exr(*encoded, fbSize.x, fbSize.y, fbSize.z,
+            readback_buffer_float.data(), compression)
+        : WriteImage::write_exr(prefix, fbSize.x, fbSize.y, fbSize.z,
             readback_buffer_float.data(), compression);
     saveScope.end();
 
@@ -440,7 +491,7 @@ bool BasicApplicationState::save_framebuffer(const char *prefix, RenderBackend *
 
 bool BasicApplicationState::save_aov_exr(const char *prefix,
         RenderBackend *renderer, RenderGraphic::AOVBufferIndex aovIndex,
-        ExrCompression compression)
+        ExrCompression compression, std::vector<unsigned char> *encoded)
 {
     const glm::uvec3 fbSize = renderer->get_framebuffer_size();
     const size_t bufferSize = fbSize.x * static_cast<size_t>(fbSize.y) * fbSize.z;
@@ -454,9 +505,13 @@ bool BasicApplicationState::save_aov_exr(const char *prefix,
 
     BasicProfilingScope saveScope;
     saveScope.begin();
-    const bool written = WriteImage::write_exr(prefix,
-        fbSize.x, fbSize.y, fbSize.z, readback_buffer_half.data(),
-        compression);
+    const bool written = encoded
+        ? WriteImage::encode_exr(*encoded,
+            fbSize.x, fbSize.y, fbSize.z, readback_buffer_half.data(),
+            compression)
+        : WriteImage::write_exr(prefix,
+            fbSize.x, fbSize.y, fbSize.z, readback_buffer_half.data(),
+            compression);
     saveScope.end();
     return available && written;
 }
@@ -481,7 +536,15 @@ void BasicApplicationState::handle_mode_actions(const Shell &shell,
     }
     else if (profiling_mode)
     {
-        if (!profiling_img_prefix.empty()
+        if (!profiling_img_prefix.empty() && profiling_img_every_frame)
+        {
+            std::ostringstream os;
+            os << profiling_img_prefix << "_"
+               << std::setw(5) << std::setfill('0')
+               << fixed_step_index;
+            save_framebuffer(os.str().c_str(), renderer, EXR_COMPRESSION_NONE);
+        }
+        else if (!profiling_img_prefix.empty()
          // In profiling mode, limit writing to once per second (at the end of the keyframe).
          && (current_time + profiling_delta_time) >= std::ceil(current_time))
         {
@@ -505,22 +568,31 @@ void BasicApplicationState::handle_mode_actions(const Shell &shell,
                << std::setw(4) << std::setfill('0')
                << ImState::CurrentKeyframe()+1;
             const std::string pf = os.str();
+            // distributed workers stage their images, which the coordinator moves to pf
+            if (distributed_worker.active())
+                distributed_staging.begin_frame(fixed_step_index);
+            auto output = [&](char const* suffix) {
+                std::string prefix = pf + suffix;
+                return distributed_worker.active() ? distributed_staging.staged_prefix(prefix) : prefix;
+            };
 
             if (data_capture.rgba) {
-                save_framebuffer((pf + "_rgba").c_str(), renderer, EXR_COMPRESSION_NONE);
+                save_framebuffer(output("_rgba").c_str(), renderer, EXR_COMPRESSION_NONE);
             }
             if (data_capture.albedo_roughness) {
-                save_aov_exr((pf + "_albedo_roughness").c_str(), renderer,
+                save_aov_exr(output("_albedo_roughness").c_str(), renderer,
                     RenderGraphic::AOVAlbedoRoughnessIndex, EXR_COMPRESSION_NONE);
             }
             if (data_capture.normal_depth) {
-                save_aov_exr((pf + "_normal_depth").c_str(), renderer,
+                save_aov_exr(output("_normal_depth").c_str(), renderer,
                     RenderGraphic::AOVNormalDepthIndex, EXR_COMPRESSION_NONE);
             }
             if (data_capture.motion) {
-                save_aov_exr((pf + "_motion_jitter").c_str(), renderer,
+                save_aov_exr(output("_motion_jitter").c_str(), renderer,
                     RenderGraphic::AOVMotionJitterIndex, EXR_COMPRESSION_NONE);
             }
+            if (distributed_worker.active())
+                distributed_staging.commit_frame();
 
             if (ImState::LastKeyframeComingUp(current_time + data_capture_delta_time))
             {
@@ -528,12 +600,61 @@ void BasicApplicationState::handle_mode_actions(const Shell &shell,
             }
         }
     }
+    else if (server_mode)
+    {
+        if (server_job_active && done_accumulating)
+            finish_server_job(renderer);
+    }
     else
     {
         track_file_change(shell);
     }
 }
 
+void BasicApplicationState::begin_server_job(RenderServer::QueuedJob const& job)
+{
+    server_job = job;
+    server_job_active = true;
+    server_job_start_time = shell.get_time();
+    target_spp = std::max(job.job.target_spp, 1);
+    renderer_changed = true;
+}
+
+void BasicApplicationState::finish_server_job(RenderBackend *renderer)
+{
+    static char const* const aov_names[] = { RENDER_SERVER_AOV_NAMES };
+    static const RenderGraphic::AOVBufferIndex aov_indices[] = {
+        RenderGraphic::AOVAlbedoRoughnessIndex,
+        RenderGraphic::AOVNormalDepthIndex,
+        RenderGraphic::AOVMotionJitterIndex
+    };
+
+    RenderJobResult result;
+    result.id = server_job.job.id;
+    result.success = true;
+    for (int i = 0; i < (int) RENDER_SERVER_AOV_COUNT; ++i) {
+        if (!(server_job.job.aovs & (1u << i)))
+            continue;
+        std::vector<unsigned char> exr;
+        bool encoded = i == 0
+            ? save_framebuffer_exr(nullptr, renderer, EXR_COMPRESSION_NONE, &exr)
+            : save_aov_exr(nullptr, renderer, aov_indices[i - 1], EXR_COMPRESSION_NONE, &exr);
+        if (!encoded) {
+            result.success = false;
+            result.error += std::string(result.error.empty() ? "" : ", ") + "no " + aov_names[i] + " output";
+            continue;
+        }
+        result.images.push_back({ aov_names[i], std::move(exr) });
+    }
+    println(CLL::INFORMATION, "Render job %llu: %d spp in %.1f ms"
+        , (unsigned long long) result.id, accumulated_spp
+        , 1000.0 * (shell.get_time() - server_job_start_time));
+    server->send_result(server_job.connection, result);
+
+    server_job_active = false;
+    target_spp = 0;
+}
+
 void BasicApplicationState::track_file_change(const Shell &shell)
 {
     if (!change_tracking_file || !interactive())
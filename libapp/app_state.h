@@ -10,6 +10,8 @@
 #include "shell.h"
 #include "util.h"
 #include "benchmark_info.h"
+#include "frame_time_controller.h"
+#include "render_server.h"
 #include <memory>
 #include <vector>
 
@@ -28,6 +30,7 @@ struct BasicApplicationState {
     float delta_time = 0.0f;
     double last_time = 0;
     double current_time = 0; // May or may not be real-time depending on the mode.
+    uint64_t fixed_step_index = 0; // frames advanced in fixed-step modes, current_time = index * step
 
     bool pause_rendering = false;
     bool continuous_restart = false;
@@ -40,17 +43,31 @@ struct BasicApplicationState {
     bool freeze_frame = false;
     bool synchronous_rendering = false;
 
+    // adapts batch spp and upscale factor to a target frame time, interactive mode only
+    FrameTimeController frame_time_controller;
+
     bool validation_mode = false;
     std::string validation_img_prefix;
 
     bool profiling_mode = false;
     std::string profiling_img_prefix;
+    bool profiling_img_every_frame = false;
     std::string profiling_csv_prefix;
     float profiling_delta_time = 1.f/60.f;
 
     bool data_capture_mode = false;
     float data_capture_delta_time = 1.f/60.f;
     DataCaptureConfig data_capture;
+    // frames rendered by this process if it is a distributed worker, and their staged images
+    DistributedWorkerArgs distributed_worker;
+    DistributedFrameStaging distributed_staging;
+
+    bool server_mode = false;
+    std::unique_ptr<RenderServer> server;
+    // the job being accumulated, if any, its result is sent once done accumulating
+    RenderServer::QueuedJob server_job;
+    bool server_job_active = false;
+    double server_job_start_time = 0.0;
 
     // Set to true when we are done rendering.
     bool done = false;
@@ -65,7 +82,7 @@ struct BasicApplicationState {
     const char *change_tracking_file;
 
     bool interactive() const {
-        return !validation_mode && !profiling_mode && !data_capture_mode;
+        return !validation_mode && !profiling_mode && !data_capture_mode && !server_mode;
     }
 
     // The main state update, used both for serialization and UI.
@@ -83,6 +100,12 @@ struct BasicApplicationState {
     void handle_shell_updates(Shell& shell);
     void reset_render();
     void handle_mode_actions(const Shell &shell, RenderBackend* renderer);
+    // accumulates the given job until its target spp is reached
+    void begin_server_job(RenderServer::QueuedJob const& job);
+
+    // distributed workers advance over the frames of other workers without rendering them
+    bool skips_frame() const { return data_capture_mode && !distributed_worker.renders_frame(fixed_step_index); }
+    void skip_frame();
 
     bool needs_rerender() const { return renderer_changed || (!pause_rendering && continuous_restart && done_accumulating); }
     bool needs_render() const { return !pause_rendering && !done_accumulating; }
@@ -107,11 +130,15 @@ struct BasicApplicationState {
             ExrCompression compression);
         bool save_framebuffer_png(const char *prefix, RenderBackend *renderer);
         bool save_framebuffer_pfm(const char *prefix, RenderBackend *renderer);
+        // encodes into the given buffer instead of writing prefix.exr, if any
         bool save_framebuffer_exr(const char *prefix, RenderBackend *renderer,
-                ExrCompression compression);
+                ExrCompression compression,
+                std::vector<unsigned char> *encoded = nullptr);
         bool save_aov_exr(const char *prefix, RenderBackend *renderer,
                 RenderGraphic::AOVBufferIndex aovIndex,
-                ExrCompression compression);
+                ExrCompression compression,
+                std::vector<unsigned char> *encoded = nullptr);
+        void finish_server_job(RenderBackend *renderer);
 
         std::vector<float>         readback_buffer_float;
         std::vector<uint16_t>      readback_buffer_half;
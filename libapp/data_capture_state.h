@@ -14,6 +14,7 @@
 
 #include "libdatacapture/pois.h"
 #include "libdatacapture/viewpoints.h"
+#include "libdatacapture/scene_raytracer.h"
 
 struct DataCaptureTools {
     rt_datacapture::RandomSampler capture_rng;
@@ -25,7 +26,10 @@ struct DataCaptureTools {
     DataCaptureTools(RenderBackend* renderer) {
        raytracer = dynamic_cast<RaytraceBackend*>(renderer);
        if (!raytracer) {
-            assert(false);
+            // no render backend implements RaytraceBackend (the Vulkan ray query program only
+            // returns barycentrics and primitive ids), trace capture rays on the CPU instead
+            aux_raytracer.reset(new rt_datacapture::SceneRaytracer());
+            raytracer = aux_raytracer.get();
        }
     }
 
@@ -53,7 +57,7 @@ struct DataCaptureState {
                 rt_datacapture::collect_visible_points(*capture_tools.raytracer, poi_source, pois.data() + poi_cursor, num_pois_per_perspective);
                 poi_cursor += num_pois_per_perspective;
             }
-            poi_cursor = rt_datacapture::prune_pois(*capture_tools.raytracer, pois.data(), (int) pois.size(), capture_tools.capture_rng);
+            poi_cursor = rt_datacapture::prune_pois(pois.data(), (int) pois.size(), capture_tools.capture_rng);
             pois.resize(poi_cursor);
         }
         bool add_perspective = false;
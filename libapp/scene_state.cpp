@@ -70,7 +70,10 @@ void imstate_scene_loader_parameters(SceneLoaderParams& params, const std::vecto
         IMGUI_STATE1(ImGui::Checkbox, "ignore textures", &per_file.ignore_textures);
         IMGUI_STATE1(ImGui::Checkbox, "ignore animation", &per_file.ignore_animation);
         IMGUI_STATE1(ImGui::Checkbox, "merge partition instances", &per_file.merge_partition_instances);
+        IMGUI_STATE1(ImGui::DragFloat, "merge transform epsilon", &per_file.merge_transform_epsilon);
         IMGUI_STATE1(ImGui::Checkbox, "load specularity", &per_file.load_specularity);
+        IMGUI_STATE1(ImGui::Checkbox, "sort triangles by material", &per_file.sort_triangles_by_material);
+        IMGUI_STATE1(ImGui::DragFloat, "split triangle area ratio", &per_file.split_triangle_area_ratio);
     }
     ImState::EndRead();
 }
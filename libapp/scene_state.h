@@ -98,6 +98,8 @@ struct BasicSceneState {
 
         if (IMGUI_STATE_BEGIN_HEADER(ImGui::CollapsingHeader, "Scene", &scene_config.bump_scale, ImGuiTreeNodeFlags_DefaultOpen)) {
             scene_changed |= IMGUI_STATE(ImGui::SliderFloat, "bump scale", &scene_config.bump_scale, 0.5f, 10.0f);
+            scene_changed |= IMGUI_STATE(ImGui::SliderFloat, "environment intensity", &scene_config.environment_intensity, 0.0f, 10.0f);
+            scene_changed |= IMGUI_STATE(ImGui::SliderFloat, "environment rotation", &scene_config.environment_rotation, -180.0f, 180.0f);
 
             IMGUI_STATE_END_HEADER(&scene_config.bump_scale);
         }
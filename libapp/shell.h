@@ -11,6 +11,8 @@
 #include "util/display/render_graphic.h"
 #include "util/write_image.h"
 #include "util.h"
+#include "camera_path.h"
+#include "distributed_render.h"
 
 #include "imgui.h"
 #include "imstate.h"
@@ -60,6 +62,7 @@ struct Shell {
         glm::vec3 up = glm::vec3(0, 1, 0);
         float fov_y = 65.f;
         size_t camera_id = 0;
+        std::string camera_path_file;
 
         bool disable_ui = false;
         bool freeze_frame = false;
@@ -68,6 +71,11 @@ struct Shell {
         int fixed_resolution_x = 0;
         int fixed_resolution_y = 0;
         int fixed_upscale_factor = 0;
+        float target_frame_time_ms = 0.0f;
+
+        // coordinator: number of worker processes, worker: assigned frames
+        int distributed_workers = 0;
+        DistributedWorkerArgs distributed_worker;
 
         OutputImageFormat image_format { OUTPUT_IMAGE_FORMAT_EXR };
 
@@ -83,6 +91,7 @@ struct Shell {
         bool profiling_mode = false;
         std::string profiling_csv_prefix;
         std::string profiling_img_prefix;
+        bool profiling_img_every_frame = false;
         float profiling_fps = 60.f;
 
         // Data capture mode is designed for generating training data for
@@ -91,11 +100,17 @@ struct Shell {
         bool data_capture_mode = false;
         DataCaptureConfig data_capture;
 
+        // Server mode renders jobs received on a local socket, keeping the
+        // backend and scene resident in between.
+        bool server_mode = false;
+        std::string server_socket;
+
         // Data that can be required by extensions (post process for instance
         std::string resource_dir = rooted_path("resources");
     };
 
     DefaultArgs cmdline_args;
+    CameraPath camera_path; // loaded from cmdline_args.camera_path_file, if any
     int render_width = 0, display_width = 0;
     int render_height = 0, display_height = 0;
     int render_upscale_factor = 1;
@@ -0,0 +1,239 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "pois.h"
+#include "parallel.h"
+#include "types.h"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace rt_datacapture {
+
+namespace {
+
+// directions that miss all geometry are retried this many times
+int const POI_SAMPLING_ROUNDS = 4;
+
+struct CellKey {
+    int x, y, z;
+    bool operator==(CellKey const& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+struct CellKeyHash {
+    size_t operator()(CellKey const& key) const {
+        uint64_t h = uint64_t(uint32_t(key.x)) * 0x9e3779b97f4a7c15ull;
+        h ^= uint64_t(uint32_t(key.y)) * 0xc2b2ae3d27d4eb4full + (h >> 29);
+        h ^= uint64_t(uint32_t(key.z)) * 0x165667b19e3779f9ull + (h >> 32);
+        return size_t(h);
+    }
+};
+
+CellKey cell_of(glm::vec3 pos, float inv_cell_size) {
+    auto coord = [](float v) {
+        return int(std::min(std::max(std::floor(v), -1.e9f), 1.e9f));
+    };
+    return { coord(pos.x * inv_cell_size), coord(pos.y * inv_cell_size), coord(pos.z * inv_cell_size) };
+}
+
+// open-addressing hash map from cells to their index, built once and then only read concurrently
+struct CellTable {
+    std::vector<CellKey> keys;
+    std::vector<int> values;
+    size_t mask = 0;
+
+    explicit CellTable(int count) {
+        size_t capacity = 16;
+        while (capacity < 2 * size_t(count))
+            capacity *= 2;
+        keys.resize(capacity);
+        values.resize(capacity, -1);
+        mask = capacity - 1;
+    }
+    void insert(CellKey const& key, int value) {
+        size_t slot = CellKeyHash()(key) & mask;
+        while (values[slot] >= 0)
+            slot = (slot + 1) & mask;
+        keys[slot] = key;
+        values[slot] = value;
+    }
+    int find(CellKey const& key) const {
+        for (size_t slot = CellKeyHash()(key) & mask; values[slot] >= 0; slot = (slot + 1) & mask) {
+            if (keys[slot] == key)
+                return values[slot];
+        }
+        return -1;
+    }
+};
+
+// cells of equal phase are never adjacent, such that they can be processed concurrently
+int cell_phase(CellKey const& key) {
+    auto mod3 = [](int v) { return (v % 3 + 3) % 3; };
+    return mod3(key.x) + 3 * mod3(key.y) + 9 * mod3(key.z);
+}
+
+} // namespace
+
+int collect_visible_points(RaytraceBackend& raytracer, glm::vec3 source, Poi* pois, int num_pois
+    , uint64_t seed, float max_distance) {
+    if (num_pois <= 0)
+        return 0;
+
+    // stratify directions over a grid on the unit square that is mapped to the sphere,
+    // unused cells of the last row are spread evenly over the grid
+    int grid_x = std::max(int(std::ceil(std::sqrt(double(num_pois)))), 1);
+    int grid_y = (num_pois + grid_x - 1) / grid_x;
+    int64_t cell_count = int64_t(grid_x) * grid_y;
+
+    std::vector<int> pending(num_pois);
+    std::iota(pending.begin(), pending.end(), 0);
+    std::vector<RayQuery> queries(std::min(num_pois, POI_QUERY_BATCH_SIZE));
+    std::vector<float> hit_t(queries.size());
+    std::vector<glm::vec3> hit_normal(queries.size());
+    RaytraceResults results;
+    results.hit_t = hit_t.data();
+    results.hit_normal = hit_normal.data();
+
+    for (int round = 0; round < POI_SAMPLING_ROUNDS && !pending.empty(); ++round) {
+        for (int batch_begin = 0; batch_begin < ilen(pending); batch_begin += POI_QUERY_BATCH_SIZE) {
+            int batch_size = std::min(ilen(pending) - batch_begin, POI_QUERY_BATCH_SIZE);
+            int const* batch_pois = pending.data() + batch_begin;
+
+            parallel_for(batch_size, [&](int i) {
+                int poi_idx = batch_pois[i];
+                RandomSampler rng(seed + uint64_t(round), uint64_t(poi_idx));
+                int64_t cell = int64_t(poi_idx) * cell_count / num_pois;
+                glm::vec2 jitter = rng.next_vec2();
+                glm::vec2 u(
+                    (float(cell % grid_x) + jitter.x) / float(grid_x),
+                    (float(cell / grid_x) + jitter.y) / float(grid_y));
+                RayQuery& query = queries[i];
+                query.origin = source;
+                query.mode_or_data = poi_idx;
+                query.dir = square_to_sphere(u);
+                query.t_max = max_distance;
+            }, 0, 256);
+
+            raytracer.trace_ray(queries.data(), batch_size, results);
+
+            parallel_for(batch_size, [&](int i) {
+                Poi& poi = pois[batch_pois[i]];
+                if (hit_t[i] >= 0.0f) {
+                    poi.pos = source + queries[i].dir * hit_t[i];
+                    poi.normal = hit_normal[i];
+                    poi.distance = hit_t[i];
+                }
+                else {
+                    poi.pos = source;
+                    poi.normal = glm::vec3(0.0f);
+                    poi.distance = -1.0f;
+                }
+            }, 0, 256);
+        }
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [pois](int poi_idx) {
+            return pois[poi_idx].valid();
+        }), pending.end());
+    }
+    return num_pois - ilen(pending);
+}
+
+int prune_pois(Poi* pois, int num_pois, RandomSampler& rng, float min_spacing) {
+    int valid_count = int(std::remove_if(pois, pois + num_pois, [](Poi const& poi) { return !poi.valid(); }) - pois);
+    if (valid_count <= 1)
+        return valid_count;
+
+    if (!(min_spacing > 0.0f)) {
+        // spacing of as many samples spread uniformly over a sphere at the median POI distance
+        std::vector<float> distances(valid_count);
+        for (int i = 0; i < valid_count; ++i)
+            distances[i] = pois[i].distance;
+        std::nth_element(distances.begin(), distances.begin() + valid_count / 2, distances.end());
+        min_spacing = distances[valid_count / 2] * std::sqrt(4.0f * PI / float(valid_count));
+        if (!(min_spacing > 0.0f))
+            return valid_count;
+    }
+    float inv_cell_size = 1.0f / min_spacing;
+
+    // parallel dart throwing: candidates are bucketed into a spatial hash with cells the size of
+    // the minimum spacing, cells of one phase are processed concurrently in random priority order
+    struct Candidate {
+        CellKey cell;
+        int phase;
+        uint32_t priority;
+        int poi;
+    };
+    std::vector<Candidate> candidates(valid_count);
+    for (int i = 0; i < valid_count; ++i)
+        candidates[i].priority = rng.next_uint();
+    parallel_for(valid_count, [&](int i) {
+        candidates[i].cell = cell_of(pois[i].pos, inv_cell_size);
+        candidates[i].phase = cell_phase(candidates[i].cell);
+        candidates[i].poi = i;
+    }, 0, 1024);
+    std::sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) {
+        if (a.phase != b.phase) return a.phase < b.phase;
+        if (a.cell.x != b.cell.x) return a.cell.x < b.cell.x;
+        if (a.cell.y != b.cell.y) return a.cell.y < b.cell.y;
+        if (a.cell.z != b.cell.z) return a.cell.z < b.cell.z;
+        if (a.priority != b.priority) return a.priority < b.priority;
+        return a.poi < b.poi;
+    });
+
+    // cell ranges in the sorted candidate list, grouped by phase
+    std::vector<int> cell_begin;
+    std::vector<int> phase_begin(28, 0);
+    for (int i = 0; i < valid_count; ++i) {
+        if (i == 0 || !(candidates[i].cell == candidates[i - 1].cell))
+            cell_begin.push_back(i);
+        phase_begin[candidates[i].phase + 1] = ilen(cell_begin);
+    }
+    CellTable cell_index(ilen(cell_begin));
+    for (int cell = 0; cell < ilen(cell_begin); ++cell)
+        cell_index.insert(candidates[cell_begin[cell]].cell, cell);
+    cell_begin.push_back(valid_count);
+    for (int p = 1; p < 28; ++p)
+        phase_begin[p] = std::max(phase_begin[p], phase_begin[p - 1]);
+
+    std::vector<char> keep(valid_count, 0);
+    float min_spacing_sq = min_spacing * min_spacing;
+    for (int phase = 0; phase < 27; ++phase) {
+        parallel_for(phase_begin[phase + 1] - phase_begin[phase], [&](int phase_cell) {
+            int cell = phase_begin[phase] + phase_cell;
+            for (int c = cell_begin[cell]; c < cell_begin[cell + 1]; ++c) {
+                Poi const& poi = pois[candidates[c].poi];
+                CellKey key = candidates[c].cell;
+                bool conflict = false;
+                for (int dz = -1; dz <= 1 && !conflict; ++dz)
+                for (int dy = -1; dy <= 1 && !conflict; ++dy)
+                for (int dx = -1; dx <= 1 && !conflict; ++dx) {
+                    int neighbor = cell_index.find(CellKey{ key.x + dx, key.y + dy, key.z + dz });
+                    if (neighbor < 0)
+                        continue;
+                    for (int n = cell_begin[neighbor], ne = cell_begin[neighbor + 1]; n < ne; ++n) {
+                        if (!keep[n])
+                            continue;
+                        Poi const& kept = pois[candidates[n].poi];
+                        glm::vec3 delta = kept.pos - poi.pos;
+                        // surfaces facing away from each other (e.g. both sides of thin walls) do not compete
+                        if (glm::dot(delta, delta) < min_spacing_sq && glm::dot(kept.normal, poi.normal) > 0.0f) {
+                            conflict = true;
+                            break;
+                        }
+                    }
+                }
+                keep[c] = !conflict;
+            }
+        }, 0, 16);
+    }
+
+    std::vector<char> keep_poi(valid_count, 0);
+    for (int c = 0; c < valid_count; ++c)
+        keep_poi[candidates[c].poi] = keep[c];
+    int kept_count = 0;
+    for (int i = 0; i < valid_count; ++i) {
+        if (keep_poi[i])
+            pois[kept_count++] = pois[i];
+    }
+    return kept_count;
+}
+
+} // namespace
@@ -0,0 +1,34 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "raytrace.h"
+#include "sampling.h"
+
+namespace rt_datacapture {
+
+// point of interest on a visible surface
+struct Poi {
+    glm::vec3 pos;
+    glm::vec3 normal;
+    float distance = -1.0f; // distance to the source it was seen from, negative if invalid
+    bool valid() const { return distance >= 0.0f; }
+};
+
+// number of ray queries handed to the ray tracing backend at once
+int const POI_QUERY_BATCH_SIZE = 1 << 14;
+
+// Fills pois with points visible from source, sampled along stratified directions over
+// the sphere. Directions that miss all geometry are retried with fresh jitter a few times,
+// remaining misses stay invalid. Results only depend on the seed, not on the thread count.
+// Returns the number of valid POIs.
+int collect_visible_points(RaytraceBackend& raytracer, glm::vec3 source, Poi* pois, int num_pois
+    , uint64_t seed = 0, float max_distance = 1.e32f);
+
+// Removes invalid POIs and thins out the remaining ones such that no two are closer than
+// min_spacing (0 = derived from the POI distances), keeping a random subset in densely
+// sampled regions. Compacts the POIs in place and returns their new count.
+int prune_pois(Poi* pois, int num_pois, RandomSampler& rng, float min_spacing = 0.0f);
+
+} // namespace
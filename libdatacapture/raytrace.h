@@ -0,0 +1,30 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace rt_datacapture {
+
+// closest-hit query, laid out like RenderRayQuery for direct upload to GPU query buffers
+struct RayQuery {
+    glm::vec3 origin;
+    int mode_or_data = 0;
+    glm::vec3 dir;
+    float t_max;
+};
+
+// optional per-query outputs of RaytraceBackend::trace_ray, null arrays are not written
+struct RaytraceResults {
+    float* hit_t = nullptr; // distance to the closest hit in units of the query direction, negative on miss
+    glm::vec3* hit_normal = nullptr; // normalized geometric normal, facing against the query direction
+};
+
+struct RaytraceBackend {
+    virtual ~RaytraceBackend() { }
+    // traces a batch of queries, returns the number of queries that hit geometry
+    virtual int trace_ray(RayQuery* queries, int num_queries, RaytraceResults aux_results) = 0;
+};
+
+} // namespace
@@ -0,0 +1,62 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace rt_datacapture {
+
+// PCG32 generator, independent streams allow deterministic results under parallel sampling
+struct RandomSampler {
+    uint64_t state = 0;
+    uint64_t increment = 1;
+
+    explicit RandomSampler(uint64_t seed = 0x853c49e6748fea9bull, uint64_t stream = 0xda3e39cb94b95bdbull) {
+        increment = (stream << 1u) | 1u;
+        next_uint();
+        state += seed;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old_state = state;
+        state = old_state * 6364136223846793005ull + increment;
+        uint32_t xorshifted = uint32_t(((old_state >> 18u) ^ old_state) >> 27u);
+        uint32_t rot = uint32_t(old_state >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+    // uniform in [0, 1)
+    float next_float() {
+        return float(next_uint() >> 8) * (1.0f / 16777216.0f);
+    }
+    glm::vec2 next_vec2() {
+        float x = next_float();
+        return glm::vec2(x, next_float());
+    }
+};
+
+float const PI = 3.14159265358979323846f;
+
+// equal-area mapping of the unit square to the unit sphere
+inline glm::vec3 square_to_sphere(glm::vec2 u) {
+    float z = 1.0f - 2.0f * u.x;
+    float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = 2.0f * PI * u.y;
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// cosine-weighted hemisphere around the given unit normal
+inline glm::vec3 square_to_cosine_hemisphere(glm::vec2 u, glm::vec3 n) {
+    float r = std::sqrt(u.x);
+    float phi = 2.0f * PI * u.y;
+    glm::vec3 t = std::abs(n.x) > 0.5f ? glm::vec3(n.y, -n.x, 0.0f) : glm::vec3(0.0f, n.z, -n.y);
+    t = glm::normalize(t);
+    glm::vec3 b = glm::cross(n, t);
+    return r * std::cos(phi) * t + r * std::sin(phi) * b + std::sqrt(std::max(0.0f, 1.0f - u.x)) * n;
+}
+
+} // namespace
@@ -0,0 +1,358 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "scene_raytracer.h"
+#include "parallel.h"
+#include "types.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <numeric>
+
+namespace rt_datacapture {
+
+namespace {
+
+int const BVH_BIN_COUNT = 16;
+int const BVH_MAX_DEPTH = 64;
+
+float half_area(glm::vec3 lower, glm::vec3 upper) {
+    glm::vec3 e = glm::max(upper - lower, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+    glm::vec3 inv_dir;
+
+    Ray(glm::vec3 origin, glm::vec3 dir)
+        : origin(origin), dir(dir) {
+        // avoid NaNs in slab tests for axis-aligned directions
+        for (int i = 0; i < 3; ++i)
+            inv_dir[i] = 1.0f / (dir[i] != 0.0f ? dir[i] : 1.e-30f);
+    }
+};
+
+bool intersect_box(Bvh::Node const& node, Ray const& ray, float t_max, float& t_entry) {
+    glm::vec3 t0 = (node.lower - ray.origin) * ray.inv_dir;
+    glm::vec3 t1 = (node.upper - ray.origin) * ray.inv_dir;
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far = glm::max(t0, t1);
+    t_entry = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+    float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, t_max));
+    return t_entry <= t_exit;
+}
+
+// Moeller-Trumbore, returns the hit distance or a negative value
+float intersect_triangle(Ray const& ray, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, float t_max) {
+    glm::vec3 e1 = v1 - v0;
+    glm::vec3 e2 = v2 - v0;
+    glm::vec3 p = glm::cross(ray.dir, e2);
+    float det = glm::dot(e1, p);
+    if (det == 0.0f)
+        return -1.0f;
+    float inv_det = 1.0f / det;
+    glm::vec3 s = ray.origin - v0;
+    float u = glm::dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(ray.dir, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+    float t = glm::dot(e2, q) * inv_det;
+    return (t > 0.0f && t < t_max) ? t : -1.0f;
+}
+
+// calls leaf_fn(primitive, t_max) for all leaves overlapping the ray, nearest child first
+template <class LeafFn>
+void traverse(Bvh const& bvh, Ray const& ray, float& t_max, LeafFn&& leaf_fn) {
+    if (bvh.nodes.empty())
+        return;
+    float t_entry;
+    if (!intersect_box(bvh.nodes[0], ray, t_max, t_entry))
+        return;
+    int stack[BVH_MAX_DEPTH + 1];
+    int stack_size = 0;
+    int node_idx = 0;
+    while (true) {
+        Bvh::Node const& node = bvh.nodes[node_idx];
+        if (node.count > 0) {
+            for (int i = node.first, ie = node.first + node.count; i < ie; ++i)
+                leaf_fn(bvh.primitives[i], t_max);
+        }
+        else {
+            float t_left, t_right;
+            bool hit_left = intersect_box(bvh.nodes[node.first], ray, t_max, t_left);
+            bool hit_right = intersect_box(bvh.nodes[node.first + 1], ray, t_max, t_right);
+            if (hit_left && hit_right) {
+                bool left_first = t_left <= t_right;
+                stack[stack_size++] = left_first ? node.first + 1 : node.first;
+                node_idx = left_first ? node.first : node.first + 1;
+                continue;
+            }
+            if (hit_left || hit_right) {
+                node_idx = hit_left ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (stack_size == 0)
+            break;
+        node_idx = stack[--stack_size];
+    }
+}
+
+} // namespace
+
+void Bvh::build(std::vector<glm::vec3> const& lower, std::vector<glm::vec3> const& upper, int max_leaf_size) {
+    int count = ilen(lower);
+    nodes.clear();
+    primitives.resize(count);
+    std::iota(primitives.begin(), primitives.end(), 0);
+    if (count == 0)
+        return;
+
+    std::vector<glm::vec3> centroids(count);
+    for (int i = 0; i < count; ++i)
+        centroids[i] = 0.5f * (lower[i] + upper[i]);
+
+    struct Task {
+        int node, begin, end, depth;
+    };
+    std::vector<Task> tasks;
+    nodes.reserve(2 * size_t(count));
+    nodes.push_back(Node());
+    tasks.push_back({ 0, 0, count, 0 });
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        glm::vec3 node_lower(FLT_MAX), node_upper(-FLT_MAX);
+        glm::vec3 centroid_lower(FLT_MAX), centroid_upper(-FLT_MAX);
+        for (int i = task.begin; i < task.end; ++i) {
+            int p = primitives[i];
+            node_lower = glm::min(node_lower, lower[p]);
+            node_upper = glm::max(node_upper, upper[p]);
+            centroid_lower = glm::min(centroid_lower, centroids[p]);
+            centroid_upper = glm::max(centroid_upper, centroids[p]);
+        }
+        nodes[task.node].lower = node_lower;
+        nodes[task.node].upper = node_upper;
+
+        int task_count = task.end - task.begin;
+        if (task_count <= max_leaf_size || task.depth >= BVH_MAX_DEPTH) {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = task_count;
+            continue;
+        }
+
+        glm::vec3 centroid_extent = centroid_upper - centroid_lower;
+        int axis = 0;
+        if (centroid_extent.y > centroid_extent[axis]) axis = 1;
+        if (centroid_extent.z > centroid_extent[axis]) axis = 2;
+
+        int mid = task.begin + task_count / 2;
+        if (centroid_extent[axis] > 0.0f) {
+            struct Bin {
+                glm::vec3 lower = glm::vec3(FLT_MAX), upper = glm::vec3(-FLT_MAX);
+                int count = 0;
+            } bins[BVH_BIN_COUNT];
+            float bin_scale = float(BVH_BIN_COUNT) / centroid_extent[axis];
+            auto bin_of = [&](int p) {
+                return std::min(int((centroids[p][axis] - centroid_lower[axis]) * bin_scale), BVH_BIN_COUNT - 1);
+            };
+            for (int i = task.begin; i < task.end; ++i) {
+                int p = primitives[i];
+                Bin& bin = bins[bin_of(p)];
+                bin.lower = glm::min(bin.lower, lower[p]);
+                bin.upper = glm::max(bin.upper, upper[p]);
+                ++bin.count;
+            }
+            // sweep from the right to get the cost of all right partitions
+            float right_cost[BVH_BIN_COUNT];
+            glm::vec3 sweep_lower(FLT_MAX), sweep_upper(-FLT_MAX);
+            int sweep_count = 0;
+            for (int b = BVH_BIN_COUNT - 1; b > 0; --b) {
+                sweep_lower = glm::min(sweep_lower, bins[b].lower);
+                sweep_upper = glm::max(sweep_upper, bins[b].upper);
+                sweep_count += bins[b].count;
+                right_cost[b] = sweep_count ? half_area(sweep_lower, sweep_upper) * float(sweep_count) : 0.0f;
+            }
+            int best_split = 1;
+            float best_cost = FLT_MAX;
+            sweep_lower = glm::vec3(FLT_MAX);
+            sweep_upper = glm::vec3(-FLT_MAX);
+            sweep_count = 0;
+            for (int b = 1; b < BVH_BIN_COUNT; ++b) {
+                sweep_lower = glm::min(sweep_lower, bins[b - 1].lower);
+                sweep_upper = glm::max(sweep_upper, bins[b - 1].upper);
+                sweep_count += bins[b - 1].count;
+                float cost = (sweep_count ? half_area(sweep_lower, sweep_upper) * float(sweep_count) : 0.0f) + right_cost[b];
+                if (sweep_count > 0 && sweep_count < task_count && cost < best_cost) {
+                    best_cost = cost;
+                    best_split = b;
+                }
+            }
+            if (best_cost < FLT_MAX) {
+                mid = int(std::partition(primitives.begin() + task.begin, primitives.begin() + task.end
+                    , [&](int p) { return bin_of(p) < best_split; }) - primitives.begin());
+            }
+        }
+        // degenerate centroid distributions are split in the middle
+        if (mid == task.begin || mid == task.end)
+            mid = task.begin + task_count / 2;
+
+        int left = ilen(nodes);
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+        tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+    }
+}
+
+void SceneRaytracer::clear() {
+    meshes.clear();
+    instances.clear();
+    object_to_world.clear();
+    tlas = Bvh();
+}
+
+int SceneRaytracer::add_mesh(std::vector<glm::vec3> triangle_positions) {
+    BlasMesh mesh;
+    mesh.positions = std::move(triangle_positions);
+    meshes.push_back(std::move(mesh));
+    return ilen(meshes) - 1;
+}
+
+void SceneRaytracer::add_instance(int mesh, glm::mat4 const& transform) {
+    TlasInstance instance;
+    instance.mesh = mesh;
+    instance.world_to_object = glm::inverse(transform);
+    instances.push_back(instance);
+    object_to_world.push_back(transform);
+}
+
+void SceneRaytracer::build() {
+    parallel_for(ilen(meshes), [&](int mesh_idx) {
+        auto& mesh = meshes[mesh_idx];
+        int triangle_count = ilen(mesh.positions) / 3;
+        std::vector<glm::vec3> lower(triangle_count), upper(triangle_count);
+        for (int i = 0; i < triangle_count; ++i) {
+            glm::vec3 const* v = &mesh.positions[3 * i];
+            lower[i] = glm::min(v[0], glm::min(v[1], v[2]));
+            upper[i] = glm::max(v[0], glm::max(v[1], v[2]));
+        }
+        mesh.bvh.build(lower, upper);
+    });
+
+    std::vector<glm::vec3> lower(instances.size()), upper(instances.size());
+    for (int i = 0; i < ilen(instances); ++i) {
+        auto& bvh = meshes[instances[i].mesh].bvh;
+        lower[i] = glm::vec3(FLT_MAX);
+        upper[i] = glm::vec3(-FLT_MAX);
+        if (bvh.nodes.empty())
+            continue;
+        for (int c = 0; c < 8; ++c) {
+            glm::vec3 corner(
+                (c & 1) ? bvh.nodes[0].upper.x : bvh.nodes[0].lower.x,
+                (c & 2) ? bvh.nodes[0].upper.y : bvh.nodes[0].lower.y,
+                (c & 4) ? bvh.nodes[0].upper.z : bvh.nodes[0].lower.z);
+            glm::vec3 world = glm::vec3(object_to_world[i] * glm::vec4(corner, 1.0f));
+            lower[i] = glm::min(lower[i], world);
+            upper[i] = glm::max(upper[i], world);
+        }
+    }
+    tlas.build(lower, upper, 1);
+}
+
+size_t SceneRaytracer::instanced_triangle_count() const {
+    size_t count = 0;
+    for (auto& instance : instances)
+        count += meshes[instance.mesh].positions.size() / 3;
+    return count;
+}
+
+void SceneRaytracer::set_scene(const Scene &scene) {
+    clear();
+    std::vector<int> mesh_index(scene.meshes.size(), -1);
+    for (auto& instance : scene.instances) {
+        int mesh_id = scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id;
+        if (mesh_index[mesh_id] < 0)
+            mesh_index[mesh_id] = add_mesh({});
+    }
+    std::vector<int> scene_mesh_ids(meshes.size());
+    for (int i = 0; i < ilen(mesh_index); ++i)
+        if (mesh_index[i] >= 0)
+            scene_mesh_ids[mesh_index[i]] = i;
+    parallel_for(ilen(meshes), [&](int mesh_idx) {
+        auto& mesh = scene.meshes[scene_mesh_ids[mesh_idx]];
+        auto& positions = meshes[mesh_idx].positions;
+        for (auto& geometry : mesh.geometries) {
+            size_t offset = positions.size();
+            positions.resize(offset + 3 * size_t(geometry.num_tris()));
+            for (int i = 0, ie = geometry.num_tris(); i < ie; ++i)
+                geometry.tri_positions(i, positions[offset + 3 * i], positions[offset + 3 * i + 1], positions[offset + 3 * i + 2]);
+        }
+    });
+    for (auto& instance : scene.instances) {
+        int mesh_id = scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id;
+        add_instance(mesh_index[mesh_id], scene.animation_data[instance.animation_data_index].dequantize(instance.transform_index, 0));
+    }
+    build();
+}
+
+int SceneRaytracer::trace_ray(RayQuery* queries, int num_queries, RaytraceResults aux_results) {
+    std::atomic<int> hit_count(0);
+    parallel_for(num_queries, [&](int query_idx) {
+        RayQuery const& query = queries[query_idx];
+        Ray world_ray(query.origin, query.dir);
+        float t_max = query.t_max;
+        int hit_instance = -1;
+        glm::vec3 hit_object_normal;
+
+        traverse(tlas, world_ray, t_max, [&](int instance_idx, float& t_max) {
+            auto& instance = instances[instance_idx];
+            auto& mesh = meshes[instance.mesh];
+            // directions are not normalized, such that hit distances carry over to world space
+            Ray ray(glm::vec3(instance.world_to_object * glm::vec4(query.origin, 1.0f))
+                , glm::vec3(instance.world_to_object * glm::vec4(query.dir, 0.0f)));
+            traverse(mesh.bvh, ray, t_max, [&](int triangle_idx, float& t_max) {
+                glm::vec3 const* v = &mesh.positions[3 * triangle_idx];
+                float t = intersect_triangle(ray, v[0], v[1], v[2], t_max);
+                if (t >= 0.0f) {
+                    t_max = t;
+                    hit_instance = instance_idx;
+                    hit_object_normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+                }
+            });
+        });
+
+        if (hit_instance >= 0) {
+            ++hit_count;
+            if (aux_results.hit_t)
+                aux_results.hit_t[query_idx] = t_max;
+            if (aux_results.hit_normal) {
+                // normals transform with the inverse transpose
+                glm::mat4 const& w2o = instances[hit_instance].world_to_object;
+                glm::vec3 n(
+                    glm::dot(glm::vec3(w2o[0]), hit_object_normal),
+                    glm::dot(glm::vec3(w2o[1]), hit_object_normal),
+                    glm::dot(glm::vec3(w2o[2]), hit_object_normal));
+                n = glm::normalize(n);
+                aux_results.hit_normal[query_idx] = glm::dot(n, query.dir) > 0.0f ? -n : n;
+            }
+        }
+        else {
+            if (aux_results.hit_t)
+                aux_results.hit_t[query_idx] = -1.0f;
+            if (aux_results.hit_normal)
+                aux_results.hit_normal[query_idx] = glm::vec3(0.0f);
+        }
+    }, 0, 64);
+    return hit_count;
+}
+
+} // namespace
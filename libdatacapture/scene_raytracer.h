@@ -0,0 +1,58 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "librender/raytrace_backend.h"
+#include <vector>
+
+namespace rt_datacapture {
+
+// binned SAH bounding volume hierarchy over primitive bounds
+struct Bvh {
+    struct Node {
+        glm::vec3 lower;
+        int first = 0; // first primitive of leaves, left child of inner nodes (right = first + 1)
+        glm::vec3 upper;
+        int count = 0; // primitive count of leaves, 0 for inner nodes
+    };
+    std::vector<Node> nodes;
+    std::vector<int> primitives;
+
+    void build(std::vector<glm::vec3> const& lower, std::vector<glm::vec3> const& upper, int max_leaf_size = 4);
+};
+
+// Multi-threaded CPU ray tracer over instanced triangle meshes, for capturing data with
+// render backends that do not implement RaytraceBackend themselves.
+struct SceneRaytracer : ::RaytraceBackend {
+    std::string name() const override { return "CPU BVH"; }
+
+    // instantiates the first LOD of all scene instances at their first animation frame
+    void set_scene(const Scene &scene) override;
+    int trace_ray(RayQuery* queries, int num_queries, RaytraceResults aux_results) override;
+
+    void clear();
+    // takes world-space triangle soup (three vertices per triangle), returns the mesh index
+    int add_mesh(std::vector<glm::vec3> triangle_positions);
+    void add_instance(int mesh, glm::mat4 const& object_to_world);
+    // (re)builds acceleration structures after meshes or instances were added
+    void build();
+
+    size_t instanced_triangle_count() const;
+
+private:
+    struct BlasMesh {
+        std::vector<glm::vec3> positions;
+        Bvh bvh;
+    };
+    struct TlasInstance {
+        int mesh;
+        glm::mat4 world_to_object;
+    };
+    std::vector<BlasMesh> meshes;
+    std::vector<TlasInstance> instances;
+    std::vector<glm::mat4> object_to_world;
+    Bvh tlas;
+};
+
+} // namespace
@@ -0,0 +1,55 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "test_scene.h"
+#include "sampling.h"
+
+namespace rt_datacapture {
+
+namespace {
+
+// axis-aligned box as 12 triangles, wound counter-clockwise when seen from outside
+std::vector<glm::vec3> box_triangles(glm::vec3 lower, glm::vec3 upper) {
+    glm::vec3 c[8];
+    for (int i = 0; i < 8; ++i)
+        c[i] = glm::vec3((i & 1) ? upper.x : lower.x, (i & 2) ? upper.y : lower.y, (i & 4) ? upper.z : lower.z);
+    int const quads[6][4] = {
+        { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, // -x, +x
+        { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, // -y, +y
+        { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, // -z, +z
+    };
+    std::vector<glm::vec3> triangles;
+    for (auto& q : quads) {
+        for (int i : { q[0], q[1], q[2], q[0], q[2], q[3] })
+            triangles.push_back(c[i]);
+    }
+    return triangles;
+}
+
+} // namespace
+
+void make_test_scene(SceneRaytracer& raytracer, int pillar_count, uint64_t seed) {
+    raytracer.clear();
+    int room = raytracer.add_mesh(box_triangles(TEST_SCENE_LOWER, TEST_SCENE_UPPER));
+    raytracer.add_instance(room, glm::mat4(1.0f));
+
+    int pillar = raytracer.add_mesh(box_triangles(glm::vec3(-0.5f, 0.0f, -0.5f), glm::vec3(0.5f, 1.0f, 0.5f)));
+    RandomSampler rng(seed);
+    for (int i = 0; i < pillar_count; ++i) {
+        glm::vec2 pos;
+        do {
+            pos = glm::vec2(-8.0f + 16.0f * rng.next_float(), -8.0f + 16.0f * rng.next_float());
+        } while (glm::dot(pos, pos) < 3.0f * 3.0f);
+        float width = 0.3f + 0.9f * rng.next_float();
+        float height = 1.0f + 3.5f * rng.next_float();
+        glm::mat4 transform(1.0f);
+        transform[0][0] = width;
+        transform[1][1] = height;
+        transform[2][2] = width;
+        transform[3] = glm::vec4(pos.x, 0.0f, pos.y, 1.0f);
+        raytracer.add_instance(pillar, transform);
+    }
+    raytracer.build();
+}
+
+} // namespace
@@ -0,0 +1,18 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "scene_raytracer.h"
+
+namespace rt_datacapture {
+
+// extent of the closed room of the test scene
+glm::vec3 const TEST_SCENE_LOWER(-10.0f, 0.0f, -10.0f);
+glm::vec3 const TEST_SCENE_UPPER(10.0f, 5.0f, 10.0f);
+
+// Deterministic test scene for the capture tools: a closed room with instanced box pillars
+// at random positions, keeping a free radius of 2 around the vertical axis through the origin.
+void make_test_scene(SceneRaytracer& raytracer, int pillar_count = 32, uint64_t seed = 1);
+
+} // namespace
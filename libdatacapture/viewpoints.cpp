@@ -0,0 +1,48 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "viewpoints.h"
+#include <algorithm>
+
+namespace rt_datacapture {
+
+View sample_viewpoint(RaytraceBackend& raytracer, Poi const* pois, int num_pois, RandomSampler& rng) {
+    if (num_pois <= 0)
+        return View{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+
+    // trace a small batch of candidate views at once and pick the least obstructed one
+    int const CANDIDATE_COUNT = 16;
+    RayQuery queries[CANDIDATE_COUNT];
+    float hit_t[CANDIDATE_COUNT];
+    float preferred_distance[CANDIDATE_COUNT];
+    Poi const* candidate_pois[CANDIDATE_COUNT];
+    for (int i = 0; i < CANDIDATE_COUNT; ++i) {
+        Poi const& poi = pois[rng.next_uint() % uint32_t(num_pois)];
+        glm::vec3 normal = poi.valid() ? poi.normal : glm::vec3(0.0f, 1.0f, 0.0f);
+        // view POIs from distances similar to the ones they were discovered from
+        preferred_distance[i] = std::max(poi.distance, 1.e-3f);
+        candidate_pois[i] = &poi;
+        queries[i].origin = poi.pos + normal * (1.e-4f * preferred_distance[i]);
+        queries[i].mode_or_data = i;
+        queries[i].dir = square_to_cosine_hemisphere(rng.next_vec2(), normal);
+        queries[i].t_max = 2.0f * preferred_distance[i];
+    }
+    RaytraceResults results;
+    results.hit_t = hit_t;
+    raytracer.trace_ray(queries, CANDIDATE_COUNT, results);
+
+    int best = 0;
+    float best_distance = -1.0f;
+    for (int i = 0; i < CANDIDATE_COUNT; ++i) {
+        float free_distance = hit_t[i] >= 0.0f ? 0.8f * hit_t[i] : queries[i].t_max;
+        float view_distance = std::min(free_distance, preferred_distance[i]);
+        if (view_distance > best_distance) {
+            best = i;
+            best_distance = view_distance;
+        }
+    }
+    float view_distance = best_distance * (0.5f + 0.5f * rng.next_float());
+    return View{ candidate_pois[best]->pos + queries[best].dir * view_distance, -queries[best].dir };
+}
+
+} // namespace
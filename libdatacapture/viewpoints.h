@@ -0,0 +1,19 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "pois.h"
+
+namespace rt_datacapture {
+
+struct View {
+    glm::vec3 pos;
+    glm::vec3 dir;
+};
+
+// Places a camera looking at a random POI from a random direction of its visible
+// hemisphere, at a distance that keeps the view of the POI unobstructed.
+View sample_viewpoint(RaytraceBackend& raytracer, Poi const* pois, int num_pois, RandomSampler& rng);
+
+} // namespace
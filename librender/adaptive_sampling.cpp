@@ -0,0 +1,92 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "adaptive_sampling.h"
+#include "error_io.h"
+#include <algorithm>
+
+AdaptiveSampler::AdaptiveSampler(int width, int height, AdaptiveSamplingConfig const& config)
+    : config(config)
+    , width(width)
+    , height(height)
+    , stats(size_t(width) * height)
+    , color(size_t(width) * height * 3) {
+    if (config.batch_spp < 1 || config.min_spp < 1 || config.max_spp < 1)
+        throw_error("Adaptive sampling requires positive sample counts");
+    reset();
+}
+
+void AdaptiveSampler::reset() {
+    std::fill(stats.begin(), stats.end(), glsl::AdaptivePixelStats{ 0.0f, 0.0f, 0.0f, float(config.batch_spp) });
+    std::fill(color.begin(), color.end(), 0.0f);
+    totals = glsl::AdaptiveSamplingTotals();
+    frame = 0;
+    total_samples = 0;
+}
+
+void AdaptiveSampler::render_frame(SampleFunction const& sample) {
+    uint32_t pixel_count = uint32_t(width * height);
+    std::vector<float> frame_color(color.size(), 0.0f);
+
+    // tracing: all samples of a pixel in one thread, merged into the moments
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            uint32_t pixel = uint32_t(y * width + x);
+            auto& s = stats[pixel];
+            uint32_t spp = uint32_t(s.spp);
+            uint32_t sample_base = uint32_t(s.count);
+            float mean = 0.0f, second_moment = 0.0f;
+            float* rgb = &frame_color[3 * pixel];
+            for (uint32_t i = 0; i < spp; ++i) {
+                float c[3];
+                sample(x, y, sample_base + i, c);
+                float l = glsl::adaptive_luminance(c[0], c[1], c[2]);
+                mean += l;
+                second_moment += l * l;
+                for (int k = 0; k < 3; ++k)
+                    rgb[k] += c[k];
+            }
+            if (spp > 0) {
+                float inv_spp = 1.0f / float(spp);
+                mean *= inv_spp;
+                second_moment *= inv_spp;
+                for (int k = 0; k < 3; ++k)
+                    rgb[k] *= inv_spp;
+            }
+            s = glsl::adaptive_merge_frame(s, mean, second_moment, spp);
+            total_samples += spp;
+        }
+
+    // sample processing: the importance sums of the previous frame are complete
+    int write_slot = frame % ADAPTIVE_SAMPLING_TOTALS_SLOTS;
+    int read_slot = (frame + ADAPTIVE_SAMPLING_TOTALS_SLOTS - 1) % ADAPTIVE_SAMPLING_TOTALS_SLOTS;
+    int clear_slot = (frame + 1) % ADAPTIVE_SAMPLING_TOTALS_SLOTS;
+    float spp_per_importance = glsl::adaptive_spp_per_importance(totals.importance[read_slot]
+        , totals.uniform_pixels[read_slot], pixel_count, config.batch_spp);
+    totals.importance[clear_slot] = 0.0f;
+    totals.uniform_pixels[clear_slot] = 0;
+
+    for (uint32_t pixel = 0; pixel < pixel_count; ++pixel) {
+        auto& s = stats[pixel];
+        float weight = glsl::adaptive_history_weight(s);
+        for (int k = 0; k < 3; ++k)
+            color[3 * pixel + k] += (frame_color[3 * pixel + k] - color[3 * pixel + k]) * weight;
+
+        totals.importance[write_slot] += glsl::adaptive_importance(s, config.error_threshold, config.min_spp);
+        totals.uniform_pixels[write_slot] += glsl::adaptive_uniform_pixel(s, config.min_spp) ? 1 : 0;
+        s.spp = float(glsl::adaptive_pixel_spp(s, spp_per_importance
+            , config.error_threshold, config.min_spp, config.max_spp, config.batch_spp
+            , glsl::adaptive_rounding_random(uint32_t(frame), pixel)));
+    }
+    ++frame;
+}
+
+uint32_t AdaptiveSampler::pixel_spp(int x, int y) const {
+    return uint32_t(stats[size_t(y) * width + x].spp);
+}
+
+uint32_t AdaptiveSampler::retired_pixels() const {
+    return uint32_t(std::count_if(stats.begin(), stats.end(), [this](glsl::AdaptivePixelStats const& s) {
+        return glsl::adaptive_converged(s, config.error_threshold, config.min_spp);
+    }));
+}
@@ -0,0 +1,127 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef ADAPTIVE_SAMPLING_H_GLSL
+#define ADAPTIVE_SAMPLING_H_GLSL
+
+// Per-pixel sample allocation of adaptive sampling, shared by the integrators and sample
+// processing (vulkan/accumulate.glsl, vulkan/process_samples.comp) and the CPU reference
+// in adaptive_sampling.h. Each frame distributes the budget of batch_spp samples per pixel
+// proportionally to the relative standard deviation of the pixel luminance, pixels whose
+// relative error of the mean falls below the threshold are retired.
+
+// relative errors of dark pixels are measured against this luminance
+#define ADAPTIVE_SAMPLING_LUMINANCE_FLOOR 0.01f
+// importance sums are written, read and cleared in rotating slots, one frame apart
+#define ADAPTIVE_SAMPLING_TOTALS_SLOTS 3
+
+// Luminance moments of all samples of a pixel, stored in an rgba32f image
+struct AdaptivePixelStats {
+    float mean;
+    float second_moment;
+    float count;
+    // samples of the last frame after tracing, samples of the next frame after processing
+    float spp;
+};
+
+// Importance sums of all pixels of a frame, and the pixels still sampled uniformly
+struct AdaptiveSamplingTotals {
+    float importance[ADAPTIVE_SAMPLING_TOTALS_SLOTS];
+    uint32_t uniform_pixels[ADAPTIVE_SAMPLING_TOTALS_SLOTS];
+};
+
+inline float adaptive_luminance(float r, float g, float b) {
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// merges the luminance moments of the samples of one frame
+inline AdaptivePixelStats adaptive_merge_frame(AdaptivePixelStats stats, float frame_mean, float frame_second_moment, uint32_t frame_spp) {
+    if (frame_spp == 0) {
+        stats.spp = 0.0f;
+        return stats;
+    }
+    float count = stats.count + float(frame_spp);
+    float weight = float(frame_spp) / count;
+    stats.mean += (frame_mean - stats.mean) * weight;
+    stats.second_moment += (frame_second_moment - stats.second_moment) * weight;
+    stats.count = count;
+    stats.spp = float(frame_spp);
+    return stats;
+}
+
+// weight of the mean color of the last frame in the accumulated mean
+inline float adaptive_history_weight(AdaptivePixelStats stats) {
+    return stats.count > 0.0f ? stats.spp / stats.count : 0.0f;
+}
+
+// relative standard deviation of one sample
+inline float adaptive_relative_deviation(AdaptivePixelStats stats) {
+    float variance = stats.second_moment - stats.mean * stats.mean;
+    if (!(variance > 0.0f))
+        return 0.0f;
+    float scale = stats.mean > ADAPTIVE_SAMPLING_LUMINANCE_FLOOR ? stats.mean : ADAPTIVE_SAMPLING_LUMINANCE_FLOOR;
+    return sqrt(variance) / scale;
+}
+
+// relative standard error of the accumulated mean
+inline float adaptive_relative_error(AdaptivePixelStats stats) {
+    if (!(stats.count > 1.0f))
+        return 2.e16f;
+    return adaptive_relative_deviation(stats) * sqrt(1.0f / (stats.count - 1.0f));
+}
+
+inline bool adaptive_uniform_pixel(AdaptivePixelStats stats, int min_spp) {
+    return stats.count < float(min_spp);
+}
+
+inline bool adaptive_converged(AdaptivePixelStats stats, float error_threshold, int min_spp) {
+    return !adaptive_uniform_pixel(stats, min_spp) && adaptive_relative_error(stats) < error_threshold;
+}
+
+// Minimizing the summed relative variance of all pixels under a fixed sample budget
+// allocates samples proportionally to the relative deviation of each pixel.
+inline float adaptive_importance(AdaptivePixelStats stats, float error_threshold, int min_spp) {
+    if (adaptive_uniform_pixel(stats, min_spp) || adaptive_converged(stats, error_threshold, min_spp))
+        return 0.0f;
+    return adaptive_relative_deviation(stats);
+}
+
+// samples per unit of importance, such that all pixels together use the frame budget
+inline float adaptive_spp_per_importance(float importance_sum, uint32_t uniform_pixels
+    , uint32_t pixel_count, int batch_spp) {
+    float budget = float(pixel_count - (uniform_pixels < pixel_count ? uniform_pixels : pixel_count)) * float(batch_spp);
+    return importance_sum > 0.0f ? budget / importance_sum : 0.0f;
+}
+
+// uniform random number for the rounding of the sample count of a pixel in a frame
+inline float adaptive_rounding_random(uint32_t frame, uint32_t pixel) {
+    uint32_t state = pixel * 0x9e3779b9u ^ frame * 0x85ebca6bu;
+    state ^= state >> 16;
+    state *= 0x7feb352du;
+    state ^= state >> 15;
+    state *= 0x846ca68bu;
+    state ^= state >> 16;
+    return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+// samples of a pixel in the next frame, stochastically rounded with the uniform number u
+inline uint32_t adaptive_pixel_spp(AdaptivePixelStats stats, float spp_per_importance
+    , float error_threshold, int min_spp, int max_spp, int batch_spp, float u) {
+    if (adaptive_uniform_pixel(stats, min_spp))
+        return uint32_t(batch_spp);
+    float importance = adaptive_importance(stats, error_threshold, min_spp);
+    if (!(importance > 0.0f))
+        return 0u;
+    // no estimate of the budget yet
+    if (!(spp_per_importance > 0.0f))
+        return uint32_t(batch_spp);
+    float expected = importance * spp_per_importance;
+    if (expected >= float(max_spp))
+        return uint32_t(max_spp);
+    uint32_t spp = uint32_t(expected);
+    if (u < expected - float(spp))
+        ++spp;
+    return spp;
+}
+
+#endif
@@ -0,0 +1,49 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace glsl {
+    #include "adaptive_sampling.glsl"
+}
+
+// CPU reference of adaptive sampling, which replicates the frame order of the integrators
+// (vulkan/pt_megakernel.glsl) and sample processing (vulkan/process_samples.comp) such that
+// sample allocation and convergence can be tested without a GPU.
+
+struct AdaptiveSamplingConfig {
+    float error_threshold = 0.01f;
+    int min_spp = 16;
+    int max_spp = 64;
+    // average samples per pixel and frame
+    int batch_spp = 1;
+};
+
+struct AdaptiveSampler {
+    // returns the color of one sample of the given pixel
+    typedef std::function<void(int x, int y, uint32_t sample_index, float (&rgb)[3])> SampleFunction;
+
+    AdaptiveSamplingConfig config;
+    int width, height;
+    std::vector<glsl::AdaptivePixelStats> stats;
+    // accumulated mean color, 3 floats per pixel
+    std::vector<float> color;
+    glsl::AdaptiveSamplingTotals totals;
+    int frame = 0;
+    uint64_t total_samples = 0;
+
+    AdaptiveSampler(int width, int height, AdaptiveSamplingConfig const& config);
+    void reset();
+
+    // traces the samples allocated to each pixel, then accumulates them and
+    // allocates the samples of the next frame
+    void render_frame(SampleFunction const& sample);
+
+    uint32_t pixel_spp(int x, int y) const;
+    uint32_t retired_pixels() const;
+};
@@ -0,0 +1,75 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef BLEND_ATTRIBUTES_H_GLSL
+#define BLEND_ATTRIBUTES_H_GLSL
+
+// Decoder for the 32-bit blend attributes of skinned .vks meshes (BlendAttributeCodec
+// of the exporter). Five of the six ascending weights are mapped to a unit cube and
+// quantized to 32 values each; the order in which the quantized values are stored
+// is a permutation that carries the low bits of the payload (tuple index and extra bits).
+#define BLEND_ATTRIBUTE_ENTRY_COUNT 5
+#define BLEND_ATTRIBUTE_WEIGHT_VALUE_COUNT 32
+#define BLEND_ATTRIBUTE_PERMUTATION_COUNT 120
+
+inline uint32_t blend_attribute_extra_value_count(int i) {
+    return i < 3 ? 1u : (i == 3 ? 2u : 4u);
+}
+
+// Returns the index into the bone index tuple table, weights are sorted ascending
+inline uint32_t decode_blend_attributes(uint32_t code, GLSL_out(vec3) weights_lo, GLSL_out(vec3) weights_hi) {
+    uint32_t shuffled[BLEND_ATTRIBUTE_ENTRY_COUNT];
+    for (int k = BLEND_ATTRIBUTE_ENTRY_COUNT - 1; k >= 0; --k) {
+        shuffled[k] = code % uint32_t(BLEND_ATTRIBUTE_WEIGHT_VALUE_COUNT);
+        code /= uint32_t(BLEND_ATTRIBUTE_WEIGHT_VALUE_COUNT);
+    }
+
+    // quantized weights are strictly ascending, ranks recover the permutation
+    int permutation[BLEND_ATTRIBUTE_ENTRY_COUNT];
+    for (int k = 0; k < BLEND_ATTRIBUTE_ENTRY_COUNT; ++k) {
+        int rank = 0;
+        for (int j = 0; j < BLEND_ATTRIBUTE_ENTRY_COUNT; ++j)
+            rank += int(shuffled[j] < shuffled[k]);
+        permutation[rank] = k;
+    }
+    // Lehmer code of the lexicographically ordered permutation
+    uint32_t lehmer = 0u;
+    uint32_t radix = 1u;
+    for (int i = 2; i <= BLEND_ATTRIBUTE_ENTRY_COUNT; ++i) {
+        int position = BLEND_ATTRIBUTE_ENTRY_COUNT - i;
+        uint32_t remainder = 0u;
+        for (int j = position + 1; j < BLEND_ATTRIBUTE_ENTRY_COUNT; ++j)
+            remainder += uint32_t(permutation[j] < permutation[position]);
+        lehmer += remainder * radix;
+        radix *= uint32_t(i);
+    }
+    uint32_t payload = code * uint32_t(BLEND_ATTRIBUTE_PERMUTATION_COUNT) + lehmer;
+
+    uint32_t extra[BLEND_ATTRIBUTE_ENTRY_COUNT];
+    for (int i = BLEND_ATTRIBUTE_ENTRY_COUNT - 1; i >= 0; --i) {
+        extra[i] = payload % blend_attribute_extra_value_count(i);
+        payload /= blend_attribute_extra_value_count(i);
+    }
+
+    // undo the mapping of the sorted weights into the unit cube
+    float weights[BLEND_ATTRIBUTE_ENTRY_COUNT + 1];
+    float prefix = 0.0f;
+    for (int i = 0; i < BLEND_ATTRIBUTE_ENTRY_COUNT; ++i) {
+        uint32_t extra_count = blend_attribute_extra_value_count(i);
+        uint32_t combined = shuffled[permutation[i]] * extra_count + extra[i];
+        float offset = float(uint32_t(i + 1) * extra_count - 1u);
+        float value_count = float(uint32_t(BLEND_ATTRIBUTE_WEIGHT_VALUE_COUNT - BLEND_ATTRIBUTE_ENTRY_COUNT) * extra_count);
+        float cube_weight = (float(combined) - offset) / value_count;
+        float w = (cube_weight - prefix) / float(BLEND_ATTRIBUTE_ENTRY_COUNT + 1 - i);
+        w = w > 0.0f ? w : 0.0f;
+        weights[i] = w;
+        prefix += w;
+    }
+    weights[BLEND_ATTRIBUTE_ENTRY_COUNT] = prefix < 1.0f ? 1.0f - prefix : 0.0f;
+
+    weights_lo = vec3(weights[0], weights[1], weights[2]);
+    weights_hi = vec3(weights[3], weights[4], weights[5]);
+    return payload;
+}
+
+#endif
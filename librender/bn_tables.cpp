@@ -0,0 +1,206 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "bn_tables.h"
+#include "types.h"
+#include "util.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const char BN_TABLES_MAGIC[4] = { 'B', 'N', 'T', 'B' };
+const uint32_t BN_TABLES_VERSION = 1;
+
+struct BNTablesFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sample_count;
+    uint32_t dimensions;
+    uint32_t tile_size;
+    uint32_t scrambling_dimensions;
+    uint32_t tile_count;
+    uint32_t payload_hash; // FNV-1a over everything following the header
+};
+
+uint32_t fnv1a_hash(uint32_t hash, void const* data, size_t size) {
+    auto bytes = reinterpret_cast<unsigned char const*>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+const uint32_t FNV1A_BASIS = 2166136261u;
+
+bool is_power_of_two(int v) {
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+// tables are stored as a byte width followed by the values at that width
+void append_table(std::vector<unsigned char> &payload, std::vector<uint32_t> const &values) {
+    uint32_t max_value = 0;
+    for (uint32_t v : values)
+        max_value = std::max(max_value, v);
+    uint32_t width = max_value <= 0xffu ? 1 : max_value <= 0xffffu ? 2 : 4;
+
+    size_t offset = payload.size();
+    payload.resize(offset + sizeof(width) + width * values.size());
+    std::memcpy(&payload[offset], &width, sizeof(width));
+    unsigned char* cursor = &payload[offset + sizeof(width)];
+    for (uint32_t v : values) {
+        for (uint32_t b = 0; b < width; ++b)
+            *cursor++ = (unsigned char) (v >> (8 * b));
+    }
+}
+
+void read_table(std::vector<uint32_t> &values, size_t count
+    , unsigned char const* &cursor, unsigned char const* end, char const* filename) {
+    uint32_t width = 0;
+    if (size_t(end - cursor) < sizeof(width))
+        throw_error("Blue-noise tables \"%s\" are truncated", filename);
+    std::memcpy(&width, cursor, sizeof(width));
+    cursor += sizeof(width);
+    if (width != 1 && width != 2 && width != 4)
+        throw_error("Blue-noise tables \"%s\" use unsupported value width %u", filename, width);
+    if (size_t(end - cursor) / width < count)
+        throw_error("Blue-noise tables \"%s\" are truncated", filename);
+
+    values.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t v = 0;
+        for (uint32_t b = 0; b < width; ++b)
+            v |= uint32_t(*cursor++) << (8 * b);
+        values[i] = v;
+    }
+}
+
+} // namespace
+
+BNTables::Tile const* BNTables::find_tile(int spp) const {
+    for (auto& tile : tiles)
+        if (tile.spp == spp)
+            return &tile;
+    return nullptr;
+}
+
+void BNTables::validate() const {
+    if (!is_power_of_two(sample_count) || !is_power_of_two(dimensions)
+     || !is_power_of_two(tile_size) || !is_power_of_two(scrambling_dimensions))
+        throw_error("Blue-noise table dimensions have to be powers of two (%d samples, %d dimensions, %d tile size, %d scrambling dimensions)"
+            , sample_count, dimensions, tile_size, scrambling_dimensions);
+    if (scrambling_dimensions > dimensions)
+        throw_error("Blue-noise tables scramble %d dimensions of a %d-dimensional sequence", scrambling_dimensions, dimensions);
+    if (ilen(sequence_spp_d) != sequence_entry_count())
+        throw_error("Blue-noise sequence holds %d values, expected %d", ilen(sequence_spp_d), sequence_entry_count());
+    for (auto& tile : tiles) {
+        if (!is_power_of_two(tile.spp) || tile.spp > sample_count)
+            throw_error("Blue-noise tile optimized for invalid sample count %d", tile.spp);
+        if (ilen(tile.scrambling_yx_d) != tile_entry_count() || ilen(tile.ranking_yx_d) != tile_entry_count())
+            throw_error("Blue-noise tile for %d spp has wrong size", tile.spp);
+        for (uint32_t rank : tile.ranking_yx_d)
+            if (rank >= uint32_t(tile.spp))
+                throw_error("Blue-noise tile for %d spp has out-of-range ranking key %u", tile.spp, rank);
+    }
+}
+
+void write_bn_tables(const std::string &filename, const BNTables &tables) {
+    tables.validate();
+
+    std::vector<unsigned char> payload;
+    for (auto& tile : tables.tiles) {
+        uint32_t spp = uint32_t(tile.spp);
+        payload.insert(payload.end(), (unsigned char const*) &spp, (unsigned char const*) &spp + sizeof(spp));
+    }
+    append_table(payload, tables.sequence_spp_d);
+    for (auto& tile : tables.tiles) {
+        append_table(payload, tile.scrambling_yx_d);
+        append_table(payload, tile.ranking_yx_d);
+    }
+
+    BNTablesFileHeader header = { };
+    std::memcpy(header.magic, BN_TABLES_MAGIC, sizeof(header.magic));
+    header.version = BN_TABLES_VERSION;
+    header.sample_count = uint32_t(tables.sample_count);
+    header.dimensions = uint32_t(tables.dimensions);
+    header.tile_size = uint32_t(tables.tile_size);
+    header.scrambling_dimensions = uint32_t(tables.scrambling_dimensions);
+    header.tile_count = uint32_t(tables.tiles.size());
+    header.payload_hash = fnv1a_hash(FNV1A_BASIS, payload.data(), payload.size());
+
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f)
+        throw_error("Failed to open blue-noise tables \"%s\" for writing", filename.c_str());
+    bool failure = fwrite(&header, sizeof(header), 1, f) != 1;
+    failure |= fwrite(payload.data(), 1, payload.size(), f) != payload.size();
+    failure |= fclose(f) != 0;
+    if (failure)
+        throw_error("Failed to write blue-noise tables \"%s\"", filename.c_str());
+}
+
+BNTables read_bn_tables(const std::string &filename) {
+    std::vector<unsigned char> data;
+    {
+        FILE* f = fopen(filename.c_str(), "rb");
+        if (!f)
+            throw_error("Failed to open blue-noise tables \"%s\" for reading", filename.c_str());
+        fseek(f, 0, SEEK_END);
+        data.resize(int_cast<size_t>(ftell(f)));
+        fseek(f, 0, SEEK_SET);
+        bool failure = fread(data.data(), 1, data.size(), f) != data.size();
+        fclose(f);
+        if (failure)
+            throw_error("Failed to read blue-noise tables \"%s\"", filename.c_str());
+    }
+
+    BNTablesFileHeader header;
+    if (data.size() < sizeof(header))
+        throw_error("Blue-noise tables \"%s\" are truncated", filename.c_str());
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, BN_TABLES_MAGIC, sizeof(header.magic)) != 0)
+        throw_error("\"%s\" is not a blue-noise table file", filename.c_str());
+    if (header.version != BN_TABLES_VERSION)
+        throw_error("Blue-noise tables \"%s\" have version %u, expected %u", filename.c_str(), header.version, BN_TABLES_VERSION);
+
+    unsigned char const* cursor = data.data() + sizeof(header);
+    unsigned char const* end = data.data() + data.size();
+    if (fnv1a_hash(FNV1A_BASIS, cursor, size_t(end - cursor)) != header.payload_hash)
+        throw_error("Blue-noise tables \"%s\" are corrupted (checksum mismatch)", filename.c_str());
+    // guard size computations below against overflow before validation
+    if (header.sample_count > (1u << 16) || header.dimensions > (1u << 12)
+     || header.tile_size > (1u << 10) || header.scrambling_dimensions > (1u << 8)
+     || header.tile_count > 64)
+        throw_error("Blue-noise tables \"%s\" have implausible dimensions", filename.c_str());
+
+    BNTables tables;
+    tables.sample_count = int(header.sample_count);
+    tables.dimensions = int(header.dimensions);
+    tables.tile_size = int(header.tile_size);
+    tables.scrambling_dimensions = int(header.scrambling_dimensions);
+    tables.tiles.resize(header.tile_count);
+    for (auto& tile : tables.tiles) {
+        uint32_t spp = 0;
+        if (size_t(end - cursor) < sizeof(spp))
+            throw_error("Blue-noise tables \"%s\" are truncated", filename.c_str());
+        std::memcpy(&spp, cursor, sizeof(spp));
+        cursor += sizeof(spp);
+        tile.spp = int(std::min(spp, uint32_t(INT32_MAX)));
+    }
+    read_table(tables.sequence_spp_d, size_t(tables.sequence_entry_count()), cursor, end, filename.c_str());
+    for (auto& tile : tables.tiles) {
+        read_table(tile.scrambling_yx_d, size_t(tables.tile_entry_count()), cursor, end, filename.c_str());
+        read_table(tile.ranking_yx_d, size_t(tables.tile_entry_count()), cursor, end, filename.c_str());
+    }
+    if (cursor != end)
+        throw_error("Blue-noise tables \"%s\" contain %d trailing bytes", filename.c_str(), int(end - cursor));
+
+    tables.validate();
+    return tables;
+}
+
+std::string default_bn_tables_file() {
+    std::string next_to_binary = binary_path("bn_tables.bin");
+    if (file_exists(next_to_binary))
+        return next_to_binary;
+    return rooted_path("rendering/pointsets/bn_tables.bin");
+}
@@ -0,0 +1,43 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tables for blue-noise dithered sampling (see rendering/pointsets/bn_rng.glsl):
+// a low-discrepancy sample sequence plus per-pixel scrambling and ranking keys
+// for a set of optimized sample counts, tiled over the screen.
+// Generated by rendering/tools/prepare_bn.cpp and loaded at run time.
+struct BNTables {
+    struct Tile {
+        int spp = 0;
+        std::vector<uint32_t> scrambling_yx_d;
+        std::vector<uint32_t> ranking_yx_d;
+    };
+
+    int sample_count = 0;
+    int dimensions = 0;
+    int tile_size = 0;
+    int scrambling_dimensions = 0;
+    std::vector<uint32_t> sequence_spp_d;
+    std::vector<Tile> tiles; // one per optimized sample count
+
+    int sequence_entry_count() const { return sample_count * dimensions; }
+    int tile_entry_count() const { return tile_size * tile_size * scrambling_dimensions; }
+    // returns nullptr if the tables were not optimized for the given sample count
+    Tile const* find_tile(int spp) const;
+
+    // throws if the table sizes are inconsistent with the configuration
+    void validate() const;
+};
+
+// Compact binary representation: a fixed header followed by the tables, with each
+// table stored at the smallest integer width that holds all of its values.
+void write_bn_tables(const std::string &filename, const BNTables &tables);
+BNTables read_bn_tables(const std::string &filename);
+
+// bn_tables.bin next to the binary, falling back to rendering/pointsets in the root tree
+std::string default_bn_tables_file();
@@ -70,7 +70,7 @@ Sphere Sphere::boundPoints(const glm::vec3* positions, int num_positions) {
     for (int iPos = 0; iPos < num_positions; iPos++) {
         const glm::vec3 delta = positions[iPos] - bounding_sphere.origin;
         const float dist_squared = glm::dot(delta, delta);
-        if (dist_squared > bounding_sphere.radius) {
+        if (dist_squared > bounding_sphere.radius * bounding_sphere.radius) {
             const float dist = sqrtf(dist_squared);
             const float radius_new = (bounding_sphere.radius + dist) * 0.5f;
             bounding_sphere.origin += delta * ((radius_new - bounding_sphere.radius) / dist);
@@ -81,3 +81,42 @@ Sphere Sphere::boundPoints(const glm::vec3* positions, int num_positions) {
     return bounding_sphere;
 }
 
+
+Box::Box(const glm::vec3 &_lower, const glm::vec3 &_upper)
+    : lower(_lower), upper(_upper) {}
+
+float Box::surface_area() const {
+    if (empty())
+        return 0.0f;
+    const glm::vec3 e = extent();
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+const Box& Box::operator+=(const Box& other) {
+    lower = glm::min(lower, other.lower);
+    upper = glm::max(upper, other.upper);
+    return *this;
+}
+
+Box Box::operator+(const Box& other) const {
+    return Box(*this)+=other;
+}
+
+const Box& Box::operator+=(const glm::vec3& point) {
+    lower = glm::min(lower, point);
+    upper = glm::max(upper, point);
+    return *this;
+}
+
+Box Box::transformed(const glm::mat4& transform) const {
+    if (empty())
+        return *this;
+    Box result;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? upper.x : lower.x,
+                         (i & 2) ? upper.y : lower.y,
+                         (i & 4) ? upper.z : lower.z);
+        result += glm::vec3(transform * glm::vec4(corner, 1.0f));
+    }
+    return result;
+}
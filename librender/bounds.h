@@ -4,6 +4,7 @@
 #pragma once
 
 #include <vector>
+#include <cfloat>
 #include <glm/glm.hpp>
 
 struct Sphere {
@@ -20,3 +21,21 @@ struct Sphere {
     static Sphere boundPoints(const glm::vec3 *positions, int num_positions);
 };
 
+struct Box {
+    glm::vec3 lower = glm::vec3(FLT_MAX);
+    glm::vec3 upper = glm::vec3(-FLT_MAX);
+
+    Box() = default;
+    Box(const glm::vec3 &_lower, const glm::vec3 &_upper);
+
+    bool empty() const { return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z; }
+    glm::vec3 extent() const { return upper - lower; }
+    float surface_area() const;
+
+    const Box &operator+=(const Box &other);
+    Box operator+(const Box &other) const;
+    const Box &operator+=(const glm::vec3 &point);
+
+    // Bounds of the eight transformed corners of this box
+    Box transformed(const glm::mat4 &transform) const;
+};
@@ -0,0 +1,608 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "bvh_quality.h"
+#include "instance_bounds.h"
+#include "mesh.h"
+#include "quantization.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace glsl {
+    using namespace glm;
+    #include "../rendering/language.hpp"
+    #include "../librender/dequantize.glsl"
+}
+#include "../librender/quantize.h"
+
+namespace {
+
+struct BuildRange {
+    int begin, end;
+    int depth;
+    Box bounds;
+};
+
+} // namespace
+
+BvhQuality estimate_bvh_quality(std::vector<Box> const& boxes, SahCostParams const& params
+    , std::vector<float> const* primitive_costs) {
+    BvhQuality quality;
+    std::vector<int> ids;
+    std::vector<glm::vec3> centroids(boxes.size());
+    Box root;
+    for (int i = 0, ie = ilen(boxes); i < ie; ++i) {
+        if (boxes[i].empty())
+            continue;
+        ids.push_back(i);
+        centroids[i] = 0.5f * (boxes[i].lower + boxes[i].upper);
+        root += boxes[i];
+    }
+    quality.primitive_count = ilen(ids);
+    if (ids.empty())
+        return quality;
+
+    auto cost_of = [&](int id) -> double {
+        return primitive_costs ? double((*primitive_costs)[id]) : double(params.primitive_cost);
+    };
+    // degenerate hierarchies, e.g. of points, count every node as hit
+    double root_area = root.surface_area();
+    auto relative_area = [root_area](Box const& b) -> double {
+        return root_area > 0.0 ? b.surface_area() / root_area : 1.0;
+    };
+
+    int bin_count = std::max(params.bin_count, 2);
+    int max_leaf_size = std::max(params.max_leaf_size, 1);
+    std::vector<Box> bin_bounds(bin_count);
+    std::vector<double> bin_costs(bin_count);
+    std::vector<Box> right_bounds(bin_count);
+    std::vector<double> right_costs(bin_count);
+
+    std::vector<BuildRange> stack;
+    stack.push_back({ 0, ilen(ids), 0, root });
+    while (!stack.empty()) {
+        BuildRange range = stack.back();
+        stack.pop_back();
+        quality.max_depth = std::max(quality.max_depth, range.depth);
+
+        int count = range.end - range.begin;
+        double leaf_cost = 0.0;
+        Box centroid_bounds;
+        for (int i = range.begin; i < range.end; ++i) {
+            leaf_cost += cost_of(ids[i]);
+            centroid_bounds += centroids[ids[i]];
+        }
+        double node_area = range.bounds.surface_area();
+
+        // binned SAH over the centroids, along each axis
+        int best_axis = -1, best_bin = 0;
+        double best_cost = HUGE_VAL;
+        glm::vec3 centroid_extent = centroid_bounds.extent();
+        for (int axis = 0; axis < 3 && count > 1; ++axis) {
+            if (!(centroid_extent[axis] > 0.0f))
+                continue;
+            float bin_scale = float(bin_count) / centroid_extent[axis];
+            std::fill(bin_bounds.begin(), bin_bounds.end(), Box());
+            std::fill(bin_costs.begin(), bin_costs.end(), 0.0);
+            for (int i = range.begin; i < range.end; ++i) {
+                int id = ids[i];
+                int bin = std::min(int((centroids[id][axis] - centroid_bounds.lower[axis]) * bin_scale), bin_count - 1);
+                bin_bounds[bin] += boxes[id];
+                bin_costs[bin] += cost_of(id);
+            }
+            Box right;
+            double right_cost = 0.0;
+            for (int b = bin_count - 1; b > 0; --b) {
+                right += bin_bounds[b];
+                right_cost += bin_costs[b];
+                right_bounds[b] = right;
+                right_costs[b] = right_cost;
+            }
+            Box left;
+            double left_cost = 0.0;
+            for (int b = 1; b < bin_count; ++b) {
+                left += bin_bounds[b - 1];
+                left_cost += bin_costs[b - 1];
+                if (left.empty() || right_bounds[b].empty())
+                    continue;
+                double split_cost = params.node_cost + (node_area > 0.0
+                    ? (left.surface_area() * left_cost + right_bounds[b].surface_area() * right_costs[b]) / node_area
+                    : left_cost + right_costs[b]);
+                if (split_cost < best_cost) {
+                    best_cost = split_cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        bool make_leaf = count == 1 || (count <= max_leaf_size && (best_axis < 0 || leaf_cost <= best_cost));
+        if (make_leaf) {
+            double area = relative_area(range.bounds);
+            ++quality.leaf_count;
+            quality.leaf_area += area;
+            quality.sah_cost += area * leaf_cost;
+            continue;
+        }
+
+        int middle;
+        if (best_axis >= 0) {
+            float bin_scale = float(bin_count) / centroid_extent[best_axis];
+            middle = int(std::partition(ids.begin() + range.begin, ids.begin() + range.end, [&](int id) {
+                int bin = std::min(int((centroids[id][best_axis] - centroid_bounds.lower[best_axis]) * bin_scale), bin_count - 1);
+                return bin < best_bin;
+            }) - ids.begin());
+        }
+        else
+            middle = range.begin + count / 2; // coincident centroids, split in stored order
+
+        double area = relative_area(range.bounds);
+        ++quality.inner_node_count;
+        quality.inner_area += area;
+        quality.sah_cost += area * params.node_cost;
+
+        Box left, right;
+        for (int i = range.begin; i < middle; ++i)
+            left += boxes[ids[i]];
+        for (int i = middle; i < range.end; ++i)
+            right += boxes[ids[i]];
+        stack.push_back({ range.begin, middle, range.depth + 1, left });
+        stack.push_back({ middle, range.end, range.depth + 1, right });
+    }
+    return quality;
+}
+
+std::vector<Box> mesh_triangle_bounds(Mesh const& mesh) {
+    std::vector<Box> bounds;
+    bounds.reserve(mesh.num_tris());
+    for (auto const& geom : mesh.geometries) {
+        for (int i = 0, ie = geom.num_tris(); i < ie; ++i) {
+            glm::vec3 a, b, c;
+            geom.tri_positions(i, a, b, c);
+            Box box(a, a);
+            box += b;
+            box += c;
+            bounds.push_back(box);
+        }
+    }
+    return bounds;
+}
+
+BvhQuality estimate_tlas_quality(std::vector<Box> const& instance_bounds, std::vector<double> const& blas_costs
+    , SahCostParams const& params) {
+    std::vector<float> costs(instance_bounds.size());
+    for (size_t i = 0; i < costs.size(); ++i)
+        costs[i] = float(params.node_cost + blas_costs[i]);
+    SahCostParams tlas_params = params;
+    tlas_params.max_leaf_size = 1;
+    return estimate_bvh_quality(instance_bounds, tlas_params, &costs);
+}
+
+bool triangle_needs_split(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c
+    , float mesh_diagonal, TriangleSplitParams const& params) {
+    float area = 0.5f * glm::length(glm::cross(b - a, c - a));
+    if (!(area > 0.0f))
+        return false;
+    Box box(a, a);
+    box += b;
+    box += c;
+    if (glm::length(box.extent()) < params.min_relative_extent * mesh_diagonal)
+        return false;
+    return box.surface_area() > params.max_area_ratio * area;
+}
+
+namespace {
+
+struct SplitCandidate {
+    float area;
+    uint32_t triangle;
+    uint32_t version;
+
+    bool operator<(SplitCandidate const& other) const {
+        return area < other.area || (area == other.area && triangle > other.triangle);
+    }
+};
+
+} // namespace
+
+TriangleSplit split_triangles(glm::vec3 const* positions, uint32_t vertex_count
+    , glm::uvec3 const* triangles, uint32_t triangle_count, float mesh_diagonal, TriangleSplitParams const& params) {
+    TriangleSplit result;
+    std::vector<glm::vec3> points(positions, positions + vertex_count);
+    std::vector<glm::uvec3> tris(triangles, triangles + triangle_count);
+    std::vector<uint32_t> sources(triangle_count);
+    std::iota(sources.begin(), sources.end(), 0u);
+    // corners in barycentric coordinates of the source triangle
+    std::vector<glm::mat3> corners(triangle_count, glm::mat3(1.0f));
+    std::vector<uint32_t> versions(triangle_count, 0);
+
+    std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+    for (uint32_t t = 0; t < triangle_count; ++t)
+        for (int k = 0; k < 3; ++k)
+            if (k == 0 || (tris[t][k] != tris[t][0] && (k == 1 || tris[t][k] != tris[t][1])))
+                vertex_triangles[tris[t][k]].push_back(t);
+
+    std::priority_queue<SplitCandidate> queue;
+    auto consider = [&](uint32_t t) {
+        glm::vec3 a = points[tris[t].x], b = points[tris[t].y], c = points[tris[t].z];
+        if (!triangle_needs_split(a, b, c, mesh_diagonal, params))
+            return;
+        Box box(a, a);
+        box += b;
+        box += c;
+        queue.push({ box.surface_area(), t, versions[t] });
+    };
+    for (uint32_t t = 0; t < triangle_count; ++t)
+        consider(t);
+
+    size_t budget = size_t(double(std::max(params.max_growth, 0.0f)) * triangle_count);
+    size_t added = 0;
+    auto longest_edge = [&](uint32_t t, float& length2) -> int {
+        int edge = 0;
+        length2 = -1.0f;
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 d = points[tris[t][(k + 1) % 3]] - points[tris[t][k]];
+            if (glm::dot(d, d) > length2) {
+                length2 = glm::dot(d, d);
+                edge = k;
+            }
+        }
+        return edge;
+    };
+    std::vector<uint32_t> incident;
+    while (!queue.empty() && added < budget) {
+        SplitCandidate candidate = queue.top();
+        queue.pop();
+        if (candidate.version != versions[candidate.triangle])
+            continue;
+
+        // follow the longest-edge propagation path to an edge that is longest in all
+        // triangles sharing it, bisecting neighbors on shorter edges would grow needles
+        uint32_t current = candidate.triangle;
+        uint32_t a, b;
+        for (;;) {
+            float length2;
+            int edge = longest_edge(current, length2);
+            a = tris[current][edge];
+            b = tris[current][(edge + 1) % 3];
+            incident.clear();
+            for (uint32_t t : vertex_triangles[a])
+                if (tris[t].x == b || tris[t].y == b || tris[t].z == b)
+                    incident.push_back(t);
+            uint32_t next = current;
+            for (uint32_t t : incident) {
+                float neighbor_length2;
+                longest_edge(t, neighbor_length2);
+                if (neighbor_length2 > length2) {
+                    next = t;
+                    break;
+                }
+            }
+            if (next == current)
+                break;
+            current = next;
+        }
+        if (added + incident.size() > budget)
+            break;
+
+        uint32_t m = uint32_t(points.size());
+        points.push_back(0.5f * (points[a] + points[b]));
+        result.midpoint_parents.push_back(glm::uvec2(a, b));
+        vertex_triangles.emplace_back();
+        ++result.split_edges;
+
+        for (uint32_t s : incident) {
+            glm::uvec3 st = tris[s];
+            int i = 0;
+            while (!((st[i] == a && st[(i + 1) % 3] == b) || (st[i] == b && st[(i + 1) % 3] == a)))
+                ++i;
+            uint32_t v0 = st[i], v1 = st[(i + 1) % 3], v2 = st[(i + 2) % 3];
+            glm::mat3 sc = corners[s];
+            glm::vec3 bm = 0.5f * (sc[i] + sc[(i + 1) % 3]);
+
+            // (v0, v1, v2) becomes (v0, m, v2) in place and (m, v1, v2) appended
+            uint32_t t = uint32_t(tris.size());
+            tris[s] = glm::uvec3(v0, m, v2);
+            tris.push_back(glm::uvec3(m, v1, v2));
+            corners[s] = glm::mat3(sc[i], bm, sc[(i + 2) % 3]);
+            corners.push_back(glm::mat3(bm, sc[(i + 1) % 3], sc[(i + 2) % 3]));
+            sources.push_back(sources[s]);
+            ++versions[s];
+            versions.push_back(0);
+
+            // with v1 == v2, slot s keeps its reference to the vertex
+            if (v1 != v2) {
+                std::replace(vertex_triangles[v1].begin(), vertex_triangles[v1].end(), s, t);
+                vertex_triangles[v2].push_back(t);
+            }
+            else
+                vertex_triangles[v1].push_back(t);
+            vertex_triangles[m].push_back(s);
+            vertex_triangles[m].push_back(t);
+            ++added;
+        }
+        for (uint32_t s : incident)
+            consider(s);
+        for (uint32_t t = uint32_t(tris.size() - incident.size()); t < uint32_t(tris.size()); ++t)
+            consider(t);
+        // the candidate itself is not split yet if the path led elsewhere
+        if (versions[candidate.triangle] == candidate.version)
+            queue.push(candidate);
+    }
+
+    // keep the pieces of each source triangle together, in the source order
+    std::vector<uint32_t> order(tris.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&sources](uint32_t x, uint32_t y) { return sources[x] < sources[y]; });
+    result.triangles.resize(tris.size());
+    result.source_triangles.resize(tris.size());
+    result.corner_barycentrics.resize(3 * tris.size());
+    for (size_t j = 0; j < order.size(); ++j) {
+        result.triangles[j] = tris[order[j]];
+        result.source_triangles[j] = sources[order[j]];
+        for (int k = 0; k < 3; ++k)
+            result.corner_barycentrics[3 * j + k] = corners[order[j]][k];
+    }
+    return result;
+}
+
+namespace {
+
+// vertex attributes of a triangle corner interpolated within the source triangle
+uint64_t interpolate_normal_uv(uint64_t const (&c)[3], glm::vec3 const& b) {
+    glm::vec3 n = b.x * glsl::dequantize_normal(uint32_t(c[0]))
+                + b.y * glsl::dequantize_normal(uint32_t(c[1]))
+                + b.z * glsl::dequantize_normal(uint32_t(c[2]));
+    float length = glm::length(n);
+    n = length > 0.0f ? n / length : glsl::dequantize_normal(uint32_t(c[0]));
+    // uvs wrap at 16 bits, interpolate the differences to the first corner
+    uint32_t uv = 0;
+    for (int shift = 0; shift < 32; shift += 16) {
+        int u0 = int(uint32_t(c[0] >> 32) >> shift) & 0xFFFF;
+        int d1 = int(int16_t(uint16_t((uint32_t(c[1] >> 32) >> shift) - u0)));
+        int d2 = int(int16_t(uint16_t((uint32_t(c[2] >> 32) >> shift) - u0)));
+        int u = u0 + int(std::lround(b.y * float(d1) + b.z * float(d2)));
+        uv |= uint32_t(u & 0xFFFF) << shift;
+    }
+    return uint64_t(quantize_normal(n)) | (uint64_t(uv) << 32);
+}
+
+uint64_t quantized_midpoint(uint64_t p, uint64_t q) {
+    uint64_t m = 0;
+    for (int shift = 0; shift < 63; shift += 21)
+        m |= ((((p >> shift) & 0x1FFFFF) + ((q >> shift) & 0x1FFFFF)) / 2) << shift;
+    return m;
+}
+
+} // namespace
+
+bool split_oversized_triangles(Mesh& mesh, ParameterizedMesh& pm, TriangleSplitParams const& params) {
+    if (mesh.flags & (Mesh::Dynamic | Mesh::SubtlyDynamic | Mesh::Skinned))
+        return false;
+    for (auto const& shader : mesh.mesh_shader_names)
+        if (!shader.empty())
+            return false;
+    if (pm.per_triangle_materials() && pm.num_triangle_material_ids() < mesh.num_tris())
+        return false;
+
+    std::vector<uint32_t> ids;
+    if (pm.per_triangle_materials()) {
+        ids.resize(pm.num_triangle_material_ids());
+        dequantize_material_ids(ids.data(), ids.size(), pm.triangle_material_ids.data(), uint32_t(pm.material_id_bitcount));
+    }
+    std::vector<uint32_t> split_ids;
+    float mesh_diagonal = glm::length(mesh_bounds(mesh).extent());
+
+    bool changed = false;
+    size_t tri_base = 0;
+    for (auto& geom : mesh.geometries) {
+        int tri_count = geom.num_tris();
+        size_t geom_tri_base = tri_base;
+        tri_base += size_t(tri_count);
+        auto keep_ids = [&]() {
+            if (!ids.empty())
+                split_ids.insert(split_ids.end(), ids.begin() + geom_tri_base, ids.begin() + geom_tri_base + tri_count);
+        };
+        bool unrolled = (geom.format_flags & Geometry::NoIndices) == Geometry::NoIndices;
+        if (tri_count == 0 || !geom.blend_attributes.empty() || ((geom.format_flags & Geometry::ImplicitIndices) && !unrolled)) {
+            keep_ids();
+            continue;
+        }
+        bool quantized_positions = (geom.format_flags & Geometry::QuantizedPositions) != 0;
+        bool quantized_attributes = (geom.format_flags & Geometry::QuantizedNormalsAndUV) != 0;
+
+        int vertex_count = geom.num_verts();
+        std::vector<glm::vec3> positions(vertex_count);
+        geom.get_vertex_positions(positions.data());
+        auto corner_vertex = [&](int tri, int k) -> uint32_t {
+            return unrolled ? uint32_t(3 * tri + k) : geom.indices.data()[tri][k];
+        };
+
+        // weld vertices with equal stored positions, such that splits propagate across
+        // attribute seams and unrolled triangles
+        auto position_key = [&](uint32_t v) -> std::array<uint32_t, 3> {
+            std::array<uint32_t, 3> key = { };
+            if (quantized_positions) {
+                uint64_t q = geom.vertices.as_range<uint64_t>().first[v];
+                key[0] = uint32_t(q);
+                key[1] = uint32_t(q >> 32);
+            }
+            else
+                memcpy(key.data(), &geom.vertices.as_range<glm::vec3>().first[v], sizeof(key));
+            return key;
+        };
+        std::vector<uint32_t> vertex_order(vertex_count);
+        std::iota(vertex_order.begin(), vertex_order.end(), 0u);
+        std::sort(vertex_order.begin(), vertex_order.end(), [&](uint32_t x, uint32_t y) {
+            return position_key(x) < position_key(y);
+        });
+        std::vector<uint32_t> welded(vertex_count);
+        std::vector<uint32_t> representatives;
+        for (int i = 0; i < vertex_count; ++i) {
+            if (i == 0 || position_key(vertex_order[i]) != position_key(vertex_order[i - 1]))
+                representatives.push_back(vertex_order[i]);
+            welded[vertex_order[i]] = uint32_t(representatives.size() - 1);
+        }
+        std::vector<glm::vec3> welded_positions(representatives.size());
+        for (size_t i = 0; i < representatives.size(); ++i)
+            welded_positions[i] = positions[representatives[i]];
+        std::vector<glm::uvec3> welded_tris(tri_count);
+        for (int i = 0; i < tri_count; ++i)
+            welded_tris[i] = glm::uvec3(welded[corner_vertex(i, 0)], welded[corner_vertex(i, 1)], welded[corner_vertex(i, 2)]);
+
+        TriangleSplit split = split_triangles(welded_positions.data(), uint32_t(welded_positions.size())
+            , welded_tris.data(), uint32_t(tri_count), mesh_diagonal, params);
+        if (split.split_edges == 0) {
+            keep_ids();
+            continue;
+        }
+
+        // positions of welded and appended vertices, midpoints are shared by all triangles
+        std::vector<uint64_t> split_quantized;
+        std::vector<glm::vec3> split_positions;
+        if (quantized_positions) {
+            split_quantized.resize(representatives.size());
+            for (size_t i = 0; i < representatives.size(); ++i)
+                split_quantized[i] = geom.vertices.as_range<uint64_t>().first[representatives[i]];
+            for (glm::uvec2 parents : split.midpoint_parents)
+                split_quantized.push_back(quantized_midpoint(split_quantized[parents.x], split_quantized[parents.y]));
+        }
+        else {
+            split_positions = welded_positions;
+            for (glm::uvec2 parents : split.midpoint_parents)
+                split_positions.push_back(0.5f * (split_positions[parents.x] + split_positions[parents.y]));
+        }
+
+        bool has_normals = !geom.normals.empty();
+        bool has_uvs = !quantized_attributes && !geom.uvs.empty();
+        std::vector<uint64_t> out_quantized, out_normal_uvs;
+        std::vector<glm::vec3> out_positions, out_normals;
+        std::vector<glm::vec2> out_uvs;
+        std::vector<glm::uvec3> out_indices;
+        if (!unrolled) {
+            // indexed geometries keep their vertices, split corners are appended
+            if (quantized_positions)
+                out_quantized.assign(geom.vertices.as_range<uint64_t>().first, geom.vertices.as_range<uint64_t>().last);
+            else
+                out_positions.assign(geom.vertices.as_range<glm::vec3>().first, geom.vertices.as_range<glm::vec3>().last);
+            if (has_normals && quantized_attributes)
+                out_normal_uvs.assign(geom.normals.as_range<uint64_t>().first, geom.normals.as_range<uint64_t>().last);
+            else if (has_normals)
+                out_normals.assign(geom.normals.as_range<glm::vec3>().first, geom.normals.as_range<glm::vec3>().last);
+            if (has_uvs)
+                out_uvs.assign(geom.uvs.as_range<glm::vec2>().first, geom.uvs.as_range<glm::vec2>().last);
+        }
+
+        auto append_vertex = [&](uint32_t welded_vertex, uint32_t source, glm::vec3 const& b) -> uint32_t {
+            uint32_t index = uint32_t(quantized_positions ? out_quantized.size() : out_positions.size());
+            if (quantized_positions)
+                out_quantized.push_back(split_quantized[welded_vertex]);
+            else
+                out_positions.push_back(split_positions[welded_vertex]);
+            uint32_t c[3] = { corner_vertex(source, 0), corner_vertex(source, 1), corner_vertex(source, 2) };
+            if (has_normals && quantized_attributes) {
+                auto nuvs = geom.normals.as_range<uint64_t>().first;
+                uint64_t corners[3] = { nuvs[c[0]], nuvs[c[1]], nuvs[c[2]] };
+                out_normal_uvs.push_back(interpolate_normal_uv(corners, b));
+            }
+            else if (has_normals) {
+                auto normals = geom.normals.as_range<glm::vec3>().first;
+                out_normals.push_back(b.x * normals[c[0]] + b.y * normals[c[1]] + b.z * normals[c[2]]);
+            }
+            if (has_uvs) {
+                auto uvs = geom.uvs.as_range<glm::vec2>().first;
+                out_uvs.push_back(b.x * uvs[c[0]] + b.y * uvs[c[1]] + b.z * uvs[c[2]]);
+            }
+            return index;
+        };
+
+        std::unordered_map<uint64_t, uint32_t> split_corners;
+        for (size_t j = 0; j < split.triangles.size(); ++j) {
+            uint32_t source = split.source_triangles[j];
+            glm::uvec3 tri(0);
+            for (int k = 0; k < 3; ++k) {
+                glm::vec3 const& b = split.corner_barycentrics[3 * j + k];
+                uint32_t w = split.triangles[j][k];
+                if (unrolled) {
+                    append_vertex(w, source, b);
+                    continue;
+                }
+                // corners of the source triangle keep their vertex
+                int source_corner = b.x == 1.0f ? 0 : b.y == 1.0f ? 1 : b.z == 1.0f ? 2 : -1;
+                if (source_corner >= 0) {
+                    tri[k] = corner_vertex(source, source_corner);
+                    continue;
+                }
+                uint64_t key = (uint64_t(w) << 32) | source;
+                auto it = split_corners.find(key);
+                if (it == split_corners.end())
+                    it = split_corners.emplace(key, append_vertex(w, source, b)).first;
+                tri[k] = it->second;
+            }
+            if (!unrolled)
+                out_indices.push_back(tri);
+            if (!ids.empty())
+                split_ids.push_back(ids[geom_tri_base + source]);
+        }
+
+        if (quantized_positions)
+            geom.vertices = mapped_vector<void>(GenericBuffer(std::move(out_quantized)));
+        else
+            geom.vertices = mapped_vector<void>(GenericBuffer(std::move(out_positions)));
+        if (has_normals && quantized_attributes) {
+            geom.normals = mapped_vector<void>(GenericBuffer(std::move(out_normal_uvs)));
+            // quantized uvs share the normal buffer
+            geom.uvs = geom.normals;
+        }
+        else if (has_normals)
+            geom.normals = mapped_vector<void>(GenericBuffer(std::move(out_normals)));
+        if (has_uvs)
+            geom.uvs = mapped_vector<void>(GenericBuffer(std::move(out_uvs)));
+        if (!unrolled)
+            geom.indices = mapped_vector<glm::uvec3>(std::move(out_indices));
+        geom.meshlets = { };
+        changed = true;
+    }
+    if (!changed)
+        return false;
+
+    if (!ids.empty()) {
+        switch (pm.material_id_bitcount) {
+        case 8:
+            pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint8_t>(split_ids.begin(), split_ids.end())));
+            break;
+        case 16:
+            pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint16_t>(split_ids.begin(), split_ids.end())));
+            break;
+        default:
+            pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::move(split_ids)));
+        }
+        // split triangles stay with their source, runs of sorted materials only grow
+        if (!pm.triangle_material_ranges.empty()) {
+            pm.triangle_material_ranges.clear();
+            size_t base = 0;
+            for (int geo_idx = 0, geo_end = mesh.num_geometries(); geo_idx < geo_end; ++geo_idx) {
+                int count = mesh.geometries[geo_idx].num_tris();
+                for (int i = 0; i < count; ) {
+                    TriangleMaterialRange range;
+                    range.geometry = geo_idx;
+                    range.triangle_offset = i;
+                    range.material_id = pm.triangle_material_id(index_t(base + i));
+                    while (i < count && pm.triangle_material_id(index_t(base + i)) == range.material_id)
+                        ++i;
+                    range.triangle_count = i - range.triangle_offset;
+                    pm.triangle_material_ranges.push_back(range);
+                }
+                base += size_t(count);
+            }
+        }
+    }
+    ++mesh.model_revision;
+    ++pm.materials_revision;
+    return true;
+}
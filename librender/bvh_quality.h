@@ -0,0 +1,86 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+
+struct Mesh;
+struct ParameterizedMesh;
+
+// Surface area heuristic estimates of acceleration structure quality. The driver builders
+// are approximated by a binned top-down SAH build over the primitive boxes, the cost of
+// the resulting hierarchy is the expected cost of a ray that hits the root box, with
+// node areas relative to the root area as hit probabilities.
+struct SahCostParams {
+    float node_cost = 1.0f;      // per traversed inner node
+    float primitive_cost = 1.0f; // per intersected primitive, unless given per primitive
+    int max_leaf_size = 4;
+    int bin_count = 16;
+};
+
+struct BvhQuality {
+    int primitive_count = 0;
+    int inner_node_count = 0;
+    int leaf_count = 0;
+    int max_depth = 0;
+    double sah_cost = 0.0;
+    // summed node areas relative to the root, large leaf areas indicate overlapping primitives
+    double inner_area = 0.0;
+    double leaf_area = 0.0;
+};
+
+BvhQuality estimate_bvh_quality(std::vector<Box> const& boxes, SahCostParams const& params = {}
+    , std::vector<float> const* primitive_costs = nullptr);
+
+// Boxes of all triangles of all geometries, as built into one BLAS
+std::vector<Box> mesh_triangle_bounds(Mesh const& mesh);
+
+// TLAS estimate over the world boxes of the given instances, a ray that reaches an
+// instance pays a node step for the transform plus the SAH cost of its BLAS
+BvhQuality estimate_tlas_quality(std::vector<Box> const& instance_bounds, std::vector<double> const& blas_costs
+    , SahCostParams const& params = {});
+
+// Splitting of triangles whose boxes are much larger than their area suggests, e.g.
+// long diagonal slivers in architectural models, which inflate the BLAS nodes they end up in
+struct TriangleSplitParams {
+    // split triangles whose box surface area exceeds this multiple of their own area,
+    // an axis-aligned right triangle has a ratio of 4
+    float max_area_ratio = 32.0f;
+    // keep triangles whose box diagonal is below this fraction of the mesh box diagonal; bisected
+    // slivers keep their ratio, such that this bounds how far they are refined
+    float min_relative_extent = 0.01f;
+    // at most this many added triangles per input triangle
+    float max_growth = 1.0f;
+};
+
+bool triangle_needs_split(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c
+    , float mesh_diagonal, TriangleSplitParams const& params);
+
+// Result of splitting an indexed triangle list: vertices from vertex_count on are appended
+// midpoints, the new triangles replace the input triangles and keep their winding
+struct TriangleSplit {
+    std::vector<glm::uvec2> midpoint_parents; // per appended vertex, parents may be appended vertices
+    std::vector<glm::uvec3> triangles;
+    std::vector<uint32_t> source_triangles; // per new triangle, ordered by source triangle
+    std::vector<glm::vec3> corner_barycentrics; // 3 per new triangle, within its source triangle
+    int split_edges = 0;
+};
+
+// Bisects the longest edges of the triangles that need splitting, largest boxes first, until
+// none do or the growth budget is used up. Edges are only bisected when they are longest in
+// all triangles sharing them (longest-edge propagation), the result stays watertight without
+// T-junctions.
+TriangleSplit split_triangles(glm::vec3 const* positions, uint32_t vertex_count
+    , glm::uvec3 const* triangles, uint32_t triangle_count, float mesh_diagonal, TriangleSplitParams const& params);
+
+// Applies split_triangles to the geometries of the mesh, welding vertices with equal positions
+// such that splits stay watertight across attribute seams. Vertex attributes are interpolated
+// within the source triangles, per-triangle materials of the parameterized mesh are repeated
+// for the split triangles and meshlets are cleared. Geometries with blend attributes are kept.
+// Returns false without changes for skinned or dynamic meshes, or if nothing needs splitting.
+// The mesh must not be shared with other parameterized meshes.
+bool split_oversized_triangles(Mesh& mesh, ParameterizedMesh& pm, TriangleSplitParams const& params = {});
@@ -0,0 +1,155 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "environment_map.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cstring>
+
+static int next_power_of_two(int n) {
+    int p = 1;
+    while (p < n)
+        p *= 2;
+    return p;
+}
+
+EnvironmentMap::EnvironmentMap(int width, int height, float const* rgb)
+    : width(width)
+    , height(height) {
+    if (width < 1 || height < 1)
+        throw_error("Invalid environment map dimensions %dx%d", width, height);
+    pyramid_width = next_power_of_two(width);
+    pyramid_height = next_power_of_two(height);
+    int levels = 1;
+    while (glsl::environment_map_level_dim(pyramid_width, levels - 1) > 1
+        || glsl::environment_map_level_dim(pyramid_height, levels - 1) > 1)
+        ++levels;
+    if (levels > ENVIRONMENT_MAP_MAX_LEVELS)
+        throw_error("Environment maps support up to %d pixels per dimension", 1 << (ENVIRONMENT_MAP_MAX_LEVELS - 1));
+
+    size_t texel_count = size_t(width) * height;
+    radiance.assign(rgb, rgb + 3 * texel_count);
+
+    // pyramid levels follow the radiance in the GPU buffer
+    uint32_t offset = uint32_t(3 * texel_count);
+    level_offsets.resize(levels);
+    for (int l = 0; l < levels; ++l) {
+        level_offsets[l] = offset;
+        offset += uint32_t(glsl::environment_map_level_dim(pyramid_width, l) * glsl::environment_map_level_dim(pyramid_height, l));
+    }
+    pyramid.assign(offset - level_offsets[0], 0.0f);
+
+    double total = 0.0;
+    for (int y = 0; y < height; ++y) {
+        float omega = glsl::environment_map_texel_solid_angle(y, width, height);
+        for (int x = 0; x < width; ++x) {
+            float const* c = &radiance[3 * (size_t(y) * width + x)];
+            float luminance = glsl::environment_map_luminance(c[0], c[1], c[2]);
+            float power = std::isfinite(luminance) ? luminance * omega : 0.0f;
+            pyramid[size_t(y) * pyramid_width + x] = power;
+            total += power;
+        }
+    }
+    total_power = float(total);
+
+    for (int l = 1; l < levels; ++l) {
+        int fine_w = glsl::environment_map_level_dim(pyramid_width, l - 1);
+        int fine_h = glsl::environment_map_level_dim(pyramid_height, l - 1);
+        int w = glsl::environment_map_level_dim(pyramid_width, l);
+        int h = glsl::environment_map_level_dim(pyramid_height, l);
+        float const* fine = &pyramid[level_offsets[l - 1] - level_offsets[0]];
+        float* coarse = &pyramid[level_offsets[l] - level_offsets[0]];
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x) {
+                float sum = 0.0f;
+                for (int fy = y * fine_h / h; fy < (y + 1) * fine_h / h; ++fy)
+                    for (int fx = x * fine_w / w; fx < (x + 1) * fine_w / w; ++fx)
+                        sum += fine[fy * fine_w + fx];
+                coarse[y * w + x] = sum;
+            }
+    }
+}
+
+int EnvironmentMap::texel(float dx, float dy, float dz) const {
+    return glsl::environment_map_texel(dx, dy, dz, width, height, 0.0f);
+}
+
+float EnvironmentMap::pdf(float dx, float dy, float dz) const {
+    if (empty())
+        return 0.0f;
+    int t = texel(dx, dy, dz);
+    int row = t / width;
+    float power = pyramid[size_t(row) * pyramid_width + (t - row * width)];
+    return glsl::environment_map_texel_density(power, total_power, row, width, height);
+}
+
+float EnvironmentMap::sample(float u, float v, float (&dir)[3]) const {
+    dir[0] = 0.0f;
+    dir[1] = 1.0f;
+    dir[2] = 0.0f;
+    if (empty() || !(total_power > 0.0f))
+        return 0.0f;
+    // descend from the root, choosing the row by v and the column by u, then reuse
+    // the rescaled numbers to place the direction within the texel
+    int x = 0, y = 0;
+    for (int l = level_count() - 2; l >= 0; --l) {
+        int w = glsl::environment_map_level_dim(pyramid_width, l);
+        int h = glsl::environment_map_level_dim(pyramid_height, l);
+        float const* level = &pyramid[level_offsets[l] - level_offsets[0]];
+        bool split_x = w > glsl::environment_map_level_dim(pyramid_width, l + 1);
+        bool split_y = h > glsl::environment_map_level_dim(pyramid_height, l + 1);
+        x = split_x ? 2 * x : x;
+        y = split_y ? 2 * y : y;
+        if (split_y) {
+            float upper = level[y * w + x] + (split_x ? level[y * w + x + 1] : 0.0f);
+            float lower = level[(y + 1) * w + x] + (split_x ? level[(y + 1) * w + x + 1] : 0.0f);
+            float p = upper / (upper + lower);
+            if (v < p || lower <= 0.0f)
+                v = std::min(v / p, 1.0f);
+            else {
+                v = std::min((v - p) / (1.0f - p), 1.0f);
+                ++y;
+            }
+        }
+        if (split_x) {
+            float left = level[y * w + x];
+            float right = level[y * w + x + 1];
+            float p = left / (left + right);
+            if (u < p || right <= 0.0f)
+                u = std::min(u / p, 1.0f);
+            else {
+                u = std::min((u - p) / (1.0f - p), 1.0f);
+                ++x;
+            }
+        }
+    }
+    float cos_theta = glsl::environment_map_texel_cos_theta(y, height, v);
+    float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = glsl::environment_map_texel_phi(x, width, u, 0.0f);
+    dir[0] = sin_theta * std::cos(phi);
+    dir[1] = cos_theta;
+    dir[2] = sin_theta * std::sin(phi);
+    return glsl::environment_map_texel_density(pyramid[size_t(y) * pyramid_width + x], total_power, y, width, height);
+}
+
+size_t EnvironmentMap::gpu_buffer_size() const {
+    return sizeof(glsl::EnvironmentMapHeader) + sizeof(float) * (radiance.size() + pyramid.size());
+}
+
+void EnvironmentMap::write_gpu_buffer(void* buffer) const {
+    auto header = (glsl::EnvironmentMapHeader*) buffer;
+    std::memset(header, 0, sizeof(*header));
+    header->width = uint32_t(width);
+    header->height = uint32_t(height);
+    header->pyramid_width = uint32_t(pyramid_width);
+    header->pyramid_height = uint32_t(pyramid_height);
+    header->level_count = uint32_t(level_count());
+    header->total_power = total_power;
+    for (int l = 0; l < level_count(); ++l)
+        header->level_offsets[l] = level_offsets[l];
+    auto data = (float*) (header + 1);
+    if (!empty()) {
+        std::memcpy(data, radiance.data(), sizeof(float) * radiance.size());
+        std::memcpy(data + radiance.size(), pyramid.data(), sizeof(float) * pyramid.size());
+    }
+}
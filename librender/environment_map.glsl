@@ -0,0 +1,89 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef ENVIRONMENT_MAP_H_GLSL
+#define ENVIRONMENT_MAP_H_GLSL
+
+// Equirectangular environment map with hierarchical importance sampling, shared by the
+// integrators (vulkan/environment_map.glsl) and the CPU construction in environment_map.h.
+// Rows are stored top row (zenith, +y) first, columns run along phi = atan(z, x).
+// Sampling descends a sum pyramid over the texel powers (luminance times solid angle),
+// whose finest level is the texel grid padded with zeros to power-of-two dimensions.
+// Within a texel, directions are uniform in phi and cos(theta), such that the density
+// of sampled directions is proportional to the luminance of the map.
+
+#define ENVIRONMENT_MAP_MAX_LEVELS 16
+
+#define ENVIRONMENT_MAP_PI 3.14159265358979323846f
+#ifndef ENVIRONMENT_MAP_ATAN2
+    #define ENVIRONMENT_MAP_ATAN2(y, x) atan(y, x)
+#endif
+
+// The map buffer holds the header followed by a float array with the RGB radiance of
+// all texels and, starting at level_offsets[0], the levels of the pyramid
+struct EnvironmentMapHeader {
+    uint32_t width;
+    uint32_t height;
+    // dimensions of the finest pyramid level, coarser levels halve down to 1
+    uint32_t pyramid_width;
+    uint32_t pyramid_height;
+    uint32_t level_count;
+    // sum of luminance times solid angle over all texels
+    float total_power;
+    uint32_t _pad0;
+    uint32_t _pad1;
+    uint32_t level_offsets[ENVIRONMENT_MAP_MAX_LEVELS];
+};
+
+inline float environment_map_luminance(float r, float g, float b) {
+    float l = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    return l > 0.0f ? l : 0.0f;
+}
+
+inline int environment_map_level_dim(int finest_dim, int level) {
+    int d = finest_dim >> level;
+    return d > 1 ? d : 1;
+}
+
+inline float environment_map_row_cos_theta(int row, int height) {
+    return cos(ENVIRONMENT_MAP_PI * float(row) / float(height));
+}
+
+inline float environment_map_texel_solid_angle(int row, int width, int height) {
+    float omega = (environment_map_row_cos_theta(row, height) - environment_map_row_cos_theta(row + 1, height))
+        * (2.0f * ENVIRONMENT_MAP_PI / float(width));
+    return omega > 0.0f ? omega : 0.0f;
+}
+
+// index of the texel seen along the (normalized) direction, the map is rotated by
+// the given angle around the y axis
+inline int environment_map_texel(float x, float y, float z, int width, int height, float rotation) {
+    float phi = ENVIRONMENT_MAP_ATAN2(z, x) - rotation;
+    float u = phi * (0.5f / ENVIRONMENT_MAP_PI);
+    u -= floor(u);
+    float cos_theta = y < -1.0f ? -1.0f : y < 1.0f ? y : 1.0f;
+    float v = acos(cos_theta) / ENVIRONMENT_MAP_PI;
+    int col = int(u * float(width));
+    int row = int(v * float(height));
+    col = col < 0 ? 0 : col < width ? col : width - 1;
+    row = row < 0 ? 0 : row < height ? row : height - 1;
+    return row * width + col;
+}
+
+// direction within a texel from two uniform numbers, as cos(theta) and phi
+inline float environment_map_texel_cos_theta(int row, int height, float v) {
+    float c0 = environment_map_row_cos_theta(row, height);
+    float c1 = environment_map_row_cos_theta(row + 1, height);
+    return c0 + (c1 - c0) * v;
+}
+inline float environment_map_texel_phi(int col, int width, float u, float rotation) {
+    return 2.0f * ENVIRONMENT_MAP_PI * (float(col) + u) / float(width) + rotation;
+}
+
+// solid angle density of directions in a texel of the given power
+inline float environment_map_texel_density(float texel_power, float total_power, int row, int width, int height) {
+    float omega = environment_map_texel_solid_angle(row, width, height);
+    return total_power > 0.0f && omega > 0.0f ? texel_power / (total_power * omega) : 0.0f;
+}
+
+#endif
@@ -0,0 +1,47 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define ENVIRONMENT_MAP_ATAN2(y, x) std::atan2(y, x)
+namespace glsl {
+    #include "environment_map.glsl"
+}
+
+// Equirectangular HDR environment map (environment_map.glsl) with the sum pyramid that
+// the integrators descend to importance sample directions in proportion to luminance.
+// Directions here are in the frame of the map, the renderer applies the rotation.
+
+struct EnvironmentMap {
+    int width = 0;
+    int height = 0;
+    // RGB radiance, top row first
+    std::vector<float> radiance;
+    // levels of texel powers, finest first, see EnvironmentMapHeader::level_offsets
+    std::vector<float> pyramid;
+    int pyramid_width = 0;
+    int pyramid_height = 0;
+    std::vector<uint32_t> level_offsets;
+    float total_power = 0.0f;
+
+    EnvironmentMap() = default;
+    // builds the sampling pyramid for the given RGB radiance, top row first
+    EnvironmentMap(int width, int height, float const* rgb);
+
+    bool empty() const { return width == 0; }
+    int level_count() const { return (int) level_offsets.size(); }
+
+    int texel(float dx, float dy, float dz) const;
+    float pdf(float dx, float dy, float dz) const;
+    // samples a direction from two uniform numbers, returns its density
+    float sample(float u, float v, float (&dir)[3]) const;
+
+    // layout of the map buffer read by the integrators, an empty map only writes the header
+    size_t gpu_buffer_size() const;
+    void write_gpu_buffer(void* buffer) const;
+};
@@ -0,0 +1,250 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "geometry_paging.h"
+#include "instance_bounds.h"
+#include "parallel.h"
+#include "types.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+Sphere box_sphere(const Box &box) {
+    if (box.empty())
+        return Sphere(glm::vec3(0.0f), 0.0f);
+    return Sphere(0.5f * (box.lower + box.upper), 0.5f * glm::length(box.extent()));
+}
+
+Box sphere_box(const Sphere &sphere) {
+    return Box(sphere.origin - sphere.radius, sphere.origin + sphere.radius);
+}
+
+// distance at which a LoD with the given detail reduction becomes active, see LoDUtils
+float lod_distance_scale(float detail_reduction) {
+    return detail_reduction < 1.0f ? 1.0f / (1.0f - detail_reduction) : FLT_MAX;
+}
+
+} // namespace
+
+void GeometryPager::reset(const Scene &scene, GeometryPagingParams const& params, double time) {
+    this->params = params;
+    int mesh_count = ilen(scene.meshes);
+    mesh_pages.assign(mesh_count, -1);
+    mesh_bytes.resize(mesh_count);
+    for (int i = 0; i < mesh_count; ++i)
+        mesh_bytes[i] = size_t(scene.meshes[i].num_tris()) * params.bytes_per_triangle;
+
+    InstanceBoundsTracker tracker;
+    tracker.reset(scene, time);
+
+    std::vector<GeometryPageReference> unsorted_references;
+    for (int i = 0, ie = ilen(scene.instances); i < ie; ++i) {
+        int pm_id = scene.instances[i].parameterized_mesh_id;
+        glm::mat4 const& transform = tracker.transforms[i];
+        LodGroup const& lod_group = tracker.lod_groups[pm_id];
+
+        GeometryPageReference ref;
+        if (lod_group.mesh_ids.empty()) {
+            ref.mesh_id = scene.parameterized_meshes[pm_id].mesh_id;
+            ref.bounds = box_sphere(tracker.local_bounds[pm_id].transformed(transform));
+            unsorted_references.push_back(ref);
+            continue;
+        }
+
+        // LoD distances relate to the bounds of the whole group
+        Box group_bounds;
+        for (int member_id : lod_group.mesh_ids)
+            group_bounds += tracker.local_bounds[member_id].transformed(transform);
+        ref.bounds = box_sphere(group_bounds);
+        ref.lod_count = ilen(lod_group.mesh_ids);
+        for (int j = 0; j < ref.lod_count; ++j) {
+            ref.mesh_id = scene.parameterized_meshes[lod_group.mesh_ids[j]].mesh_id;
+            ref.lod_level = j;
+            ref.lod_begin = j > 0 ? lod_distance_scale(lod_group.detail_reduction[j]) : 0.0f;
+            ref.lod_end = j + 1 < ref.lod_count ? lod_distance_scale(lod_group.detail_reduction[j + 1]) : FLT_MAX;
+            unsorted_references.push_back(ref);
+        }
+    }
+
+    // world bounds of all uses of each mesh, dynamic meshes are never paged
+    std::vector<Box> world_bounds(mesh_count);
+    Box scene_bounds;
+    for (auto const& ref : unsorted_references) {
+        Box box = sphere_box(ref.bounds);
+        world_bounds[ref.mesh_id] += box;
+        scene_bounds += box;
+    }
+    std::vector<int> paged_meshes;
+    std::vector<uint32_t> morton_codes(mesh_count);
+    for (int i = 0; i < mesh_count; ++i) {
+        if (scene.meshes[i].flags & (Mesh::Dynamic | Mesh::SubtlyDynamic))
+            continue;
+        paged_meshes.push_back(i);
+        morton_codes[i] = centroid_morton_code(world_bounds[i], scene_bounds);
+    }
+    std::stable_sort(paged_meshes.begin(), paged_meshes.end(), [&](int a, int b) {
+        return morton_codes[a] < morton_codes[b];
+    });
+
+    // fill pages along the space-filling curve
+    pages.clear();
+    for (int mesh_id : paged_meshes) {
+        if (pages.empty() || (!pages.back().mesh_ids.empty()
+                && pages.back().bytes + mesh_bytes[mesh_id] > params.page_bytes))
+            pages.emplace_back();
+        GeometryPage& page = pages.back();
+        page.mesh_ids.push_back(mesh_id);
+        page.bounds += world_bounds[mesh_id];
+        page.bytes += mesh_bytes[mesh_id];
+        mesh_pages[mesh_id] = ilen(pages) - 1;
+    }
+
+    // group references by page
+    int page_count = ilen(pages);
+    for (auto const& ref : unsorted_references)
+        if (mesh_pages[ref.mesh_id] >= 0)
+            ++pages[mesh_pages[ref.mesh_id]].reference_count;
+    int reference_offset = 0;
+    for (auto& page : pages) {
+        page.reference_offset = reference_offset;
+        reference_offset += page.reference_count;
+        page.reference_count = 0;
+    }
+    references.resize(reference_offset);
+    for (auto const& ref : unsorted_references)
+        if (int page_idx = mesh_pages[ref.mesh_id]; page_idx >= 0) {
+            GeometryPage& page = pages[page_idx];
+            references[page.reference_offset + page.reference_count++] = ref;
+        }
+
+    resident.assign(page_count, 0);
+    priorities.assign(page_count, 0.0f);
+    last_requested.assign(page_count, 0);
+    resident_bytes = 0;
+    update_count = 0;
+    loaded_pages.clear();
+    evicted_pages.clear();
+    missing_pages = 0;
+}
+
+bool GeometryPager::update(glm::vec3 camera_position, float fov_y, int lod_offset) {
+    ++update_count;
+    loaded_pages.clear();
+    evicted_pages.clear();
+    missing_pages = 0;
+    int page_count = ilen(pages);
+    if (!enabled() || page_count == 0)
+        return false;
+
+    float tan_half_fov = std::tan(glm::radians(fov_y) * 0.5f);
+    parallel_for(page_count, [&](int page_idx) {
+        GeometryPage const& page = pages[page_idx];
+        float priority = 0.0f;
+        for (int i = page.reference_offset, ie = i + page.reference_count; i < ie; ++i) {
+            GeometryPageReference const& ref = references[i];
+            float distance = glm::length(camera_position - ref.bounds.origin);
+            if (lod_offset >= 0) {
+                if (ref.lod_level != std::min(lod_offset, ref.lod_count - 1))
+                    continue;
+            }
+            else if (ref.lod_count > 1) {
+                float lod_unit = ref.bounds.radius / tan_half_fov;
+                if (distance * params.lod_margin < ref.lod_begin * lod_unit
+                    || distance >= ref.lod_end * lod_unit * params.lod_margin)
+                    continue;
+            }
+            // fraction of the screen height covered by the bounds, 1 inside
+            float nearest = std::max(distance - ref.bounds.radius, 0.0f);
+            float size = ref.bounds.radius / (tan_half_fov * nearest + ref.bounds.radius);
+            if (size >= params.min_screen_size)
+                priority = std::max(size, priority);
+        }
+        priorities[page_idx] = priority;
+        if (priority > 0.0f)
+            last_requested[page_idx] = update_count;
+    }, 0, 64);
+
+    // requested pages by importance, resident pages are preferred by the hysteresis factor;
+    // resident pages that are no longer requested are kept while there is space, least recently used first out
+    std::vector<int> order;
+    for (int i = 0; i < page_count; ++i)
+        if (priorities[i] > 0.0f || resident[i])
+            order.push_back(i);
+    auto rank = [&](int i) {
+        return resident[i] ? priorities[i] * params.eviction_hysteresis : priorities[i];
+    };
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        float rank_a = rank(a), rank_b = rank(b);
+        if (rank_a != rank_b)
+            return rank_a > rank_b;
+        if (last_requested[a] != last_requested[b])
+            return last_requested[a] > last_requested[b];
+        return a < b;
+    });
+
+    std::vector<char> keep(page_count, 0);
+    size_t available_bytes = params.budget_bytes;
+    size_t load_bytes = 0;
+    for (int page_idx : order) {
+        size_t bytes = pages[page_idx].bytes;
+        bool fits = bytes <= available_bytes;
+        if (fits && !resident[page_idx] && params.max_load_bytes > 0
+                && !loaded_pages.empty() && load_bytes + bytes > params.max_load_bytes)
+            fits = false;
+        if (!fits) {
+            if (!resident[page_idx])
+                ++missing_pages;
+            continue;
+        }
+        keep[page_idx] = 1;
+        available_bytes -= bytes;
+        if (!resident[page_idx]) {
+            loaded_pages.push_back(page_idx);
+            load_bytes += bytes;
+        }
+    }
+
+    for (int i = 0; i < page_count; ++i)
+        if (resident[i] && !keep[i]) {
+            evicted_pages.push_back(i);
+            resident[i] = 0;
+            resident_bytes -= pages[i].bytes;
+        }
+    for (int page_idx : loaded_pages) {
+        resident[page_idx] = 1;
+        resident_bytes += pages[page_idx].bytes;
+    }
+
+    return !loaded_pages.empty() || !evicted_pages.empty();
+}
+
+bool GeometryPager::mesh_resident(int mesh_id) const {
+    if (!enabled() || mesh_id >= ilen(mesh_pages))
+        return true;
+    int page_idx = mesh_pages[mesh_id];
+    return page_idx < 0 || resident[page_idx];
+}
+
+void GeometryPager::set_mesh_bytes(int mesh_id, size_t bytes) {
+    int page_idx = mesh_pages[mesh_id];
+    if (page_idx >= 0) {
+        GeometryPage& page = pages[page_idx];
+        page.bytes = page.bytes - mesh_bytes[mesh_id] + bytes;
+        if (resident[page_idx])
+            resident_bytes = resident_bytes - mesh_bytes[mesh_id] + bytes;
+    }
+    mesh_bytes[mesh_id] = bytes;
+}
+
+void advise_mesh_residency(const Mesh &mesh, bool will_need) {
+    for (auto const& geom : mesh.geometries) {
+        geom.vertices.advise(will_need);
+        geom.indices.advise(will_need);
+        geom.normals.advise(will_need);
+        // quantized uvs share the normal buffer
+        if (!(geom.format_flags & Geometry::QuantizedNormalsAndUV))
+            geom.uvs.advise(will_need);
+        geom.blend_attributes.advise(will_need);
+    }
+}
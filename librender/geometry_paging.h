@@ -0,0 +1,87 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+#include "scene.h"
+
+struct GeometryPagingParams {
+    // bytes of all resident pages, 0 disables paging
+    size_t budget_bytes = 0;
+    // meshes are grouped into pages of about this size
+    size_t page_bytes = size_t(16) << 20;
+    // size of a mesh until its actual size is known, e.g. uploaded vertices and BLAS
+    size_t bytes_per_triangle = 128;
+    // instances that cover less of the screen height do not request their pages
+    float min_screen_size = 0.002f;
+    // LoD distance ranges are widened by this factor, to load LoDs before they become active
+    float lod_margin = 1.25f;
+    // resident pages are only replaced by pages that are this much more important
+    float eviction_hysteresis = 1.5f;
+    // bytes loaded per update, 0 = unlimited (at least one page is always loaded)
+    size_t max_load_bytes = 0;
+};
+
+// One use of a mesh by an instance, limited to the camera distances where its LoD is active
+struct GeometryPageReference {
+    int mesh_id = -1;
+    Sphere bounds = Sphere(glm::vec3(0.0f), 0.0f); // world space, whole LoD group for LoD members
+    // LoD distance range in units of bounds.radius / tan(fov_y / 2), as in LoDUtils
+    float lod_begin = 0.0f;
+    float lod_end = FLT_MAX;
+    int lod_level = 0;
+    int lod_count = 1;
+};
+
+struct GeometryPage {
+    std::vector<int> mesh_ids;
+    Box bounds; // world space, all instances of all meshes on the page
+    size_t bytes = 0;
+    int reference_offset = 0;
+    int reference_count = 0;
+};
+
+// Groups static meshes into spatially coherent pages and decides which pages stay resident
+// under a memory budget. Pages are requested by the apparent size of the instances that use
+// them, counting only instances whose LoD is active at their distance from the camera.
+// Dynamic meshes are always resident and not part of any page. The pager only tracks
+// residency, loading and evicting the listed pages is up to the caller.
+struct GeometryPager {
+    GeometryPagingParams params;
+    std::vector<GeometryPage> pages;
+    std::vector<GeometryPageReference> references; // grouped by page
+    std::vector<int> mesh_pages; // -1 for meshes that are always resident
+    std::vector<size_t> mesh_bytes;
+
+    std::vector<char> resident;
+    std::vector<float> priorities; // apparent size of each page in the last update
+    std::vector<uint64_t> last_requested;
+    size_t resident_bytes = 0;
+    uint64_t update_count = 0;
+
+    // results of the last update
+    std::vector<int> loaded_pages;
+    std::vector<int> evicted_pages;
+    int missing_pages = 0; // requested, but neither resident nor loaded
+
+    bool enabled() const { return params.budget_bytes > 0; }
+    // Builds pages from the instances at the given time, nothing is resident afterwards
+    void reset(const Scene &scene, GeometryPagingParams const& params, double time = 0.0);
+    // Selects resident pages for the camera, a negative LoD offset selects LoDs by distance,
+    // otherwise only the members that active_lod_member picks for the offset are requested.
+    // Returns true if any pages were loaded or evicted.
+    bool update(glm::vec3 camera_position, float fov_y, int lod_offset = -1);
+
+    bool mesh_resident(int mesh_id) const;
+    // Replaces the estimated size of a mesh, e.g. by the size of its compacted BLAS
+    void set_mesh_bytes(int mesh_id, size_t bytes);
+};
+
+// Residency hint for the file-backed geometry data of a mesh, see FileMapping::advise
+void advise_mesh_residency(const Mesh &mesh, bool will_need);
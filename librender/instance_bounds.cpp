@@ -0,0 +1,187 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "instance_bounds.h"
+#include "types.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+Box mesh_bounds(const Mesh &mesh) {
+    Box bounds;
+    for (auto& geo : mesh.geometries)
+        bounds += Box(geo.base, geo.base + geo.extent);
+    return bounds;
+}
+
+int active_lod_member(const LodGroup &lod_group, int parameterized_mesh_id, int lod_offset) {
+    if (lod_group.mesh_ids.empty())
+        return parameterized_mesh_id;
+    return lod_group.mesh_ids[std::min(std::max(lod_offset, 0), ilen(lod_group.mesh_ids) - 1)];
+}
+
+void InstanceBoundsTracker::reset(const Scene &scene, double time, int lod_offset) {
+    animation_data = scene.animation_data;
+
+    int pm_count = ilen(scene.parameterized_meshes);
+    lod_groups.resize(pm_count);
+    local_bounds.resize(pm_count);
+    for (int i = 0; i < pm_count; ++i) {
+        auto& pm = scene.parameterized_meshes[i];
+        auto& lod_group = scene.lod_groups[pm.lod_group];
+        // only the leading LoD holds the group, LoD members are never instanced directly
+        if (pm.lod_group && !lod_group.mesh_ids.empty() && lod_group.mesh_ids[0] == i)
+            lod_groups[i] = lod_group;
+        else
+            lod_groups[i] = { };
+        local_bounds[i] = mesh_bounds(scene.meshes[pm.mesh_id]);
+    }
+
+    int instance_count = ilen(scene.instances);
+    instances.resize(instance_count);
+    animated_instance_count = 0;
+    for (int i = 0; i < instance_count; ++i) {
+        auto& inst = scene.instances[i];
+        auto& anim = animation_data.at(inst.animation_data_index);
+        InstanceRef& ref = instances[i];
+        ref.animation_data_index = inst.animation_data_index;
+        ref.transform_index = inst.transform_index;
+        ref.parameterized_mesh_id = inst.parameterized_mesh_id;
+        ref.animated = anim.is_animated() && inst.transform_index >= anim.numStaticTransforms;
+        animated_instance_count += int(ref.animated);
+    }
+
+    frames.resize(animation_data.size());
+    for (int i = 0, ie = ilen(animation_data); i < ie; ++i)
+        frames[i] = animation_data[i].frame_at_time(time);
+    this->lod_offset = lod_offset;
+
+    transforms.resize(instance_count);
+    active_meshes.resize(instance_count);
+    world_bounds.resize(instance_count);
+    for (int i = 0; i < instance_count; ++i)
+        evaluate_instance(i);
+}
+
+int InstanceBoundsTracker::update(double time, int lod_offset) {
+    bool lod_changed = lod_offset != this->lod_offset;
+    this->lod_offset = lod_offset;
+
+    std::vector<bool> frame_changed(frames.size());
+    bool any_frame_changed = false;
+    for (int i = 0, ie = ilen(animation_data); i < ie; ++i) {
+        uint32_t frame = animation_data[i].frame_at_time(time);
+        frame_changed[i] = frame != frames[i];
+        any_frame_changed |= frame_changed[i];
+        frames[i] = frame;
+    }
+    if (!lod_changed && !any_frame_changed)
+        return 0;
+
+    int changed_count = 0;
+    for (int i = 0, ie = ilen(instances); i < ie; ++i) {
+        auto& inst = instances[i];
+        bool instance_lod_changed = lod_changed && !lod_groups[inst.parameterized_mesh_id].mesh_ids.empty();
+        bool instance_frame_changed = inst.animated && frame_changed[inst.animation_data_index];
+        if (!instance_lod_changed && !instance_frame_changed)
+            continue;
+        evaluate_instance(i);
+        ++changed_count;
+    }
+    return changed_count;
+}
+
+void InstanceBoundsTracker::evaluate_instance(int instance_idx) {
+    auto& inst = instances[instance_idx];
+    uint32_t frame = inst.animated ? frames[inst.animation_data_index] : 0;
+    transforms[instance_idx] = animation_data[inst.animation_data_index].dequantize(inst.transform_index, frame);
+    int pm_id = active_lod_member(lod_groups[inst.parameterized_mesh_id], inst.parameterized_mesh_id, lod_offset);
+    active_meshes[instance_idx] = pm_id;
+    world_bounds[instance_idx] = local_bounds[pm_id].transformed(transforms[instance_idx]);
+}
+
+uint32_t centroid_morton_code(const Box &box, const Box &scene_bounds) {
+    auto spread_bits = [](uint32_t v) -> uint32_t {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    };
+    if (box.empty())
+        return 0;
+    glm::vec3 scene_extent = glm::max(scene_bounds.extent(), glm::vec3(1.e-20f));
+    glm::vec3 rel = (0.5f * (box.lower + box.upper) - scene_bounds.lower) / scene_extent;
+    glm::uvec3 q = glm::uvec3(glm::clamp(rel * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f)));
+    return (spread_bits(q.x) << 2) | (spread_bits(q.y) << 1) | spread_bits(q.z);
+}
+
+namespace {
+
+// Sum of inner node surface areas of an implicit binary hierarchy over the boxes in the given order
+double implicit_hierarchy_area(const std::vector<Box> &bounds, const std::vector<int> &order) {
+    std::vector<Box> level(order.size());
+    for (int i = 0, ie = ilen(order); i < ie; ++i)
+        level[i] = bounds[order[i]];
+
+    double area = 0.0;
+    while (level.size() > 1) {
+        int parent_count = (ilen(level) + 1) / 2;
+        for (int i = 0; i < parent_count; ++i) {
+            Box parent = level[2 * i];
+            if (2 * i + 1 < ilen(level))
+                parent += level[2 * i + 1];
+            area += parent.surface_area();
+            level[i] = parent;
+        }
+        level.resize(parent_count);
+    }
+    return area;
+}
+
+// Approximates the TLAS builder by ordering instances along a Morton curve
+std::vector<int> spatial_order(const std::vector<Box> &bounds) {
+    Box scene_bounds;
+    for (auto& b : bounds)
+        scene_bounds += b;
+    std::vector<uint32_t> codes(bounds.size());
+    for (int i = 0, ie = ilen(bounds); i < ie; ++i)
+        codes[i] = centroid_morton_code(bounds[i], scene_bounds);
+    std::vector<int> order(bounds.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&codes](int a, int b) { return codes[a] < codes[b]; });
+    return order;
+}
+
+} // namespace
+
+double TlasRefitHeuristic::area_ratio(const std::vector<Box> &bounds) const {
+    if (bounds.size() != build_bounds.size())
+        return HUGE_VAL;
+    // the hierarchy topology is fixed at build time, refits only grow or shrink the nodes,
+    // compare against the hierarchy a rebuild would produce for the current bounds
+    double rebuilt_area = implicit_hierarchy_area(bounds, spatial_order(bounds));
+    if (!(rebuilt_area > 0.0))
+        return 1.0;
+    return std::max(implicit_hierarchy_area(bounds, build_order) / rebuilt_area, 1.0);
+}
+
+bool TlasRefitHeuristic::needs_rebuild(const std::vector<Box> &bounds) const {
+    if (bounds.size() != build_bounds.size())
+        return true;
+    if (max_refits > 0 && refit_count >= max_refits)
+        return true;
+    // the refitted hierarchy is cheap to measure, only sort for the rebuilt
+    // hierarchy once it grew beyond the threshold over its build-time area
+    double refit_area = implicit_hierarchy_area(bounds, build_order);
+    if (refit_area <= double(max_area_ratio) * build_area)
+        return false;
+    return area_ratio(bounds) > double(max_area_ratio);
+}
+
+void TlasRefitHeuristic::rebuilt(const std::vector<Box> &bounds) {
+    build_bounds = bounds;
+    build_order = spatial_order(build_bounds);
+    build_area = implicit_hierarchy_area(build_bounds, build_order);
+    refit_count = 0;
+}
@@ -0,0 +1,75 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+#include "scene.h"
+
+// Local-space bounds of all geometries in a mesh
+Box mesh_bounds(const Mesh &mesh);
+
+// Parameterized mesh that is rendered for the given LoD offset,
+// returns parameterized_mesh_id unchanged if the mesh is not part of a LoD group
+int active_lod_member(const LodGroup &lod_group, int parameterized_mesh_id, int lod_offset);
+
+// Morton code of the box centroid, quantized to 10 bits per axis within the scene bounds
+uint32_t centroid_morton_code(const Box &box, const Box &scene_bounds);
+
+// Tracks world-space instance transforms and bounds over time, following
+// the active LoD member and the current animation frame of each instance
+struct InstanceBoundsTracker {
+    struct InstanceRef {
+        uint32_t animation_data_index = 0;
+        uint32_t transform_index = 0;
+        int parameterized_mesh_id = -1;
+        bool animated = false;
+    };
+    std::vector<InstanceRef> instances;
+    std::vector<AnimationData> animation_data;
+    std::vector<LodGroup> lod_groups; // note: indexed by parameterized mesh id
+    std::vector<Box> local_bounds; // indexed by parameterized mesh id
+
+    // per-instance results of the last update
+    std::vector<glm::mat4> transforms;
+    std::vector<int> active_meshes;
+    std::vector<Box> world_bounds;
+
+    std::vector<uint32_t> frames; // active frame per animation data entry
+    int lod_offset = 0;
+    int animated_instance_count = 0;
+
+    void reset(const Scene &scene, double time = 0.0, int lod_offset = 0);
+    bool has_animation() const { return animated_instance_count > 0; }
+    // Re-evaluates all instances whose animation frame or LoD member changed,
+    // returns the number of instances whose transform, mesh, or bounds changed
+    int update(double time, int lod_offset);
+
+private:
+    void evaluate_instance(int instance_idx);
+};
+
+// Decides between TLAS refits and rebuilds by estimating how much larger the
+// surface area of the refitted hierarchy is than that of a freshly rebuilt one.
+// BLAS of dynamic meshes are judged the same way, using their meshlet bounds.
+struct TlasRefitHeuristic {
+    // rebuild once refitted nodes cover this much more area than rebuilt nodes would
+    float max_area_ratio = 1.5f;
+    // rebuild after this many consecutive refits, regardless of quality (0 = unlimited)
+    int max_refits = 0;
+
+    std::vector<Box> build_bounds;
+    std::vector<int> build_order;
+    double build_area = 0.0; // inner node area of the hierarchy at build time
+    int refit_count = 0;
+
+    // Estimated surface area ratio of the refitted hierarchy over a rebuilt hierarchy (>= 1)
+    double area_ratio(const std::vector<Box> &bounds) const;
+    // note: only re-sorts the bounds once the refitted area exceeds max_area_ratio times the build-time area
+    bool needs_rebuild(const std::vector<Box> &bounds) const;
+
+    void rebuilt(const std::vector<Box> &bounds);
+    void refitted() { ++refit_count; }
+};
@@ -0,0 +1,185 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "instance_merging.h"
+#include "parallel.h"
+#include "profiling.h"
+#include "types.h"
+#include <vkr.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int CHUNK_SIZE = 4096;
+
+uint64_t fnv1a_hash(uint64_t hash, void const* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char const*>(data)[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+const uint64_t FNV1A_BASIS = 14695981039346656037ull;
+
+unsigned char const* quantized_transform(Scene const& scene, Instance const& instance) {
+    AnimationData const& anim = scene.animation_data[instance.animation_data_index];
+    uint64_t offset = vkr_get_transform_offset(instance.transform_index
+        , anim.numStaticTransforms, anim.numAnimatedTransforms, 0);
+    return anim.quantized.data() + offset * VKR_QUANTIZED_TRANSFORM_SIZE;
+}
+
+struct GridCell {
+    int64_t x, y, z;
+    uint32_t mesh_flags;
+};
+
+uint64_t grid_cell_hash(GridCell cell) {
+    uint64_t hash = FNV1A_BASIS;
+    hash = fnv1a_hash(hash, &cell.x, sizeof(cell.x));
+    hash = fnv1a_hash(hash, &cell.y, sizeof(cell.y));
+    hash = fnv1a_hash(hash, &cell.z, sizeof(cell.z));
+    return fnv1a_hash(hash, &cell.mesh_flags, sizeof(cell.mesh_flags));
+}
+
+bool transforms_within(glm::mat4 const& a, glm::mat4 const& b, float epsilon) {
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 3; ++r)
+            if (!(std::abs(a[c][r] - b[c][r]) <= epsilon))
+                return false;
+    return true;
+}
+
+} // namespace
+
+InstanceMergeStats merge_partition_instances(Scene &scene, int first_instance, float epsilon) {
+    ProfilingScope profile_merge("Merge partition instances");
+    InstanceMergeStats stats;
+    auto& instances = scene.instances;
+    int count = ilen(instances) - first_instance;
+    if (count <= 0)
+        return stats;
+    stats.instances = count;
+    bool approximate = epsilon > 0.0f;
+
+    // match keys of all instances in parallel, 0 for instances that are kept as they are
+    std::vector<uint64_t> keys(count);
+    std::vector<GridCell> cells(approximate ? count : 0);
+    std::vector<glm::mat4> transforms(approximate ? count : 0);
+    parallel_for(count, [&](int i) {
+        Instance const& instance = instances[first_instance + i];
+        ParameterizedMesh const& pmesh = scene.parameterized_meshes[instance.parameterized_mesh_id];
+        Mesh const& mesh = scene.meshes[pmesh.mesh_id];
+        bool mergeable = (pmesh.lod_group == 0 || scene.lod_groups[pmesh.lod_group].mesh_ids.size() <= 1)
+            && !pmesh.per_triangle_materials()
+            && pmesh.shader_names.empty()
+            && mesh.mesh_shader_names.empty();
+        if (!mergeable) {
+            keys[i] = 0;
+            return;
+        }
+        if (approximate) {
+            glm::mat4 transform = scene.animation_data[instance.animation_data_index].dequantize(instance.transform_index, 0);
+            transforms[i] = transform;
+            cells[i] = { int64_t(std::floor(double(transform[3].x) / epsilon))
+                       , int64_t(std::floor(double(transform[3].y) / epsilon))
+                       , int64_t(std::floor(double(transform[3].z) / epsilon))
+                       , mesh.flags };
+            keys[i] = grid_cell_hash(cells[i]);
+        }
+        else {
+            uint64_t hash = fnv1a_hash(FNV1A_BASIS, quantized_transform(scene, instance), VKR_QUANTIZED_TRANSFORM_SIZE);
+            hash = fnv1a_hash(hash, &instance.animation_data_index, sizeof(instance.animation_data_index));
+            keys[i] = fnv1a_hash(hash, &mesh.flags, sizeof(mesh.flags));
+        }
+        keys[i] += keys[i] == 0;
+    }, 0, CHUNK_SIZE);
+
+    // earlier instances that later ones merge into, by key
+    std::unordered_map<uint64_t, std::vector<int>> targets;
+    std::vector<int> output_index(count, -1);
+    auto exact_target = [&](int i) {
+        auto it = targets.find(keys[i]);
+        if (it == targets.end())
+            return -1;
+        Instance const& instance = instances[first_instance + i];
+        uint32_t flags = scene.meshes[scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id].flags;
+        for (int target : it->second) {
+            Instance const& target_instance = instances[output_index[target]];
+            if (target_instance.animation_data_index == instance.animation_data_index
+                && scene.meshes[scene.parameterized_meshes[target_instance.parameterized_mesh_id].mesh_id].flags == flags
+                && memcmp(quantized_transform(scene, target_instance), quantized_transform(scene, instance), VKR_QUANTIZED_TRANSFORM_SIZE) == 0)
+                return target;
+        }
+        return -1;
+    };
+    // the earliest match among the neighboring grid cells
+    auto approximate_target = [&](int i) {
+        int best = -1;
+        for (int64_t dz = -1; dz <= 1; ++dz)
+        for (int64_t dy = -1; dy <= 1; ++dy)
+        for (int64_t dx = -1; dx <= 1; ++dx) {
+            GridCell cell = { cells[i].x + dx, cells[i].y + dy, cells[i].z + dz, cells[i].mesh_flags };
+            uint64_t key = grid_cell_hash(cell);
+            auto it = targets.find(key + (key == 0));
+            if (it == targets.end())
+                continue;
+            for (int target : it->second) {
+                GridCell const& target_cell = cells[target];
+                if (target_cell.x == cell.x && target_cell.y == cell.y && target_cell.z == cell.z
+                    && target_cell.mesh_flags == cell.mesh_flags
+                    && (best < 0 || target < best)
+                    && transforms_within(transforms[target], transforms[i], epsilon))
+                    best = target;
+            }
+        }
+        return best;
+    };
+
+    // compact instances in place, merged instances are dropped
+    // note: outputs never overtake inputs, target indices refer to the original order
+    int output_count = first_instance;
+    for (int i = 0; i < count; ++i) {
+        Instance const& instance = instances[first_instance + i];
+        int target = -1;
+        if (keys[i]) {
+            ++stats.mergeable_instances;
+            target = approximate ? approximate_target(i) : exact_target(i);
+        }
+        int target_pmesh_id = target >= 0 ? instances[output_index[target]].parameterized_mesh_id : -1;
+        // a mesh cannot be appended to itself, other parameterizations of it stay separate instances
+        if (target < 0 || (target_pmesh_id != instance.parameterized_mesh_id
+                && scene.parameterized_meshes[target_pmesh_id].mesh_id == scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id)) {
+            if (target < 0 && keys[i])
+                targets[keys[i]].push_back(i);
+            output_index[i] = output_count;
+            if (output_count != first_instance + i)
+                instances[output_count] = instance;
+            ++output_count;
+            continue;
+        }
+
+        if (approximate && !transforms_within(transforms[target], transforms[i], 0.0f))
+            ++stats.approximate_matches;
+        if (target_pmesh_id == instance.parameterized_mesh_id) {
+            ++stats.duplicate_instances;
+            continue;
+        }
+        ParameterizedMesh const& pmesh = scene.parameterized_meshes[instance.parameterized_mesh_id];
+        ParameterizedMesh& target_pmesh = scene.parameterized_meshes[target_pmesh_id];
+        Mesh const& mesh = scene.meshes[pmesh.mesh_id];
+        Mesh& target_mesh = scene.meshes[target_pmesh.mesh_id];
+        target_mesh.geometries.insert(target_mesh.geometries.end()
+            , mesh.geometries.begin(), mesh.geometries.end());
+        target_pmesh.material_offsets.insert(target_pmesh.material_offsets.end()
+            , pmesh.material_offsets.begin(), pmesh.material_offsets.end());
+        target_pmesh.has_overrides_applied = true;
+        stats.merged_geometries += ilen(mesh.geometries);
+        ++stats.merged_instances;
+    }
+    instances.resize(output_count);
+    return stats;
+}
@@ -0,0 +1,23 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "scene.h"
+
+struct InstanceMergeStats {
+    int instances = 0; // instances that were considered
+    int mergeable_instances = 0;
+    int merged_instances = 0; // geometry appended to the mesh of an instance with the same transform
+    int duplicate_instances = 0; // dropped, the same mesh was already placed at the same transform
+    int approximate_matches = 0; // merged or dropped with transforms that differ by at most the epsilon
+    int merged_geometries = 0;
+};
+
+// Merges instances of partitioned scenes that share a transform into one instance, appending
+// the geometries and materials of the merged meshes to the mesh of the first such instance.
+// Instances from first_instance on are matched by a hash of their quantized frame 0 transform
+// and mesh flags. With a positive epsilon, transforms whose entries differ by at most epsilon
+// are matched through a spatial hash of their translations instead. Instances of LoD groups,
+// per-triangle materials and custom shaders are kept as they are.
+InstanceMergeStats merge_partition_instances(Scene &scene, int first_instance, float epsilon = 0.0f);
@@ -6,6 +6,7 @@
 #include "lights.h"
 #include "scene.h"
 #include "mesh_decode.h"
+#include "quantization.h"
 #include "compute_util.h"
 #include "types.h"
 #include "error_io.h"
@@ -36,6 +37,13 @@ std::vector<TriLight> collect_emitters(glm::mat4 const& transform, Parameterized
         return lights;
     bool per_triangle_ids = pm.per_triangle_materials();
 
+    std::vector<uint32_t> triangle_material_ids;
+    if (per_triangle_ids) {
+        triangle_material_ids.resize(pm.num_triangle_material_ids());
+        dequantize_material_ids(triangle_material_ids.data(), triangle_material_ids.size()
+            , pm.triangle_material_ids.data(), uint32_t(pm.material_id_bitcount));
+    }
+
     len_t mesh_tri_idx_base = 0;
     for (int i = 0, ie = mesh.num_geometries(); i < ie; ++i) {
         Geometry currentGeom = mesh.geometries[i];
@@ -54,7 +62,7 @@ std::vector<TriLight> collect_emitters(glm::mat4 const& transform, Parameterized
             lights.reserve(mesh.num_tris());
         for (int tri_idx = 0, tri_idx_end = currentGeom.num_tris(); tri_idx < tri_idx_end; ++tri_idx) {
             if (per_triangle_ids) {
-                int material_id = material_offset + pm.triangle_material_id(mesh_tri_idx_base + tri_idx);
+                int material_id = material_offset + int(triangle_material_ids[mesh_tri_idx_base + tri_idx]);
                 auto& material = materials[material_id];
                 if (!(material.emission_intensity > 0.0f))
                     continue;
@@ -72,6 +80,51 @@ std::vector<TriLight> collect_emitters(glm::mat4 const& transform, Parameterized
     return lights;
 }
 
+TriLight encode_quad_emitter(QuadLight const& light) {
+    glm::vec3 e_x = 2.0f * light.width * light.v_x;
+    glm::vec3 e_y = 2.0f * light.height * light.v_y;
+    if (dot(cross(e_x, e_y), light.normal) < 0.0f)
+        std::swap(e_x, e_y);
+
+    TriLight encoded;
+    encoded.v0 = light.position - 0.5f * (e_x + e_y);
+    encoded.v1 = encoded.v0 + e_x;
+    encoded.v2 = encoded.v0 + e_y;
+    encoded.radiance = light.emission;
+    return encoded;
+}
+
+std::vector<TriLight> collect_quad_emitters(Scene const& scene) {
+    std::vector<TriLight> emitters;
+    emitters.reserve(scene.quadLights.size());
+    for (auto& light : scene.quadLights) {
+        if (!(light.width > 0.0f && light.height > 0.0f) || !(luminance(light.emission) > 0.0f))
+            continue;
+        emitters.push_back(encode_quad_emitter(light));
+    }
+    return emitters;
+}
+
+float quad_light_selection_probability(std::vector<TriLight> const& quad_emitters, std::vector<TriLight> const& tri_emitters) {
+    if (quad_emitters.empty())
+        return 0.0f;
+    if (tri_emitters.empty())
+        return 1.0f;
+
+    // note: the common factor of pi for diffuse emission cancels out
+    auto total_power = [](std::vector<TriLight> const& emitters, float area_scale) {
+        double power = 0.0;
+        for (auto& light : emitters)
+            power += double(luminance(light.radiance)) * double(area_scale * length(cross(light.v1 - light.v0, light.v2 - light.v0)));
+        return power;
+    };
+    double quad_power = total_power(quad_emitters, 1.0f);
+    double tri_power = total_power(tri_emitters, 0.5f);
+    float p = quad_power + tri_power > 0.0 ? float(quad_power / (quad_power + tri_power)) : 0.5f;
+    // keep a minimum sampling rate for either kind, power is a poor proxy for nearby emitters
+    return glm::clamp(p, 0.1f, 0.9f);
+}
+
 void update_light_sampling(BinnedLightSampling& binned, std::vector<TriLight> const& emitters, LightSamplingConfig params) {
     bool invalidated = (binned.params.bin_size == 0);
     if (binned.params.min_radiance != params.min_radiance ||
@@ -23,6 +23,13 @@ struct BaseMaterial;
 std::vector<TriLight> collect_emitters(Scene const& scene);
 std::vector<TriLight> collect_emitters(glm::mat4 const& transform, ParameterizedMesh const& pm, Mesh const& mesh, std::vector<BaseMaterial> const& materials);
 
+// quad lights are uploaded in tri light layout: v0 is a corner, v1 and v2 the adjacent corners,
+// ordered such that cross(v1 - v0, v2 - v0) points along the emission normal
+TriLight encode_quad_emitter(QuadLight const& light);
+std::vector<TriLight> collect_quad_emitters(Scene const& scene);
+// probability of sampling quad lights rather than tri lights, proportional to their emitted power
+float quad_light_selection_probability(std::vector<TriLight> const& quad_emitters, std::vector<TriLight> const& tri_emitters);
+
 // importance sampling tools
 struct BinnedLightSampling {
     std::vector<TriLight> emitters;
@@ -37,6 +44,7 @@ void update_light_sampling(BinnedLightSampling& binned, std::vector<TriLight> co
 
 struct LightSamplingSetup {
     std::vector<TriLight> emitters;
+    std::vector<TriLight> quad_emitters;
     BinnedLightSampling binned;
 };
 
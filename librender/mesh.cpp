@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: MIT
 
 #include "mesh.h"
+#include "quantization.h"
 #include <algorithm>
+#include <cstring>
 #include <numeric>
 
 int Geometry::num_verts() const
@@ -64,3 +66,110 @@ int ParameterizedMesh::triangle_material_id(index_t idx) const {
         return 0;
     }
 }
+
+namespace {
+
+// copies the data of whole triangles in the given order
+template <class E>
+std::vector<E> permuted_triangles(void const* data, size_t nbytes, std::vector<int> const& order) {
+    size_t triangle_elements = nbytes / sizeof(E) / order.size();
+    std::vector<E> permuted(triangle_elements * order.size());
+    E const* source = (E const*) data;
+    for (size_t i = 0; i < order.size(); ++i)
+        std::copy_n(source + size_t(order[i]) * triangle_elements, triangle_elements, permuted.data() + i * triangle_elements);
+    return permuted;
+}
+
+template <class T>
+mapped_vector<void> typed_material_ids(std::vector<uint32_t> const& ids) {
+    return mapped_vector<void>(GenericBuffer(std::vector<T>(ids.begin(), ids.end())));
+}
+
+} // namespace
+
+bool sort_triangles_by_material(Mesh &mesh, ParameterizedMesh &pm) {
+    if (!pm.per_triangle_materials() || pm.num_triangle_material_ids() < mesh.num_tris())
+        return false;
+    for (auto const& geom : mesh.geometries)
+        if ((geom.format_flags & Geometry::ImplicitIndices) && (geom.format_flags & Geometry::NoIndices) != Geometry::NoIndices)
+            return false;
+
+    std::vector<uint32_t> ids(pm.num_triangle_material_ids());
+    dequantize_material_ids(ids.data(), ids.size(), pm.triangle_material_ids.data(), uint32_t(pm.material_id_bitcount));
+
+    pm.triangle_material_ranges.clear();
+    std::vector<int> order;
+    size_t tri_base = 0;
+    for (int geo_idx = 0, geo_end = mesh.num_geometries(); geo_idx < geo_end; ++geo_idx) {
+        Geometry& geom = mesh.geometries[geo_idx];
+        int tri_count = geom.num_tris();
+        uint32_t* geom_ids = ids.data() + tri_base;
+        tri_base += size_t(tri_count);
+        if (tri_count == 0)
+            continue;
+
+        // counting sort for the usual small ID ranges
+        uint32_t max_id = *std::max_element(geom_ids, geom_ids + tri_count);
+        order.resize(tri_count);
+        if (max_id < 0x10000u) {
+            std::vector<int> id_offsets(size_t(max_id) + 2, 0);
+            for (int i = 0; i < tri_count; ++i)
+                ++id_offsets[geom_ids[i] + 1];
+            std::partial_sum(id_offsets.begin(), id_offsets.end(), id_offsets.begin());
+            for (int i = 0; i < tri_count; ++i)
+                order[id_offsets[geom_ids[i]]++] = i;
+        }
+        else {
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return geom_ids[a] < geom_ids[b];
+            });
+        }
+        std::vector<uint32_t> sorted_ids(tri_count);
+        for (int i = 0; i < tri_count; ++i)
+            sorted_ids[i] = geom_ids[order[i]];
+        std::copy(sorted_ids.begin(), sorted_ids.end(), geom_ids);
+
+        if ((geom.format_flags & Geometry::NoIndices) == Geometry::NoIndices) {
+            // triangles are unrolled, permute the vertices of whole triangles
+            geom.vertices = mapped_vector<void>(GenericBuffer(permuted_triangles<uint8_t>(geom.vertices.data(), geom.vertices.nbytes(), order)));
+            if (!geom.normals.empty())
+                geom.normals = mapped_vector<void>(GenericBuffer(permuted_triangles<uint8_t>(geom.normals.data(), geom.normals.nbytes(), order)));
+            // quantized uvs share the normal buffer
+            if (geom.format_flags & Geometry::QuantizedNormalsAndUV)
+                geom.uvs = geom.normals;
+            else if (!geom.uvs.empty())
+                geom.uvs = mapped_vector<void>(GenericBuffer(permuted_triangles<uint8_t>(geom.uvs.data(), geom.uvs.nbytes(), order)));
+            if (!geom.blend_attributes.empty())
+                geom.blend_attributes = mapped_vector<uint32_t>(permuted_triangles<uint32_t>(geom.blend_attributes.data(), geom.blend_attributes.nbytes(), order));
+        }
+        else
+            geom.indices = mapped_vector<glm::uvec3>(permuted_triangles<glm::uvec3>(geom.indices.data(), geom.indices.nbytes(), order));
+        geom.meshlets = { };
+
+        for (int i = 0; i < tri_count; ) {
+            TriangleMaterialRange range;
+            range.geometry = geo_idx;
+            range.triangle_offset = i;
+            range.material_id = int(geom_ids[i]);
+            while (i < tri_count && geom_ids[i] == geom_ids[range.triangle_offset])
+                ++i;
+            range.triangle_count = i - range.triangle_offset;
+            pm.triangle_material_ranges.push_back(range);
+        }
+    }
+
+    switch (pm.material_id_bitcount) {
+    case 8:
+        pm.triangle_material_ids = typed_material_ids<uint8_t>(ids);
+        break;
+    case 16:
+        pm.triangle_material_ids = typed_material_ids<uint16_t>(ids);
+        break;
+    default:
+        pm.triangle_material_ids = typed_material_ids<uint32_t>(ids);
+    }
+    ++mesh.model_revision;
+    ++pm.materials_revision;
+    return true;
+}
@@ -6,6 +6,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "file_mapping.h"
+#include "meshlets.h"
 
 struct Geometry {
     enum FormatFlags {
@@ -19,6 +20,10 @@ struct Geometry {
     mapped_vector<void> normals;
     mapped_vector<void> uvs;
     mapped_vector<glm::uvec3> indices;
+    // per-vertex bone weights and tuple indices of skinned geometry, see skinning.h
+    mapped_vector<uint32_t> blend_attributes;
+    // consecutive triangle runs with bounds and normal cones, see meshlets.h
+    mapped_vector<Meshlet> meshlets;
 
     glm::vec3 base;
     glm::vec3 extent;
@@ -44,6 +49,7 @@ struct Mesh {
     enum Flags {
         Dynamic = 0x01,
         SubtlyDynamic = 0x02,
+        Skinned = 0x04, // deformed by bones, rendered with exactly one instance
     };
 
     std::vector<Geometry> geometries;
@@ -71,6 +77,14 @@ struct Mesh {
     unsigned model_optimize_revision() const { return (optimize_revision & 0xffff) + (model_revision << 16); };
 };
 
+// Consecutive triangles of one geometry that share their per-triangle material, see sort_triangles_by_material
+struct TriangleMaterialRange {
+    int geometry;
+    int triangle_offset; // in the geometry
+    int triangle_count;
+    int material_id; // per-triangle ID, relative to the material offset of the geometry
+};
+
 /* A parameterized mesh is a combination of a mesh containing the geometries
  * with a set of material parameters to set the appearance information for those
  * geometries.
@@ -83,6 +97,9 @@ struct ParameterizedMesh {
     std::vector<int> material_offsets;
     mapped_vector<void> triangle_material_ids;
     int material_id_bitcount = 32; // default to uint32
+    // runs of equal per-triangle materials, only for triangles sorted by material,
+    // geometries with a single run are rendered with a constant material
+    std::vector<TriangleMaterialRange> triangle_material_ranges;
 
     std::string mesh_name;
     // Names of material shaders to apply to each geometry
@@ -107,6 +124,13 @@ struct ParameterizedMesh {
     unsigned model_shader_revision() const { return (shaders_revision & 0xffff) + (model_revision << 16); };
 };
 
+// Reorders the triangles of each geometry by their per-triangle material IDs, triangles with equal
+// IDs keep their order. Unrolled vertex streams are permuted, indexed geometries get a remapped
+// index buffer, and the material ranges of the parameterized mesh are filled in. Meshlets are
+// cleared. Returns false without changes if there are no per-triangle materials, or if indices
+// refer to unrolled vertices. The mesh must not be shared with other parameterized meshes.
+bool sort_triangles_by_material(Mesh &mesh, ParameterizedMesh &pm);
+
 /* An instance places a parameterized mesh at some location in the scene
  */
 struct Instance {
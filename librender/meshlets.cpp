@@ -0,0 +1,161 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "meshlets.h"
+#include "mesh.h"
+#include "parallel.h"
+#include "types.h"
+#include <algorithm>
+#include <cmath>
+
+void bound_triangles(glm::vec3 const* vertices, int triangle_count
+    , Sphere& bounds, glm::vec3& cone_axis, float& cone_cutoff) {
+    bounds = Sphere(glm::vec3(0.0f), 0.0f);
+    cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    cone_cutoff = 2.0f;
+    if (triangle_count <= 0)
+        return;
+    bounds = Sphere::boundPoints(vertices, 3 * triangle_count);
+
+    glm::vec3 normal_sum(0.0f);
+    for (int i = 0; i < triangle_count; ++i) {
+        glm::vec3 const* v = vertices + 3 * i;
+        glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+        float n_len = glm::length(n);
+        if (n_len > 0.0f)
+            normal_sum += n / n_len;
+    }
+    float sum_len = glm::length(normal_sum);
+    if (!(sum_len > 0.0f))
+        return;
+    cone_axis = normal_sum / sum_len;
+
+    float min_alignment = 1.0f;
+    for (int i = 0; i < triangle_count; ++i) {
+        glm::vec3 const* v = vertices + 3 * i;
+        glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+        float n_len = glm::length(n);
+        if (n_len > 0.0f)
+            min_alignment = std::min(glm::dot(n / n_len, cone_axis), min_alignment);
+    }
+    if (min_alignment > 0.0f)
+        cone_cutoff = std::sqrt(std::max(1.0f - min_alignment * min_alignment, 0.0f));
+}
+
+bool behind_normal_cone(Sphere const& bounds, glm::vec3 const& cone_axis, float cone_cutoff, glm::vec3 const& point) {
+    // all normals are within asin(cone_cutoff) of the axis, so all triangles face away from
+    // the point if every direction from the point into the sphere is within acos(cone_cutoff)
+    glm::vec3 to_center = bounds.origin - point;
+    return glm::dot(to_center, cone_axis) > cone_cutoff * glm::length(to_center) + bounds.radius * (1.0f + cone_cutoff);
+}
+
+std::vector<Meshlet> build_meshlets(Geometry const& geom, MeshletParams const& params) {
+    std::vector<Meshlet> meshlets;
+    int num_tris = geom.num_tris();
+    if (num_tris <= 0)
+        return meshlets;
+    int max_triangles = std::max(params.max_triangles, 1);
+
+    std::vector<glm::vec3> vertices(3 * std::min(num_tris, max_triangles));
+    int begin = 0, count = 0;
+    Box box;
+    float area = 0.0f;
+    glm::vec3 normal_sum(0.0f);
+
+    auto finish_meshlet = [&]() {
+        Meshlet m;
+        m.triangle_offset = uint32_t(begin);
+        m.triangle_count = uint32_t(count);
+        bound_triangles(vertices.data(), count, m.bounds, m.cone_axis, m.cone_cutoff);
+        meshlets.push_back(m);
+    };
+
+    for (int tri_idx = 0; tri_idx < num_tris; ++tri_idx) {
+        glm::vec3 v[3];
+        geom.tri_positions(tri_idx, v[0], v[1], v[2]);
+        glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+        float n_len = glm::length(n);
+
+        if (count > 0) {
+            bool split = count >= max_triangles;
+            if (!split && n_len > 0.0f) {
+                float sum_len = glm::length(normal_sum);
+                split = sum_len > 0.0f && glm::dot(n, normal_sum) < params.min_normal_alignment * n_len * sum_len;
+            }
+            if (!split && count >= params.min_triangles) {
+                Box grown = box;
+                grown += v[0];
+                grown += v[1];
+                grown += v[2];
+                glm::vec3 diagonal = grown.extent();
+                split = glm::dot(diagonal, diagonal) > params.max_elongation * (area + 0.5f * n_len);
+            }
+            if (split) {
+                finish_meshlet();
+                begin = tri_idx;
+                count = 0;
+                box = Box();
+                area = 0.0f;
+                normal_sum = glm::vec3(0.0f);
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            vertices[3 * count + i] = v[i];
+            box += v[i];
+        }
+        area += 0.5f * n_len;
+        if (n_len > 0.0f)
+            normal_sum += n / n_len;
+        ++count;
+    }
+    finish_meshlet();
+
+    return meshlets;
+}
+
+void build_meshlets(std::vector<Mesh>& meshes, MeshletParams const& params, int thread_count) {
+    std::vector<Geometry*> pending;
+    for (auto& mesh : meshes)
+        for (auto& geom : mesh.geometries)
+            if (geom.meshlets.empty() && geom.num_tris() > 0)
+                pending.push_back(&geom);
+
+    parallel_for(ilen(pending), [&](int i) {
+        pending[i]->meshlets = mapped_vector<Meshlet>(build_meshlets(*pending[i], params));
+    }, thread_count);
+}
+
+std::vector<Meshlet> refit_meshlets(Geometry const& geom, Meshlet const* meshlets, int meshlet_count) {
+    std::vector<Meshlet> refitted(meshlets, meshlets + meshlet_count);
+    std::vector<glm::vec3> vertices;
+    for (auto& m : refitted) {
+        vertices.resize(3 * m.triangle_count);
+        for (int i = 0, ie = int(m.triangle_count); i < ie; ++i)
+            geom.tri_positions(int(m.triangle_offset) + i, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+        bound_triangles(vertices.data(), int(m.triangle_count), m.bounds, m.cone_axis, m.cone_cutoff);
+    }
+    return refitted;
+}
+
+MeshletFrustum::MeshletFrustum(glm::mat4 const& object_to_clip, glm::vec2 clip_slack) {
+    glm::mat4 rows = glm::transpose(object_to_clip);
+    // -w <= x, y <= w, z <= w
+    planes[0] = rows[3] * (1.0f + clip_slack.x) + rows[0];
+    planes[1] = rows[3] * (1.0f + clip_slack.x) - rows[0];
+    planes[2] = rows[3] * (1.0f + clip_slack.y) + rows[1];
+    planes[3] = rows[3] * (1.0f + clip_slack.y) - rows[1];
+    planes[4] = rows[3] - rows[2];
+    for (auto& p : planes) {
+        float len = glm::length(glm::vec3(p));
+        if (len > 0.0f)
+            p /= len;
+    }
+}
+
+bool MeshletFrustum::culls(Sphere const& bounds) const {
+    for (auto& p : planes)
+        if (glm::dot(glm::vec3(p), bounds.origin) + p.w < -bounds.radius)
+            return true;
+    return false;
+}
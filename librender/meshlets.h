@@ -0,0 +1,64 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.h"
+
+struct Geometry;
+struct Mesh;
+
+// Meshlets are runs of consecutive triangles of a geometry, such that every meshlet can
+// be drawn, culled or refitted as a sub-range of the (implicit or explicit) index stream.
+// Triangles keep their stored order, .vks meshes are already optimized for locality.
+struct Meshlet {
+    uint32_t triangle_offset = 0; // relative to the geometry
+    uint32_t triangle_count = 0;
+    Sphere bounds = Sphere(glm::vec3(0.0f), 0.0f);
+    // all triangle normals lie within the cone around the axis, the cutoff is the
+    // sine of the cone's half angle, or > 1 if no half-space bounds the normals
+    glm::vec3 cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float cone_cutoff = 2.0f;
+};
+
+struct MeshletParams {
+    int max_triangles = 128;
+    // meshlets are only split by their shape once they have this many triangles
+    int min_triangles = 16;
+    // split off triangles whose normals deviate further from the average normal (cosine)
+    float min_normal_alignment = 0.5f;
+    // split once the squared diagonal of the meshlet box exceeds this multiple of its area
+    float max_elongation = 16.0f;
+};
+
+// Greedy clustering of the geometry's triangles in stored order, the result only
+// depends on the geometry and the parameters
+std::vector<Meshlet> build_meshlets(Geometry const& geom, MeshletParams const& params = {});
+// Clusters all geometries without meshlets in parallel, storing the results in Geometry::meshlets
+void build_meshlets(std::vector<Mesh>& meshes, MeshletParams const& params = {}, int thread_count = 0);
+// Recomputes bounds and cones for the current vertex positions, keeping the triangle ranges
+std::vector<Meshlet> refit_meshlets(Geometry const& geom, Meshlet const* meshlets, int meshlet_count);
+
+// Bounding sphere and normal cone of unindexed triangles (three vertices each),
+// degenerate triangles do not constrain the cone
+void bound_triangles(glm::vec3 const* vertices, int triangle_count
+    , Sphere& bounds, glm::vec3& cone_axis, float& cone_cutoff);
+// True if the point lies behind the planes of all triangles bounded by sphere and normal cone
+bool behind_normal_cone(Sphere const& bounds, glm::vec3 const& cone_axis, float cone_cutoff, glm::vec3 const& point);
+inline bool meshlet_backfacing(Meshlet const& meshlet, glm::vec3 const& eye) {
+    return behind_normal_cone(meshlet.bounds, meshlet.cone_axis, meshlet.cone_cutoff, eye);
+}
+
+// Conservative view frustum test in the space that object_to_clip transforms from,
+// the far plane is kept to support both regular and reversed depth
+struct MeshletFrustum {
+    glm::vec4 planes[5];
+
+    // clip_slack widens the frustum by the given amount of normalized device
+    // coordinates, e.g. to account for sub-pixel jitter
+    MeshletFrustum(glm::mat4 const& object_to_clip, glm::vec2 clip_slack = glm::vec2(0.0f));
+    bool culls(Sphere const& bounds) const;
+};
@@ -0,0 +1,123 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "neural_denoiser.h"
+#include "parallel.h"
+#include "types.h"
+#include "util.h"
+#include "error_io.h"
+#include <vkr.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+NeuralDenoiser::NeuralDenoiser(NeuralNetwork network_)
+    : network(std::move(network_)) {
+    int taps = network.input_count() / FEATURES_PER_TAP;
+    window = int(std::lround(std::sqrt(double(taps))));
+    if (window < 1 || window % 2 != 1 || window * window * FEATURES_PER_TAP != network.input_count())
+        throw_error("Denoising networks need %d inputs per tap of an odd square window, got %d inputs"
+            , FEATURES_PER_TAP, network.input_count());
+    if (network.output_count() < 3)
+        throw_error("Denoising networks need at least 3 outputs, got %d", network.output_count());
+}
+
+void NeuralDenoiser::denoise(DenoiserImages const& images, float* output
+    , int thread_count, NeuralProfile* profile) const {
+    int const W = images.width, H = images.height;
+    int const tile_size = NeuralNetwork::TILE_ROWS;
+    int const tiles_per_line = (W + tile_size - 1) / tile_size;
+    int const radius = window / 2;
+    int const input_count = network.input_count();
+    int const output_count = network.output_count();
+
+    // compress the dynamic range once per pixel rather than once per tap
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<float> log_color(size_t(3) * W * H);
+    parallel_for(H, [&](int y) {
+        for (size_t i = size_t(y) * W, end = i + W; i < end; ++i)
+            for (int c = 0; c < 3; ++c) {
+                float color = images.color[4 * i + c];
+                log_color[3 * i + c] = std::log1p(color > 0.0f ? color : 0.0f);
+            }
+    }, thread_count);
+    if (profile)
+        profile->feature_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::mutex profile_mutex;
+    parallel_for(tiles_per_line * H, [&](int tile_idx) {
+        thread_local NeuralScratch scratch;
+        thread_local std::vector<float> inputs, outputs;
+        inputs.resize(size_t(tile_size) * input_count);
+        outputs.resize(size_t(tile_size) * output_count);
+
+        NeuralProfile tile_profile;
+        if (profile)
+            tile_profile.reset(network.layers.size());
+        auto tile_start_time = std::chrono::steady_clock::now();
+
+        int y = tile_idx / tiles_per_line;
+        int x_begin = tile_idx % tiles_per_line * tile_size;
+        int count = std::min(tile_size, W - x_begin);
+        for (int p = 0; p < count; ++p) {
+            float* features = inputs.data() + size_t(p) * input_count;
+            for (int dy = -radius; dy <= radius; ++dy) {
+                int sy = std::min(std::max(y + dy, 0), H - 1);
+                for (int dx = -radius; dx <= radius; ++dx) {
+                    int sx = std::min(std::max(x_begin + p + dx, 0), W - 1);
+                    size_t pixel = size_t(sy) * W + sx;
+                    for (int c = 0; c < 3; ++c) {
+                        features[c] = log_color[3 * pixel + c];
+                        features[3 + c] = images.albedo[4 * pixel + c];
+                        features[6 + c] = images.normal[4 * pixel + c];
+                    }
+                    features += FEATURES_PER_TAP;
+                }
+            }
+        }
+        if (profile)
+            tile_profile.feature_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start_time).count();
+
+        network.evaluate_tile(inputs.data(), outputs.data(), count, scratch, profile ? &tile_profile : nullptr);
+
+        for (int p = 0; p < count; ++p) {
+            size_t pixel = 4 * (size_t(y) * W + x_begin + p);
+            float const* result = outputs.data() + size_t(p) * output_count;
+            for (int c = 0; c < 3; ++c)
+                output[pixel + c] = std::expm1(result[c] > 0.0f ? result[c] : 0.0f);
+            output[pixel + 3] = images.color[pixel + 3];
+        }
+
+        if (profile) {
+            std::lock_guard<std::mutex> lock(profile_mutex);
+            profile->accumulate(tile_profile);
+        }
+    }, thread_count);
+}
+
+NeuralNetwork load_neural_network(const std::string &filename) {
+    auto errorHandler = [](VkrResult result, const char *msg)
+    {
+      throw_error(msg);
+    };
+
+    VkrTensor tensor;
+    if (vkr_open_tensor(filename.c_str(), &tensor, errorHandler) != VKR_SUCCESS)
+        throw_error("Error opening network tensor %s", filename.c_str());
+    try {
+        NeuralNetwork network(tensor);
+        vkr_close_tensor(&tensor);
+        return network;
+    } catch (...) {
+        vkr_close_tensor(&tensor);
+        throw;
+    }
+}
+
+std::string default_denoiser_network_file() {
+    std::string next_to_binary = binary_path("denoiser.vktensor");
+    if (file_exists(next_to_binary))
+        return next_to_binary;
+    return rooted_path("rendering/denoise/denoiser.vktensor");
+}
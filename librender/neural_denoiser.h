@@ -0,0 +1,40 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "neural_network.h"
+#include <string>
+
+// Feature images of the frame to denoise, four floats per pixel
+struct DenoiserImages {
+    int width = 0, height = 0;
+    float const* color = nullptr; // linear HDR, alpha is passed through
+    float const* albedo = nullptr; // e.g. albedo-roughness AOV, rgb are used
+    float const* normal = nullptr; // e.g. normal-depth AOV, xyz are used
+};
+
+// Per-pixel network evaluated as a KxK convolution: the inputs of a pixel are the
+// log-compressed color, albedo and normal of its neighborhood (nine values per tap,
+// taps in scanline order, clamped at the image borders). The first three outputs are
+// the log-compressed denoised color. K follows from the input count of the network.
+struct NeuralDenoiser {
+    static int const FEATURES_PER_TAP = 9;
+
+    NeuralNetwork network;
+    int window = 1;
+
+    NeuralDenoiser() = default;
+    // throws if the network does not match the feature layout
+    explicit NeuralDenoiser(NeuralNetwork network);
+
+    // output may not alias the inputs
+    void denoise(DenoiserImages const& images, float* output
+        , int thread_count = 0, NeuralProfile* profile = nullptr) const;
+};
+
+// throws if the file cannot be read or does not describe a network
+NeuralNetwork load_neural_network(const std::string &filename);
+
+// denoiser.vktensor next to the binary, falling back to rendering/denoise in the root tree
+std::string default_denoiser_network_file();
@@ -0,0 +1,361 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "neural_network.h"
+#include "compute_util.h"
+#include "parallel.h"
+#include "types.h"
+#include "error_io.h"
+#include <vkr.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+struct TensorValues {
+    VkrTensor const& tensor;
+    float int8_scale;
+
+    float operator()(uint64_t idx) const {
+        switch (tensor.format) {
+        case VKR_TENSOR_FORMAT_HALF_FLOAT: {
+            FP16 h;
+            h.u = ((uint16_t const*) tensor.values)[idx];
+            return half_to_float(h).f;
+        }
+        case VKR_TENSOR_FORMAT_FLOAT:
+            return ((float const*) tensor.values)[idx];
+        case VKR_TENSOR_FORMAT_INT8:
+            return float(((int8_t const*) tensor.values)[idx]) * int8_scale;
+        }
+        return 0.0f;
+    }
+    int8_t quantized(uint64_t idx) const {
+        return ((int8_t const*) tensor.values)[idx];
+    }
+};
+
+void set_weight(NeuralLayer& layer, TensorValues const& values, uint64_t idx, int input, int output) {
+    size_t dst = size_t(input) * layer.output_stride + output;
+    if (!layer.quantized_weights.empty())
+        layer.quantized_weights[dst] = values.quantized(idx);
+    else
+        layer.weights[dst] = values(idx);
+}
+
+void allocate_layer(NeuralLayer& layer, int input_count, int output_count, bool relu, bool quantized, float weight_scale) {
+    layer.input_count = input_count;
+    layer.output_count = output_count;
+    layer.output_stride = (output_count + NeuralLayer::OUTPUT_BLOCK - 1) / NeuralLayer::OUTPUT_BLOCK * NeuralLayer::OUTPUT_BLOCK;
+    layer.relu = relu;
+    if (quantized) {
+        layer.quantized_weights.assign(size_t(input_count) * layer.output_stride, 0);
+        layer.weight_scale = weight_scale;
+    } else
+        layer.weights.assign(size_t(input_count) * layer.output_stride, 0.0f);
+    layer.biases.assign(layer.output_stride, 0.0f);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int const ROW_BLOCK = 4; // rows accumulated in registers by the kernels
+
+// Rows of the current row block, clamped to stay within the rows of the tile
+void row_block_pointers(float const* x, int input_count, int r0, int row_count, float const* (&rows)[ROW_BLOCK]) {
+    for (int r = 0; r < ROW_BLOCK; ++r)
+        rows[r] = x + size_t(std::min(r0 + r, row_count - 1)) * input_count;
+}
+
+// Dense float kernel computing rows of y = b + x W in register-sized blocks of
+// ROW_BLOCK rows and OUTPUT_BLOCK outputs, streaming over contiguous weight rows
+void gemm_rows_float(NeuralLayer const& layer, float const* x, float* y, int row_count) {
+    int const B = NeuralLayer::OUTPUT_BLOCK;
+    int const I = layer.input_count, O = layer.output_count, stride = layer.output_stride;
+    for (int r0 = 0; r0 < row_count; r0 += ROW_BLOCK) {
+        float const* rows[ROW_BLOCK];
+        row_block_pointers(x, I, r0, row_count, rows);
+        for (int o0 = 0; o0 < O; o0 += B) {
+            float acc[ROW_BLOCK][B];
+            for (int r = 0; r < ROW_BLOCK; ++r)
+                for (int o = 0; o < B; ++o)
+                    acc[r][o] = layer.biases[o0 + o];
+            float const* w = layer.weights.data() + o0;
+            for (int i = 0; i < I; ++i, w += stride) {
+                for (int r = 0; r < ROW_BLOCK; ++r) {
+                    float a = rows[r][i];
+                    for (int o = 0; o < B; ++o)
+                        acc[r][o] += a * w[o];
+                }
+            }
+            int output_end = std::min(B, O - o0);
+            for (int r = 0; r < ROW_BLOCK && r0 + r < row_count; ++r)
+                std::memcpy(y + size_t(r0 + r) * O + o0, acc[r], sizeof(float) * output_end);
+        }
+    }
+}
+
+// Int8 kernel: activations are quantized per row, products accumulate in int32
+void gemm_rows_int8(NeuralLayer const& layer, float const* x, float* y, int row_count, NeuralScratch& scratch) {
+    int const B = NeuralLayer::OUTPUT_BLOCK;
+    int const I = layer.input_count, O = layer.output_count, stride = layer.output_stride;
+    int8_t* xq = scratch.quantized_activations.data();
+    float* x_scales = scratch.activation_scales.data();
+
+    for (int r = 0; r < row_count; ++r) {
+        float const* xr = x + size_t(r) * I;
+        float max_abs = 0.0f;
+        for (int i = 0; i < I; ++i)
+            max_abs = std::max(max_abs, std::abs(xr[i]));
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        float inv_scale = 1.0f / scale;
+        int8_t* xqr = xq + size_t(r) * I;
+        for (int i = 0; i < I; ++i)
+            xqr[i] = int8_t(std::lrint(xr[i] * inv_scale));
+        x_scales[r] = scale * layer.weight_scale;
+    }
+
+    for (int r0 = 0; r0 < row_count; r0 += ROW_BLOCK) {
+        int8_t const* rows[ROW_BLOCK];
+        for (int r = 0; r < ROW_BLOCK; ++r)
+            rows[r] = xq + size_t(std::min(r0 + r, row_count - 1)) * I;
+        for (int o0 = 0; o0 < O; o0 += B) {
+            int32_t acc[ROW_BLOCK][B] = { };
+            int8_t const* w = layer.quantized_weights.data() + o0;
+            for (int i = 0; i < I; ++i, w += stride) {
+                for (int r = 0; r < ROW_BLOCK; ++r) {
+                    int32_t a = rows[r][i];
+                    for (int o = 0; o < B; ++o)
+                        acc[r][o] += a * int32_t(w[o]);
+                }
+            }
+            int output_end = std::min(B, O - o0);
+            for (int r = 0; r < ROW_BLOCK && r0 + r < row_count; ++r) {
+                float* yr = y + size_t(r0 + r) * O + o0;
+                float s = x_scales[r0 + r];
+                for (int o = 0; o < output_end; ++o)
+                    yr[o] = layer.biases[o0 + o] + float(acc[r][o]) * s;
+            }
+        }
+    }
+}
+
+} // namespace
+
+NeuralNetwork::NeuralNetwork(VkrTensor const& tensor) {
+    if (!tensor.values)
+        throw_error("Network tensor has no values");
+    if (tensor.flags & VKR_TENSOR_FLAGS_CUSTOM_DATA_LAYOUT)
+        throw_error("Network tensors with custom data layouts are not supported");
+    if (tensor.dimensionality < 2 || tensor.dimensionality > 3)
+        throw_error("Network tensors need 2 or 3 dimensions, got %d", int(tensor.dimensionality));
+    if (tensor.format != VKR_TENSOR_FORMAT_HALF_FLOAT && tensor.format != VKR_TENSOR_FORMAT_FLOAT
+     && tensor.format != VKR_TENSOR_FORMAT_INT8)
+        throw_error("Unsupported network tensor format %d", int(tensor.format));
+
+    uint64_t columns = tensor.dimensions[0];
+    uint64_t rows = tensor.dimensions[1];
+    uint64_t matrix_count = tensor.dimensionality > 2 ? tensor.dimensions[2] : 1;
+    uint64_t matrix_size = rows * columns;
+    if (columns < 1 || rows < 1 || matrix_count < 1)
+        throw_error("Empty network tensor");
+
+    quantized = tensor.format == VKR_TENSOR_FORMAT_INT8;
+    float weight_scale = float(tensor.ratioDescriptor != 0.0 ? tensor.ratioDescriptor : 1.0 / 127.0);
+    TensorValues values = { tensor, weight_scale };
+    int const bias_lanes = (tensor.flags & VKR_TENSOR_FLAGS_IMPLICIT_BIASES) ? 1 : 0;
+    if (uint64_t(bias_lanes) >= columns || uint64_t(bias_lanes) >= rows)
+        throw_error("Network tensor matrices of %dx%d are too small for implicit biases", int(rows), int(columns));
+
+    // copies the rows and columns of a (block) matrix into a layer
+    auto copy_matrix = [&](NeuralLayer& layer, uint64_t matrix, bool transposed
+            , int input_begin, int input_count, int output_begin, int output_count) {
+        for (int o = 0; o < output_count; ++o) {
+            for (int i = 0; i < input_count; ++i) {
+                uint64_t element = transposed ? uint64_t(i) * rows + uint64_t(o) : uint64_t(o) * columns + uint64_t(i);
+                set_weight(layer, values, matrix * matrix_size + element, input_begin + i, output_begin + o);
+            }
+            if (bias_lanes) {
+                uint64_t element = transposed ? (columns - 1) * rows + uint64_t(o) : uint64_t(o) * columns + (columns - 1);
+                layer.biases[output_begin + o] += values(matrix * matrix_size + element);
+            }
+        }
+    };
+
+    int const feature_columns = int_cast(columns) - bias_lanes;
+    if (tensor.flags & VKR_TENSOR_FLAGS_INPUT_OUTPUT_SPEC) {
+        if (rows != columns)
+            throw_error("Network blocks have to be square, got %dx%d", int(rows), int(columns));
+        uint64_t input_blocks = tensor.numInputLayerBlocks;
+        uint64_t output_blocks = tensor.numOutputLayerBlocks;
+        if (input_blocks < 1 || output_blocks < 1 || input_blocks + output_blocks > matrix_count)
+            throw_error("Network tensor has %d blocks, which cannot hold %d input and %d output blocks"
+                , int(matrix_count), int(input_blocks), int(output_blocks));
+        if (tensor.numInputs > input_blocks * uint64_t(feature_columns) || tensor.numOutputs > output_blocks * rows)
+            throw_error("Network inputs (%d) or outputs (%d) exceed their blocks", int(tensor.numInputs), int(tensor.numOutputs));
+        int const hidden_width = int_cast(rows) - bias_lanes;
+        int const input_count = int_cast(tensor.numInputs);
+        int const output_count = int_cast(tensor.numOutputs);
+        uint64_t hidden_count = matrix_count - input_blocks - output_blocks;
+        bool transposed = (tensor.flags & VKR_TENSOR_FLAGS_OUTPUT_TRANSPOSED) != 0;
+
+        layers.resize(hidden_count + 2);
+        NeuralLayer& input_layer = layers.front();
+        allocate_layer(input_layer, input_count, hidden_width, true, quantized, weight_scale);
+        for (uint64_t b = 0; b < input_blocks; ++b) {
+            int begin = int(b) * feature_columns;
+            int count = std::min(feature_columns, input_count - begin);
+            if (count > 0 || bias_lanes)
+                copy_matrix(input_layer, b, false, begin, std::max(count, 0), 0, hidden_width);
+        }
+        for (uint64_t h = 0; h < hidden_count; ++h) {
+            NeuralLayer& layer = layers[1 + h];
+            allocate_layer(layer, hidden_width, hidden_width, true, quantized, weight_scale);
+            copy_matrix(layer, input_blocks + h, false, 0, feature_columns, 0, hidden_width);
+        }
+        NeuralLayer& output_layer = layers.back();
+        allocate_layer(output_layer, hidden_width, output_count, false, quantized, weight_scale);
+        for (uint64_t b = 0; b < output_blocks; ++b) {
+            int begin = int(b) * int_cast(rows);
+            int count = std::min(int_cast(rows), output_count - begin);
+            if (count > 0)
+                copy_matrix(output_layer, matrix_count - output_blocks + b, transposed, 0, feature_columns, begin, count);
+        }
+    } else {
+        if (matrix_count > 1 && int_cast(rows) - bias_lanes != feature_columns)
+            throw_error("Stacked network layers need matching widths, got %dx%d", int(rows), int(columns));
+        layers.resize(matrix_count);
+        for (uint64_t m = 0; m < matrix_count; ++m) {
+            bool last = m + 1 == matrix_count;
+            int output_count = int_cast(rows) - (last ? 0 : bias_lanes);
+            allocate_layer(layers[m], feature_columns, output_count, !last, quantized, weight_scale);
+            copy_matrix(layers[m], m, false, 0, feature_columns, 0, output_count);
+        }
+    }
+}
+
+int NeuralNetwork::max_width() const {
+    int width = 0;
+    for (auto& layer : layers)
+        width = std::max(width, std::max(layer.input_count, layer.output_count));
+    return width;
+}
+
+void NeuralNetwork::evaluate_tile(float const* inputs, float* outputs, int row_count
+    , NeuralScratch& scratch, NeuralProfile* profile) const {
+    if (layers.empty())
+        return;
+    assert(row_count <= TILE_ROWS);
+    size_t tile_size = size_t(TILE_ROWS) * max_width();
+    for (auto& activations : scratch.activations)
+        if (activations.size() < tile_size)
+            activations.resize(tile_size);
+    if (quantized && scratch.quantized_activations.size() < tile_size) {
+        scratch.quantized_activations.resize(tile_size);
+        scratch.activation_scales.resize(TILE_ROWS);
+    }
+
+    float const* x = inputs;
+    for (int l = 0; l < ilen(layers); ++l) {
+        auto start_time = std::chrono::steady_clock::now();
+        NeuralLayer const& layer = layers[l];
+        bool last = l + 1 == ilen(layers);
+        float* y = last ? outputs : scratch.activations[l % 2].data();
+        if (quantized)
+            gemm_rows_int8(layer, x, y, row_count, scratch);
+        else
+            gemm_rows_float(layer, x, y, row_count);
+        if (layer.relu) {
+            for (size_t i = 0, count = size_t(row_count) * layer.output_count; i < count; ++i)
+                y[i] = y[i] > 0.0f ? y[i] : 0.0f;
+        }
+        x = y;
+        if (profile) {
+            profile->layer_seconds[l] += seconds_since(start_time);
+            profile->layer_multiply_adds[l] += layer.multiply_adds(row_count);
+        }
+    }
+    if (profile)
+        profile->row_count += uint64_t(row_count);
+}
+
+void NeuralNetwork::evaluate(float const* inputs, float* outputs, int row_count
+    , int thread_count, NeuralProfile* profile) const {
+    std::mutex profile_mutex;
+    int tile_count = (row_count + TILE_ROWS - 1) / TILE_ROWS;
+    parallel_for(tile_count, [&](int tile_idx) {
+        thread_local NeuralScratch scratch;
+        NeuralProfile tile_profile;
+        if (profile)
+            tile_profile.reset(layers.size());
+        int begin = tile_idx * TILE_ROWS;
+        int count = std::min(TILE_ROWS, row_count - begin);
+        evaluate_tile(inputs + size_t(begin) * input_count(), outputs + size_t(begin) * output_count(), count
+            , scratch, profile ? &tile_profile : nullptr);
+        if (profile) {
+            std::lock_guard<std::mutex> lock(profile_mutex);
+            profile->accumulate(tile_profile);
+        }
+    }, thread_count);
+}
+
+void evaluate_neural_network_reference(NeuralNetwork const& network, float const* inputs, float* outputs, int row_count) {
+    std::vector<float> x, y;
+    for (int r = 0; r < row_count; ++r) {
+        x.assign(inputs + size_t(r) * network.input_count(), inputs + size_t(r + 1) * network.input_count());
+        for (auto& layer : network.layers) {
+            y.assign(layer.biases.begin(), layer.biases.begin() + layer.output_count);
+            for (int o = 0; o < layer.output_count; ++o) {
+                for (int i = 0; i < layer.input_count; ++i)
+                    y[o] += x[i] * layer.weight(i, o);
+                if (layer.relu)
+                    y[o] = y[o] > 0.0f ? y[o] : 0.0f;
+            }
+            std::swap(x, y);
+        }
+        std::copy(x.begin(), x.end(), outputs + size_t(r) * network.output_count());
+    }
+}
+
+void NeuralProfile::reset(size_t layer_count) {
+    layer_seconds.assign(layer_count, 0.0);
+    layer_multiply_adds.assign(layer_count, 0);
+    feature_seconds = 0.0;
+    row_count = 0;
+}
+
+void NeuralProfile::accumulate(NeuralProfile const& other) {
+    if (layer_seconds.size() < other.layer_seconds.size()) {
+        layer_seconds.resize(other.layer_seconds.size(), 0.0);
+        layer_multiply_adds.resize(other.layer_multiply_adds.size(), 0);
+    }
+    for (size_t l = 0; l < other.layer_seconds.size(); ++l) {
+        layer_seconds[l] += other.layer_seconds[l];
+        layer_multiply_adds[l] += other.layer_multiply_adds[l];
+    }
+    feature_seconds += other.feature_seconds;
+    row_count += other.row_count;
+}
+
+void NeuralNetwork::print_profile(NeuralProfile const& profile, char const* title) const {
+    double total_seconds = profile.feature_seconds;
+    for (double s : profile.layer_seconds)
+        total_seconds += s;
+    println(CLL::INFORMATION, "%s: %.2f M rows in %.2f ms of thread time (%s)", title
+        , double(profile.row_count) * 1.e-6, total_seconds * 1.e3, quantized ? "int8" : "float");
+    if (profile.feature_seconds > 0.0)
+        println(CLL::INFORMATION, "  features: %.2f ms (%.1f%%)", profile.feature_seconds * 1.e3
+            , 100.0 * profile.feature_seconds / total_seconds);
+    for (size_t l = 0; l < profile.layer_seconds.size() && l < layers.size(); ++l) {
+        double seconds = profile.layer_seconds[l];
+        double gmacs = seconds > 0.0 ? double(profile.layer_multiply_adds[l]) / seconds * 1.e-9 : 0.0;
+        println(CLL::INFORMATION, "  layer %d (%dx%d): %.2f ms (%.1f%%), %.2f GMAC/s per thread", int(l)
+            , layers[l].input_count, layers[l].output_count
+            , seconds * 1.e3, total_seconds > 0.0 ? 100.0 * seconds / total_seconds : 0.0, gmacs);
+    }
+}
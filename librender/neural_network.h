@@ -0,0 +1,89 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VkrTensor;
+
+// Fully connected layers of a network stored in a VkrTensor. The tensor is a stack
+// of dimensions[2] matrices with dimensions[1] rows (outputs) of dimensions[0] columns
+// (inputs), inputs vary fastest. With VKR_TENSOR_FLAGS_INPUT_OUTPUT_SPEC, the matrices
+// are square blocks: the first numInputLayerBlocks blocks are summed to form the input
+// layer (block b sees inputs [b * width, (b + 1) * width)), the last numOutputLayerBlocks
+// blocks each produce width outputs of the output layer, and all blocks in between are
+// hidden layers. VKR_TENSOR_FLAGS_OUTPUT_TRANSPOSED stores the output blocks with outputs
+// varying fastest. With VKR_TENSOR_FLAGS_IMPLICIT_BIASES, the last column of every matrix
+// multiplies a constant one, i.e. holds the biases, and the last row of hidden layers is
+// unused. Int8 values are scaled by ratioDescriptor (1/127 if zero). All layers but the
+// output layer apply a ReLU. Per-pixel convolutions are expressed by the caller gathering
+// the pixel neighborhoods into the inputs of each row (see neural_denoiser.h).
+struct NeuralLayer {
+    static int const OUTPUT_BLOCK = 16; // outputs accumulated in registers by the kernels
+
+    int input_count = 0;
+    int output_count = 0;
+    int output_stride = 0; // output_count padded to OUTPUT_BLOCK
+    bool relu = true;
+    // transposed to inputs x padded outputs, such that kernels stream over contiguous outputs
+    std::vector<float> weights;
+    std::vector<int8_t> quantized_weights;
+    float weight_scale = 1.0f; // of quantized weights
+    std::vector<float> biases; // padded
+
+    float weight(int input, int output) const {
+        size_t idx = size_t(input) * output_stride + output;
+        return quantized_weights.empty() ? weights[idx] : float(quantized_weights[idx]) * weight_scale;
+    }
+
+    uint64_t multiply_adds(int row_count) const { return uint64_t(row_count) * uint64_t(input_count) * uint64_t(output_count); }
+};
+
+// Accumulated timings of all rows evaluated with a profile, over all threads
+struct NeuralProfile {
+    std::vector<double> layer_seconds;
+    std::vector<uint64_t> layer_multiply_adds;
+    double feature_seconds = 0.0; // gathering inputs, e.g. denoiser features
+    uint64_t row_count = 0;
+
+    void reset(size_t layer_count);
+    void accumulate(NeuralProfile const& other);
+};
+
+// Per-thread working memory of tiled evaluation
+struct NeuralScratch {
+    std::vector<float> activations[2];
+    std::vector<int8_t> quantized_activations;
+    std::vector<float> activation_scales;
+};
+
+struct NeuralNetwork {
+    static int const TILE_ROWS = 64; // rows evaluated together, activations stay in cache
+
+    std::vector<NeuralLayer> layers;
+    bool quantized = false;
+
+    NeuralNetwork() = default;
+    // throws if the tensor does not describe a supported network
+    explicit NeuralNetwork(VkrTensor const& tensor);
+
+    int input_count() const { return layers.empty() ? 0 : layers.front().input_count; }
+    int output_count() const { return layers.empty() ? 0 : layers.back().output_count; }
+    int max_width() const;
+
+    // Evaluates up to TILE_ROWS rows of input_count() inputs each into rows of
+    // output_count() outputs on the calling thread
+    void evaluate_tile(float const* inputs, float* outputs, int row_count
+        , NeuralScratch& scratch, NeuralProfile* profile = nullptr) const;
+    // Evaluates all rows in tiles on up to thread_count threads (0 = all cores)
+    void evaluate(float const* inputs, float* outputs, int row_count
+        , int thread_count = 0, NeuralProfile* profile = nullptr) const;
+
+    void print_profile(NeuralProfile const& profile, char const* title) const;
+};
+
+// Reference evaluation without tiling or quantized arithmetic, for tests
+void evaluate_neural_network_reference(NeuralNetwork const& network, float const* inputs, float* outputs, int row_count);
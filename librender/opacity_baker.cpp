@@ -0,0 +1,184 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "opacity_baker.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cmath>
+
+AlphaRangeTexture::AlphaRangeTexture(int width, int height, int mip_levels, uint8_t const* rgba8_mips, int max_mip_level) {
+    if (width < 1 || height < 1 || mip_levels < 1)
+        throw_error("Invalid alpha texture dimensions %dx%d with %d levels", width, height, mip_levels);
+    int level_count = std::min(std::max(max_mip_level, 0) + 1, mip_levels);
+    levels.resize(level_count);
+    size_t offset = 0;
+    for (int m = 0; m < level_count; ++m) {
+        Pyramid base;
+        base.width = std::max(width >> m, 1);
+        base.height = std::max(height >> m, 1);
+        size_t texel_count = size_t(base.width) * base.height;
+        base.min_alpha.resize(texel_count);
+        for (size_t i = 0; i < texel_count; ++i)
+            base.min_alpha[i] = rgba8_mips[offset + 4 * i + 3];
+        base.max_alpha = base.min_alpha;
+        offset += 4 * texel_count;
+
+        auto& pyramid = levels[m];
+        pyramid.push_back(std::move(base));
+        while (pyramid.back().width > 1 || pyramid.back().height > 1) {
+            Pyramid const& fine = pyramid.back();
+            Pyramid coarse;
+            coarse.width = (fine.width + 1) / 2;
+            coarse.height = (fine.height + 1) / 2;
+            coarse.min_alpha.resize(size_t(coarse.width) * coarse.height);
+            coarse.max_alpha.resize(size_t(coarse.width) * coarse.height);
+            for (int y = 0; y < coarse.height; ++y)
+                for (int x = 0; x < coarse.width; ++x) {
+                    uint8_t lo = 255, hi = 0;
+                    for (int fy = 2 * y; fy < std::min(2 * y + 2, fine.height); ++fy)
+                        for (int fx = 2 * x; fx < std::min(2 * x + 2, fine.width); ++fx) {
+                            lo = std::min(lo, fine.min_alpha[size_t(fy) * fine.width + fx]);
+                            hi = std::max(hi, fine.max_alpha[size_t(fy) * fine.width + fx]);
+                        }
+                    coarse.min_alpha[size_t(y) * coarse.width + x] = lo;
+                    coarse.max_alpha[size_t(y) * coarse.width + x] = hi;
+                }
+            pyramid.push_back(std::move(coarse));
+        }
+    }
+}
+
+static void cell_range(std::vector<AlphaRangeTexture::Pyramid> const& pyramid, int k, int cx, int cy, int x0, int y0, int x1, int y1, int& lo, int& hi) {
+    auto const& level = pyramid[k];
+    if (cx >= level.width || cy >= level.height)
+        return;
+    int first_x = cx << k, last_x = ((cx + 1) << k) - 1;
+    int first_y = cy << k, last_y = ((cy + 1) << k) - 1;
+    if (last_x < x0 || first_x > x1 || last_y < y0 || first_y > y1)
+        return;
+    // cells that are only partially covered are refined to stay exact
+    if (k > 0 && (first_x < x0 || last_x > x1 || first_y < y0 || last_y > y1)) {
+        for (int j = 0; j < 2; ++j)
+            for (int i = 0; i < 2; ++i)
+                cell_range(pyramid, k - 1, 2 * cx + i, 2 * cy + j, x0, y0, x1, y1, lo, hi);
+        return;
+    }
+    lo = std::min(lo, int(level.min_alpha[size_t(cy) * level.width + cx]));
+    hi = std::max(hi, int(level.max_alpha[size_t(cy) * level.width + cx]));
+}
+
+// range of a texel rectangle within the bounds of the level, starting from the coarsest
+// pyramid level at which it still spans a few cells
+static void pyramid_range(std::vector<AlphaRangeTexture::Pyramid> const& pyramid, int x0, int y0, int x1, int y1, int& lo, int& hi) {
+    int k = 0;
+    while (k + 1 < (int) pyramid.size() && ((x1 >> k) - (x0 >> k) > 3 || (y1 >> k) - (y0 >> k) > 3))
+        ++k;
+    for (int y = y0 >> k; y <= (y1 >> k); ++y)
+        for (int x = x0 >> k; x <= (x1 >> k); ++x)
+            cell_range(pyramid, k, x, y, x0, y0, x1, y1, lo, hi);
+}
+
+// texel intervals covering the bilinear footprint of [t0, t1], wrapped into [0, size)
+static int wrapped_intervals(float t0, float t1, int size, int (&lower)[2], int (&upper)[2]) {
+    double first = std::floor(double(t0) * size - 0.5);
+    double last = std::floor(double(t1) * size - 0.5) + 1.0;
+    if (last - first + 1.0 >= size) {
+        lower[0] = 0;
+        upper[0] = size - 1;
+        return 1;
+    }
+    int lo = int(first - std::floor(first / size) * size);
+    int hi = lo + int(last - first);
+    if (hi < size) {
+        lower[0] = lo;
+        upper[0] = hi;
+        return 1;
+    }
+    lower[0] = lo;
+    upper[0] = size - 1;
+    lower[1] = 0;
+    upper[1] = hi - size;
+    return 2;
+}
+
+void AlphaRangeTexture::alpha_range(float u0, float v0, float u1, float v1, int& min_alpha, int& max_alpha) const {
+    min_alpha = 255;
+    max_alpha = 0;
+    if (!(std::isfinite(u0) && std::isfinite(v0) && std::isfinite(u1) && std::isfinite(v1)) || levels.empty()) {
+        min_alpha = 0;
+        max_alpha = 255;
+        return;
+    }
+    for (auto const& pyramid : levels) {
+        int x_lower[2], x_upper[2], y_lower[2], y_upper[2];
+        int x_count = wrapped_intervals(u0, u1, pyramid[0].width, x_lower, x_upper);
+        int y_count = wrapped_intervals(v0, v1, pyramid[0].height, y_lower, y_upper);
+        for (int j = 0; j < y_count; ++j)
+            for (int i = 0; i < x_count; ++i)
+                pyramid_range(pyramid, x_lower[i], y_lower[j], x_upper[i], y_upper[j], min_alpha, max_alpha);
+    }
+}
+
+static uint8_t classify(AlphaRangeTexture const& alpha, float const (&a)[2], float const (&b)[2], float const (&c)[2], OpacityBakeParams const& params) {
+    int lo, hi;
+    alpha.alpha_range(std::min(std::min(a[0], b[0]), c[0]), std::min(std::min(a[1], b[1]), c[1])
+        , std::max(std::max(a[0], b[0]), c[0]), std::max(std::max(a[1], b[1]), c[1]), lo, hi);
+    if (lo >= params.opaque_alpha)
+        return OPACITY_STATE_OPAQUE;
+    if (hi <= params.transparent_alpha)
+        return OPACITY_STATE_TRANSPARENT;
+    return OPACITY_STATE_UNKNOWN;
+}
+
+std::vector<uint8_t> bake_opacity_states(AlphaRangeTexture const& alpha, float const* triangle_uvs, size_t triangle_count
+    , OpacityBakeParams const& params, std::vector<uint8_t>* micro_states) {
+    if (params.subdivision_level < 0 || params.subdivision_level > 12)
+        throw_error("Opacity states support subdivision levels from 0 to 12");
+    int n = 1 << params.subdivision_level;
+    size_t micro_count = size_t(n) * n;
+    std::vector<uint8_t> states(triangle_count);
+    if (micro_states)
+        micro_states->resize(triangle_count * micro_count);
+
+    for (size_t t = 0; t < triangle_count; ++t) {
+        float const* uv = &triangle_uvs[6 * t];
+        auto corner = [&](int i, int j, float (&p)[2]) {
+            float s = float(i) / float(n), r = float(j) / float(n);
+            for (int k = 0; k < 2; ++k)
+                p[k] = uv[k] + (uv[2 + k] - uv[k]) * s + (uv[4 + k] - uv[k]) * r;
+        };
+        bool all_opaque = true, all_transparent = true;
+        size_t micro = 0;
+        for (int j = 0; j < n; ++j)
+            for (int i = 0; i < n - j; ++i) {
+                float p00[2], p10[2], p01[2], p11[2];
+                corner(i, j, p00);
+                corner(i + 1, j, p10);
+                corner(i, j + 1, p01);
+                uint8_t state = classify(alpha, p00, p10, p01, params);
+                all_opaque &= state == OPACITY_STATE_OPAQUE;
+                all_transparent &= state == OPACITY_STATE_TRANSPARENT;
+                if (micro_states)
+                    (*micro_states)[t * micro_count + micro] = state;
+                ++micro;
+                if (i < n - 1 - j) {
+                    corner(i + 1, j + 1, p11);
+                    state = classify(alpha, p10, p11, p01, params);
+                    all_opaque &= state == OPACITY_STATE_OPAQUE;
+                    all_transparent &= state == OPACITY_STATE_TRANSPARENT;
+                    if (micro_states)
+                        (*micro_states)[t * micro_count + micro] = state;
+                    ++micro;
+                }
+            }
+        states[t] = all_opaque ? OPACITY_STATE_OPAQUE : all_transparent ? OPACITY_STATE_TRANSPARENT : OPACITY_STATE_UNKNOWN;
+    }
+    return states;
+}
+
+std::vector<uint32_t> pack_opacity_states(uint8_t const* states, size_t count) {
+    std::vector<uint32_t> packed((count + OPACITY_STATES_PER_WORD - 1) / OPACITY_STATES_PER_WORD, 0);
+    for (size_t i = 0; i < count; ++i)
+        packed[i / OPACITY_STATES_PER_WORD] |= uint32_t(states[i] & 3) << (2 * (i % OPACITY_STATES_PER_WORD));
+    return packed;
+}
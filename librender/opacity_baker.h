@@ -0,0 +1,61 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace glsl {
+    #include "opacity_states.glsl"
+}
+
+// Conservative classification of triangles of alpha-tested geometry as fully opaque, fully
+// transparent or unknown (opacity_states.glsl). Triangles are split into 4^subdivision_level
+// micro-triangles, the uv bounds of each are looked up in min/max pyramids of the alpha
+// channel of the base color mip chain. A micro-triangle is known only if all texels that
+// bilinear filtering can read on the considered mip levels agree, addressing is assumed
+// to repeat. Triangles are known if all of their micro-triangles agree.
+//
+// Micro-triangles of a triangle with uvs (t0, t1, t2) are ordered by rows of the
+// barycentric grid with n = 2^subdivision_level segments per edge: for row j in 0..n-1 and
+// column i in 0..n-1-j, the upright micro-triangle with corners (i, j), (i+1, j), (i, j+1),
+// followed by the inverted one with corners (i+1, j), (i+1, j+1), (i, j+1) if i < n-1-j,
+// where corner (i, j) is at t0 + (t1 - t0) * i / n + (t2 - t0) * j / n.
+
+struct OpacityBakeParams {
+    // alpha values at or above are opaque, at or below transparent (8 bit scale)
+    int opaque_alpha = 255;
+    int transparent_alpha = 0;
+    // coarsest mip level that the renderer is assumed to sample
+    int max_mip_level = 0;
+    int subdivision_level = 0;
+};
+
+// Min/max pyramids of the alpha channel of each mip level of a texture
+struct AlphaRangeTexture {
+    struct Pyramid {
+        int width;
+        int height;
+        std::vector<uint8_t> min_alpha;
+        std::vector<uint8_t> max_alpha;
+    };
+    // per mip level, pyramid levels from the mip level itself up to a single texel
+    std::vector<std::vector<Pyramid>> levels;
+
+    AlphaRangeTexture() = default;
+    // mips are RGBA8 with unpadded levels, finest first, as returned by Image::decompressBytes()
+    AlphaRangeTexture(int width, int height, int mip_levels, uint8_t const* rgba8_mips, int max_mip_level);
+
+    // range of alpha values that filtered lookups within the uv bounds can return
+    void alpha_range(float u0, float v0, float u1, float v1, int& min_alpha, int& max_alpha) const;
+};
+
+// classifies the triangles given by uv triplets, returns one state per triangle
+// and, if micro_states is given, 4^subdivision_level states per triangle
+std::vector<uint8_t> bake_opacity_states(AlphaRangeTexture const& alpha, float const* triangle_uvs, size_t triangle_count
+    , OpacityBakeParams const& params, std::vector<uint8_t>* micro_states = nullptr);
+
+// packs states as read by calc_hit_opacity_state(), see OPACITY_STATES_PER_WORD
+std::vector<uint32_t> pack_opacity_states(uint8_t const* states, size_t count);
@@ -0,0 +1,22 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef OPACITY_STATES_H_GLSL
+#define OPACITY_STATES_H_GLSL
+
+// Opacity states of triangles of alpha-tested geometry, baked on the CPU (opacity_baker.h).
+// Known states replace the evaluation of material alpha in any-hit and candidate hit
+// tests, unknown triangles are still tested. The values match the 4-state format of
+// opacity micromaps, with unknown mapped to unknown-transparent.
+#define OPACITY_STATE_TRANSPARENT 0
+#define OPACITY_STATE_OPAQUE 1
+#define OPACITY_STATE_UNKNOWN 2
+
+// states are packed at 2 bits per triangle, 16 triangles per 32 bit word
+#define OPACITY_STATES_PER_WORD 16
+
+inline uint32_t unpack_opacity_state(uint32_t word, uint32_t triangle) {
+    return (word >> (2u * (triangle & 15u))) & 3u;
+}
+
+#endif
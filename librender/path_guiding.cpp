@@ -0,0 +1,178 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "path_guiding.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cstring>
+
+PathGuidingField::PathGuidingField(PathGuidingConfig const& config)
+    : config(config) {
+    if (config.max_cells < 1 || config.max_cells > PATH_GUIDING_MAX_CELLS)
+        throw_error("Path guiding supports between 1 and %d cells", PATH_GUIDING_MAX_CELLS);
+    if (!(config.uniform_fraction >= 0.0f && config.uniform_fraction <= 1.0f))
+        throw_error("Path guiding requires a uniform fraction between 0 and 1");
+}
+
+void PathGuidingField::reset(float const (&lower)[3], float const (&upper)[3]) {
+    nodes.assign(1, glsl::PathGuidingNode{ -1, 0.0f, -1, 0 });
+    Region root;
+    for (int i = 0; i < 3; ++i) {
+        root.lower[i] = lower[i];
+        root.upper[i] = upper[i];
+    }
+    root.depth = 0;
+    regions.assign(1, root);
+    Cell cell = { };
+    cell.node = 0;
+    cells.assign(1, cell);
+    cdfs.assign(PATH_GUIDING_BINS, 0.0f);
+    fit(0);
+    iteration = 0;
+    iteration_samples = 0;
+}
+
+void PathGuidingField::add_samples(glsl::PathGuidingSample const* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        auto const& s = samples[i];
+        if (!(std::isfinite(s.px) && std::isfinite(s.py) && std::isfinite(s.pz)))
+            continue;
+        if (!(s.radiance >= 0.0f && std::isfinite(s.radiance) && s.pdf > 0.0f && std::isfinite(s.pdf)))
+            continue;
+        int cell = lookup_cell(s.px, s.py, s.pz);
+        if (cell < 0)
+            continue;
+        auto& c = cells[cell];
+        c.energy[glsl::path_guiding_direction_bin(s.dx, s.dy, s.dz)] += s.radiance / s.pdf;
+        c.sample_count += 1.0f;
+        ++iteration_samples;
+    }
+}
+
+void PathGuidingField::split(int cell) {
+    int node = cells[cell].node;
+    Region region = regions[node];
+    int axis = 0;
+    for (int i = 1; i < 3; ++i)
+        if (region.upper[i] - region.lower[i] > region.upper[axis] - region.lower[axis])
+            axis = i;
+    float split = 0.5f * (region.lower[axis] + region.upper[axis]);
+
+    // children inherit the statistics of the parent, until their own samples arrive
+    Cell& parent = cells[cell];
+    for (float& e : parent.energy)
+        e *= 0.5f;
+    parent.sample_count *= 0.5f;
+    Cell sibling = parent;
+
+    int child = (int) nodes.size();
+    nodes[node] = glsl::PathGuidingNode{ axis, split, child, -1 };
+    Region lower_region = region, upper_region = region;
+    lower_region.upper[axis] = split;
+    upper_region.lower[axis] = split;
+    lower_region.depth = upper_region.depth = region.depth + 1;
+
+    parent.node = child;
+    sibling.node = child + 1;
+    nodes.push_back(glsl::PathGuidingNode{ -1, 0.0f, -1, cell });
+    nodes.push_back(glsl::PathGuidingNode{ -1, 0.0f, -1, (int) cells.size() });
+    regions.push_back(lower_region);
+    regions.push_back(upper_region);
+    cells.push_back(sibling);
+}
+
+void PathGuidingField::fit(int cell) {
+    auto& c = cells[cell];
+    float total = 0.0f;
+    for (float e : c.energy)
+        total += e;
+    float scale = 0.0f;
+    float uniform = 1.0f / float(PATH_GUIDING_BINS);
+    if (total > 0.0f) {
+        scale = (1.0f - config.uniform_fraction) / total;
+        uniform *= config.uniform_fraction;
+    }
+    float* cdf = &cdfs[size_t(cell) * PATH_GUIDING_BINS];
+    float sum = 0.0f;
+    for (int b = 0; b < PATH_GUIDING_BINS; ++b) {
+        sum += c.energy[b] * scale + uniform;
+        cdf[b] = sum;
+    }
+    for (int b = 0; b < PATH_GUIDING_BINS; ++b)
+        cdf[b] /= sum;
+    cdf[PATH_GUIDING_BINS - 1] = 1.0f;
+}
+
+void PathGuidingField::refine_and_fit() {
+    if (nodes.empty())
+        return;
+    int max_depth = std::min(config.max_depth, PATH_GUIDING_MAX_DEPTH - 1);
+    // new cells are appended and may split again in the same iteration
+    for (int c = 0; c < (int) cells.size(); ++c)
+        while (cells[c].sample_count >= config.split_sample_count
+            && regions[cells[c].node].depth < max_depth
+            && (int) cells.size() < config.max_cells)
+            split(c);
+
+    cdfs.resize(cells.size() * PATH_GUIDING_BINS);
+    for (int c = 0; c < (int) cells.size(); ++c) {
+        fit(c);
+        for (float& e : cells[c].energy)
+            e *= config.history_decay;
+        cells[c].sample_count *= config.history_decay;
+    }
+    ++iteration;
+    iteration_samples = 0;
+}
+
+int PathGuidingField::lookup_cell(float x, float y, float z) const {
+    if (nodes.empty())
+        return -1;
+    int node = 0;
+    for (int depth = 0; depth <= PATH_GUIDING_MAX_DEPTH; ++depth) {
+        auto const& n = nodes[node];
+        if (n.axis < 0)
+            return n.cell;
+        node = glsl::path_guiding_child(n, x, y, z);
+    }
+    return -1;
+}
+
+float PathGuidingField::pdf(int cell, float dx, float dy, float dz) const {
+    float const* cdf = &cdfs[size_t(cell) * PATH_GUIDING_BINS];
+    int bin = glsl::path_guiding_direction_bin(dx, dy, dz);
+    return glsl::path_guiding_bin_density(cdf[bin] - (bin > 0 ? cdf[bin - 1] : 0.0f));
+}
+
+float PathGuidingField::sample(int cell, float u_bin, float u, float v, float (&dir)[3]) const {
+    float const* cdf = &cdfs[size_t(cell) * PATH_GUIDING_BINS];
+    int bin = int(std::upper_bound(cdf, cdf + PATH_GUIDING_BINS, u_bin) - cdf);
+    bin = std::min(bin, PATH_GUIDING_BINS - 1);
+    float cos_theta = glsl::path_guiding_bin_cos_theta(bin, u);
+    float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = glsl::path_guiding_bin_phi(bin, v);
+    dir[0] = sin_theta * std::cos(phi);
+    dir[1] = sin_theta * std::sin(phi);
+    dir[2] = cos_theta;
+    return glsl::path_guiding_bin_density(cdf[bin] - (bin > 0 ? cdf[bin - 1] : 0.0f));
+}
+
+size_t PathGuidingField::gpu_buffer_size() {
+    return sizeof(glsl::PathGuidingFieldHeader)
+        + sizeof(glsl::PathGuidingNode) * PATH_GUIDING_MAX_NODES
+        + sizeof(float) * PATH_GUIDING_BINS * PATH_GUIDING_MAX_CELLS;
+}
+
+void PathGuidingField::write_gpu_buffer(void* buffer) const {
+    auto header = (glsl::PathGuidingFieldHeader*) buffer;
+    auto gpu_nodes = (glsl::PathGuidingNode*) (header + 1);
+    auto gpu_cdfs = (float*) (gpu_nodes + PATH_GUIDING_MAX_NODES);
+    header->node_count = uint32_t(nodes.size());
+    header->cell_count = uint32_t(cells.size());
+    header->iteration = uint32_t(iteration);
+    header->_pad = 0;
+    if (!nodes.empty()) {
+        std::memcpy(gpu_nodes, nodes.data(), sizeof(nodes[0]) * nodes.size());
+        std::memcpy(gpu_cdfs, cdfs.data(), sizeof(cdfs[0]) * cdfs.size());
+    }
+}
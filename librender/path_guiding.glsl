@@ -0,0 +1,109 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef PATH_GUIDING_H_GLSL
+#define PATH_GUIDING_H_GLSL
+
+// Guiding field of practical path guiding, shared by the megakernel integrators
+// (vulkan/path_guiding.glsl) and the CPU training and fitting in path_guiding.h.
+// Space is subdivided by a kd-tree, each leaf holds a piecewise-constant distribution
+// of incident radiance over equal-area bins of the sphere of directions. Bins are
+// regular in cos(theta) and phi around the world z axis.
+
+#define PATH_GUIDING_THETA_BINS 8
+#define PATH_GUIDING_PHI_BINS 16
+#define PATH_GUIDING_BINS (PATH_GUIDING_THETA_BINS * PATH_GUIDING_PHI_BINS)
+#define PATH_GUIDING_MAX_CELLS 4096
+#define PATH_GUIDING_MAX_NODES (2 * PATH_GUIDING_MAX_CELLS)
+#define PATH_GUIDING_MAX_DEPTH 32
+// training samples written per frame, excess samples are dropped
+#define PATH_GUIDING_MAX_SAMPLES (1 << 16)
+// guided vertices per path that are recorded for training
+#define PATH_GUIDING_PATH_VERTICES 4
+
+#define PATH_GUIDING_PI 3.14159265358979323846f
+#ifndef PATH_GUIDING_ATAN2
+    #define PATH_GUIDING_ATAN2(y, x) atan(y, x)
+#endif
+
+// Inner nodes split at the given coordinate along axis, their children are stored
+// next to each other starting at child. Leaves (axis < 0) refer to a cell.
+struct PathGuidingNode {
+    int32_t axis;
+    float split;
+    int32_t child;
+    int32_t cell;
+};
+
+// The field buffer holds the header, PATH_GUIDING_MAX_NODES nodes, and the
+// cumulative bin distributions of all cells (PATH_GUIDING_BINS floats each)
+struct PathGuidingFieldHeader {
+    uint32_t node_count;
+    uint32_t cell_count;
+    uint32_t iteration;
+    uint32_t _pad;
+};
+
+// Incident radiance estimate at a path vertex, as seen along the sampled direction
+struct PathGuidingSample {
+    float px, py, pz;
+    float dx, dy, dz;
+    // luminance of the incident radiance
+    float radiance;
+    // density the direction was sampled with
+    float pdf;
+};
+
+// The sample buffer holds the header followed by up to PATH_GUIDING_MAX_SAMPLES samples
+struct PathGuidingSampleHeader {
+    // counts all written samples, including those that exceeded the capacity
+    uint32_t count;
+    uint32_t _pad0;
+    uint32_t _pad1;
+    uint32_t _pad2;
+};
+
+inline int path_guiding_child(PathGuidingNode node, float x, float y, float z) {
+    float p = node.axis == 0 ? x : node.axis == 1 ? y : z;
+    return node.child + (p >= node.split ? 1 : 0);
+}
+
+inline int path_guiding_direction_bin(float x, float y, float z) {
+    float u = 0.5f * (z + 1.0f);
+    float phi = PATH_GUIDING_ATAN2(y, x);
+    float v = phi * (0.5f / PATH_GUIDING_PI) + (phi < 0.0f ? 1.0f : 0.0f);
+    int theta_bin = int(u * float(PATH_GUIDING_THETA_BINS));
+    int phi_bin = int(v * float(PATH_GUIDING_PHI_BINS));
+    theta_bin = theta_bin < 0 ? 0 : theta_bin < PATH_GUIDING_THETA_BINS ? theta_bin : PATH_GUIDING_THETA_BINS - 1;
+    phi_bin = phi_bin < 0 ? 0 : phi_bin < PATH_GUIDING_PHI_BINS ? phi_bin : PATH_GUIDING_PHI_BINS - 1;
+    return theta_bin * PATH_GUIDING_PHI_BINS + phi_bin;
+}
+
+// solid angle density of directions in a bin of the given probability
+inline float path_guiding_bin_density(float bin_probability) {
+    return bin_probability * (float(PATH_GUIDING_BINS) / (4.0f * PATH_GUIDING_PI));
+}
+
+// direction within a bin from two uniform numbers, as cos(theta) and phi
+inline float path_guiding_bin_cos_theta(int bin, float u) {
+    float theta_bin = float(bin / PATH_GUIDING_PHI_BINS);
+    float cos_theta = 2.0f * (theta_bin + u) / float(PATH_GUIDING_THETA_BINS) - 1.0f;
+    return cos_theta < -1.0f ? -1.0f : cos_theta < 1.0f ? cos_theta : 1.0f;
+}
+inline float path_guiding_bin_phi(int bin, float v) {
+    float phi_bin = float(bin - (bin / PATH_GUIDING_PHI_BINS) * PATH_GUIDING_PHI_BINS);
+    return 2.0f * PATH_GUIDING_PI * (phi_bin + v) / float(PATH_GUIDING_PHI_BINS);
+}
+
+// uniform random number deciding which paths are recorded for training
+inline float path_guiding_training_random(uint32_t sample_index, uint32_t pixel) {
+    uint32_t state = pixel * 0x85ebca6bu ^ sample_index * 0xc2b2ae35u;
+    state ^= state >> 16;
+    state *= 0x7feb352du;
+    state ^= state >> 15;
+    state *= 0x846ca68bu;
+    state ^= state >> 16;
+    return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
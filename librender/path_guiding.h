@@ -0,0 +1,76 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define PATH_GUIDING_ATAN2(y, x) std::atan2(y, x)
+namespace glsl {
+    #include "path_guiding.glsl"
+}
+
+// Training and fitting of the path guiding field (path_guiding.glsl) from the samples
+// that the integrators record at path vertices. Between frames, leaves that received
+// enough samples are split at the middle of their longest axis, then the directional
+// distribution of each cell is refitted from the radiance it received, blended with
+// the history of previous iterations.
+
+struct PathGuidingConfig {
+    // leaves are split once their (decayed) sample count reaches this threshold
+    float split_sample_count = 4000.0f;
+    int max_depth = 24;
+    int max_cells = PATH_GUIDING_MAX_CELLS;
+    // fraction of uniform density mixed into each distribution, such that no direction is missed
+    float uniform_fraction = 0.1f;
+    // weight of the accumulated statistics of previous iterations
+    float history_decay = 0.5f;
+};
+
+struct PathGuidingField {
+    struct Region {
+        float lower[3];
+        float upper[3];
+        int depth;
+    };
+    struct Cell {
+        // sums of radiance over sampling density, per directional bin
+        float energy[PATH_GUIDING_BINS];
+        float sample_count;
+        int node;
+    };
+
+    PathGuidingConfig config;
+    std::vector<glsl::PathGuidingNode> nodes;
+    std::vector<Region> regions; // note: indexed by node
+    std::vector<Cell> cells;
+    // cumulative bin distributions, PATH_GUIDING_BINS per cell
+    std::vector<float> cdfs;
+    int iteration = 0;
+    uint64_t iteration_samples = 0;
+
+    PathGuidingField(PathGuidingConfig const& config = PathGuidingConfig());
+    // restarts training with a single uniform cell covering the given bounds
+    void reset(float const (&lower)[3], float const (&upper)[3]);
+
+    // invalid samples (non-finite or negative radiance, zero density) are skipped
+    void add_samples(glsl::PathGuidingSample const* samples, size_t count);
+    // splits leaves that received enough samples, then refits all distributions
+    void refine_and_fit();
+
+    int lookup_cell(float x, float y, float z) const;
+    float pdf(int cell, float dx, float dy, float dz) const;
+    // samples a direction from three uniform numbers, returns its density
+    float sample(int cell, float u_bin, float u, float v, float (&dir)[3]) const;
+
+    // layout of the field buffer read by the integrators
+    static size_t gpu_buffer_size();
+    void write_gpu_buffer(void* buffer) const;
+
+private:
+    void split(int cell);
+    void fit(int cell);
+};
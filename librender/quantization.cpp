@@ -3,6 +3,7 @@
 
 #include "quantization.h"
 #include "mesh.h"
+#include <cassert>
 #include <cstring>
 
 namespace glsl {
@@ -12,6 +13,38 @@ namespace glsl {
 }
 #include "../librender/quantize.h"
 
+namespace {
+
+template <class T, class S>
+void convert_material_ids(T* __restrict target, S const* __restrict source, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        target[i] = T(source[i]);
+}
+
+template <class T>
+void dequantize_material_ids_to(T* target, size_t count
+    , void const* source, uint32_t material_id_bitcount) {
+    if (8 * sizeof(T) == material_id_bitcount) {
+        std::memcpy(target, source, sizeof(T) * count);
+        return;
+    }
+    switch (material_id_bitcount) {
+    case 8:
+        convert_material_ids(target, (uint8_t const*) source, count);
+        break;
+    case 16:
+        convert_material_ids(target, (uint16_t const*) source, count);
+        break;
+    case 32:
+        convert_material_ids(target, (uint32_t const*) source, count);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+} // namespace
+
 void dequantize_vertices(void* target, size_t stride, size_t vertexCount
     , void const* source, uint32_t format_flags
     , glm::vec3 quantized_scaling, glm::vec3 quantized_offset) {
@@ -58,3 +91,13 @@ void dequantize_uvs(glm::vec2* target, size_t vertexCount
     else
         std::memcpy(target, source, sizeof(glm::vec2) * vertexCount);
 }
+
+void dequantize_material_ids(uint32_t* target, size_t count
+    , void const* source, uint32_t material_id_bitcount) {
+    dequantize_material_ids_to(target, count, source, material_id_bitcount);
+}
+
+void dequantize_material_ids(uint8_t* target, size_t count
+    , void const* source, uint32_t material_id_bitcount) {
+    dequantize_material_ids_to(target, count, source, material_id_bitcount);
+}
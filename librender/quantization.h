@@ -3,6 +3,7 @@
 
 #pragma once
 #include <glm/glm.hpp>
+#include <cstddef>
 #include <cstdint>
 
 void dequantize_vertices(void* target, size_t stride, size_t vertexCount
@@ -13,27 +14,9 @@ void dequantize_normals(glm::vec3* target, size_t vertexCount
 void dequantize_uvs(glm::vec2* target, size_t vertexCount
     , void const* source, uint32_t format_flags);
 
-template <class T>
-inline void dequantize_material_ids(T* target, size_t vertexCount
-    , void const* source, uint32_t material_id_bitcount) {
-    if (8 * sizeof(T) == material_id_bitcount) {
-        memcpy(target, source, sizeof(T) * vertexCount);
-        return;
-    }
-    switch (material_id_bitcount) {
-    case 8:
-        for (size_t i = 0; i < vertexCount; ++i)
-            target[i] = ((uint8_t const*) source)[i];
-        break;
-    case 16:
-        for (size_t i = 0; i < vertexCount; ++i)
-            target[i] = ((uint16_t const*) source)[i];
-        break;
-    case 32:
-        for (size_t i = 0; i < vertexCount; ++i)
-            target[i] = ((uint32_t const*) source)[i];
-        break;
-    default:
-        assert(false);
-    }
-}
+// Converts per-triangle material IDs of 8, 16 or 32 bits, one tight loop per width that
+// compilers vectorize. 8 bit targets truncate, as the IDs uploaded for the shaders.
+void dequantize_material_ids(uint32_t* target, size_t count
+    , void const* source, uint32_t material_id_bitcount);
+void dequantize_material_ids(uint8_t* target, size_t count
+    , void const* source, uint32_t material_id_bitcount);
@@ -0,0 +1,191 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "ray_query_service.h"
+#include "libdatacapture/raytrace.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+static_assert(sizeof(rt_datacapture::RayQuery) == sizeof(RenderRayQuery), "CPU and GPU query layouts differ");
+
+struct RaytraceQuerySlots::Slot {
+    std::vector<rt_datacapture::RayQuery> queries;
+    std::vector<float> hit_t;
+    std::vector<glm::vec3> hit_normal;
+    std::future<void> tracing;
+};
+
+RaytraceQuerySlots::RaytraceQuerySlots(rt_datacapture::RaytraceBackend& raytracer, int slot_count, int slot_capacity)
+    : raytracer(raytracer)
+    , capacity(slot_capacity) {
+    if (slot_count < 1 || slot_capacity < 1)
+        throw_error("Ray query slots need a positive slot count and capacity");
+    for (int i = 0; i < slot_count; ++i) {
+        slots.emplace_back(new Slot());
+        slots.back()->queries.resize(slot_capacity);
+        slots.back()->hit_t.resize(slot_capacity);
+        slots.back()->hit_normal.resize(slot_capacity);
+    }
+}
+
+RaytraceQuerySlots::~RaytraceQuerySlots() {
+    for (auto& slot : slots)
+        if (slot->tracing.valid())
+            slot->tracing.wait();
+}
+
+void RaytraceQuerySlots::submit(int slot_idx, RenderRayQuery const* queries, int num_queries) {
+    assert(num_queries <= capacity);
+    Slot& slot = *slots[slot_idx];
+    if (slot.tracing.valid())
+        slot.tracing.wait();
+    std::memcpy((void*) slot.queries.data(), queries, sizeof(RenderRayQuery) * num_queries);
+    // misses are not written by the ray tracer
+    std::fill_n(slot.hit_t.data(), num_queries, -1.0f);
+    std::fill_n(slot.hit_normal.data(), num_queries, glm::vec3(0.0f));
+    slot.tracing = std::async(std::launch::async, [this, &slot, num_queries]() {
+        rt_datacapture::RaytraceResults results;
+        results.hit_t = slot.hit_t.data();
+        results.hit_normal = slot.hit_normal.data();
+        raytracer.trace_ray(slot.queries.data(), num_queries, results);
+    });
+}
+
+bool RaytraceQuerySlots::poll(int slot_idx, bool wait) {
+    Slot& slot = *slots[slot_idx];
+    if (!slot.tracing.valid())
+        return true;
+    if (wait) {
+        slot.tracing.wait();
+        return true;
+    }
+    return slot.tracing.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void RaytraceQuerySlots::read_results(int slot_idx, glm::vec4* results, int num_queries) {
+    Slot& slot = *slots[slot_idx];
+    // rethrows errors of the tracing thread
+    if (slot.tracing.valid())
+        slot.tracing.get();
+    for (int i = 0; i < num_queries; ++i)
+        results[i] = glm::vec4(slot.hit_normal[i], slot.hit_t[i]);
+}
+
+RayQueryService::RayQueryService(std::unique_ptr<RayQuerySlots> slots_)
+    : slots(std::move(slots_)) {
+    if (!slots || slots->slot_count() < 1 || slots->slot_capacity() < 1)
+        throw_error("Ray query service needs at least one non-empty query slot");
+    // free slots are taken from the back, start with slot 0
+    for (int i = slots->slot_count(); i-- > 0; )
+        free_slots.push_back(i);
+}
+
+RayQueryService::~RayQueryService() {
+    // slot memory may still be in use, incomplete jobs report broken promises
+    for (auto& chunk : in_flight)
+        slots->poll(chunk.slot, true);
+}
+
+std::future<void> RayQueryService::trace(RenderRayQuery const* queries, size_t num_queries, glm::vec4* results
+    , std::function<void()> on_complete) {
+    Job* job = new Job();
+    jobs.emplace_back(job);
+    job->queries = queries;
+    job->results = results;
+    job->num_queries = num_queries;
+    job->on_complete = std::move(on_complete);
+    auto future = job->done.get_future();
+    submit_chunks();
+    return future;
+}
+
+int RayQueryService::pump() {
+    submit_chunks();
+    complete_finished_jobs();
+    while (retire_chunk(false)) {
+        submit_chunks();
+        complete_finished_jobs();
+    }
+    return (int) jobs.size();
+}
+
+void RayQueryService::finish() {
+    complete_finished_jobs();
+    while (!jobs.empty()) {
+        submit_chunks();
+        bool retired = retire_chunk(true);
+        assert(retired);
+        (void) retired;
+        complete_finished_jobs();
+    }
+}
+
+void RayQueryService::submit_chunks() {
+    size_t capacity = size_t(slots->slot_capacity());
+    for (auto& job : jobs) {
+        while (job->submitted < job->num_queries) {
+            if (free_slots.empty())
+                return;
+            Chunk chunk;
+            chunk.slot = free_slots.back();
+            chunk.job = job.get();
+            chunk.offset = job->submitted;
+            chunk.count = (int) std::min(job->num_queries - job->submitted, capacity);
+            slots->submit(chunk.slot, job->queries + chunk.offset, chunk.count);
+            free_slots.pop_back();
+            in_flight.push_back(chunk);
+            job->submitted += size_t(chunk.count);
+
+            ++statistics.chunks;
+            statistics.max_chunks_in_flight = std::max(statistics.max_chunks_in_flight, (int) in_flight.size());
+        }
+    }
+}
+
+bool RayQueryService::retire_chunk(bool wait) {
+    if (in_flight.empty())
+        return false;
+    Chunk chunk = in_flight.front();
+    if (!slots->poll(chunk.slot, wait))
+        return false;
+    Job* job = chunk.job;
+    try {
+        slots->read_results(chunk.slot, job->results + chunk.offset, chunk.count);
+    } catch (...) {
+        // fails the job once its chunks in flight are retired, the rest is never submitted
+        if (!job->error)
+            job->error = std::current_exception();
+        job->retired += job->num_queries - job->submitted;
+        job->submitted = job->num_queries;
+    }
+    // the slot is only reused after its results were consumed
+    in_flight.pop_front();
+    free_slots.push_back(chunk.slot);
+    job->retired += size_t(chunk.count);
+    return true;
+}
+
+void RayQueryService::complete_finished_jobs() {
+    // chunks retire in submission order, thus jobs complete in order
+    while (!jobs.empty() && jobs.front()->retired == jobs.front()->num_queries) {
+        std::unique_ptr<Job> job = std::move(jobs.front());
+        jobs.pop_front();
+        if (job->error) {
+            job->done.set_exception(job->error);
+            continue;
+        }
+        ++statistics.jobs;
+        statistics.queries += job->num_queries;
+        try {
+            if (job->on_complete)
+                job->on_complete();
+        } catch (...) {
+            job->done.set_exception(std::current_exception());
+            throw;
+        }
+        job->done.set_value();
+    }
+}
@@ -0,0 +1,114 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "render_params.glsl.h"
+
+namespace rt_datacapture {
+    struct RaytraceBackend;
+}
+
+// A fixed set of query and result buffers that a backend traces asynchronously. Each slot
+// holds up to slot_capacity() queries; slots are submitted, polled and read back independently,
+// such that staging of one slot overlaps with tracing and readback of the others.
+struct RayQuerySlots {
+    virtual ~RayQuerySlots() { }
+    virtual int slot_count() const = 0;
+    virtual int slot_capacity() const = 0;
+
+    // stages the queries into the slot and starts tracing them
+    virtual void submit(int slot, RenderRayQuery const* queries, int num_queries) = 0;
+    // returns true once the results of the last submission are available, optionally blocking
+    virtual bool poll(int slot, bool wait) = 0;
+    // copies the results of the last submission, the layout of the vec4 results is backend-defined
+    virtual void read_results(int slot, glm::vec4* results, int num_queries) = 0;
+};
+
+// Slots that trace with a CPU ray tracer, each submission runs on its own thread.
+// Results are (hit normal, hit distance), the distance is negative on a miss.
+struct RaytraceQuerySlots : RayQuerySlots {
+    RaytraceQuerySlots(rt_datacapture::RaytraceBackend& raytracer, int slot_count, int slot_capacity);
+    ~RaytraceQuerySlots();
+
+    int slot_count() const override { return (int) slots.size(); }
+    int slot_capacity() const override { return capacity; }
+    void submit(int slot, RenderRayQuery const* queries, int num_queries) override;
+    bool poll(int slot, bool wait) override;
+    void read_results(int slot, glm::vec4* results, int num_queries) override;
+
+private:
+    struct Slot;
+    rt_datacapture::RaytraceBackend& raytracer;
+    int capacity;
+    std::vector<std::unique_ptr<Slot>> slots;
+};
+
+// Traces arbitrarily large query arrays through a set of query slots. Jobs are split into chunks
+// of the slot capacity, which are submitted round-robin while older chunks are still in flight,
+// and retired in submission order. Completion is signaled through the returned future and an
+// optional callback, both fire during pump() or finish(). Jobs whose results cannot be read
+// back fail their future with the readback error and skip the callback.
+// Slots of GPU backends submit to device queues, therefore trace(), pump() and finish() must
+// be called from the thread that owns the queue. Waiting on a future without pumping in
+// parallel does not make progress.
+struct RayQueryService {
+    struct Stats {
+        uint64_t jobs = 0;
+        uint64_t queries = 0;
+        uint64_t chunks = 0;
+        int max_chunks_in_flight = 0;
+    };
+
+    explicit RayQueryService(std::unique_ptr<RayQuerySlots> slots);
+    ~RayQueryService();
+
+    // queries and results must stay valid until the job completes, results holds one vec4 per query
+    std::future<void> trace(RenderRayQuery const* queries, size_t num_queries, glm::vec4* results
+        , std::function<void()> on_complete = nullptr);
+    // submits chunks to free slots and retires finished ones without blocking,
+    // returns the number of incomplete jobs
+    int pump();
+    // blocks until all jobs are complete
+    void finish();
+
+    int chunks_in_flight() const { return (int) in_flight.size(); }
+    Stats const& stats() const { return statistics; }
+
+private:
+    struct Job {
+        RenderRayQuery const* queries;
+        glm::vec4* results;
+        size_t num_queries;
+        size_t submitted = 0;
+        size_t retired = 0;
+        std::promise<void> done;
+        std::function<void()> on_complete;
+        std::exception_ptr error; // first failed readback, remaining queries are skipped
+    };
+    struct Chunk {
+        int slot;
+        Job* job;
+        size_t offset;
+        int count;
+    };
+
+    void submit_chunks();
+    bool retire_chunk(bool wait);
+    void complete_finished_jobs();
+
+    std::unique_ptr<RayQuerySlots> slots;
+    std::deque<std::unique_ptr<Job>> jobs;
+    std::deque<Chunk> in_flight;
+    std::vector<int> free_slots;
+    Stats statistics;
+};
@@ -6,6 +6,7 @@
 #include <vector>
 #include "render_params.glsl.h"
 #include "device_backend.h"
+#include "ray_query_service.h"
 #include "../util/display/render_graphic.h"
 
 extern bool running_rendering_profiling;
@@ -37,6 +38,8 @@ struct RenderConfiguration {
     int active_swap_buffer_count = -1;
     bool reset_accumulation = false;
     bool freeze_frame = false;
+    // if >= 0, a reset restarts the sample sequences at this offset instead of continuing them
+    int64_t sample_sequence_offset = -1;
 };
 
 // mask of options that may be applied to a given current configuration
@@ -74,6 +77,8 @@ struct RenderBackend : RenderGraphic {
     unsigned unique_scene_id = 0;
     bool reset_accumulation = false;
     bool freeze_frame = false;
+    // keep rendering with an already-built pipeline while requested pipelines compile
+    bool allow_fallback_pipelines = false;
 
     virtual ~RenderBackend() { }
     virtual std::string name() const = 0;
@@ -100,6 +105,8 @@ struct RenderBackend : RenderGraphic {
 
     virtual void enable_ray_queries(const int max_queries = DEFAULT_RAY_QUERY_BUDGET, const int max_queries_per_pixel = 0) { }
     virtual bool render_ray_queries(int num_queries, const RenderParams &params, int variant_idx = 0, CommandStream* cmd_stream = nullptr) { return false; }
+    // query slots for RayQueryService, traced with the closest-hit ray query program; null if unsupported
+    virtual std::unique_ptr<RayQuerySlots> create_ray_query_slots(int slot_count, int slot_capacity) { return nullptr; }
 
     virtual void enable_aovs() { }
 
@@ -91,6 +91,10 @@ struct RenderBackendOptions {
         RBO_STAGES_CPU_ONLY) \
     declare(int, rebuild_triangle_budget, RBO_rebuild_triangle_budget_DEFAULT, \
         RBO_STAGES_CPU_ONLY) \
+    declare(int, blas_budget_mb, 0, \
+        RBO_STAGES_CPU_ONLY) \
+    declare(bool, bake_opacity_states, false, \
+        RBO_STAGES_CPU_ONLY) \
     \
     declare(bool, enable_taa, false, \
         RBO_STAGES_CPU_ONLY) \
@@ -149,9 +153,18 @@ struct RenderParams {
     int render_upscale_factor GLCPP_DEFAULT(= 1);
     
     float focal_length GLCPP_DEFAULT(= 35.0);
-    int _pad3;
-    int _pad4;
-    int _pad5;
+    // adaptive sampling (adaptive_sampling.glsl), distributes batch_spp samples per pixel by variance
+    int adaptive_sampling GLCPP_DEFAULT(= 0);
+    float adaptive_error_threshold GLCPP_DEFAULT(= 0.01f);
+    int adaptive_min_spp GLCPP_DEFAULT(= 16);
+
+    int adaptive_max_spp GLCPP_DEFAULT(= 64);
+    // path guiding (path_guiding.glsl), trained between frames from the paths of the megakernel integrators
+    int path_guiding GLCPP_DEFAULT(= 0);
+    // probability of sampling the guiding field instead of the BSDF
+    float path_guiding_selection_probability GLCPP_DEFAULT(= 0.5f);
+    // probability of recording a path for training, maintained by the backend to fit the sample buffer
+    float path_guiding_training_probability GLCPP_DEFAULT(= 1.0f);
 };
 
 struct SceneConfig {
@@ -159,6 +172,9 @@ struct SceneConfig {
     GLM(vec3) sun_dir GLCPP_DEFAULT(= GLM(vec3)(0.0f, 1.0f, 0.0f));
     float turbidity GLCPP_DEFAULT(= 3.0f);
     GLM(vec3) albedo GLCPP_DEFAULT(= GLM(vec3)(0.2f));
+    // scale and rotation around the y axis (degrees) of the environment map, if any
+    float environment_intensity GLCPP_DEFAULT(= 1.0f);
+    float environment_rotation GLCPP_DEFAULT(= 0.0f);
 };
 
 // cross-backend data exchange
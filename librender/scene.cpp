@@ -2,8 +2,14 @@
 // SPDX-License-Identifier: MIT
 
 #include "scene.h"
+#include "scene_compaction.h"
+#include "instance_merging.h"
+#include "bvh_quality.h"
+#include "parallel.h"
+#include "skinning.h"
 #include "error_io.h"
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <numeric>
 #include <stdexcept>
@@ -46,6 +52,17 @@ size_t AnimationData::size_in_bytes() const
         * VKR_QUANTIZED_TRANSFORM_SIZE;
 }
 
+uint32_t AnimationData::frame_at_time(double time) const
+{
+    if (!is_animated() || !(animationStep > 0.0f))
+        return 0;
+    double frame = std::floor((time - double(animationStart)) / double(animationStep));
+    frame = std::fmod(frame, double(numFrames));
+    if (frame < 0.0)
+        frame += double(numFrames);
+    return std::min(uint32_t(frame), uint32_t(numFrames - 1));
+}
+
 unsigned Scene::counter_unique_ids = 0;
 
 Scene::Scene(const std::vector<std::string> &fnames, SceneLoaderParams const &scene_params)
@@ -60,6 +77,8 @@ Scene::Scene(const std::vector<std::string> &fnames, SceneLoaderParams const &sc
       const std::string ext = get_file_extension(fname);
       if (ext == ".vkrs" || ext == ".vks") {
           load_vkrs(fname, loader_params);
+      } else if (ext == ".hdr" || ext == ".exr") {
+          load_environment_map(fname);
       } else
           throw_error("Unsupported file type %s in %s", ext.c_str(), fname.c_str());
 
@@ -83,6 +102,13 @@ Scene::Scene(const std::vector<std::string> &fnames, SceneLoaderParams const &sc
         garbage_collect(deduplication_info);
     }
 
+    split_shared_skinned_meshes();
+
+    {
+        ProfilingScope profile_meshlets("Build meshlets");
+        build_meshlets(meshes);
+    }
+
     if (deduplication_info.num_removed_meshes > 0 ||
         deduplication_info.num_removed_lod_groups > 0) {
       println(CLL::INFORMATION, "Duplicate geometry detected! Removed %d meshes and %d LOD groups",
@@ -147,11 +173,12 @@ void Scene::deduplicate(DeduplicationInfo &dedup_info)
 
 void Scene::garbage_collect(DeduplicationInfo &dedup_info)
 {
-    // note: order matters!
-    remove_orphaned_instanced_meshes(dedup_info);
-    remove_orphaned_lods_and_meshes(dedup_info);
-    remove_orphaned_materials(dedup_info);
-    remove_orphaned_textures(dedup_info);
+    SceneCompactionStats stats = compact_scene(*this);
+    dedup_info.num_removed_pmeshes += stats.num_removed_pmeshes;
+    dedup_info.num_removed_meshes += stats.num_removed_meshes;
+    dedup_info.num_removed_lod_groups += stats.num_removed_lod_groups;
+    dedup_info.num_removed_materials += stats.num_removed_materials;
+    dedup_info.num_removed_textures += stats.num_removed_textures;
 }
 
 bool Scene::unlink_duplicate_instanced_meshes(DeduplicationInfo& dedup_info) {
@@ -227,6 +254,35 @@ bool Scene::unlink_duplicate_materials(DeduplicationInfo& dedup_info) {
     return true;
 }
 
+void Scene::split_shared_skinned_meshes() {
+    // each instance of a skinned mesh is deformed into its own dynamic geometry,
+    // instances beyond the first get a copy that shares the mapped vertex data
+    std::vector<bool> mesh_instanced(meshes.size(), false);
+    int num_split = 0;
+    for (Instance &instance : instances) {
+        int pm_id = instance.parameterized_mesh_id;
+        int mesh_id = parameterized_meshes[pm_id].mesh_id;
+        if (!(meshes[mesh_id].flags & Mesh::Skinned))
+            continue;
+        if (!mesh_instanced[mesh_id]) {
+            mesh_instanced[mesh_id] = true;
+            continue;
+        }
+
+        Mesh mesh_copy = meshes[mesh_id];
+        ParameterizedMesh pm_copy = parameterized_meshes[pm_id];
+        pm_copy.mesh_id = ilen(meshes);
+        // deformed copies are not switched by LoD selection
+        pm_copy.lod_group = 0;
+        meshes.push_back(std::move(mesh_copy));
+        instance.parameterized_mesh_id = ilen(parameterized_meshes);
+        parameterized_meshes.push_back(std::move(pm_copy));
+        ++num_split;
+    }
+    if (num_split)
+        println(CLL::VERBOSE, "Split %d shared instances of skinned meshes", num_split);
+}
+
 bool Scene::unlink_pruned_lod_meshes(DeduplicationInfo& dedup_info) {
     bool remapped_meshes = false;
     for (Instance &instance : instances) {
@@ -244,213 +300,6 @@ bool Scene::unlink_pruned_lod_meshes(DeduplicationInfo& dedup_info) {
     return remapped_meshes;
 }
 
-void Scene::remove_orphaned_instanced_meshes(DeduplicationInfo& dedup_info) {
-    int numOriginalMeshes = ilen(parameterized_meshes);
-    int numDedupMeshes = 0;
-
-    // compact paramterized_meshes to contain only unique mesh names
-    std::vector<int> mesh_dedup_index_LUT(numOriginalMeshes, -1);
-    {
-        std::vector<int> mesh_users(numOriginalMeshes);
-        for (Instance &instance : instances) {
-            int pm_id = instance.parameterized_mesh_id;
-            mesh_users[pm_id]++;
-            if (int lod_group_id = parameterized_meshes[pm_id].lod_group) {
-                for (int lod_mesh_id : lod_groups[lod_group_id].mesh_ids)
-                    mesh_users[lod_mesh_id]++;
-            }
-        }
-
-        for (int iMesh = 0; iMesh < numOriginalMeshes; iMesh++) {
-            if (mesh_users[iMesh] > 0) {
-                mesh_dedup_index_LUT[iMesh] = numDedupMeshes;
-                if (numDedupMeshes != iMesh)
-                    parameterized_meshes[numDedupMeshes] = std::move(parameterized_meshes[iMesh]);
-                ++numDedupMeshes;
-            }
-        }
-        parameterized_meshes.resize(numDedupMeshes);
-    }
-    if (numOriginalMeshes == numDedupMeshes)
-        return;
-
-    // update LOD groups
-    for (LodGroup &lod_group : lod_groups) {
-      for (int &lod_mesh_id : lod_group.mesh_ids)
-        lod_mesh_id = mesh_dedup_index_LUT[lod_mesh_id];
-    }
-
-    // update instances
-    for (Instance &instance : instances) {
-        instance.parameterized_mesh_id = mesh_dedup_index_LUT[instance.parameterized_mesh_id];
-    }
-
-    dedup_info.num_removed_pmeshes += numOriginalMeshes - numDedupMeshes;
-}
-
-void Scene::remove_orphaned_lods_and_meshes(DeduplicationInfo& dedup_info) {
-    int numOriginalMeshes = ilen(meshes);
-    int numOriginalLODGroups = ilen(lod_groups);
-
-    int numUsedMeshes = 0;
-    // note: by design the default LOD group 0 must stay intact!
-    int numUsedLODGroups = 1;
-
-    // compact meshes and LOD groups to only contain used items
-    std::vector<int> used_mesh_indices(numOriginalMeshes, -1);
-    std::vector<int> used_lodgroup_indices(numOriginalLODGroups, -1);
-    used_lodgroup_indices[0] = 0;
-    {
-        std::vector<int> mesh_users(numOriginalMeshes);
-        std::vector<int> lodgroup_users(numOriginalLODGroups);
-        for (auto &pmesh : parameterized_meshes) {
-            mesh_users[pmesh.mesh_id]++;
-            lodgroup_users[pmesh.lod_group]++;
-        }
-
-        for (int mesh_id = 0; mesh_id < numOriginalMeshes; mesh_id++) {
-            if (mesh_users[mesh_id] > 0) {
-                used_mesh_indices[mesh_id] = numUsedMeshes;
-                if (numUsedMeshes != mesh_id)
-                    meshes[numUsedMeshes] = std::move(meshes[mesh_id]);
-                numUsedMeshes++;
-            }
-        }
-        meshes.resize(numUsedMeshes);
-
-        for (int lod_group_id = 1; lod_group_id < numOriginalLODGroups; lod_group_id++) {
-            if (lodgroup_users[lod_group_id] > 0) {
-                used_lodgroup_indices[lod_group_id] = numUsedLODGroups;
-                if (numUsedLODGroups != lod_group_id)
-                    lod_groups[numUsedLODGroups] = std::move(lod_groups[lod_group_id]);
-                numUsedLODGroups++;
-            }
-        }
-        lod_groups.resize(numUsedLODGroups);
-    }
-    if (numOriginalMeshes == numUsedMeshes
-     && numOriginalLODGroups == numUsedLODGroups)
-        return;
-
-    // update meshes
-    for (auto &pmesh : parameterized_meshes) {
-        pmesh.mesh_id = used_mesh_indices[pmesh.mesh_id];
-        pmesh.lod_group = used_lodgroup_indices[pmesh.lod_group];
-    }
-
-    dedup_info.num_removed_meshes += numOriginalMeshes - numUsedMeshes;
-    dedup_info.num_removed_lod_groups += numOriginalLODGroups - numUsedLODGroups;
-}
-
-void Scene::remove_orphaned_materials(DeduplicationInfo& dedup_info) {
-    int numOriginalMaterials = ilen(materials);
-    int numUsedMaterials = 0;
-
-    // compact materials to only contain used materials
-    std::vector<int> material_used_indices(numOriginalMaterials, -1);
-    {
-        std::vector<int> material_users(numOriginalMaterials);
-        for (auto &pmesh : parameterized_meshes) {
-            if (pmesh.per_triangle_materials()) {
-                warning("Cannot detect orphaned materials for per-triangle materials, aborting");
-                return;
-            }
-            for (int material_id : pmesh.material_offsets)
-                material_users[material_id]++;
-        }
-
-        for (int material_id = 0; material_id < numOriginalMaterials; material_id++) {
-            if (material_users[material_id] > 0) {
-                material_used_indices[material_id] = numUsedMaterials;
-                if (numUsedMaterials != material_id) {
-                    materials[numUsedMaterials] = std::move(materials[material_id]);
-                    material_names[numUsedMaterials] = std::move(material_names[material_id]);
-                }
-                numUsedMaterials++;
-            }
-        }
-        materials.resize(numUsedMaterials);
-        material_names.resize(numUsedMaterials);
-    }
-    if (numOriginalMaterials == numUsedMaterials)
-        return;
-
-    // update meshes
-    for (auto &pmesh : parameterized_meshes) {
-        for (int& material_id : pmesh.material_offsets)
-            material_id = material_used_indices[material_id];
-    }
-
-    dedup_info.num_removed_materials += numOriginalMaterials - numUsedMaterials;
-}
-
-void Scene::remove_orphaned_textures(DeduplicationInfo& dedup_info) {
-    int numOriginalTextures = ilen(textures);
-    int numUsedTextures = 0;
-
-    // compact textures to only contain used textures
-    std::vector<int> texture_used_indices(numOriginalTextures, -1);
-    {
-        std::vector<int> texture_users(numOriginalTextures);
-        for (auto &material : materials) {
-            if (material.normal_map >= 0)
-                texture_users[material.normal_map]++;
-
-#define FOR_TEXTURED_MATERIAL_PROPERTIES(x) \
-            x(base_color) \
-            x(specular) \
-            x(roughness) \
-            x(metallic) \
-            x(specular_transmission) \
-            x(transmission_color) \
-            x(ior) \
-
-#define TEXTURED_MATERIAL_PROPERTY_INC(property) { \
-                uint32_t tex_id; \
-                memcpy(&tex_id, reinterpret_cast<char*>(&material.property), sizeof(tex_id)); \
-                if (IS_TEXTURED_PARAM(tex_id)) \
-                    texture_users[GET_TEXTURE_ID(tex_id)]++; \
-            }
-            FOR_TEXTURED_MATERIAL_PROPERTIES(TEXTURED_MATERIAL_PROPERTY_INC)
-#undef TEXTURED_MATERIAL_PROPERTY_INC
-        }
-
-        for (int texture_id = 0; texture_id < numOriginalTextures; texture_id++) {
-            if (texture_users[texture_id] > 0) {
-                texture_used_indices[texture_id] = numUsedTextures;
-                if (numUsedTextures != texture_id)
-                    textures[numUsedTextures] = std::move(textures[texture_id]);
-                numUsedTextures++;
-            }
-        }
-        textures.resize(numUsedTextures);
-    }
-    if (numOriginalTextures == numUsedTextures)
-        return;
-
-    // update materials
-    for (auto &material : materials) {
-        if (material.normal_map >= 0)
-            material.normal_map = texture_used_indices[material.normal_map];
-
-#define TEXTURED_MATERIAL_PROPERTY_REMAP(property) { \
-            uint32_t old_tex_id; \
-            memcpy(&old_tex_id, reinterpret_cast<char*>(&material.property), sizeof(old_tex_id)); \
-            if (IS_TEXTURED_PARAM(old_tex_id)) { \
-                uint32_t new_tex_id = TEXTURED_PARAM_MASK; \
-                SET_TEXTURE_ID(new_tex_id, texture_used_indices[GET_TEXTURE_ID(old_tex_id)]); \
-                memcpy(reinterpret_cast<char*>(&material.property), &new_tex_id, sizeof(new_tex_id)); \
-            } \
-        }
-        FOR_TEXTURED_MATERIAL_PROPERTIES(TEXTURED_MATERIAL_PROPERTY_REMAP)
-#undef TEXTURED_MATERIAL_PROPERTY_REMAP
-    }
-
-
-    dedup_info.num_removed_textures += numOriginalTextures - numUsedTextures;
-}
-
-
 void Scene::validate()
 {
     // Bounds checks
@@ -541,6 +390,28 @@ void Scene::validate()
 }
 
 
+void Scene::load_environment_map(const std::string &file)
+{
+    ProfilingScope profile_load("Environment map");
+    HdrImage image = HdrImage::fromFile(file);
+    environment_map = EnvironmentMap(image.width, image.height, image.rgb.data());
+    ++lights_revision;
+    println(CLL::VERBOSE, "Loaded %dx%d environment map %s", image.width, image.height, file.c_str());
+}
+
+// loose image files stand in for .vkt textures that were not converted yet
+static std::string find_loose_texture(char const* texture_dir, char const* material_name, char const* texture_name)
+{
+    if (!texture_dir)
+        return std::string();
+    for (char const* ext : { ".png", ".jpg", ".jpeg", ".tga" }) {
+        std::string file = std::string(texture_dir) + material_name + "_" + texture_name + ext;
+        if (file_exists(file))
+            return file;
+    }
+    return std::string();
+}
+
 void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const* override_params)
 {
     std::cout << "Loading VulkanRenderer scene: " << file << "\n";
@@ -593,12 +464,21 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
     this->parameterized_meshes.resize(uint_bound(meshBase + vkrs.numMeshes));
 
     index_t maxTriCount = 0;
+    int num_unsupported_skinned = 0;
     for (int i = 0; i < (int) vkrs.numMeshes; ++i) {
         Mesh& mesh = this->meshes[meshBase + i];
         VkrMesh const& vkrm = vkrs.meshes[i];
 
         mesh.mesh_name = vkrm.name;
 
+        bool skinned = (vkrm.flags & VKR_MESH_FLAGS_BLEND_ATTRIBUTES)
+            && !(override_params && override_params->ignore_animation);
+#ifndef ENABLE_DYNAMIC_MESHES
+        // nothing deforms skinned meshes, render them in their rest pose
+        num_unsupported_skinned += int(skinned);
+        skinned = false;
+#endif
+
         mesh.geometries.resize(uint_bound(vkrm.numSegments));
         index_t baseTriangle = 0;
         int num_complete_segments = 0;
@@ -635,6 +515,12 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
             geom.uvs = geom.normals;
             geom.format_flags |= Geometry::QuantizedNormalsAndUV;
 
+            if (skinned) {
+                geom.blend_attributes = { file_mapping, static_cast<size_t>(vkrm.blendAttributeBufferOffset)
+                    + sizeof(uint32_t) * 3 * baseTriangle
+                    , sizeof(uint32_t) * 3 * numTriangles };
+            }
+
             if (vkrm.flags & VKR_MESH_FLAGS_INDICES) {
                 geom.indices = { file_mapping, static_cast<size_t>(vkrm.indexBufferOffset)
                     + sizeof(uint32_t) * 3 * baseTriangle
@@ -657,6 +543,8 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
 
         uint32_t dynamic_mesh_flags = (override_params && override_params->small_deformation) ? Mesh::SubtlyDynamic : Mesh::Dynamic;
         bool ignore_animation = override_params && override_params->ignore_animation;
+        if (skinned)
+            mesh.flags |= dynamic_mesh_flags | Mesh::Skinned;
 
         ParameterizedMesh& pmesh = this->parameterized_meshes[meshBase + i];
         pmesh.mesh_name = vkrm.name;
@@ -708,6 +596,30 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
             }
         }
     }
+    if (num_unsupported_skinned > 0)
+        warning("Skinning is not supported in this build (ENABLE_DYNAMIC_MESHES is off), rendering %d skinned meshes of %s in their rest pose"
+            , num_unsupported_skinned, file.c_str());
+
+    if (override_params && override_params->sort_triangles_by_material) {
+        std::atomic<int> num_sorted(0);
+        parallel_for((int) vkrs.numMeshes, [&](int i) {
+            ParameterizedMesh& pmesh = this->parameterized_meshes[meshBase + i];
+            if (sort_triangles_by_material(this->meshes[pmesh.mesh_id], pmesh))
+                ++num_sorted;
+        });
+        println(CLL::VERBOSE, "Sorted triangles of %d meshes by material", num_sorted.load());
+    }
+    if (override_params && override_params->split_triangle_area_ratio > 0.0f) {
+        TriangleSplitParams split_params;
+        split_params.max_area_ratio = override_params->split_triangle_area_ratio;
+        std::atomic<int> num_split(0);
+        parallel_for((int) vkrs.numMeshes, [&](int i) {
+            ParameterizedMesh& pmesh = this->parameterized_meshes[meshBase + i];
+            if (split_oversized_triangles(this->meshes[pmesh.mesh_id], pmesh, split_params))
+                ++num_split;
+        });
+        println(CLL::VERBOSE, "Split oversized triangles of %d meshes", num_split.load());
+    }
 
     this->instances.reserve(uint_bound(instanceBase + vkrs.numInstances));
 
@@ -715,6 +627,8 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
     animationData.numStaticTransforms = vkrs.numStaticTransforms;
     animationData.numAnimatedTransforms = vkrs.numAnimatedTransforms;
     animationData.numFrames = vkrs.numFrames;
+    animationData.animationStart = vkrs.animationStart;
+    animationData.animationStep = vkrs.animationStep;
     if (vkrs.animationData) {
         animationData.quantized = mapped_vector<unsigned char>(
             std::vector<unsigned char>(vkrs.animationData,
@@ -727,6 +641,13 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
             animationData.size_in_bytes()
         };
     }
+    if (vkrs.numBoneIndexTuples > 0 && vkrs.boneIndexTuplesOffset > 0) {
+        animationData.bone_index_tuples = {
+            file_mapping,
+            static_cast<size_t>(vkrs.boneIndexTuplesOffset),
+            sizeof(uint16_t) * SKINNING_MAX_INFLUENCES * vkrs.numBoneIndexTuples
+        };
+    }
 
     const uint32_t animDataIndex = static_cast<uint32_t>(this->animation_data.size());
     animation_data.push_back(animationData);
@@ -755,46 +676,10 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
     }
 
     if (override_params && override_params->merge_partition_instances && vkrs.numInstances) {
-        auto& transform_data = animation_data[animDataIndex];
-        glm::mat4 cursor_transform(-1.0f);
-        int cursor_i = instanceBase, ic = instanceBase;
-        for (int i = instanceBase, ie = ilen(instances); i < ie; ++i) {
-            auto& pmesh = parameterized_meshes[instances[i].parameterized_mesh_id];
-            auto& mesh = meshes[pmesh.mesh_id];
-
-            bool mergeable = pmesh.lod_group == 0 || lod_groups[pmesh.lod_group].mesh_ids.size() <= 1
-                && !pmesh.per_triangle_materials()
-                && pmesh.shader_names.empty()
-                && mesh.mesh_shader_names.empty();
-            if (!mergeable) {
-                cursor_transform[3][3] = -1.0f;
-                if (ic != i)
-                    instances[ic] = instances[i];
-                ++ic;
-                continue;
-            }
-
-            glm::mat4 transform = transform_data.dequantize(instances[i].transform_index, 0);
-            auto& ci_pmesh = parameterized_meshes[instances[cursor_i].parameterized_mesh_id];
-            auto& ci_mesh = meshes[ci_pmesh.mesh_id];
-            bool merge_with_prev = cursor_transform[3][3] > 0.0f
-                && transform == cursor_transform
-                && mesh.flags == ci_mesh.flags;
-            if (!merge_with_prev) {
-                cursor_transform = transform;
-                if (ic != i)
-                    instances[ic] = instances[i];
-                cursor_i = ic++;
-                continue;
-            }
-
-            ci_mesh.geometries.insert(ci_mesh.geometries.end()
-                , mesh.geometries.begin(), mesh.geometries.end());
-            ci_pmesh.material_offsets.insert(ci_pmesh.material_offsets.end()
-                , pmesh.material_offsets.begin(), pmesh.material_offsets.end());
-            ci_pmesh.has_overrides_applied = true;
-        }
-        instances.resize(ic);
+        InstanceMergeStats merge_stats = merge_partition_instances(*this, instanceBase, override_params->merge_transform_epsilon);
+        println(CLL::INFORMATION, "Merged %d of %d partition instances (%d geometries), dropped %d duplicates, %d matched within epsilon",
+                merge_stats.merged_instances, merge_stats.mergeable_instances, merge_stats.merged_geometries,
+                merge_stats.duplicate_instances, merge_stats.approximate_matches);
     }
 
     // apply LOD overrides after loading correct instances
@@ -822,6 +707,10 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
     this->material_names.resize(uint_bound(matBase + vkrs.numMaterials));
     bool ignore_textures = override_params && override_params->ignore_textures;
     bool load_specularity = override_params && override_params->load_specularity;
+    // loose image files are decoded together on worker threads after all materials are set up
+    std::vector<ImageFile> loose_texture_files;
+    std::vector<int> loose_texture_ids;
+    std::vector<int> loose_texture_alpha_materials; // material that needs alpha if the texture has any, or -1
     for (int i = 0; i < (int) vkrs.numMaterials; ++i) {
       int materialId = matBase + i;
       BaseMaterial& material = this->materials[materialId];
@@ -868,6 +757,13 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .bcFormat = bcFormat
         };
       } else {
+        std::string loose_file = ignore_textures ? std::string() : find_loose_texture(vkrs.textureDir, vkrm.name, "BaseColor");
+        if (!loose_file.empty()) {
+          loose_texture_files.push_back({ loose_file, loose_file, ColorSpace::SRGB });
+          loose_texture_ids.push_back(id);
+          // alpha is only known after decoding, see below
+          loose_texture_alpha_materials.push_back(materialId);
+        }
         color_img = Image{ .name = std::string(vkrm.name) + "_DefaultBaseColor"
           , .width = 1
           , .height = 1
@@ -875,7 +771,7 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .img = { Buffer<uint8_t>({ 255, 255, 255, 255 }) }
           , .color_space = ColorSpace::SRGB
         };
-        if (!ignore_textures)
+        if (!ignore_textures && loose_file.empty())
             warning("missing color texture for %s (texture dir %s)",
               vkrm.name, vkrs.textureDir);
       }
@@ -901,6 +797,12 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .bcFormat = 5
         };
       } else {
+        std::string loose_file = ignore_textures ? std::string() : find_loose_texture(vkrs.textureDir, vkrm.name, "Normal");
+        if (!loose_file.empty()) {
+          loose_texture_files.push_back({ loose_file, loose_file, ColorSpace::LINEAR });
+          loose_texture_ids.push_back(id);
+          loose_texture_alpha_materials.push_back(-1);
+        }
         normal_img = Image{ .name = std::string(vkrm.name) + "_DefaultNormal"
           , .width = 1
           , .height = 1
@@ -908,7 +810,7 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .img = { Buffer<uint8_t>({ 127, 127, 127, 255 }) }
           , .color_space = ColorSpace::LINEAR
         };
-        if (!ignore_textures)
+        if (!ignore_textures && loose_file.empty())
             warning(
               "missing normal texture for %s (texture dir %s)", vkrm.name, vkrs.textureDir);
       }
@@ -928,6 +830,12 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .bcFormat = 1
         };
       } else {
+        std::string loose_file = ignore_textures ? std::string() : find_loose_texture(vkrs.textureDir, vkrm.name, "Specular");
+        if (!loose_file.empty()) {
+          loose_texture_files.push_back({ loose_file, loose_file, ColorSpace::LINEAR });
+          loose_texture_ids.push_back(id);
+          loose_texture_alpha_materials.push_back(-1);
+        }
         specular_img = Image{ .name = std::string(vkrm.name) + "_DefaultSpecular"
           , .width = 1
           , .height = 1
@@ -935,7 +843,7 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
           , .img = { Buffer<uint8_t>({ 255, 127, 0, 255 }) }
           , .color_space = ColorSpace::LINEAR
         };
-        if (!ignore_textures)
+        if (!ignore_textures && loose_file.empty())
             warning(
               "missing specular texture for %s (texture dir %s)", vkrm.name, vkrs.textureDir);
       }
@@ -972,6 +880,26 @@ void Scene::load_vkrs(const std::string &file, SceneLoaderParams::PerFile const*
 
     }
 
+    if (!loose_texture_files.empty()) {
+      ProfilingScope profile_textures("Load image files");
+      std::vector<Image> loose_textures = Image::fromFiles(loose_texture_files, true);
+      // decoding expands all files to RGBA8, base color images have alpha if any base level texel is not opaque
+      std::vector<char> has_alpha(loose_textures.size(), 0);
+      parallel_for(ilen(loose_textures), [&](int i) {
+        if (loose_texture_alpha_materials[i] < 0)
+          return;
+        Image const& image = loose_textures[i];
+        uint8_t const* texels = image.img.data();
+        for (size_t t = 0, te = size_t(image.width) * image.height; t < te && !has_alpha[i]; ++t)
+          has_alpha[i] = texels[4 * t + 3] < 255;
+      });
+      for (int i = 0, ie = ilen(loose_textures); i < ie; ++i) {
+        if (has_alpha[i])
+          this->materials[loose_texture_alpha_materials[i]].flags &= ~BASE_MATERIAL_NOALPHA;
+        this->textures[loose_texture_ids[i]] = std::move(loose_textures[i]);
+      }
+    }
+
     vkr_close_scene(&vkrs);
 }
 
@@ -11,6 +11,7 @@
 #include "mesh.h"
 #include "types.h"
 #include "image.h"
+#include "environment_map.h"
 #include "file_mapping.h"
 //#include "phmap.h"
 
@@ -25,9 +26,16 @@ struct AnimationData {
     uint64_t numStaticTransforms = 0;
     uint64_t numAnimatedTransforms = 0;
     uint64_t numFrames = 0;
+    float animationStart = 0.0f;
+    float animationStep = 0.0f;
+    // six transform indices per tuple, referenced by blend attributes of skinned geometry
+    mapped_vector<uint16_t> bone_index_tuples;
 
     size_t size_in_bytes() const;
     glm::mat4 dequantize(uint32_t index, uint32_t frame) const;
+    bool is_animated() const { return numAnimatedTransforms > 0 && numFrames > 1; }
+    // Animation frame that is active at the given time, looping over all frames
+    uint32_t frame_at_time(double time) const;
 };
 
 struct SceneLoaderParams {
@@ -40,7 +48,10 @@ struct SceneLoaderParams {
         bool ignore_animation = false;
         bool ignore_textures = false;
         bool merge_partition_instances = false;
+        float merge_transform_epsilon = 0.0f; // merge instances with near-equal transforms
         bool load_specularity = false;
+        bool sort_triangles_by_material = false; // for coherent shading of per-triangle materials
+        float split_triangle_area_ratio = 0.0f; // split slivers with larger box/triangle area ratios (0 = off)
     };
     std::vector<PerFile> per_file;
 };
@@ -58,6 +69,8 @@ struct Scene {
     std::vector<PointLight> pointLights;
     std::vector<QuadLight> quadLights;
     std::vector<CameraDesc> cameras;
+    // replaces sky and sun when loaded from an .hdr or .exr file in the scene file list
+    EnvironmentMap environment_map;
 
 
     unsigned instances_revision = 0;
@@ -85,6 +98,7 @@ struct Scene {
 
 private:
     void load_vkrs(const std::string &file, SceneLoaderParams::PerFile const* params = nullptr);
+    void load_environment_map(const std::string &file);
 
     struct DeduplicationInfo {
         size_t num_removed_meshes = 0;
@@ -97,11 +111,9 @@ private:
     void garbage_collect(DeduplicationInfo& dedup_info);
     bool unlink_duplicate_instanced_meshes(DeduplicationInfo& dedup_info);
     bool unlink_duplicate_materials(DeduplicationInfo& dedup_info);
-    void remove_orphaned_instanced_meshes(DeduplicationInfo& dedup_info);
-    void remove_orphaned_lods_and_meshes(DeduplicationInfo& dedup_info);
-    void remove_orphaned_materials(DeduplicationInfo& dedup_info);
-    void remove_orphaned_textures(DeduplicationInfo& dedup_info);
     bool unlink_pruned_lod_meshes(DeduplicationInfo& dedup_info);
+    // skinned meshes are deformed per instance, duplicate those shared by several instances
+    void split_shared_skinned_meshes();
 
 
     void validate();
@@ -0,0 +1,201 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "scene_compaction.h"
+#include "parallel.h"
+#include "profiling.h"
+#include "error_io.h"
+#include "types.h"
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// instances and meshes are marked and remapped in chunks of this many items per thread
+const int INSTANCE_CHUNK_SIZE = 16 * 1024;
+const int MESH_CHUNK_SIZE = 256;
+
+struct UsageMarks {
+    std::vector<std::atomic<uint8_t>> used;
+
+    explicit UsageMarks(int count) : used(count) { }
+    void mark(int i) {
+        // most items are marked many times, avoid writing to shared cache lines
+        if (!used[i].load(std::memory_order_relaxed))
+            used[i].store(1, std::memory_order_relaxed);
+    }
+    bool operator[](int i) const { return used[i].load(std::memory_order_relaxed) != 0; }
+};
+
+// Exclusive prefix sum over the marks, -1 for unused items, the first always_used items are kept
+std::vector<int> used_index_remap(UsageMarks const& marks, int &used_count, int always_used = 0) {
+    int count = ilen(marks.used);
+    std::vector<int> remap(count, -1);
+    used_count = 0;
+    for (int i = 0; i < count; ++i)
+        if (i < always_used || marks[i])
+            remap[i] = used_count++;
+    return remap;
+}
+
+// Stable in-place compaction, new indices never exceed old ones
+template <class T>
+void compact_in_place(std::vector<T> &items, std::vector<int> const& remap, int used_count) {
+    for (int i = 0, ie = ilen(remap); i < ie; ++i)
+        if (remap[i] >= 0 && remap[i] != i)
+            items[remap[i]] = std::move(items[i]);
+    items.resize(used_count);
+}
+
+#define FOR_TEXTURED_MATERIAL_PROPERTIES(x) \
+    x(base_color) \
+    x(specular) \
+    x(roughness) \
+    x(metallic) \
+    x(specular_transmission) \
+    x(transmission_color) \
+    x(ior) \
+
+// Calls fn with a pointer to each property that may hold a texture handle in its first 32 bits
+template <class MaterialType, class Fn>
+void for_each_textured_property(MaterialType &material, Fn&& fn) {
+#define TEXTURED_MATERIAL_PROPERTY(property) fn(&material.property);
+    FOR_TEXTURED_MATERIAL_PROPERTIES(TEXTURED_MATERIAL_PROPERTY)
+#undef TEXTURED_MATERIAL_PROPERTY
+}
+
+} // namespace
+
+SceneCompactionStats compact_scene(Scene &scene, int thread_count) {
+    ProfilingScope profile_compaction("Compact scene");
+    SceneCompactionStats stats;
+
+    auto& pmeshes = scene.parameterized_meshes;
+    int pmesh_count = ilen(pmeshes);
+    int mesh_count = ilen(scene.meshes);
+    int lod_group_count = ilen(scene.lod_groups);
+    int material_count = ilen(scene.materials);
+    int texture_count = ilen(scene.textures);
+    int instance_count = ilen(scene.instances);
+
+    // mark parameterized meshes used by instances, including all members of their LoD groups
+    UsageMarks pmesh_marks(pmesh_count);
+    parallel_for(instance_count, [&](int i) {
+        int pm_id = scene.instances[i].parameterized_mesh_id;
+        pmesh_marks.mark(pm_id);
+        if (int lod_group_id = pmeshes[pm_id].lod_group) {
+            for (int lod_mesh_id : scene.lod_groups[lod_group_id].mesh_ids)
+                pmesh_marks.mark(lod_mesh_id);
+        }
+    }, thread_count, INSTANCE_CHUNK_SIZE);
+
+    // mark meshes, LoD groups and materials used by the remaining parameterized meshes
+    UsageMarks mesh_marks(mesh_count);
+    UsageMarks lod_group_marks(lod_group_count);
+    UsageMarks material_marks(material_count);
+    std::atomic<bool> per_triangle_materials(false);
+    parallel_for(pmesh_count, [&](int i) {
+        if (!pmesh_marks[i])
+            return;
+        ParameterizedMesh const& pmesh = pmeshes[i];
+        mesh_marks.mark(pmesh.mesh_id);
+        lod_group_marks.mark(pmesh.lod_group);
+        if (pmesh.per_triangle_materials())
+            per_triangle_materials = true;
+        for (int material_id : pmesh.material_offsets)
+            material_marks.mark(material_id);
+    }, thread_count, MESH_CHUNK_SIZE);
+    if (per_triangle_materials)
+        warning("Cannot detect orphaned materials for per-triangle materials, aborting");
+    bool compact_materials = !per_triangle_materials;
+
+    // mark textures used by the remaining materials
+    UsageMarks texture_marks(texture_count);
+    parallel_for(material_count, [&](int i) {
+        if (compact_materials && !material_marks[i])
+            return;
+        BaseMaterial const& material = scene.materials[i];
+        if (material.normal_map >= 0)
+            texture_marks.mark(material.normal_map);
+        for_each_textured_property(material, [&](auto const* property) {
+            uint32_t tex_id;
+            memcpy(&tex_id, reinterpret_cast<char const*>(property), sizeof(tex_id));
+            if (IS_TEXTURED_PARAM(tex_id))
+                texture_marks.mark(GET_TEXTURE_ID(tex_id));
+        });
+    }, thread_count, MESH_CHUNK_SIZE);
+
+    // new indices
+    int used_pmesh_count, used_mesh_count, used_lod_group_count, used_material_count = material_count, used_texture_count;
+    std::vector<int> pmesh_remap = used_index_remap(pmesh_marks, used_pmesh_count);
+    std::vector<int> mesh_remap = used_index_remap(mesh_marks, used_mesh_count);
+    // note: by design the default LOD group 0 must stay intact!
+    std::vector<int> lod_group_remap = used_index_remap(lod_group_marks, used_lod_group_count, 1);
+    std::vector<int> material_remap;
+    if (compact_materials)
+        material_remap = used_index_remap(material_marks, used_material_count);
+    std::vector<int> texture_remap = used_index_remap(texture_marks, used_texture_count);
+    bool pmeshes_removed = used_pmesh_count != pmesh_count;
+    bool meshes_removed = used_mesh_count != mesh_count || used_lod_group_count != lod_group_count;
+    bool materials_removed = used_material_count != material_count;
+    bool textures_removed = used_texture_count != texture_count;
+
+    // compact in place
+    compact_in_place(pmeshes, pmesh_remap, used_pmesh_count);
+    compact_in_place(scene.meshes, mesh_remap, used_mesh_count);
+    compact_in_place(scene.lod_groups, lod_group_remap, used_lod_group_count);
+    if (compact_materials) {
+        compact_in_place(scene.materials, material_remap, used_material_count);
+        compact_in_place(scene.material_names, material_remap, used_material_count);
+    }
+    compact_in_place(scene.textures, texture_remap, used_texture_count);
+
+    // update references to the new indices
+    if (pmeshes_removed) {
+        parallel_for(instance_count, [&](int i) {
+            Instance &instance = scene.instances[i];
+            instance.parameterized_mesh_id = pmesh_remap[instance.parameterized_mesh_id];
+        }, thread_count, INSTANCE_CHUNK_SIZE);
+        for (LodGroup &lod_group : scene.lod_groups) {
+            for (int &lod_mesh_id : lod_group.mesh_ids)
+                lod_mesh_id = pmesh_remap[lod_mesh_id];
+        }
+    }
+    if (meshes_removed || materials_removed) {
+        parallel_for(used_pmesh_count, [&](int i) {
+            ParameterizedMesh &pmesh = pmeshes[i];
+            if (meshes_removed) {
+                pmesh.mesh_id = mesh_remap[pmesh.mesh_id];
+                pmesh.lod_group = lod_group_remap[pmesh.lod_group];
+            }
+            if (materials_removed) {
+                for (int &material_id : pmesh.material_offsets)
+                    material_id = material_remap[material_id];
+            }
+        }, thread_count, MESH_CHUNK_SIZE);
+    }
+    if (textures_removed) {
+        parallel_for(used_material_count, [&](int i) {
+            BaseMaterial &material = scene.materials[i];
+            if (material.normal_map >= 0)
+                material.normal_map = texture_remap[material.normal_map];
+            for_each_textured_property(material, [&](auto* property) {
+                uint32_t old_tex_id;
+                memcpy(&old_tex_id, reinterpret_cast<char const*>(property), sizeof(old_tex_id));
+                if (IS_TEXTURED_PARAM(old_tex_id)) {
+                    uint32_t new_tex_id = TEXTURED_PARAM_MASK;
+                    SET_TEXTURE_ID(new_tex_id, texture_remap[GET_TEXTURE_ID(old_tex_id)]);
+                    memcpy(reinterpret_cast<char*>(property), &new_tex_id, sizeof(new_tex_id));
+                }
+            });
+        }, thread_count, MESH_CHUNK_SIZE);
+    }
+
+    stats.num_removed_pmeshes = size_t(pmesh_count - used_pmesh_count);
+    stats.num_removed_meshes = size_t(mesh_count - used_mesh_count);
+    stats.num_removed_lod_groups = size_t(lod_group_count - used_lod_group_count);
+    stats.num_removed_materials = size_t(material_count - used_material_count);
+    stats.num_removed_textures = size_t(texture_count - used_texture_count);
+    return stats;
+}
@@ -0,0 +1,23 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstddef>
+#include "scene.h"
+
+struct SceneCompactionStats {
+    size_t num_removed_pmeshes = 0;
+    size_t num_removed_meshes = 0;
+    size_t num_removed_lod_groups = 0;
+    size_t num_removed_materials = 0;
+    size_t num_removed_textures = 0;
+};
+
+// Removes everything that is no longer reachable from the instances, in dependency order:
+// parameterized meshes (keeping all members of used LoD groups), meshes and LoD groups (group 0
+// always stays), materials and textures. Usage is marked in parallel for all stages at once,
+// new indices follow from prefix sums over the marks and all arrays are compacted in place,
+// preserving the order of the remaining items. Materials are kept if any remaining mesh uses
+// per-triangle materials.
+SceneCompactionStats compact_scene(Scene &scene, int thread_count = 0);
@@ -0,0 +1,210 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "skinning.h"
+#include "parallel.h"
+#include "types.h"
+#include "util.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cmath>
+
+namespace glsl {
+    using namespace glm;
+    #include "../rendering/language.hpp"
+    #include "dequantize.glsl"
+    #include "blend_attributes.glsl"
+}
+
+namespace {
+
+int const ENTRY_COUNT = BLEND_ATTRIBUTE_ENTRY_COUNT;
+uint32_t const WEIGHT_VALUE_COUNT = BLEND_ATTRIBUTE_WEIGHT_VALUE_COUNT;
+uint32_t const PERMUTATION_COUNT = BLEND_ATTRIBUTE_PERMUTATION_COUNT;
+
+uint32_t extra_value_offset(int i) {
+    return uint32_t(i + 1) * glsl::blend_attribute_extra_value_count(i) - 1;
+}
+uint32_t weight_value_count(int i) {
+    return (WEIGHT_VALUE_COUNT - ENTRY_COUNT) * glsl::blend_attribute_extra_value_count(i);
+}
+
+// inverse of the Lehmer code in the decoder, see https://doi.org/10.1145/3522607 (algorithm 1)
+void lehmer_to_permutation(uint32_t lehmer, int (&permutation)[ENTRY_COUNT]) {
+    permutation[ENTRY_COUNT - 1] = 0;
+    for (int i = 2; i <= ENTRY_COUNT; ++i) {
+        int remainder = int(lehmer % uint32_t(i));
+        lehmer /= uint32_t(i);
+        permutation[ENTRY_COUNT - i] = remainder;
+        for (int j = ENTRY_COUNT + 1 - i; j < ENTRY_COUNT; ++j)
+            permutation[j] += int(permutation[j] >= remainder);
+    }
+}
+
+} // namespace
+
+BlendAttributes decode_blend_attributes(uint32_t code) {
+    glm::vec3 weights_lo, weights_hi;
+    BlendAttributes attributes;
+    attributes.tuple_index = glsl::decode_blend_attributes(code, weights_lo, weights_hi);
+    for (int i = 0; i < 3; ++i) {
+        attributes.weights[i] = weights_lo[i];
+        attributes.weights[3 + i] = weights_hi[i];
+    }
+    return attributes;
+}
+
+uint32_t encode_blend_attributes(BlendAttributes const& attributes) {
+    if (attributes.tuple_index >= SKINNING_TUPLE_INDEX_COUNT)
+        throw_error("Bone index tuple %u exceeds the range of blend attributes (%u)", attributes.tuple_index, SKINNING_TUPLE_INDEX_COUNT);
+
+    uint32_t quantized[ENTRY_COUNT];
+    uint32_t payload = attributes.tuple_index;
+    float cumulative = 0.0f;
+    for (int i = 0; i < ENTRY_COUNT; ++i) {
+        // mirror the single-precision prefix sums of the exporter
+        cumulative += attributes.weights[i];
+        float prefix = cumulative - attributes.weights[i];
+        double cube_weight = double(ENTRY_COUNT + 1 - i) * attributes.weights[i] + prefix;
+        uint32_t extra_count = glsl::blend_attribute_extra_value_count(i);
+        uint32_t combined = uint32_t(std::floor(double(weight_value_count(i)) * cube_weight + (extra_value_offset(i) + 0.5)));
+        quantized[i] = combined / extra_count;
+        payload = payload * extra_count + (combined - extra_count * quantized[i]);
+    }
+
+    int permutation[ENTRY_COUNT];
+    lehmer_to_permutation(payload % PERMUTATION_COUNT, permutation);
+    uint32_t shuffled[ENTRY_COUNT];
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+        shuffled[permutation[i]] = quantized[i];
+
+    uint32_t code = payload / PERMUTATION_COUNT;
+    for (int k = 0; k < ENTRY_COUNT; ++k)
+        code = code * WEIGHT_VALUE_COUNT + shuffled[k];
+    return code;
+}
+
+int resolve_bone_influences(BlendAttributes const& attributes, AnimationData const& animation
+    , uint32_t (&bones)[SKINNING_MAX_INFLUENCES], float (&weights)[SKINNING_MAX_INFLUENCES]) {
+    if (attributes.is_singleton()) {
+        for (int i = 0; i < SKINNING_MAX_INFLUENCES - 1; ++i) {
+            bones[i] = 0;
+            weights[i] = 0.0f;
+        }
+        bones[SKINNING_MAX_INFLUENCES - 1] = attributes.tuple_index;
+        weights[SKINNING_MAX_INFLUENCES - 1] = 1.0f;
+        return 1;
+    }
+
+    size_t num_tuples = animation.bone_index_tuples.size() / SKINNING_MAX_INFLUENCES;
+    if (attributes.tuple_index >= num_tuples)
+        throw_error("Blend attributes reference bone index tuple %u of %d", attributes.tuple_index, int_cast(num_tuples));
+    uint16_t const* tuple = animation.bone_index_tuples.data() + size_t(attributes.tuple_index) * SKINNING_MAX_INFLUENCES;
+    int count = 0;
+    for (int i = 0; i < SKINNING_MAX_INFLUENCES; ++i) {
+        // indices of zero weights may be padding
+        bool used = attributes.weights[i] > 0.0f;
+        bones[i] = used ? tuple[i] : 0;
+        weights[i] = used ? attributes.weights[i] : 0.0f;
+        count += int(used);
+    }
+    return count;
+}
+
+void SkinningPalette::initialize(Scene const& scene, Instance const& instance) {
+    auto& animation = scene.animation_data[instance.animation_data_index];
+    auto& mesh = scene.meshes[scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id];
+
+    uint32_t begin_bone = ~0u, end_bone = 0;
+    for (auto& geom : mesh.geometries) {
+        for (uint32_t code : geom.blend_attributes) {
+            if (code == UNSKINNED_BLEND_ATTRIBUTES)
+                continue;
+            uint32_t bones[SKINNING_MAX_INFLUENCES];
+            float weights[SKINNING_MAX_INFLUENCES];
+            resolve_bone_influences(decode_blend_attributes(code), animation, bones, weights);
+            for (int i = 0; i < SKINNING_MAX_INFLUENCES; ++i) {
+                if (weights[i] > 0.0f) {
+                    begin_bone = std::min(begin_bone, bones[i]);
+                    end_bone = std::max(end_bone, bones[i] + 1);
+                }
+            }
+        }
+    }
+    if (begin_bone >= end_bone)
+        begin_bone = end_bone = 0;
+    if (end_bone > animation.numStaticTransforms + animation.numAnimatedTransforms)
+        throw_error("Skinned mesh %s references bone transform %u of %d", mesh.mesh_name.c_str()
+            , end_bone - 1, int_cast(animation.numStaticTransforms + animation.numAnimatedTransforms));
+
+    first_bone = begin_bone;
+    bone_transforms.assign(end_bone - begin_bone, glm::mat4(1.0f));
+    frame = ~0u;
+}
+
+bool SkinningPalette::update(AnimationData const& animation, Instance const& instance, uint32_t frame) {
+    if (this->frame == frame)
+        return false;
+    glm::mat4 world_to_instance = glm::inverse(animation.dequantize(instance.transform_index, frame));
+    for (int i = 0, ie = ilen(bone_transforms); i < ie; ++i)
+        bone_transforms[i] = world_to_instance * animation.dequantize(first_bone + uint32_t(i), frame);
+    this->frame = frame;
+    return true;
+}
+
+int skinned_vertex_count(Mesh const& mesh) {
+    int count = 0;
+    for (auto& geom : mesh.geometries)
+        count += geom.num_verts();
+    return count;
+}
+
+void skin_geometry(Geometry const& geom, AnimationData const& animation, SkinningPalette const& palette
+    , glm::vec3* positions, glm::vec3* normals, int thread_count) {
+    int vertex_count = geom.num_verts();
+    bool has_blend_attributes = !geom.blend_attributes.empty();
+    if (has_blend_attributes && int_cast(geom.blend_attributes.size()) != vertex_count)
+        throw_error("Geometry has %d blend attributes for %d vertices", int_cast(geom.blend_attributes.size()), vertex_count);
+    bool quantized_normals = (geom.format_flags & Geometry::QuantizedNormalsAndUV) != 0;
+    bool has_normals = quantized_normals ? geom.normals.count<uint64_t>() >= size_t(vertex_count)
+                                         : geom.normals.count<glm::vec3>() >= size_t(vertex_count);
+
+    int const chunk_size = 4096;
+    parallel_for((vertex_count + chunk_size - 1) / chunk_size, [&](int chunk_idx) {
+        int begin = chunk_idx * chunk_size;
+        int end = std::min(begin + chunk_size, vertex_count);
+        for (int i = begin; i < end; ++i) {
+            if (geom.format_flags & Geometry::QuantizedPositions) {
+                using namespace glm;
+                positions[i] = DEQUANTIZE_POSITION(geom.vertices.as_range<uint64_t>().first[i]
+                    , geom.quantized_scaling, geom.quantized_offset);
+            } else
+                positions[i] = geom.vertices.as_range<glm::vec3>().first[i];
+
+            glm::vec3 n = glm::vec3(0.0f);
+            if (normals && has_normals) {
+                n = quantized_normals ? glsl::dequantize_normal(uint32_t(geom.normals.as_range<uint64_t>().first[i]))
+                                      : geom.normals.as_range<glm::vec3>().first[i];
+            }
+
+            uint32_t code = has_blend_attributes ? geom.blend_attributes.data()[i] : UNSKINNED_BLEND_ATTRIBUTES;
+            if (code != UNSKINNED_BLEND_ATTRIBUTES) {
+                uint32_t bones[SKINNING_MAX_INFLUENCES];
+                float weights[SKINNING_MAX_INFLUENCES];
+                resolve_bone_influences(decode_blend_attributes(code), animation, bones, weights);
+                glm::mat4 skinning(0.0f);
+                for (int j = 0; j < SKINNING_MAX_INFLUENCES; ++j) {
+                    if (weights[j] > 0.0f)
+                        skinning += weights[j] * palette.bone_transforms[bones[j] - palette.first_bone];
+                }
+                positions[i] = glm::vec3(skinning * glm::vec4(positions[i], 1.0f));
+                // bones are expected to scale uniformly
+                n = glm::mat3(skinning) * n;
+                if (n != glm::vec3(0.0f))
+                    n = glm::normalize(n);
+            }
+            if (normals)
+                normals[i] = n;
+        }
+    }, thread_count);
+}
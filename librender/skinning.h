@@ -0,0 +1,57 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "scene.h"
+
+// Blend attributes of skinned .vks meshes pack the bone weights and an index into the
+// table of bone index tuples (AnimationData::bone_index_tuples) into 32 bits per vertex,
+// see blend_attributes.glsl for the decoder shared with the GPU. Weights are sorted
+// ascending and sum to one. If only the last weight is non-zero, the tuple index is
+// the transform index of the single influencing bone.
+int const SKINNING_MAX_INFLUENCES = 6;
+uint32_t const SKINNING_TUPLE_INDEX_COUNT = 127 * 120 / 8; // all tuple indices must be below this
+// vertices of rigid geometries in skinned meshes keep their pre-skinning positions
+uint32_t const UNSKINNED_BLEND_ATTRIBUTES = ~0u;
+
+struct BlendAttributes {
+    float weights[SKINNING_MAX_INFLUENCES];
+    uint32_t tuple_index;
+
+    bool is_singleton() const { return weights[SKINNING_MAX_INFLUENCES - 2] == 0.0f; }
+};
+
+BlendAttributes decode_blend_attributes(uint32_t code);
+// throws if the tuple index is out of range, weights must be sorted and normalized
+uint32_t encode_blend_attributes(BlendAttributes const& attributes);
+
+// Transform indices and weights of the bones influencing a vertex, returns the number
+// of non-zero weights. Influences are filled in from the back (largest weight last).
+int resolve_bone_influences(BlendAttributes const& attributes, AnimationData const& animation
+    , uint32_t (&bones)[SKINNING_MAX_INFLUENCES], float (&weights)[SKINNING_MAX_INFLUENCES]);
+
+// Bone transforms for one skinned instance. Transforms map pre-skinning space to the
+// instance space of the current frame, such that the skinned vertices of per-instance
+// dynamic geometry are placed correctly by the regular instance transform.
+struct SkinningPalette {
+    uint32_t first_bone = 0;
+    std::vector<glm::mat4> bone_transforms;
+    uint32_t frame = ~0u;
+
+    // sets up the range of bones referenced by the instanced mesh
+    void initialize(Scene const& scene, Instance const& instance);
+    // returns false if the palette was already up to date for the given frame
+    bool update(AnimationData const& animation, Instance const& instance, uint32_t frame);
+};
+
+// Number of vertices that are deformed when skinning the mesh
+int skinned_vertex_count(Mesh const& mesh);
+
+// Multithreaded CPU reference of the GPU skinning pass: writes num_verts() deformed
+// positions and (optionally) normals of the geometry in instance space.
+void skin_geometry(Geometry const& geom, AnimationData const& animation, SkinningPalette const& palette
+    , glm::vec3* positions, glm::vec3* normals = nullptr, int thread_count = 0);
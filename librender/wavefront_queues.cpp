@@ -0,0 +1,108 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "wavefront_queues.h"
+#include "error_io.h"
+#include <algorithm>
+
+void WavefrontMaterialSort::reset() {
+    std::fill_n(bins, WAVEFRONT_SORT_BINS, 0u);
+}
+
+void WavefrontMaterialSort::count(WavefrontQueue<WavefrontHit> const& hits) {
+    hits.dispatch([this](uint32_t, WavefrontHit const& hit) {
+        ++bins[glsl::wavefront_sort_bin(hit.material_id)];
+    });
+}
+
+void WavefrontMaterialSort::scan() {
+    uint32_t offset = 0;
+    for (auto& bin : bins) {
+        uint32_t count = bin;
+        bin = offset;
+        offset += count;
+    }
+}
+
+void WavefrontMaterialSort::scatter(WavefrontQueue<WavefrontHit> const& hits, std::vector<uint32_t>& sorted_paths) {
+    assert(sorted_paths.size() >= hits.size());
+    hits.dispatch([&](uint32_t, WavefrontHit const& hit) {
+        sorted_paths[bins[glsl::wavefront_sort_bin(hit.material_id)]++] = hit.path;
+    });
+}
+
+WavefrontScheduler::WavefrontScheduler(int path_capacity)
+    : ray_queues{ WavefrontQueue<uint32_t>(path_capacity), WavefrontQueue<uint32_t>(path_capacity) }
+    , hit_queue(path_capacity)
+    , shadow_queue(path_capacity)
+    , sorted_paths(path_capacity) {
+}
+
+void WavefrontScheduler::run(uint32_t path_count, int max_path_depth, WavefrontKernels& kernels) {
+    if (path_count > sorted_paths.size())
+        throw_error("Wave of %u paths exceeds the queue capacity of %d", path_count, int(sorted_paths.size()));
+    for (auto& queue : ray_queues)
+        queue.reset();
+    hit_queue.reset();
+    shadow_queue.reset();
+    material_sort.reset();
+    stats = Stats();
+
+    kernels.begin_stage(WAVEFRONT_STAGE_GENERATE, 0, path_count);
+    for (uint32_t path = 0; path < path_count; ++path) {
+        kernels.generate(path);
+        ray_queues[0].append(path);
+    }
+
+    int bounce = 0;
+    for (; bounce < max_path_depth; ++bounce) {
+        auto& rays = ray_queues[bounce % 2];
+        auto& next_rays = ray_queues[(bounce + 1) % 2];
+        if (rays.size() == 0)
+            break;
+
+        kernels.begin_stage(WAVEFRONT_STAGE_EXTEND, bounce, rays.size());
+        rays.dispatch([&](uint32_t, uint32_t path) {
+            int material_id = kernels.extend(path, bounce);
+            if (material_id >= 0)
+                hit_queue.append({ uint32_t(material_id), path });
+        });
+        stats.extended += rays.size();
+
+        kernels.begin_stage(WAVEFRONT_STAGE_SORT_COUNT, bounce, hit_queue.size());
+        material_sort.count(hit_queue);
+        kernels.begin_stage(WAVEFRONT_STAGE_SORT_SCAN, bounce, WAVEFRONT_SORT_BINS);
+        material_sort.scan();
+        kernels.begin_stage(WAVEFRONT_STAGE_SORT_SCATTER, bounce, hit_queue.size());
+        material_sort.scatter(hit_queue, sorted_paths);
+
+        // shading threads map to the sorted hits
+        kernels.begin_stage(WAVEFRONT_STAGE_SHADE, bounce, hit_queue.size());
+        hit_queue.dispatch([&](uint32_t index, WavefrontHit const&) {
+            uint32_t path = sorted_paths[index];
+            bool shadow_ray = false;
+            if (kernels.shade(path, bounce, shadow_ray))
+                next_rays.append(path);
+            if (shadow_ray)
+                shadow_queue.append(path);
+        });
+        stats.shaded += hit_queue.size();
+
+        kernels.begin_stage(WAVEFRONT_STAGE_SHADOW, bounce, shadow_queue.size());
+        shadow_queue.dispatch([&](uint32_t, uint32_t path) {
+            kernels.shadow(path, bounce);
+        });
+        stats.shadow_rays += shadow_queue.size();
+
+        // consumed queues are reset for the next bounce
+        rays.reset();
+        hit_queue.reset();
+        shadow_queue.reset();
+        material_sort.reset();
+    }
+    stats.bounces = bounce;
+
+    kernels.begin_stage(WAVEFRONT_STAGE_RESOLVE, bounce, path_count);
+    for (uint32_t path = 0; path < path_count; ++path)
+        kernels.resolve(path);
+}
@@ -0,0 +1,63 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef WAVEFRONT_QUEUES_H_GLSL
+#define WAVEFRONT_QUEUES_H_GLSL
+
+// Queue layout and material binning of the wavefront path tracer, shared by
+// vulkan/pt_wavefront.glsl and the CPU reference in wavefront_queues.h.
+#define WAVEFRONT_WORKGROUP_SIZE 128
+#define WAVEFRONT_SORT_BINS 256
+// paths in flight per wave, larger frames are traced in multiple waves
+#define WAVEFRONT_MAX_PATHS (1 << 20)
+// upper bound of the size of WavefrontPath in pt_wavefront.glsl
+#define WAVEFRONT_PATH_STATE_BYTES 256
+
+// one module per stage, in the order of a bounce
+#define WAVEFRONT_STAGE_GENERATE 0
+#define WAVEFRONT_STAGE_EXTEND 1
+#define WAVEFRONT_STAGE_SORT_COUNT 2
+#define WAVEFRONT_STAGE_SORT_SCAN 3
+#define WAVEFRONT_STAGE_SORT_SCATTER 4
+#define WAVEFRONT_STAGE_SHADE 5
+#define WAVEFRONT_STAGE_SHADOW 6
+#define WAVEFRONT_STAGE_RESOLVE 7
+#define WAVEFRONT_STAGE_COUNT 8
+
+// Item count of a queue, followed by the indirect dispatch size that consumes it.
+// Appends open new workgroups as they cross workgroup boundaries, such that the
+// dispatch size is maintained without a separate pass.
+struct WavefrontQueueCounter {
+    uint32_t count;
+    uint32_t groups_x;
+    uint32_t groups_y;
+    uint32_t groups_z;
+};
+
+// extend queues of the current and the next bounce alternate
+#define WAVEFRONT_QUEUE_RAYS 0
+#define WAVEFRONT_QUEUE_HITS 2
+#define WAVEFRONT_QUEUE_SHADOW_RAYS 3
+#define WAVEFRONT_QUEUE_COUNT 4
+
+struct WavefrontQueueHeader {
+    WavefrontQueueCounter queues[WAVEFRONT_QUEUE_COUNT];
+    // material histogram, turned into exclusive offsets by the scan stage
+    uint32_t sort_bins[WAVEFRONT_SORT_BINS];
+};
+
+inline uint32_t wavefront_queue_groups(uint32_t count) {
+    return (count + uint32_t(WAVEFRONT_WORKGROUP_SIZE - 1)) / uint32_t(WAVEFRONT_WORKGROUP_SIZE);
+}
+
+// workgroups opened by appending count items at the given queue offset
+inline uint32_t wavefront_append_groups(uint32_t offset, uint32_t count) {
+    return wavefront_queue_groups(offset + count) - wavefront_queue_groups(offset);
+}
+
+// shading is coherent per bin, materials beyond the bin count share bins
+inline uint32_t wavefront_sort_bin(uint32_t material_id) {
+    return material_id % uint32_t(WAVEFRONT_SORT_BINS);
+}
+
+#endif
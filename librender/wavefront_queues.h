@@ -0,0 +1,145 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace glsl {
+    #include "wavefront_queues.glsl"
+}
+
+// CPU reference of the queues and the material sort of the wavefront path tracer
+// (vulkan/pt_wavefront.glsl), which replicates the GPU stage order such that queue
+// compaction and shading order can be tested without a GPU.
+
+// Append-only queue with the counter layout of the GPU queues
+template <class T>
+struct WavefrontQueue {
+    glsl::WavefrontQueueCounter counter;
+    std::vector<T> items;
+
+    explicit WavefrontQueue(int capacity = 0)
+        : items(capacity) {
+        reset();
+    }
+    void reset() {
+        counter = { 0, 0, 1, 1 };
+    }
+    // stores the item in the next free slot, returns the slot
+    uint32_t append(T const& item) {
+        uint32_t index = counter.count++;
+        assert(index < items.size());
+        counter.groups_x += glsl::wavefront_append_groups(index, 1);
+        items[index] = item;
+        return index;
+    }
+    uint32_t size() const { return counter.count; }
+
+    // visits the items like the threads of an indirect dispatch of the queue
+    template <class F>
+    void dispatch(F&& fn) const {
+        for (uint32_t group = 0; group < counter.groups_x; ++group)
+            for (uint32_t local = 0; local < WAVEFRONT_WORKGROUP_SIZE; ++local) {
+                uint32_t index = group * WAVEFRONT_WORKGROUP_SIZE + local;
+                if (index < counter.count)
+                    fn(index, items[index]);
+            }
+    }
+};
+
+struct WavefrontHit {
+    uint32_t material_id;
+    uint32_t path;
+};
+
+// Scalar layout of the largest WavefrontPath configuration in pt_wavefront.glsl (two-word
+// random state, mesh IDs for visualization, texture footprints), which checks its size
+// against the same bound with WAVEFRONT_PATH_BYTES.
+struct WavefrontPathLayout {
+    glm::vec3 ray_origin;
+    float t_min;
+    glm::vec3 ray_dir;
+    float t_max;
+    glm::vec3 throughput;
+    float prev_bounce_pdf;
+    glm::vec3 illum;
+    int bounce;
+    glm::uvec2 random_state;
+    struct {
+        glm::vec3 normal;
+        float dist;
+        glm::vec3 geo_normal;
+        int material_id;
+        glm::vec3 tangent;
+        float bitangent_l;
+        glm::vec2 uv;
+        uint32_t parameterized_mesh_id;
+    } hit;
+    glm::vec3 local_ray_orig;
+    int instance_id;
+    glm::vec3 local_ray_dir;
+    int primitive_id;
+    glm::vec3 motion_vector;
+    float total_t;
+    glm::mat2 texture_footprint;
+    glm::vec3 shadow_origin;
+    float shadow_dist;
+    glm::vec3 shadow_dir;
+    glm::vec3 shadow_illum;
+};
+static_assert(sizeof(WavefrontPathLayout) <= WAVEFRONT_PATH_STATE_BYTES, "Wavefront path state exceeds its buffer stride");
+
+// Counting sort of hits by material bin, in the three passes of the GPU sort stages.
+// Unlike on the GPU, where the scatter uses atomics, the order within bins is stable.
+struct WavefrontMaterialSort {
+    uint32_t bins[WAVEFRONT_SORT_BINS];
+
+    WavefrontMaterialSort() { reset(); }
+    void reset();
+    void count(WavefrontQueue<WavefrontHit> const& hits);
+    // turns the histogram into exclusive offsets
+    void scan();
+    // writes the paths of the hits into consecutive per-bin ranges
+    void scatter(WavefrontQueue<WavefrontHit> const& hits, std::vector<uint32_t>& sorted_paths);
+};
+
+// The stages of a path, called by the scheduler for each queued path
+struct WavefrontKernels {
+    virtual ~WavefrontKernels() { }
+    // called once per dispatch with the number of items the stage consumes
+    virtual void begin_stage(int stage, int bounce, uint32_t items) { }
+    virtual void generate(uint32_t path) { }
+    // returns the material ID of the hit, or a negative value if the ray missed
+    virtual int extend(uint32_t path, int bounce) = 0;
+    // returns true if the path continues, sets shadow_ray to queue an occlusion test
+    virtual bool shade(uint32_t path, int bounce, bool& shadow_ray) = 0;
+    virtual void shadow(uint32_t path, int bounce) { }
+    virtual void resolve(uint32_t path) { }
+};
+
+struct WavefrontScheduler {
+    struct Stats {
+        uint64_t extended = 0;
+        uint64_t shaded = 0;
+        uint64_t shadow_rays = 0;
+        int bounces = 0;
+    };
+
+    WavefrontQueue<uint32_t> ray_queues[2];
+    WavefrontQueue<WavefrontHit> hit_queue;
+    WavefrontQueue<uint32_t> shadow_queue;
+    WavefrontMaterialSort material_sort;
+    std::vector<uint32_t> sorted_paths;
+    Stats stats;
+
+    explicit WavefrontScheduler(int path_capacity);
+
+    // traces one wave of paths: generate, then extend, sort, shade and shadow per bounce,
+    // then resolve. Unlike the GPU, which dispatches all bounces up to the maximum path
+    // depth with empty indirect dispatches, this stops as soon as no path continues.
+    void run(uint32_t path_count, int max_path_depth, WavefrontKernels& kernels);
+};
@@ -63,6 +63,21 @@ int main(int argc, const char **argv)
     println(CLL::INFORMATION, "DG2 features are disabled");
 #endif
 
+    // the coordinator of distributed rendering only launches workers and merges their outputs
+    if (shell.cmdline_args.distributed_workers > 0 && !shell.cmdline_args.distributed_worker.active()) {
+        std::vector<std::string> worker_args = { get_executable_path() };
+        for (size_t i = 1; i < vargs.size(); ++i) {
+            if (vargs[i] == "--distributed")
+                ++i;
+            else
+                worker_args.push_back(vargs[i]);
+        }
+        DistributedCoordinator coordinator;
+        coordinator.worker_count = shell.cmdline_args.distributed_workers;
+        coordinator.staging_dir = shell.cmdline_args.data_capture.img_prefix + ".staging";
+        return coordinator.run(worker_args) ? 0 : -1;
+    }
+
     if (!glfwInit()) {
         char const* error_msg = "unknown";
         glfwGetError(&error_msg);
@@ -86,7 +101,8 @@ int main(int argc, const char **argv)
     // skip default persistent state on validation
     if (shell.cmdline_args.validation_mode
      || shell.cmdline_args.profiling_mode
-     || shell.cmdline_args.data_capture_mode) {
+     || shell.cmdline_args.data_capture_mode
+     || shell.cmdline_args.server_mode) {
         ImState::SetApplicationIniFile(nullptr);
     }
 
@@ -143,6 +159,16 @@ int main(int argc, const char **argv)
             }
         }
 
+        // run camera paths to their end in non-interactive modes
+        if (!shell.cmdline_args.camera_path_file.empty()) {
+            shell.camera_path = load_camera_path(shell.cmdline_args.camera_path_file);
+            println(CLL::INFORMATION, "Loaded camera path %s: %d keys, %.2f s"
+                , shell.cmdline_args.camera_path_file.c_str(), (int) shell.camera_path.keys.size()
+                , shell.camera_path.end_time() - shell.camera_path.start_time());
+            if (shell.cmdline_args.profiling_mode || shell.cmdline_args.data_capture_mode)
+                ImState::ExtendTimeline(shell.camera_path.end_time());
+        }
+
         // make sure there is at least one complete set of frames demarking start and end
         if (shell.cmdline_args.profiling_mode)
             ImState::PadFrames(1);
@@ -165,7 +191,8 @@ int main(int argc, const char **argv)
     // even if provided by config files
     else if (shell.cmdline_args.validation_mode
           || shell.cmdline_args.profiling_mode
-          || shell.cmdline_args.data_capture_mode) {
+          || shell.cmdline_args.data_capture_mode
+          || shell.cmdline_args.server_mode) {
         shell.cmdline_args.fixed_resolution_x = shell.win_width;
         shell.cmdline_args.fixed_resolution_y = shell.win_height;
     }
@@ -17,6 +17,9 @@ struct GpuModuleOption {
 enum GpuProgramFeatures {
     GPU_PROGRAM_FEATURE_MEGAKERNEL = 0x1,
     GPU_PROGRAM_FEATURE_EXTENDED_HIT = 0x2,
+    GPU_PROGRAM_FEATURE_WAVEFRONT = 0x4,
+    GPU_PROGRAM_FEATURE_ADAPTIVE_SAMPLING = 0x8,
+    GPU_PROGRAM_FEATURE_PATH_GUIDING = 0x10,
 };
 struct GpuModuleUnit {
     char const* id;
@@ -10,7 +10,7 @@
 
 vec3 sample_quad_light_position(const QuadLight light, vec2 samples)
 {
-    return samples.x * light.v_x * light.width + samples.y * light.v_y * light.height +
+    return (2.0f * samples.x - 1.0f) * light.v_x * light.width + (2.0f * samples.y - 1.0f) * light.v_y * light.height +
            light.position;
 }
 
@@ -22,7 +22,7 @@ float quad_light_pdf(const QuadLight light,
                      const vec3 orig,
                      const vec3 dir)
 {
-    float surface_area = light.width * light.height;
+    float surface_area = 4.0f * light.width * light.height;
     vec3 to_pt = p - orig;
     float dist_sqr = dot(to_pt, to_pt);
     float n_dot_w = dot(light.normal, -dir);
@@ -56,5 +56,84 @@ bool quad_intersect(const QuadLight light,
     return false;
 }
 
+// Solid angle sampling of spherical rectangles
+// "An Area-Preserving Parametrization for Spherical Rectangles"
+// Carlos Urena, Marcos Fajardo, Alan King, EGSR 2013
+struct SphericalQuad {
+    vec3 o, x, y, z; // local reference system
+    float z0, z0sq;
+    float x0, y0, y0sq; // rectangle coords in local system
+    float x1, y1, y1sq;
+    float b0, b1, k; // misc precomputed constants
+    float S; // solid angle
+};
+
+// s is a corner of the rectangle, ex and ey the (orthogonal) edges leaving it, o the reference point
+inline SphericalQuad init_spherical_quad(vec3 s, vec3 ex, vec3 ey, vec3 o) {
+    SphericalQuad squad;
+    squad.o = o;
+    float exl = length(ex), eyl = length(ey);
+    squad.x = ex / exl;
+    squad.y = ey / eyl;
+    squad.z = cross(squad.x, squad.y);
+    vec3 d = s - o;
+    squad.z0 = dot(d, squad.z);
+    // flip z to make it point away from the rectangle
+    if (squad.z0 > 0.0f) {
+        squad.z *= -1.0f;
+        squad.z0 *= -1.0f;
+    }
+    squad.z0sq = squad.z0 * squad.z0;
+    squad.x0 = dot(d, squad.x);
+    squad.y0 = dot(d, squad.y);
+    squad.x1 = squad.x0 + exl;
+    squad.y1 = squad.y0 + eyl;
+    squad.y0sq = squad.y0 * squad.y0;
+    squad.y1sq = squad.y1 * squad.y1;
+    // vectors to the rectangle vertices in the local system
+    vec3 v00 = vec3(squad.x0, squad.y0, squad.z0);
+    vec3 v01 = vec3(squad.x0, squad.y1, squad.z0);
+    vec3 v10 = vec3(squad.x1, squad.y0, squad.z0);
+    vec3 v11 = vec3(squad.x1, squad.y1, squad.z0);
+    // normals to the planes through o and the rectangle edges
+    vec3 n0 = normalize(cross(v00, v10));
+    vec3 n1 = normalize(cross(v10, v11));
+    vec3 n2 = normalize(cross(v11, v01));
+    vec3 n3 = normalize(cross(v01, v00));
+    // internal angles of the spherical rectangle
+    float g0 = acos(clamp(-dot(n0, n1), -1.0f, 1.0f));
+    float g1 = acos(clamp(-dot(n1, n2), -1.0f, 1.0f));
+    float g2 = acos(clamp(-dot(n2, n3), -1.0f, 1.0f));
+    float g3 = acos(clamp(-dot(n3, n0), -1.0f, 1.0f));
+    squad.b0 = n0.z;
+    squad.b1 = n2.z;
+    squad.k = 2.0f * M_PI - g2 - g3;
+    squad.S = g0 + g1 - squad.k;
+    // rectangles seen edge-on cover no solid angle
+    if (!(squad.S > 0.0f) || !(abs(squad.z0) > 0.0f))
+        squad.S = 0.0f;
+    return squad;
+}
+
+// Maps uniform samples to a point on the rectangle, distributed uniformly in solid angle
+inline vec3 sample_spherical_quad(const SphericalQuad squad, vec2 samples) {
+    // compute cu
+    float au = samples.x * squad.S + squad.k;
+    float fu = (cos(au) * squad.b0 - squad.b1) / sin(au);
+    float cu = 1.0f / sqrt(fu * fu + squad.b0 * squad.b0) * (fu > 0.0f ? 1.0f : -1.0f);
+    cu = clamp(cu, -1.0f, 1.0f); // avoid NaNs
+    // compute xu
+    float xu = -(cu * squad.z0) / max(sqrt(1.0f - cu * cu), 1.e-7f);
+    xu = clamp(xu, squad.x0, squad.x1); // avoid Infs
+    // compute yv
+    float d = sqrt(xu * xu + squad.z0sq);
+    float h0 = squad.y0 / sqrt(d * d + squad.y0sq);
+    float h1 = squad.y1 / sqrt(d * d + squad.y1sq);
+    float hv = h0 + samples.y * (h1 - h0), hv2 = hv * hv;
+    float yv = (hv2 < 1.0f - 1.e-6f) ? (hv * d) / sqrt(1.0f - hv2) : squad.y1;
+    // transform (xu, yv, z0) to world coords
+    return squad.o + xu * squad.x + yv * squad.y + squad.z0 * squad.z;
+}
+
 #endif
 
@@ -0,0 +1,94 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef QUAD_LIGHT_SAMPLING_GLSL
+#define QUAD_LIGHT_SAMPLING_GLSL
+
+#include "../defaults.glsl"
+#include "../lights/tri.glsl"
+#include "../lights/quad.glsl"
+#include "../util.glsl"
+
+// Quad lights share the emitter buffer with tri lights and are stored as
+// TriLightData, where v0 is a corner of the quad and v1, v2 are the corners
+// adjacent along the quad edges. The quad emits towards cross(v1 - v0, v2 - v0).
+// #define SCENE_GET_QUAD_LIGHT_SOURCE(light_id)
+// #define SCENE_GET_QUAD_LIGHT_SOURCE_COUNT()
+
+inline bool is_quad_facing_forward(const TriLight light, const vec3 p) {
+    return dot(p - light.v0, cross(light.v1 - light.v0, light.v2 - light.v0)) > 0.0f;
+}
+
+inline SphericalQuad spherical_quad_light(const TriLight light, const vec3 p) {
+    return init_spherical_quad(light.v0, light.v1 - light.v0, light.v2 - light.v0, p);
+}
+
+inline vec3 sample_quad_lights(const vec3 hit_p, const vec3 hit_n
+    , vec2 dir_sample, vec2 sel_sample
+    , GLSL_out(vec3) light_dir, GLSL_out(float) light_dist
+    , GLSL_out(float) pdf)
+{
+    int num_lights = SCENE_GET_QUAD_LIGHT_SOURCE_COUNT();
+
+#if defined(BINNED_LIGHTS_BIN_MAX_SIZE) && BINNED_LIGHTS_BIN_MAX_SIZE > 1
+    int num_bins = (num_lights + BINNED_LIGHTS_BIN_SIZE - 1) / BINNED_LIGHTS_BIN_SIZE;
+    sel_sample.x *= float(num_bins);
+    int bin_id = int(uint(sel_sample.x));
+    bin_id = min(bin_id, num_bins - 1);
+    float sel_p = 1.0f / float(num_bins);
+
+    // importance sample by the solid angle each quad subtends
+    float light_contributions[BINNED_LIGHTS_BIN_MAX_SIZE];
+    float total_contrib = 0.0f;
+    const float MIN_IRRADIANCE = 6.2e-4f * 0.001f; // avoid divisions by zero
+
+    int bin_end = min(BINNED_LIGHTS_BIN_SIZE * (bin_id+1), num_lights);
+    UNROLL_FOR (int i = 0; i < BINNED_LIGHTS_BIN_MAX_SIZE; ++i) {
+        int light_id = BINNED_LIGHTS_BIN_SIZE * bin_id + i;
+        if (!(light_id < bin_end)) break;
+        TriLight light = SCENE_GET_QUAD_LIGHT_SOURCE(light_id);
+        vec3 v3 = light.v1 + light.v2 - light.v0;
+        float contrib = 0.0f;
+        if ((dot(light.v0 - hit_p, hit_n) > 0.0f || dot(light.v1 - hit_p, hit_n) > 0.0f
+          || dot(light.v2 - hit_p, hit_n) > 0.0f || dot(v3 - hit_p, hit_n) > 0.0f)
+          && is_quad_facing_forward(light, hit_p))
+            contrib = luminance(light.radiance) * spherical_quad_light(light, hit_p).S;
+        contrib += MIN_IRRADIANCE;
+        light_contributions[i] = contrib;
+        total_contrib += contrib;
+    }
+
+    float p = 0.0f;
+    float t = 0.0f;
+    int light_id;
+    UNROLL_FOR (int i = 0; i < BINNED_LIGHTS_BIN_MAX_SIZE; ++i) {
+        light_id = BINNED_LIGHTS_BIN_SIZE * bin_id + i;
+        if (!(light_id < bin_end)) break;
+        p = light_contributions[i] / total_contrib;
+        t += p;
+        if (sel_sample.y < t)
+            break;
+    }
+    sel_p *= p;
+#else
+    int light_id = int(uint(sel_sample.x * num_lights));
+    light_id = min(light_id, num_lights - 1);
+    float sel_p = 1.0f / float(num_lights);
+#endif
+    TriLight light = SCENE_GET_QUAD_LIGHT_SOURCE(light_id);
+
+    SphericalQuad squad = spherical_quad_light(light, hit_p);
+    if (!(squad.S > 0.0f) || !is_quad_facing_forward(light, hit_p)) {
+        pdf = 0.0f;
+        return vec3(0.0f);
+    }
+    vec3 light_pos = sample_spherical_quad(squad, dir_sample);
+    light_dir = light_pos - hit_p;
+    light_dist = length(light_dir);
+    light_dir /= light_dist;
+
+    pdf = sel_p / squad.S;
+    return light.radiance / pdf;
+}
+
+#endif
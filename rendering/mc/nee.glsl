@@ -16,6 +16,7 @@
 #include "lights_sun.glsl"
 #ifndef DISABLE_AREA_LIGHT_SAMPLING
 #include "lights_linear.glsl"
+#include "lights_quad.glsl"
 #endif
 #include "../bsdfs/hit_point.glsl"
 #include "../util.glsl"
@@ -37,6 +38,7 @@ inline vec3 sample_direct_light(const MATERIAL_TYPE mat, GLSL_in(InteractionPoin
     float light_dist = 2.e16f;
     float light_pdf = 0.0f;
     float mis_pdf = aux_info.mis_pdf;
+    bool nee_only = false;
 
     // sun light
 #ifndef DISABLE_AREA_LIGHT_SAMPLING
@@ -44,6 +46,14 @@ inline vec3 sample_direct_light(const MATERIAL_TYPE mat, GLSL_in(InteractionPoin
         sel_sample.x /= scene_params.sun_radiance.w;
 #else
     {
+#endif
+#ifdef ENABLE_ENVIRONMENT_MAP
+        if (scene_params.environment_map != 0) {
+            light_dir = environment_map_sample(dir_sample, light_pdf);
+            illum += light_pdf > 0.0f
+                ? environment_map_radiance(light_dir) * (vec3(scene_params.sun_radiance) / (light_pdf * scene_params.sun_radiance.w))
+                : vec3(0.0f);
+        } else
 #endif
         illum += sample_sun_light(hit.p, hit.n, scene_params.sun_dir, scene_params.sun_cos_angle, dir_sample, sel_sample, light_dir, light_pdf)
             * (vec3(scene_params.sun_radiance) / scene_params.sun_radiance.w);
@@ -54,18 +64,36 @@ inline vec3 sample_direct_light(const MATERIAL_TYPE mat, GLSL_in(InteractionPoin
         mis_pdf = light_pdf;
     }
 #ifndef DISABLE_AREA_LIGHT_SAMPLING
-    // tri light
     else {
         sel_sample.x = (sel_sample.x - scene_params.sun_radiance.w) / (1.0f - scene_params.sun_radiance.w);
-        
-        float tri_mis_wpdf = 0.0f;
-        illum += sample_tri_lights(hit.p, hit.n, dir_sample, sel_sample, light_dir, light_dist, light_pdf, tri_mis_wpdf)
-            / (1.0f - scene_params.sun_radiance.w);
-        light_pdf *= 1.0f - scene_params.sun_radiance.w;
-
-        // allow overriding MIS pdf
-        if (mis_pdf == 0.0f)
-            mis_pdf = tri_mis_wpdf * (1.0f - scene_params.sun_radiance.w);
+        float quad_p = scene_params.light_sampling.quad_light_probability;
+
+        // quad light
+        if (sel_sample.x < quad_p) {
+            sel_sample.x /= quad_p;
+            float sel_p = (1.0f - scene_params.sun_radiance.w) * quad_p;
+            illum += sample_quad_lights(hit.p, hit.n, dir_sample, sel_sample, light_dir, light_dist, light_pdf)
+                / sel_p;
+            light_pdf *= sel_p;
+
+            // quad lights are not part of the scene geometry, only NEE finds them
+            mis_pdf = light_pdf;
+            nee_only = true;
+        }
+        // tri light
+        else {
+            sel_sample.x = (sel_sample.x - quad_p) / (1.0f - quad_p);
+            float sel_p = (1.0f - scene_params.sun_radiance.w) * (1.0f - quad_p);
+
+            float tri_mis_wpdf = 0.0f;
+            illum += sample_tri_lights(hit.p, hit.n, dir_sample, sel_sample, light_dir, light_dist, light_pdf, tri_mis_wpdf)
+                / sel_p;
+            light_pdf *= sel_p;
+
+            // allow overriding MIS pdf
+            if (mis_pdf == 0.0f)
+                mis_pdf = tri_mis_wpdf * sel_p;
+        }
     }
 #endif
 
@@ -76,7 +104,7 @@ inline vec3 sample_direct_light(const MATERIAL_TYPE mat, GLSL_in(InteractionPoin
         float bsdf_pdf = eval_bsdf_wpdf(mat, hit, w_o, light_dir);
         if (bsdf_pdf >= 0.0f && visibility) {
             vec3 bsdf = eval_bsdf(mat, hit, w_o, light_dir);
-            float w = nee_mis_heuristic(1.f, mis_pdf, 1.f, bsdf_pdf);
+            float w = nee_only ? 1.0f : nee_mis_heuristic(1.f, mis_pdf, 1.f, bsdf_pdf);
             illum *= w * abs(dot(light_dir, hit.n)) * bsdf;
             aux_info.light_dir = light_dir;
             aux_info.light_dist = light_dist;
@@ -44,13 +44,18 @@ inline NEEQueryPoint nee_query_point(const MATERIAL_TYPE mat, GLSL_in(Interactio
 
 #ifdef SUN_LIGHT_GLSL
 inline float eval_direct_sun_light_pdf(NEEQueryPoint query, vec3 w_i) {
+#ifdef ENABLE_ENVIRONMENT_MAP
+    if (scene_params.environment_map != 0)
+        return scene_params.sun_radiance.w * environment_map_pdf(w_i);
+#endif
     return scene_params.sun_radiance.w * eval_sun_light_pdf(query.point, query.normal, w_i, scene_params.sun_dir, scene_params.sun_cos_angle);
 }
 #endif
 
 #ifdef TRI_LIGHTS_GLSL
 inline float wpdf_direct_tri_light(float approx_solid_angle) {
-    return (1.0f - scene_params.sun_radiance.w) * approx_tri_lights_pdf(approx_solid_angle);
+    return (1.0f - scene_params.sun_radiance.w) * (1.0f - scene_params.light_sampling.quad_light_probability)
+        * approx_tri_lights_pdf(approx_solid_angle);
 }
 
 inline float wpdf_direct_light(NEESampledArea light) {
@@ -78,7 +78,41 @@ inline int shade_base_material(GLSL_inout(ShadingSampleState) state
         vec2 bsdfLobeSample = RANDOM_FLOAT2(rng, DIM_LOBE);
         vec2 bsdfDirSample = RANDOM_FLOAT2(rng, DIM_DIRECTION_X);
 
+#ifdef ENABLE_PATH_GUIDING
+        // one-sample MIS of the guiding field and the BSDF, the strategy is selected
+        // by the lobe sample, which is then remapped for reuse by the selected strategy
+        int guiding_cell = -1;
+        float guiding_probability = 0.0f;
+        if ((accumulation_flags & ACCUMULATION_FLAGS_PATH_GUIDING) != 0 && state.output_channel == 0
+         && mat.roughness >= PATH_GUIDING_MIN_ROUGHNESS) {
+            guiding_cell = path_guiding_lookup_cell(interaction.p);
+            guiding_probability = render_params.path_guiding_selection_probability;
+        }
+        aux.guided_vertex = guiding_cell >= 0;
+        bool sample_guided = aux.guided_vertex && bsdfLobeSample.x < guiding_probability;
+        if (aux.guided_vertex)
+            bsdfLobeSample.x = sample_guided ? bsdfLobeSample.x / guiding_probability
+                : (bsdfLobeSample.x - guiding_probability) / (1.0f - guiding_probability);
+
+        vec3 bsdf;
+        if (sample_guided) {
+            w_i = path_guiding_sample(guiding_cell, bsdfLobeSample.x, bsdfDirSample);
+            bsdf = eval_bsdf(mat, interaction, w_o, w_i) * abs(dot(w_i, interaction.n));
+            aux.mis_pdf = eval_bsdf_wpdf(mat, interaction, w_o, w_i);
+        }
+        else
+            bsdf = sample_bsdf(mat, interaction, w_o, w_i, aux.sampling_pdf, aux.mis_pdf, bsdfDirSample, bsdfLobeSample, rng);
+        if (aux.guided_vertex && bsdf != vec3(0.0f)) {
+            // balance heuristic over the guiding density and the MIS density of the BSDF;
+            // the latter also weights emitter hits against NEE, which remains consistent
+            aux.sampling_pdf = guiding_probability * path_guiding_pdf(guiding_cell, w_i)
+                + (1.0f - guiding_probability) * aux.mis_pdf;
+            float weight = sample_guided ? 1.0f : aux.mis_pdf;
+            bsdf *= aux.sampling_pdf > 0.0f ? weight / aux.sampling_pdf : 0.0f;
+        }
+#else
         vec3 bsdf = sample_bsdf(mat, interaction, w_o, w_i, aux.sampling_pdf, aux.mis_pdf, bsdfDirSample, bsdfLobeSample, rng);
+#endif
         RANDOM_SHIFT_DIM(rng, DIM_VERTEX_END);
         // Must increment bounce before returning an error or alpha will be
         // accumulated incorrectly.
@@ -24,6 +24,10 @@ ShadingSampleState init_shading_sample_state() {
 struct ShadingQueryAux {
     float sampling_pdf;
     float mis_pdf;
+#ifdef ENABLE_PATH_GUIDING
+    // direction sampled from the mixture of guiding field and BSDF, of density sampling_pdf
+    bool guided_vertex;
+#endif
 };
 
 inline int perform_shading(GLSL_inout(ShadingSampleState) state
@@ -4,6 +4,9 @@
 #ifndef BN_DATA_GLSL
 #define BN_DATA_GLSL
 
+// Tables are loaded at run time from bn_tables.bin, which has to match this layout.
+// Regenerate with rendering/tools/prepare_bn.cpp (ENABLE_RENDERING_TOOLS).
+
 #define BNData_SampleCount 256
 #define BNData_Dimensions 256
 #define BNData_ScramblingDimensions 8
@@ -43,6 +43,11 @@ struct MotionVectorBuffer { uint16_t* m_components; };
 #define MOTION_VECTOR_BUFFER_TYPE MotionVectorBuffer
 #endif
 
+#ifndef OPACITY_STATE_BUFFER_TYPE
+struct OpacityStateBuffer { uint32_t* packed; };
+#define OPACITY_STATE_BUFFER_TYPE OpacityStateBuffer
+#endif
+
 #ifndef VERTEX_BUFFER_TYPE
 #ifdef QUANTIZED_POSITIONS
 #define VERTEX_BUFFER_TYPE QUANTIZED_VERTEX_BUFFER_TYPE
@@ -68,6 +73,7 @@ struct MotionVectorBuffer { uint16_t* m_components; };
 #define GEOMETRY_FLAGS_EXTENDED_SHADER 0x04
 #define GEOMETRY_FLAGS_THIN 0x08
 #define GEOMETRY_FLAGS_DYNAMIC 0x10
+#define GEOMETRY_FLAGS_OPACITY_STATES 0x20
 
 struct RenderMeshParams {
     INDEX_BUFFER_TYPE indices GLCPP_DEFAULT(= { });
@@ -88,6 +94,8 @@ struct RenderMeshParams {
     MOTION_VECTOR_BUFFER_TYPE motion_vectors GLCPP_DEFAULT(= { });
     int paramerterized_mesh_id;      // consistent across LoDs (lead mesh)
     int paramerterized_mesh_data_id; // precise, different across LoDs
+
+    OPACITY_STATE_BUFFER_TYPE opacity_states GLCPP_DEFAULT(= { }); // only if GEOMETRY_FLAGS_OPACITY_STATES
 };
 
 struct InstancedGeometry {
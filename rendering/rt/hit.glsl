@@ -55,6 +55,15 @@ inline int calc_hit_material_id(int material_id_in, MATERIAL_ID_BUFFER_TYPE mate
         return material_id_in;
 }
 
+#ifdef OPACITY_STATE_BUFFER_TYPE
+#include "../../librender/opacity_states.glsl"
+
+// baked state of the triangle, see GEOMETRY_FLAGS_OPACITY_STATES
+inline uint32_t calc_hit_opacity_state(OPACITY_STATE_BUFFER_TYPE opacity_states, uint primitive_id) {
+    return unpack_opacity_state(opacity_states.packed[primitive_id / OPACITY_STATES_PER_WORD], primitive_id);
+}
+#endif
+
 inline RTHit calc_hit_attributes(float ray_t, uint primitive_id, vec2 attrib,
     mat3 verts, uvec3 idx,
     mat3 normals_to_world, // transpose(gl_WorldToObjectEXT)
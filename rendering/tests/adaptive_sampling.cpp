@@ -0,0 +1,180 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "adaptive_sampling.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void test_merge() {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> value(0.0f, 4.0f);
+    glsl::AdaptivePixelStats stats = { 0.0f, 0.0f, 0.0f, 0.0f };
+    double sum = 0.0, sum_sq = 0.0;
+    int count = 0;
+    for (int frame = 0; frame < 50; ++frame) {
+        uint32_t spp = rng() % 9;
+        double frame_sum = 0.0, frame_sum_sq = 0.0;
+        for (uint32_t i = 0; i < spp; ++i) {
+            double v = value(rng);
+            frame_sum += v;
+            frame_sum_sq += v * v;
+        }
+        float frame_mean = spp ? float(frame_sum / spp) : 0.0f;
+        float frame_second_moment = spp ? float(frame_sum_sq / spp) : 0.0f;
+        stats = glsl::adaptive_merge_frame(stats, frame_mean, frame_second_moment, spp);
+        sum += frame_sum;
+        sum_sq += frame_sum_sq;
+        count += int(spp);
+        CHECK(stats.spp == float(spp));
+    }
+    CHECK(stats.count == float(count));
+    CHECK(std::abs(stats.mean - sum / count) < 1.e-4);
+    CHECK(std::abs(stats.second_moment - sum_sq / count) < 1.e-3);
+}
+
+// Gray image with per-pixel relative noise of nonnegative samples, a third of the pixels without noise
+struct NoisyImage {
+    int width, height;
+    std::vector<float> value;
+    std::vector<float> deviation;
+
+    NoisyImage(int width, int height)
+        : width(width), height(height), value(width * height), deviation(width * height) {
+        float const deviations[3] = { 0.0f, 0.2f, 2.0f };
+        for (int i = 0; i < width * height; ++i) {
+            value[i] = 0.1f + float(i % 7);
+            deviation[i] = deviations[(i / 5) % 3];
+        }
+    }
+    AdaptiveSampler::SampleFunction sampler(std::mt19937& rng) const {
+        return [this, &rng](int x, int y, uint32_t, float (&rgb)[3]) {
+            int i = y * width + x;
+            float v = value[i];
+            if (deviation[i] > 0.0f) {
+                float shape = 1.0f / (deviation[i] * deviation[i]);
+                v = std::gamma_distribution<float>(shape, v / shape)(rng);
+            }
+            rgb[0] = rgb[1] = rgb[2] = v;
+        };
+    }
+    double relative_mse(AdaptiveSampler const& sampler) const {
+        double error = 0.0;
+        for (int i = 0; i < width * height; ++i) {
+            double d = (sampler.color[3 * i] - value[i]) / value[i];
+            error += d * d;
+        }
+        return error / (width * height);
+    }
+};
+
+static void test_budget() {
+    NoisyImage image(64, 64);
+    AdaptiveSamplingConfig config;
+    config.error_threshold = 0.0f;
+    config.min_spp = 8;
+    config.max_spp = 1024;
+    config.batch_spp = 4;
+    AdaptiveSampler sampler(image.width, image.height, config);
+    std::mt19937 rng(11);
+    auto sample = image.sampler(rng);
+
+    bool uniform_start = true, conserved = true, noiseless_skipped = true;
+    for (int frame = 0; frame < 12; ++frame) {
+        uint64_t samples_before = sampler.total_samples;
+        sampler.render_frame(sample);
+        uint64_t frame_samples = sampler.total_samples - samples_before;
+        uint64_t budget = uint64_t(config.batch_spp) * image.width * image.height;
+        if (frame < 2)
+            uniform_start &= frame_samples == budget;
+        // importance sums lag one frame behind and settle as the deviation estimates improve
+        if (frame >= 6)
+            conserved &= std::abs(double(frame_samples) - double(budget)) < 0.05 * double(budget);
+        if (frame >= 2)
+            for (int i = 0; i < image.width * image.height; ++i)
+                noiseless_skipped &= image.deviation[i] != 0.0f || sampler.stats[i].spp == 0.0f;
+    }
+    CHECK(uniform_start);
+    CHECK(conserved);
+    CHECK(noiseless_skipped);
+
+    // samples proportional to the relative deviation
+    double spp[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < image.width * image.height; ++i)
+        spp[(i / 5) % 3] += sampler.stats[i].count;
+    double ratio = (spp[2] - spp[0]) / (spp[1] - spp[0]);
+    CHECK(ratio > 7.0 && ratio < 13.0);
+}
+
+static void test_convergence() {
+    NoisyImage image(32, 32);
+    AdaptiveSamplingConfig config;
+    config.error_threshold = 0.05f;
+    config.min_spp = 8;
+    config.max_spp = 64;
+    config.batch_spp = 8;
+    AdaptiveSampler sampler(image.width, image.height, config);
+    std::mt19937 rng(5);
+    auto sample = image.sampler(rng);
+
+    for (int frame = 0; frame < 20; ++frame)
+        sampler.render_frame(sample);
+    CHECK(sampler.retired_pixels() > 0);
+
+    // retired pixels keep their color and sample counts
+    std::vector<glsl::AdaptivePixelStats> stats = sampler.stats;
+    std::vector<float> color = sampler.color;
+    sampler.render_frame(sample);
+    bool retired_fixed = true, retired_accurate = true;
+    for (int i = 0; i < image.width * image.height; ++i) {
+        if (!glsl::adaptive_converged(stats[i], config.error_threshold, config.min_spp))
+            continue;
+        retired_fixed &= stats[i].spp == 0.0f && sampler.stats[i].count == stats[i].count
+            && sampler.color[3 * i] == color[3 * i];
+        retired_accurate &= glsl::adaptive_relative_error(stats[i]) < config.error_threshold;
+    }
+    CHECK(retired_fixed);
+    CHECK(retired_accurate);
+}
+
+// equal sample counts: the error of adaptive sampling is lower than that of uniform sampling
+static void test_equal_samples() {
+    NoisyImage image(64, 64);
+    AdaptiveSamplingConfig config;
+    config.error_threshold = 0.0f;
+    config.min_spp = 8;
+    config.max_spp = 1024;
+    config.batch_spp = 4;
+
+    AdaptiveSamplingConfig uniform_config = config;
+    // convergence criteria that never select pixels for adaptive sampling
+    uniform_config.min_spp = 1 << 20;
+    AdaptiveSampler uniform(image.width, image.height, uniform_config);
+    AdaptiveSampler adaptive(image.width, image.height, config);
+
+    std::mt19937 uniform_rng(1), adaptive_rng(2);
+    auto uniform_sample = image.sampler(uniform_rng);
+    auto adaptive_sample = image.sampler(adaptive_rng);
+    for (int frame = 0; frame < 32; ++frame)
+        uniform.render_frame(uniform_sample);
+    while (adaptive.total_samples < uniform.total_samples)
+        adaptive.render_frame(adaptive_sample);
+    CHECK(adaptive.total_samples < uniform.total_samples * 21 / 20);
+
+    double uniform_error = image.relative_mse(uniform);
+    double adaptive_error = image.relative_mse(adaptive);
+    printf("relative MSE at %.1f spp: uniform %g, adaptive %g\n"
+        , double(uniform.total_samples) / (image.width * image.height), uniform_error, adaptive_error);
+    // uniform: mean squared deviation, adaptive: squared mean deviation
+    CHECK(adaptive_error < 0.6 * uniform_error);
+}
+
+int main() {
+    test_merge();
+    test_budget();
+    test_convergence();
+    test_equal_samples();
+    return test_result();
+}
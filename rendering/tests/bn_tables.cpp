@@ -0,0 +1,111 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "bn_tables.h"
+#include "parallel.h"
+#include "test_util.h"
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+static char const* const test_file = "test_bn_tables.bin";
+
+static BNTables make_test_tables() {
+    BNTables tables;
+    tables.sample_count = 16;
+    tables.dimensions = 4;
+    tables.tile_size = 8;
+    tables.scrambling_dimensions = 2;
+    for (int i = 0; i < tables.sequence_entry_count(); ++i)
+        tables.sequence_spp_d.push_back(uint32_t(i * 37 % 256));
+    for (int spp : { 1, 16 }) {
+        BNTables::Tile tile;
+        tile.spp = spp;
+        for (int i = 0; i < tables.tile_entry_count(); ++i) {
+            // exercise the wider value encodings in scrambling keys
+            tile.scrambling_yx_d.push_back(spp == 1 ? uint32_t(i * 13 % 256) : uint32_t(i * 70001));
+            tile.ranking_yx_d.push_back(uint32_t(i / 2 % spp));
+        }
+        tables.tiles.push_back(tile);
+    }
+    return tables;
+}
+
+static void test_round_trip() {
+    BNTables tables = make_test_tables();
+    write_bn_tables(test_file, tables);
+    BNTables loaded = read_bn_tables(test_file);
+    CHECK(loaded.sample_count == tables.sample_count);
+    CHECK(loaded.dimensions == tables.dimensions);
+    CHECK(loaded.tile_size == tables.tile_size);
+    CHECK(loaded.scrambling_dimensions == tables.scrambling_dimensions);
+    CHECK(loaded.sequence_spp_d == tables.sequence_spp_d);
+    CHECK(loaded.tiles.size() == tables.tiles.size());
+    for (auto& tile : tables.tiles) {
+        auto* loaded_tile = loaded.find_tile(tile.spp);
+        CHECK(loaded_tile != nullptr);
+        if (loaded_tile) {
+            CHECK(loaded_tile->scrambling_yx_d == tile.scrambling_yx_d);
+            CHECK(loaded_tile->ranking_yx_d == tile.ranking_yx_d);
+        }
+    }
+    CHECK(loaded.find_tile(4) == nullptr);
+}
+
+static void test_invalid_tables() {
+    BNTables tables = make_test_tables();
+    tables.tiles[1].ranking_yx_d[3] = 16;
+    CHECK(throws([&]() { tables.validate(); }));
+    tables = make_test_tables();
+    tables.tile_size = 6;
+    CHECK(throws([&]() { tables.validate(); }));
+    tables = make_test_tables();
+    tables.sequence_spp_d.pop_back();
+    CHECK(throws([&]() { write_bn_tables(test_file, tables); }));
+
+    // corrupted and truncated files are rejected
+    write_bn_tables(test_file, make_test_tables());
+    std::vector<unsigned char> data;
+    if (FILE* f = fopen(test_file, "rb")) {
+        for (int c; (c = fgetc(f)) != EOF; )
+            data.push_back((unsigned char) c);
+        fclose(f);
+    }
+    CHECK(data.size() > 64);
+    auto write_data = [](std::vector<unsigned char> const& bytes) {
+        if (FILE* f = fopen(test_file, "wb")) {
+            fwrite(bytes.data(), 1, bytes.size(), f);
+            fclose(f);
+        }
+    };
+    std::vector<unsigned char> corrupted = data;
+    corrupted[data.size() / 2] ^= 0x10;
+    write_data(corrupted);
+    CHECK(throws([]() { read_bn_tables(test_file); }));
+    write_data(std::vector<unsigned char>(data.begin(), data.begin() + data.size() - 1));
+    CHECK(throws([]() { read_bn_tables(test_file); }));
+    std::remove(test_file);
+    CHECK(throws([]() { read_bn_tables(test_file); }));
+}
+
+static void test_parallel_for() {
+    std::vector<std::atomic<int>> visits(1000);
+    parallel_for(int(visits.size()), [&](int i) { ++visits[i]; }, 4, 7);
+    int wrong = 0;
+    for (auto& v : visits)
+        wrong += int(v != 1);
+    CHECK(wrong == 0);
+
+    CHECK(throws([]() {
+        parallel_for(100, [](int i) { if (i == 42) throw std::runtime_error("expected"); }, 4);
+    }));
+}
+
+int main() {
+    printf("Testing blue-noise tables\n");
+    test_round_trip();
+    test_invalid_tables();
+    test_parallel_for();
+    return test_result();
+}
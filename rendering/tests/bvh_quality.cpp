@@ -0,0 +1,378 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "bvh_quality.h"
+#include "mesh.h"
+#include "quantize.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+static bool close(double a, double b, double eps = 1e-4) {
+    return std::abs(a - b) <= eps * std::max(1.0, std::max(std::abs(a), std::abs(b)));
+}
+
+static Box unit_box(float x) {
+    return Box(glm::vec3(x, 0.0f, 0.0f), glm::vec3(x + 1.0f, 1.0f, 1.0f));
+}
+
+static void test_sah() {
+    BvhQuality single = estimate_bvh_quality({ unit_box(0.0f) });
+    CHECK(single.primitive_count == 1);
+    CHECK(single.leaf_count == 1 && single.inner_node_count == 0);
+    CHECK(close(single.sah_cost, 1.0));
+
+    SahCostParams params;
+    params.max_leaf_size = 1;
+    BvhQuality pair = estimate_bvh_quality({ unit_box(0.0f), Box(), unit_box(9.0f) }, params);
+    CHECK(pair.primitive_count == 2); // empty boxes are skipped
+    CHECK(pair.leaf_count == 2 && pair.inner_node_count == 1 && pair.max_depth == 1);
+    double leaf_area = unit_box(0.0f).surface_area() / (unit_box(0.0f) + unit_box(9.0f)).surface_area();
+    CHECK(close(pair.sah_cost, 1.0 + 2.0 * leaf_area));
+    CHECK(close(pair.leaf_area, 2.0 * leaf_area));
+
+    // per-primitive costs weigh the leaves
+    std::vector<float> costs = { 3.0f, 0.0f, 5.0f };
+    BvhQuality weighted = estimate_bvh_quality({ unit_box(0.0f), Box(), unit_box(9.0f) }, params, &costs);
+    CHECK(close(weighted.sah_cost, 1.0 + 8.0 * leaf_area));
+
+    // coincident boxes cannot be separated, disjoint ones can
+    std::vector<Box> stacked(8, unit_box(0.0f)), row;
+    for (int i = 0; i < 8; ++i)
+        row.push_back(unit_box(2.0f * float(i)));
+    BvhQuality overlapping = estimate_bvh_quality(stacked, params);
+    BvhQuality disjoint = estimate_bvh_quality(row, params);
+    CHECK(overlapping.leaf_count == 8 && disjoint.leaf_count == 8);
+    CHECK(close(overlapping.leaf_area, 8.0));
+    CHECK(disjoint.leaf_area < 2.0);
+    CHECK(disjoint.sah_cost < overlapping.sah_cost);
+    CHECK(estimate_bvh_quality({ }).sah_cost == 0.0);
+}
+
+static void test_tlas() {
+    std::vector<Box> stacked(4, Box(glm::vec3(0.0f), glm::vec3(10.0f))), spread;
+    for (int i = 0; i < 4; ++i)
+        spread.push_back(Box(glm::vec3(20.0f * float(i), 0.0f, 0.0f), glm::vec3(20.0f * float(i) + 10.0f, 10.0f, 10.0f)));
+    std::vector<double> blas_costs(4, 10.0);
+    BvhQuality overlapping = estimate_tlas_quality(stacked, blas_costs);
+    BvhQuality disjoint = estimate_tlas_quality(spread, blas_costs);
+    CHECK(overlapping.leaf_count == 4);
+    CHECK(close(overlapping.leaf_area, 4.0));
+    CHECK(disjoint.leaf_area < overlapping.leaf_area);
+    CHECK(disjoint.sah_cost < overlapping.sah_cost);
+    // every leaf of overlapping instances is hit, each pays its transform and BLAS
+    CHECK(overlapping.sah_cost > 4.0 * 11.0);
+}
+
+static void test_heuristic() {
+    TriangleSplitParams params;
+    float diagonal = 20.0f;
+    // axis-aligned right triangle: box area 4x triangle area, no split
+    CHECK(!triangle_needs_split(glm::vec3(0.0f), glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(0.0f, 10.0f, 0.0f), diagonal, params));
+    // diagonal sliver
+    glm::vec3 a(0.0f), b(10.0f, 10.0f, 0.0f), c(9.9f, 10.1f, 0.0f);
+    CHECK(triangle_needs_split(a, b, c, diagonal, params));
+    // same shape but negligible relative to the mesh
+    CHECK(!triangle_needs_split(0.001f * a, 0.001f * b, 0.001f * c, diagonal, params));
+    // degenerate
+    CHECK(!triangle_needs_split(a, b, 0.5f * b, diagonal, params));
+}
+
+// Diagonal strip of two long sliver triangles, as in e.g. rotated architectural trims
+static std::vector<glm::vec3> strip_positions() {
+    return { glm::vec3(0.0f), glm::vec3(10.0f, 10.0f, 0.0f), glm::vec3(9.9f, 10.1f, 0.0f), glm::vec3(-0.1f, 0.1f, 0.0f) };
+}
+static std::vector<glm::uvec3> strip_triangles() {
+    return { glm::uvec3(0, 1, 2), glm::uvec3(0, 2, 3) };
+}
+
+static float triangle_area(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c) {
+    return 0.5f * glm::length(glm::cross(b - a, c - a));
+}
+
+static void test_split_triangles() {
+    auto positions = strip_positions();
+    auto triangles = strip_triangles();
+    float diagonal = glm::length(glm::vec3(10.1f, 10.1f, 0.0f));
+    TriangleSplitParams params;
+    params.min_relative_extent = 0.1f;
+    params.max_growth = 256.0f;
+    TriangleSplit split = split_triangles(positions.data(), uint32_t(positions.size()), triangles.data(), uint32_t(triangles.size()), diagonal, params);
+    CHECK(split.split_edges > 0);
+    CHECK(split.midpoint_parents.size() == size_t(split.split_edges));
+    CHECK(split.corner_barycentrics.size() == 3 * split.triangles.size());
+    CHECK(split.source_triangles.size() == split.triangles.size());
+    CHECK(std::is_sorted(split.source_triangles.begin(), split.source_triangles.end()));
+
+    std::vector<glm::vec3> points = positions;
+    for (glm::uvec2 parents : split.midpoint_parents)
+        points.push_back(0.5f * (points[parents.x] + points[parents.y]));
+
+    // no triangle needs splitting any more, and the pieces cover the input exactly
+    std::vector<Box> before, after;
+    double area_before = 0.0, area_after = 0.0;
+    for (auto const& t : triangles) {
+        Box box(points[t.x], points[t.x]);
+        box += points[t.y];
+        box += points[t.z];
+        before.push_back(box);
+        area_before += triangle_area(points[t.x], points[t.y], points[t.z]);
+    }
+    bool none_needs_split = true, same_winding = true, barycentrics_match = true;
+    std::map<std::pair<uint32_t, uint32_t>, int> edge_counts;
+    for (size_t j = 0; j < split.triangles.size(); ++j) {
+        glm::uvec3 t = split.triangles[j];
+        glm::uvec3 s = triangles[split.source_triangles[j]];
+        none_needs_split &= !triangle_needs_split(points[t.x], points[t.y], points[t.z], diagonal, params);
+        glm::vec3 normal = glm::cross(points[t.y] - points[t.x], points[t.z] - points[t.x]);
+        glm::vec3 source_normal = glm::cross(positions[s.y] - positions[s.x], positions[s.z] - positions[s.x]);
+        same_winding &= glm::dot(normal, source_normal) > 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 b = split.corner_barycentrics[3 * j + k];
+            glm::vec3 p = b.x * positions[s.x] + b.y * positions[s.y] + b.z * positions[s.z];
+            barycentrics_match &= glm::length(p - points[t[k]]) < 1e-4f;
+            uint32_t v0 = t[k], v1 = t[(k + 1) % 3];
+            ++edge_counts[std::make_pair(std::min(v0, v1), std::max(v0, v1))];
+        }
+        Box box(points[t.x], points[t.x]);
+        box += points[t.y];
+        box += points[t.z];
+        after.push_back(box);
+        area_after += triangle_area(points[t.x], points[t.y], points[t.z]);
+    }
+    CHECK(none_needs_split);
+    CHECK(same_winding);
+    CHECK(barycentrics_match);
+    CHECK(close(area_before, area_after));
+
+    // watertight: edges are shared by two triangles, except along the unchanged outline
+    bool manifold = true;
+    double boundary_length = 0.0;
+    for (auto const& edge : edge_counts) {
+        manifold &= edge.second <= 2;
+        if (edge.second == 1)
+            boundary_length += glm::length(points[edge.first.first] - points[edge.first.second]);
+    }
+    double outline = 2.0 * glm::length(positions[1] - positions[0]) + 2.0 * glm::length(positions[2] - positions[1]);
+    CHECK(manifold);
+    CHECK(close(boundary_length, outline));
+
+    double box_area_before = 0.0, box_area_after = 0.0;
+    for (auto const& box : before)
+        box_area_before += box.surface_area();
+    for (auto const& box : after)
+        box_area_after += box.surface_area();
+    CHECK(box_area_after < 0.5 * box_area_before);
+
+    // slivers across a finely tessellated floor overlap most of its triangles, a few of the
+    // added triangles already take them out of most leaves
+    std::vector<glm::vec3> scene;
+    std::vector<glm::uvec3> scene_tris;
+    int const n = 32;
+    for (int y = 0; y <= n; ++y)
+        for (int x = 0; x <= n; ++x)
+            scene.push_back(glm::vec3(10.0f * float(x) / n, 10.0f * float(y) / n, 0.0f));
+    for (uint32_t y = 0; y < n; ++y)
+        for (uint32_t x = 0; x < n; ++x) {
+            uint32_t i = y * (n + 1) + x;
+            scene_tris.push_back(glm::uvec3(i, i + 1, i + n + 2));
+            scene_tris.push_back(glm::uvec3(i, i + n + 2, i + n + 1));
+        }
+    for (int i = 0; i < 4; ++i) {
+        uint32_t base = uint32_t(scene.size());
+        for (auto const& p : positions)
+            scene.push_back(p + float(i) * glm::vec3(2.0f, -2.0f, 0.0f));
+        for (auto const& t : triangles)
+            scene_tris.push_back(t + glm::uvec3(base));
+    }
+    TriangleSplitParams scene_params;
+    scene_params.max_growth = 0.1f;
+    TriangleSplit scene_split = split_triangles(scene.data(), uint32_t(scene.size()), scene_tris.data(), uint32_t(scene_tris.size()), 16.0f, scene_params);
+    for (glm::uvec2 parents : scene_split.midpoint_parents)
+        scene.push_back(0.5f * (scene[parents.x] + scene[parents.y]));
+    auto triangle_boxes = [&scene](std::vector<glm::uvec3> const& tris) {
+        std::vector<Box> boxes;
+        for (auto const& t : tris) {
+            Box box(scene[t.x], scene[t.x]);
+            box += scene[t.y];
+            box += scene[t.z];
+            boxes.push_back(box);
+        }
+        return boxes;
+    };
+    BvhQuality scene_before = estimate_bvh_quality(triangle_boxes(scene_tris));
+    BvhQuality scene_after = estimate_bvh_quality(triangle_boxes(scene_split.triangles));
+    CHECK(scene_after.primitive_count > scene_before.primitive_count);
+    CHECK(scene_after.primitive_count <= scene_before.primitive_count + scene_before.primitive_count / 10);
+    CHECK(scene_after.sah_cost < 0.8 * scene_before.sah_cost);
+    CHECK(scene_after.leaf_area < scene_before.leaf_area);
+
+    // growth budget
+    params.max_growth = 1.0f;
+    TriangleSplit limited = split_triangles(positions.data(), uint32_t(positions.size()), triangles.data(), uint32_t(triangles.size()), diagonal, params);
+    CHECK(limited.split_edges > 0);
+    CHECK(limited.triangles.size() <= 2 * triangles.size());
+    params.max_growth = 0.0f;
+    CHECK(split_triangles(positions.data(), uint32_t(positions.size()), triangles.data(), uint32_t(triangles.size()), diagonal, params).split_edges == 0);
+}
+
+// linear in the positions, within the period of quantized uvs
+static glm::vec2 planar_uv(glm::vec3 const& p) {
+    return glm::vec2(0.05f * p.x + 0.25f, 0.05f * p.y + 0.25f);
+}
+
+static void test_split_mesh() {
+    auto positions = strip_positions();
+    auto triangles = strip_triangles();
+    TriangleSplitParams params;
+    params.min_relative_extent = 0.2f;
+    params.max_growth = 64.0f;
+
+    // unrolled geometry with per-triangle materials
+    {
+        std::vector<glm::vec3> unrolled;
+        for (auto const& t : triangles)
+            for (int k = 0; k < 3; ++k)
+                unrolled.push_back(positions[t[k]]);
+        Geometry geom;
+        geom.format_flags = Geometry::NoIndices;
+        geom.vertices = mapped_vector<void>(GenericBuffer(std::move(unrolled)));
+        Mesh mesh({ geom });
+        ParameterizedMesh pm;
+        pm.mesh_id = 0;
+        pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint8_t>{ 3, 7 }));
+        pm.material_id_bitcount = 8;
+
+        CHECK(split_oversized_triangles(mesh, pm, params));
+        int tri_count = int(mesh.num_tris());
+        CHECK(tri_count > 2 && tri_count <= 2 + 64 * 2);
+        CHECK(pm.num_triangle_material_ids() == mesh.num_tris());
+        CHECK(mesh.geometries[0].format_flags == Geometry::NoIndices);
+        bool ids_match = true;
+        double area = 0.0;
+        for (int i = 0; i < tri_count; ++i) {
+            glm::vec3 a, b, c;
+            mesh.geometries[0].tri_positions(i, a, b, c);
+            area += triangle_area(a, b, c);
+            // pieces of the first triangle lie on its side of the diagonal 0-2
+            float side = glm::cross(positions[2] - positions[0], (a + b + c) / 3.0f - positions[0]).z;
+            ids_match &= pm.triangle_material_id(index_t(i)) == (side < 0.0f ? 3 : 7);
+        }
+        CHECK(ids_match);
+        CHECK(close(area, triangle_area(positions[0], positions[1], positions[2]) + triangle_area(positions[0], positions[2], positions[3])));
+        CHECK(mesh.model_revision == 1 && pm.materials_revision == 1);
+    }
+
+    // indexed geometry with linear attributes, which interpolation reproduces exactly
+    {
+        std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.0f, 0.0f, 1.0f));
+        std::vector<glm::vec2> uvs;
+        for (auto const& p : positions)
+            uvs.push_back(planar_uv(p));
+        Geometry geom;
+        geom.vertices = mapped_vector<void>(GenericBuffer(std::vector<glm::vec3>(positions)));
+        geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals)));
+        geom.uvs = mapped_vector<void>(GenericBuffer(std::move(uvs)));
+        geom.indices = mapped_vector<glm::uvec3>(std::vector<glm::uvec3>(triangles));
+        Mesh mesh({ geom });
+        ParameterizedMesh pm;
+        pm.mesh_id = 0;
+
+        CHECK(split_oversized_triangles(mesh, pm, params));
+        Geometry const& split = mesh.geometries[0];
+        CHECK(split.num_tris() > 2);
+        CHECK(split.num_verts() > 4);
+        bool corners_kept = true;
+        for (int i = 0; i < 4; ++i)
+            corners_kept &= split.vertices.as_range<glm::vec3>().first[i] == positions[i];
+        CHECK(corners_kept);
+        bool uvs_match = true, normals_match = true;
+        for (int i = 0; i < split.num_tris(); ++i) {
+            glm::vec3 p[3], n[3];
+            glm::vec2 t[3];
+            split.tri_positions(i, p[0], p[1], p[2]);
+            split.tri_normals(i, n[0], n[1], n[2]);
+            split.tri_uvs(i, t[0], t[1], t[2]);
+            for (int k = 0; k < 3; ++k) {
+                uvs_match &= glm::length(t[k] - planar_uv(p[k])) < 1e-4f;
+                normals_match &= glm::length(n[k] - glm::vec3(0.0f, 0.0f, 1.0f)) < 1e-4f;
+            }
+        }
+        CHECK(uvs_match);
+        CHECK(normals_match);
+
+        // nothing left to split
+        CHECK(!split_oversized_triangles(mesh, pm, params));
+    }
+
+    // quantized and unrolled, as loaded from .vks files
+    {
+        glm::vec3 base(-0.1f, 0.0f, -1.0f), extent(10.1f, 10.1f, 2.0f);
+        std::vector<uint64_t> quantized, normal_uvs;
+        for (auto const& t : triangles)
+            for (int k = 0; k < 3; ++k) {
+                glm::vec3 p = positions[t[k]];
+                quantized.push_back(quantize_position(p, extent, base));
+                normal_uvs.push_back(quantize_normal(glm::vec3(0.0f, 0.0f, 1.0f)) | (uint64_t(quantize_uv(planar_uv(p), glm::vec3(0.0f))) << 32));
+            }
+        Geometry geom;
+        geom.format_flags = Geometry::NoIndices | Geometry::QuantizedPositions | Geometry::QuantizedNormalsAndUV;
+        geom.base = base;
+        geom.extent = extent;
+        geom.quantized_scaling = dequantization_scaling(extent);
+        geom.quantized_offset = dequantization_offset(base, extent);
+        geom.vertices = mapped_vector<void>(GenericBuffer(std::move(quantized)));
+        geom.normals = mapped_vector<void>(GenericBuffer(std::move(normal_uvs)));
+        geom.uvs = geom.normals;
+        Mesh mesh({ geom });
+        ParameterizedMesh pm;
+        pm.mesh_id = 0;
+
+        CHECK(split_oversized_triangles(mesh, pm, params));
+        Geometry const& split = mesh.geometries[0];
+        CHECK(split.num_tris() > 2);
+        CHECK(split.uvs.data() == split.normals.data());
+        bool attributes_match = true;
+        double area = 0.0;
+        for (int i = 0; i < split.num_tris(); ++i) {
+            glm::vec3 p[3], n[3];
+            glm::vec2 t[3];
+            split.tri_positions(i, p[0], p[1], p[2]);
+            split.tri_normals(i, n[0], n[1], n[2]);
+            split.tri_uvs(i, t[0], t[1], t[2]);
+            area += triangle_area(p[0], p[1], p[2]);
+            for (int k = 0; k < 3; ++k) {
+                attributes_match &= glm::length(t[k] - planar_uv(p[k])) < 1e-3f;
+                attributes_match &= glm::length(n[k] - glm::vec3(0.0f, 0.0f, 1.0f)) < 1e-3f;
+            }
+        }
+        CHECK(attributes_match);
+        CHECK(close(area, 2.0, 1e-3));
+    }
+
+    // deforming meshes keep their triangles
+    {
+        Geometry geom;
+        geom.vertices = mapped_vector<void>(GenericBuffer(std::vector<glm::vec3>(positions)));
+        geom.indices = mapped_vector<glm::uvec3>(std::vector<glm::uvec3>(triangles));
+        Mesh mesh({ geom });
+        mesh.flags = Mesh::Skinned;
+        ParameterizedMesh pm;
+        pm.mesh_id = 0;
+        CHECK(!split_oversized_triangles(mesh, pm, params));
+        CHECK(mesh.num_tris() == 2);
+    }
+}
+
+int main() {
+    test_sah();
+    test_tlas();
+    test_heuristic();
+    test_split_triangles();
+    test_split_mesh();
+    return test_result();
+}
@@ -0,0 +1,103 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "camera_path.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+static CameraPathKey make_key(double time, glm::vec3 position, float yaw_degrees) {
+    float yaw = glm::radians(yaw_degrees);
+    CameraPathKey key;
+    key.time = time;
+    key.position = position;
+    key.orientation = CameraPathKey::orientation_from(glm::vec3(-std::sin(yaw), 0.0f, -std::cos(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+    return key;
+}
+
+// keys are interpolated, linear motion is reproduced exactly even for uneven key times
+static void test_interpolation() {
+    double const times[] = { 0.0, 0.5, 2.0, 2.5, 4.0 };
+    glm::vec3 const velocity(1.0f, -2.0f, 0.5f);
+    CameraPath path;
+    for (double t : times)
+        path.keys.push_back(make_key(t, velocity * float(t), float(t) * 30.0f));
+    path.finalize();
+
+    for (auto const& key : path.keys) {
+        CameraPathKey pose = path.evaluate(key.time);
+        CHECK(near_equal(pose.position, key.position, 1.e-4f));
+        CHECK(near_equal(pose.dir(), key.dir(), 1.e-4f));
+    }
+    for (double t = 0.0; t <= 4.0; t += 0.125)
+        CHECK(near_equal(path.evaluate(t).position, velocity * float(t), 1.e-3f));
+
+    // uniform rotation about the up axis stays uniform
+    CameraPathKey mid = path.evaluate(2.25);
+    float yaw = std::atan2(-mid.dir().x, -mid.dir().z);
+    CHECK(std::abs(glm::degrees(yaw) - 67.5f) < 0.05f);
+    CHECK(near_equal(mid.up(), glm::vec3(0.0f, 1.0f, 0.0f), 1.e-4f));
+
+    // ends hold their poses
+    CHECK(near_equal(path.evaluate(-1.0).position, path.keys.front().position, 1.e-4f));
+    CHECK(near_equal(path.evaluate(10.0).position, path.keys.back().position, 1.e-4f));
+}
+
+static void test_loop() {
+    CameraPath path;
+    for (int i = 0; i < 4; ++i)
+        path.keys.push_back(make_key(i, glm::vec3(std::cos(i * 1.5708f), 0.0f, std::sin(i * 1.5708f)), i * 90.0f));
+    path.loop = true;
+    path.loop_time = 1.0;
+    path.finalize();
+    CHECK(path.end_time() == 4.0);
+
+    for (double t = 0.0; t < 4.0; t += 0.3) {
+        CameraPathKey a = path.evaluate(t), b = path.evaluate(t + 8.0);
+        CHECK(near_equal(a.position, b.position, 1.e-3f));
+        CHECK(near_equal(a.dir(), b.dir(), 1.e-3f));
+    }
+    // the closing segment continues smoothly through 360 degrees
+    CameraPathKey closing = path.evaluate(3.5);
+    float yaw = glm::degrees(std::atan2(-closing.dir().x, -closing.dir().z));
+    CHECK(std::abs(yaw + 45.0f) < 0.05f);
+}
+
+static void test_file_round_trip() {
+    CameraPath path;
+    path.keys.push_back(make_key(0.0, glm::vec3(1.0f, 2.0f, 3.0f), 10.0f));
+    path.keys.push_back(make_key(1.5, glm::vec3(-1.0f, 0.0f, 3.0f), 80.0f));
+    for (auto& key : path.keys)
+        key.fov_y = 50.0f + float(key.time);
+    char const* file = "test_camera_path.campath";
+    save_camera_path(file, path);
+    CameraPath loaded = load_camera_path(file);
+    std::remove(file);
+
+    CHECK(loaded.keys.size() == path.keys.size() && !loaded.loop);
+    for (size_t i = 0; i < path.keys.size() && i < loaded.keys.size(); ++i) {
+        CHECK(loaded.keys[i].time == path.keys[i].time);
+        CHECK(near_equal(loaded.keys[i].position, path.keys[i].position, 1.e-4f));
+        CHECK(near_equal(loaded.keys[i].dir(), path.keys[i].dir(), 1.e-4f));
+        CHECK(loaded.keys[i].fov_y == path.keys[i].fov_y);
+    }
+    CHECK(std::abs(loaded.evaluate(0.75).fov_y - 50.75f) < 1.e-3f);
+
+    bool threw = false;
+    try {
+        path.keys[1].time = path.keys[0].time;
+        path.finalize();
+    } catch (std::exception const&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    printf("Testing camera paths\n");
+    test_interpolation();
+    test_loop();
+    test_file_round_trip();
+    return test_result();
+}
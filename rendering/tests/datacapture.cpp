@@ -0,0 +1,145 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "libdatacapture/pois.h"
+#include "libdatacapture/viewpoints.h"
+#include "libdatacapture/test_scene.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace rt_datacapture;
+
+static glm::vec3 const source(0.0f, 1.5f, 0.0f);
+
+static bool inside_room(glm::vec3 p, float eps = 1.e-3f) {
+    return p.x >= TEST_SCENE_LOWER.x - eps && p.y >= TEST_SCENE_LOWER.y - eps && p.z >= TEST_SCENE_LOWER.z - eps
+        && p.x <= TEST_SCENE_UPPER.x + eps && p.y <= TEST_SCENE_UPPER.y + eps && p.z <= TEST_SCENE_UPPER.z + eps;
+}
+
+static void test_raytracer(SceneRaytracer& raytracer) {
+    RayQuery queries[3];
+    queries[0] = { source, 0, glm::vec3(0.0f, -1.0f, 0.0f), 1.e32f }; // floor
+    queries[1] = { source, 0, glm::vec3(0.0f, 1.0f, 0.0f), 1.e32f }; // ceiling
+    queries[2] = { source, 0, glm::vec3(0.0f, -1.0f, 0.0f), 1.0f }; // floor out of range
+    float hit_t[3];
+    glm::vec3 hit_normal[3];
+    RaytraceResults results;
+    results.hit_t = hit_t;
+    results.hit_normal = hit_normal;
+    CHECK(raytracer.trace_ray(queries, 3, results) == 2);
+    CHECK(std::abs(hit_t[0] - 1.5f) < 1.e-4f);
+    CHECK(std::abs(hit_normal[0].y - 1.0f) < 1.e-4f);
+    CHECK(std::abs(hit_t[1] - 3.5f) < 1.e-4f);
+    CHECK(std::abs(hit_normal[1].y + 1.0f) < 1.e-4f);
+    CHECK(hit_t[2] < 0.0f);
+}
+
+static void test_collect(SceneRaytracer& raytracer) {
+    int const count = 20000;
+    std::vector<Poi> pois(count), again(count);
+    // closed room, all directions hit
+    CHECK(collect_visible_points(raytracer, source, pois.data(), count, 7) == count);
+    CHECK(collect_visible_points(raytracer, source, again.data(), count, 7) == count);
+
+    int outside = 0, mismatched = 0, unstratified = 0;
+    int octants[8] = { };
+    for (int i = 0; i < count; ++i) {
+        outside += int(!inside_room(pois[i].pos));
+        mismatched += int(pois[i].pos != again[i].pos || pois[i].distance != again[i].distance);
+        glm::vec3 d = pois[i].pos - source;
+        ++octants[(d.x > 0) + 2 * (d.y > 0) + 4 * (d.z > 0)];
+    }
+    for (int o : octants)
+        unstratified += int(std::abs(o - count / 8) > count / 100);
+    CHECK(outside == 0);
+    CHECK(mismatched == 0);
+    CHECK(unstratified == 0);
+
+    // points are visible: rays towards them are not blocked before reaching them
+    std::vector<RayQuery> queries(count);
+    std::vector<float> hit_t(count);
+    for (int i = 0; i < count; ++i)
+        queries[i] = { source, i, glm::normalize(pois[i].pos - source), 1.e32f };
+    RaytraceResults results;
+    results.hit_t = hit_t.data();
+    raytracer.trace_ray(queries.data(), count, results);
+    int occluded = 0;
+    for (int i = 0; i < count; ++i)
+        occluded += int(hit_t[i] < pois[i].distance - 1.e-3f * pois[i].distance);
+    CHECK(occluded == 0);
+
+    // open scene: misses stay invalid
+    SceneRaytracer floor_only;
+    floor_only.add_mesh({ glm::vec3(-100, 0, -100), glm::vec3(-100, 0, 100), glm::vec3(100, 0, 0) });
+    floor_only.add_instance(0, glm::mat4(1.0f));
+    floor_only.build();
+    int valid = collect_visible_points(floor_only, source, pois.data(), 1000, 1);
+    CHECK(valid > 400 && valid <= 500); // lower hemisphere
+    int counted = 0;
+    for (int i = 0; i < 1000; ++i)
+        counted += int(pois[i].valid());
+    CHECK(counted == valid);
+}
+
+static void test_prune(SceneRaytracer& raytracer) {
+    int const count = 20000;
+    std::vector<Poi> pois(count);
+    collect_visible_points(raytracer, source, pois.data(), count, 3);
+    pois[5].distance = -1.0f; // invalid entries are removed
+    std::vector<Poi> again = pois;
+
+    float const spacing = 0.5f;
+    RandomSampler rng(11), rng_again(11);
+    int kept = prune_pois(pois.data(), count, rng, spacing);
+    int kept_again = prune_pois(again.data(), count, rng_again, spacing);
+    CHECK(kept > 100 && kept < count / 2);
+    CHECK(kept == kept_again);
+
+    int too_close = 0, mismatched = 0, invalid = 0;
+    for (int i = 0; i < kept; ++i) {
+        invalid += int(!pois[i].valid());
+        mismatched += int(pois[i].pos != again[i].pos);
+        for (int j = i + 1; j < kept; ++j) {
+            glm::vec3 d = pois[i].pos - pois[j].pos;
+            if (glm::dot(d, d) < spacing * spacing && glm::dot(pois[i].normal, pois[j].normal) > 0.0f)
+                ++too_close;
+        }
+    }
+    CHECK(too_close == 0);
+    CHECK(mismatched == 0);
+    CHECK(invalid == 0);
+
+    // automatic spacing still thins out the densely sampled floor below the source
+    collect_visible_points(raytracer, source, again.data(), count, 3);
+    int auto_kept = prune_pois(again.data(), count, rng);
+    CHECK(auto_kept > 0 && auto_kept < count);
+}
+
+static void test_viewpoints(SceneRaytracer& raytracer) {
+    int const count = 5000;
+    std::vector<Poi> pois(count);
+    collect_visible_points(raytracer, source, pois.data(), count, 5);
+    RandomSampler rng(5);
+    int outside = 0, degenerate = 0;
+    for (int i = 0; i < 100; ++i) {
+        View v = sample_viewpoint(raytracer, pois.data(), count, rng);
+        outside += int(!inside_room(v.pos));
+        degenerate += int(std::abs(glm::length(v.dir) - 1.0f) > 1.e-3f);
+    }
+    CHECK(outside == 0);
+    CHECK(degenerate == 0);
+}
+
+int main() {
+    printf("Testing data capture POIs\n");
+    SceneRaytracer raytracer;
+    make_test_scene(raytracer);
+    CHECK(raytracer.instanced_triangle_count() == 12 * 33);
+    test_raytracer(raytracer);
+    test_collect(raytracer);
+    test_prune(raytracer);
+    test_viewpoints(raytracer);
+    return test_result();
+}
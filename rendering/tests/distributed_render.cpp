@@ -0,0 +1,241 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "distributed_render.h"
+#include "test_util.h"
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// Offline sequence whose frames write an image per output, several frames sharing
+// output names like the keyframe-named images of data capture mode
+struct Sequence {
+    uint64_t frame_count = 23;
+    int frame_spp = 16;
+    // off for renderers that continue the sample sequences of the previous frame
+    bool fixed_sample_offsets = true;
+    std::string output_dir;
+
+    std::vector<std::string> outputs(uint64_t frame) const {
+        std::string keyframe = output_dir + "/key_" + std::to_string(frame / 4);
+        return { keyframe + "_rgba", keyframe + "_normal_depth" };
+    }
+    static std::string image(uint64_t frame, int output, uint64_t sample_offset) {
+        return "frame " + std::to_string(frame) + " output " + std::to_string(output)
+            + " samples " + std::to_string(sample_offset);
+    }
+};
+
+// Sample sequence state of one renderer process, following the accumulation resets
+// of RenderVulkan::begin_frame
+struct FakeRenderer {
+    Sequence const& sequence;
+    uint64_t frame_offset = 0;
+    uint64_t frame_id = 0;
+
+    explicit FakeRenderer(Sequence const& sequence) : sequence(sequence) { }
+
+    // returns the offset the samples of the frame are seeded with
+    uint64_t render(uint64_t frame) {
+        if (sequence.fixed_sample_offsets)
+            frame_offset = offline_frame_sample_offset(frame, sequence.frame_spp);
+        else
+            frame_offset += frame_id;
+        frame_id = uint64_t(sequence.frame_spp);
+        return frame_offset;
+    }
+};
+
+static void write_file(std::string const& path, std::string const& data) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+static std::map<std::string, std::string> read_directory(std::string const& dir) {
+    std::map<std::string, std::string> files;
+    for (auto const& entry : fs::directory_iterator(dir)) {
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::stringstream data;
+        data << file.rdbuf();
+        files[entry.path().filename().string()] = data.str();
+    }
+    return files;
+}
+
+// Workers run synchronously on launch, crashing before the commit of given frames
+struct FakeWorkers {
+    Sequence const& sequence;
+    std::multiset<uint64_t> crash_frames;
+    std::deque<std::pair<long long, int>> exited;
+    long long next_pid = 100;
+    int launches = 0;
+
+    explicit FakeWorkers(Sequence const& sequence) : sequence(sequence) { }
+
+    long long launch(std::vector<std::string> const& args) {
+        size_t n = args.size();
+        CHECK(n >= 5 && args[n - 5] == "--distributed-worker");
+        DistributedWorkerArgs worker;
+        worker.slot = std::stoi(args[n - 4]);
+        worker.worker_count = std::stoi(args[n - 3]);
+        worker.first_frame = std::stoull(args[n - 2]);
+        worker.staging_dir = args[n - 1];
+        ++launches;
+
+        int exit_code = 0;
+        DistributedFrameStaging staging;
+        staging.staging_dir = worker.staging_dir;
+        FakeRenderer renderer(sequence);
+        for (uint64_t frame = 0; frame < sequence.frame_count && exit_code == 0; ++frame) {
+            if (!worker.renders_frame(frame))
+                continue;
+            staging.begin_frame(frame);
+            uint64_t sample_offset = renderer.render(frame);
+            std::vector<std::string> outputs = sequence.outputs(frame);
+            for (int i = 0; i < (int) outputs.size(); ++i) {
+                write_file(staging.staged_prefix(outputs[i]) + ".exr", Sequence::image(frame, i, sample_offset));
+                auto crash = crash_frames.find(frame);
+                if (crash != crash_frames.end()) {
+                    crash_frames.erase(crash);
+                    exit_code = -11;
+                    break;
+                }
+            }
+            if (exit_code == 0)
+                staging.commit_frame();
+        }
+        exited.push_back({ next_pid, exit_code });
+        return next_pid++;
+    }
+    bool wait(long long* pid, int* exit_code) {
+        if (exited.empty())
+            return false;
+        *pid = exited.front().first;
+        *exit_code = exited.front().second;
+        exited.pop_front();
+        return true;
+    }
+};
+
+static std::string make_directory(std::string const& name) {
+    fs::path dir = fs::temp_directory_path() / ("rptr_test_distributed_" + name);
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir.string();
+}
+
+static std::map<std::string, std::string> render_single_process(Sequence sequence) {
+    sequence.output_dir = make_directory("single");
+    FakeRenderer renderer(sequence);
+    for (uint64_t frame = 0; frame < sequence.frame_count; ++frame) {
+        uint64_t sample_offset = renderer.render(frame);
+        std::vector<std::string> outputs = sequence.outputs(frame);
+        for (int i = 0; i < (int) outputs.size(); ++i)
+            write_file(outputs[i] + ".exr", Sequence::image(frame, i, sample_offset));
+    }
+    return read_directory(sequence.output_dir);
+}
+
+static bool render_distributed(Sequence sequence, FakeWorkers& workers, int worker_count
+    , std::map<std::string, std::string>* result, std::string const& name) {
+    DistributedCoordinator coordinator;
+    coordinator.worker_count = worker_count;
+    coordinator.staging_dir = make_directory(name + "_staging");
+    coordinator.launch = [&](std::vector<std::string> const& args) { return workers.launch(args); };
+    coordinator.wait = [&](long long* pid, int* exit_code) { return workers.wait(pid, exit_code); };
+    bool success = coordinator.run({ "rptr", "scene.vks", "--data-capture", "out" });
+    if (success)
+        CHECK(!fs::exists(coordinator.staging_dir));
+    *result = read_directory(workers.sequence.output_dir);
+    return success;
+}
+
+static void test_assignment() {
+    DistributedWorkerArgs worker;
+    CHECK(worker.renders_frame(5));
+    worker.slot = 1;
+    worker.worker_count = 3;
+    worker.first_frame = 4;
+    CHECK(!worker.renders_frame(1));
+    CHECK(worker.renders_frame(4));
+    CHECK(!worker.renders_frame(5));
+    CHECK(worker.renders_frame(7));
+    std::vector<std::string> args = worker.command_line({ "rptr", "--data-capture", "x" });
+    CHECK(args.size() == 8 && args[3] == "--distributed-worker" && args[6] == "4");
+}
+
+static void test_merge_order() {
+    Sequence sequence;
+    std::map<std::string, std::string> reference = render_single_process(sequence);
+    for (int worker_count : { 1, 3, 4, 30 }) {
+        sequence.output_dir = make_directory("merge_" + std::to_string(worker_count));
+        FakeWorkers workers(sequence);
+        std::map<std::string, std::string> result;
+        CHECK(render_distributed(sequence, workers, worker_count, &result, "merge"));
+        CHECK(result == reference);
+        CHECK(workers.launches == worker_count);
+    }
+}
+
+static void test_sample_sequences() {
+    CHECK(offline_frame_sample_offset(0, 16) == 0);
+    CHECK(offline_frame_sample_offset(3, 16) == 48);
+    CHECK(offline_frame_sample_offset(3, -1) == 3);
+
+    Sequence sequence;
+    std::map<std::string, std::string> reference = render_single_process(sequence);
+    sequence.output_dir = make_directory("samples");
+    FakeWorkers workers(sequence);
+    std::map<std::string, std::string> result;
+    CHECK(render_distributed(sequence, workers, 3, &result, "samples"));
+    CHECK(result == reference);
+
+    // continued sequences depend on the frames each process rendered before
+    sequence.fixed_sample_offsets = false;
+    reference = render_single_process(sequence);
+    sequence.output_dir = make_directory("continued_samples");
+    FakeWorkers continued_workers(sequence);
+    CHECK(render_distributed(sequence, continued_workers, 3, &result, "continued_samples"));
+    CHECK(result != reference);
+}
+
+static void test_crash_recovery() {
+    Sequence sequence;
+    std::map<std::string, std::string> reference = render_single_process(sequence);
+    sequence.output_dir = make_directory("crash");
+    FakeWorkers workers(sequence);
+    // two crashes of the same worker, the second on a later frame, and one on the first frame
+    workers.crash_frames = { 5, 13, 2 };
+    std::map<std::string, std::string> result;
+    CHECK(render_distributed(sequence, workers, 4, &result, "crash"));
+    CHECK(result == reference);
+    CHECK(workers.launches == 4 + 3);
+}
+
+static void test_repeated_crash() {
+    Sequence sequence;
+    sequence.output_dir = make_directory("repeated");
+    FakeWorkers workers(sequence);
+    // a frame that always crashes its worker
+    workers.crash_frames = { 6, 6, 6, 6, 6 };
+    std::map<std::string, std::string> result;
+    CHECK(!render_distributed(sequence, workers, 4, &result, "repeated"));
+    // no partial outputs
+    CHECK(result.empty());
+    // one relaunch after progress up to the frame, then the retries without progress
+    CHECK(workers.launches == 4 + 1 + 2);
+}
+
+int main() {
+    test_assignment();
+    test_merge_order();
+    test_sample_sequences();
+    test_crash_recovery();
+    test_repeated_crash();
+    return test_result();
+}
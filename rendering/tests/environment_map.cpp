@@ -0,0 +1,168 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "environment_map.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static float const pi = 3.14159265358979323846f;
+
+// Sky with a small, very bright sun, a colored horizon band and a dark ground,
+// at a resolution that is not a power of two
+static EnvironmentMap make_outdoor_map(int width = 100, int height = 37) {
+    std::vector<float> rgb(3 * width * height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            float* c = &rgb[3 * (y * width + x)];
+            float sky = y < height / 2 ? 1.0f + float(x % 7) : 0.05f;
+            c[0] = sky * 0.6f;
+            c[1] = sky * 0.8f;
+            c[2] = sky;
+            if (y == height / 2) {
+                c[0] = 4.0f;
+                c[1] = 0.5f;
+                c[2] = 0.0f;
+            }
+            if (y == 5 && x >= 60 && x < 62) {
+                c[0] = c[1] = c[2] = 5000.0f;
+            }
+        }
+    return EnvironmentMap(width, height, rgb.data());
+}
+
+static void test_pyramid() {
+    EnvironmentMap map = make_outdoor_map();
+    CHECK(map.pyramid_width == 128);
+    CHECK(map.pyramid_height == 64);
+    CHECK(map.level_count() == 8);
+    CHECK(map.level_offsets[0] == 3 * 100 * 37);
+    // the root holds the total power
+    float root = map.pyramid[map.level_offsets.back() - map.level_offsets[0]];
+    CHECK(std::abs(root - map.total_power) < 1.e-4f * map.total_power);
+
+    // texels cover the sphere
+    double solid_angle = 0.0;
+    for (int y = 0; y < map.height; ++y)
+        solid_angle += glsl::environment_map_texel_solid_angle(y, map.width, map.height) * map.width;
+    CHECK(std::abs(solid_angle - 4.0 * pi) < 1.e-4);
+}
+
+static void test_pdf_matches_luminance() {
+    EnvironmentMap map = make_outdoor_map();
+    // the density is the luminance of the texel seen along the direction, normalized
+    std::mt19937 rng(3);
+    bool proportional = true;
+    for (int i = 0; i < 10000; ++i) {
+        float d[3];
+        uniform_direction(rng, d, 1);
+        float const* c = &map.radiance[3 * size_t(map.texel(d[0], d[1], d[2]))];
+        float expected = glsl::environment_map_luminance(c[0], c[1], c[2]) / map.total_power;
+        proportional &= std::abs(map.pdf(d[0], d[1], d[2]) - expected) <= 1.e-4f * expected;
+    }
+    CHECK(proportional);
+
+    // densities integrate to one over the sphere
+    double integral = 0.0;
+    int const integration_samples = 1000000;
+    for (int i = 0; i < integration_samples; ++i) {
+        float d[3];
+        uniform_direction(rng, d, 1);
+        integral += map.pdf(d[0], d[1], d[2]) * 4.0 * pi / integration_samples;
+    }
+    CHECK(std::abs(integral - 1.0) < 0.05);
+}
+
+static void test_sampling_matches_pdf() {
+    EnvironmentMap map = make_outdoor_map();
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int const count = 1000000;
+    std::vector<int> histogram(map.width * map.height, 0);
+    int inconsistent_pdfs = 0;
+    for (int i = 0; i < count; ++i) {
+        float d[3];
+        float pdf = map.sample(uniform(rng), uniform(rng), d);
+        // note: directions on texel boundaries may round into the neighboring texel
+        inconsistent_pdfs += std::abs(pdf - map.pdf(d[0], d[1], d[2])) > 1.e-3f * pdf;
+        ++histogram[map.texel(d[0], d[1], d[2])];
+    }
+    CHECK(inconsistent_pdfs < count / 1000);
+    // texels are hit in proportion to their power
+    bool matches = true;
+    for (int y = 0; y < map.height; ++y)
+        for (int x = 0; x < map.width; ++x) {
+            double expected = map.pyramid[size_t(y) * map.pyramid_width + x] / map.total_power * count;
+            matches &= std::abs(histogram[y * map.width + x] - expected) < 5.0 * std::sqrt(expected) + 3.0;
+        }
+    CHECK(matches);
+
+    // estimating the irradiance-like integral of luminance over the sphere from the
+    // sampled directions has almost no variance
+    double sum = 0.0, sum_sq = 0.0;
+    int const estimates = 100000;
+    for (int i = 0; i < estimates; ++i) {
+        float d[3];
+        float pdf = map.sample(uniform(rng), uniform(rng), d);
+        float const* c = &map.radiance[3 * size_t(map.texel(d[0], d[1], d[2]))];
+        double estimate = pdf > 0.0f ? glsl::environment_map_luminance(c[0], c[1], c[2]) / pdf : 0.0;
+        sum += estimate;
+        sum_sq += estimate * estimate;
+    }
+    double mean = sum / estimates;
+    double variance = sum_sq / estimates - mean * mean;
+    CHECK(std::abs(mean - map.total_power) < 1.e-3 * map.total_power);
+    CHECK(variance < 1.e-4 * mean * mean);
+}
+
+static void test_degenerate_maps() {
+    // a single texel covers the full sphere
+    float white[3] = { 1.0f, 1.0f, 1.0f };
+    EnvironmentMap single(1, 1, white);
+    CHECK(single.level_count() == 1);
+    float d[3];
+    float pdf = single.sample(0.3f, 0.7f, d);
+    CHECK(std::abs(pdf - 1.0f / (4.0f * pi)) < 1.e-5f);
+    CHECK(std::abs(single.pdf(0.0f, -1.0f, 0.0f) - 1.0f / (4.0f * pi)) < 1.e-5f);
+
+    // black maps cannot be sampled
+    std::vector<float> black(3 * 8 * 4, 0.0f);
+    EnvironmentMap dark(8, 4, black.data());
+    CHECK(dark.total_power == 0.0f);
+    CHECK(dark.sample(0.5f, 0.5f, d) == 0.0f);
+    CHECK(dark.pdf(0.0f, 1.0f, 0.0f) == 0.0f);
+
+    EnvironmentMap empty;
+    CHECK(empty.empty());
+    CHECK(empty.pdf(0.0f, 1.0f, 0.0f) == 0.0f);
+}
+
+static void test_gpu_buffer() {
+    EnvironmentMap map = make_outdoor_map();
+    std::vector<unsigned char> buffer(map.gpu_buffer_size());
+    map.write_gpu_buffer(buffer.data());
+    auto header = (glsl::EnvironmentMapHeader const*) buffer.data();
+    auto data = (float const*) (header + 1);
+    CHECK(header->width == 100);
+    CHECK(header->height == 37);
+    CHECK(header->level_count == 8);
+    CHECK(header->total_power == map.total_power);
+    CHECK(data[3 * (5 * 100 + 60)] == 5000.0f);
+    CHECK(data[header->level_offsets[header->level_count - 1]] == map.pyramid.back());
+
+    EnvironmentMap empty;
+    CHECK(empty.gpu_buffer_size() == sizeof(glsl::EnvironmentMapHeader));
+    empty.write_gpu_buffer(buffer.data());
+    CHECK(header->width == 0);
+}
+
+int main() {
+    test_pyramid();
+    test_pdf_matches_luminance();
+    test_sampling_matches_pdf();
+    test_degenerate_maps();
+    test_gpu_buffer();
+    return test_result();
+}
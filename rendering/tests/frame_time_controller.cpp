@@ -0,0 +1,182 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "frame_time_controller.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Synthetic GPU timings: fixed overhead plus cost per full-resolution sample, with relative noise
+struct TimingTrace {
+    float overhead_ms = 1.0f;
+    float sample_ms = 2.0f;
+    float noise = 0.0f;
+    std::mt19937 rng{ 7 };
+
+    float frame_time(FrameTimeController::Decision d) {
+        float t = overhead_ms + sample_ms * float(d.batch_spp) / float(d.upscale_factor * d.upscale_factor);
+        if (noise > 0.0f)
+            t *= 1.0f + std::uniform_real_distribution<float>(-noise, noise)(rng);
+        return t;
+    }
+};
+
+struct TraceRun {
+    FrameTimeController::Decision last;
+    float last_ms = 0.0f;
+    int spp_changes = 0;
+    int resolution_changes = 0;
+};
+
+static TraceRun run(FrameTimeController& controller, TimingTrace& trace, int frames) {
+    TraceRun r;
+    r.last = controller.current;
+    for (int i = 0; i < frames; ++i) {
+        r.last_ms = trace.frame_time(controller.current);
+        FrameTimeController::Decision next = controller.update(r.last_ms);
+        r.spp_changes += next.batch_spp != r.last.batch_spp;
+        r.resolution_changes += next.upscale_factor != r.last.upscale_factor;
+        r.last = next;
+    }
+    return r;
+}
+
+static FrameTimeController make_controller(float target_ms) {
+    FrameTimeController controller;
+    controller.settings.target_ms = target_ms;
+    controller.reset({ 1, 1 });
+    return controller;
+}
+
+static bool near_target(FrameTimeController const& controller, float time_ms) {
+    return std::abs(time_ms - controller.settings.target_ms)
+        <= controller.settings.tolerance * controller.settings.target_ms + 1.e-3f;
+}
+
+static void test_disabled() {
+    FrameTimeController controller;
+    controller.reset({ 3, 2 });
+    TimingTrace trace;
+    trace.sample_ms = 100.0f;
+    TraceRun r = run(controller, trace, 20);
+    CHECK(r.last.batch_spp == 3 && r.last.upscale_factor == 2);
+    CHECK(r.spp_changes == 0 && r.resolution_changes == 0);
+}
+
+static void test_convergence() {
+    FrameTimeController controller = make_controller(16.0f);
+    TimingTrace trace;
+    TraceRun r = run(controller, trace, 40);
+    // 1 ms + 7 * 2 ms
+    CHECK(r.last.upscale_factor == 1);
+    CHECK(r.last.batch_spp == 7);
+    CHECK(near_target(controller, trace.frame_time(r.last)));
+    r = run(controller, trace, 40);
+    CHECK(r.spp_changes == 0 && r.resolution_changes == 0);
+}
+
+// GPU timer queries are read back a few frames late
+static void test_latency() {
+    FrameTimeController controller = make_controller(16.0f);
+    TimingTrace trace;
+    float pending[2] = { 0.0f, 0.0f };
+    bool overshoot = false;
+    for (int i = 0; i < 80; ++i) {
+        float measured = pending[0];
+        pending[0] = pending[1];
+        pending[1] = trace.frame_time(controller.current);
+        int spp = controller.current.batch_spp;
+        controller.update(measured);
+        // stale timings of fewer samples must not be attributed to more samples
+        overshoot |= controller.current.batch_spp < spp;
+    }
+    CHECK(controller.current.batch_spp == 7);
+    CHECK(!overshoot);
+}
+
+static void test_heavy_scene() {
+    FrameTimeController controller = make_controller(16.0f);
+    TimingTrace trace;
+    run(controller, trace, 40);
+
+    // a single sample at full resolution exceeds the target: fewer samples, then lower resolution
+    trace.sample_ms = 40.0f;
+    TraceRun r = run(controller, trace, 40);
+    CHECK(r.last.upscale_factor == 2);
+    CHECK(r.last.batch_spp == 1);
+    CHECK(r.resolution_changes == 1);
+    CHECK(trace.frame_time(r.last) <= controller.settings.target_ms);
+
+    // moderately heavy: lower resolution with more samples
+    trace.sample_ms = 20.0f;
+    r = run(controller, trace, 40);
+    CHECK(r.resolution_changes == 0);
+    CHECK(r.last.upscale_factor == 2);
+    // 1 ms + 3 * 20 ms / 4
+    CHECK(r.last.batch_spp == 3);
+    CHECK(near_target(controller, trace.frame_time(r.last)));
+
+    // recovery: back to full resolution
+    trace.sample_ms = 2.0f;
+    r = run(controller, trace, 40);
+    CHECK(r.last.upscale_factor == 1);
+    CHECK(r.last.batch_spp == 7);
+    CHECK(r.resolution_changes == 1);
+}
+
+static void test_noise() {
+    FrameTimeController controller = make_controller(16.0f);
+    TimingTrace trace;
+    trace.noise = 0.15f;
+    run(controller, trace, 40);
+    TraceRun r = run(controller, trace, 400);
+    CHECK(r.resolution_changes == 0);
+    // occasional steps between neighboring sample counts, not from frame to frame
+    CHECK(r.spp_changes <= 20);
+    CHECK(r.last.batch_spp >= 6 && r.last.batch_spp <= 8);
+
+    // noise at the border between two resolutions: 1 spp at full resolution is just above target
+    trace.sample_ms = 16.5f;
+    trace.overhead_ms = 0.0f;
+    run(controller, trace, 40);
+    r = run(controller, trace, 400);
+    CHECK(r.resolution_changes <= 1);
+}
+
+static void test_limits() {
+    FrameTimeController controller = make_controller(16.0f);
+    controller.settings.max_spp = 4;
+    TimingTrace trace;
+    trace.sample_ms = 0.1f;
+    TraceRun r = run(controller, trace, 40);
+    CHECK(r.last.batch_spp == 4 && r.last.upscale_factor == 1);
+
+    // resolution cannot be lowered beyond the limit
+    trace.sample_ms = 1000.0f;
+    r = run(controller, trace, 40);
+    CHECK(r.last.batch_spp == 1 && r.last.upscale_factor == 2);
+
+    controller.settings.max_upscale_factor = 1;
+    controller.settings.min_spp = 2;
+    r = run(controller, trace, 40);
+    CHECK(r.last.batch_spp == 2 && r.last.upscale_factor == 1);
+
+    // invalid measurements are ignored
+    FrameTimeController::Decision before = controller.current;
+    long long measurements = controller.sample_cost.num_samples;
+    controller.update(0.0f);
+    controller.update(NAN);
+    CHECK(controller.current.batch_spp == before.batch_spp);
+    CHECK(controller.sample_cost.num_samples == measurements);
+}
+
+int main() {
+    test_disabled();
+    test_convergence();
+    test_latency();
+    test_heavy_scene();
+    test_noise();
+    test_limits();
+    return test_result();
+}
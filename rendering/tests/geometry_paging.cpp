@@ -0,0 +1,248 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "geometry_paging.h"
+#include "camera_path.h"
+#include "test_scene_util.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+static const size_t BYTES_PER_TRIANGLE = 128;
+static const int TRIANGLES_PER_MESH = 8;
+static const size_t MESH_BYTES = BYTES_PER_TRIANGLE * TRIANGLES_PER_MESH;
+
+// Unit cube bounds with a few unrolled triangles, the pager only looks at bounds and triangle counts
+static Mesh unit_mesh(uint32_t flags = 0) {
+    std::vector<glm::vec3> positions(3 * TRIANGLES_PER_MESH);
+    for (int i = 0; i < TRIANGLES_PER_MESH; ++i) {
+        positions[3 * i] = glm::vec3(0.0f);
+        positions[3 * i + 1] = glm::vec3(1.0f, 0.0f, 0.0f);
+        positions[3 * i + 2] = glm::vec3(0.0f, 1.0f, 1.0f);
+    }
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.format_flags = Geometry::NoIndices;
+    geom.base = glm::vec3(0.0f);
+    geom.extent = glm::vec3(1.0f);
+    Mesh mesh({ geom });
+    mesh.flags = flags;
+    return mesh;
+}
+
+// A row of meshes every 10 units along x
+static Scene row_scene(int count) {
+    SceneBuilder builder;
+    builder.undo_vks_axes = true;
+    for (int i = 0; i < count; ++i)
+        builder.add_instance(builder.add_mesh(unit_mesh()), builder.add_transform(glm::vec3(10.0f * float(i), 0.0f, 0.0f)));
+    return builder.finish();
+}
+
+static GeometryPagingParams test_params(int budget_pages) {
+    GeometryPagingParams params;
+    params.bytes_per_triangle = BYTES_PER_TRIANGLE;
+    params.page_bytes = 2 * MESH_BYTES;
+    params.budget_bytes = size_t(budget_pages) * params.page_bytes;
+    params.min_screen_size = 0.01f;
+    return params;
+}
+
+static void test_pages() {
+    Scene scene = row_scene(16);
+    GeometryPager pager;
+    pager.reset(scene, test_params(4));
+
+    CHECK(pager.pages.size() == 8);
+    for (auto& page : pager.pages) {
+        CHECK(page.mesh_ids.size() == 2);
+        CHECK(page.bytes == 2 * MESH_BYTES);
+        CHECK(page.reference_count == 2);
+        // neighbors along the row share pages
+        glm::vec3 extent = page.bounds.extent();
+        CHECK(extent.x <= 12.0f);
+    }
+    for (int i = 0; i < 16; ++i)
+        CHECK(pager.mesh_pages[i] >= 0);
+
+    CHECK(pager.update(glm::vec3(0.0f), 60.0f));
+    CHECK(pager.loaded_pages.size() == 4);
+    CHECK(pager.mesh_resident(0));
+    CHECK(!pager.mesh_resident(15));
+
+    // sizes measured later replace the estimates
+    int page_idx = pager.mesh_pages[0];
+    size_t resident_bytes = pager.resident_bytes;
+    pager.set_mesh_bytes(0, MESH_BYTES / 2);
+    CHECK(pager.pages[page_idx].bytes == MESH_BYTES + MESH_BYTES / 2);
+    CHECK(pager.resident_bytes == resident_bytes - MESH_BYTES / 2);
+
+    // nothing is paged without a budget
+    GeometryPager disabled;
+    disabled.reset(scene, test_params(0));
+    CHECK(!disabled.enabled());
+    CHECK(!disabled.update(glm::vec3(0.0f), 60.0f));
+    CHECK(disabled.mesh_resident(5));
+}
+
+static void test_camera_path_budget() {
+    int mesh_count = 64;
+    Scene scene = row_scene(mesh_count);
+    int budget_pages = 4;
+    GeometryPager pager;
+    pager.reset(scene, test_params(budget_pages));
+    int page_count = ilen(pager.pages);
+
+    // fly along the row, looking down x
+    CameraPath path;
+    for (int i = 0; i <= 4; ++i) {
+        CameraPathKey key;
+        key.time = double(i);
+        key.position = glm::vec3(160.0f * float(i), 2.0f, 0.5f);
+        key.orientation = CameraPathKey::orientation_from(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        path.keys.push_back(key);
+    }
+    path.finalize();
+
+    int total_loads = 0;
+    int nearest_missing = 0;
+    std::vector<int> load_counts(page_count, 0);
+    for (double t = path.start_time(); t <= path.end_time(); t += 1.0 / 30.0) {
+        glm::vec3 eye = path.evaluate(t).position;
+        pager.update(eye, 60.0f);
+        CHECK(pager.resident_bytes <= pager.params.budget_bytes);
+
+        size_t resident_bytes = 0;
+        for (int i = 0; i < page_count; ++i)
+            if (pager.resident[i])
+                resident_bytes += pager.pages[i].bytes;
+        CHECK(resident_bytes == pager.resident_bytes);
+
+        for (int page_idx : pager.loaded_pages)
+            ++load_counts[page_idx];
+        total_loads += ilen(pager.loaded_pages);
+
+        // the geometry right in front of the camera is always resident
+        int nearest = std::min(std::max(int(std::round(eye.x / 10.0f)), 0), mesh_count - 1);
+        if (!pager.mesh_resident(nearest))
+            ++nearest_missing;
+    }
+    CHECK(nearest_missing == 0);
+    // pages left behind are not reloaded on a path that never returns
+    for (int i = 0; i < page_count; ++i)
+        CHECK(load_counts[i] <= 1);
+    CHECK(total_loads <= page_count);
+    CHECK(total_loads >= page_count - budget_pages);
+
+    // small camera motion does not cause thrashing
+    pager.update(glm::vec3(325.0f, 2.0f, 0.5f), 60.0f);
+    int changes = 0;
+    for (int i = 0; i < 50; ++i) {
+        glm::vec3 eye(325.0f + 4.0f * std::sin(0.7f * float(i)), 2.0f, 0.5f);
+        changes += pager.update(eye, 60.0f);
+    }
+    CHECK(changes == 0);
+}
+
+static void test_load_limit() {
+    Scene scene = row_scene(16);
+    GeometryPagingParams params = test_params(4);
+    params.max_load_bytes = params.page_bytes;
+    GeometryPager pager;
+    pager.reset(scene, params);
+
+    int updates = 0;
+    do {
+        pager.update(glm::vec3(35.0f, 0.5f, 0.5f), 60.0f);
+        CHECK(pager.loaded_pages.size() <= 1);
+        ++updates;
+    } while (!pager.loaded_pages.empty() && updates < 100);
+    CHECK(updates == 5); // four pages, then nothing left to load
+    CHECK(pager.missing_pages > 0); // more pages would be visible than fit
+    CHECK(pager.resident_bytes == params.budget_bytes);
+}
+
+static void test_lods() {
+    SceneBuilder builder;
+    builder.undo_vks_axes = true;
+    int lod_meshes[3];
+    for (int j = 0; j < 3; ++j)
+        lod_meshes[j] = builder.add_mesh(unit_mesh());
+    builder.scene.lod_groups.resize(2);
+    builder.scene.lod_groups[1].mesh_ids = { lod_meshes[0], lod_meshes[1], lod_meshes[2] };
+    builder.scene.lod_groups[1].detail_reduction = { 0.0f, 0.5f, 0.9f };
+    for (int j = 0; j < 3; ++j)
+        builder.scene.parameterized_meshes[lod_meshes[j]].lod_group = 1;
+    builder.add_instance(lod_meshes[0], builder.add_transform(glm::vec3(0.0f)));
+    int dynamic_mesh = builder.add_mesh(unit_mesh(Mesh::Dynamic));
+    builder.add_instance(dynamic_mesh, builder.add_transform(glm::vec3(0.0f, 5.0f, 0.0f)));
+    Scene& scene = builder.finish();
+
+    GeometryPagingParams params = test_params(8);
+    params.page_bytes = MESH_BYTES; // one mesh per page
+    params.min_screen_size = 0.0f;
+    GeometryPager pager;
+    pager.reset(scene, params);
+    CHECK(pager.pages.size() == 3);
+    CHECK(pager.mesh_pages[dynamic_mesh] < 0);
+    CHECK(pager.mesh_resident(dynamic_mesh));
+
+    // distances in units of the LoD reference distance
+    float lod_unit = 0.5f * std::sqrt(3.0f) / std::tan(glm::radians(60.0f) * 0.5f);
+    auto requested = [&](float distance, int lod_offset, int level) {
+        pager.update(glm::vec3(0.5f, 0.5f, 0.5f + distance * lod_unit), 60.0f, lod_offset);
+        return pager.priorities[pager.mesh_pages[lod_meshes[level]]] > 0.0f;
+    };
+    CHECK(requested(1.0f, -1, 0));
+    CHECK(!requested(1.0f, -1, 1));
+    CHECK(!requested(1.0f, -1, 2));
+    // LoDs are requested a bit before they become active, and kept a bit longer
+    CHECK(requested(1.9f, -1, 0));
+    CHECK(requested(1.9f, -1, 1));
+    CHECK(requested(5.0f, -1, 1));
+    CHECK(!requested(5.0f, -1, 0));
+    CHECK(requested(50.0f, -1, 2));
+    CHECK(!requested(50.0f, -1, 1));
+    // a fixed LoD offset overrides distances
+    CHECK(requested(1.0f, 1, 1));
+    CHECK(!requested(1.0f, 1, 0));
+    CHECK(requested(50.0f, 5, 2));
+}
+
+static void test_file_advice() {
+    std::string file = (std::filesystem::temp_directory_path() / "geometry_paging_test.bin").string();
+    std::vector<uint32_t> data(64 * 1024);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = uint32_t(i * 2654435761u);
+    {
+        std::ofstream out(file, std::ios::binary);
+        out.write((char const*) data.data(), data.size() * sizeof(data[0]));
+    }
+    {
+        FileMapping mapping(file);
+        mapped_vector<uint32_t> view(mapping, 4 * 1000, 4 * 40000);
+        view.advise(true);
+        CHECK(view.data()[0] == data[1000]);
+        view.advise(false);
+        // dropped pages are read back from the file
+        CHECK(std::memcmp(view.data(), data.data() + 1000, view.nbytes()) == 0);
+        mapping.advise(mapping.nbytes() - 16, 1024, true);
+        mapped_vector<uint32_t> buffer = Buffer<uint32_t>(std::vector<uint32_t>(data));
+        buffer.advise(false);
+        CHECK(buffer.size() == data.size());
+    }
+    std::filesystem::remove(file);
+}
+
+int main() {
+    test_pages();
+    test_camera_path_budget();
+    test_load_limit();
+    test_lods();
+    test_file_advice();
+
+    return test_result();
+}
@@ -0,0 +1,186 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "instance_bounds.h"
+#include "test_scene_util.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static Geometry box_geometry(glm::vec3 base, glm::vec3 extent) {
+    Geometry geo;
+    geo.base = base;
+    geo.extent = extent;
+    return geo;
+}
+
+// Two instances of a mesh with two LoDs, one static and one moving along x over 4 frames
+static Scene make_test_scene() {
+    Scene scene;
+    scene.meshes.push_back(Mesh({ box_geometry(glm::vec3(0.0f), glm::vec3(1.0f)) }));
+    scene.meshes.push_back(Mesh({ box_geometry(glm::vec3(-1.0f), glm::vec3(1.0f))
+                                , box_geometry(glm::vec3(0.0f), glm::vec3(1.0f)) }));
+
+    scene.lod_groups.resize(2);
+    scene.lod_groups[1].mesh_ids = { 0, 1 };
+    scene.lod_groups[1].detail_reduction = { 1.0f, 0.5f };
+
+    scene.parameterized_meshes.resize(2);
+    for (int i = 0; i < 2; ++i) {
+        scene.parameterized_meshes[i].mesh_id = i;
+        scene.parameterized_meshes[i].lod_group = 1;
+    }
+
+    AnimationData anim;
+    anim.numStaticTransforms = 1;
+    anim.numAnimatedTransforms = 1;
+    anim.numFrames = 4;
+    anim.animationStart = 0.0f;
+    anim.animationStep = 0.5f;
+    std::vector<unsigned char> quantized(anim.size_in_bytes());
+    quantize_translation(quantized.data(), glm::vec3(0.0f));
+    for (int f = 0; f < 4; ++f)
+        quantize_translation(quantized.data() + (1 + f) * VKR_QUANTIZED_TRANSFORM_SIZE, glm::vec3(10.0f * f, 0.0f, 0.0f));
+    anim.quantized = mapped_vector<unsigned char>(std::move(quantized));
+    scene.animation_data.push_back(anim);
+
+    Instance static_instance = { };
+    static_instance.parameterized_mesh_id = 0;
+    static_instance.transform_index = 0;
+    Instance animated_instance = static_instance;
+    animated_instance.transform_index = 1;
+    scene.instances = { static_instance, animated_instance };
+    return scene;
+}
+
+static void test_box() {
+    Box box(glm::vec3(0.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+    CHECK(!box.empty());
+    CHECK(std::abs(box.surface_area() - 22.0f) < 1.e-5f);
+    CHECK(Box().empty());
+    CHECK(Box().surface_area() == 0.0f);
+
+    Box moved = box.transformed(glm::mat4(glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)
+                                        , glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f)
+                                        , glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)
+                                        , glm::vec4(5.0f, 0.0f, 0.0f, 1.0f)));
+    CHECK(near_equal(moved.lower, glm::vec3(3.0f, 0.0f, 0.0f)));
+    CHECK(near_equal(moved.upper, glm::vec3(5.0f, 1.0f, 3.0f)));
+}
+
+static void test_frame_at_time() {
+    Scene scene = make_test_scene();
+    auto& anim = scene.animation_data[0];
+    CHECK(anim.frame_at_time(0.0) == 0);
+    CHECK(anim.frame_at_time(0.6) == 1);
+    CHECK(anim.frame_at_time(1.99) == 3);
+    CHECK(anim.frame_at_time(2.1) == 0);
+    CHECK(anim.frame_at_time(-0.1) == 3);
+
+    AnimationData still = anim;
+    still.numFrames = 1;
+    CHECK(still.frame_at_time(1.0) == 0);
+}
+
+static void test_tracker() {
+    Scene scene = make_test_scene();
+    InstanceBoundsTracker tracker;
+    tracker.reset(scene, 0.0, 0);
+    CHECK(tracker.has_animation());
+    CHECK(tracker.animated_instance_count == 1);
+    CHECK(tracker.active_meshes[0] == 0 && tracker.active_meshes[1] == 0);
+
+    // world bounds enclose the transformed local bounds of the active LoD member
+    for (int i = 0; i < 2; ++i) {
+        glm::mat4 m = scene.animation_data[0].dequantize(scene.instances[i].transform_index, 0);
+        Box expected = Box(glm::vec3(0.0f), glm::vec3(1.0f)).transformed(m);
+        CHECK(near_equal(tracker.world_bounds[i].lower, expected.lower));
+        CHECK(near_equal(tracker.world_bounds[i].upper, expected.upper));
+    }
+
+    // nothing changes within the same frame
+    CHECK(tracker.update(0.25, 0) == 0);
+
+    // switching LoDs affects all instances of the group, coarser LoD has larger bounds
+    float lod0_area = tracker.world_bounds[0].surface_area();
+    CHECK(tracker.update(0.25, 1) == 2);
+    CHECK(tracker.active_meshes[0] == 1 && tracker.active_meshes[1] == 1);
+    CHECK(tracker.world_bounds[0].surface_area() > 3.9f * lod0_area);
+
+    // LoD offsets beyond the group clamp to the last member
+    tracker.update(0.25, 5);
+    CHECK(tracker.active_meshes[0] == 1);
+
+    // advancing the animation only affects the animated instance
+    Box static_bounds = tracker.world_bounds[0];
+    Box animated_bounds = tracker.world_bounds[1];
+    CHECK(tracker.update(0.6, 5) == 1);
+    CHECK(near_equal(tracker.world_bounds[0].lower, static_bounds.lower));
+    glm::vec3 motion = tracker.world_bounds[1].lower - animated_bounds.lower;
+    CHECK(std::abs(glm::length(motion) - 10.0f) < 1.e-2f);
+}
+
+static std::vector<Box> grid_bounds(int n, float spacing) {
+    std::vector<Box> bounds;
+    for (int z = 0; z < n; ++z)
+        for (int y = 0; y < n; ++y)
+            for (int x = 0; x < n; ++x) {
+                glm::vec3 p = spacing * glm::vec3(x, y, z);
+                bounds.push_back(Box(p, p + glm::vec3(1.0f)));
+            }
+    return bounds;
+}
+
+static void test_refit_heuristic() {
+    std::vector<Box> bounds = grid_bounds(4, 2.0f);
+    TlasRefitHeuristic heuristic;
+    heuristic.rebuilt(bounds);
+    CHECK(std::abs(heuristic.area_ratio(bounds) - 1.0) < 1.e-6);
+    CHECK(!heuristic.needs_rebuild(bounds));
+
+    // rigid motion of the whole scene keeps the hierarchy intact
+    std::vector<Box> moved = bounds;
+    for (auto& b : moved)
+        b = Box(b.lower + glm::vec3(100.0f, -3.0f, 7.0f), b.upper + glm::vec3(100.0f, -3.0f, 7.0f));
+    CHECK(heuristic.area_ratio(moved) < 1.01);
+    CHECK(!heuristic.needs_rebuild(moved));
+
+    // small jitter only degrades the hierarchy slightly
+    std::vector<Box> jittered = bounds;
+    for (int i = 0; i < ilen(jittered); ++i) {
+        glm::vec3 d(0.1f * float(i % 3), 0.05f * float(i % 5), 0.0f);
+        jittered[i] = Box(jittered[i].lower + d, jittered[i].upper + d);
+    }
+    CHECK(!heuristic.needs_rebuild(jittered));
+
+    // instances trading places spread all nodes over the scene
+    std::vector<Box> shuffled = bounds;
+    uint32_t rng = 7;
+    for (int i = ilen(shuffled) - 1; i > 0; --i) {
+        rng = rng * 1664525u + 1013904223u;
+        std::swap(shuffled[i], shuffled[(rng >> 8) % uint32_t(i + 1)]);
+    }
+    CHECK(heuristic.area_ratio(shuffled) > 1.5);
+    CHECK(heuristic.needs_rebuild(shuffled));
+    heuristic.rebuilt(shuffled);
+    CHECK(!heuristic.needs_rebuild(shuffled));
+
+    // changed instance counts and refit budgets force rebuilds
+    bounds.pop_back();
+    CHECK(heuristic.needs_rebuild(bounds));
+    heuristic.max_refits = 2;
+    heuristic.refitted();
+    CHECK(!heuristic.needs_rebuild(shuffled));
+    heuristic.refitted();
+    CHECK(heuristic.needs_rebuild(shuffled));
+}
+
+int main() {
+    printf("Testing instance bounds\n");
+    test_box();
+    test_frame_at_time();
+    test_tracker();
+    test_refit_heuristic();
+    return test_result();
+}
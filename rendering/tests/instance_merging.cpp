@@ -0,0 +1,231 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "instance_merging.h"
+#include "test_scene_util.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// The previous merging of consecutive instances with equal transforms, as reference
+static void reference_merge_partition_instances(Scene &scene, int instanceBase) {
+    auto& instances = scene.instances;
+    auto& parameterized_meshes = scene.parameterized_meshes;
+    auto& meshes = scene.meshes;
+    auto& lod_groups = scene.lod_groups;
+    auto& transform_data = scene.animation_data[0];
+    glm::mat4 cursor_transform(-1.0f);
+    int cursor_i = instanceBase, ic = instanceBase;
+    for (int i = instanceBase, ie = ilen(instances); i < ie; ++i) {
+        auto& pmesh = parameterized_meshes[instances[i].parameterized_mesh_id];
+        auto& mesh = meshes[pmesh.mesh_id];
+
+        bool mergeable = pmesh.lod_group == 0 || (lod_groups[pmesh.lod_group].mesh_ids.size() <= 1
+            && !pmesh.per_triangle_materials()
+            && pmesh.shader_names.empty()
+            && mesh.mesh_shader_names.empty());
+        if (!mergeable) {
+            cursor_transform[3][3] = -1.0f;
+            if (ic != i)
+                instances[ic] = instances[i];
+            ++ic;
+            continue;
+        }
+
+        glm::mat4 transform = transform_data.dequantize(instances[i].transform_index, 0);
+        auto& ci_pmesh = parameterized_meshes[instances[cursor_i].parameterized_mesh_id];
+        auto& ci_mesh = meshes[ci_pmesh.mesh_id];
+        bool merge_with_prev = cursor_transform[3][3] > 0.0f
+            && transform == cursor_transform
+            && mesh.flags == ci_mesh.flags;
+        if (!merge_with_prev) {
+            cursor_transform = transform;
+            if (ic != i)
+                instances[ic] = instances[i];
+            cursor_i = ic++;
+            continue;
+        }
+
+        ci_mesh.geometries.insert(ci_mesh.geometries.end()
+            , mesh.geometries.begin(), mesh.geometries.end());
+        ci_pmesh.material_offsets.insert(ci_pmesh.material_offsets.end()
+            , pmesh.material_offsets.begin(), pmesh.material_offsets.end());
+        ci_pmesh.has_overrides_applied = true;
+    }
+    instances.resize(ic);
+}
+
+// Meshes with a single geometry, identified by the base of the geometry
+static int add_indexed_mesh(SceneBuilder& builder, uint32_t flags = 0) {
+    Geometry geom;
+    geom.base = glm::vec3(float(builder.scene.meshes.size()), 0.0f, 0.0f);
+    Mesh mesh({ geom });
+    mesh.flags = flags;
+    int mesh_id = builder.add_mesh(mesh);
+    builder.scene.parameterized_meshes[mesh_id].material_offsets = { mesh_id };
+    return mesh_id;
+}
+
+static std::vector<float> geometry_ids(Mesh const& mesh) {
+    std::vector<float> ids;
+    for (auto const& geom : mesh.geometries)
+        ids.push_back(geom.base.x);
+    return ids;
+}
+
+static bool same_merge(Scene const& a, Scene const& b) {
+    if (a.instances.size() != b.instances.size() || a.meshes.size() != b.meshes.size())
+        return false;
+    bool same = true;
+    for (size_t i = 0; i < a.instances.size(); ++i)
+        same &= a.instances[i].parameterized_mesh_id == b.instances[i].parameterized_mesh_id
+            && a.instances[i].transform_index == b.instances[i].transform_index;
+    for (size_t i = 0; i < a.meshes.size(); ++i)
+        same &= geometry_ids(a.meshes[i]) == geometry_ids(b.meshes[i]);
+    for (size_t i = 0; i < a.parameterized_meshes.size(); ++i)
+        same &= a.parameterized_meshes[i].material_offsets == b.parameterized_meshes[i].material_offsets
+            && a.parameterized_meshes[i].has_overrides_applied == b.parameterized_meshes[i].has_overrides_applied;
+    return same;
+}
+
+// Tiles as written by partitioning: all props of a tile share its transform and follow each other,
+// some props are animated or have LoDs
+static Scene tiled_scene(int tiles, int props_per_tile, uint32_t seed) {
+    std::mt19937 rng(seed);
+    SceneBuilder builder;
+    builder.scene.lod_groups.resize(2);
+    int lod_meshes[2] = { add_indexed_mesh(builder), add_indexed_mesh(builder) };
+    builder.scene.lod_groups[1].mesh_ids = { lod_meshes[0], lod_meshes[1] };
+    builder.scene.lod_groups[1].detail_reduction = { 0.0f, 0.5f };
+    for (int mesh_id : lod_meshes)
+        builder.scene.parameterized_meshes[mesh_id].lod_group = 1;
+
+    for (int t = 0; t < tiles; ++t) {
+        int transform = builder.add_transform(glm::vec3(100.0f * float(t % 16), 0.0f, 100.0f * float(t / 16)));
+        for (int p = 0; p < props_per_tile; ++p) {
+            uint32_t flags = rng() % 4 == 0 ? Mesh::Dynamic : 0;
+            builder.add_instance(add_indexed_mesh(builder, flags), transform);
+            if (rng() % 8 == 0)
+                builder.add_instance(lod_meshes[0], builder.add_transform(glm::vec3(float(t), 1.0f, float(p))));
+        }
+    }
+    return builder.finish();
+}
+
+static void test_reference() {
+    for (uint32_t seed = 1; seed <= 10; ++seed) {
+        Scene expected = tiled_scene(8 * int(seed), 1 + int(seed % 5), seed);
+        Scene scene = tiled_scene(8 * int(seed), 1 + int(seed % 5), seed);
+        reference_merge_partition_instances(expected, 0);
+        InstanceMergeStats stats = merge_partition_instances(scene, 0);
+        CHECK(stats.instances == stats.merged_instances + ilen(scene.instances));
+        CHECK(stats.duplicate_instances == 0);
+        CHECK(stats.approximate_matches == 0);
+        // hashing also merges across the interruptions of consecutive runs
+        CHECK(scene.instances.size() <= expected.instances.size());
+    }
+
+    // without interruptions the results are identical
+    for (uint32_t seed = 1; seed <= 10; ++seed) {
+        SceneBuilder builder;
+        std::mt19937 rng(seed);
+        for (int t = 0; t < 20; ++t) {
+            int transform = builder.add_transform(glm::vec3(float(t), 2.0f * float(t), 0.0f));
+            for (int p = 0, pe = 1 + int(rng() % 6); p < pe; ++p)
+                builder.add_instance(add_indexed_mesh(builder), transform);
+        }
+        Scene expected = builder.finish();
+        Scene scene = expected;
+        reference_merge_partition_instances(expected, 0);
+        InstanceMergeStats stats = merge_partition_instances(scene, 0);
+        CHECK(same_merge(scene, expected));
+        CHECK(scene.instances.size() == 20);
+        CHECK(stats.merged_instances + 20 == stats.instances);
+        CHECK(stats.merged_geometries == stats.merged_instances);
+    }
+}
+
+static void test_interleaved() {
+    // tiles that share props: the same transforms recur far apart
+    SceneBuilder builder;
+    int transforms[3];
+    for (int t = 0; t < 3; ++t)
+        transforms[t] = builder.add_transform(glm::vec3(10.0f * float(t), 0.0f, 0.0f));
+    for (int round = 0; round < 4; ++round)
+        for (int t = 0; t < 3; ++t)
+            builder.add_instance(add_indexed_mesh(builder), transforms[t]);
+    // an animated prop at the same place stays separate
+    int dynamic_mesh = add_indexed_mesh(builder, Mesh::Dynamic);
+    builder.add_instance(dynamic_mesh, transforms[0]);
+    // the same parameterized mesh twice at the same place is a duplicate
+    builder.add_instance(0, transforms[0]);
+    Scene& scene = builder.finish();
+
+    Scene expected = scene;
+    reference_merge_partition_instances(expected, 0);
+    CHECK(expected.instances.size() == 14); // nothing is consecutive
+
+    InstanceMergeStats stats = merge_partition_instances(scene, 0);
+    CHECK(scene.instances.size() == 4);
+    CHECK(stats.merged_instances == 9);
+    CHECK(stats.duplicate_instances == 1);
+    for (int t = 0; t < 3; ++t) {
+        Instance const& instance = scene.instances[t];
+        CHECK(instance.parameterized_mesh_id == t);
+        CHECK(geometry_ids(scene.meshes[t]) == std::vector<float>({ float(t), float(t + 3), float(t + 6), float(t + 9) }));
+        CHECK(scene.parameterized_meshes[t].material_offsets == std::vector<int>({ t, t + 3, t + 6, t + 9 }));
+        CHECK(scene.parameterized_meshes[t].has_overrides_applied);
+    }
+    CHECK(scene.instances[3].parameterized_mesh_id == dynamic_mesh);
+}
+
+static void test_epsilon() {
+    SceneBuilder builder;
+    int base = builder.add_transform(glm::vec3(1000.0f, 5.0f, -300.0f));
+    int near = builder.add_transform(glm::vec3(1000.004f, 5.0f, -300.003f));
+    int far = builder.add_transform(glm::vec3(1000.5f, 5.0f, -300.0f));
+    builder.add_instance(add_indexed_mesh(builder), base);
+    builder.add_instance(add_indexed_mesh(builder), far);
+    builder.add_instance(add_indexed_mesh(builder), near);
+    builder.add_instance(add_indexed_mesh(builder), base);
+    Scene& scene = builder.finish();
+
+    Scene exact = scene;
+    InstanceMergeStats stats = merge_partition_instances(exact, 0);
+    CHECK(exact.instances.size() == 3);
+    CHECK(stats.approximate_matches == 0);
+
+    // near-equal transforms across grid cell boundaries
+    for (float epsilon : { 0.01f, 0.0075f, 0.02f }) {
+        Scene approximate = scene;
+        stats = merge_partition_instances(approximate, 0, epsilon);
+        CHECK(approximate.instances.size() == 2);
+        CHECK(stats.merged_instances == 2);
+        CHECK(stats.approximate_matches == 1);
+        CHECK(geometry_ids(approximate.meshes[0]) == std::vector<float>({ 0.0f, 2.0f, 3.0f }));
+        CHECK(approximate.instances[1].transform_index == uint32_t(far));
+    }
+}
+
+static void test_first_instance() {
+    SceneBuilder builder;
+    int transform = builder.add_transform(glm::vec3(0.0f));
+    for (int i = 0; i < 4; ++i)
+        builder.add_instance(add_indexed_mesh(builder), transform);
+    Scene& scene = builder.finish();
+    // instances of earlier files are left alone
+    InstanceMergeStats stats = merge_partition_instances(scene, 2);
+    CHECK(stats.instances == 2);
+    CHECK(scene.instances.size() == 3);
+    CHECK(geometry_ids(scene.meshes[0]).size() == 1);
+    CHECK(geometry_ids(scene.meshes[2]) == std::vector<float>({ 2.0f, 3.0f }));
+}
+
+int main() {
+    test_reference();
+    test_interleaved();
+    test_epsilon();
+    test_first_instance();
+
+    return test_result();
+}
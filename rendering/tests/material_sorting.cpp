@@ -0,0 +1,280 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "mesh.h"
+#include "quantization.h"
+#include "test_util.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <vector>
+
+static mapped_vector<void> material_id_buffer(std::vector<uint32_t> const& ids, int bitcount) {
+    switch (bitcount) {
+    case 8: return mapped_vector<void>(GenericBuffer(std::vector<uint8_t>(ids.begin(), ids.end())));
+    case 16: return mapped_vector<void>(GenericBuffer(std::vector<uint16_t>(ids.begin(), ids.end())));
+    default: return mapped_vector<void>(GenericBuffer(std::vector<uint32_t>(ids)));
+    }
+}
+
+static void test_decode() {
+    std::mt19937 rng(3);
+    for (int bitcount : { 8, 16, 32 }) {
+        // odd counts exercise the loop remainders
+        for (size_t count : { size_t(0), size_t(1), size_t(37), size_t(4099) }) {
+            std::vector<uint32_t> ids(count);
+            for (auto& id : ids)
+                id = rng() >> (32 - bitcount);
+            ParameterizedMesh pm;
+            pm.triangle_material_ids = material_id_buffer(ids, bitcount);
+            pm.material_id_bitcount = bitcount;
+
+            std::vector<uint32_t> wide(count + 1, 0xdeadbeef);
+            std::vector<uint8_t> narrow(count + 1, 0xcd);
+            dequantize_material_ids(wide.data(), count, pm.triangle_material_ids.data(), uint32_t(bitcount));
+            dequantize_material_ids(narrow.data(), count, pm.triangle_material_ids.data(), uint32_t(bitcount));
+            bool same = true;
+            for (size_t i = 0; i < count; ++i)
+                same &= wide[i] == uint32_t(pm.triangle_material_id(index_t(i)))
+                    && narrow[i] == uint8_t(ids[i]);
+            CHECK(same);
+            CHECK(wide[count] == 0xdeadbeef && narrow[count] == 0xcd);
+        }
+    }
+}
+
+// Random triangles over the unit square at varying depths, with per-vertex normals and uvs
+static Geometry random_geometry(std::mt19937 &rng, int tri_count, bool indexed) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int vertex_count = indexed ? tri_count + 2 : 3 * tri_count;
+    std::vector<glm::vec3> positions(vertex_count), normals(vertex_count);
+    std::vector<glm::vec2> uvs(vertex_count);
+    std::vector<uint32_t> blend_attributes(vertex_count);
+    for (int i = 0; i < vertex_count; ++i) {
+        positions[i] = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        normals[i] = glm::normalize(glm::vec3(uniform(rng) - 0.5f, uniform(rng) - 0.5f, 1.0f));
+        uvs[i] = glm::vec2(uniform(rng), uniform(rng));
+        blend_attributes[i] = uint32_t(rng());
+    }
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals)));
+    geom.uvs = mapped_vector<void>(GenericBuffer(std::move(uvs)));
+    if (indexed) {
+        std::vector<glm::uvec3> indices(tri_count);
+        for (int i = 0; i < tri_count; ++i)
+            indices[i] = glm::uvec3(uint32_t(i), uint32_t(i + 1 + rng() % 2), uint32_t(i + 2 - (rng() % 2)));
+        geom.indices = mapped_vector<glm::uvec3>(std::move(indices));
+    }
+    else {
+        geom.format_flags = Geometry::NoIndices;
+        geom.blend_attributes = mapped_vector<uint32_t>(std::move(blend_attributes));
+    }
+    return geom;
+}
+
+struct Hit {
+    int material_id = -1;
+    glm::vec3 normal = glm::vec3(0.0f);
+    glm::vec2 uv = glm::vec2(0.0f);
+};
+
+// Material, normal and uv AOVs of rays cast down the z axis onto a grid, nearest hits first
+static std::vector<Hit> render_aovs(Mesh const& mesh, ParameterizedMesh const& pm, int resolution) {
+    std::vector<Hit> image(resolution * resolution);
+    std::vector<float> depth(image.size(), 2.0f);
+    len_t tri_base = 0;
+    for (int geo_idx = 0; geo_idx < mesh.num_geometries(); ++geo_idx) {
+        Geometry const& geom = mesh.geometries[geo_idx];
+        for (int tri = 0, tri_end = geom.num_tris(); tri < tri_end; ++tri) {
+            glm::vec3 p[3], n[3];
+            glm::vec2 t[3];
+            geom.tri_positions(tri, p[0], p[1], p[2]);
+            geom.tri_normals(tri, n[0], n[1], n[2]);
+            geom.tri_uvs(tri, t[0], t[1], t[2]);
+            int material_id = pm.material_offset(geo_idx) + pm.triangle_material_id(tri_base + tri);
+            for (int y = 0; y < resolution; ++y)
+                for (int x = 0; x < resolution; ++x) {
+                    float px = (float(x) + 0.5f) / float(resolution), py = (float(y) + 0.5f) / float(resolution);
+                    // barycentrics of the ray in the xy projection of the triangle
+                    float det = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+                    if (det == 0.0f)
+                        continue;
+                    float b1 = ((px - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (py - p[0].y)) / det;
+                    float b2 = ((p[1].x - p[0].x) * (py - p[0].y) - (px - p[0].x) * (p[1].y - p[0].y)) / det;
+                    float b0 = 1.0f - b1 - b2;
+                    if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+                        continue;
+                    float z = b0 * p[0].z + b1 * p[1].z + b2 * p[2].z;
+                    int pixel = y * resolution + x;
+                    if (z >= depth[pixel])
+                        continue;
+                    depth[pixel] = z;
+                    image[pixel].material_id = material_id;
+                    image[pixel].normal = b0 * n[0] + b1 * n[1] + b2 * n[2];
+                    image[pixel].uv = b0 * t[0] + b1 * t[1] + b2 * t[2];
+                }
+        }
+        tri_base += geom.num_tris();
+    }
+    return image;
+}
+
+static void test_sorting() {
+    std::mt19937 rng(11);
+    for (int bitcount : { 8, 16, 32 }) {
+        Mesh mesh({ random_geometry(rng, 300, false), random_geometry(rng, 200, true) });
+        ParameterizedMesh pm;
+        pm.mesh_id = 0;
+        pm.material_offsets = { 0, 100 };
+        std::vector<uint32_t> ids(mesh.num_tris());
+        for (auto& id : ids)
+            id = rng() % 13;
+        pm.triangle_material_ids = material_id_buffer(ids, bitcount);
+        pm.material_id_bitcount = bitcount;
+        std::vector<uint32_t> original_blend_attributes(mesh.geometries[0].blend_attributes.begin(), mesh.geometries[0].blend_attributes.end());
+
+        std::vector<Hit> expected = render_aovs(mesh, pm, 48);
+        ParameterizedMesh original_pm = pm;
+        Mesh original_mesh = mesh;
+        CHECK(sort_triangles_by_material(mesh, pm));
+        CHECK(pm.material_id_bitcount == bitcount);
+        CHECK(pm.num_triangle_material_ids() == len_t(ids.size()));
+
+        // material runs cover each geometry in ascending order
+        int tri_base = 0, range_idx = 0;
+        for (int geo_idx = 0; geo_idx < 2; ++geo_idx) {
+            int tri_count = mesh.geometries[geo_idx].num_tris();
+            CHECK(tri_count == original_mesh.geometries[geo_idx].num_tris());
+            int covered = 0, previous_id = -1;
+            for (; range_idx < ilen(pm.triangle_material_ranges) && pm.triangle_material_ranges[range_idx].geometry == geo_idx; ++range_idx) {
+                TriangleMaterialRange const& range = pm.triangle_material_ranges[range_idx];
+                CHECK(range.triangle_offset == covered);
+                CHECK(range.material_id > previous_id);
+                for (int i = 0; i < range.triangle_count; ++i)
+                    CHECK(pm.triangle_material_id(tri_base + range.triangle_offset + i) == range.material_id);
+                covered += range.triangle_count;
+                previous_id = range.material_id;
+            }
+            CHECK(covered == tri_count);
+            tri_base += tri_count;
+        }
+        CHECK(range_idx == ilen(pm.triangle_material_ranges));
+
+        // same triangles, attributes and materials in a different order
+        std::vector<Hit> image = render_aovs(mesh, pm, 48);
+        bool same_aovs = true;
+        int covered_pixels = 0;
+        for (size_t i = 0; i < image.size(); ++i) {
+            same_aovs &= image[i].material_id == expected[i].material_id
+                && image[i].normal == expected[i].normal && image[i].uv == expected[i].uv;
+            covered_pixels += expected[i].material_id >= 0;
+        }
+        CHECK(same_aovs);
+        CHECK(covered_pixels > 48 * 48 / 2);
+
+        // unrolled triangles carry their skinning attributes along
+        Geometry const& sorted = mesh.geometries[0];
+        Geometry const& unsorted = original_mesh.geometries[0];
+        bool same_triangles = true;
+        for (int tri = 0, cursor = 0; tri < sorted.num_tris(); ++tri) {
+            // stable order: the next unsorted triangle of the same material
+            int id = pm.triangle_material_id(tri);
+            if (tri > 0 && id != pm.triangle_material_id(tri - 1))
+                cursor = 0;
+            while (original_pm.triangle_material_id(cursor) != id)
+                ++cursor;
+            glm::vec3 a[3], b[3];
+            sorted.tri_positions(tri, a[0], a[1], a[2]);
+            unsorted.tri_positions(cursor, b[0], b[1], b[2]);
+            for (int k = 0; k < 3; ++k) {
+                same_triangles &= a[k] == b[k];
+                same_triangles &= sorted.blend_attributes.data()[3 * tri + k] == original_blend_attributes[3 * cursor + k];
+            }
+            ++cursor;
+        }
+        CHECK(same_triangles);
+        // indexed geometry keeps its vertices
+        CHECK(mesh.geometries[1].vertices.data() == original_mesh.geometries[1].vertices.data());
+    }
+}
+
+static void test_quantized() {
+    // vks layout: unrolled quantized positions, normals and uvs sharing one buffer
+    std::mt19937_64 rng(5);
+    int tri_count = 64;
+    std::vector<uint64_t> positions(3 * tri_count), normals_uvs(3 * tri_count);
+    for (int i = 0; i < 3 * tri_count; ++i) {
+        positions[i] = rng() & ((uint64_t(1) << 63) - 1);
+        normals_uvs[i] = rng();
+    }
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals_uvs)));
+    geom.uvs = geom.normals;
+    geom.quantized_scaling = glm::vec3(1.0f / float(0x200000u));
+    geom.quantized_offset = glm::vec3(0.0f);
+    geom.format_flags = Geometry::QuantizedPositions | Geometry::QuantizedNormalsAndUV | Geometry::NoIndices;
+    Mesh mesh({ geom });
+    ParameterizedMesh pm;
+    pm.mesh_id = 0;
+    pm.material_offsets = { 0 };
+    std::vector<uint32_t> ids(tri_count);
+    for (int i = 0; i < tri_count; ++i)
+        ids[i] = uint32_t(tri_count - i) / 16;
+    pm.triangle_material_ids = material_id_buffer(ids, 8);
+    pm.material_id_bitcount = 8;
+
+    CHECK(sort_triangles_by_material(mesh, pm));
+    Geometry const& sorted = mesh.geometries[0];
+    CHECK(sorted.uvs.data() == sorted.normals.data());
+    CHECK(pm.triangle_material_ranges.size() == 5);
+    // runs of 16 in reverse order, triangles within a run keep their order
+    uint32_t previous = 0;
+    for (int tri = 0; tri < tri_count; ++tri) {
+        CHECK(uint32_t(pm.triangle_material_id(tri)) >= previous);
+        previous = uint32_t(pm.triangle_material_id(tri));
+    }
+    // the lowest ID is held by the last 15 unsorted triangles, the highest only by the first one
+    int sorted_tris[2] = { 0, tri_count - 1 }, unsorted_tris[2] = { 49, 0 };
+    for (int k = 0; k < 2; ++k) {
+        glm::vec3 a[3], b[3];
+        sorted.tri_positions(sorted_tris[k], a[0], a[1], a[2]);
+        geom.tri_positions(unsorted_tris[k], b[0], b[1], b[2]);
+        CHECK(a[0] == b[0] && a[1] == b[1] && a[2] == b[2]);
+        sorted.tri_normals(sorted_tris[k], a[0], a[1], a[2]);
+        geom.tri_normals(unsorted_tris[k], b[0], b[1], b[2]);
+        CHECK(a[0] == b[0] && a[1] == b[1] && a[2] == b[2]);
+        glm::vec2 uv_a[3], uv_b[3];
+        sorted.tri_uvs(sorted_tris[k], uv_a[0], uv_a[1], uv_a[2]);
+        geom.tri_uvs(unsorted_tris[k], uv_b[0], uv_b[1], uv_b[2]);
+        CHECK(uv_a[0] == uv_b[0] && uv_a[1] == uv_b[1] && uv_a[2] == uv_b[2]);
+    }
+}
+
+static void test_unsupported() {
+    std::mt19937 rng(2);
+    Mesh mesh({ random_geometry(rng, 10, false) });
+    ParameterizedMesh pm;
+    pm.mesh_id = 0;
+    CHECK(!sort_triangles_by_material(mesh, pm)); // no per-triangle materials
+
+    // indices that refer to unrolled vertices are left alone
+    mesh.geometries[0].format_flags = Geometry::ImplicitIndices;
+    mesh.geometries[0].indices = mapped_vector<glm::uvec3>(std::vector<glm::uvec3>(10, glm::uvec3(0, 1, 2)));
+    pm.triangle_material_ids = material_id_buffer(std::vector<uint32_t>(10, 1), 32);
+    void const* vertices = mesh.geometries[0].vertices.data();
+    CHECK(!sort_triangles_by_material(mesh, pm));
+    CHECK(mesh.geometries[0].vertices.data() == vertices);
+    CHECK(pm.triangle_material_ranges.empty());
+}
+
+int main() {
+    test_decode();
+    test_sorting();
+    test_quantized();
+    test_unsupported();
+
+    return test_result();
+}
@@ -0,0 +1,261 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "meshlets.h"
+#include "mesh.h"
+#include "test_util.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+static Geometry triangle_soup(std::vector<glm::vec3> positions) {
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.format_flags = Geometry::NoIndices;
+    return geom;
+}
+
+// Unrolled quads of a size x size grid in the z = height plane, in row-major order
+static std::vector<glm::vec3> grid_triangles(int size, float height = 0.0f) {
+    std::vector<glm::vec3> positions;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x) {
+            glm::vec3 p00(float(x), float(y), height), p10(float(x + 1), float(y), height);
+            glm::vec3 p01(float(x), float(y + 1), height), p11(float(x + 1), float(y + 1), height);
+            positions.insert(positions.end(), { p00, p10, p11, p00, p11, p01 });
+        }
+    return positions;
+}
+
+// Two triangles per face, all facing outwards
+static std::vector<glm::vec3> cube_triangles() {
+    std::vector<glm::vec3> positions;
+    for (int axis = 0; axis < 3; ++axis)
+        for (int side = 0; side < 2; ++side) {
+            glm::vec3 n(0.0f), u(0.0f), v(0.0f);
+            n[axis] = side ? 1.0f : -1.0f;
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = side ? 1.0f : -1.0f;
+            glm::vec3 c = 0.5f * n;
+            glm::vec3 p0 = c - 0.5f * u - 0.5f * v, p1 = c + 0.5f * u - 0.5f * v;
+            glm::vec3 p2 = c + 0.5f * u + 0.5f * v, p3 = c - 0.5f * u + 0.5f * v;
+            positions.insert(positions.end(), { p0, p1, p2, p0, p2, p3 });
+        }
+    return positions;
+}
+
+// A bumpy surface with varying normals, in a scrambled but fixed triangle order
+static std::vector<glm::vec3> bumpy_triangles(int size) {
+    std::vector<glm::vec3> grid = grid_triangles(size);
+    for (auto& p : grid)
+        p.z = 0.25f * std::sin(1.3f * p.x) * std::cos(0.7f * p.y);
+    std::vector<glm::vec3> positions(grid.size());
+    int num_tris = int(grid.size() / 3);
+    for (int i = 0; i < num_tris; ++i) {
+        int src = int((unsigned(i) * 2654435761u) % unsigned(num_tris));
+        if (i % 7 == 0)
+            src = i; // keep some runs coherent
+        for (int j = 0; j < 3; ++j)
+            positions[3 * i + j] = grid[3 * src + j];
+    }
+    return positions;
+}
+
+static glm::vec3 triangle_normal(Geometry const& geom, int tri_idx) {
+    glm::vec3 v0, v1, v2;
+    geom.tri_positions(tri_idx, v0, v1, v2);
+    return glm::normalize(glm::cross(v1 - v0, v2 - v0));
+}
+
+// Meshlets cover all triangles in order, bound their vertices and normals
+static void check_meshlets(Geometry const& geom, std::vector<Meshlet> const& meshlets, MeshletParams const& params) {
+    uint32_t next = 0;
+    int uncovered = 0, outside = 0, outside_cone = 0, oversized = 0;
+    for (auto const& m : meshlets) {
+        uncovered += int(m.triangle_offset != next || m.triangle_count == 0);
+        oversized += int(m.triangle_count > uint32_t(params.max_triangles));
+        next = m.triangle_offset + m.triangle_count;
+        float min_alignment = m.cone_cutoff <= 1.0f ? std::sqrt(1.0f - m.cone_cutoff * m.cone_cutoff) : -1.0f;
+        for (uint32_t t = m.triangle_offset; t < next; ++t) {
+            glm::vec3 v[3];
+            geom.tri_positions(int(t), v[0], v[1], v[2]);
+            for (auto& p : v)
+                outside += int(glm::length(p - m.bounds.origin) > m.bounds.radius * 1.0001f + 1.e-5f);
+            outside_cone += int(glm::dot(triangle_normal(geom, int(t)), m.cone_axis) < min_alignment - 1.e-4f);
+        }
+    }
+    CHECK(uncovered == 0);
+    CHECK(next == uint32_t(geom.num_tris()));
+    CHECK(oversized == 0);
+    CHECK(outside == 0);
+    CHECK(outside_cone == 0);
+}
+
+static void test_grid() {
+    Geometry geom = triangle_soup(grid_triangles(16));
+    MeshletParams params;
+    std::vector<Meshlet> meshlets = build_meshlets(geom, params);
+    check_meshlets(geom, meshlets, params);
+    CHECK(meshlets.size() >= 4);
+    for (auto const& m : meshlets) {
+        // flat, so the cone collapses to the plane normal
+        CHECK(m.cone_axis.z > 0.9999f);
+        CHECK(m.cone_cutoff < 1.e-3f);
+    }
+}
+
+static void test_normal_split() {
+    Geometry geom = triangle_soup(cube_triangles());
+    MeshletParams params;
+    std::vector<Meshlet> meshlets = build_meshlets(geom, params);
+    check_meshlets(geom, meshlets, params);
+    // faces are perpendicular, beyond the default normal alignment
+    CHECK(meshlets.size() == 6);
+    for (auto const& m : meshlets)
+        CHECK(m.triangle_count == 2 && m.cone_cutoff < 1.e-3f);
+
+    // without normal splits, the whole cube has no bounding normal cone
+    params.min_normal_alignment = -1.0f;
+    meshlets = build_meshlets(geom, params);
+    check_meshlets(geom, meshlets, params);
+    CHECK(meshlets.size() == 1 && meshlets[0].cone_cutoff > 1.0f);
+}
+
+static void test_elongation() {
+    // a strip of 2 x 100 triangles
+    std::vector<glm::vec3> strip;
+    for (int x = 0; x < 100; ++x) {
+        glm::vec3 p00(float(x), 0.0f, 0.0f), p10(float(x + 1), 0.0f, 0.0f);
+        glm::vec3 p01(float(x), 1.0f, 0.0f), p11(float(x + 1), 1.0f, 0.0f);
+        strip.insert(strip.end(), { p00, p10, p11, p00, p11, p01 });
+    }
+    Geometry geom = triangle_soup(strip);
+    MeshletParams params;
+    std::vector<Meshlet> meshlets = build_meshlets(geom, params);
+    check_meshlets(geom, meshlets, params);
+    CHECK(meshlets.size() > 2);
+    for (auto const& m : meshlets)
+        CHECK(m.triangle_count >= uint32_t(params.min_triangles) || &m == &meshlets.back());
+
+    params.max_elongation = 1.e9f;
+    CHECK(build_meshlets(geom, params).size() == 2);
+}
+
+static void test_determinism() {
+    std::vector<Mesh> meshes[2];
+    for (auto& mesh_set : meshes)
+        for (int i = 0; i < 6; ++i)
+            mesh_set.push_back(Mesh({ triangle_soup(bumpy_triangles(20 + 3 * i)), triangle_soup(cube_triangles()) }));
+    build_meshlets(meshes[0], MeshletParams(), 1);
+    build_meshlets(meshes[1], MeshletParams(), 8);
+
+    int mismatches = 0;
+    for (int i = 0; i < 6; ++i)
+        for (int j = 0; j < 2; ++j) {
+            auto const& a = meshes[0][i].geometries[j].meshlets;
+            auto const& b = meshes[1][i].geometries[j].meshlets;
+            mismatches += int(a.nbytes() != b.nbytes() || std::memcmp(a.data(), b.data(), a.nbytes()) != 0);
+            std::vector<Meshlet> single = build_meshlets(meshes[0][i].geometries[j]);
+            mismatches += int(single.size() != a.size() || std::memcmp(single.data(), a.data(), a.nbytes()) != 0);
+        }
+    CHECK(mismatches == 0);
+
+    Geometry const& bumpy = meshes[0][5].geometries[0];
+    check_meshlets(bumpy, std::vector<Meshlet>(bumpy.meshlets.begin(), bumpy.meshlets.end()), MeshletParams());
+}
+
+static void test_refit() {
+    Geometry geom = triangle_soup(bumpy_triangles(12));
+    std::vector<Meshlet> meshlets = build_meshlets(geom);
+
+    std::vector<glm::vec3> moved = bumpy_triangles(12);
+    for (auto& p : moved)
+        p = glm::vec3(-p.x, p.y, p.z) + glm::vec3(5.0f, 0.0f, 0.0f); // mirrored, flips the winding
+    Geometry moved_geom = triangle_soup(moved);
+    std::vector<Meshlet> refitted = refit_meshlets(moved_geom, meshlets.data(), int(meshlets.size()));
+    CHECK(refitted.size() == meshlets.size());
+    check_meshlets(moved_geom, refitted, MeshletParams());
+    int mismatches = 0;
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        mismatches += int(refitted[i].triangle_offset != meshlets[i].triangle_offset);
+        mismatches += int(refitted[i].triangle_count != meshlets[i].triangle_count);
+        mismatches += int(std::abs(refitted[i].bounds.radius - meshlets[i].bounds.radius) > 1.e-3f);
+        mismatches += int(std::abs(refitted[i].cone_axis.z + meshlets[i].cone_axis.z) > 1.e-3f);
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_backfacing() {
+    Geometry geom = triangle_soup(bumpy_triangles(8));
+    MeshletParams params;
+    params.max_triangles = 16;
+    std::vector<Meshlet> meshlets = build_meshlets(geom, params);
+
+    Meshlet flat;
+    flat.triangle_count = 2;
+    std::vector<glm::vec3> quad = grid_triangles(1);
+    bound_triangles(quad.data(), 2, flat.bounds, flat.cone_axis, flat.cone_cutoff);
+    CHECK(meshlet_backfacing(flat, glm::vec3(0.5f, 0.5f, -1.0f)));
+    CHECK(!meshlet_backfacing(flat, glm::vec3(0.5f, 0.5f, 1.0f)));
+    CHECK(!meshlet_backfacing(flat, glm::vec3(0.5f, 0.5f, 0.0f)));
+
+    // culled meshlets must only contain triangles facing away from the eye
+    int culled = 0, wrongly_culled = 0;
+    for (int i = 0; i < 512; ++i) {
+        glm::vec3 eye(std::fmod(float(i) * 0.618034f, 1.0f) * 16.0f - 4.0f
+            , std::fmod(float(i) * 0.414214f, 1.0f) * 16.0f - 4.0f
+            , (float(i % 16) - 7.5f) * 2.0f);
+        for (auto const& m : meshlets) {
+            if (!meshlet_backfacing(m, eye))
+                continue;
+            ++culled;
+            for (uint32_t t = m.triangle_offset; t < m.triangle_offset + m.triangle_count; ++t) {
+                glm::vec3 v0, v1, v2;
+                geom.tri_positions(int(t), v0, v1, v2);
+                wrongly_culled += int(glm::dot(glm::cross(v1 - v0, v2 - v0), v0 - eye) <= 0.0f);
+            }
+        }
+    }
+    CHECK(culled > 0);
+    CHECK(wrongly_culled == 0);
+}
+
+static void test_frustum() {
+    // clip space: -w <= x, y <= w and z <= w with w = 1
+    MeshletFrustum box(glm::mat4(1.0f));
+    CHECK(!box.culls(Sphere(glm::vec3(0.0f), 0.5f)));
+    CHECK(!box.culls(Sphere(glm::vec3(1.5f, 0.0f, 0.0f), 1.0f)));
+    CHECK(box.culls(Sphere(glm::vec3(2.5f, 0.0f, 0.0f), 1.0f)));
+    CHECK(box.culls(Sphere(glm::vec3(0.0f, -2.5f, 0.0f), 1.0f)));
+    CHECK(box.culls(Sphere(glm::vec3(0.0f, 0.0f, 2.5f), 1.0f)));
+    CHECK(!MeshletFrustum(glm::mat4(1.0f), glm::vec2(0.1f)).culls(Sphere(glm::vec3(2.05f, 0.0f, 0.0f), 1.0f)));
+
+    // perspective looking down -z, w = -z, depth in [0, 1] from 0.1 to 100
+    glm::mat4 proj(1.0f);
+    proj[2] = glm::vec4(0.0f, 0.0f, -1.001f, -1.0f);
+    proj[3] = glm::vec4(0.0f, 0.0f, -0.1001f, 0.0f);
+    MeshletFrustum view(proj);
+    CHECK(!view.culls(Sphere(glm::vec3(0.0f, 0.0f, -5.0f), 1.0f)));
+    CHECK(view.culls(Sphere(glm::vec3(0.0f, 0.0f, 5.0f), 1.0f)));
+    CHECK(view.culls(Sphere(glm::vec3(8.0f, 0.0f, -5.0f), 1.0f)));
+    CHECK(!view.culls(Sphere(glm::vec3(5.5f, 0.0f, -5.0f), 1.0f)));
+    // the object-to-clip transform places the instance
+    glm::mat4 translate(1.0f);
+    translate[3] = glm::vec4(0.0f, 0.0f, -10.0f, 1.0f);
+    CHECK(!MeshletFrustum(proj * translate).culls(Sphere(glm::vec3(0.0f), 1.0f)));
+    translate[3] = glm::vec4(0.0f, 0.0f, 10.0f, 1.0f);
+    CHECK(MeshletFrustum(proj * translate).culls(Sphere(glm::vec3(0.0f), 1.0f)));
+}
+
+int main(int argc, char** argv) {
+    test_grid();
+    test_normal_split();
+    test_elongation();
+    test_determinism();
+    test_refit();
+    test_backfacing();
+    test_frustum();
+
+    return test_result();
+}
@@ -0,0 +1,195 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "neural_denoiser.h"
+#include "test_util.h"
+#include <vkr.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+template <class T>
+static VkrTensor make_tensor(std::vector<T> const& values, VkrTensorFormat format, uint64_t columns, uint64_t rows, uint64_t matrices) {
+    VkrTensor tensor = { };
+    tensor.dimensionality = 3;
+    tensor.format = format;
+    tensor.dimensions[0] = columns;
+    tensor.dimensions[1] = rows;
+    tensor.dimensions[2] = matrices;
+    tensor.numValues = values.size();
+    tensor.values = values.data();
+    tensor.dataSize = sizeof(T) * values.size();
+    return tensor;
+}
+
+static float max_relative_error(std::vector<float> const& a, std::vector<float> const& b) {
+    float max_abs = 0.0f, max_error = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        max_abs = std::max(max_abs, std::abs(b[i]));
+        max_error = std::max(max_error, std::abs(a[i] - b[i]));
+    }
+    return max_abs > 0.0f ? max_error / max_abs : max_error;
+}
+
+// two stacked 2x2 layers without biases, the first one followed by a ReLU
+static void test_plain_stack() {
+    std::vector<float> values = { 1.0f, 0.0f, 0.0f, -1.0f,   2.0f, 1.0f, 0.0f, 3.0f };
+    NeuralNetwork network(make_tensor(values, VKR_TENSOR_FORMAT_FLOAT, 2, 2, 2));
+    CHECK(network.layers.size() == 2);
+    CHECK(network.input_count() == 2 && network.output_count() == 2);
+    CHECK(network.layers[0].relu && !network.layers[1].relu);
+
+    float inputs[4] = { 3.0f, 5.0f,   -1.0f, -2.0f };
+    float outputs[4];
+    network.evaluate(inputs, outputs, 2, 1);
+    // hidden (3, 0) and (0, 2)
+    CHECK(outputs[0] == 6.0f && outputs[1] == 0.0f);
+    CHECK(outputs[2] == 2.0f && outputs[3] == 6.0f);
+}
+
+// input/output spec with two input blocks, one hidden and one transposed output block,
+// each 4x4 block holding its biases in the last column
+static void test_block_layout() {
+    int const width = 4;
+    std::vector<float> values(size_t(width) * width * 4);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = float(i);
+    VkrTensor tensor = make_tensor(values, VKR_TENSOR_FORMAT_FLOAT, width, width, 4);
+    tensor.flags = VKR_TENSOR_FLAGS_INPUT_OUTPUT_SPEC | VKR_TENSOR_FLAGS_OUTPUT_TRANSPOSED | VKR_TENSOR_FLAGS_IMPLICIT_BIASES;
+    tensor.numInputs = 5;
+    tensor.numInputLayerBlocks = 2;
+    tensor.numOutputs = 2;
+    tensor.numOutputLayerBlocks = 1;
+    NeuralNetwork network(tensor);
+    CHECK(network.layers.size() == 3);
+    CHECK(network.input_count() == 5 && network.output_count() == 2);
+
+    NeuralLayer const& input = network.layers[0];
+    CHECK(input.input_count == 5 && input.output_count == 3);
+    // input 4 is column 1 of block 1, weights are stored inputs x outputs
+    CHECK(input.weight(4, 2) == values[16 + 2 * width + 1]);
+    // biases of all input blocks add up
+    CHECK(input.biases[1] == values[1 * width + 3] + values[16 + 1 * width + 3]);
+
+    NeuralLayer const& hidden = network.layers[1];
+    CHECK(hidden.input_count == 3 && hidden.output_count == 3);
+    CHECK(hidden.weight(0, 1) == values[32 + 1 * width + 0]);
+
+    NeuralLayer const& output = network.layers[2];
+    CHECK(output.input_count == 3 && output.output_count == 2 && !output.relu);
+    // transposed: outputs vary fastest
+    CHECK(output.weight(2, 1) == values[48 + 2 * width + 1]);
+    CHECK(output.biases[1] == values[48 + 3 * width + 1]);
+
+    tensor.numInputs = 7;
+    CHECK(throws([&]() { NeuralNetwork invalid(tensor); }));
+    tensor.numInputs = 5;
+    tensor.flags |= VKR_TENSOR_FLAGS_CUSTOM_DATA_LAYOUT;
+    CHECK(throws([&]() { NeuralNetwork invalid(tensor); }));
+}
+
+template <class T>
+static VkrTensor make_random_network(std::vector<T>& values, VkrTensorFormat format, int width, int blocks
+    , int inputs, int outputs, std::mt19937& rng) {
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    values.resize(size_t(width) * width * blocks);
+    for (auto& v : values) {
+        if (format == VKR_TENSOR_FORMAT_INT8)
+            v = T(std::lround(127.0f * uniform(rng)));
+        else
+            v = T(uniform(rng) / std::sqrt(float(width)));
+    }
+    VkrTensor tensor = make_tensor(values, format, width, width, blocks);
+    tensor.flags = VKR_TENSOR_FLAGS_INPUT_OUTPUT_SPEC | VKR_TENSOR_FLAGS_IMPLICIT_BIASES;
+    tensor.numInputs = inputs;
+    tensor.numInputLayerBlocks = 1;
+    tensor.numOutputs = outputs;
+    tensor.numOutputLayerBlocks = 1;
+    tensor.ratioDescriptor = 1.0 / (127.0 * std::sqrt(double(width)));
+    return tensor;
+}
+
+static void test_tiled_evaluation() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    int const rows = 3 * NeuralNetwork::TILE_ROWS + 5;
+
+    std::vector<float> float_values;
+    NeuralNetwork float_network(make_random_network(float_values, VKR_TENSOR_FORMAT_FLOAT, 32, 4, 27, 3, rng));
+    std::vector<int8_t> int8_values;
+    NeuralNetwork int8_network(make_random_network(int8_values, VKR_TENSOR_FORMAT_INT8, 32, 4, 27, 3, rng));
+    CHECK(!float_network.quantized && int8_network.quantized);
+
+    std::vector<float> inputs(size_t(rows) * 27);
+    for (auto& v : inputs)
+        v = uniform(rng);
+    for (NeuralNetwork const* network : { &float_network, &int8_network }) {
+        std::vector<float> reference(size_t(rows) * 3), tiled(reference.size());
+        evaluate_neural_network_reference(*network, inputs.data(), reference.data(), rows);
+        NeuralProfile profile;
+        profile.reset(network->layers.size());
+        network->evaluate(inputs.data(), tiled.data(), rows, 4, &profile);
+        // int8 activations add quantization noise
+        CHECK(max_relative_error(tiled, reference) < (network->quantized ? 0.05f : 1.e-5f));
+        CHECK(profile.row_count == uint64_t(rows));
+        CHECK(profile.layer_multiply_adds[0] == uint64_t(rows) * 27 * 31);
+    }
+}
+
+static void test_denoiser() {
+    int const W = 70, H = 5;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> uniform(0.0f, 4.0f);
+    std::vector<float> color(4 * W * H), albedo(4 * W * H), normal(4 * W * H);
+    for (auto* image : { &color, &albedo, &normal })
+        for (auto& v : *image)
+            v = uniform(rng);
+    DenoiserImages images;
+    images.width = W;
+    images.height = H;
+    images.color = color.data();
+    images.albedo = albedo.data();
+    images.normal = normal.data();
+
+    // a 1x1 window network passing the color through
+    std::vector<float> identity(3 * 9, 0.0f);
+    for (int c = 0; c < 3; ++c)
+        identity[c * 9 + c] = 1.0f;
+    NeuralDenoiser passthrough(NeuralNetwork(make_tensor(identity, VKR_TENSOR_FORMAT_FLOAT, 9, 3, 1)));
+    CHECK(passthrough.window == 1);
+    std::vector<float> output(color.size());
+    passthrough.denoise(images, output.data(), 2);
+    CHECK(max_relative_error(output, color) < 1.e-5f);
+
+    // a 3x3 box filter in log space
+    std::vector<float> box(3 * 81, 0.0f);
+    for (int c = 0; c < 3; ++c)
+        for (int t = 0; t < 9; ++t)
+            box[c * 81 + t * 9 + c] = 1.0f / 9.0f;
+    NeuralDenoiser filter(NeuralNetwork(make_tensor(box, VKR_TENSOR_FORMAT_FLOAT, 81, 3, 1)));
+    CHECK(filter.window == 3);
+    filter.denoise(images, output.data());
+    for (int y : { 0, 2 }) {
+        int x = 65;
+        float expected = 0.0f;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                expected += std::log1p(color[4 * (std::max(y + dy, 0) * W + x + dx)]) / 9.0f;
+        CHECK(std::abs(output[4 * (y * W + x)] - std::expm1(expected)) < 1.e-4f);
+        CHECK(output[4 * (y * W + x) + 3] == color[4 * (y * W + x) + 3]);
+    }
+
+    std::vector<float> mismatched(3 * 10, 0.0f);
+    CHECK(throws([&]() { NeuralDenoiser invalid(NeuralNetwork(make_tensor(mismatched, VKR_TENSOR_FORMAT_FLOAT, 10, 3, 1))); }));
+}
+
+int main() {
+    printf("Testing neural network inference\n");
+    test_plain_stack();
+    test_block_layout();
+    test_tiled_evaluation();
+    test_denoiser();
+    return test_result();
+}
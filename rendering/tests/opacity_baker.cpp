@@ -0,0 +1,238 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "opacity_baker.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int const size = 64;
+
+// Foliage-like cutout: opaque left part, transparent right part, with a soft edge in
+// between and a full mip chain of box-filtered levels
+struct CutoutTexture {
+    std::vector<uint8_t> mips;
+    std::vector<size_t> offsets;
+    int levels = 0;
+
+    CutoutTexture() {
+        std::vector<uint8_t> level(4 * size * size);
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x) {
+                uint8_t a = x < 28 ? 255 : x >= 36 ? 0 : uint8_t(255 - (x - 27) * 28);
+                uint8_t* t = &level[4 * (y * size + x)];
+                t[0] = t[1] = t[2] = 128;
+                t[3] = a;
+            }
+        for (int w = size; ; w /= 2) {
+            offsets.push_back(mips.size());
+            mips.insert(mips.end(), level.begin(), level.end());
+            ++levels;
+            if (w == 1)
+                break;
+            std::vector<uint8_t> coarse(4 * (w / 2) * (w / 2));
+            for (int y = 0; y < w / 2; ++y)
+                for (int x = 0; x < w / 2; ++x)
+                    for (int c = 0; c < 4; ++c) {
+                        int sum = level[4 * (2 * y * w + 2 * x) + c] + level[4 * (2 * y * w + 2 * x + 1) + c]
+                            + level[4 * ((2 * y + 1) * w + 2 * x) + c] + level[4 * ((2 * y + 1) * w + 2 * x + 1) + c];
+                        coarse[4 * (y * (w / 2) + x) + c] = uint8_t((sum + 2) / 4);
+                    }
+            level.swap(coarse);
+        }
+    }
+
+    // bilinear lookup with repeat addressing, as done by the sampler
+    float sample(int level, float u, float v) const {
+        int w = std::max(size >> level, 1);
+        float x = u * w - 0.5f, y = v * w - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        float result = 0.0f;
+        for (int j = 0; j < 2; ++j)
+            for (int i = 0; i < 2; ++i) {
+                int tx = (int(fx) + i) % w, ty = (int(fy) + j) % w;
+                tx += tx < 0 ? w : 0;
+                ty += ty < 0 ? w : 0;
+                float weight = (i ? x - fx : 1.0f - (x - fx)) * (j ? y - fy : 1.0f - (y - fy));
+                result += weight * mips[offsets[level] + 4 * (ty * w + tx) + 3];
+            }
+        return result;
+    }
+};
+
+static CutoutTexture const& cutout() {
+    static CutoutTexture texture;
+    return texture;
+}
+
+static AlphaRangeTexture make_alpha(int max_mip_level) {
+    CutoutTexture const& t = cutout();
+    return AlphaRangeTexture(size, size, t.levels, t.mips.data(), max_mip_level);
+}
+
+static uint8_t bake_one(AlphaRangeTexture const& alpha, float const (&uvs)[6], int subdivision_level = 0) {
+    OpacityBakeParams params;
+    params.subdivision_level = subdivision_level;
+    return bake_opacity_states(alpha, uvs, 1, params)[0];
+}
+
+static void test_classification() {
+    AlphaRangeTexture alpha = make_alpha(0);
+    CHECK(alpha.levels.size() == 1);
+    CHECK(alpha.levels[0].size() == 7);
+
+    float opaque[6] = { 0.05f, 0.1f, 0.35f, 0.1f, 0.05f, 0.9f };
+    float transparent[6] = { 0.6f, 0.1f, 0.9f, 0.1f, 0.6f, 0.9f };
+    float edge[6] = { 0.3f, 0.1f, 0.7f, 0.1f, 0.3f, 0.9f };
+    CHECK(bake_one(alpha, opaque) == OPACITY_STATE_OPAQUE);
+    CHECK(bake_one(alpha, transparent) == OPACITY_STATE_TRANSPARENT);
+    CHECK(bake_one(alpha, edge) == OPACITY_STATE_UNKNOWN);
+
+    // bilinear taps reach half a texel beyond the triangle
+    float touching[6] = { 27.4f / size, 0.1f, 27.4f / size, 0.9f, 0.1f, 0.5f };
+    CHECK(bake_one(alpha, touching) == OPACITY_STATE_OPAQUE);
+    float overlapping[6] = { 27.6f / size, 0.1f, 27.6f / size, 0.9f, 0.1f, 0.5f };
+    CHECK(bake_one(alpha, overlapping) == OPACITY_STATE_UNKNOWN);
+
+    // relaxed thresholds, e.g. for a forced 0.5 alpha test
+    OpacityBakeParams params;
+    params.opaque_alpha = 128;
+    params.transparent_alpha = 127;
+    float soft_edge[6] = { 28.5f / size, 0.1f, 29.5f / size, 0.1f, 28.5f / size, 0.9f };
+    CHECK(bake_one(alpha, soft_edge) == OPACITY_STATE_UNKNOWN);
+    CHECK(bake_opacity_states(alpha, soft_edge, 1, params)[0] == OPACITY_STATE_OPAQUE);
+}
+
+static void test_repeat_addressing() {
+    AlphaRangeTexture alpha = make_alpha(0);
+    // shifted by whole periods
+    float opaque[6] = { 3.05f, -2.9f, 3.35f, -2.9f, 3.05f, -2.1f };
+    CHECK(bake_one(alpha, opaque) == OPACITY_STATE_OPAQUE);
+    // wrapping across the u = 0 border reads the transparent right edge
+    float wrapping[6] = { 0.004f, 0.1f, 0.3f, 0.1f, 0.004f, 0.9f };
+    CHECK(bake_one(alpha, wrapping) == OPACITY_STATE_UNKNOWN);
+    float transparent_wrap[6] = { 0.6f, 0.1f, 1.4f - 1.0f / size, 0.1f, 0.6f, 0.2f };
+    CHECK(bake_one(alpha, transparent_wrap) == OPACITY_STATE_UNKNOWN);
+    float transparent_span[6] = { 0.6f, 0.1f, 0.9f + 1.0f, 0.1f, 0.6f, 0.2f };
+    CHECK(bake_one(alpha, transparent_span) == OPACITY_STATE_UNKNOWN);
+    // non-finite uvs are never classified
+    float broken[6] = { NAN, 0.1f, 0.2f, 0.1f, 0.1f, 0.2f };
+    CHECK(bake_one(alpha, broken) == OPACITY_STATE_UNKNOWN);
+}
+
+static void test_subdivision() {
+    AlphaRangeTexture alpha = make_alpha(0);
+    float edge[6] = { 0.1f, 0.1f, 0.8f, 0.1f, 0.1f, 0.8f };
+    OpacityBakeParams params;
+    params.subdivision_level = 3;
+    std::vector<uint8_t> micro;
+    auto states = bake_opacity_states(alpha, edge, 1, params, &micro);
+    CHECK(states[0] == OPACITY_STATE_UNKNOWN);
+    CHECK(micro.size() == 64);
+    int known = 0;
+    for (uint8_t s : micro)
+        known += s != OPACITY_STATE_UNKNOWN;
+    CHECK(known > 32);
+    // the first micro-triangle sits at the opaque corner t0, the last at t2
+    CHECK(micro.front() == OPACITY_STATE_OPAQUE);
+    CHECK(micro.back() == OPACITY_STATE_OPAQUE);
+    // the micro-triangle next to t1 at the far end of row 0 is transparent
+    CHECK(micro[2 * 8 - 2] == OPACITY_STATE_TRANSPARENT);
+
+    // triangles agree with their micro-triangles
+    float opaque[6] = { 0.05f, 0.1f, 0.35f, 0.1f, 0.05f, 0.9f };
+    CHECK(bake_opacity_states(alpha, opaque, 1, params)[0] == OPACITY_STATE_OPAQUE);
+}
+
+static void test_mip_levels() {
+    // coarser mips blur the edge into the opaque region
+    float near_edge[6] = { 22.0f / size, 0.1f, 26.0f / size, 0.1f, 22.0f / size, 0.9f };
+    CHECK(bake_one(make_alpha(0), near_edge) == OPACITY_STATE_OPAQUE);
+    CHECK(bake_one(make_alpha(3), near_edge) == OPACITY_STATE_UNKNOWN);
+    CHECK(make_alpha(3).levels.size() == 4);
+    CHECK(make_alpha(100).levels.size() == size_t(cutout().levels));
+}
+
+// known states never contradict filtered lookups inside the triangles
+static void test_conservative() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int const max_mip_level = 2;
+    AlphaRangeTexture alpha = make_alpha(max_mip_level);
+    int const triangle_count = 2000;
+    std::vector<float> uvs(6 * triangle_count);
+    for (int t = 0; t < triangle_count; ++t) {
+        float cu = 4.0f * uniform(rng) - 2.0f, cv = 4.0f * uniform(rng) - 2.0f;
+        float extent = 0.2f * uniform(rng) * uniform(rng);
+        for (int k = 0; k < 3; ++k) {
+            uvs[6 * t + 2 * k] = cu + extent * (2.0f * uniform(rng) - 1.0f);
+            uvs[6 * t + 2 * k + 1] = cv + extent * (2.0f * uniform(rng) - 1.0f);
+        }
+    }
+    OpacityBakeParams params;
+    params.max_mip_level = max_mip_level;
+    params.subdivision_level = 2;
+    std::vector<uint8_t> micro;
+    auto states = bake_opacity_states(alpha, uvs.data(), triangle_count, params, &micro);
+
+    int known = 0, contradictions = 0;
+    for (int t = 0; t < triangle_count; ++t) {
+        known += states[t] != OPACITY_STATE_UNKNOWN;
+        float const* uv = &uvs[6 * t];
+        for (int s = 0; s < 64; ++s) {
+            float b1 = uniform(rng), b2 = uniform(rng);
+            if (b1 + b2 > 1.0f) {
+                b1 = 1.0f - b1;
+                b2 = 1.0f - b2;
+            }
+            float u = uv[0] + (uv[2] - uv[0]) * b1 + (uv[4] - uv[0]) * b2;
+            float v = uv[1] + (uv[3] - uv[1]) * b1 + (uv[5] - uv[1]) * b2;
+            for (int level = 0; level <= max_mip_level; ++level) {
+                float a = cutout().sample(level, u, v);
+                contradictions += states[t] == OPACITY_STATE_OPAQUE && a < 254.99f;
+                contradictions += states[t] == OPACITY_STATE_TRANSPARENT && a > 0.01f;
+            }
+            // micro-triangle containing the sample
+            int n = 4;
+            int i = std::min(int(b1 * n), n - 1), j = std::min(int(b2 * n), n - 1 - i);
+            bool inverted = b1 * n - i + b2 * n - j > 1.0f && i + j < n - 1;
+            int index = 0;
+            for (int r = 0; r < j; ++r)
+                index += 2 * (n - r) - 1;
+            index += 2 * i + (inverted ? 1 : 0);
+            uint8_t state = micro[size_t(t) * 16 + index];
+            for (int level = 0; level <= max_mip_level; ++level) {
+                float a = cutout().sample(level, u, v);
+                contradictions += state == OPACITY_STATE_OPAQUE && a < 254.99f;
+                contradictions += state == OPACITY_STATE_TRANSPARENT && a > 0.01f;
+            }
+        }
+    }
+    CHECK(contradictions == 0);
+    CHECK(known > triangle_count / 4);
+}
+
+static void test_packing() {
+    std::vector<uint8_t> states(37);
+    for (size_t i = 0; i < states.size(); ++i)
+        states[i] = uint8_t(i * 7 % 3);
+    auto packed = pack_opacity_states(states.data(), states.size());
+    CHECK(packed.size() == 3);
+    bool round_trip = true;
+    for (size_t i = 0; i < states.size(); ++i)
+        round_trip &= glsl::unpack_opacity_state(packed[i / OPACITY_STATES_PER_WORD], uint32_t(i)) == states[i];
+    CHECK(round_trip);
+    CHECK(pack_opacity_states(states.data(), 0).empty());
+}
+
+int main() {
+    test_classification();
+    test_repeat_addressing();
+    test_subdivision();
+    test_mip_levels();
+    test_conservative();
+    test_packing();
+    return test_result();
+}
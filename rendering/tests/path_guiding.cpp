@@ -0,0 +1,238 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "path_guiding.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static float const pi = 3.14159265358979323846f;
+
+// Interior lit through a small opening: bright radiance from a narrow cone around the
+// window direction, which changes with the position along x, and a dim ambient term
+static float window_radiance(float const (&p)[3], float const (&d)[3]) {
+    float window[3] = { 0.0f, 0.0f, 1.0f };
+    if (p[0] >= 0.5f) {
+        window[1] = 1.0f;
+        window[2] = 0.0f;
+    }
+    float cos_angle = d[0] * window[0] + d[1] * window[1] + d[2] * window[2];
+    return cos_angle > 0.95f ? 20.0f : 0.05f;
+}
+
+// trains with directions sampled uniformly, as by a path tracer without guiding
+static void train(PathGuidingField& field, std::mt19937& rng, int iterations, int samples_per_iteration) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<glsl::PathGuidingSample> samples(samples_per_iteration);
+    for (int i = 0; i < iterations; ++i) {
+        for (auto& s : samples) {
+            float p[3] = { uniform(rng), uniform(rng), uniform(rng) };
+            float d[3];
+            uniform_direction(rng, d);
+            s = { p[0], p[1], p[2], d[0], d[1], d[2], window_radiance(p, d), 1.0f / (4.0f * pi) };
+        }
+        field.add_samples(samples.data(), samples.size());
+        field.refine_and_fit();
+    }
+}
+
+static PathGuidingField make_field(PathGuidingConfig const& config = PathGuidingConfig()) {
+    PathGuidingField field(config);
+    float lower[3] = { 0.0f, 0.0f, 0.0f };
+    float upper[3] = { 1.0f, 1.0f, 1.0f };
+    field.reset(lower, upper);
+    return field;
+}
+
+static void test_direction_bins() {
+    std::mt19937 rng(5);
+    // bins are of equal area
+    int const count = 128 * 2000;
+    std::vector<int> histogram(PATH_GUIDING_BINS, 0);
+    for (int i = 0; i < count; ++i) {
+        float d[3];
+        uniform_direction(rng, d);
+        int bin = glsl::path_guiding_direction_bin(d[0], d[1], d[2]);
+        CHECK(bin >= 0 && bin < PATH_GUIDING_BINS);
+        if (bin >= 0 && bin < PATH_GUIDING_BINS)
+            ++histogram[bin];
+    }
+    int expected = count / PATH_GUIDING_BINS;
+    bool equal_area = true;
+    for (int h : histogram)
+        equal_area &= std::abs(h - expected) < expected / 6;
+    CHECK(equal_area);
+
+    // directions generated within a bin map back to the bin
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    bool round_trip = true;
+    for (int i = 0; i < 10000; ++i) {
+        int bin = int(rng() % PATH_GUIDING_BINS);
+        float cos_theta = glsl::path_guiding_bin_cos_theta(bin, 0.001f + 0.998f * uniform(rng));
+        float phi = glsl::path_guiding_bin_phi(bin, 0.001f + 0.998f * uniform(rng));
+        float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+        round_trip &= glsl::path_guiding_direction_bin(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta) == bin;
+    }
+    CHECK(round_trip);
+}
+
+static void test_sampling_matches_pdf() {
+    std::mt19937 rng(7);
+    PathGuidingField field = make_field();
+    train(field, rng, 4, 20000);
+
+    int cell = field.lookup_cell(0.25f, 0.5f, 0.5f);
+    CHECK(cell >= 0);
+    // densities integrate to one over the sphere
+    double integral = 0.0;
+    int const integration_samples = 200000;
+    for (int i = 0; i < integration_samples; ++i) {
+        float d[3];
+        uniform_direction(rng, d);
+        integral += field.pdf(cell, d[0], d[1], d[2]) * 4.0 * pi / integration_samples;
+    }
+    CHECK(std::abs(integral - 1.0) < 0.02);
+
+    // sampled directions follow the density
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int const count = 400000;
+    std::vector<int> histogram(PATH_GUIDING_BINS, 0);
+    int inconsistent_pdfs = 0;
+    for (int i = 0; i < count; ++i) {
+        float d[3];
+        float pdf = field.sample(cell, uniform(rng), uniform(rng), uniform(rng), d);
+        // note: directions on bin boundaries may round into the neighboring bin
+        inconsistent_pdfs += std::abs(pdf - field.pdf(cell, d[0], d[1], d[2])) > 1.e-4f * pdf;
+        ++histogram[glsl::path_guiding_direction_bin(d[0], d[1], d[2])];
+    }
+    CHECK(inconsistent_pdfs < count / 10000);
+    bool matches = true;
+    for (int b = 0; b < PATH_GUIDING_BINS; ++b) {
+        float const* cdf = &field.cdfs[size_t(cell) * PATH_GUIDING_BINS];
+        double expected = (cdf[b] - (b > 0 ? cdf[b - 1] : 0.0f)) * count;
+        matches &= std::abs(histogram[b] - expected) < 5.0 * std::sqrt(expected) + 2.0;
+    }
+    CHECK(matches);
+}
+
+static void test_spatial_refinement() {
+    std::mt19937 rng(11);
+    PathGuidingField field = make_field();
+    train(field, rng, 6, 50000);
+    CHECK(field.cells.size() > 2);
+    CHECK(field.nodes.size() == 2 * field.cells.size() - 1);
+
+    // each side learned the direction of its own window
+    float up[3] = { 0.0f, 0.0f, 1.0f };
+    float side[3] = { 0.0f, 1.0f, 0.0f };
+    int left = field.lookup_cell(0.25f, 0.5f, 0.5f);
+    int right = field.lookup_cell(0.75f, 0.5f, 0.5f);
+    CHECK(left != right);
+    CHECK(field.pdf(left, up[0], up[1], up[2]) > 10.0f * field.pdf(left, side[0], side[1], side[2]));
+    CHECK(field.pdf(right, side[0], side[1], side[2]) > 10.0f * field.pdf(right, up[0], up[1], up[2]));
+    // the uniform fraction keeps all directions reachable
+    float down[3] = { 0.0f, 0.0f, -1.0f };
+    CHECK(field.pdf(left, down[0], down[1], down[2]) >= 0.9f * field.config.uniform_fraction / (4.0f * pi));
+}
+
+static void test_variance_reduction() {
+    std::mt19937 rng(13);
+    PathGuidingField field = make_field();
+    train(field, rng, 6, 50000);
+
+    // irradiance-like integral of the incident radiance at a point, estimated by
+    // uniform sampling and by one-sample MIS of the guiding field and uniform sampling
+    float p[3] = { 0.3f, 0.6f, 0.4f };
+    int cell = field.lookup_cell(p[0], p[1], p[2]);
+    float const selection_probability = 0.7f;
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    int const count = 100000;
+    double uniform_sum = 0.0, uniform_sum_sq = 0.0;
+    double guided_sum = 0.0, guided_sum_sq = 0.0;
+    for (int i = 0; i < count; ++i) {
+        float d[3];
+        uniform_direction(rng, d);
+        double estimate = window_radiance(p, d) * 4.0 * pi;
+        uniform_sum += estimate;
+        uniform_sum_sq += estimate * estimate;
+
+        if (uniform(rng) < selection_probability)
+            field.sample(cell, uniform(rng), uniform(rng), uniform(rng), d);
+        else
+            uniform_direction(rng, d);
+        double mixture_pdf = selection_probability * field.pdf(cell, d[0], d[1], d[2])
+            + (1.0f - selection_probability) / (4.0 * pi);
+        estimate = window_radiance(p, d) / mixture_pdf;
+        guided_sum += estimate;
+        guided_sum_sq += estimate * estimate;
+    }
+    double uniform_mean = uniform_sum / count, guided_mean = guided_sum / count;
+    double uniform_variance = uniform_sum_sq / count - uniform_mean * uniform_mean;
+    double guided_variance = guided_sum_sq / count - guided_mean * guided_mean;
+    // both are unbiased, guiding needs a fraction of the samples
+    CHECK(std::abs(guided_mean - uniform_mean) < 0.03 * uniform_mean);
+    CHECK(guided_variance < 0.25 * uniform_variance);
+}
+
+static void test_cell_budget() {
+    std::mt19937 rng(17);
+    PathGuidingConfig config;
+    config.max_cells = 16;
+    config.split_sample_count = 100.0f;
+    PathGuidingField field = make_field(config);
+    train(field, rng, 3, 20000);
+    CHECK(field.cells.size() == 16);
+    CHECK(field.nodes.size() == 31);
+
+    // points are found in the leaf whose region contains them
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    bool contained = true;
+    for (int i = 0; i < 1000; ++i) {
+        float p[3] = { uniform(rng), uniform(rng), uniform(rng) };
+        int cell = field.lookup_cell(p[0], p[1], p[2]);
+        auto const& region = field.regions[field.cells[cell].node];
+        for (int k = 0; k < 3; ++k)
+            contained &= p[k] >= region.lower[k] && p[k] <= region.upper[k];
+    }
+    CHECK(contained);
+
+    // invalid samples are ignored
+    uint64_t samples_before = field.iteration_samples;
+    glsl::PathGuidingSample invalid[] = {
+        { 0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, NAN, 1.0f },
+        { 0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f },
+        { 0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, -1.0f, 1.0f },
+        { INFINITY, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f },
+    };
+    field.add_samples(invalid, sizeof(invalid) / sizeof(invalid[0]));
+    CHECK(field.iteration_samples == samples_before);
+}
+
+static void test_gpu_buffer() {
+    std::mt19937 rng(19);
+    PathGuidingField field = make_field();
+    train(field, rng, 3, 20000);
+    std::vector<unsigned char> buffer(PathGuidingField::gpu_buffer_size());
+    field.write_gpu_buffer(buffer.data());
+    auto header = (glsl::PathGuidingFieldHeader const*) buffer.data();
+    auto nodes = (glsl::PathGuidingNode const*) (header + 1);
+    auto cdfs = (float const*) (nodes + PATH_GUIDING_MAX_NODES);
+    CHECK(header->node_count == field.nodes.size());
+    CHECK(header->cell_count == field.cells.size());
+    CHECK(header->iteration == 3);
+    int last = int(field.cells.size()) - 1;
+    CHECK(nodes[field.nodes.size() - 1].cell == field.nodes.back().cell);
+    CHECK(cdfs[(last + 1) * PATH_GUIDING_BINS - 1] == 1.0f);
+}
+
+int main() {
+    test_direction_bins();
+    test_sampling_matches_pdf();
+    test_spatial_refinement();
+    test_variance_reduction();
+    test_cell_budget();
+    test_gpu_buffer();
+    return test_result();
+}
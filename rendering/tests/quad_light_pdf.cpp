@@ -0,0 +1,257 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include <glm/glm.hpp>
+#include "lights.h"
+#include "scene.h"
+#include "test_util.h"
+
+namespace shaders_quad {
+
+using namespace glm;
+#include "../language.hpp"
+#include "../defaults.glsl"
+#include "../util.glsl"
+#include "../lights/tri.glsl"
+#include "../lights/quad.glsl"
+
+uint32_t const global_num_quad_lights = 3;
+TriLightData quad_lights[global_num_quad_lights] = {};
+
+#define SCENE_GET_QUAD_LIGHT_SOURCE(light_id) decode_tri_light(quad_lights[light_id])
+#define SCENE_GET_QUAD_LIGHT_SOURCE_COUNT()   int(global_num_quad_lights)
+
+#define BINNED_LIGHTS_BIN_MAX_SIZE 2
+#define BINNED_LIGHTS_BIN_SIZE 2
+#include "../mc/lights_quad.glsl"
+
+}
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+static std::mt19937 rng(42);
+static float next_randf() {
+    return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+}
+
+static bool close_to(double value, double reference, double rel_tolerance) {
+    return std::abs(value - reference) <= rel_tolerance * std::abs(reference);
+}
+
+struct QuadSetup {
+    glm::vec3 corner, e_x, e_y, p;
+};
+
+static QuadSetup const test_quads[] = {
+    { glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f) }, // centered above
+    { glm::vec3(0.5f, 0.2f, 0.3f), glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(0.0f) }, // close, off-center
+    { glm::vec3(10.0f, -2.0f, 1.0f), glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f) }, // distant, oblique
+    { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.6f, 0.8f, 0.0f), glm::vec3(-0.8f, 0.6f, 0.0f), glm::vec3(0.1f, 0.2f, 0.0f) }, // rotated, below
+};
+
+// integral of cos / r^2 over the quad area
+static double area_solid_angle(QuadSetup const& q, int sample_count) {
+    glm::vec3 n = glm::normalize(glm::cross(q.e_x, q.e_y));
+    double area = glm::length(glm::cross(q.e_x, q.e_y));
+    double sum = 0.0;
+    for (int i = 0; i < sample_count; ++i) {
+        glm::vec3 x = q.corner + next_randf() * q.e_x + next_randf() * q.e_y;
+        glm::vec3 d = x - q.p;
+        float dist2 = glm::dot(d, d);
+        sum += std::abs(glm::dot(n, d)) / (dist2 * std::sqrt(dist2));
+    }
+    return sum * area / double(sample_count);
+}
+
+int test_solid_angle() {
+    using namespace shaders_quad;
+    int failed = 0;
+    for (auto& q : test_quads) {
+        SphericalQuad squad = init_spherical_quad(q.corner, q.e_x, q.e_y, q.p);
+        double reference = area_solid_angle(q, 1 << 20);
+        if (!close_to(squad.S, reference, 0.01)) {
+            printf("solid angle %f, expected %f\n", squad.S, reference);
+            ++failed;
+        }
+    }
+    // quads seen edge-on cover no solid angle
+    SphericalQuad edge_on = init_spherical_quad(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f));
+    if (edge_on.S != 0.0f) {
+        printf("edge-on solid angle %f, expected 0\n", edge_on.S);
+        ++failed;
+    }
+    return failed;
+}
+
+// samples must be uniform in solid angle: the fraction landing in each cell of
+// the quad has to match the solid angle of the cell relative to the full quad
+int test_sample_distribution() {
+    using namespace shaders_quad;
+    const int cells = 4;
+    const int sample_count = 1 << 20;
+    int failed = 0;
+    for (auto& q : test_quads) {
+        SphericalQuad squad = init_spherical_quad(q.corner, q.e_x, q.e_y, q.p);
+
+        std::vector<int> histogram(cells * cells);
+        float ex_len2 = glm::dot(q.e_x, q.e_x), ey_len2 = glm::dot(q.e_y, q.e_y);
+        glm::vec3 n = glm::normalize(glm::cross(q.e_x, q.e_y));
+        for (int i = 0; i < sample_count; ++i) {
+            glm::vec3 x = sample_spherical_quad(squad, glm::vec2(next_randf(), next_randf()));
+            glm::vec3 rel = x - q.corner;
+            float u = glm::dot(rel, q.e_x) / ex_len2;
+            float v = glm::dot(rel, q.e_y) / ey_len2;
+            if (!(u > -1.e-3f && u < 1.0f + 1.e-3f && v > -1.e-3f && v < 1.0f + 1.e-3f && std::abs(glm::dot(rel, n)) < 1.e-3f)) {
+                printf("sample (%f %f %f) not on quad\n", x.x, x.y, x.z);
+                return failed + 1;
+            }
+            int cu = glm::clamp(int(u * cells), 0, cells - 1);
+            int cv = glm::clamp(int(v * cells), 0, cells - 1);
+            ++histogram[cv * cells + cu];
+        }
+
+        for (int cv = 0; cv < cells; ++cv)
+            for (int cu = 0; cu < cells; ++cu) {
+                glm::vec3 cell_corner = q.corner + (float(cu) / cells) * q.e_x + (float(cv) / cells) * q.e_y;
+                SphericalQuad cell = init_spherical_quad(cell_corner, q.e_x / float(cells), q.e_y / float(cells), q.p);
+                double expected = double(cell.S) / double(squad.S);
+                double measured = double(histogram[cv * cells + cu]) / double(sample_count);
+                // allow for 4 standard deviations of the binomial cell counts
+                double tolerance = 4.0 * std::sqrt(expected * (1.0 - expected) / double(sample_count)) + 1.e-4;
+                if (!(std::abs(measured - expected) <= tolerance)) {
+                    printf("cell %d %d: %f of samples, expected %f\n", cu, cv, measured, expected);
+                    ++failed;
+                }
+            }
+    }
+    return failed;
+}
+
+// Scene fixture with two lit quads, one facing away from the origin,
+// and two that emit nothing and are dropped when the emitters are collected
+static Scene make_quad_light_scene() {
+    QuadLight light = { };
+    light.position = glm::vec3(0.0f, 0.0f, 2.0f);
+    light.normal = glm::vec3(0.0f, 0.0f, -1.0f);
+    light.v_x = glm::vec3(1.0f, 0.0f, 0.0f); light.width = 1.0f;
+    light.v_y = glm::vec3(0.0f, 1.0f, 0.0f); light.height = 0.5f;
+    light.emission = glm::vec3(2.0f);
+
+    Scene scene;
+    scene.quadLights.push_back(light);
+    QuadLight black = light;
+    black.emission = glm::vec3(0.0f);
+    scene.quadLights.push_back(black);
+    scene.quadLights.push_back(light);
+    scene.quadLights.back().position = glm::vec3(3.0f, 0.0f, 1.0f);
+    scene.quadLights.back().emission = glm::vec3(10.0f, 1.0f, 1.0f);
+    QuadLight degenerate = light;
+    degenerate.height = 0.0f;
+    scene.quadLights.push_back(degenerate);
+    // facing away from the shading point
+    scene.quadLights.push_back(light);
+    scene.quadLights.back().position = glm::vec3(0.0f, 0.0f, 1.0f);
+    scene.quadLights.back().normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    scene.quadLights.back().emission = glm::vec3(100.0f);
+    return scene;
+}
+
+// quad lights of a scene are uploaded in tri light layout, mixed with tri emitters by power
+int test_scene_quad_lights() {
+    using namespace shaders_quad;
+    Scene scene = make_quad_light_scene();
+    std::vector<TriLight> emitters = collect_quad_emitters(scene);
+    if (emitters.size() != 3) {
+        printf("%d quad emitters, expected 3\n", int(emitters.size()));
+        return 1;
+    }
+    int failed = 0;
+    int const lit[] = { 0, 2, 4 };
+    for (int i = 0; i < 3; ++i) {
+        QuadLight const& light = scene.quadLights[lit[i]];
+        glm::vec3 e_x = emitters[i].v1 - emitters[i].v0, e_y = emitters[i].v2 - emitters[i].v0;
+        glm::vec3 center = emitters[i].v0 + 0.5f * (e_x + e_y);
+        if (!(glm::length(center - light.position) < 1.e-5f && glm::dot(glm::cross(e_x, e_y), light.normal) > 0.0f
+            && std::abs(glm::length(glm::cross(e_x, e_y)) - 4.0f * light.width * light.height) < 1.e-5f)) {
+            printf("quad emitter %d does not match its light\n", i);
+            ++failed;
+        }
+    }
+
+    // a tri emitter of equal power is selected as often as the quad lights
+    double quad_power = 0.0;
+    for (auto& e : emitters)
+        quad_power += luminance(e.radiance) * glm::length(glm::cross(e.v1 - e.v0, e.v2 - e.v0));
+    TriLight tri = { };
+    tri.v1 = glm::vec3(2.0f, 0.0f, 0.0f);
+    tri.v2 = glm::vec3(0.0f, 1.0f, 0.0f);
+    tri.radiance = glm::vec3(float(quad_power));
+    float p_mixed = quad_light_selection_probability(emitters, { tri });
+    float p_quads = quad_light_selection_probability(emitters, { });
+    float p_tris = quad_light_selection_probability({ }, { tri });
+    if (!(std::abs(p_mixed - 0.5f) < 1.e-3f && p_quads == 1.0f && p_tris == 0.0f)) {
+        printf("quad light selection probabilities %f %f %f, expected 0.5 1 0\n", p_mixed, p_quads, p_tris);
+        ++failed;
+    }
+    return failed;
+}
+
+// NEE estimates of irradiance from multiple quad lights have to match area sampling
+int test_light_selection() {
+    using namespace shaders_quad;
+    std::vector<TriLight> emitters = collect_quad_emitters(make_quad_light_scene());
+    if (emitters.size() != global_num_quad_lights)
+        return 1;
+    for (uint32_t i = 0; i < global_num_quad_lights; ++i)
+        std::memcpy(&quad_lights[i], &emitters[i], sizeof(quad_lights[i]));
+
+    const glm::vec3 p(0.0f), n(0.0f, 0.0f, 1.0f);
+    const int sample_count = 1 << 20;
+
+    double reference = 0.0;
+    for (uint32_t i = 0; i < 2; ++i) {
+        TriLight light = decode_tri_light(quad_lights[i]);
+        QuadSetup q = { light.v0, light.v1 - light.v0, light.v2 - light.v0, p };
+        glm::vec3 ln = glm::normalize(glm::cross(q.e_x, q.e_y));
+        double area = glm::length(glm::cross(q.e_x, q.e_y));
+        double sum = 0.0;
+        for (int j = 0; j < sample_count; ++j) {
+            glm::vec3 x = q.corner + next_randf() * q.e_x + next_randf() * q.e_y;
+            glm::vec3 d = x - p;
+            float dist2 = glm::dot(d, d);
+            glm::vec3 w = d / std::sqrt(dist2);
+            sum += std::max(glm::dot(w, n), 0.0f) * std::max(glm::dot(-w, ln), 0.0f) / dist2;
+        }
+        reference += luminance(light.radiance) * sum * area / double(sample_count);
+    }
+
+    double estimate = 0.0;
+    for (int j = 0; j < sample_count; ++j) {
+        glm::vec3 light_dir;
+        float light_dist, pdf;
+        glm::vec3 contrib = sample_quad_lights(p, n, glm::vec2(next_randf(), next_randf()), glm::vec2(next_randf(), next_randf()), light_dir, light_dist, pdf);
+        if (pdf > 0.0f)
+            estimate += luminance(contrib) * std::max(glm::dot(light_dir, n), 0.0f);
+    }
+    estimate /= double(sample_count);
+
+    if (!close_to(estimate, reference, 0.01)) {
+        printf("irradiance %f, expected %f\n", estimate, reference);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    printf("Testing spherical quad solid angles\n");
+    num_failed += test_solid_angle();
+    printf("Testing spherical quad sample distribution\n");
+    num_failed += test_sample_distribution();
+    printf("Testing scene quad lights\n");
+    num_failed += test_scene_quad_lights();
+    printf("Testing quad light selection\n");
+    num_failed += test_light_selection();
+    return test_result();
+}
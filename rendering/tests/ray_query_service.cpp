@@ -0,0 +1,203 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "librender/ray_query_service.h"
+#include "libdatacapture/test_scene.h"
+#include "test_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace rt_datacapture;
+
+// Echoes the query origins, submissions complete after a number of polls
+struct EchoSlots : RayQuerySlots {
+    struct Slot {
+        std::vector<RenderRayQuery> queries;
+        int polls_left = 0;
+        bool pending = false;
+    };
+    std::vector<Slot> slots;
+    int capacity;
+    int poll_delay;
+    int pending_count = 0;
+    int max_pending = 0;
+    bool errors = false;
+    int failing_read = -1; // index of the readback that throws
+    int reads = 0;
+
+    EchoSlots(int slot_count, int capacity, int poll_delay)
+        : slots(slot_count), capacity(capacity), poll_delay(poll_delay) { }
+
+    int slot_count() const override { return (int) slots.size(); }
+    int slot_capacity() const override { return capacity; }
+    void submit(int slot, RenderRayQuery const* queries, int num_queries) override {
+        errors |= slots[slot].pending || num_queries < 1 || num_queries > capacity;
+        slots[slot].queries.assign(queries, queries + num_queries);
+        slots[slot].polls_left = poll_delay;
+        slots[slot].pending = true;
+        max_pending = std::max(max_pending, ++pending_count);
+    }
+    bool poll(int slot, bool wait) override {
+        if (wait)
+            slots[slot].polls_left = 0;
+        return slots[slot].polls_left-- <= 0;
+    }
+    void read_results(int slot, glm::vec4* results, int num_queries) override {
+        errors |= !slots[slot].pending || num_queries != (int) slots[slot].queries.size();
+        if (reads++ == failing_read) {
+            slots[slot].pending = false;
+            --pending_count;
+            throw std::runtime_error("readback failed");
+        }
+        for (int i = 0; i < num_queries; ++i)
+            results[i] = glm::vec4(slots[slot].queries[i].origin, 1.0f);
+        slots[slot].pending = false;
+        --pending_count;
+    }
+};
+
+static std::vector<RenderRayQuery> numbered_queries(int count) {
+    std::vector<RenderRayQuery> queries(count);
+    for (int i = 0; i < count; ++i) {
+        queries[i].origin = glm::vec3(float(i), 0.0f, 0.0f);
+        queries[i].mode_or_data = 0;
+        queries[i].dir = glm::vec3(0.0f, 1.0f, 0.0f);
+        queries[i].t_max = 1.0f;
+    }
+    return queries;
+}
+
+static void test_chunking() {
+    int const capacity = 100;
+    // empty, partial, exact and many-chunk jobs
+    std::vector<int> job_sizes = { 0, 1, capacity, 5 * capacity + 37, 0, 3 };
+    std::vector<std::vector<RenderRayQuery>> queries;
+    std::vector<std::vector<glm::vec4>> results;
+    for (int size : job_sizes) {
+        queries.push_back(numbered_queries(size));
+        results.push_back(std::vector<glm::vec4>(size, glm::vec4(-1.0f)));
+    }
+
+    EchoSlots* slots = new EchoSlots(3, capacity, 2);
+    RayQueryService service((std::unique_ptr<RayQuerySlots>(slots)));
+    std::vector<int> completed;
+    std::vector<std::future<void>> futures;
+    for (size_t j = 0; j < job_sizes.size(); ++j)
+        futures.push_back(service.trace(queries[j].data(), queries[j].size(), results[j].data()
+            , [&completed, j]() { completed.push_back(int(j)); }));
+    CHECK(service.chunks_in_flight() == 3);
+
+    int pumps = 0;
+    while (service.pump() > 0 && pumps < 1000)
+        ++pumps;
+    CHECK(pumps > 1); // completion needs several non-blocking pumps
+    CHECK(!slots->errors);
+    CHECK(slots->pending_count == 0);
+    CHECK(slots->max_pending == 3);
+
+    CHECK(completed.size() == job_sizes.size());
+    for (size_t j = 0; j < completed.size(); ++j)
+        CHECK(completed[j] == int(j));
+    for (auto& f : futures)
+        CHECK(f.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+
+    bool echoed = true;
+    for (size_t j = 0; j < job_sizes.size(); ++j)
+        for (int i = 0; i < job_sizes[j]; ++i)
+            echoed &= results[j][i] == glm::vec4(float(i), 0.0f, 0.0f, 1.0f);
+    CHECK(echoed);
+
+    auto const& stats = service.stats();
+    CHECK(stats.jobs == job_sizes.size());
+    CHECK(stats.queries == uint64_t(1 + capacity + 5 * capacity + 37 + 3));
+    CHECK(stats.chunks == uint64_t(1 + 1 + 6 + 1));
+    CHECK(stats.max_chunks_in_flight == 3);
+
+    // finish blocks until later jobs are done
+    auto more = numbered_queries(10 * capacity);
+    std::vector<glm::vec4> more_results(more.size());
+    auto future = service.trace(more.data(), more.size(), more_results.data());
+    service.finish();
+    CHECK(future.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    CHECK(more_results.back() == glm::vec4(float(more.size() - 1), 0.0f, 0.0f, 1.0f));
+    CHECK(service.pump() == 0);
+}
+
+static void test_failed_readback() {
+    int const capacity = 10;
+    auto failing = numbered_queries(6 * capacity);
+    auto next = numbered_queries(2 * capacity);
+    std::vector<glm::vec4> failing_results(failing.size()), next_results(next.size());
+
+    EchoSlots* slots = new EchoSlots(2, capacity, 1);
+    slots->failing_read = 1;
+    RayQueryService service((std::unique_ptr<RayQuerySlots>(slots)));
+    std::vector<int> completed;
+    auto failing_future = service.trace(failing.data(), failing.size(), failing_results.data()
+        , [&completed]() { completed.push_back(0); });
+    auto next_future = service.trace(next.data(), next.size(), next_results.data()
+        , [&completed]() { completed.push_back(1); });
+    service.finish();
+
+    CHECK(throws([&]() { failing_future.get(); }));
+    next_future.get();
+    CHECK(completed.size() == 1 && completed[0] == 1);
+    CHECK(next_results.back() == glm::vec4(float(next.size() - 1), 0.0f, 0.0f, 1.0f));
+    // the chunk in flight with the failing one is retired, the remaining ones are skipped
+    CHECK(slots->reads == 3 + 2);
+    CHECK(!slots->errors);
+    CHECK(slots->pending_count == 0);
+    CHECK(service.stats().jobs == 1);
+    CHECK(service.pump() == 0);
+}
+
+static void test_raytracer_slots() {
+    SceneRaytracer raytracer;
+    make_test_scene(raytracer, 16, 3);
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    int const count = 5000;
+    std::vector<RenderRayQuery> queries(count);
+    for (auto& q : queries) {
+        q.origin = glm::vec3(0.0f, 1.5f, 0.0f);
+        q.mode_or_data = 0;
+        q.dir = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        q.t_max = 1.e32f;
+    }
+    queries[7].t_max = 1.e-3f; // miss
+
+    std::vector<RayQuery> reference_queries(count);
+    std::memcpy((void*) reference_queries.data(), queries.data(), sizeof(RenderRayQuery) * count);
+    std::vector<float> hit_t(count, -1.0f);
+    std::vector<glm::vec3> hit_normal(count, glm::vec3(0.0f));
+    RaytraceResults reference_results;
+    reference_results.hit_t = hit_t.data();
+    reference_results.hit_normal = hit_normal.data();
+    raytracer.trace_ray(reference_queries.data(), count, reference_results);
+
+    RayQueryService service(std::unique_ptr<RayQuerySlots>(new RaytraceQuerySlots(raytracer, 3, 777)));
+    std::vector<glm::vec4> results(count);
+    auto future = service.trace(queries.data(), queries.size(), results.data());
+    service.finish();
+    future.get();
+
+    bool same = true;
+    for (int i = 0; i < count; ++i)
+        same &= results[i] == glm::vec4(hit_normal[i], hit_t[i]);
+    CHECK(same);
+    CHECK(results[7].w < 0.0f);
+    CHECK(service.stats().chunks == uint64_t((count + 776) / 777));
+}
+
+int main() {
+    test_chunking();
+    test_failed_readback();
+    test_raytracer_slots();
+    return test_result();
+}
@@ -0,0 +1,205 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "render_server.h"
+#include "test_util.h"
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static RenderJob make_job(uint64_t id) {
+    RenderJob job;
+    job.id = id;
+    job.scene_files = { "scenes/a.vks", "scenes/b.obj" };
+    job.has_camera = true;
+    job.eye[0] = 1.0f + float(id);
+    job.dir[2] = 1.0f;
+    job.fov_y = 40.0f;
+    job.config = "[Renderer][Params]\nmax_path_depth=3\n";
+    job.aovs = RENDER_SERVER_AOV_RGBA | RENDER_SERVER_AOV_NORMAL_DEPTH;
+    job.target_spp = 16;
+    return job;
+}
+
+static RenderJobResult make_result(RenderJob const& job) {
+    RenderJobResult result;
+    result.id = job.id;
+    result.success = true;
+    std::vector<unsigned char> image(1000 + size_t(job.id) * 70001);
+    for (size_t i = 0; i < image.size(); ++i)
+        image[i] = (unsigned char) (i * 31 + job.id);
+    result.images.push_back({ "rgba", image });
+    result.images.push_back({ "normal_depth", std::vector<unsigned char>(image.rbegin(), image.rend()) });
+    return result;
+}
+
+static bool same_job(RenderJob const& a, RenderJob const& b) {
+    return a.id == b.id && a.scene_files == b.scene_files && a.has_camera == b.has_camera
+        && a.eye[0] == b.eye[0] && a.dir[2] == b.dir[2] && a.up[1] == b.up[1] && a.fov_y == b.fov_y
+        && a.config == b.config && a.aovs == b.aovs && a.target_spp == b.target_spp;
+}
+
+static bool same_result(RenderJobResult const& a, RenderJobResult const& b) {
+    return a.id == b.id && a.success == b.success && a.error == b.error && a.images == b.images;
+}
+
+static void test_serialization() {
+    RenderJob job = make_job(7);
+    std::vector<unsigned char> data = serialize_render_job(job);
+    RenderJob read_job;
+    CHECK(deserialize_render_job(data.data(), data.size(), &read_job));
+    CHECK(same_job(job, read_job));
+    // truncated and oversized payloads are rejected
+    CHECK(!deserialize_render_job(data.data(), data.size() - 1, &read_job));
+    data.push_back(0);
+    CHECK(!deserialize_render_job(data.data(), data.size(), &read_job));
+
+    RenderJobResult result = make_result(job);
+    result.success = false;
+    result.error = "scene not found";
+    data = serialize_render_job_result(result);
+    RenderJobResult read_result;
+    CHECK(deserialize_render_job_result(data.data(), data.size(), &read_result));
+    CHECK(same_result(result, read_result));
+}
+
+static void test_framing() {
+    std::vector<unsigned char> stream;
+    frame_render_server_message(stream, RENDER_SERVER_MESSAGE_JOB, serialize_render_job(make_job(1)));
+    frame_render_server_message(stream, RENDER_SERVER_MESSAGE_JOB, serialize_render_job(make_job(2)));
+
+    // messages arrive in arbitrary pieces
+    std::vector<unsigned char> buffer;
+    std::vector<uint64_t> ids;
+    RenderServerMessageType type;
+    std::vector<unsigned char> payload;
+    for (size_t i = 0; i < stream.size(); i += 5) {
+        buffer.insert(buffer.end(), stream.begin() + i, stream.begin() + std::min(i + 5, stream.size()));
+        while (unframe_render_server_message(buffer, &type, &payload)) {
+            RenderJob job;
+            CHECK(type == RENDER_SERVER_MESSAGE_JOB);
+            CHECK(deserialize_render_job(payload.data(), payload.size(), &job));
+            ids.push_back(job.id);
+        }
+    }
+    CHECK(ids == std::vector<uint64_t>({ 1, 2 }));
+    CHECK(buffer.empty());
+
+    std::vector<unsigned char> corrupt(64, 0xff);
+    bool threw = false;
+    try {
+        unframe_render_server_message(corrupt, &type, &payload);
+    } catch (std::exception const&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+static std::string socket_path(std::string const& name) {
+    return (fs::temp_directory_path() / ("rptr_test_" + name + ".sock")).string();
+}
+
+// Serves jobs like the render loop, polling while rendering and while idle
+static void serve(RenderServer& server, int job_count, std::vector<uint64_t>* served) {
+    while ((int) served->size() < job_count) {
+        server.poll(10);
+        RenderServer::QueuedJob queued;
+        while (server.next_job(&queued)) {
+            served->push_back(queued.job.id);
+            server.send_result(queued.connection, make_result(queued.job));
+            server.poll(0);
+        }
+    }
+    while (server.pending_output_bytes() > 0)
+        server.poll(10);
+}
+
+static void test_socket_jobs() {
+    std::string path = socket_path("render_server");
+    RenderServer server(path);
+    int const job_count = 6;
+
+    int received = 0;
+    bool in_order = true, intact = true;
+    std::thread client_thread([&]() {
+        RenderClient client(path);
+        // all jobs are queued before the first result is read
+        for (int i = 0; i < job_count; ++i)
+            client.submit(make_job(uint64_t(i)));
+        RenderJobResult result;
+        while (received < job_count && client.receive(&result)) {
+            in_order &= result.id == uint64_t(received);
+            intact &= same_result(result, make_result(make_job(result.id)));
+            ++received;
+        }
+    });
+    std::vector<uint64_t> served;
+    serve(server, job_count, &served);
+    client_thread.join();
+
+    CHECK(received == job_count);
+    CHECK(in_order);
+    CHECK(intact);
+    CHECK(served.size() == size_t(job_count));
+}
+
+static void test_disconnected_client() {
+    std::string path = socket_path("render_server_disconnect");
+    RenderServer server(path);
+    {
+        RenderClient client(path);
+        client.submit(make_job(1));
+        client.submit(make_job(2));
+        server.poll(100);
+    }
+    RenderClient client(path);
+    client.submit(make_job(3));
+    // the first client hangs up before its jobs were started
+    for (int i = 0; i < 10; ++i)
+        server.poll(10);
+
+    std::vector<uint64_t> started;
+    RenderServer::QueuedJob queued;
+    while (server.next_job(&queued)) {
+        started.push_back(queued.job.id);
+        server.send_result(queued.connection, make_result(queued.job));
+    }
+    CHECK(started == std::vector<uint64_t>({ 3 }));
+    RenderJobResult result;
+    bool received = false;
+    std::thread client_thread([&]() { received = client.receive(&result); });
+    while (server.pending_output_bytes() > 0)
+        server.poll(10);
+    client_thread.join();
+    CHECK(received && result.id == 3);
+}
+
+static void test_existing_file() {
+    std::string path = socket_path("render_server_file");
+    {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        CHECK(file != nullptr);
+        std::fputs("keep", file);
+        std::fclose(file);
+    }
+    // only stale sockets are replaced, other files are an error and survive
+    CHECK(throws([&]() { RenderServer server(path); }));
+    CHECK(fs::is_regular_file(path) && fs::file_size(path) == 4);
+    fs::remove(path);
+
+    // the socket of another server is replaced
+    path = socket_path("render_server_stale");
+    RenderServer first(path);
+    CHECK(!throws([&]() { RenderServer second(path); }));
+}
+
+int main() {
+    test_serialization();
+    test_framing();
+    test_socket_jobs();
+    test_disconnected_client();
+    test_existing_file();
+    return test_result();
+}
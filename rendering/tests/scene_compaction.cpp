@@ -0,0 +1,397 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "scene_compaction.h"
+#include "test_util.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// The sequential passes that compact_scene replaces, in their order, as reference
+
+#define FOR_TEXTURED_MATERIAL_PROPERTIES(x) \
+    x(base_color) \
+    x(specular) \
+    x(roughness) \
+    x(metallic) \
+    x(specular_transmission) \
+    x(transmission_color) \
+    x(ior) \
+
+static void reference_remove_orphaned_instanced_meshes(Scene &scene, SceneCompactionStats &stats) {
+    int numOriginalMeshes = ilen(scene.parameterized_meshes);
+    int numDedupMeshes = 0;
+    std::vector<int> mesh_dedup_index_LUT(numOriginalMeshes, -1);
+    std::vector<int> mesh_users(numOriginalMeshes);
+    for (Instance &instance : scene.instances) {
+        int pm_id = instance.parameterized_mesh_id;
+        mesh_users[pm_id]++;
+        if (int lod_group_id = scene.parameterized_meshes[pm_id].lod_group) {
+            for (int lod_mesh_id : scene.lod_groups[lod_group_id].mesh_ids)
+                mesh_users[lod_mesh_id]++;
+        }
+    }
+    for (int iMesh = 0; iMesh < numOriginalMeshes; iMesh++) {
+        if (mesh_users[iMesh] > 0) {
+            mesh_dedup_index_LUT[iMesh] = numDedupMeshes;
+            if (numDedupMeshes != iMesh)
+                scene.parameterized_meshes[numDedupMeshes] = std::move(scene.parameterized_meshes[iMesh]);
+            ++numDedupMeshes;
+        }
+    }
+    scene.parameterized_meshes.resize(numDedupMeshes);
+    if (numOriginalMeshes == numDedupMeshes)
+        return;
+    for (LodGroup &lod_group : scene.lod_groups)
+        for (int &lod_mesh_id : lod_group.mesh_ids)
+            lod_mesh_id = mesh_dedup_index_LUT[lod_mesh_id];
+    for (Instance &instance : scene.instances)
+        instance.parameterized_mesh_id = mesh_dedup_index_LUT[instance.parameterized_mesh_id];
+    stats.num_removed_pmeshes += numOriginalMeshes - numDedupMeshes;
+}
+
+static void reference_remove_orphaned_lods_and_meshes(Scene &scene, SceneCompactionStats &stats) {
+    int numOriginalMeshes = ilen(scene.meshes);
+    int numOriginalLODGroups = ilen(scene.lod_groups);
+    int numUsedMeshes = 0;
+    int numUsedLODGroups = 1;
+    std::vector<int> used_mesh_indices(numOriginalMeshes, -1);
+    std::vector<int> used_lodgroup_indices(numOriginalLODGroups, -1);
+    used_lodgroup_indices[0] = 0;
+    std::vector<int> mesh_users(numOriginalMeshes);
+    std::vector<int> lodgroup_users(numOriginalLODGroups);
+    for (auto &pmesh : scene.parameterized_meshes) {
+        mesh_users[pmesh.mesh_id]++;
+        lodgroup_users[pmesh.lod_group]++;
+    }
+    for (int mesh_id = 0; mesh_id < numOriginalMeshes; mesh_id++) {
+        if (mesh_users[mesh_id] > 0) {
+            used_mesh_indices[mesh_id] = numUsedMeshes;
+            if (numUsedMeshes != mesh_id)
+                scene.meshes[numUsedMeshes] = std::move(scene.meshes[mesh_id]);
+            numUsedMeshes++;
+        }
+    }
+    scene.meshes.resize(numUsedMeshes);
+    for (int lod_group_id = 1; lod_group_id < numOriginalLODGroups; lod_group_id++) {
+        if (lodgroup_users[lod_group_id] > 0) {
+            used_lodgroup_indices[lod_group_id] = numUsedLODGroups;
+            if (numUsedLODGroups != lod_group_id)
+                scene.lod_groups[numUsedLODGroups] = std::move(scene.lod_groups[lod_group_id]);
+            numUsedLODGroups++;
+        }
+    }
+    scene.lod_groups.resize(numUsedLODGroups);
+    if (numOriginalMeshes == numUsedMeshes && numOriginalLODGroups == numUsedLODGroups)
+        return;
+    for (auto &pmesh : scene.parameterized_meshes) {
+        pmesh.mesh_id = used_mesh_indices[pmesh.mesh_id];
+        pmesh.lod_group = used_lodgroup_indices[pmesh.lod_group];
+    }
+    stats.num_removed_meshes += numOriginalMeshes - numUsedMeshes;
+    stats.num_removed_lod_groups += numOriginalLODGroups - numUsedLODGroups;
+}
+
+static void reference_remove_orphaned_materials(Scene &scene, SceneCompactionStats &stats) {
+    int numOriginalMaterials = ilen(scene.materials);
+    int numUsedMaterials = 0;
+    std::vector<int> material_used_indices(numOriginalMaterials, -1);
+    std::vector<int> material_users(numOriginalMaterials);
+    for (auto &pmesh : scene.parameterized_meshes) {
+        if (pmesh.per_triangle_materials())
+            return;
+        for (int material_id : pmesh.material_offsets)
+            material_users[material_id]++;
+    }
+    for (int material_id = 0; material_id < numOriginalMaterials; material_id++) {
+        if (material_users[material_id] > 0) {
+            material_used_indices[material_id] = numUsedMaterials;
+            if (numUsedMaterials != material_id) {
+                scene.materials[numUsedMaterials] = std::move(scene.materials[material_id]);
+                scene.material_names[numUsedMaterials] = std::move(scene.material_names[material_id]);
+            }
+            numUsedMaterials++;
+        }
+    }
+    scene.materials.resize(numUsedMaterials);
+    scene.material_names.resize(numUsedMaterials);
+    if (numOriginalMaterials == numUsedMaterials)
+        return;
+    for (auto &pmesh : scene.parameterized_meshes)
+        for (int& material_id : pmesh.material_offsets)
+            material_id = material_used_indices[material_id];
+    stats.num_removed_materials += numOriginalMaterials - numUsedMaterials;
+}
+
+static void reference_remove_orphaned_textures(Scene &scene, SceneCompactionStats &stats) {
+    int numOriginalTextures = ilen(scene.textures);
+    int numUsedTextures = 0;
+    std::vector<int> texture_used_indices(numOriginalTextures, -1);
+    std::vector<int> texture_users(numOriginalTextures);
+    for (auto &material : scene.materials) {
+        if (material.normal_map >= 0)
+            texture_users[material.normal_map]++;
+#define TEXTURED_MATERIAL_PROPERTY_INC(property) { \
+            uint32_t tex_id; \
+            memcpy(&tex_id, reinterpret_cast<char*>(&material.property), sizeof(tex_id)); \
+            if (IS_TEXTURED_PARAM(tex_id)) \
+                texture_users[GET_TEXTURE_ID(tex_id)]++; \
+        }
+        FOR_TEXTURED_MATERIAL_PROPERTIES(TEXTURED_MATERIAL_PROPERTY_INC)
+#undef TEXTURED_MATERIAL_PROPERTY_INC
+    }
+    for (int texture_id = 0; texture_id < numOriginalTextures; texture_id++) {
+        if (texture_users[texture_id] > 0) {
+            texture_used_indices[texture_id] = numUsedTextures;
+            if (numUsedTextures != texture_id)
+                scene.textures[numUsedTextures] = std::move(scene.textures[texture_id]);
+            numUsedTextures++;
+        }
+    }
+    scene.textures.resize(numUsedTextures);
+    if (numOriginalTextures == numUsedTextures)
+        return;
+    for (auto &material : scene.materials) {
+        if (material.normal_map >= 0)
+            material.normal_map = texture_used_indices[material.normal_map];
+#define TEXTURED_MATERIAL_PROPERTY_REMAP(property) { \
+            uint32_t old_tex_id; \
+            memcpy(&old_tex_id, reinterpret_cast<char*>(&material.property), sizeof(old_tex_id)); \
+            if (IS_TEXTURED_PARAM(old_tex_id)) { \
+                uint32_t new_tex_id = TEXTURED_PARAM_MASK; \
+                SET_TEXTURE_ID(new_tex_id, texture_used_indices[GET_TEXTURE_ID(old_tex_id)]); \
+                memcpy(reinterpret_cast<char*>(&material.property), &new_tex_id, sizeof(new_tex_id)); \
+            } \
+        }
+        FOR_TEXTURED_MATERIAL_PROPERTIES(TEXTURED_MATERIAL_PROPERTY_REMAP)
+#undef TEXTURED_MATERIAL_PROPERTY_REMAP
+    }
+    stats.num_removed_textures += numOriginalTextures - numUsedTextures;
+}
+
+static SceneCompactionStats reference_compact_scene(Scene &scene) {
+    SceneCompactionStats stats;
+    reference_remove_orphaned_instanced_meshes(scene, stats);
+    reference_remove_orphaned_lods_and_meshes(scene, stats);
+    reference_remove_orphaned_materials(scene, stats);
+    reference_remove_orphaned_textures(scene, stats);
+    return stats;
+}
+
+static void set_texture_param(float &param, int texture_id, int channel) {
+    uint32_t tex_id = TEXTURED_PARAM_MASK;
+    SET_TEXTURE_ID(tex_id, texture_id);
+    SET_TEXTURE_CHANNEL(tex_id, channel);
+    memcpy(&param, &tex_id, sizeof(tex_id));
+}
+
+struct RandomSceneParams {
+    int meshes = 200;
+    int lod_groups = 20;
+    int materials = 100;
+    int textures = 60;
+    int instances = 5000;
+    float used_fraction = 0.5f; // of meshes that instances pick from
+    bool per_triangle_materials = false;
+};
+
+// Items are identified by their names and ids after compaction
+static Scene random_scene(RandomSceneParams const& params, uint32_t seed) {
+    std::mt19937 rng(seed);
+    auto random_int = [&](int n) { return n > 0 ? int(rng() % uint32_t(n)) : 0; };
+    Scene scene;
+
+    for (int i = 0; i < params.textures; ++i) {
+        Image image;
+        image.name = "texture" + std::to_string(i);
+        scene.textures.push_back(image);
+    }
+    for (int i = 0; i < params.materials; ++i) {
+        BaseMaterial material;
+        material.base_color = glm::vec3(float(i));
+        if (params.textures > 0) {
+            if (random_int(2))
+                material.normal_map = random_int(params.textures);
+            if (random_int(2))
+                set_texture_param(material.base_color.x, random_int(params.textures), 0);
+            if (random_int(3) == 0)
+                set_texture_param(material.roughness, random_int(params.textures), 1 + random_int(3));
+            if (random_int(4) == 0)
+                set_texture_param(material.ior, random_int(params.textures), 2);
+        }
+        scene.materials.push_back(material);
+        scene.material_names.push_back("material" + std::to_string(i));
+    }
+
+    for (int i = 0; i < params.meshes; ++i) {
+        Mesh mesh;
+        mesh.flags = uint32_t(i);
+        scene.meshes.push_back(mesh);
+    }
+    // several parameterized meshes per mesh, some meshes are shared
+    int pmesh_count = params.meshes + params.meshes / 2;
+    for (int i = 0; i < pmesh_count; ++i) {
+        ParameterizedMesh pmesh;
+        pmesh.mesh_id = i < params.meshes ? i : random_int(params.meshes);
+        pmesh.mesh_name = "pmesh" + std::to_string(i);
+        for (int j = 0, je = 1 + random_int(3); j < je; ++j)
+            pmesh.material_offsets.push_back(random_int(params.materials));
+        scene.parameterized_meshes.push_back(pmesh);
+    }
+    if (params.per_triangle_materials) {
+        ParameterizedMesh &pmesh = scene.parameterized_meshes[0];
+        pmesh.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint32_t>(4, 0)));
+    }
+
+    // LoD groups of consecutive parameterized meshes, except for the last third
+    for (int i = 0; i < params.lod_groups; ++i) {
+        LodGroup group;
+        int first = random_int(pmesh_count * 2 / 3);
+        for (int j = first, je = std::min(first + 1 + random_int(3), pmesh_count); j < je; ++j) {
+            if (scene.parameterized_meshes[j].lod_group)
+                break;
+            group.mesh_ids.push_back(j);
+            group.detail_reduction.push_back(0.3f * float(group.mesh_ids.size() - 1));
+            scene.parameterized_meshes[j].lod_group = ilen(scene.lod_groups);
+        }
+        if (!group.mesh_ids.empty())
+            scene.lod_groups.push_back(group);
+    }
+
+    int used_pmeshes = std::max(int(float(pmesh_count) * params.used_fraction), 1);
+    for (int i = 0; i < params.instances; ++i) {
+        Instance instance;
+        instance.transform_index = uint32_t(i);
+        instance.parameterized_mesh_id = random_int(used_pmeshes);
+        scene.instances.push_back(instance);
+    }
+    if (params.per_triangle_materials && !scene.instances.empty())
+        scene.instances[0].parameterized_mesh_id = 0;
+    return scene;
+}
+
+static bool same_scene(Scene const& a, Scene const& b) {
+    bool same = a.meshes.size() == b.meshes.size()
+        && a.parameterized_meshes.size() == b.parameterized_meshes.size()
+        && a.lod_groups.size() == b.lod_groups.size()
+        && a.materials.size() == b.materials.size()
+        && a.material_names == b.material_names
+        && a.textures.size() == b.textures.size()
+        && a.instances.size() == b.instances.size();
+    if (!same)
+        return false;
+    for (size_t i = 0; i < a.meshes.size(); ++i)
+        same &= a.meshes[i].flags == b.meshes[i].flags;
+    for (size_t i = 0; i < a.parameterized_meshes.size(); ++i) {
+        ParameterizedMesh const& pa = a.parameterized_meshes[i];
+        ParameterizedMesh const& pb = b.parameterized_meshes[i];
+        same &= pa.mesh_id == pb.mesh_id && pa.lod_group == pb.lod_group && pa.mesh_name == pb.mesh_name
+            && pa.material_offsets == pb.material_offsets;
+    }
+    for (size_t i = 0; i < a.lod_groups.size(); ++i)
+        same &= a.lod_groups[i].mesh_ids == b.lod_groups[i].mesh_ids
+            && a.lod_groups[i].detail_reduction == b.lod_groups[i].detail_reduction;
+    same &= memcmp(a.materials.data(), b.materials.data(), a.materials.size() * sizeof(BaseMaterial)) == 0;
+    for (size_t i = 0; i < a.textures.size(); ++i)
+        same &= a.textures[i].name == b.textures[i].name;
+    same &= memcmp(a.instances.data(), b.instances.data(), a.instances.size() * sizeof(Instance)) == 0;
+    return same;
+}
+
+static bool same_stats(SceneCompactionStats const& a, SceneCompactionStats const& b) {
+    return a.num_removed_pmeshes == b.num_removed_pmeshes
+        && a.num_removed_meshes == b.num_removed_meshes
+        && a.num_removed_lod_groups == b.num_removed_lod_groups
+        && a.num_removed_materials == b.num_removed_materials
+        && a.num_removed_textures == b.num_removed_textures;
+}
+
+static void check_against_reference(RandomSceneParams const& params, uint32_t seed, int thread_count) {
+    Scene expected = random_scene(params, seed);
+    Scene scene = random_scene(params, seed);
+    SceneCompactionStats expected_stats = reference_compact_scene(expected);
+    SceneCompactionStats stats = compact_scene(scene, thread_count);
+    CHECK(same_scene(scene, expected));
+    CHECK(same_stats(stats, expected_stats));
+
+    // compaction is idempotent
+    SceneCompactionStats second_stats = compact_scene(scene, thread_count);
+    CHECK(same_scene(scene, expected));
+    CHECK(same_stats(second_stats, SceneCompactionStats()));
+}
+
+static void test_reference() {
+    RandomSceneParams params;
+    for (uint32_t seed = 1; seed <= 20; ++seed) {
+        params.used_fraction = 0.05f * float(seed);
+        check_against_reference(params, seed, seed % 2 ? 1 : 0);
+    }
+
+    // all textures stay in use, texture handles are not rewritten
+    params.textures = 2;
+    params.used_fraction = 1.0f;
+    check_against_reference(params, 50, 0);
+    params.textures = 60;
+
+    // many instances, marked and remapped in parallel chunks
+    params.instances = 200000;
+    params.used_fraction = 0.3f;
+    check_against_reference(params, 100, 0);
+
+    // materials are kept, but textures of unused materials are not
+    params.instances = 1000;
+    params.per_triangle_materials = true;
+    Scene scene = random_scene(params, 7);
+    SceneCompactionStats stats = compact_scene(scene);
+    CHECK(stats.num_removed_materials == 0);
+    CHECK(scene.materials.size() == size_t(params.materials));
+    check_against_reference(params, 7, 0);
+
+    // no instances leave only the default LoD group
+    params = RandomSceneParams();
+    params.instances = 0;
+    scene = random_scene(params, 3);
+    compact_scene(scene);
+    CHECK(scene.parameterized_meshes.empty());
+    CHECK(scene.meshes.empty());
+    CHECK(scene.lod_groups.size() == 1);
+    CHECK(scene.materials.empty());
+    CHECK(scene.textures.empty());
+    check_against_reference(params, 3, 0);
+}
+
+static void test_lod_members() {
+    Scene scene;
+    scene.meshes.resize(4);
+    scene.parameterized_meshes.resize(4);
+    for (int i = 0; i < 4; ++i)
+        scene.parameterized_meshes[i].mesh_id = i;
+    // group of pmeshes 1 and 3, only the coarse LoD is instanced
+    LodGroup group;
+    group.mesh_ids = { 1, 3 };
+    group.detail_reduction = { 0.0f, 0.5f };
+    scene.lod_groups.push_back(group);
+    scene.parameterized_meshes[1].lod_group = 1;
+    scene.parameterized_meshes[3].lod_group = 1;
+    Instance instance;
+    instance.parameterized_mesh_id = 3;
+    scene.instances.push_back(instance);
+
+    SceneCompactionStats stats = compact_scene(scene);
+    CHECK(stats.num_removed_pmeshes == 2);
+    CHECK(stats.num_removed_meshes == 2);
+    CHECK(scene.parameterized_meshes.size() == 2);
+    CHECK(scene.lod_groups.size() == 2);
+    CHECK(scene.lod_groups[1].mesh_ids == std::vector<int>({ 0, 1 }));
+    CHECK(scene.instances[0].parameterized_mesh_id == 1);
+    CHECK(scene.parameterized_meshes[0].mesh_id == 0);
+    CHECK(scene.parameterized_meshes[1].mesh_id == 1);
+}
+
+int main() {
+    test_reference();
+    test_lod_members();
+
+    return test_result();
+}
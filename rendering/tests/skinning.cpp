@@ -0,0 +1,179 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "skinning.h"
+#include "test_scene_util.h"
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+static bool near_weights(BlendAttributes const& a, float const (&weights)[SKINNING_MAX_INFLUENCES], float eps) {
+    for (int i = 0; i < SKINNING_MAX_INFLUENCES; ++i)
+        if (std::abs(a.weights[i] - weights[i]) > eps)
+            return false;
+    return true;
+}
+
+static BlendAttributes make_attributes(uint32_t tuple_index, float const (&weights)[SKINNING_MAX_INFLUENCES]) {
+    BlendAttributes attributes;
+    attributes.tuple_index = tuple_index;
+    for (int i = 0; i < SKINNING_MAX_INFLUENCES; ++i)
+        attributes.weights[i] = weights[i];
+    return attributes;
+}
+
+// codes written by the Blender exporter (BlendAttributeCodec.compress)
+static void test_exporter_codes() {
+    struct Reference {
+        uint32_t code;
+        uint32_t tuple_index;
+        float weights[SKINNING_MAX_INFLUENCES];
+    } const references[] = {
+        { 4259875u, 7, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } },
+        { 1067106u, 3, { 0.0f, 0.0f, 0.0f, 0.0f, 0.25f, 0.75f } },
+        { 67555u, 0, { 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.5f } },
+        { 23524353u, 11, { 0.0f, 0.0f, 0.1f, 0.2f, 0.3f, 0.4f } },
+        { 1150173917u, 511, { 0.05f, 0.1f, 0.15f, 0.2f, 0.2f, 0.3f } },
+    };
+    for (auto& ref : references) {
+        BlendAttributes decoded = decode_blend_attributes(ref.code);
+        CHECK(decoded.tuple_index == ref.tuple_index);
+        CHECK(near_weights(decoded, ref.weights, 0.01f));
+        CHECK(encode_blend_attributes(make_attributes(ref.tuple_index, ref.weights)) == ref.code);
+    }
+    CHECK(decode_blend_attributes(4259875u).is_singleton());
+    CHECK(!decode_blend_attributes(67555u).is_singleton());
+}
+
+static void test_round_trip() {
+    float const weight_sets[][SKINNING_MAX_INFLUENCES] = {
+        { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+        { 0.0f, 0.0f, 0.0f, 0.0f, 0.4f, 0.6f },
+        { 0.0f, 0.0f, 0.0f, 0.2f, 0.3f, 0.5f },
+        { 0.0f, 0.1f, 0.1f, 0.2f, 0.2f, 0.4f },
+        { 0.1f, 0.1f, 0.15f, 0.15f, 0.2f, 0.3f },
+    };
+    int mismatches = 0;
+    for (uint32_t tuple_index : { 0u, 1u, 17u, 120u, 999u, SKINNING_TUPLE_INDEX_COUNT - 1 }) {
+        for (auto& weights : weight_sets) {
+            uint32_t code = encode_blend_attributes(make_attributes(tuple_index, weights));
+            BlendAttributes decoded = decode_blend_attributes(code);
+            mismatches += int(decoded.tuple_index != tuple_index);
+            mismatches += int(!near_weights(decoded, weights, 0.02f));
+            // quantized attributes are reproduced exactly
+            mismatches += int(encode_blend_attributes(decoded) != code);
+            float sum = 0.0f;
+            for (float w : decoded.weights)
+                sum += w;
+            mismatches += int(std::abs(sum - 1.0f) > 1.e-5f);
+        }
+    }
+    CHECK(mismatches == 0);
+
+    float const single[SKINNING_MAX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    CHECK(throws([&]() { encode_blend_attributes(make_attributes(SKINNING_TUPLE_INDEX_COUNT, single)); }));
+}
+
+// One skinned mesh with a static instance transform (index 0) and two bones (indices 1, 2)
+// that translate along x and y, respectively. Bone 2 moves further in the second frame.
+static Scene make_test_scene(std::vector<uint32_t> blend_attributes, std::vector<glm::vec3> positions) {
+    Scene scene;
+    Geometry geom;
+    std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.0f, 0.0f, 1.0f));
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals)));
+    geom.blend_attributes = mapped_vector<uint32_t>(std::move(blend_attributes));
+    geom.format_flags = Geometry::ImplicitIndices;
+    scene.meshes.push_back(Mesh({ geom }));
+    scene.meshes[0].flags = Mesh::Dynamic | Mesh::Skinned;
+    scene.parameterized_meshes.resize(1);
+    scene.parameterized_meshes[0].mesh_id = 0;
+
+    AnimationData anim;
+    anim.numStaticTransforms = 2;
+    anim.numAnimatedTransforms = 1;
+    anim.numFrames = 2;
+    anim.animationStep = 1.0f;
+    std::vector<unsigned char> quantized(anim.size_in_bytes());
+    quantize_translation(quantized.data(), glm::vec3(0.0f));
+    quantize_translation(quantized.data() + VKR_QUANTIZED_TRANSFORM_SIZE, glm::vec3(1.0f, 0.0f, 0.0f));
+    for (int f = 0; f < 2; ++f)
+        quantize_translation(quantized.data() + (2 + f) * VKR_QUANTIZED_TRANSFORM_SIZE, glm::vec3(0.0f, 2.0f * (f + 1), 0.0f));
+    anim.quantized = mapped_vector<unsigned char>(std::move(quantized));
+    anim.bone_index_tuples = mapped_vector<uint16_t>(std::vector<uint16_t>{ 0, 0, 0, 0, 1, 2 });
+    scene.animation_data.push_back(anim);
+
+    scene.instances.resize(1);
+    scene.instances[0].parameterized_mesh_id = 0;
+    return scene;
+}
+
+static void test_cpu_skinning() {
+    float const half[SKINNING_MAX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.5f };
+    float const single[SKINNING_MAX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    Scene scene = make_test_scene({ encode_blend_attributes(make_attributes(1, single))
+                                  , encode_blend_attributes(make_attributes(0, half))
+                                  , UNSKINNED_BLEND_ATTRIBUTES }
+                                , { glm::vec3(0.0f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(3.0f, 0.0f, 0.0f) });
+    Geometry const& geom = scene.meshes[0].geometries[0];
+    AnimationData const& anim = scene.animation_data[0];
+
+    SkinningPalette palette;
+    palette.initialize(scene, scene.instances[0]);
+    CHECK(palette.first_bone == 1);
+    CHECK(palette.bone_transforms.size() == 2);
+    CHECK(skinned_vertex_count(scene.meshes[0]) == 3);
+
+    glm::vec3 positions[3], normals[3];
+    for (uint32_t frame = 0; frame < 2; ++frame) {
+        CHECK(palette.update(anim, scene.instances[0], frame));
+        CHECK(!palette.update(anim, scene.instances[0], frame));
+        skin_geometry(geom, anim, palette, positions, normals, 1);
+        float bone_y = 2.0f * float(frame + 1);
+        CHECK(near_equal(positions[0], glm::vec3(1.0f, 0.0f, 0.0f)));
+        CHECK(near_equal(positions[1], glm::vec3(1.5f, 1.0f + 0.5f * bone_y, 1.0f)));
+        CHECK(near_equal(positions[2], glm::vec3(3.0f, 0.0f, 0.0f)));
+        for (auto& n : normals)
+            CHECK(near_equal(n, glm::vec3(0.0f, 0.0f, 1.0f)));
+    }
+
+    // tuple indices beyond the table are rejected
+    Scene broken = make_test_scene({ encode_blend_attributes(make_attributes(1, half)) }, { glm::vec3(0.0f) });
+    CHECK(throws([&]() { palette.initialize(broken, broken.instances[0]); }));
+}
+
+static void test_threaded_skinning() {
+    float const weights[SKINNING_MAX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.3f, 0.7f };
+    float const single[SKINNING_MAX_INFLUENCES] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+    std::vector<uint32_t> blend_attributes;
+    std::vector<glm::vec3> rest;
+    for (int i = 0; i < 3 * 10000; ++i) {
+        blend_attributes.push_back(i % 3 == 0 ? encode_blend_attributes(make_attributes(1 + i % 2, single))
+                                              : encode_blend_attributes(make_attributes(0, weights)));
+        rest.push_back(glm::vec3(float(i % 17), float(i % 5), float(i % 3)));
+    }
+    Scene scene = make_test_scene(std::move(blend_attributes), std::move(rest));
+    Geometry const& geom = scene.meshes[0].geometries[0];
+
+    SkinningPalette palette;
+    palette.initialize(scene, scene.instances[0]);
+    palette.update(scene.animation_data[0], scene.instances[0], 1);
+    int vertex_count = geom.num_verts();
+    std::vector<glm::vec3> serial(vertex_count), threaded(vertex_count);
+    skin_geometry(geom, scene.animation_data[0], palette, serial.data(), nullptr, 1);
+    skin_geometry(geom, scene.animation_data[0], palette, threaded.data(), nullptr, 4);
+    int mismatches = 0;
+    for (int i = 0; i < vertex_count; ++i)
+        mismatches += int(serial[i] != threaded[i]);
+    CHECK(mismatches == 0);
+}
+
+int main() {
+    printf("Testing skinning\n");
+    test_exporter_codes();
+    test_round_trip();
+    test_cpu_skinning();
+    test_threaded_skinning();
+    return test_result();
+}
@@ -0,0 +1,58 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Scene construction helpers of the rendering tests that link librender,
+// kept apart from test_util.h for the tests that only link util.
+
+#include "test_util.h"
+#include "scene.h"
+#include <vkr.h>
+#include <vector>
+
+// undo_vks_axes quantizes the transform as .vks files store it, AnimationData::dequantize flips the axes back
+inline void quantize_translation(unsigned char* quantized, glm::vec3 t, bool undo_vks_axes = false) {
+    if (undo_vks_axes) {
+        float matrix[4][3] = { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { -t.x, t.z, t.y } };
+        vkr_quantize_transform(quantized, matrix);
+    } else {
+        float matrix[4][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { t.x, t.y, t.z } };
+        vkr_quantize_transform(quantized, matrix);
+    }
+}
+
+// One parameterized mesh per mesh, instances with static translations
+struct SceneBuilder {
+    Scene scene;
+    std::vector<glm::vec3> translations;
+    bool undo_vks_axes = false;
+
+    int add_mesh(Mesh mesh) {
+        scene.meshes.push_back(std::move(mesh));
+        ParameterizedMesh pm;
+        pm.mesh_id = ilen(scene.meshes) - 1;
+        scene.parameterized_meshes.push_back(pm);
+        return pm.mesh_id;
+    }
+    int add_transform(glm::vec3 t) {
+        translations.push_back(t);
+        return ilen(translations) - 1;
+    }
+    void add_instance(int parameterized_mesh_id, int transform_index) {
+        Instance inst = { };
+        inst.parameterized_mesh_id = parameterized_mesh_id;
+        inst.transform_index = uint32_t(transform_index);
+        scene.instances.push_back(inst);
+    }
+    Scene& finish() {
+        AnimationData anim;
+        anim.numStaticTransforms = translations.size();
+        std::vector<unsigned char> quantized(anim.size_in_bytes());
+        for (size_t i = 0; i < translations.size(); ++i)
+            quantize_translation(quantized.data() + i * VKR_QUANTIZED_TRANSFORM_SIZE, translations[i], undo_vks_axes);
+        anim.quantized = mapped_vector<unsigned char>(std::move(quantized));
+        scene.animation_data = { anim };
+        return scene;
+    }
+};
@@ -0,0 +1,52 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Check scaffold of the rendering tests: failed checks are printed and counted,
+// main returns test_result() to print the summary and to fail on any failed check.
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <random>
+
+static int num_failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); ++num_failed; } } while (false)
+
+inline int test_result() {
+    if (num_failed)
+        printf("FAILED (%d checks)\n", num_failed);
+    else
+        printf("PASSED\n");
+    return num_failed ? 1 : 0;
+}
+
+template <class Fn>
+bool throws(Fn&& fn) {
+    try {
+        fn();
+    } catch (std::exception const&) {
+        return true;
+    }
+    return false;
+}
+
+inline bool near_equal(glm::vec3 a, glm::vec3 b, float eps = 1.e-3f) {
+    return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec3(eps)));
+}
+
+// uniformly distributed over the unit sphere, the height is drawn along pole_axis
+inline void uniform_direction(std::mt19937& rng, float (&dir)[3], int pole_axis = 2) {
+    float const pi = 3.14159265358979323846f;
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float h = 2.0f * uniform(rng) - 1.0f;
+    float r = std::sqrt(std::max(1.0f - h * h, 0.0f));
+    float phi = 2.0f * pi * uniform(rng);
+    dir[pole_axis == 0 ? 1 : 0] = r * std::cos(phi);
+    dir[pole_axis == 2 ? 1 : 2] = r * std::sin(phi);
+    dir[pole_axis] = h;
+}
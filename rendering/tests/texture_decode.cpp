@@ -0,0 +1,280 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "image.h"
+#include "write_image.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static Image block_image(int bc_format, int width, int height, std::vector<uint8_t> blocks) {
+    Image image = {
+        .name = "blocks",
+        .width = width,
+        .height = height,
+        .channels = 4,
+        .img = Buffer<uint8_t>(std::move(blocks)),
+        .bcFormat = bc_format
+    };
+    return image;
+}
+
+// Straightforward per-texel decode with real arithmetic, following the Khronos Data Format Specification
+static double reference_channel(uint8_t const* block, int texel, bool is_signed) {
+    double e0 = is_signed ? std::max(int8_t(block[0]) / 127.0, -1.0) : block[0] / 255.0;
+    double e1 = is_signed ? std::max(int8_t(block[1]) / 127.0, -1.0) : block[1] / 255.0;
+    uint64_t bits = 0;
+    for (int i = 7; i >= 2; --i)
+        bits = bits << 8 | block[i];
+    int index = int(bits >> (3 * texel)) & 0x7;
+    bool eight_values = is_signed ? int8_t(block[0]) > int8_t(block[1]) : block[0] > block[1];
+    if (index == 0) return e0;
+    if (index == 1) return e1;
+    if (eight_values)
+        return ((8 - index) * e0 + (index - 1) * e1) / 7.0;
+    if (index == 6) return is_signed ? -1.0 : 0.0;
+    if (index == 7) return 1.0;
+    return ((6 - index) * e0 + (index - 1) * e1) / 5.0;
+}
+
+static void reference_color(uint8_t const* block, int texel, bool four_color_only, bool has_alpha, double rgba[4]) {
+    unsigned c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+    double e[2][3] = { { (c0 >> 11) / 31.0, ((c0 >> 5) & 63) / 63.0, (c0 & 31) / 31.0 }
+                     , { (c1 >> 11) / 31.0, ((c1 >> 5) & 63) / 63.0, (c1 & 31) / 31.0 } };
+    int index = (block[4 + texel / 4] >> (2 * (texel % 4))) & 0x3;
+    rgba[3] = 1.0;
+    for (int ch = 0; ch < 3; ++ch) {
+        if (index < 2)
+            rgba[ch] = e[index][ch];
+        else if (four_color_only || c0 > c1)
+            rgba[ch] = index == 2 ? (2.0 * e[0][ch] + e[1][ch]) / 3.0 : (e[0][ch] + 2.0 * e[1][ch]) / 3.0;
+        else
+            rgba[ch] = index == 2 ? (e[0][ch] + e[1][ch]) / 2.0 : 0.0;
+    }
+    if (index == 3 && !(four_color_only || c0 > c1) && has_alpha)
+        rgba[3] = 0.0;
+}
+
+static uint8_t to_unorm8(double v) {
+    return uint8_t(std::floor(v * 255.0 + 0.5));
+}
+static uint8_t to_snorm8(double v) {
+    double scaled = v * 127.0;
+    return uint8_t(int8_t(scaled < 0.0 ? -std::floor(-scaled + 0.5) : std::floor(scaled + 0.5)));
+}
+
+static void reference_texel(int bc_format, uint8_t const* block, int texel, uint8_t out[4]) {
+    double rgba[4] = { 0.0, 0.0, 0.0, 1.0 };
+    bool is_signed = bc_format < 0;
+    switch (bc_format) {
+    case 1: case -1:
+        reference_color(block, texel, false, is_signed, rgba);
+        break;
+    case 2:
+        reference_color(block + 8, texel, true, true, rgba);
+        rgba[3] = ((block[texel / 2] >> (4 * (texel % 2))) & 0xf) / 15.0;
+        break;
+    case 3:
+        reference_color(block + 8, texel, true, true, rgba);
+        rgba[3] = reference_channel(block, texel, false);
+        break;
+    case 5: case -5:
+        rgba[1] = reference_channel(block + 8, texel, is_signed);
+        [[fallthrough]];
+    case 4: case -4:
+        rgba[0] = reference_channel(block, texel, is_signed);
+        break;
+    }
+    for (int ch = 0; ch < 4; ++ch)
+        out[ch] = is_signed && ch < 2 && std::abs(bc_format) >= 4 ? to_snorm8(rgba[ch]) : to_unorm8(rgba[ch]);
+}
+
+static void test_known_blocks() {
+    // white and black endpoints, all texels on the first interpolated color
+    Image white_black = block_image(1, 4, 4, { 0xff, 0xff, 0x00, 0x00, 0xaa, 0xaa, 0xaa, 0xaa });
+    mapped_vector<uint8_t> texels = white_black.decompressBytes();
+    CHECK(texels.size() == 64);
+    CHECK(texels.data()[0] == 170 && texels.data()[1] == 170 && texels.data()[2] == 170 && texels.data()[3] == 255);
+
+    // 5 bit red 3 is 24.68 / 255, not the 24 of bit replication
+    Image red = block_image(1, 4, 4, { 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 });
+    CHECK(red.decompressBytes().data()[0] == 25);
+
+    // three-color mode: the fourth color is black, transparent only for BC1 RGBA
+    std::vector<uint8_t> three_colors = { 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    mapped_vector<uint8_t> opaque = block_image(1, 4, 4, three_colors).decompressBytes();
+    mapped_vector<uint8_t> transparent = block_image(-1, 4, 4, three_colors).decompressBytes();
+    CHECK(opaque.data()[0] == 0 && opaque.data()[3] == 255);
+    CHECK(transparent.data()[0] == 0 && transparent.data()[3] == 0);
+
+    // BC3 always decodes its colors in four-color mode
+    std::vector<uint8_t> bc3 = { 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    bc3.insert(bc3.end(), three_colors.begin(), three_colors.end());
+    mapped_vector<uint8_t> bc3_texels = block_image(3, 4, 4, bc3).decompressBytes();
+    CHECK(bc3_texels.data()[0] == 170 && bc3_texels.data()[3] == 255);
+
+    // 6/7 of 255 rounds up to 219, in the six-value mode index 7 is 255
+    mapped_vector<uint8_t> bc4 = block_image(4, 4, 4, { 0xff, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 }).decompressBytes();
+    CHECK(bc4.data()[0] == 219 && bc4.data()[1] == 0 && bc4.data()[2] == 0 && bc4.data()[3] == 255);
+    mapped_vector<uint8_t> bc4_six = block_image(4, 4, 4, { 0x10, 0x20, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00 }).decompressBytes();
+    CHECK(bc4_six.data()[0] == 255 && bc4_six.data()[4] == 16);
+
+    // signed endpoints: -128 is -1 like -127
+    mapped_vector<uint8_t> snorm = block_image(-4, 4, 4, { 0x80, 0x7f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }).decompressBytes();
+    CHECK(int8_t(snorm.data()[0]) == -127);
+
+    // BC5 fills red and green, blue is zero and alpha one
+    mapped_vector<uint8_t> bc5 = block_image(5, 4, 4, { 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+        , 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }).decompressBytes();
+    CHECK(bc5.data()[0] == 0x40 && bc5.data()[1] == 0xc0 && bc5.data()[2] == 0 && bc5.data()[3] == 255);
+}
+
+static void test_mip_chains() {
+    std::mt19937 rng(7);
+    for (int bc_format : { 1, -1, 2, 3, 4, -4, 5, -5 }) {
+        // sizes that are not multiples of the block size
+        for (auto size : { std::pair<int, int>(10, 6), std::pair<int, int>(33, 1), std::pair<int, int>(64, 64) }) {
+            Image probe = block_image(bc_format, size.first, size.second, { });
+            size_t block_bytes = size_t(probe.bits_per_pixel()) * 2;
+            std::vector<uint8_t> blocks;
+            std::vector<size_t> level_offsets;
+            for (int w = size.first, h = size.second, i = 0, ie = probe.max_mip_levels(); i < ie; ++i) {
+                level_offsets.push_back(blocks.size());
+                for (size_t b = 0, be = size_t((w + 3) / 4) * ((h + 3) / 4) * block_bytes; b < be; ++b)
+                    blocks.push_back(uint8_t(rng()));
+                if (w > 1) w /= 2;
+                if (h > 1) h /= 2;
+            }
+            Image image = block_image(bc_format, size.first, size.second, blocks);
+            CHECK(image.mip_levels() == image.max_mip_levels());
+
+            Image decoded = image.decompress(1);
+            Image threaded = image.decompress(4);
+            CHECK(decoded.bcFormat == 0 && decoded.channels == 4);
+            CHECK(decoded.mip_levels() == image.mip_levels());
+            CHECK(memcmp(decoded.img.data(), threaded.img.data(), decoded.img.size()) == 0);
+
+            bool same = true;
+            size_t texel_offset = 0;
+            for (int w = size.first, h = size.second, i = 0; i < ilen(level_offsets); ++i) {
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x) {
+                        uint8_t const* block = blocks.data() + level_offsets[i] + (size_t(y / 4) * ((w + 3) / 4) + x / 4) * block_bytes;
+                        uint8_t expected[4];
+                        reference_texel(bc_format, block, (y % 4) * 4 + x % 4, expected);
+                        same &= memcmp(expected, decoded.img.data() + texel_offset + 4 * (size_t(y) * w + x), 4) == 0;
+                    }
+                texel_offset += size_t(w) * h * 4;
+                if (w > 1) w /= 2;
+                if (h > 1) h /= 2;
+            }
+            CHECK(same);
+            CHECK(texel_offset == decoded.img.size());
+        }
+    }
+
+    // scratch buffers are reused, uncompressed images pass through
+    Image bc1 = block_image(1, 4, 4, { 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 });
+    Buffer<uint8_t> scratch = nullptr;
+    mapped_vector<uint8_t> first = bc1.decompressBytes(scratch);
+    CHECK(first.data() == scratch.data());
+    Image rgba = bc1.decompress();
+    CHECK(rgba.decompressBytes().data() == rgba.img.data());
+
+    // truncated data
+    bool thrown = false;
+    try {
+        block_image(3, 8, 8, std::vector<uint8_t>(16)).decompressBytes();
+    } catch (std::exception const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static void test_generate_mips() {
+    std::vector<uint8_t> texels(5 * 3 * 4);
+    for (size_t i = 0; i < texels.size(); ++i)
+        texels[i] = uint8_t(i * 37);
+    Image image = {
+        .name = "mips",
+        .width = 5,
+        .height = 3,
+        .channels = 4,
+        .img = Buffer<uint8_t>(texels)
+    };
+    Image mips = image.generateMips(1);
+    CHECK(mips.mip_levels() == 3);
+    CHECK(mips.img.size() == size_t(5 * 3 + 2 * 1 + 1 * 1) * 4);
+    CHECK(memcmp(mips.img.data(), texels.data(), texels.size()) == 0);
+    // 2x2 box of the top left texels
+    uint8_t const* level1 = mips.img.data() + texels.size();
+    CHECK(level1[0] == uint8_t((texels.data()[0] + texels.data()[4] + texels.data()[20] + texels.data()[24] + 2) / 4));
+    CHECK(memcmp(mips.img.data(), image.generateMips(3).img.data(), mips.img.size()) == 0);
+
+    // sRGB averages in linear space: black and white give 188, not 128
+    Image srgb = {
+        .name = "srgb",
+        .width = 2,
+        .height = 1,
+        .channels = 4,
+        .img = Buffer<uint8_t>(std::vector<uint8_t>({ 0, 0, 0, 255, 255, 255, 255, 255 })),
+        .color_space = SRGB
+    };
+    Image srgb_mips = srgb.generateMips();
+    CHECK(srgb_mips.img.size() == 12);
+    CHECK(srgb_mips.img.data()[8] == 188 && srgb_mips.img.data()[11] == 255);
+}
+
+static void test_import() {
+    // rows are stored bottom first, as with the previous flipped load
+    std::vector<ImageFile> files;
+    std::vector<std::vector<uint8_t>> written;
+    for (int i = 0; i < 6; ++i) {
+        int width = 3 + i, height = 2 + i;
+        std::vector<uint8_t> pixels(size_t(width) * height * 4);
+        for (size_t j = 0; j < pixels.size(); ++j)
+            pixels[j] = uint8_t(j * 13 + i);
+        // note: the extension is appended by write_png
+        std::string prefix = "test_texture_decode_" + std::to_string(i);
+        CHECK(WriteImage::write_png(prefix.c_str(), width, height, 4, pixels.data()));
+        files.push_back({ prefix + ".png", "image" + std::to_string(i), i % 2 ? SRGB : LINEAR });
+        written.push_back(pixels);
+    }
+    std::vector<Image> images = Image::fromFiles(files, false, 3);
+    std::vector<Image> mipmapped = Image::fromFiles(files, true);
+    CHECK(images.size() == files.size());
+    for (int i = 0; i < ilen(images); ++i) {
+        Image const& image = images[i];
+        CHECK(image.width == 3 + i && image.height == 2 + i && image.channels == 4);
+        CHECK(image.name == files[i].name && image.color_space == files[i].color_space);
+        size_t row_bytes = size_t(image.width) * 4;
+        bool flipped = true;
+        for (int y = 0; y < image.height; ++y)
+            flipped &= memcmp(image.img.data() + row_bytes * y, written[i].data() + row_bytes * (image.height - 1 - y), row_bytes) == 0;
+        CHECK(flipped);
+        CHECK(mipmapped[i].mip_levels() == image.max_mip_levels());
+        CHECK(memcmp(mipmapped[i].img.data(), image.img.data(), image.img.size()) == 0);
+        remove(files[i].file.c_str());
+    }
+
+    bool thrown = false;
+    try {
+        Image::fromFiles({ { "test_texture_decode_missing.png", "missing" } });
+    } catch (std::exception const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main() {
+    test_known_blocks();
+    test_mip_chains();
+    test_generate_mips();
+    test_import();
+
+    return test_result();
+}
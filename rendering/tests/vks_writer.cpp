@@ -0,0 +1,274 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "vkr.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void error_handler(VkrResult result, const char *msg) {
+    printf("libvkr: %s\n", msg);
+}
+
+struct TestMesh {
+    std::vector<float> positions, normals, uvs;
+    std::vector<uint32_t> indices, material_ids;
+
+    VkrMeshData data(char const* name) const {
+        VkrMeshData mesh = { };
+        mesh.name = name;
+        mesh.numVertices = positions.size() / 3;
+        mesh.positions = positions.data();
+        mesh.normals = normals.empty() ? nullptr : normals.data();
+        mesh.uvs = uvs.empty() ? nullptr : uvs.data();
+        mesh.numTriangles = indices.size() / 3;
+        mesh.indices = indices.data();
+        mesh.materialIds = material_ids.empty() ? nullptr : material_ids.data();
+        return mesh;
+    }
+};
+
+// wavy grid with shared vertices, normals pointing all around and tiling UVs
+static TestMesh make_grid(int n, int num_materials, uint32_t material_base) {
+    TestMesh mesh;
+    for (int y = 0; y <= n; ++y) {
+        for (int x = 0; x <= n; ++x) {
+            float u = float(x) / n, v = float(y) / n;
+            mesh.positions.insert(mesh.positions.end(), { 4.0f * u - 1.0f, 0.5f * std::sin(6.0f * u), 2.0f * v + 3.0f });
+            float theta = 3.0f * u, phi = 6.2831853f * v;
+            mesh.normals.insert(mesh.normals.end(), { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+            mesh.uvs.insert(mesh.uvs.end(), { 3.0f * u - 0.5f, 2.0f * v });
+        }
+    }
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            uint32_t i = uint32_t(y * (n + 1) + x);
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + uint32_t(n) + 1 });
+            mesh.indices.insert(mesh.indices.end(), { i + 1, i + uint32_t(n) + 2, i + uint32_t(n) + 1 });
+            for (int k = 0; k < 2; ++k)
+                mesh.material_ids.push_back(material_base + uint32_t((x * 7 + y * 3 + k) % num_materials));
+        }
+    }
+    return mesh;
+}
+
+static bool near(float const* a, float const* b, int count, float eps) {
+    for (int i = 0; i < count; ++i)
+        if (!(std::abs(a[i] - b[i]) <= eps))
+            return false;
+    return true;
+}
+
+// UVs are reproduced up to integer offsets per triangle
+static bool near_uv(float const* a, float const* b, float eps) {
+    for (int i = 0; i < 2; ++i) {
+        float d = a[i] - b[i];
+        if (!(std::abs(d - std::round(d)) <= eps))
+            return false;
+    }
+    return true;
+}
+
+static std::vector<char> read_range(char const* file, int64_t offset, size_t size) {
+    std::vector<char> data(size);
+    FILE* f = fopen(file, "rb");
+    if (!f)
+        return { };
+    bool ok = fseek(f, long(offset), SEEK_SET) == 0 && fread(data.data(), 1, size, f) == size;
+    fclose(f);
+    return ok ? data : std::vector<char>();
+}
+
+// compares all triangles of the written mesh against the source triangles,
+// finding the source of each output triangle by matching corners
+static void check_mesh(char const* file, VkrMesh const& vkrm, TestMesh const& src, int num_segments) {
+    size_t n = src.indices.size() / 3;
+    CHECK(vkrm.numTriangles == n);
+    CHECK(vkrm.numSegments == uint64_t(num_segments));
+    if (vkrm.numTriangles != n)
+        return;
+
+    std::vector<char> vertex_data = read_range(file, vkrm.vertexBufferOffset, sizeof(uint64_t) * 3 * n);
+    std::vector<char> normal_uv_data = read_range(file, vkrm.normalUvBufferOffset, sizeof(uint64_t) * 3 * n);
+    std::vector<char> material_data = read_range(file, vkrm.materialIdBufferOffset, n);
+    CHECK(!vertex_data.empty() && !normal_uv_data.empty() && !material_data.empty());
+    if (vertex_data.empty() || normal_uv_data.empty() || material_data.empty())
+        return;
+
+    std::vector<float> positions(9 * n), normals(9 * n), uvs(6 * n);
+    vkr_dequantize_vertices((uint64_t const*) vertex_data.data(), 3 * n, vkrm.vertexScale, vkrm.vertexOffset, positions.data());
+    vkr_dequantize_normal_uv((uint64_t const*) normal_uv_data.data(), 3 * n, normals.data(), uvs.data());
+    // octahedral normals come back with unit L1 norm
+    for (size_t i = 0; i < 3 * n; ++i) {
+        float* normal = &normals[3 * i];
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int j = 0; j < 3; ++j)
+            normal[j] /= length;
+    }
+
+    float position_eps = 0.0f;
+    for (int j = 0; j < 3; ++j)
+        position_eps = std::max(position_eps, vkrm.vertexScale[j]);
+
+    std::vector<int> source_used(n, 0);
+    size_t segment = 0, segment_end = vkrm.segmentNumTriangles[0];
+    for (size_t t = 0; t < n; ++t) {
+        while (t >= segment_end && segment + 1 < vkrm.numSegments)
+            segment_end += vkrm.segmentNumTriangles[++segment];
+        int32_t material_base = vkrm.numSegments == 1 ? vkrm.materialIdBufferBase : vkrm.segmentMaterialBaseOffsets[segment];
+
+        size_t match = n;
+        for (size_t s = 0; s < n && match == n; ++s) {
+            bool same = true;
+            for (int c = 0; c < 3 && same; ++c)
+                same = near(&positions[9 * t + 3 * c], &src.positions[3 * src.indices[3 * s + c]], 3, position_eps);
+            if (same)
+                match = s;
+        }
+        CHECK(match < n);
+        if (match == n)
+            continue;
+        ++source_used[match];
+        CHECK(uint32_t(material_base + uint8_t(material_data[t])) == src.material_ids[match]);
+        for (int c = 0; c < 3; ++c) {
+            uint32_t i = src.indices[3 * match + c];
+            CHECK(near(&normals[9 * t + 3 * c], &src.normals[3 * i], 3, 2.e-4f));
+            CHECK(near_uv(&uvs[6 * t + 2 * c], &src.uvs[2 * i], 2.e-4f));
+        }
+    }
+    for (size_t s = 0; s < n; ++s)
+        CHECK(source_used[s] == 1);
+
+    if (vkrm.flags & VKR_MESH_FLAGS_INDICES) {
+        std::vector<char> index_data = read_range(file, vkrm.indexBufferOffset, sizeof(uint32_t) * 3 * n);
+        CHECK(!index_data.empty());
+        uint32_t const* sharing = (uint32_t const*) index_data.data();
+        for (size_t c = 0; c < 3 * n && !index_data.empty(); ++c) {
+            CHECK(sharing[c] <= c);
+            CHECK(sharing[sharing[c]] == sharing[c]);
+            CHECK(near(&positions[3 * sharing[c]], &positions[3 * c], 3, 0.0f));
+        }
+    }
+}
+
+static void test_round_trip() {
+    char const* file = "test_vks_writer.vks";
+    TestMesh grid = make_grid(12, 5, 0);
+    // spans more than 256 materials, split into one segment per material
+    TestMesh wide = make_grid(6, 3, 0);
+    for (auto& id : wide.material_ids)
+        id = id == 0 ? 1 : id == 1 ? 200 : 300;
+
+    VkrSceneWriter* writer = nullptr;
+    CHECK(vkr_begin_scene(file, VKR_WRITE_FLAGS_OPTIMIZE_MESHES | VKR_WRITE_FLAGS_INDICES, 3, &writer, error_handler) == VKR_SUCCESS);
+    if (!writer)
+        return;
+    for (int i = 0; i < 301; ++i)
+        CHECK(vkr_write_material(writer, ("material" + std::to_string(i)).c_str()) == VKR_SUCCESS);
+
+    int64_t grid_id = -1, wide_id = -1;
+    VkrMeshData grid_data = grid.data("grid"), wide_data = wide.data("wide");
+    CHECK(vkr_write_mesh(writer, &grid_data, &grid_id) == VKR_SUCCESS);
+    CHECK(vkr_write_mesh(writer, &wide_data, &wide_id) == VKR_SUCCESS);
+    CHECK(grid_id == 0 && wide_id == 1);
+
+    float transforms[2][4][3] = {
+        { { 0.0f, 2.0f, 0.0f }, { -2.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 2.0f }, { 1.0f, 2.0f, 3.0f } },
+        { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { -5.0f, 0.0f, 0.5f } },
+    };
+    CHECK(vkr_write_instances(writer, grid_id, "grids", 2, transforms) == VKR_SUCCESS);
+    CHECK(vkr_write_instances(writer, wide_id, "wide", 0, nullptr) == VKR_SUCCESS);
+    CHECK(vkr_end_scene(writer) == VKR_SUCCESS);
+
+    VkrScene vks = { };
+    CHECK(vkr_open_scene(file, &vks, error_handler) == VKR_SUCCESS);
+    CHECK(vks.numMeshes == 2 && vks.numInstances == 3 && vks.numMaterials == 301);
+    CHECK(vks.numTriangles == (grid.indices.size() + wide.indices.size()) / 3);
+    if (vks.numMeshes == 2 && vks.numInstances == 3 && vks.numMaterials == 301) {
+        CHECK(std::strcmp(vks.meshes[0].name, "grid") == 0);
+        CHECK(std::strcmp(vks.materials[300].name, "material300") == 0);
+        check_mesh(file, vks.meshes[0], grid, 1);
+        check_mesh(file, vks.meshes[1], wide, 3);
+        CHECK(vks.meshes[0].numMaterialsInRange == 5);
+
+        CHECK(vks.instances[0].meshId == 0 && vks.instances[1].meshId == 0 && vks.instances[2].meshId == 1);
+        CHECK(std::strcmp(vks.instances[1].name, "grids") == 0);
+        CHECK(vks.numStaticTransforms == 3 && vks.numAnimatedTransforms == 0 && vks.animationOffset > 0);
+        std::vector<char> table = read_range(file, vks.animationOffset, VKR_QUANTIZED_TRANSFORM_SIZE * 3);
+        CHECK(!table.empty());
+        for (int i = 0; i < 3 && !table.empty(); ++i) {
+            float tx[4][3];
+            uint64_t offset = vkr_get_transform_offset(vks.instances[i].transformIndex, vks.numStaticTransforms, 0, 0);
+            vkr_dequantize_transform(tx, (unsigned char const*) table.data() + VKR_QUANTIZED_TRANSFORM_SIZE * offset);
+            float const identity[4][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+            CHECK(near(&tx[0][0], i < 2 ? &transforms[i][0][0] : &identity[0][0], 12, 1.e-3f));
+        }
+    }
+    vkr_close_scene(&vks);
+    std::remove(file);
+}
+
+static std::vector<char> write_grid_scene(char const* file, TestMesh const& grid, uint32_t num_threads) {
+    VkrSceneWriter* writer = nullptr;
+    if (vkr_begin_scene(file, VKR_WRITE_FLAGS_OPTIMIZE_MESHES | VKR_WRITE_FLAGS_INDICES, num_threads, &writer, error_handler) != VKR_SUCCESS)
+        return { };
+    VkrMeshData grid_data = grid.data("grid");
+    int64_t mesh_id = -1;
+    for (int i = 0; i < 5; ++i)
+        vkr_write_material(writer, "material");
+    vkr_write_mesh(writer, &grid_data, &mesh_id);
+    vkr_write_instances(writer, mesh_id, "grid", 0, nullptr);
+    if (vkr_end_scene(writer) != VKR_SUCCESS)
+        return { };
+    std::vector<char> data;
+    if (FILE* f = fopen(file, "rb")) {
+        fseek(f, 0, SEEK_END);
+        data.resize(size_t(ftell(f)));
+        fseek(f, 0, SEEK_SET);
+        if (fread(data.data(), 1, data.size(), f) != data.size())
+            data.clear();
+        fclose(f);
+    }
+    std::remove(file);
+    return data;
+}
+
+// large enough to be quantized in parallel, must not depend on the thread count
+static void test_threads() {
+    TestMesh grid = make_grid(160, 5, 0);
+    std::vector<char> serial = write_grid_scene("test_vks_writer_serial.vks", grid, 1);
+    std::vector<char> parallel = write_grid_scene("test_vks_writer_parallel.vks", grid, 8);
+    CHECK(!serial.empty());
+    CHECK(serial == parallel);
+}
+
+static void test_errors() {
+    char const* file = "test_vks_writer_error.vks";
+    VkrSceneWriter* writer = nullptr;
+    CHECK(vkr_begin_scene(file, VKR_WRITE_FLAGS_NONE, 0, &writer, nullptr) == VKR_SUCCESS);
+    if (!writer)
+        return;
+    TestMesh grid = make_grid(2, 5, 0);
+    VkrMeshData grid_data = grid.data("grid");
+    int64_t mesh_id = -1;
+    CHECK(vkr_write_mesh(writer, &grid_data, &mesh_id) == VKR_SUCCESS);
+    CHECK(vkr_write_instances(writer, mesh_id, "grid", 0, nullptr) == VKR_SUCCESS);
+    CHECK(vkr_write_instances(writer, mesh_id + 1, "missing", 0, nullptr) == VKR_INVALID_ARGUMENT);
+    CHECK(vkr_write_material(writer, "only") == VKR_INVALID_ARGUMENT); // errors are sticky
+    CHECK(vkr_end_scene(writer) != VKR_SUCCESS);
+    FILE* f = fopen(file, "rb");
+    CHECK(!f);
+    if (f)
+        fclose(f);
+}
+
+int main() {
+    printf("Testing .vks scene writer\n");
+    test_round_trip();
+    test_threads();
+    test_errors();
+    return test_result();
+}
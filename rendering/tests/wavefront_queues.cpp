@@ -0,0 +1,256 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "wavefront_queues.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static uint32_t group_count(uint32_t items) {
+    return (items + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+}
+
+static void test_queue() {
+    int const capacity = 5 * WAVEFRONT_WORKGROUP_SIZE + 3;
+    WavefrontQueue<uint32_t> queue(capacity);
+    CHECK(queue.size() == 0 && queue.counter.groups_x == 0);
+    CHECK(queue.counter.groups_y == 1 && queue.counter.groups_z == 1);
+
+    bool groups_match = true;
+    for (int i = 0; i < capacity; ++i) {
+        CHECK(queue.append(uint32_t(1000 + i)) == uint32_t(i));
+        groups_match &= queue.counter.groups_x == group_count(queue.size());
+    }
+    CHECK(groups_match);
+
+    std::vector<uint32_t> visited;
+    queue.dispatch([&](uint32_t index, uint32_t item) {
+        visited.push_back(item);
+        groups_match &= item == 1000 + index;
+    });
+    CHECK(groups_match);
+    CHECK(visited.size() == size_t(capacity));
+
+    queue.reset();
+    CHECK(queue.size() == 0 && queue.counter.groups_x == 0);
+    int visits = 0;
+    queue.dispatch([&](uint32_t, uint32_t) { ++visits; });
+    CHECK(visits == 0);
+
+    // subgroup-aggregated appends of several items open the same workgroups
+    std::mt19937 rng(5);
+    uint32_t offset = 0, groups = 0;
+    bool bulk_match = true;
+    for (int i = 0; i < 1000; ++i) {
+        uint32_t count = rng() % 65;
+        groups += glsl::wavefront_append_groups(offset, count);
+        offset += count;
+        bulk_match &= groups == group_count(offset);
+    }
+    CHECK(bulk_match);
+}
+
+static void test_material_sort() {
+    std::mt19937 rng(7);
+    for (int count : { 0, 1, 300, 20000 }) {
+        WavefrontQueue<WavefrontHit> hits(count);
+        for (int i = 0; i < count; ++i)
+            // more materials than bins
+            hits.append({ uint32_t(rng() % (3 * WAVEFRONT_SORT_BINS)), uint32_t(i) });
+
+        WavefrontMaterialSort sort;
+        std::vector<uint32_t> sorted(count, ~0u);
+        sort.count(hits);
+        uint32_t total = 0;
+        for (uint32_t bin : sort.bins)
+            total += bin;
+        CHECK(total == uint32_t(count));
+        sort.scan();
+        CHECK(sort.bins[0] == 0);
+        sort.scatter(hits, sorted);
+
+        // permutation of the paths, ascending bins, stable within bins
+        std::vector<bool> seen(count, false);
+        bool valid = true;
+        for (int i = 0; i < count; ++i) {
+            uint32_t path = sorted[i];
+            valid &= path < uint32_t(count) && !seen[path];
+            if (!valid)
+                break;
+            seen[path] = true;
+            if (i > 0) {
+                uint32_t prev_bin = glsl::wavefront_sort_bin(hits.items[sorted[i - 1]].material_id);
+                uint32_t bin = glsl::wavefront_sort_bin(hits.items[path].material_id);
+                valid &= prev_bin < bin || (prev_bin == bin && sorted[i - 1] < path);
+            }
+        }
+        CHECK(valid);
+        // scatter leaves the bin ends
+        CHECK(count == 0 || sort.bins[WAVEFRONT_SORT_BINS - 1] == uint32_t(count));
+    }
+}
+
+// Paths with random lengths, materials, absorption and shadow rays that log all stage calls
+struct LoggingKernels : WavefrontKernels {
+    struct Event {
+        int stage;
+        int bounce;
+    };
+    struct PathLog {
+        int length; // number of hits
+        bool absorbed; // shading terminates at the last hit
+        std::vector<Event> events;
+    };
+
+    int max_path_depth;
+    std::vector<PathLog> paths;
+    std::vector<Event> dispatches;
+    std::vector<uint32_t> dispatch_items;
+    std::vector<uint32_t> current_shade_bins;
+    bool shade_coherent = true;
+
+    LoggingKernels(int path_count, int max_path_depth, uint32_t seed)
+        : max_path_depth(max_path_depth), paths(path_count) {
+        std::mt19937 rng(seed);
+        for (auto& p : paths) {
+            p.length = int(rng() % uint32_t(max_path_depth + 2));
+            p.absorbed = rng() % 3 == 0;
+        }
+    }
+
+    static uint32_t material(uint32_t path, int bounce) {
+        return (path * 2654435761u + uint32_t(bounce) * 40503u) % (2 * WAVEFRONT_SORT_BINS + 11);
+    }
+    static bool casts_shadow(uint32_t path, int bounce) {
+        return (path + uint32_t(bounce)) % 2 == 0;
+    }
+
+    void begin_stage(int stage, int bounce, uint32_t items) override {
+        if (stage == WAVEFRONT_STAGE_SHADE)
+            current_shade_bins.clear();
+        dispatches.push_back({ stage, bounce });
+        dispatch_items.push_back(items);
+    }
+    void generate(uint32_t path) override {
+        paths[path].events.push_back({ WAVEFRONT_STAGE_GENERATE, 0 });
+    }
+    int extend(uint32_t path, int bounce) override {
+        paths[path].events.push_back({ WAVEFRONT_STAGE_EXTEND, bounce });
+        return bounce < paths[path].length ? int(material(path, bounce)) : -1;
+    }
+    bool shade(uint32_t path, int bounce, bool& shadow_ray) override {
+        paths[path].events.push_back({ WAVEFRONT_STAGE_SHADE, bounce });
+        uint32_t bin = glsl::wavefront_sort_bin(material(path, bounce));
+        shade_coherent &= current_shade_bins.empty() || current_shade_bins.back() <= bin;
+        current_shade_bins.push_back(bin);
+        shadow_ray = casts_shadow(path, bounce);
+        return !(paths[path].absorbed && bounce + 1 == paths[path].length);
+    }
+    void shadow(uint32_t path, int bounce) override {
+        paths[path].events.push_back({ WAVEFRONT_STAGE_SHADOW, bounce });
+    }
+    void resolve(uint32_t path) override {
+        paths[path].events.push_back({ WAVEFRONT_STAGE_RESOLVE, 0 });
+    }
+
+    // the per-path stage sequence expected from the path parameters
+    std::vector<Event> expected_events(uint32_t path) const {
+        PathLog const& p = paths[path];
+        std::vector<Event> events = { { WAVEFRONT_STAGE_GENERATE, 0 } };
+        for (int bounce = 0; bounce < max_path_depth; ++bounce) {
+            events.push_back({ WAVEFRONT_STAGE_EXTEND, bounce });
+            if (bounce >= p.length)
+                break;
+            events.push_back({ WAVEFRONT_STAGE_SHADE, bounce });
+            if (casts_shadow(path, bounce))
+                events.push_back({ WAVEFRONT_STAGE_SHADOW, bounce });
+            if (p.absorbed && bounce + 1 == p.length)
+                break;
+        }
+        events.push_back({ WAVEFRONT_STAGE_RESOLVE, 0 });
+        return events;
+    }
+    // paths that are extended in the given bounce
+    uint32_t expected_active(int bounce) const {
+        uint32_t active = 0;
+        for (uint32_t path = 0; path < paths.size(); ++path) {
+            auto events = expected_events(path);
+            active += uint32_t(std::count_if(events.begin(), events.end(), [bounce](Event e) {
+                return e.stage == WAVEFRONT_STAGE_EXTEND && e.bounce == bounce;
+            }));
+        }
+        return active;
+    }
+};
+
+static void test_scheduler() {
+    int const path_count = 3000;
+    int const max_path_depth = 6;
+    WavefrontScheduler scheduler(path_count + 17);
+
+    for (uint32_t seed : { 1u, 2u }) {
+        LoggingKernels kernels(path_count, max_path_depth, seed);
+        scheduler.run(path_count, max_path_depth, kernels);
+        CHECK(kernels.shade_coherent);
+
+        bool same_events = true;
+        uint64_t extended = 0, shaded = 0, shadow_rays = 0;
+        for (uint32_t path = 0; path < uint32_t(path_count); ++path) {
+            auto expected = kernels.expected_events(path);
+            auto const& events = kernels.paths[path].events;
+            same_events &= events.size() == expected.size();
+            for (size_t i = 0; same_events && i < events.size(); ++i)
+                same_events &= events[i].stage == expected[i].stage && events[i].bounce == expected[i].bounce;
+            for (auto e : expected) {
+                extended += e.stage == WAVEFRONT_STAGE_EXTEND;
+                shaded += e.stage == WAVEFRONT_STAGE_SHADE;
+                shadow_rays += e.stage == WAVEFRONT_STAGE_SHADOW;
+            }
+        }
+        CHECK(same_events);
+        CHECK(scheduler.stats.extended == extended);
+        CHECK(scheduler.stats.shaded == shaded);
+        CHECK(scheduler.stats.shadow_rays == shadow_rays);
+
+        // stage order of the dispatches, extend queues hold exactly the active paths
+        auto const& dispatches = kernels.dispatches;
+        int const per_bounce = 6;
+        CHECK(dispatches.size() == size_t(2 + per_bounce * scheduler.stats.bounces));
+        CHECK(dispatches.front().stage == WAVEFRONT_STAGE_GENERATE);
+        CHECK(dispatches.back().stage == WAVEFRONT_STAGE_RESOLVE);
+        int const bounce_stages[per_bounce] = {
+            WAVEFRONT_STAGE_EXTEND, WAVEFRONT_STAGE_SORT_COUNT, WAVEFRONT_STAGE_SORT_SCAN
+            , WAVEFRONT_STAGE_SORT_SCATTER, WAVEFRONT_STAGE_SHADE, WAVEFRONT_STAGE_SHADOW };
+        bool ordered = true, compacted = true;
+        for (int bounce = 0; bounce < scheduler.stats.bounces; ++bounce) {
+            for (int s = 0; s < per_bounce; ++s) {
+                auto d = dispatches[1 + bounce * per_bounce + s];
+                ordered &= d.stage == bounce_stages[s] && d.bounce == bounce;
+            }
+            compacted &= kernels.dispatch_items[1 + bounce * per_bounce] == kernels.expected_active(bounce);
+        }
+        CHECK(ordered);
+        CHECK(compacted);
+        CHECK(scheduler.stats.bounces <= max_path_depth);
+        CHECK(scheduler.stats.bounces == max_path_depth || kernels.expected_active(scheduler.stats.bounces) == 0);
+    }
+
+    // waves beyond the capacity are rejected
+    LoggingKernels kernels(path_count + 18, max_path_depth, 3);
+    bool threw = false;
+    try {
+        scheduler.run(path_count + 18, max_path_depth, kernels);
+    } catch (...) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    test_queue();
+    test_material_sort();
+    test_scheduler();
+    return test_result();
+}
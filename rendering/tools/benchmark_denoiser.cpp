@@ -0,0 +1,185 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures the CPU inference engine of the neural denoiser on random frames, with a
+// random network in the VkrTensor block layout or a network loaded from a .vktensor.
+
+#include "neural_denoiser.h"
+#include "parallel.h"
+#include "error_io.h"
+#include <vkr.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int width = 1920;
+    int height = 1080;
+    int layer_width = 32;
+    int hidden_layers = 2;
+    int window = 3;
+    int repeats = 3;
+    int threads = 0;
+    int seed = 1;
+    std::string network;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options]\n", binary);
+    printf("  --width N          frame width (default 1920)\n");
+    printf("  --height N         frame height (default 1080)\n");
+    printf("  --layer-width N    width of the random network blocks (default 32)\n");
+    printf("  --hidden-layers N  hidden layers of the random network (default 2)\n");
+    printf("  --window N         odd convolution window of the random network (default 3)\n");
+    printf("  --repeats N        timed repetitions, the best one is reported (default 3)\n");
+    printf("  --threads N        worker threads, 0 for all cores (default 0)\n");
+    printf("  --seed N           random seed (default 1)\n");
+    printf("  --network FILE     benchmark a .vktensor network instead of random ones\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        if (arg == "--network") {
+            opt.network = value;
+            continue;
+        }
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--width") opt.width = int_value;
+        else if (arg == "--height") opt.height = int_value;
+        else if (arg == "--layer-width") opt.layer_width = int_value;
+        else if (arg == "--hidden-layers") opt.hidden_layers = int_value;
+        else if (arg == "--window") opt.window = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--threads") opt.threads = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.width < 1 || opt.height < 1 || opt.repeats < 1)
+        throw_error("Need a non-empty frame and at least one repetition");
+    if (opt.window % 2 != 1)
+        throw_error("The window has to be odd");
+    if (opt.layer_width < 4)
+        throw_error("Layers have to be at least 4 wide");
+    return true;
+}
+
+template <class Fn>
+double best_time(int repeats, Fn&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+// Random network with implicit biases, in float or int8 format
+template <class T>
+NeuralNetwork make_random_network(Options const& opt, VkrTensorFormat format, std::mt19937& rng) {
+    int inputs = NeuralDenoiser::FEATURES_PER_TAP * opt.window * opt.window;
+    int input_blocks = (inputs + opt.layer_width - 2) / (opt.layer_width - 1);
+    int blocks = input_blocks + opt.hidden_layers + 1;
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<T> values(size_t(opt.layer_width) * opt.layer_width * blocks);
+    for (auto& v : values) {
+        if (format == VKR_TENSOR_FORMAT_INT8)
+            v = T(std::lround(127.0f * uniform(rng)));
+        else
+            v = T(uniform(rng) / std::sqrt(float(opt.layer_width)));
+    }
+
+    VkrTensor tensor = { };
+    tensor.dimensionality = 3;
+    tensor.format = format;
+    tensor.flags = VKR_TENSOR_FLAGS_INPUT_OUTPUT_SPEC | VKR_TENSOR_FLAGS_OUTPUT_TRANSPOSED | VKR_TENSOR_FLAGS_IMPLICIT_BIASES;
+    tensor.dimensions[0] = tensor.dimensions[1] = uint64_t(opt.layer_width);
+    tensor.dimensions[2] = uint64_t(blocks);
+    tensor.numInputs = uint64_t(inputs);
+    tensor.numInputLayerBlocks = uint64_t(input_blocks);
+    tensor.numOutputs = 3;
+    tensor.numOutputLayerBlocks = 1;
+    tensor.ratioDescriptor = 1.0 / (127.0 * std::sqrt(double(opt.layer_width)));
+    tensor.numValues = values.size();
+    tensor.values = values.data();
+    tensor.dataSize = sizeof(T) * values.size();
+    return NeuralNetwork(tensor);
+}
+
+void run_benchmark(char const* title, NeuralDenoiser const& denoiser, DenoiserImages const& images
+    , Options const& opt, std::vector<float>& output) {
+    double seconds = best_time(opt.repeats, [&]() {
+        denoiser.denoise(images, output.data(), opt.threads);
+    });
+    double megapixels = double(images.width) * images.height * 1.e-6;
+    printf("%s: %.2f ms, %.2f MP/s\n", title, seconds * 1.e3, megapixels / seconds);
+
+    NeuralProfile profile;
+    profile.reset(denoiser.network.layers.size());
+    denoiser.denoise(images, output.data(), opt.threads, &profile);
+    denoiser.network.print_profile(profile, title);
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(uint32_t(opt.seed));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    size_t pixel_count = size_t(opt.width) * opt.height;
+    std::vector<float> color(4 * pixel_count), albedo(4 * pixel_count), normal(4 * pixel_count), output(4 * pixel_count);
+    for (size_t i = 0; i < 4 * pixel_count; ++i) {
+        color[i] = 4.0f * uniform(rng) * uniform(rng);
+        albedo[i] = uniform(rng);
+        normal[i] = 2.0f * uniform(rng) - 1.0f;
+    }
+    DenoiserImages images;
+    images.width = opt.width;
+    images.height = opt.height;
+    images.color = color.data();
+    images.albedo = albedo.data();
+    images.normal = normal.data();
+
+    int thread_count = opt.threads > 0 ? opt.threads : default_thread_count();
+    printf("Frame: %dx%d, %d threads\n", opt.width, opt.height, thread_count);
+
+    if (!opt.network.empty()) {
+        NeuralDenoiser denoiser(load_neural_network(opt.network));
+        printf("Network %s: %d layers, %dx%d window\n", opt.network.c_str()
+            , int(denoiser.network.layers.size()), denoiser.window, denoiser.window);
+        run_benchmark(denoiser.network.quantized ? "int8" : "float", denoiser, images, opt, output);
+        return 0;
+    }
+
+    printf("Random networks: %d wide, %d hidden layers, %dx%d window\n"
+        , opt.layer_width, opt.hidden_layers, opt.window, opt.window);
+    run_benchmark("float", NeuralDenoiser(make_random_network<float>(opt, VKR_TENSOR_FORMAT_FLOAT, rng)), images, opt, output);
+    run_benchmark("int8", NeuralDenoiser(make_random_network<int8_t>(opt, VKR_TENSOR_FORMAT_INT8, rng)), images, opt, output);
+    return 0;
+}
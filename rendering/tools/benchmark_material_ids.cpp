@@ -0,0 +1,156 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures the decoding of per-triangle material IDs, element-wise through the parameterized
+// mesh against the bulk conversion, and the sorting of triangles by material.
+
+#include "mesh.h"
+#include "quantization.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int triangles = 10000000;
+    int materials = 16;
+    int repeats = 5;
+    int seed = 1;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options]\n", binary);
+    printf("  --triangles N   triangles (default 10000000)\n");
+    printf("  --materials N   distinct per-triangle materials (default 16)\n");
+    printf("  --repeats N     timed repetitions, the best one is reported (default 5)\n");
+    printf("  --seed N        random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--triangles") opt.triangles = int_value;
+        else if (arg == "--materials") opt.materials = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.triangles < 1 || opt.materials < 1 || opt.repeats < 1)
+        throw_error("Need at least one triangle, material and repetition");
+    return true;
+}
+
+template <class F>
+double best_time(int repeats, F&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+ParameterizedMesh make_parameterized_mesh(std::vector<uint32_t> const& ids, int bitcount) {
+    ParameterizedMesh pm;
+    pm.mesh_id = 0;
+    pm.material_offsets = { 0 };
+    pm.material_id_bitcount = bitcount;
+    if (bitcount == 8)
+        pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint8_t>(ids.begin(), ids.end())));
+    else if (bitcount == 16)
+        pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint16_t>(ids.begin(), ids.end())));
+    else
+        pm.triangle_material_ids = mapped_vector<void>(GenericBuffer(std::vector<uint32_t>(ids)));
+    return pm;
+}
+
+// Unrolled triangles with float positions, normals and uvs, as written by the vks writer
+Mesh make_unrolled_mesh(int triangles, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<glm::vec3> positions(3 * size_t(triangles)), normals(3 * size_t(triangles));
+    std::vector<glm::vec2> uvs(3 * size_t(triangles));
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        normals[i] = glm::vec3(0.0f, 0.0f, 1.0f);
+        uvs[i] = glm::vec2(uniform(rng), uniform(rng));
+    }
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals)));
+    geom.uvs = mapped_vector<void>(GenericBuffer(std::move(uvs)));
+    geom.format_flags = Geometry::NoIndices;
+    return Mesh({ geom });
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(uint32_t(opt.seed));
+    std::vector<uint32_t> ids(opt.triangles);
+    for (auto& id : ids)
+        id = rng() % uint32_t(opt.materials);
+    printf("Material IDs: %s triangles, %d materials\n", pretty_print_count(double(opt.triangles)).c_str(), opt.materials);
+
+    std::vector<uint32_t> element_wise(ids.size()), bulk(ids.size());
+    std::vector<uint8_t> upload(ids.size());
+    for (int bitcount : { 8, 16, 32 }) {
+        ParameterizedMesh pm = make_parameterized_mesh(ids, bitcount);
+        double element_time = best_time(opt.repeats, [&]() {
+            for (len_t i = 0, ie = pm.num_triangle_material_ids(); i < ie; ++i)
+                element_wise[i] = uint32_t(pm.triangle_material_id(i));
+        });
+        double bulk_time = best_time(opt.repeats, [&]() {
+            dequantize_material_ids(bulk.data(), bulk.size(), pm.triangle_material_ids.data(), uint32_t(bitcount));
+        });
+        double upload_time = best_time(opt.repeats, [&]() {
+            dequantize_material_ids(upload.data(), upload.size(), pm.triangle_material_ids.data(), uint32_t(bitcount));
+        });
+        printf("%2d bit: element-wise %.3f ms, bulk %.3f ms (%.2fx), 8 bit upload %.3f ms\n"
+            , bitcount, element_time * 1.e3, bulk_time * 1.e3, element_time / bulk_time, upload_time * 1.e3);
+        if (element_wise != bulk) {
+            printf("Element-wise and bulk decoding differ\n");
+            return 1;
+        }
+    }
+
+    Mesh unsorted_mesh = make_unrolled_mesh(opt.triangles, rng);
+    ParameterizedMesh unsorted_pm = make_parameterized_mesh(ids, opt.materials <= 256 ? 8 : 32);
+    size_t num_ranges = 0;
+    double sort_time = best_time(opt.repeats, [&]() {
+        Mesh mesh = unsorted_mesh;
+        ParameterizedMesh pm = unsorted_pm;
+        sort_triangles_by_material(mesh, pm);
+        num_ranges = pm.triangle_material_ranges.size();
+    });
+    printf("Sorted unrolled triangles into %d material ranges in %.3f ms: %.1f M triangles/s\n"
+        , int_cast(num_ranges), sort_time * 1.e3, double(opt.triangles) / sort_time * 1.e-6);
+    return 0;
+}
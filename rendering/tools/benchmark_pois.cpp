@@ -0,0 +1,132 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures point-of-interest generation throughput of the data capture library
+// on the deterministic test scene.
+
+#include "libdatacapture/pois.h"
+#include "libdatacapture/viewpoints.h"
+#include "libdatacapture/test_scene.h"
+#include "parallel.h"
+#include "error_io.h"
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+using namespace rt_datacapture;
+
+namespace {
+
+struct Options {
+    int pois_per_source = 100000;
+    int sources = 4;
+    int pillars = 256;
+    int repeats = 3;
+    int seed = 1;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options]\n", binary);
+    printf("  --pois N      POIs collected per source (default 100000)\n");
+    printf("  --sources N   POI sources, placed around the scene center (default 4)\n");
+    printf("  --pillars N   instanced pillars in the test scene (default 256)\n");
+    printf("  --repeats N   timed repetitions, the best one is reported (default 3)\n");
+    printf("  --seed N      random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--pois") opt.pois_per_source = int_value;
+        else if (arg == "--sources") opt.sources = int_value;
+        else if (arg == "--pillars") opt.pillars = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.pois_per_source < 1 || opt.sources < 1 || opt.repeats < 1)
+        throw_error("Need at least one POI, source and repetition");
+    return true;
+}
+
+template <class Fn>
+double best_time(int repeats, Fn&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    SceneRaytracer raytracer;
+    double build_time = best_time(1, [&]() {
+        make_test_scene(raytracer, opt.pillars, uint64_t(opt.seed));
+    });
+    printf("Test scene: %d pillars, %d triangles, built in %.3f s, %d threads\n"
+        , opt.pillars, int(raytracer.instanced_triangle_count()), build_time, default_thread_count());
+
+    std::vector<glm::vec3> sources;
+    for (int i = 0; i < opt.sources; ++i) {
+        float angle = 2.0f * PI * float(i) / float(opt.sources);
+        sources.push_back(glm::vec3(1.5f * std::cos(angle), 1.5f, 1.5f * std::sin(angle)));
+    }
+
+    int total_pois = opt.pois_per_source * opt.sources;
+    std::vector<Poi> pois(total_pois);
+    int valid_pois = 0;
+    double collect_time = best_time(opt.repeats, [&]() {
+        valid_pois = 0;
+        for (int i = 0; i < opt.sources; ++i)
+            valid_pois += collect_visible_points(raytracer, sources[i], pois.data() + i * opt.pois_per_source
+                , opt.pois_per_source, uint64_t(opt.seed + i));
+    });
+    printf("Collected %d POIs (%d valid) in %.3f s: %.2f M POIs/s\n"
+        , total_pois, valid_pois, collect_time, double(total_pois) / collect_time * 1.e-6);
+
+    std::vector<Poi> pruned;
+    int kept_pois = 0;
+    double prune_time = best_time(opt.repeats, [&]() {
+        pruned = pois;
+        RandomSampler rng(uint64_t(opt.seed));
+        kept_pois = prune_pois(pruned.data(), total_pois, rng);
+    });
+    printf("Pruned to %d POIs in %.3f s: %.2f M POIs/s\n"
+        , kept_pois, prune_time, double(total_pois) / prune_time * 1.e-6);
+
+    int const view_count = 10000;
+    double view_time = best_time(opt.repeats, [&]() {
+        RandomSampler rng(uint64_t(opt.seed));
+        for (int i = 0; i < view_count; ++i)
+            sample_viewpoint(raytracer, pruned.data(), kept_pois, rng);
+    });
+    printf("Sampled %d viewpoints in %.3f s: %.1f k views/s\n"
+        , view_count, view_time, double(view_count) / view_time * 1.e-3);
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures closest-hit query throughput of the pipelined ray query service, with a single
+// query slot (no overlap of staging, tracing and readback) against multiple in-flight slots.
+// Traces the deterministic test scene with the CPU ray tracer by default; scene files given
+// after the options are traced by the Vulkan backend (which may be a software driver).
+
+#include "librender/ray_query_service.h"
+#include "librender/instance_bounds.h"
+#include "libdatacapture/test_scene.h"
+#include "parallel.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef ENABLE_VULKAN
+#include "vulkan/render_vulkan.h"
+#endif
+
+using namespace rt_datacapture;
+
+namespace {
+
+struct Options {
+    int queries = 4000000;
+    int jobs = 4;
+    int slots = 3;
+    int chunk = DEFAULT_RAY_QUERY_BUDGET / 4;
+    int pillars = 256;
+    int repeats = 3;
+    int seed = 1;
+    std::vector<std::string> scene_files;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options] [scene files]\n", binary);
+    printf("  --queries N   closest-hit queries per repetition (default 4000000)\n");
+    printf("  --jobs N      jobs the queries are split into (default 4)\n");
+    printf("  --slots N     in-flight query slots of the pipelined run (default 3)\n");
+    printf("  --chunk N     queries per slot (default %d)\n", DEFAULT_RAY_QUERY_BUDGET / 4);
+    printf("  --pillars N   instanced pillars in the CPU test scene (default 256)\n");
+    printf("  --repeats N   timed repetitions, the best one is reported (default 3)\n");
+    printf("  --seed N      random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (arg.compare(0, 2, "--") != 0) {
+            opt.scene_files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--queries") opt.queries = int_value;
+        else if (arg == "--jobs") opt.jobs = int_value;
+        else if (arg == "--slots") opt.slots = int_value;
+        else if (arg == "--chunk") opt.chunk = int_value;
+        else if (arg == "--pillars") opt.pillars = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.queries < 1 || opt.jobs < 1 || opt.slots < 1 || opt.chunk < 1 || opt.repeats < 1)
+        throw_error("Need at least one query, job, slot, chunk entry and repetition");
+    return true;
+}
+
+template <class Fn>
+double best_time(int repeats, Fn&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+// Random rays from points inside the bounds
+std::vector<RenderRayQuery> random_queries(int count, glm::vec3 lower, glm::vec3 upper, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal;
+    std::vector<RenderRayQuery> queries(count);
+    for (auto& q : queries) {
+        q.origin = lower + (upper - lower) * glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        q.mode_or_data = 0;
+        q.dir = glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)) + glm::vec3(0.0f, 1.e-6f, 0.0f));
+        q.t_max = 1.e32f;
+    }
+    return queries;
+}
+
+template <class CreateSlots, class IsHit>
+void run_benchmark(Options const& opt, std::vector<RenderRayQuery> const& queries, CreateSlots&& create_slots, IsHit&& is_hit) {
+    std::vector<glm::vec4> results(queries.size());
+    size_t job_size = (queries.size() + size_t(opt.jobs) - 1) / size_t(opt.jobs);
+
+    double times[2] = { };
+    for (int pipelined = 0; pipelined < 2; ++pipelined) {
+        RayQueryService service(create_slots(pipelined ? opt.slots : 1, opt.chunk));
+        int callbacks = 0;
+        times[pipelined] = best_time(opt.repeats, [&]() {
+            std::vector<std::future<void>> futures;
+            for (size_t begin = 0; begin < queries.size(); begin += job_size) {
+                size_t count = std::min(job_size, queries.size() - begin);
+                futures.push_back(service.trace(queries.data() + begin, count, results.data() + begin
+                    , [&callbacks]() { ++callbacks; }));
+            }
+            service.finish();
+            for (auto& f : futures)
+                f.get();
+        });
+        auto const& stats = service.stats();
+        printf("%s: %d slots, %d chunks in flight at most, %.3f s: %.2f M queries/s\n"
+            , pipelined ? "Pipelined" : "Serial", pipelined ? opt.slots : 1, stats.max_chunks_in_flight
+            , times[pipelined], double(queries.size()) / times[pipelined] * 1.e-6);
+        if (callbacks != int(stats.jobs))
+            throw_error("Expected one callback per job");
+    }
+    int hits = 0;
+    for (auto const& r : results)
+        hits += is_hit(r);
+    printf("Speedup %.2fx, %s of %s queries hit\n", times[0] / times[1]
+        , pretty_print_count(double(hits)).c_str(), pretty_print_count(double(queries.size())).c_str());
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(uint32_t(opt.seed));
+    if (opt.scene_files.empty()) {
+        SceneRaytracer raytracer;
+        make_test_scene(raytracer, opt.pillars, uint64_t(opt.seed));
+        printf("CPU test scene: %d pillars, %d triangles, %d threads\n"
+            , opt.pillars, int(raytracer.instanced_triangle_count()), default_thread_count());
+        auto queries = random_queries(opt.queries, TEST_SCENE_LOWER, TEST_SCENE_UPPER, rng);
+        run_benchmark(opt, queries, [&](int slot_count, int slot_capacity) {
+            return std::unique_ptr<RayQuerySlots>(new RaytraceQuerySlots(raytracer, slot_count, slot_capacity));
+        }, [](glm::vec4 r) { return r.w >= 0.0f; });
+        return 0;
+    }
+
+#ifdef ENABLE_VULKAN
+    Scene scene(opt.scene_files);
+    InstanceBoundsTracker bounds;
+    bounds.reset(scene);
+    Box scene_bounds;
+    for (auto const& b : bounds.world_bounds)
+        scene_bounds += b;
+    if (scene_bounds.empty())
+        throw_error("Scene has no geometry to trace");
+
+    std::unique_ptr<RenderVulkan> renderer(new RenderVulkan(vkrt::Device()));
+    renderer->enable_ray_queries(std::max(opt.chunk, DEFAULT_RAY_QUERY_BUDGET), 0);
+    renderer->create_pipelines(nullptr, 0);
+    renderer->initialize(64, 64);
+    renderer->set_scene(scene);
+    printf("Vulkan: %s\n", renderer->name().c_str());
+    auto queries = random_queries(opt.queries, scene_bounds.lower, scene_bounds.upper, rng);
+    run_benchmark(opt, queries, [&](int slot_count, int slot_capacity) {
+        auto slots = renderer->create_ray_query_slots(slot_count, slot_capacity);
+        if (!slots)
+            throw_error("Vulkan backend does not support closest-hit ray queries");
+        return slots;
+    }, [](glm::vec4 r) { return r.x >= 0.0f; }); // barycentrics, negative on miss
+    return 0;
+#else
+    printf("Scene files require the Vulkan backend, which is not enabled in this build\n");
+    return 1;
+#endif
+}
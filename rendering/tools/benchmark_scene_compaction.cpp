@@ -0,0 +1,182 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures scene compaction after instance pruning on a synthetic scene with many instances
+// of LoD groups, single-threaded and multithreaded.
+
+#include "scene_compaction.h"
+#include "parallel.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int instances = 10000000;
+    int meshes = 100000;
+    int lod_levels = 3;
+    int materials = 20000;
+    int textures = 5000;
+    int pruning = 50; // percentage of meshes no longer instanced
+    int repeats = 3;
+    int threads = 0;
+    int seed = 1;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options]\n", binary);
+    printf("  --instances N   instances (default 10000000)\n");
+    printf("  --meshes N      meshes, each with its own parameterized mesh (default 100000)\n");
+    printf("  --lod-levels N  parameterized meshes per LoD group, 1 for no LoDs (default 3)\n");
+    printf("  --materials N   materials (default 20000)\n");
+    printf("  --textures N    textures (default 5000)\n");
+    printf("  --pruning N     percentage of LoD groups without instances (default 50)\n");
+    printf("  --repeats N     timed repetitions, the best one is reported (default 3)\n");
+    printf("  --threads N     worker threads, 0 for all cores (default 0)\n");
+    printf("  --seed N        random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--instances") opt.instances = int_value;
+        else if (arg == "--meshes") opt.meshes = int_value;
+        else if (arg == "--lod-levels") opt.lod_levels = int_value;
+        else if (arg == "--materials") opt.materials = int_value;
+        else if (arg == "--textures") opt.textures = int_value;
+        else if (arg == "--pruning") opt.pruning = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--threads") opt.threads = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.meshes < 1 || opt.lod_levels < 1 || opt.materials < 1 || opt.repeats < 1)
+        throw_error("Need at least one mesh, LoD level, material and repetition");
+    if (opt.pruning >= 100)
+        throw_error("Pruning has to leave some meshes instanced");
+    return true;
+}
+
+Scene make_pruned_scene(Options const& opt) {
+    std::mt19937 rng(uint32_t(opt.seed));
+    Scene scene;
+
+    scene.textures.resize(opt.textures);
+    scene.materials.resize(opt.materials);
+    scene.material_names.resize(opt.materials);
+    for (int i = 0; i < opt.materials; ++i) {
+        BaseMaterial& material = scene.materials[i];
+        if (opt.textures > 0) {
+            material.normal_map = int(rng() % uint32_t(opt.textures));
+            uint32_t tex_id = TEXTURED_PARAM_MASK;
+            SET_TEXTURE_ID(tex_id, rng() % uint32_t(opt.textures));
+            memcpy(reinterpret_cast<char*>(&material.roughness), &tex_id, sizeof(tex_id));
+        }
+        scene.material_names[i] = "material" + std::to_string(i);
+    }
+
+    scene.meshes.resize(opt.meshes);
+    scene.parameterized_meshes.resize(opt.meshes);
+    for (int i = 0; i < opt.meshes; ++i) {
+        ParameterizedMesh& pmesh = scene.parameterized_meshes[i];
+        pmesh.mesh_id = i;
+        pmesh.material_offsets = { int(rng() % uint32_t(opt.materials)), int(rng() % uint32_t(opt.materials)) };
+    }
+    std::vector<int> group_roots;
+    for (int i = 0; i < opt.meshes; i += opt.lod_levels) {
+        group_roots.push_back(i);
+        if (opt.lod_levels == 1)
+            continue;
+        LodGroup group;
+        for (int j = i, je = std::min(i + opt.lod_levels, opt.meshes); j < je; ++j) {
+            group.mesh_ids.push_back(j);
+            group.detail_reduction.push_back(0.5f * float(j - i));
+            scene.parameterized_meshes[j].lod_group = ilen(scene.lod_groups);
+        }
+        scene.lod_groups.push_back(group);
+    }
+
+    // instances of the groups that survived pruning
+    std::shuffle(group_roots.begin(), group_roots.end(), rng);
+    int instanced_groups = std::max(ilen(group_roots) * (100 - opt.pruning) / 100, 1);
+    scene.instances.resize(opt.instances);
+    for (int i = 0; i < opt.instances; ++i) {
+        scene.instances[i].transform_index = uint32_t(i);
+        scene.instances[i].parameterized_mesh_id = group_roots[rng() % uint32_t(instanced_groups)];
+    }
+    return scene;
+}
+
+// Best time of compacting copies of the scene, the last compacted scene is returned
+double best_compaction_time(Scene const& scene, int repeats, int thread_count, Scene &compacted, SceneCompactionStats &stats) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        compacted = scene;
+        auto start_time = std::chrono::steady_clock::now();
+        stats = compact_scene(compacted, thread_count);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Scene scene = make_pruned_scene(opt);
+    int thread_count = opt.threads > 0 ? opt.threads : default_thread_count();
+    printf("Scene: %s instances, %s meshes in %s LoD groups, %s materials, %s textures, %d threads\n"
+        , pretty_print_count(double(opt.instances)).c_str(), pretty_print_count(double(opt.meshes)).c_str()
+        , pretty_print_count(double(scene.lod_groups.size())).c_str(), pretty_print_count(double(opt.materials)).c_str()
+        , pretty_print_count(double(opt.textures)).c_str(), thread_count);
+
+    Scene serial_scene, parallel_scene;
+    SceneCompactionStats serial_stats, stats;
+    double serial_time = best_compaction_time(scene, opt.repeats, 1, serial_scene, serial_stats);
+    double parallel_time = best_compaction_time(scene, opt.repeats, opt.threads, parallel_scene, stats);
+    printf("Removed %d parameterized meshes, %d meshes, %d LoD groups, %d materials and %d textures\n"
+        , int_cast(stats.num_removed_pmeshes), int_cast(stats.num_removed_meshes), int_cast(stats.num_removed_lod_groups)
+        , int_cast(stats.num_removed_materials), int_cast(stats.num_removed_textures));
+    printf("Compacted on 1 thread in %.3f ms: %.1f M instances/s\n"
+        , serial_time * 1.e3, double(opt.instances) / serial_time * 1.e-6);
+    printf("Compacted on %d threads in %.3f ms: %.1f M instances/s (%.2fx)\n"
+        , thread_count, parallel_time * 1.e3, double(opt.instances) / parallel_time * 1.e-6, serial_time / parallel_time);
+
+    bool same = serial_stats.num_removed_pmeshes == stats.num_removed_pmeshes
+        && serial_stats.num_removed_materials == stats.num_removed_materials
+        && serial_scene.material_names == parallel_scene.material_names
+        && std::equal(serial_scene.instances.begin(), serial_scene.instances.end(), parallel_scene.instances.begin()
+            , [](Instance const& a, Instance const& b) { return a.parameterized_mesh_id == b.parameterized_mesh_id; });
+    if (!same) {
+        printf("Single-threaded and multithreaded compaction differ\n");
+        return 1;
+    }
+    return 0;
+}
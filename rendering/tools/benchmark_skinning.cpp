@@ -0,0 +1,188 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures the throughput of the multithreaded CPU skinning reference on a synthetic
+// skinned mesh with random bone influences, in the same encoding as .vks files.
+
+#include "skinning.h"
+#include "parallel.h"
+#include "error_io.h"
+#include <vkr.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int vertices = 1000000;
+    int bones = 64;
+    int tuples = 1024;
+    int influences = 4; // maximum number of bones per vertex
+    int repeats = 5;
+    int threads = 0;
+    int seed = 1;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options]\n", binary);
+    printf("  --vertices N    skinned vertices (default 1000000)\n");
+    printf("  --bones N       animated bone transforms (default 64)\n");
+    printf("  --tuples N      bone index tuples shared by the vertices (default 1024)\n");
+    printf("  --influences N  maximum bones influencing a vertex, 1 to 6 (default 4)\n");
+    printf("  --repeats N     timed repetitions, the best one is reported (default 5)\n");
+    printf("  --threads N     worker threads, 0 for all cores (default 0)\n");
+    printf("  --seed N        random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--vertices") opt.vertices = int_value;
+        else if (arg == "--bones") opt.bones = int_value;
+        else if (arg == "--tuples") opt.tuples = int_value;
+        else if (arg == "--influences") opt.influences = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--threads") opt.threads = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.vertices < 1 || opt.bones < 1 || opt.tuples < 1 || opt.repeats < 1)
+        throw_error("Need at least one vertex, bone, tuple and repetition");
+    if (opt.influences < 1 || opt.influences > SKINNING_MAX_INFLUENCES)
+        throw_error("Influences have to be in [1, %d]", SKINNING_MAX_INFLUENCES);
+    // singleton vertices store transform indices in place of tuple indices
+    if (uint32_t(opt.bones) >= SKINNING_TUPLE_INDEX_COUNT || uint32_t(opt.tuples) > SKINNING_TUPLE_INDEX_COUNT)
+        throw_error("Blend attributes address at most %u bones and tuples", SKINNING_TUPLE_INDEX_COUNT);
+    return true;
+}
+
+template <class Fn>
+double best_time(int repeats, Fn&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+// Transform 0 places the instance, transforms 1 to bones are animated over two frames
+Scene make_skinned_scene(Options const& opt) {
+    std::mt19937 rng(uint32_t(opt.seed));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    AnimationData anim;
+    anim.numStaticTransforms = 1;
+    anim.numAnimatedTransforms = uint64_t(opt.bones);
+    anim.numFrames = 2;
+    anim.animationStep = 1.0f;
+    std::vector<unsigned char> quantized(anim.size_in_bytes());
+    for (int t = 0; t < 1 + 2 * opt.bones; ++t) {
+        float angle = t == 0 ? 0.0f : 2.0f * uniform(rng);
+        float c = std::cos(angle), s = std::sin(angle);
+        float matrix[4][3] = { { c, s, 0.0f }, { -s, c, 0.0f }, { 0.0f, 0.0f, 1.0f }
+                             , { uniform(rng), uniform(rng), uniform(rng) } };
+        vkr_quantize_transform(quantized.data() + size_t(t) * VKR_QUANTIZED_TRANSFORM_SIZE, matrix);
+    }
+    anim.quantized = mapped_vector<unsigned char>(std::move(quantized));
+
+    std::vector<uint16_t> tuples(size_t(opt.tuples) * SKINNING_MAX_INFLUENCES);
+    for (auto& bone : tuples)
+        bone = uint16_t(1 + rng() % uint32_t(opt.bones));
+    anim.bone_index_tuples = mapped_vector<uint16_t>(std::move(tuples));
+
+    std::vector<glm::vec3> positions(opt.vertices), normals(opt.vertices);
+    std::vector<uint32_t> blend_attributes(opt.vertices);
+    for (int i = 0; i < opt.vertices; ++i) {
+        positions[i] = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        normals[i] = glm::normalize(glm::vec3(uniform(rng), uniform(rng), 1.0f));
+
+        int influences = 1 + int(rng() % uint32_t(opt.influences));
+        BlendAttributes attributes = { };
+        float sum = 0.0f;
+        for (int j = SKINNING_MAX_INFLUENCES - influences; j < SKINNING_MAX_INFLUENCES; ++j)
+            sum += (attributes.weights[j] = 0.05f + uniform(rng));
+        for (float& w : attributes.weights)
+            w /= sum;
+        std::sort(attributes.weights, attributes.weights + SKINNING_MAX_INFLUENCES);
+        attributes.tuple_index = influences == 1 ? 1 + rng() % uint32_t(opt.bones) : rng() % uint32_t(opt.tuples);
+        blend_attributes[i] = encode_blend_attributes(attributes);
+    }
+
+    Geometry geom;
+    geom.vertices = mapped_vector<void>(GenericBuffer(std::move(positions)));
+    geom.normals = mapped_vector<void>(GenericBuffer(std::move(normals)));
+    geom.blend_attributes = mapped_vector<uint32_t>(std::move(blend_attributes));
+    geom.format_flags = Geometry::ImplicitIndices;
+
+    Scene scene;
+    scene.meshes.push_back(Mesh({ geom }));
+    scene.meshes[0].flags = Mesh::Dynamic | Mesh::Skinned;
+    scene.parameterized_meshes.resize(1);
+    scene.parameterized_meshes[0].mesh_id = 0;
+    scene.animation_data.push_back(anim);
+    scene.instances.resize(1);
+    scene.instances[0].parameterized_mesh_id = 0;
+    return scene;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Scene scene = make_skinned_scene(opt);
+    Geometry const& geom = scene.meshes[0].geometries[0];
+    AnimationData const& anim = scene.animation_data[0];
+    int thread_count = opt.threads > 0 ? opt.threads : default_thread_count();
+    printf("Skinned mesh: %d vertices, %d bones, %d tuples, up to %d influences, %d threads\n"
+        , opt.vertices, opt.bones, opt.tuples, opt.influences, thread_count);
+
+    SkinningPalette palette;
+    palette.initialize(scene, scene.instances[0]);
+    uint32_t frame = 0;
+    double palette_time = best_time(opt.repeats, [&]() {
+        palette.update(anim, scene.instances[0], frame);
+        frame ^= 1;
+    });
+    printf("Updated %d bone transforms in %.3f ms\n", int(palette.bone_transforms.size()), palette_time * 1.e3);
+
+    std::vector<glm::vec3> positions(opt.vertices), normals(opt.vertices);
+    double position_time = best_time(opt.repeats, [&]() {
+        skin_geometry(geom, anim, palette, positions.data(), nullptr, opt.threads);
+    });
+    printf("Skinned positions in %.3f ms: %.1f M vertices/s\n"
+        , position_time * 1.e3, double(opt.vertices) / position_time * 1.e-6);
+
+    double full_time = best_time(opt.repeats, [&]() {
+        skin_geometry(geom, anim, palette, positions.data(), normals.data(), opt.threads);
+    });
+    printf("Skinned positions and normals in %.3f ms: %.1f M vertices/s\n"
+        , full_time * 1.e3, double(opt.vertices) / full_time * 1.e-6);
+    return 0;
+}
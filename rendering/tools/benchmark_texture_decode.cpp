@@ -0,0 +1,153 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Measures CPU decoding of block compressed textures with full mip chains, single-threaded and
+// multithreaded, and optionally the import of loose image files given after the options.
+
+#include "image.h"
+#include "parallel.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int size = 4096;
+    int repeats = 3;
+    int threads = 0;
+    int mips = 1; // generate mips for imported files
+    int seed = 1;
+    std::vector<std::string> files;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options] [image files]\n", binary);
+    printf("  --size N        width and height of the synthetic textures (default 4096)\n");
+    printf("  --repeats N     timed repetitions, the best one is reported (default 3)\n");
+    printf("  --threads N     worker threads, 0 for all cores (default 0)\n");
+    printf("  --mips N        1 to generate mip chains for imported files (default 1)\n");
+    printf("  --seed N        random seed (default 1)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (arg.compare(0, 2, "--") != 0) {
+            opt.files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1 || int_value < 0)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--size") opt.size = int_value;
+        else if (arg == "--repeats") opt.repeats = int_value;
+        else if (arg == "--threads") opt.threads = int_value;
+        else if (arg == "--mips") opt.mips = int_value;
+        else if (arg == "--seed") opt.seed = int_value;
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.size < 1 || opt.repeats < 1)
+        throw_error("Need a positive texture size and at least one repetition");
+    return true;
+}
+
+template <class F>
+double best_time(int repeats, F&& fn) {
+    double best = 1.e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start_time = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    return best;
+}
+
+// Random blocks with a full mip chain, both endpoint orders occur
+Image random_blocks(int bc_format, int size, std::mt19937 &rng) {
+    Image image = {
+        .name = "bc" + std::to_string(bc_format),
+        .width = size,
+        .height = size,
+        .channels = 4,
+        .bcFormat = bc_format
+    };
+    size_t block_bytes = size_t(image.bits_per_pixel()) * 2;
+    size_t total_bytes = 0;
+    for (int w = size, h = size, i = 0, ie = image.max_mip_levels(); i < ie; ++i) {
+        total_bytes += size_t((w + 3) / 4) * ((h + 3) / 4) * block_bytes;
+        if (w > 1) w /= 2;
+        if (h > 1) h /= 2;
+    }
+    std::vector<uint8_t> blocks(total_bytes);
+    for (auto& b : blocks)
+        b = uint8_t(rng());
+    image.img = Buffer<uint8_t>(std::move(blocks));
+    return image;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(uint32_t(opt.seed));
+    int thread_count = opt.threads > 0 ? opt.threads : default_thread_count();
+    printf("Decoding %dx%d textures with mip chains, %d threads\n", opt.size, opt.size, thread_count);
+    for (int bc_format : { 1, 3, 5 }) {
+        Image image = random_blocks(bc_format, opt.size, rng);
+        Buffer<uint8_t> serial_scratch = nullptr, parallel_scratch = nullptr;
+        double serial_time = best_time(opt.repeats, [&]() { image.decompressBytes(serial_scratch, 1); });
+        double parallel_time = best_time(opt.repeats, [&]() { image.decompressBytes(parallel_scratch, opt.threads); });
+        double texels = double(serial_scratch.nbytes() / 4);
+        printf("BC%d: 1 thread %.3f ms (%.1f M texels/s), %d threads %.3f ms (%.1f M texels/s, %.2fx)\n"
+            , bc_format, serial_time * 1.e3, texels / serial_time * 1.e-6
+            , thread_count, parallel_time * 1.e3, texels / parallel_time * 1.e-6, serial_time / parallel_time);
+        if (serial_scratch.get_vector() != parallel_scratch.get_vector()) {
+            printf("Single-threaded and multithreaded decoding differ\n");
+            return 1;
+        }
+    }
+
+    if (!opt.files.empty()) {
+        std::vector<ImageFile> files;
+        for (auto const& file : opt.files)
+            files.push_back({ file, file, SRGB });
+        size_t bytes = 0;
+        double serial_time = best_time(opt.repeats, [&]() {
+            for (auto const& file : files)
+                bytes = Image::fromFile(file.file, file.name, file.color_space, opt.mips != 0).img.nbytes();
+        });
+        double parallel_time = best_time(opt.repeats, [&]() {
+            bytes = 0;
+            for (auto const& image : Image::fromFiles(files, opt.mips != 0, opt.threads))
+                bytes += image.img.nbytes();
+        });
+        printf("Imported %d files (%s bytes) on 1 thread in %.3f ms, on %d threads in %.3f ms (%.2fx)\n"
+            , ilen(files), pretty_print_count(double(bytes)).c_str(), serial_time * 1.e3
+            , thread_count, parallel_time * 1.e3, serial_time / parallel_time);
+    }
+    return 0;
+}
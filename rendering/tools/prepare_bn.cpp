@@ -0,0 +1,427 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Generates the blue-noise dithered sampling tables used by rendering/pointsets/bn_rng.glsl,
+// following "A Low-Discrepancy Sampler that Distributes Monte Carlo Errors as a Blue Noise
+// in Screen Space" by Heitz et al.: an Owen-scrambled Sobol sequence plus per-pixel
+// scrambling and ranking keys, which are permuted over the tile such that the per-pixel
+// integration errors of a set of test integrands form a blue noise pattern.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "sobol_tables_src.h"
+#include "bn_tables.h"
+#include "parallel.h"
+#include "error_io.h"
+
+namespace {
+
+// sample values are fetched as (0.5 + value) / 256 by bn_rng.glsl
+const int VALUE_BITS = 8;
+const int VALUE_COUNT = 1 << VALUE_BITS;
+
+struct Options {
+    std::string output_file = "bn_tables.bin";
+    int sample_count = 256;
+    int dimensions = 256;
+    int tile_size = 128;
+    int scrambling_dimensions = 8;
+    std::vector<int> spp = { 1, 4, 16, 256 };
+    int integrands = 16;
+    int iterations = 32; // swap attempts per pixel
+    int threads = 0;
+    uint32_t seed = 0;
+};
+
+uint32_t hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// nested uniform scrambling of a 32-bit fixed-point value, using the hash-based
+// permutation by Laine and Karras with the improved constants of Burley
+uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+uint32_t sobol_sample(uint32_t index, int dim) {
+    uint32_t result = 0;
+    for (int bit = 0; index != 0; index >>= 1, ++bit)
+        if ((index & 1) != 0)
+            result ^= sobol_matrix[dim * SobolMatrixSize + bit];
+    return result;
+}
+
+std::vector<uint32_t> generate_sequence(Options const& opt) {
+    std::vector<uint32_t> sequence(size_t(opt.sample_count) * opt.dimensions);
+    parallel_for(opt.dimensions, [&](int d) {
+        uint32_t dim_seed = hash_u32(opt.seed ^ hash_u32(uint32_t(d) + 0x9e3779b9u));
+        for (int s = 0; s < opt.sample_count; ++s)
+            sequence[d + size_t(s) * opt.dimensions] = owen_scramble(sobol_sample(uint32_t(s), d), dim_seed) >> (32 - VALUE_BITS);
+    }, opt.threads);
+    return sequence;
+}
+
+// Optimizes the keys of one or two consecutive scrambling dimensions of one tile
+struct TileGroupOptimizer {
+    Options const& opt;
+    std::vector<uint32_t> const& sequence;
+    int spp;
+    int dim_begin;
+    int dim_count;
+
+    std::mt19937 rng;
+    int pixel_count = 0;
+    int levels = 0; // progressive sample counts 1, 2, 4, ..., spp
+    int error_dims = 0;
+
+    std::vector<uint32_t> scrambling_keys; // per key, dim_count entries
+    std::vector<uint32_t> ranking_keys;
+    std::vector<float> errors; // per key, error_dims entries
+    std::vector<int> key_of_pixel;
+
+    int radius = 0;
+    std::vector<float> spatial_weights;
+    float inv_error_scale = 1.0f;
+
+    double initial_energy = 0.0;
+    double final_energy = 0.0;
+
+    TileGroupOptimizer(Options const& opt, std::vector<uint32_t> const& sequence, int spp, int dim_begin, int dim_count)
+        : opt(opt), sequence(sequence), spp(spp), dim_begin(dim_begin), dim_count(dim_count)
+        , rng(hash_u32(opt.seed ^ hash_u32(uint32_t(spp) * 0x10001u + uint32_t(dim_begin)))) {
+        pixel_count = opt.tile_size * opt.tile_size;
+        for (int n = 1; n <= spp; n *= 2)
+            ++levels;
+        error_dims = opt.integrands * levels;
+    }
+
+    // Estimator errors of random heaviside integrands on the quantized sample domain
+    void compute_errors() {
+        int domain_size = dim_count == 2 ? VALUE_COUNT * VALUE_COUNT : VALUE_COUNT;
+        std::vector<unsigned char> integrand_values(size_t(opt.integrands) * domain_size);
+        std::vector<double> references(opt.integrands);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (int k = 0; k < opt.integrands; ++k) {
+            float cx = uniform(rng), cy = uniform(rng);
+            float angle = 2.0f * 3.14159265f * uniform(rng);
+            float nx = std::cos(angle), ny = std::sin(angle);
+            int covered = 0;
+            for (int i = 0; i < domain_size; ++i) {
+                float x = (0.5f + float(i % VALUE_COUNT)) / float(VALUE_COUNT);
+                float y = (0.5f + float(i / VALUE_COUNT)) / float(VALUE_COUNT);
+                bool inside = dim_count == 2 ? (x - cx) * nx + (y - cy) * ny > 0.0f : x < cx;
+                integrand_values[size_t(k) * domain_size + i] = (unsigned char) inside;
+                covered += int(inside);
+            }
+            references[k] = double(covered) / double(domain_size);
+        }
+
+        scrambling_keys.resize(size_t(pixel_count) * dim_count);
+        ranking_keys.resize(pixel_count);
+        for (auto& key : scrambling_keys)
+            key = rng() % VALUE_COUNT;
+        for (auto& key : ranking_keys)
+            key = rng() % uint32_t(spp);
+
+        errors.resize(size_t(pixel_count) * error_dims);
+        std::vector<double> sums(opt.integrands);
+        for (int key = 0; key < pixel_count; ++key) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            float* key_errors = &errors[size_t(key) * error_dims];
+            for (int s = 0, level = 0; s < spp; ++s) {
+                size_t ranked = size_t(uint32_t(s) ^ ranking_keys[key]);
+                int point = 0;
+                for (int j = 0; j < dim_count; ++j) {
+                    uint32_t value = sequence[dim_begin + j + ranked * opt.dimensions] ^ scrambling_keys[size_t(key) * dim_count + j];
+                    point += int(value) << (VALUE_BITS * j);
+                }
+                for (int k = 0; k < opt.integrands; ++k)
+                    sums[k] += integrand_values[size_t(k) * domain_size + point];
+                // record at power-of-two sample counts
+                if (((s + 1) & s) == 0) {
+                    for (int k = 0; k < opt.integrands; ++k)
+                        key_errors[level * opt.integrands + k] = float(sums[k] / double(s + 1) - references[k]);
+                    ++level;
+                }
+            }
+        }
+
+        // errors shrink with the sample count, normalize such that all levels contribute
+        for (int level = 0; level < levels; ++level) {
+            double sum_sq = 0.0;
+            for (int key = 0; key < pixel_count; ++key)
+                for (int k = 0; k < opt.integrands; ++k) {
+                    float e = errors[size_t(key) * error_dims + level * opt.integrands + k];
+                    sum_sq += double(e) * e;
+                }
+            double rms = std::sqrt(sum_sq / double(pixel_count * opt.integrands));
+            float scale = rms > 0.0 ? float(1.0 / rms) : 0.0f;
+            for (int key = 0; key < pixel_count; ++key)
+                for (int k = 0; k < opt.integrands; ++k)
+                    errors[size_t(key) * error_dims + level * opt.integrands + k] *= scale;
+        }
+    }
+
+    float error_distance_sq(int key_a, int key_b) const {
+        float const* a = &errors[size_t(key_a) * error_dims];
+        float const* b = &errors[size_t(key_b) * error_dims];
+        float d = 0.0f;
+        for (int i = 0; i < error_dims; ++i)
+            d += (a[i] - b[i]) * (a[i] - b[i]);
+        return d;
+    }
+
+    void setup_energy() {
+        // spatial falloff of Georgiev and Fajardo, window must not wrap onto itself
+        const float sigma_i = 2.1f;
+        radius = std::min(6, (opt.tile_size - 1) / 2);
+        int window = 2 * radius + 1;
+        spatial_weights.resize(window * window);
+        for (int dy = -radius; dy <= radius; ++dy)
+            for (int dx = -radius; dx <= radius; ++dx)
+                spatial_weights[(dy + radius) * window + dx + radius] = std::exp(-float(dx * dx + dy * dy) / (sigma_i * sigma_i));
+
+        double mean_distance_sq = 0.0;
+        const int pair_samples = 4096;
+        for (int i = 0; i < pair_samples; ++i)
+            mean_distance_sq += error_distance_sq(int(rng() % uint32_t(pixel_count)), int(rng() % uint32_t(pixel_count)));
+        mean_distance_sq /= double(pair_samples);
+        inv_error_scale = mean_distance_sq > 0.0 ? float(1.0 / mean_distance_sq) : 0.0f;
+
+        key_of_pixel.resize(pixel_count);
+        for (int i = 0; i < pixel_count; ++i)
+            key_of_pixel[i] = i;
+    }
+
+    // energy between the given key placed at the given pixel and its neighbors,
+    // ignoring the neighbor at the excluded pixel
+    double pixel_energy(int pixel, int key, int excluded_pixel) const {
+        int mask = opt.tile_size - 1;
+        int x = pixel & mask, y = pixel / opt.tile_size;
+        int window = 2 * radius + 1;
+        double energy = 0.0;
+        for (int dy = -radius; dy <= radius; ++dy)
+            for (int dx = -radius; dx <= radius; ++dx) {
+                int neighbor = ((y + dy) & mask) * opt.tile_size + ((x + dx) & mask);
+                if (neighbor == pixel || neighbor == excluded_pixel)
+                    continue;
+                float d = error_distance_sq(key, key_of_pixel[neighbor]);
+                energy += spatial_weights[(dy + radius) * window + dx + radius] * std::exp(-d * inv_error_scale);
+            }
+        return energy;
+    }
+
+    double total_energy() const {
+        double energy = 0.0;
+        for (int p = 0; p < pixel_count; ++p)
+            energy += pixel_energy(p, key_of_pixel[p], -1);
+        return 0.5 * energy;
+    }
+
+    void optimize() {
+        if (radius < 1) {
+            initial_energy = final_energy = 0.0;
+            return;
+        }
+        initial_energy = total_energy();
+        int mask = opt.tile_size - 1;
+        int window = 2 * radius + 1;
+        long long swap_count = (long long) opt.iterations * pixel_count;
+        for (long long i = 0; i < swap_count; ++i) {
+            int p = int(rng() % uint32_t(pixel_count));
+            uint32_t offset = rng() % uint32_t(window * window);
+            int dx = int(offset % uint32_t(window)) - radius, dy = int(offset / uint32_t(window)) - radius;
+            int q = (((p / opt.tile_size) + dy) & mask) * opt.tile_size + (((p & mask) + dx) & mask);
+            if (p == q)
+                continue;
+            int key_p = key_of_pixel[p], key_q = key_of_pixel[q];
+            double before = pixel_energy(p, key_p, q) + pixel_energy(q, key_q, p);
+            double after = pixel_energy(p, key_q, q) + pixel_energy(q, key_p, p);
+            if (after < before)
+                std::swap(key_of_pixel[p], key_of_pixel[q]);
+        }
+        final_energy = total_energy();
+    }
+
+    void store(BNTables::Tile &tile) const {
+        for (int p = 0; p < pixel_count; ++p) {
+            int key = key_of_pixel[p];
+            for (int j = 0; j < dim_count; ++j) {
+                size_t idx = size_t(p) * opt.scrambling_dimensions + dim_begin + j;
+                tile.scrambling_yx_d[idx] = scrambling_keys[size_t(key) * dim_count + j];
+                // dimension pairs share their ranking keys
+                tile.ranking_yx_d[idx] = ranking_keys[key];
+            }
+        }
+    }
+};
+
+bool is_power_of_two(int v) {
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options] [output file, default: bn_tables.bin]\n", binary);
+    printf("  --samples N                 length of the sample sequence (default 256)\n");
+    printf("  --dimensions N              dimensions of the sample sequence (default 256)\n");
+    printf("  --tile-size N               width and height of the scrambling tiles (default 128)\n");
+    printf("  --scrambling-dimensions N   optimized dimensions per pixel (default 8)\n");
+    printf("  --spp N,N,...               sample counts to optimize tiles for (default 1,4,16,256)\n");
+    printf("  --integrands N              test integrands per dimension pair (default 16)\n");
+    printf("  --iterations N              swap attempts per pixel (default 32)\n");
+    printf("  --threads N                 worker threads (default: all hardware threads)\n");
+    printf("  --seed N                    random seed (default 0)\n");
+    printf("Note: tables are loaded by rptr only if they match the layout in rendering/pointsets/bn_data.h\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (arg.compare(0, 2, "--") != 0) {
+            opt.output_file = arg;
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        if (arg == "--spp") {
+            opt.spp.clear();
+            for (char const* cursor = value; *cursor; ) {
+                char* next = nullptr;
+                opt.spp.push_back(int(std::strtol(cursor, &next, 10)));
+                if (next == cursor)
+                    throw_error("Invalid sample count list \"%s\"", value);
+                cursor = (*next == ',') ? next + 1 : next;
+            }
+            continue;
+        }
+        int int_value = 0;
+        if (sscanf(value, "%i", &int_value) != 1)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--samples") opt.sample_count = int_value;
+        else if (arg == "--dimensions") opt.dimensions = int_value;
+        else if (arg == "--tile-size") opt.tile_size = int_value;
+        else if (arg == "--scrambling-dimensions") opt.scrambling_dimensions = int_value;
+        else if (arg == "--integrands") opt.integrands = int_value;
+        else if (arg == "--iterations") opt.iterations = int_value;
+        else if (arg == "--threads") opt.threads = int_value;
+        else if (arg == "--seed") opt.seed = uint32_t(int_value);
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+
+    if (!is_power_of_two(opt.sample_count) || !is_power_of_two(opt.dimensions)
+     || !is_power_of_two(opt.tile_size) || !is_power_of_two(opt.scrambling_dimensions))
+        throw_error("Sample count, dimensions, tile size and scrambling dimensions have to be powers of two");
+    if (opt.dimensions > SobolDimensions)
+        throw_error("At most %d dimensions supported", SobolDimensions);
+    if (opt.scrambling_dimensions > opt.dimensions)
+        throw_error("Cannot scramble more than %d dimensions", opt.dimensions);
+    for (int spp : opt.spp)
+        if (!is_power_of_two(spp) || spp > opt.sample_count)
+            throw_error("Optimized sample counts have to be powers of two up to %d, got %d", opt.sample_count, spp);
+    if (opt.integrands < 1 || opt.iterations < 0)
+        throw_error("Need at least one integrand and non-negative iterations");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto seconds_since_start = [&start_time]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    };
+
+    BNTables tables;
+    tables.sample_count = opt.sample_count;
+    tables.dimensions = opt.dimensions;
+    tables.tile_size = opt.tile_size;
+    tables.scrambling_dimensions = opt.scrambling_dimensions;
+    tables.sequence_spp_d = generate_sequence(opt);
+
+    tables.tiles.resize(opt.spp.size());
+    for (int i = 0, ie = int(opt.spp.size()); i < ie; ++i) {
+        tables.tiles[i].spp = opt.spp[i];
+        tables.tiles[i].scrambling_yx_d.resize(tables.tile_entry_count());
+        tables.tiles[i].ranking_yx_d.resize(tables.tile_entry_count());
+    }
+
+    // dimension pairs of all tiles are optimized independently, and deterministically
+    // regardless of the thread count; expensive high-spp tiles are handed out first
+    int group_count = (opt.scrambling_dimensions + 1) / 2;
+    int job_count = int(opt.spp.size()) * group_count;
+    std::vector<int> job_order(job_count);
+    for (int i = 0; i < job_count; ++i)
+        job_order[i] = i;
+    std::stable_sort(job_order.begin(), job_order.end(), [&](int a, int b) {
+        return opt.spp[a / group_count] > opt.spp[b / group_count];
+    });
+
+    try {
+        parallel_for(job_count, [&](int job_idx) {
+            int job = job_order[job_idx];
+            auto& tile = tables.tiles[job / group_count];
+            int dim_begin = job % group_count * 2;
+            int dim_count = std::min(2, opt.scrambling_dimensions - dim_begin);
+
+            TileGroupOptimizer optimizer(opt, tables.sequence_spp_d, tile.spp, dim_begin, dim_count);
+            optimizer.compute_errors();
+            optimizer.setup_energy();
+            optimizer.optimize();
+            optimizer.store(tile);
+            printf("%4d spp, dimensions %d-%d: energy %.1f -> %.1f (%.1f s)\n"
+                , tile.spp, dim_begin, dim_begin + dim_count - 1
+                , optimizer.initial_energy, optimizer.final_energy, seconds_since_start());
+        }, opt.threads);
+
+        write_bn_tables(opt.output_file, tables);
+    } catch (std::exception const&) {
+        return 1;
+    }
+
+    printf("Wrote %d tiles of %dx%dx%d keys, %d samples x %d dimensions to \"%s\" (%.1f s)\n"
+        , int(tables.tiles.size()), opt.tile_size, opt.tile_size, opt.scrambling_dimensions
+        , opt.sample_count, opt.dimensions, opt.output_file.c_str(), seconds_since_start());
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Reports SAH cost estimates of the BLAS of each mesh and of the TLAS over all instances of
+// a scene, before and after splitting oversized triangles.
+
+#include "bvh_quality.h"
+#include "instance_bounds.h"
+#include "scene.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::vector<std::string> files;
+    TriangleSplitParams split;
+    int leaf_size = 4;
+    int top = 10;
+};
+
+void print_usage(char const* binary) {
+    printf("Usage: %s [options] scene files...\n", binary);
+    printf("  --area-ratio X  split triangles with larger box/triangle area ratios (default 32)\n");
+    printf("  --min-extent X  keep triangles below this fraction of the mesh diagonal (default 0.01)\n");
+    printf("  --growth X      added triangles per input triangle at most (default 1)\n");
+    printf("  --leaf-size N   primitives per BLAS leaf at most (default 4)\n");
+    printf("  --top N         meshes with the largest cost reductions to list (default 10)\n");
+}
+
+bool parse_options(Options &opt, int argc, char const* const* argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+            return false;
+        if (arg.compare(0, 2, "--") != 0) {
+            opt.files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw_error("Missing value for option %s", arg.c_str());
+        char const* value = argv[++i];
+        float float_value = 0.0f;
+        if (sscanf(value, "%f", &float_value) != 1 || float_value < 0.0f)
+            throw_error("Invalid value \"%s\" for option %s", value, arg.c_str());
+        if (arg == "--area-ratio") opt.split.max_area_ratio = float_value;
+        else if (arg == "--min-extent") opt.split.min_relative_extent = float_value;
+        else if (arg == "--growth") opt.split.max_growth = float_value;
+        else if (arg == "--leaf-size") opt.leaf_size = int(float_value);
+        else if (arg == "--top") opt.top = int(float_value);
+        else
+            throw_error("Unknown option %s", arg.c_str());
+    }
+    if (opt.files.empty())
+        throw_error("Need at least one scene file");
+    if (opt.leaf_size < 1)
+        throw_error("Need at least one primitive per leaf");
+    return true;
+}
+
+struct MeshReport {
+    int mesh_id = -1;
+    int triangles_before = 0;
+    int triangles_after = 0;
+    BvhQuality before;
+    BvhQuality after;
+};
+
+std::vector<double> blas_costs(InstanceBoundsTracker const& tracker, Scene const& scene, std::vector<MeshReport> const& reports, bool split) {
+    std::vector<double> costs(tracker.active_meshes.size(), 0.0);
+    for (size_t i = 0; i < costs.size(); ++i) {
+        if (tracker.active_meshes[i] < 0)
+            continue;
+        MeshReport const& report = reports[scene.parameterized_meshes[tracker.active_meshes[i]].mesh_id];
+        costs[i] = split ? report.after.sah_cost : report.before.sah_cost;
+    }
+    return costs;
+}
+
+} // namespace
+
+int main(int argc, char const* const* argv) {
+    Options opt;
+    try {
+        if (!parse_options(opt, argc, argv)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    } catch (std::exception const&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Scene scene(opt.files);
+    SahCostParams sah;
+    sah.max_leaf_size = opt.leaf_size;
+
+    // meshes are split per parameterized mesh, with the first one that references them
+    std::vector<MeshReport> reports(scene.meshes.size());
+    std::vector<int> mesh_pms(scene.meshes.size(), -1);
+    for (int i = 0, ie = ilen(scene.parameterized_meshes); i < ie; ++i)
+        if (mesh_pms[scene.parameterized_meshes[i].mesh_id] < 0)
+            mesh_pms[scene.parameterized_meshes[i].mesh_id] = i;
+
+    auto start_time = std::chrono::steady_clock::now();
+    size_t triangles_before = 0, triangles_after = 0;
+    for (int i = 0, ie = ilen(scene.meshes); i < ie; ++i) {
+        MeshReport& report = reports[i];
+        report.mesh_id = i;
+        report.triangles_before = int_cast(scene.meshes[i].num_tris());
+        report.before = estimate_bvh_quality(mesh_triangle_bounds(scene.meshes[i]), sah);
+        report.triangles_after = report.triangles_before;
+        report.after = report.before;
+        if (mesh_pms[i] >= 0) {
+            Mesh mesh = scene.meshes[i];
+            ParameterizedMesh pm = scene.parameterized_meshes[mesh_pms[i]];
+            if (split_oversized_triangles(mesh, pm, opt.split)) {
+                report.triangles_after = int_cast(mesh.num_tris());
+                report.after = estimate_bvh_quality(mesh_triangle_bounds(mesh), sah);
+            }
+        }
+        triangles_before += size_t(report.triangles_before);
+        triangles_after += size_t(report.triangles_after);
+    }
+    double split_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    printf("Meshes: %d, triangles: %s -> %s (+%.1f%%), splitting and estimates took %.3f s\n"
+        , ilen(scene.meshes), pretty_print_count(double(triangles_before)).c_str(), pretty_print_count(double(triangles_after)).c_str()
+        , triangles_before ? 100.0 * (double(triangles_after) / double(triangles_before) - 1.0) : 0.0, split_time);
+
+    std::vector<MeshReport> ranked = reports;
+    std::sort(ranked.begin(), ranked.end(), [](MeshReport const& a, MeshReport const& b) {
+        return a.before.sah_cost - a.after.sah_cost > b.before.sah_cost - b.after.sah_cost;
+    });
+    for (int i = 0, ie = std::min(opt.top, ilen(ranked)); i < ie && ranked[i].after.sah_cost < ranked[i].before.sah_cost; ++i) {
+        MeshReport const& r = ranked[i];
+        printf("  mesh %d \"%s\": %d -> %d triangles, SAH %.2f -> %.2f, leaf area %.2f -> %.2f\n"
+            , r.mesh_id, scene.meshes[r.mesh_id].mesh_name.c_str(), r.triangles_before, r.triangles_after
+            , r.before.sah_cost, r.after.sah_cost, r.before.leaf_area, r.after.leaf_area);
+    }
+
+    // instance overlap shows in the TLAS leaf area, splitting only lowers the costs of the BLAS
+    InstanceBoundsTracker tracker;
+    tracker.reset(scene);
+    BvhQuality tlas_before = estimate_tlas_quality(tracker.world_bounds, blas_costs(tracker, scene, reports, false), sah);
+    BvhQuality tlas_after = estimate_tlas_quality(tracker.world_bounds, blas_costs(tracker, scene, reports, true), sah);
+    printf("TLAS: %d instances, depth %d, leaf area %.2f, SAH %.2f -> %.2f\n"
+        , tlas_before.primitive_count, tlas_before.max_depth, tlas_before.leaf_area, tlas_before.sah_cost, tlas_after.sah_cost);
+    return 0;
+}
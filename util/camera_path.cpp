@@ -0,0 +1,198 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "camera_path.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+glm::quat CameraPathKey::orientation_from(glm::vec3 dir, glm::vec3 up) {
+    // same frame as OrientedCamera::set_direction
+    dir = glm::normalize(dir);
+    glm::vec3 right = glm::normalize(glm::cross(up, -dir));
+    up = glm::normalize(glm::cross(-dir, right));
+    return glm::normalize(glm::quat_cast(glm::mat3(right, up, -dir)));
+}
+
+double CameraPath::end_time() const {
+    if (keys.empty())
+        return 0.0;
+    return keys.back().time + (loop ? loop_time : 0.0);
+}
+
+namespace {
+
+struct Pose {
+    glm::vec3 position;
+    glm::quat orientation;
+    float fov_y;
+};
+
+Pose interpolate(Pose const& a, Pose const& b, double t0, double t1, double t) {
+    float alpha = t1 > t0 ? float((t - t0) / (t1 - t0)) : 0.0f;
+    Pose r;
+    r.position = a.position + (b.position - a.position) * alpha;
+    r.orientation = glm::slerp(a.orientation, b.orientation, alpha);
+    r.fov_y = a.fov_y + (b.fov_y - a.fov_y) * alpha;
+    return r;
+}
+
+// Barry-Goldman evaluation of the Catmull-Rom segment between p[1] and p[2]
+Pose catmull_rom(Pose const p[4], double const times[4], double t) {
+    Pose a1 = interpolate(p[0], p[1], times[0], times[1], t);
+    Pose a2 = interpolate(p[1], p[2], times[1], times[2], t);
+    Pose a3 = interpolate(p[2], p[3], times[2], times[3], t);
+    Pose b1 = interpolate(a1, a2, times[0], times[2], t);
+    Pose b2 = interpolate(a2, a3, times[1], times[3], t);
+    return interpolate(b1, b2, times[1], times[2], t);
+}
+
+} // namespace
+
+CameraPathKey CameraPath::evaluate(double time) const {
+    if (keys.empty())
+        return CameraPathKey();
+    int const count = (int) keys.size();
+    double const period = end_time() - start_time();
+    if (loop && period > 0.0) {
+        time = std::fmod(time - start_time(), period);
+        if (time < 0.0)
+            time += period;
+        time += start_time();
+    }
+
+    CameraPathKey result;
+    result.time = time;
+    // hold the end poses
+    if (!loop && (count == 1 || time <= keys.front().time || time >= keys.back().time)) {
+        result = (count == 1 || time <= keys.front().time) ? keys.front() : keys.back();
+        result.time = time;
+        return result;
+    }
+
+    // last key with key time <= time, or the closing segment of a loop
+    int segment = count - 1;
+    for (int i = 0; i + 1 < count; ++i) {
+        if (time < keys[i + 1].time) {
+            segment = i;
+            break;
+        }
+    }
+
+    Pose p[4];
+    double times[4];
+    for (int k = 0; k < 4; ++k) {
+        int idx = segment - 1 + k;
+        double time_offset = 0.0;
+        if (loop) {
+            time_offset = std::floor(double(idx) / count) * period;
+            idx = (idx % count + count) % count;
+        } else
+            idx = std::min(std::max(idx, 0), count - 1);
+        CameraPathKey const& key = keys[idx];
+        p[k] = { key.position, key.orientation, key.fov_y };
+        times[k] = key.time + time_offset;
+    }
+    // quaternions q and -q describe the same rotation, stay in one hemisphere
+    for (int k = 1; k < 4; ++k)
+        if (glm::dot(p[k - 1].orientation, p[k].orientation) < 0.0f)
+            p[k].orientation = -p[k].orientation;
+    if (!loop) {
+        // extrapolate phantom keys at the ends, continuing the end segments
+        if (segment == 0) {
+            times[0] = times[1] - (times[2] - times[1]);
+            p[0] = interpolate(p[1], p[2], times[1], times[2], times[0]);
+        }
+        if (segment + 2 >= count) {
+            times[3] = times[2] + (times[2] - times[1]);
+            p[3] = interpolate(p[1], p[2], times[1], times[2], times[3]);
+        }
+    }
+
+    Pose pose = catmull_rom(p, times, time);
+    result.position = pose.position;
+    result.orientation = glm::normalize(pose.orientation);
+    result.fov_y = pose.fov_y;
+    return result;
+}
+
+void CameraPath::finalize() {
+    int fov_count = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i > 0 && !(keys[i].time > keys[i - 1].time))
+            throw_error("Camera path key times need to increase, key %d at %f follows %f"
+                , (int) i, keys[i].time, keys[i - 1].time);
+        keys[i].orientation = glm::normalize(keys[i].orientation);
+        if (i > 0 && glm::dot(keys[i - 1].orientation, keys[i].orientation) < 0.0f)
+            keys[i].orientation = -keys[i].orientation;
+        fov_count += keys[i].fov_y > 0.0f;
+    }
+    if (fov_count != 0 && fov_count != (int) keys.size())
+        throw_error("Either all or no camera path keys need a field of view");
+    if (loop && !(loop_time > 0.0))
+        throw_error("Looping camera paths need a positive loop time");
+}
+
+CameraPath load_camera_path(const std::string &file) {
+    std::ifstream in(file);
+    if (!in)
+        throw_error("Failed to open camera path %s", file.c_str());
+
+    CameraPath path;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string command;
+        if (!(tokens >> command))
+            continue;
+        if (command == "key") {
+            CameraPathKey key;
+            glm::vec3 dir, up;
+            if (!(tokens >> key.time
+                >> key.position.x >> key.position.y >> key.position.z
+                >> dir.x >> dir.y >> dir.z
+                >> up.x >> up.y >> up.z))
+                throw_error("Invalid camera path key in %s, line %d", file.c_str(), line_number);
+            if (!(tokens >> key.fov_y))
+                key.fov_y = 0.0f;
+            key.orientation = CameraPathKey::orientation_from(dir, up);
+            path.keys.push_back(key);
+        }
+        else if (command == "loop") {
+            if (!(tokens >> path.loop_time))
+                throw_error("Invalid camera path loop in %s, line %d", file.c_str(), line_number);
+            path.loop = true;
+        }
+        else
+            throw_error("Unknown camera path command \"%s\" in %s, line %d", command.c_str(), file.c_str(), line_number);
+    }
+    if (path.keys.empty())
+        throw_error("Camera path %s contains no keys", file.c_str());
+    path.finalize();
+    return path;
+}
+
+void save_camera_path(const std::string &file, CameraPath const& path) {
+    FILE* out = fopen(file.c_str(), "w");
+    if (!out)
+        throw_error("Failed to open camera path %s for writing", file.c_str());
+    fprintf(out, "# key <time> <position> <direction> <up> [<fov_y>]\n");
+    for (CameraPathKey const& key : path.keys) {
+        glm::vec3 dir = key.dir(), up = key.up();
+        fprintf(out, "key %.9g  %.9g %.9g %.9g  %.9g %.9g %.9g  %.9g %.9g %.9g"
+            , key.time, key.position.x, key.position.y, key.position.z
+            , dir.x, dir.y, dir.z, up.x, up.y, up.z);
+        if (key.fov_y > 0.0f)
+            fprintf(out, "  %.9g", key.fov_y);
+        fprintf(out, "\n");
+    }
+    if (path.loop)
+        fprintf(out, "loop %.9g\n", path.loop_time);
+    fclose(out);
+}
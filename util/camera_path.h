@@ -0,0 +1,53 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <string>
+#include <vector>
+
+// One pose of a camera path at a point on the animation timeline. The orientation
+// maps camera space (looking down -z, y up) to world space.
+struct CameraPathKey {
+    double time = 0.0;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float fov_y = 0.0f; // degrees, 0 keeps the current field of view
+
+    glm::vec3 dir() const { return orientation * glm::vec3(0.0f, 0.0f, -1.0f); }
+    glm::vec3 up() const { return orientation * glm::vec3(0.0f, 1.0f, 0.0f); }
+    static glm::quat orientation_from(glm::vec3 dir, glm::vec3 up);
+};
+
+// Smooth camera path through keys sorted by time, interpolated by a Catmull-Rom
+// spline over the (non-uniform) key times. Positions and field of view use the
+// Barry-Goldman pyramid of linear interpolations, orientations the same pyramid
+// of quaternion slerps, so rotations stay on the shortest arcs between keys. The
+// end segments continue the motion towards extrapolated phantom keys, such that
+// uniform motion is reproduced exactly. Before the first and after the last key
+// the path holds the end poses, unless it loops, in which case the last key
+// connects back to the first one after loop_time seconds.
+struct CameraPath {
+    std::vector<CameraPathKey> keys;
+    bool loop = false;
+    double loop_time = 1.0; // from the last key back to the first key
+
+    bool empty() const { return keys.empty(); }
+    double start_time() const { return keys.empty() ? 0.0 : keys.front().time; }
+    double end_time() const;
+
+    CameraPathKey evaluate(double time) const;
+
+    // Flips orientations into the hemisphere of their predecessors and checks
+    // that times are increasing, throws otherwise
+    void finalize();
+};
+
+// Text format, one key per line:
+//   key <time> <px> <py> <pz> <dx> <dy> <dz> <ux> <uy> <uz> [<fov_y>]
+// with position, view direction and up vector in the conventions of the camera
+// ini settings. Optional "loop <seconds>" closes the path. '#' starts comments.
+CameraPath load_camera_path(const std::string &file);
+void save_camera_path(const std::string &file, CameraPath const& path);
@@ -61,6 +61,9 @@ bool compare(const Image &ref, const Image &cmp, const std::string &errImg)
     const std::size_t numPixels = size_t(ref.image.width) * ref.image.height;
 
     bool equal = true;
+    // error metrics to compare renderers at equal time or sample counts
+    double squaredError = 0.0;
+    double relSquaredError = 0.0;
 
     std::vector<float> errorImage(ref.image.num_channels * numPixels);
     for (int z = 0; z < ref.image.num_channels; ++z) {
@@ -80,11 +83,19 @@ bool compare(const Image &ref, const Image &cmp, const std::string &errImg)
 
             *perr = relError;
 
+            const double diff = double(vref) - double(vcmp);
+            squaredError += diff * diff;
+            relSquaredError += diff * diff / (double(vref) * double(vref) + 1.e-2);
+
             if (relError > 1e-6f)
                 equal = false;
         }
     }
 
+    const double numValues = double(numPixels) * ref.image.num_channels;
+    std::cout << "RMSE " << std::sqrt(squaredError / numValues)
+              << ", relMSE " << relSquaredError / numValues << std::endl;
+
     const char *err = nullptr;
     SaveEXR(errorImage.data(), ref.image.width, ref.image.height,
             ref.image.num_channels, 0, errImg.c_str(), &err);
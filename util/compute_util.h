@@ -223,3 +223,28 @@ inline FP16 float_to_half(FP32 f)
     o.Sign = f.Sign;
     return o;
 }
+
+// half->float, from the same collection (half_to_float_fast4), handles denormals,
+// infinities and NaNs.
+inline FP32 half_to_float(FP16 h)
+{
+    static const FP32 magic = { 113 << 23 };
+    static const unsigned shifted_exp = 0x7c00 << 13; // exponent mask after shift
+    FP32 o;
+
+    o.u = (h.u & 0x7fff) << 13;     // exponent/mantissa bits
+    unsigned exp = shifted_exp & o.u;   // just the exponent
+    o.u += (127 - 15) << 23;        // exponent adjust
+
+    // handle exponent special cases
+    if (exp == shifted_exp) // Inf/NaN?
+        o.u += (128 - 16) << 23;    // extra exp adjust
+    else if (exp == 0) // Zero/Denormal?
+    {
+        o.u += 1 << 23;             // extra exp adjust
+        o.f -= magic.f;             // renormalize
+    }
+
+    o.u |= (h.u & 0x8000) << 16;    // sign bit
+    return o;
+}
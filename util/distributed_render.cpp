@@ -0,0 +1,201 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "distributed_render.h"
+#include "error_io.h"
+#include "util.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+static char const* const staged_image_extensions[] = { ".exr", ".png", ".pfm" };
+
+bool DistributedWorkerArgs::renders_frame(uint64_t frame) const {
+    return !active() || (frame >= first_frame && frame % uint64_t(worker_count) == uint64_t(slot));
+}
+
+std::vector<std::string> DistributedWorkerArgs::command_line(std::vector<std::string> const& base_args) const {
+    std::vector<std::string> args = base_args;
+    args.push_back("--distributed-worker");
+    args.push_back(std::to_string(slot));
+    args.push_back(std::to_string(worker_count));
+    args.push_back(std::to_string(first_frame));
+    args.push_back(staging_dir);
+    return args;
+}
+
+uint64_t offline_frame_sample_offset(uint64_t frame, int frame_spp) {
+    // consecutive frames use consecutive ranges of the sequences, as if rendered in one go
+    return frame * uint64_t(std::max(frame_spp, 1));
+}
+
+std::string distributed_manifest_path(std::string const& staging_dir, uint64_t frame) {
+    return staging_dir + "/" + to_stringf("%08llu", (unsigned long long) frame) + ".manifest";
+}
+
+void DistributedFrameStaging::begin_frame(uint64_t frame) {
+    this->frame = frame;
+    outputs.clear();
+}
+
+std::string DistributedFrameStaging::staged_prefix(std::string const& output_prefix) {
+    std::string staged = to_stringf("%08llu_%d", (unsigned long long) frame, (int) outputs.size());
+    outputs.push_back({ staged, output_prefix });
+    return staging_dir + "/" + staged;
+}
+
+void DistributedFrameStaging::commit_frame() {
+    std::string manifest = distributed_manifest_path(staging_dir, frame);
+    std::string pending = manifest + ".pending";
+    {
+        std::ofstream file(pending, std::ios::binary | std::ios::trunc);
+        for (auto& output : outputs)
+            file << output.first << '\t' << output.second << '\n';
+        if (!file)
+            throw_error("Failed to write distributed frame manifest %s", pending.c_str());
+    }
+    // images are only visible to the coordinator once complete
+    std::filesystem::rename(pending, manifest);
+    outputs.clear();
+}
+
+std::vector<uint64_t> distributed_committed_frames(std::string const& staging_dir) {
+    std::vector<uint64_t> frames;
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::directory_iterator(staging_dir, ec)) {
+        if (entry.path().extension() != ".manifest")
+            continue;
+        std::string stem = entry.path().stem().string();
+        if (stem.empty() || stem.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+        frames.push_back(std::stoull(stem));
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+static void move_file(std::string const& from, std::string const& to) {
+    std::error_code ec;
+    std::filesystem::rename(from, to, ec);
+    if (!ec)
+        return;
+    // across file systems
+    std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec)
+        throw_error("Failed to move distributed output %s to %s: %s", from.c_str(), to.c_str(), ec.message().c_str());
+    std::filesystem::remove(from, ec);
+}
+
+void distributed_merge_outputs(std::string const& staging_dir) {
+    for (uint64_t frame : distributed_committed_frames(staging_dir)) {
+        std::ifstream manifest(distributed_manifest_path(staging_dir, frame), std::ios::binary);
+        std::string line;
+        while (std::getline(manifest, line)) {
+            size_t separator = line.find('\t');
+            if (separator == std::string::npos)
+                continue;
+            std::string staged = staging_dir + "/" + line.substr(0, separator);
+            std::string output = line.substr(separator + 1);
+            for (char const* extension : staged_image_extensions) {
+                if (std::filesystem::is_regular_file(staged + extension))
+                    move_file(staged + extension, output + extension);
+            }
+        }
+    }
+}
+
+DistributedCoordinator::DistributedCoordinator()
+    : launch(launch_child_process)
+    , wait(wait_for_child_process) {
+}
+
+bool DistributedCoordinator::run(std::vector<std::string> const& base_args) {
+    struct Slot {
+        long long pid = -1;
+        uint64_t first_frame = 0;
+        int retries = 0;
+        bool done = false;
+    };
+    std::vector<Slot> slots(std::max(worker_count, 1));
+
+    std::error_code ec;
+    std::filesystem::create_directories(staging_dir, ec);
+    if (!directory_exists(staging_dir)) {
+        print_error("Cannot create staging directory %s for distributed rendering", staging_dir.c_str());
+        return false;
+    }
+    if (!distributed_committed_frames(staging_dir).empty()) {
+        print_error("Staging directory %s contains frames of another run", staging_dir.c_str());
+        return false;
+    }
+
+    auto launch_slot = [&](int slot_index) {
+        Slot& slot = slots[slot_index];
+        DistributedWorkerArgs worker;
+        worker.slot = slot_index;
+        worker.worker_count = (int) slots.size();
+        worker.first_frame = slot.first_frame;
+        worker.staging_dir = staging_dir;
+        slot.pid = launch(worker.command_line(base_args));
+        if (slot.pid < 0)
+            print_error("Failed to launch distributed worker %d", slot_index);
+        return slot.pid >= 0;
+    };
+
+    bool failed = false;
+    for (int i = 0; i < (int) slots.size(); ++i) {
+        slots[i].first_frame = uint64_t(i);
+        failed |= !launch_slot(i);
+    }
+    println(CLL::INFORMATION, "Distributed rendering with %d workers, staging in %s", (int) slots.size(), staging_dir.c_str());
+
+    long long pid;
+    int exit_code;
+    while (wait(&pid, &exit_code)) {
+        auto slot_it = std::find_if(slots.begin(), slots.end(), [pid](Slot const& s) { return s.pid == pid; });
+        if (slot_it == slots.end())
+            continue;
+        Slot& slot = *slot_it;
+        int slot_index = int(slot_it - slots.begin());
+        slot.pid = -1;
+        if (exit_code == 0) {
+            slot.done = true;
+            continue;
+        }
+
+        // resume at the first frame of the slot that was not committed
+        std::vector<uint64_t> committed = distributed_committed_frames(staging_dir);
+        uint64_t resume_frame = slot.first_frame;
+        while (std::binary_search(committed.begin(), committed.end(), resume_frame))
+            resume_frame += uint64_t(slots.size());
+        slot.retries = resume_frame == slot.first_frame ? slot.retries + 1 : 0;
+        slot.first_frame = resume_frame;
+        if (slot.retries > max_retries) {
+            print_error("Distributed worker %d failed repeatedly at frame %llu, giving up"
+                , slot_index, (unsigned long long) resume_frame);
+            failed = true;
+            continue;
+        }
+        warning("Distributed worker %d exited with code %d, relaunching at frame %llu"
+            , slot_index, exit_code, (unsigned long long) resume_frame);
+        failed |= !launch_slot(slot_index);
+    }
+    if (failed) {
+        print_error("Distributed rendering incomplete, partial results remain in %s", staging_dir.c_str());
+        return false;
+    }
+
+    // every frame up to the end of the sequence has to be present
+    std::vector<uint64_t> committed = distributed_committed_frames(staging_dir);
+    for (size_t i = 0; i < committed.size(); ++i) {
+        if (committed[i] != uint64_t(i)) {
+            print_error("Distributed rendering is missing frame %llu, partial results remain in %s"
+                , (unsigned long long) i, staging_dir.c_str());
+            return false;
+        }
+    }
+    distributed_merge_outputs(staging_dir);
+    std::filesystem::remove_all(staging_dir, ec);
+    println(CLL::INFORMATION, "Distributed rendering merged %d frames", (int) committed.size());
+    return true;
+}
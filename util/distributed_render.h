@@ -0,0 +1,75 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Frame-distributed offline rendering on one machine. A coordinator process launches
+// worker processes that each render an interleaved share of the frames of an offline
+// sequence, frame i belonging to worker slot i % worker_count. Workers write their
+// images to a staging directory and commit each frame with a manifest. The coordinator
+// relaunches crashed workers from their first uncommitted frame and, once all slots are
+// done, moves the staged images to their output paths in frame order, so that later
+// frames overwrite outputs of the same name as in a single-process run. The images are
+// not guaranteed to match those of a single process, renderer state that is carried
+// between frames only sees the frames of one worker.
+
+struct DistributedWorkerArgs {
+    int slot = -1;
+    int worker_count = 0;
+    uint64_t first_frame = 0;
+    std::string staging_dir;
+
+    bool active() const { return worker_count > 0; }
+    bool renders_frame(uint64_t frame) const;
+    // appends the worker arguments to the arguments of the coordinator
+    std::vector<std::string> command_line(std::vector<std::string> const& base_args) const;
+};
+
+// Redirects the images of a worker's frames to the staging directory
+struct DistributedFrameStaging {
+    std::string staging_dir;
+    uint64_t frame = 0;
+    // staged and final prefixes of the images of the current frame
+    std::vector<std::pair<std::string, std::string>> outputs;
+
+    void begin_frame(uint64_t frame);
+    // returns the prefix to write an image of the given output prefix to instead
+    std::string staged_prefix(std::string const& output_prefix);
+    // atomically marks all images of the current frame as complete
+    void commit_frame();
+};
+
+// Offset of the sample sequences of an offline frame, derived from its index on the fixed-step
+// timeline. Frames restart accumulation at this offset instead of continuing the sequences of
+// the frames rendered before, so workers that step over frames seed the same samples.
+uint64_t offline_frame_sample_offset(uint64_t frame, int frame_spp);
+
+std::string distributed_manifest_path(std::string const& staging_dir, uint64_t frame);
+// frames with committed manifests, in ascending order
+std::vector<uint64_t> distributed_committed_frames(std::string const& staging_dir);
+// moves the images of all committed frames to their outputs in frame order
+void distributed_merge_outputs(std::string const& staging_dir);
+
+struct DistributedCoordinator {
+    typedef std::function<long long(std::vector<std::string> const& args)> LaunchFunction;
+    typedef std::function<bool(long long* pid, int* exit_code)> WaitFunction;
+
+    int worker_count = 2;
+    // relaunches of a worker slot without progress before giving up on its frames
+    int max_retries = 2;
+    std::string staging_dir;
+    LaunchFunction launch;
+    WaitFunction wait;
+
+    DistributedCoordinator();
+
+    // renders all frames with workers launched from the given arguments and merges
+    // their outputs, returns false if frames could not be rendered
+    bool run(std::vector<std::string> const& base_args);
+};
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 
 #include "file_mapping.h"
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
@@ -92,3 +93,29 @@ size_t FileMapping::nbytes() const
 {
     return num_bytes;
 }
+
+void FileMapping::advise(size_t offset, size_t size, bool will_need) const
+{
+    if (!mapping || offset >= num_bytes)
+        return;
+    size = std::min(size, num_bytes - offset);
+#ifdef _WIN32
+    if (will_need) {
+        WIN32_MEMORY_RANGE_ENTRY range = { static_cast<uint8_t *>(mapping) + offset, size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    // note: read-only views are trimmed from the working set by the OS as needed
+#else
+    // advice applies to whole pages, only drop pages that lie entirely within the range
+    size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    size_t begin = offset, end = offset + size;
+    if (will_need)
+        begin -= begin % page_size;
+    else {
+        begin += (page_size - begin % page_size) % page_size;
+        end -= end % page_size;
+    }
+    if (begin < end)
+        madvise(static_cast<uint8_t *>(mapping) + begin, end - begin, will_need ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+}
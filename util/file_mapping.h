@@ -28,6 +28,10 @@ public:
 
     const uint8_t *data() const;
     size_t nbytes() const;
+
+    // Hints that a byte range will be read soon or not for a while, the OS then
+    // prefetches the range or drops its pages, which are re-read from the file on access
+    void advise(size_t offset, size_t size, bool will_need) const;
 };
 
 // untyped buffer reference storing std::vector<T> data
@@ -179,6 +183,11 @@ public:
     }
 
     size_t offset() const { return map_offset >= 0 ? map_offset : -1 - map_offset; }
+    // residency hint for file-backed views, see FileMapping::advise
+    void advise(bool will_need) const {
+        if (map_offset >= 0)
+            ((FileMapping const&) store).advise(map_offset, nbytes(), will_need);
+    }
     size_t nbytes() const {
         if (map_size == (size_t) -1) {
             if (map_offset < 0)
@@ -0,0 +1,73 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "frame_time_controller.h"
+#include <algorithm>
+#include <cmath>
+
+static float samples_per_pixel(FrameTimeController::Decision decision) {
+    return float(decision.batch_spp) / float(decision.upscale_factor * decision.upscale_factor);
+}
+
+void FrameTimeController::reset(Decision decision) {
+    current = decision;
+    sample_cost = OnlineStats<float>{};
+    frames_since_change = 0;
+}
+
+float FrameTimeController::predicted_ms(Decision decision) const {
+    return sample_cost.exponential_moving_average * samples_per_pixel(decision);
+}
+
+FrameTimeController::Decision FrameTimeController::update(float frame_time_ms) {
+    if (!enabled() || !(frame_time_ms > 0.0f) || !std::isfinite(frame_time_ms))
+        return current;
+    if (++frames_since_change <= settings.latency_frames)
+        return current;
+    sample_cost.update(frame_time_ms / samples_per_pixel(current));
+    if (frames_since_change < settings.latency_frames + std::max(settings.settle_frames, 1))
+        return current;
+
+    float const target = settings.target_ms;
+    float const tolerance = settings.tolerance;
+    int const min_factor = std::max(settings.min_upscale_factor, 1);
+    int const max_factor = std::max(settings.max_upscale_factor, min_factor);
+    int const min_spp = std::max(settings.min_spp, 1);
+    int const max_spp = std::max(settings.max_spp, min_spp);
+    auto fits = [&](int factor, int spp, float slack) {
+        return predicted_ms({ spp, factor }) <= target * slack;
+    };
+
+    // lower the resolution while even the fewest samples miss the target, raise it
+    // again once they fit with margin, such that measurement noise causes no flicker
+    int factor = std::min(std::max(current.upscale_factor, min_factor), max_factor);
+    while (factor < max_factor && !fits(factor, min_spp, 1.0f + tolerance))
+        ++factor;
+    while (factor > min_factor && fits(factor - 1, min_spp, 1.0f - tolerance))
+        --factor;
+
+    // samples closest to the target at the chosen resolution; as fixed overheads make
+    // the cost estimate pessimistic, rounding up is allowed within the tolerance
+    float affordable_spp = std::min(target / predicted_ms({ 1, factor }), float(max_spp));
+    int spp = int(affordable_spp);
+    if (affordable_spp - float(spp) >= 0.5f && fits(factor, spp + 1, 1.0f + tolerance))
+        ++spp;
+    spp = std::min(std::max(spp, min_spp), max_spp);
+    if (factor == current.upscale_factor) {
+        float current_ms = predicted_ms(current);
+        if (current.batch_spp >= min_spp && current.batch_spp <= max_spp
+         && current_ms <= target * (1.0f + tolerance)
+         && (current_ms >= target * (1.0f - tolerance) || current.batch_spp == max_spp))
+            spp = current.batch_spp;
+    }
+
+    Decision next = { spp, factor };
+    // measurements at a different resolution have to settle again
+    if (next.upscale_factor != current.upscale_factor)
+        reset(next);
+    else if (next.batch_spp != current.batch_spp) {
+        current = next;
+        frames_since_change = 0;
+    }
+    return current;
+}
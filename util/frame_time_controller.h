@@ -0,0 +1,54 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "online_stats.h"
+
+// Adapts the samples per frame and the render upscale factor between frames such that
+// measured frame times approach a target frame time. Frame times are modeled to scale
+// with the number of samples traced per frame, i.e. with the batch spp divided by the
+// square of the upscale factor. The cost per full-resolution sample is tracked as the
+// moving average of the measurements, which also absorbs fixed per-frame overheads, as
+// these raise the cost estimate until the chosen sample count meets the target.
+struct FrameTimeController {
+    struct Settings {
+        // disabled if not positive
+        float target_ms = 0.0f;
+        int min_spp = 1;
+        int max_spp = 16;
+        int min_upscale_factor = 1;
+        int max_upscale_factor = 2;
+        // relative deviation from the target that does not trigger changes
+        float tolerance = 0.1f;
+        // measurements that still belong to frames before the last change, as GPU
+        // timer queries are read back once their swap buffer is reused
+        int latency_frames = 2;
+        // measurements averaged before the next decision
+        int settle_frames = 4;
+    };
+    struct Decision {
+        int batch_spp;
+        int upscale_factor;
+    };
+
+    Settings settings;
+    Decision current = { 1, 1 };
+    // cost in ms per sample per pixel of the full resolution, reset on resolution changes
+    OnlineStats<float> sample_cost;
+    int frames_since_change = 0;
+
+    bool enabled() const { return settings.target_ms > 0.0f; }
+
+    // starts tracking frames rendered with the given samples and upscale factor
+    void reset(Decision decision);
+
+    // Records the time of the last frame, which was rendered with the current decision,
+    // and returns the decision for the next frame. Invalid times are ignored.
+    Decision update(float frame_time_ms);
+
+    float predicted_ms(Decision decision) const;
+};
@@ -2,8 +2,16 @@
 // SPDX-License-Identifier: MIT
 
 #include "image.h"
+#include "parallel.h"
+#include "compute_util.h"
 #include "stb_image.h"
+#include "tinyexr.h"
+#include "util.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 #include <xmmintrin.h>
 
@@ -33,9 +41,10 @@ int Image::mip_levels() const {
         int hb = (h + (bw-1)) / bw * bw;
         assert(remaining_pixels >= (size_t) wb * hb);
         remaining_pixels -= (size_t) wb * hb;
+        // chains end at 1x1 at the latest
+        assert(w > 1 || h > 1 || remaining_pixels == 0);
         if (w > 1) w /= 2;
         if (h > 1) h /= 2;
-        assert(w > 1 || h > 1 || remaining_pixels == 0);
     }
     return level_count;
 }
@@ -57,23 +66,334 @@ int Image::bits_per_pixel() const {
     return blockSize / 2;  // == blockSize * 8 / (4 * 4)
 }
 
+namespace {
+
+// block rows handed out to a thread at once
+const int DECODE_CHUNK_SIZE = 16;
+
+// exact real value weighted_sum / (denominator / 255) rounded to UNORM8, halves up
+inline uint8_t unorm8(int weighted_sum, int denominator) {
+    return uint8_t((2 * 255 * weighted_sum + denominator) / (2 * denominator));
+}
+// exact real value weighted_sum / denominator on the SNORM8 scale, halves away from zero
+inline uint8_t snorm8(int weighted_sum, int denominator) {
+    int magnitude = (2 * std::abs(weighted_sum) + denominator) / (2 * denominator);
+    return uint8_t(int8_t(weighted_sum < 0 ? -magnitude : magnitude));
+}
+
+inline uint16_t load16(uint8_t const* bytes) {
+    return uint16_t(bytes[0] | bytes[1] << 8);
+}
+inline uint64_t load64(uint8_t const* bytes) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = v << 8 | bytes[i];
+    return v;
+}
+
+// RGB of a BC1 color block, four-color mode only for BC2 and BC3
+// note: the transparent color of BC1 RGB textures is opaque black
+void decode_color_block(uint8_t const* block, uint8_t* texels, bool four_color_only, bool has_alpha) {
+    uint16_t c[2] = { load16(block), load16(block + 2) };
+    int endpoints[2][3];
+    for (int e = 0; e < 2; ++e) {
+        endpoints[e][0] = c[e] >> 11;
+        endpoints[e][1] = (c[e] >> 5) & 0x3f;
+        endpoints[e][2] = c[e] & 0x1f;
+    }
+    const int channel_max[3] = { 31, 63, 31 };
+    uint8_t palette[4][4];
+    bool four_colors = four_color_only || c[0] > c[1];
+    for (int ch = 0; ch < 3; ++ch) {
+        int a = endpoints[0][ch], b = endpoints[1][ch], m = channel_max[ch];
+        palette[0][ch] = unorm8(a, m);
+        palette[1][ch] = unorm8(b, m);
+        if (four_colors) {
+            palette[2][ch] = unorm8(2 * a + b, 3 * m);
+            palette[3][ch] = unorm8(a + 2 * b, 3 * m);
+        }
+        else {
+            palette[2][ch] = unorm8(a + b, 2 * m);
+            palette[3][ch] = 0;
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+        palette[i][3] = 255;
+    if (!four_colors && has_alpha)
+        palette[3][3] = 0;
+
+    uint32_t indices = uint32_t(block[4]) | uint32_t(block[5]) << 8 | uint32_t(block[6]) << 16 | uint32_t(block[7]) << 24;
+    for (int t = 0; t < 16; ++t)
+        memcpy(texels + 4 * t, palette[(indices >> (2 * t)) & 0x3], 4);
+}
+
+// one channel of a BC3 alpha or BC4/BC5 channel block
+void decode_channel_block(uint8_t const* block, uint8_t* texels, int channel, bool is_signed) {
+    uint8_t palette[8];
+    if (!is_signed) {
+        int a = block[0], b = block[1];
+        palette[0] = uint8_t(a);
+        palette[1] = uint8_t(b);
+        if (a > b) {
+            for (int i = 2; i < 8; ++i)
+                palette[i] = unorm8((8 - i) * a + (i - 1) * b, 7 * 255);
+        }
+        else {
+            for (int i = 2; i < 6; ++i)
+                palette[i] = unorm8((6 - i) * a + (i - 1) * b, 5 * 255);
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+    else {
+        // -128 maps to -1 as -127 does
+        int a = std::max(int(int8_t(block[0])), -127), b = std::max(int(int8_t(block[1])), -127);
+        palette[0] = snorm8(a, 1);
+        palette[1] = snorm8(b, 1);
+        if (int8_t(block[0]) > int8_t(block[1])) {
+            for (int i = 2; i < 8; ++i)
+                palette[i] = snorm8((8 - i) * a + (i - 1) * b, 7);
+        }
+        else {
+            for (int i = 2; i < 6; ++i)
+                palette[i] = snorm8((6 - i) * a + (i - 1) * b, 5);
+            palette[6] = snorm8(-127, 1);
+            palette[7] = snorm8(127, 1);
+        }
+    }
+    uint64_t indices = load64(block) >> 16;
+    for (int t = 0; t < 16; ++t)
+        texels[4 * t + channel] = palette[(indices >> (3 * t)) & 0x7];
+}
+
+// explicit 4 bit alpha of BC2
+void decode_explicit_alpha_block(uint8_t const* block, uint8_t* texels) {
+    uint64_t alphas = load64(block);
+    for (int t = 0; t < 16; ++t)
+        texels[4 * t + 3] = uint8_t(((alphas >> (4 * t)) & 0xf) * 17);
+}
+
+// RGBA8 texels of one 4x4 block in row-major order
+void decode_block(int bc_format, uint8_t const* block, uint8_t* texels) {
+    switch (bc_format) {
+    case 1:
+    case -1:
+        decode_color_block(block, texels, false, bc_format < 0);
+        break;
+    case 2:
+        decode_color_block(block + 8, texels, true, true);
+        decode_explicit_alpha_block(block, texels);
+        break;
+    case 3:
+        decode_color_block(block + 8, texels, true, true);
+        decode_channel_block(block, texels, 3, false);
+        break;
+    case 4:
+    case -4:
+    case 5:
+    case -5:
+        for (int t = 0; t < 16; ++t) {
+            texels[4 * t + 1] = 0;
+            texels[4 * t + 2] = 0;
+            texels[4 * t + 3] = 255;
+        }
+        decode_channel_block(block, texels, 0, bc_format < 0);
+        if (std::abs(bc_format) == 5)
+            decode_channel_block(block + 8, texels, 1, bc_format < 0);
+        break;
+    default:
+        throw std::runtime_error("Unsupported block compression format " + std::to_string(bc_format));
+    }
+}
+
+struct MipLevel {
+    int width, height;
+    size_t source_offset, target_offset;
+    int first_work_item;
+};
+
+// box filter of the 2x2 texels at twice the coordinates, clamped at odd edges
+void downsample_row(uint8_t const* source, int source_width, int source_height, uint8_t* target, int target_width, int y
+    , float const* srgb_to_linear_table) {
+    int y0 = std::min(2 * y, source_height - 1), y1 = std::min(2 * y + 1, source_height - 1);
+    for (int x = 0; x < target_width; ++x) {
+        int x0 = std::min(2 * x, source_width - 1), x1 = std::min(2 * x + 1, source_width - 1);
+        uint8_t const* quad[4] = {
+              source + 4 * (size_t(y0) * source_width + x0), source + 4 * (size_t(y0) * source_width + x1)
+            , source + 4 * (size_t(y1) * source_width + x0), source + 4 * (size_t(y1) * source_width + x1) };
+        uint8_t* texel = target + 4 * (size_t(y) * target_width + x);
+        for (int ch = 0; ch < 4; ++ch) {
+            if (srgb_to_linear_table && ch < 3) {
+                float sum = 0.0f;
+                for (int i = 0; i < 4; ++i)
+                    sum += srgb_to_linear_table[quad[i][ch]];
+                texel[ch] = uint8_t(std::lround(std::min(std::max(linear_to_srgb(0.25f * sum), 0.0f), 1.0f) * 255.0f));
+            }
+            else
+                texel[ch] = uint8_t((quad[0][ch] + quad[1][ch] + quad[2][ch] + quad[3][ch] + 2) / 4);
+        }
+    }
+}
+
+} // namespace
+
+mapped_vector<uint8_t> Image::decompressBytes(int thread_count) const {
+    Buffer<uint8_t> scratch = nullptr;
+    return decompressBytes(scratch, thread_count);
+}
+
+mapped_vector<uint8_t> Image::decompressBytes(Buffer<uint8_t>& scratch, int thread_count) const {
+    if (this->bcFormat == 0)
+        return img;
+
+    // block rows of all levels are decoded in parallel
+    std::vector<MipLevel> levels;
+    int work_items = 0;
+    size_t source_offset = 0, target_offset = 0;
+    size_t block_bytes = size_t(bits_per_pixel()) * 16 / 8;
+    // note: levels as counted by mip_levels(), which asserts complete data
+    for (int i = 0, w = width, h = height, level_count = max_mip_levels(); i < level_count && (i == 0 || source_offset < img.nbytes()); ++i) {
+        levels.push_back({ w, h, source_offset, target_offset, work_items });
+        source_offset += size_t((w + 3) / 4) * ((h + 3) / 4) * block_bytes;
+        target_offset += size_t(w) * h * 4;
+        work_items += (h + 3) / 4;
+        if (source_offset > img.nbytes())
+            throw std::runtime_error("Truncated block compressed data in " + name);
+        if (w > 1) w /= 2;
+        if (h > 1) h /= 2;
+    }
+
+    std::vector<uint8_t>& target = scratch.to_vector();
+    target.resize(target_offset);
+    uint8_t const* source = img.data();
+    parallel_for(work_items, [&](int item) {
+        MipLevel const& level = *(std::upper_bound(levels.begin(), levels.end(), item
+            , [](int i, MipLevel const& l) { return i < l.first_work_item; }) - 1);
+        int by = item - level.first_work_item;
+        int blocks_x = (level.width + 3) / 4;
+        uint8_t const* block = source + level.source_offset + size_t(by) * blocks_x * block_bytes;
+        uint8_t* level_texels = target.data() + level.target_offset;
+        uint8_t texels[16 * 4];
+        for (int bx = 0; bx < blocks_x; ++bx, block += block_bytes) {
+            decode_block(this->bcFormat, block, texels);
+            for (int ty = 0; ty < 4 && 4 * by + ty < level.height; ++ty) {
+                int row_texels = std::min(4, level.width - 4 * bx);
+                memcpy(level_texels + 4 * ((size_t(4 * by + ty)) * level.width + 4 * bx), texels + 16 * ty, 4 * row_texels);
+            }
+        }
+    }, thread_count, DECODE_CHUNK_SIZE);
+    return mapped_vector<uint8_t>(scratch);
+}
+
+Image Image::decompress(int thread_count) const {
+    Image decompressed = {
+        .name = name,
+        .width = width,
+        .height = height,
+        .channels = 4,
+        .color_space = color_space
+    };
+    Buffer<uint8_t> scratch = nullptr;
+    decompressed.img = decompressBytes(scratch, thread_count);
+    if (this->bcFormat == 0)
+        decompressed.channels = channels;
+    return decompressed;
+}
+
+Image Image::generateMips(int thread_count) const {
+    if (this->bcFormat != 0 || this->channels != 4)
+        throw std::runtime_error("Mip generation requires RGBA8 data, got " + name);
+    size_t base_bytes = size_t(width) * height * 4;
+    if (img.nbytes() < base_bytes)
+        throw std::runtime_error("Truncated image data in " + name);
+
+    std::vector<MipLevel> levels;
+    size_t target_offset = 0;
+    for (int i = 0, w = width, h = height, level_count = max_mip_levels(); i < level_count; ++i) {
+        levels.push_back({ w, h, 0, target_offset, 0 });
+        target_offset += size_t(w) * h * 4;
+        if (w > 1) w /= 2;
+        if (h > 1) h /= 2;
+    }
+    std::vector<uint8_t> texels(target_offset);
+    memcpy(texels.data(), img.data(), base_bytes);
+
+    float srgb_to_linear_table[256];
+    for (int i = 0; i < 256; ++i)
+        srgb_to_linear_table[i] = srgb_to_linear(float(i) / 255.0f);
+    for (size_t i = 1; i < levels.size(); ++i) {
+        MipLevel const& source = levels[i - 1];
+        MipLevel const& level = levels[i];
+        parallel_for(level.height, [&](int y) {
+            downsample_row(texels.data() + source.target_offset, source.width, source.height
+                , texels.data() + level.target_offset, level.width, y
+                , color_space == SRGB ? srgb_to_linear_table : nullptr);
+        }, thread_count, DECODE_CHUNK_SIZE);
+    }
+
+    Image mipmapped = *this;
+    mipmapped.img = Buffer<uint8_t>(std::move(texels));
+    return mipmapped;
+}
+
 //#if defined(ENABLE_STANDARD_FORMATS) || defined(PBRT_PARSER_ENABLED)
-Image Image::fromFile(const std::string &file, const std::string &name, ColorSpace color_space)
+Image Image::fromFile(const std::string &file, const std::string &name, ColorSpace color_space, bool generate_mips)
 {
     Image img = {
         .name = name,
         .color_space = color_space
     };
-    stbi_set_flip_vertically_on_load(1);
+    // note: rows are flipped here, the global flip state of stb_image is not thread safe
     uint8_t *data = stbi_load(file.c_str(), &img.width, &img.height, &img.channels, 4);
     if (!data) {
         throw std::runtime_error("Failed to load " + file);
     }
     img.channels = 4; // was converted
-    img.img = Buffer<uint8_t>( std::vector<uint8_t>(data, data + img.width * img.height * img.channels) );
+    size_t row_bytes = size_t(img.width) * img.channels;
+    std::vector<uint8_t> texels(row_bytes * img.height);
+    for (int y = 0; y < img.height; ++y)
+        memcpy(texels.data() + row_bytes * y, data + row_bytes * (img.height - 1 - y), row_bytes);
+    img.img = Buffer<uint8_t>( std::move(texels) );
     stbi_image_free(data);
-    stbi_set_flip_vertically_on_load(0);
+    if (generate_mips)
+        img = img.generateMips(1);
     return img;
 }
-//#endif
 
+std::vector<Image> Image::fromFiles(const std::vector<ImageFile> &files, bool generate_mips, int thread_count)
+{
+    std::vector<Image> images(files.size());
+    // one file per thread, the mips of each file are generated by the thread that loaded it
+    parallel_for(int(files.size()), [&](int i) {
+        images[i] = fromFile(files[i].file, files[i].name, files[i].color_space, generate_mips);
+    }, thread_count);
+    return images;
+}
+HdrImage HdrImage::fromFile(const std::string &file)
+{
+    HdrImage img;
+    float *rgba = nullptr;
+    if (get_file_extension(file) == ".exr") {
+        const char *error = nullptr;
+        if (LoadEXR(&rgba, &img.width, &img.height, file.c_str(), &error) != TINYEXR_SUCCESS) {
+            std::string what = "Failed to load " + file + (error ? std::string(": ") + error : std::string());
+            FreeEXRErrorMessage(error);
+            throw std::runtime_error(what);
+        }
+    } else {
+        int channels = 0;
+        rgba = stbi_loadf(file.c_str(), &img.width, &img.height, &channels, 4);
+        if (!rgba) {
+            throw std::runtime_error("Failed to load " + file);
+        }
+    }
+    size_t pixel_count = size_t(img.width) * img.height;
+    img.rgb.resize(3 * pixel_count);
+    for (size_t i = 0; i < pixel_count; ++i)
+        for (int c = 0; c < 3; ++c)
+            img.rgb[3 * i + c] = rgba[4 * i + c];
+    // note: both libraries allocate with malloc
+    free(rgba);
+    return img;
+}
+//#endif
@@ -4,9 +4,16 @@
 #pragma once
 
 #include "file_mapping.h"
+#include <vector>
 
 enum ColorSpace { LINEAR, SRGB };
 
+struct ImageFile {
+    std::string file;
+    std::string name;
+    ColorSpace color_space = LINEAR;
+};
+
 struct Image {
     std::string name;
     int width = 0;
@@ -20,9 +27,27 @@ struct Image {
     int mip_levels() const;
     int bits_per_pixel() const;
 
-    static Image fromFile(const std::string &file, const std::string &name, ColorSpace color_space = LINEAR);
-    mapped_vector<uint8_t> decompressBytes() const;
-    mapped_vector<uint8_t> decompressBytes(Buffer<uint8_t>& scratch) const;
-    Image decompress() const;
+    // Loads PNG, JPEG and the other formats of stb_image as RGBA8, bottom row first
+    static Image fromFile(const std::string &file, const std::string &name, ColorSpace color_space = LINEAR, bool generate_mips = false);
+    // Loads the files on up to thread_count threads (0 = one per hardware thread)
+    static std::vector<Image> fromFiles(const std::vector<ImageFile> &files, bool generate_mips = false, int thread_count = 0);
+
+    // Decodes all mip levels to RGBA8 with unpadded levels. Block compressed data is decoded
+    // as specified for BC1 to BC5 in the Khronos Data Format Specification, exact values rounded
+    // to the nearest 8 bit value, halves up. Signed BC4 and BC5 channels are stored as int8.
+    mapped_vector<uint8_t> decompressBytes(int thread_count = 0) const;
+    mapped_vector<uint8_t> decompressBytes(Buffer<uint8_t>& scratch, int thread_count = 0) const;
+    Image decompress(int thread_count = 0) const;
+    // Box-filtered mip chain for a single level RGBA8 image, filtered in linear space for SRGB
+    Image generateMips(int thread_count = 0) const;
 };
 
+// Linear RGB float image, rows in file order (top row first)
+struct HdrImage {
+    int width = 0;
+    int height = 0;
+    std::vector<float> rgb;
+
+    // Loads Radiance HDR files (stb_image) and OpenEXR files (tinyexr), alpha is dropped
+    static HdrImage fromFile(const std::string &file);
+};
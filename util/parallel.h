@@ -0,0 +1,63 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of threads used by parallel_for when no thread count is given
+inline int default_thread_count() {
+    return std::max(int(std::thread::hardware_concurrency()), 1);
+}
+
+// Calls fn(i) for all i in [0, count) on up to thread_count threads (0 = one per
+// hardware thread), including the calling thread. Indices are handed out dynamically
+// in chunks of chunk_size, the first exception thrown by fn is rethrown after all
+// threads finished.
+template <class Fn>
+void parallel_for(int count, Fn&& fn, int thread_count = 0, int chunk_size = 1) {
+    if (count <= 0)
+        return;
+    if (thread_count <= 0)
+        thread_count = default_thread_count();
+    chunk_size = std::max(chunk_size, 1);
+    thread_count = std::min(thread_count, (count + chunk_size - 1) / chunk_size);
+    if (thread_count <= 1) {
+        for (int i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    std::atomic<int> next_index(0);
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (int begin; (begin = next_index.fetch_add(chunk_size)) < count; ) {
+            try {
+                for (int i = begin, end = std::min(begin + chunk_size, count); i < end; ++i)
+                    fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error)
+                    first_error = std::current_exception();
+                next_index = count; // stop handing out work
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (int i = 1; i < thread_count; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+
+    if (first_error)
+        std::rethrow_exception(first_error);
+}
@@ -0,0 +1,166 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "render_server.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char* const aov_names[] = { RENDER_SERVER_AOV_NAMES };
+
+static const char* const usage =
+R"(usage: render_client SOCKET [options]
+
+Submits render jobs to a renderer started with --server SOCKET and writes the
+resulting images to <output>_<aov>.exr.
+
+Options:
+  --scene <file>        Scene file to render, repeat for multiple files. If omitted,
+                        the resident scene of the server is rendered.
+  --eye <x> <y> <z>     Camera position, the camera of the scene is used if no camera
+  --dir <x> <y> <z>     is specified.
+  --up <x> <y> <z>
+  --fov <degrees>       Vertical field of view.
+  --config <file.ini>   Render settings to apply before rendering, as written by the
+                        renderer into its .ini files.
+  --spp <n>             Samples per pixel to accumulate (default 1).
+  --aov <name>          Output to return, repeat for multiple outputs (default rgba).
+                        One of rgba, albedo_roughness, normal_depth, motion_jitter.
+  --output <prefix>     Output prefix of the images (default render).
+  --benchmark <n>       Submits the job n times and reports the job throughput. Images
+                        are only written with an explicit --output, suffixed by job id.
+)";
+
+static float parse_float(int argc, char** argv, int i) {
+    if (i >= argc)
+        throw std::runtime_error(std::string("Missing value for ") + argv[i - 1]);
+    return std::stof(argv[i]);
+}
+
+static bool write_images(RenderJobResult const& result, std::string const& prefix) {
+    if (!result.success) {
+        std::cerr << "Job " << result.id << " failed: " << result.error << std::endl;
+        return false;
+    }
+    bool success = true;
+    for (auto& image : result.images) {
+        std::string filename = prefix + "_" + image.first + ".exr";
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write((char const*) image.second.data(), image.second.size());
+        if (!file) {
+            std::cerr << "Failed to write " << filename << std::endl;
+            success = false;
+        }
+    }
+    return success;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        std::cerr << usage;
+        return -1;
+    }
+
+    RenderJob job;
+    std::string output;
+    int benchmark_jobs = 0;
+    bool custom_aovs = false;
+    try {
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--scene" && i + 1 < argc)
+                // the server resolves paths relative to its own working directory
+                job.scene_files.push_back(std::filesystem::absolute(argv[++i]).string());
+            else if (arg == "--eye" || arg == "--dir" || arg == "--up") {
+                float* v = arg == "--eye" ? job.eye : arg == "--dir" ? job.dir : job.up;
+                for (int j = 0; j < 3; ++j)
+                    v[j] = parse_float(argc, argv, ++i);
+                job.has_camera = true;
+            }
+            else if (arg == "--fov")
+                job.fov_y = parse_float(argc, argv, ++i);
+            else if (arg == "--spp")
+                job.target_spp = (int) parse_float(argc, argv, ++i);
+            else if (arg == "--config" && i + 1 < argc) {
+                std::ifstream file(argv[++i], std::ios::binary);
+                if (!file)
+                    throw std::runtime_error(std::string("Cannot read ") + argv[i]);
+                std::stringstream config;
+                config << file.rdbuf();
+                job.config = config.str();
+            }
+            else if (arg == "--aov" && i + 1 < argc) {
+                std::string name = argv[++i];
+                uint32_t bit = 0;
+                for (int j = 0; j < (int) RENDER_SERVER_AOV_COUNT; ++j)
+                    if (name == aov_names[j])
+                        bit = 1u << j;
+                if (!bit)
+                    throw std::runtime_error("Unknown AOV " + name);
+                job.aovs = (custom_aovs ? job.aovs : 0u) | bit;
+                custom_aovs = true;
+            }
+            else if (arg == "--output" && i + 1 < argc)
+                output = argv[++i];
+            else if (arg == "--benchmark")
+                benchmark_jobs = (int) parse_float(argc, argv, ++i);
+            else
+                throw std::runtime_error("Invalid argument " + arg);
+        }
+    } catch (std::exception const& e) {
+        std::cerr << e.what() << "\n\n" << usage;
+        return -1;
+    }
+
+    try {
+        RenderClient client(argv[1]);
+        if (benchmark_jobs <= 0) {
+            client.submit(job);
+            RenderJobResult result;
+            if (!client.receive(&result)) {
+                std::cerr << "Render server closed the connection" << std::endl;
+                return -1;
+            }
+            return write_images(result, output.empty() ? "render" : output) ? 0 : -1;
+        }
+
+        // all jobs are queued at once, such that the server never idles between jobs
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < benchmark_jobs; ++i) {
+            job.id = uint64_t(i);
+            client.submit(job);
+        }
+        double first_result_s = 0.0;
+        bool success = true;
+        for (int i = 0; i < benchmark_jobs; ++i) {
+            RenderJobResult result;
+            if (!client.receive(&result)) {
+                std::cerr << "Render server closed the connection after " << i << " jobs" << std::endl;
+                return -1;
+            }
+            if (i == 0)
+                first_result_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!output.empty())
+                success &= write_images(result, output + "_" + std::to_string(result.id));
+            else if (!result.success) {
+                std::cerr << "Job " << result.id << " failed: " << result.error << std::endl;
+                success = false;
+            }
+        }
+        double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << benchmark_jobs << " jobs in " << total_s << " s, "
+                  << 60.0 * benchmark_jobs / total_s << " jobs per minute, first result after "
+                  << first_result_s << " s" << std::endl;
+        return success ? 0 : -1;
+    } catch (std::exception const& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,430 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "render_server.h"
+#include "error_io.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t RENDER_SERVER_MAGIC = 0x4a525052u; // "RPRJ"
+static const uint64_t RENDER_SERVER_MAX_PAYLOAD = uint64_t(1) << 32;
+
+namespace {
+
+struct PayloadWriter {
+    std::vector<unsigned char> data;
+
+    void bytes(void const* src, size_t size) {
+        data.insert(data.end(), (unsigned char const*) src, (unsigned char const*) src + size);
+    }
+    template <class T> void value(T const& v) { bytes(&v, sizeof(v)); }
+    void string(std::string const& s) {
+        value(uint64_t(s.size()));
+        bytes(s.data(), s.size());
+    }
+    void blob(std::vector<unsigned char> const& b) {
+        value(uint64_t(b.size()));
+        bytes(b.data(), b.size());
+    }
+};
+
+struct PayloadReader {
+    unsigned char const* data;
+    size_t size;
+    size_t offset = 0;
+    bool valid = true;
+
+    PayloadReader(unsigned char const* data, size_t size) : data(data), size(size) { }
+
+    bool bytes(void* dst, size_t n) {
+        if (!valid || n > size - offset)
+            return valid = false;
+        memcpy(dst, data + offset, n);
+        offset += n;
+        return true;
+    }
+    template <class T> bool value(T& v) { return bytes(&v, sizeof(v)); }
+    bool string(std::string& s) {
+        uint64_t n = 0;
+        if (!value(n) || n > size - offset)
+            return valid = false;
+        s.assign((char const*) data + offset, size_t(n));
+        offset += size_t(n);
+        return true;
+    }
+    bool blob(std::vector<unsigned char>& b) {
+        uint64_t n = 0;
+        if (!value(n) || n > size - offset)
+            return valid = false;
+        b.assign(data + offset, data + offset + size_t(n));
+        offset += size_t(n);
+        return true;
+    }
+    bool complete() const { return valid && offset == size; }
+};
+
+} // namespace
+
+std::vector<unsigned char> serialize_render_job(RenderJob const& job) {
+    PayloadWriter w;
+    w.value(job.id);
+    w.value(uint64_t(job.scene_files.size()));
+    for (auto& f : job.scene_files)
+        w.string(f);
+    w.value(uint32_t(job.has_camera));
+    w.value(job.eye);
+    w.value(job.dir);
+    w.value(job.up);
+    w.value(job.fov_y);
+    w.string(job.config);
+    w.value(job.aovs);
+    w.value(int32_t(job.target_spp));
+    return std::move(w.data);
+}
+
+bool deserialize_render_job(unsigned char const* data, size_t size, RenderJob* job) {
+    PayloadReader r(data, size);
+    uint64_t num_scene_files = 0;
+    r.value(job->id);
+    r.value(num_scene_files);
+    if (num_scene_files > size)
+        return false;
+    job->scene_files.resize(size_t(num_scene_files));
+    for (auto& f : job->scene_files)
+        r.string(f);
+    uint32_t has_camera = 0;
+    r.value(has_camera);
+    job->has_camera = has_camera != 0;
+    r.value(job->eye);
+    r.value(job->dir);
+    r.value(job->up);
+    r.value(job->fov_y);
+    r.string(job->config);
+    r.value(job->aovs);
+    int32_t target_spp = 0;
+    r.value(target_spp);
+    job->target_spp = target_spp;
+    return r.complete();
+}
+
+std::vector<unsigned char> serialize_render_job_result(RenderJobResult const& result) {
+    PayloadWriter w;
+    w.value(result.id);
+    w.value(uint32_t(result.success));
+    w.string(result.error);
+    w.value(uint64_t(result.images.size()));
+    for (auto& image : result.images) {
+        w.string(image.first);
+        w.blob(image.second);
+    }
+    return std::move(w.data);
+}
+
+bool deserialize_render_job_result(unsigned char const* data, size_t size, RenderJobResult* result) {
+    PayloadReader r(data, size);
+    r.value(result->id);
+    uint32_t success = 0;
+    r.value(success);
+    result->success = success != 0;
+    r.string(result->error);
+    uint64_t num_images = 0;
+    r.value(num_images);
+    if (num_images > size)
+        return false;
+    result->images.resize(size_t(num_images));
+    for (auto& image : result->images) {
+        r.string(image.first);
+        r.blob(image.second);
+    }
+    return r.complete();
+}
+
+struct RenderServerMessageHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t size;
+};
+
+void frame_render_server_message(std::vector<unsigned char>& buffer, RenderServerMessageType type
+    , std::vector<unsigned char> const& payload) {
+    RenderServerMessageHeader header = { RENDER_SERVER_MAGIC, uint32_t(type), uint64_t(payload.size()) };
+    buffer.insert(buffer.end(), (unsigned char const*) &header, (unsigned char const*) (&header + 1));
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+}
+
+bool unframe_render_server_message(std::vector<unsigned char>& buffer, RenderServerMessageType* type
+    , std::vector<unsigned char>* payload) {
+    RenderServerMessageHeader header;
+    if (buffer.size() < sizeof(header))
+        return false;
+    memcpy(&header, buffer.data(), sizeof(header));
+    if (header.magic != RENDER_SERVER_MAGIC || header.size > RENDER_SERVER_MAX_PAYLOAD)
+        throw_error("Corrupt render server message");
+    if (buffer.size() - sizeof(header) < header.size)
+        return false;
+    *type = RenderServerMessageType(header.type);
+    payload->assign(buffer.begin() + sizeof(header), buffer.begin() + sizeof(header) + size_t(header.size));
+    buffer.erase(buffer.begin(), buffer.begin() + sizeof(header) + size_t(header.size));
+    return true;
+}
+
+bool RenderServer::next_job(QueuedJob* job) {
+    while (!queue.empty()) {
+        QueuedJob next = std::move(queue.front());
+        queue.pop_front();
+        // jobs of disconnected clients are dropped
+        if (connections[next.connection].socket < 0)
+            continue;
+        *job = std::move(next);
+        return true;
+    }
+    return false;
+}
+
+void RenderServer::send_result(int connection, RenderJobResult const& result) {
+    Connection& c = connections[connection];
+    if (c.socket < 0)
+        return;
+    frame_render_server_message(c.output, RENDER_SERVER_MESSAGE_RESULT, serialize_render_job_result(result));
+    flush(connection);
+}
+
+int RenderServer::pending_output_bytes() const {
+    size_t bytes = 0;
+    for (auto& c : connections)
+        bytes += c.output.size();
+    return int(std::min(bytes, size_t(0x7fffffff)));
+}
+
+#ifdef _WIN32
+
+// the render server and client use Unix domain sockets, which are not supported on Windows
+RenderServer::RenderServer(std::string const& socket_path) : socket_path(socket_path) {
+    throw_error("The render server is not supported on Windows");
+}
+RenderServer::~RenderServer() { }
+void RenderServer::poll(int timeout_ms) { }
+void RenderServer::close_connection(int connection) { }
+void RenderServer::flush(int connection) { }
+
+RenderClient::RenderClient(std::string const& socket_path) {
+    throw_error("The render client is not supported on Windows");
+}
+RenderClient::~RenderClient() { }
+void RenderClient::submit(RenderJob const& job) { }
+bool RenderClient::receive(RenderJobResult* result) { return false; }
+
+#else
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static sockaddr_un unix_socket_address(std::string const& socket_path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+        throw_error("Socket path too long: %s", socket_path.c_str());
+    memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+static void set_nonblocking(int socket) {
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+}
+
+RenderServer::RenderServer(std::string const& socket_path)
+    : socket_path(socket_path) {
+    sockaddr_un address = unix_socket_address(socket_path);
+    listen_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_socket < 0)
+        throw_error("Failed to create render server socket: %s", strerror(errno));
+    // replace stale sockets of previous servers, but never other files
+    struct stat existing;
+    if (lstat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            close(listen_socket);
+            throw_error("Refusing to replace %s, which is not a socket", socket_path.c_str());
+        }
+        if (unlink(socket_path.c_str()) != 0) {
+            int error = errno;
+            close(listen_socket);
+            throw_error("Failed to remove stale socket %s: %s", socket_path.c_str(), strerror(error));
+        }
+    } else if (errno != ENOENT) {
+        int error = errno;
+        close(listen_socket);
+        throw_error("Cannot access %s: %s", socket_path.c_str(), strerror(error));
+    }
+    if (bind(listen_socket, (sockaddr const*) &address, sizeof(address)) != 0
+     || listen(listen_socket, 16) != 0) {
+        int error = errno;
+        close(listen_socket);
+        throw_error("Failed to listen on %s: %s", socket_path.c_str(), strerror(error));
+    }
+    set_nonblocking(listen_socket);
+    println(CLL::INFORMATION, "Render server listening on %s", socket_path.c_str());
+}
+
+RenderServer::~RenderServer() {
+    for (int i = 0; i < (int) connections.size(); ++i)
+        close_connection(i);
+    if (listen_socket >= 0) {
+        close(listen_socket);
+        unlink(socket_path.c_str());
+    }
+}
+
+void RenderServer::close_connection(int connection) {
+    Connection& c = connections[connection];
+    if (c.socket >= 0)
+        close(c.socket);
+    c.socket = -1;
+    c.input.clear();
+    c.output.clear();
+}
+
+void RenderServer::flush(int connection) {
+    Connection& c = connections[connection];
+    size_t sent = 0;
+    while (c.socket >= 0 && sent < c.output.size()) {
+        ssize_t n = send(c.socket, c.output.data() + sent, c.output.size() - sent, MSG_NOSIGNAL);
+        if (n > 0)
+            sent += size_t(n);
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else {
+            close_connection(connection);
+            return;
+        }
+    }
+    c.output.erase(c.output.begin(), c.output.begin() + sent);
+}
+
+void RenderServer::poll(int timeout_ms) {
+    std::vector<pollfd> fds;
+    std::vector<int> fd_connections;
+    fds.push_back({ listen_socket, POLLIN, 0 });
+    fd_connections.push_back(-1);
+    for (int i = 0; i < (int) connections.size(); ++i) {
+        if (connections[i].socket < 0)
+            continue;
+        short events = POLLIN;
+        if (!connections[i].output.empty())
+            events |= POLLOUT;
+        fds.push_back({ connections[i].socket, events, 0 });
+        fd_connections.push_back(i);
+    }
+    if (!queue.empty())
+        timeout_ms = 0;
+    if (::poll(fds.data(), fds.size(), timeout_ms) <= 0)
+        return;
+
+    for (size_t f = 1; f < fds.size(); ++f) {
+        int connection = fd_connections[f];
+        Connection& c = connections[connection];
+        if (fds[f].revents & POLLOUT)
+            flush(connection);
+        if (!(fds[f].revents & (POLLIN | POLLHUP | POLLERR)) || c.socket < 0)
+            continue;
+        unsigned char chunk[64 * 1024];
+        bool closed = false;
+        while (true) {
+            ssize_t n = recv(c.socket, chunk, sizeof(chunk), 0);
+            if (n > 0)
+                c.input.insert(c.input.end(), chunk, chunk + n);
+            else if (n < 0 && errno == EINTR)
+                continue;
+            else {
+                closed = n == 0 || !(errno == EAGAIN || errno == EWOULDBLOCK);
+                break;
+            }
+        }
+        try {
+            RenderServerMessageType type;
+            std::vector<unsigned char> payload;
+            while (unframe_render_server_message(c.input, &type, &payload)) {
+                QueuedJob queued = { connection };
+                if (type != RENDER_SERVER_MESSAGE_JOB
+                 || !deserialize_render_job(payload.data(), payload.size(), &queued.job))
+                    throw_error("Invalid render job");
+                queue.push_back(std::move(queued));
+            }
+        } catch (std::exception const& e) {
+            warning("Render server closing connection: %s", e.what());
+            closed = true;
+        }
+        if (closed)
+            close_connection(connection);
+    }
+
+    if (fds[0].revents & POLLIN) {
+        while (true) {
+            int client = accept(listen_socket, nullptr, nullptr);
+            if (client < 0)
+                break;
+            set_nonblocking(client);
+            Connection c;
+            c.socket = client;
+            connections.push_back(std::move(c));
+        }
+    }
+}
+
+RenderClient::RenderClient(std::string const& socket_path) {
+    sockaddr_un address = unix_socket_address(socket_path);
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0 || connect(socket, (sockaddr const*) &address, sizeof(address)) != 0) {
+        int error = errno;
+        if (socket >= 0)
+            close(socket);
+        socket = -1;
+        throw_error("Failed to connect to render server %s: %s", socket_path.c_str(), strerror(error));
+    }
+}
+
+RenderClient::~RenderClient() {
+    if (socket >= 0)
+        close(socket);
+}
+
+void RenderClient::submit(RenderJob const& job) {
+    std::vector<unsigned char> buffer;
+    frame_render_server_message(buffer, RENDER_SERVER_MESSAGE_JOB, serialize_render_job(job));
+    size_t sent = 0;
+    while (sent < buffer.size()) {
+        ssize_t n = send(socket, buffer.data() + sent, buffer.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw_error("Failed to submit render job: %s", strerror(errno));
+        sent += size_t(n);
+    }
+}
+
+bool RenderClient::receive(RenderJobResult* result) {
+    RenderServerMessageType type;
+    std::vector<unsigned char> payload;
+    while (!unframe_render_server_message(input, &type, &payload)) {
+        unsigned char chunk[64 * 1024];
+        ssize_t n = recv(socket, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        input.insert(input.end(), chunk, chunk + n);
+    }
+    if (type != RENDER_SERVER_MESSAGE_RESULT
+     || !deserialize_render_job_result(payload.data(), payload.size(), result))
+        throw_error("Invalid render job result");
+    return true;
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Render jobs and results exchanged over a local (Unix domain) socket with a renderer
+// that keeps its backend and scene resident between jobs. Messages are framed by a
+// header of magic, type and payload size; payloads are in host byte order, as both
+// ends run on the same machine.
+
+enum RenderServerAOV : uint32_t {
+    RENDER_SERVER_AOV_RGBA = 0x1,
+    RENDER_SERVER_AOV_ALBEDO_ROUGHNESS = 0x2,
+    RENDER_SERVER_AOV_NORMAL_DEPTH = 0x4,
+    RENDER_SERVER_AOV_MOTION_JITTER = 0x8,
+    RENDER_SERVER_AOV_COUNT = 4
+};
+// note: order has to match bits!
+#define RENDER_SERVER_AOV_NAMES \
+    "rgba", \
+    "albedo_roughness", \
+    "normal_depth", \
+    "motion_jitter"
+
+struct RenderJob {
+    // chosen by the client to match results
+    uint64_t id = 0;
+    // empty to keep the resident scene, reloaded only if files or their timestamps changed
+    std::vector<std::string> scene_files;
+    // otherwise, the camera of the initial settings is used
+    bool has_camera = false;
+    float eye[3] = { 0.0f, 0.0f, 0.0f };
+    float dir[3] = { 0.0f, 0.0f, -1.0f };
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    float fov_y = 65.0f;
+    // .ini settings applied before rendering, e.g. render params as in --config files
+    std::string config;
+    uint32_t aovs = RENDER_SERVER_AOV_RGBA;
+    int target_spp = 1;
+};
+
+struct RenderJobResult {
+    uint64_t id = 0;
+    bool success = false;
+    std::string error;
+    // EXR file contents by AOV name
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> images;
+};
+
+enum RenderServerMessageType : uint32_t {
+    RENDER_SERVER_MESSAGE_JOB = 1,
+    RENDER_SERVER_MESSAGE_RESULT = 2
+};
+
+std::vector<unsigned char> serialize_render_job(RenderJob const& job);
+std::vector<unsigned char> serialize_render_job_result(RenderJobResult const& result);
+bool deserialize_render_job(unsigned char const* data, size_t size, RenderJob* job);
+bool deserialize_render_job_result(unsigned char const* data, size_t size, RenderJobResult* result);
+
+// Appends a framed message to the given buffer
+void frame_render_server_message(std::vector<unsigned char>& buffer, RenderServerMessageType type
+    , std::vector<unsigned char> const& payload);
+// Removes the next complete message from the front of the buffer, returns false if there is none.
+// Throws on corrupt framing.
+bool unframe_render_server_message(std::vector<unsigned char>& buffer, RenderServerMessageType* type
+    , std::vector<unsigned char>* payload);
+
+// Non-blocking server end, driven by poll() from the render loop
+struct RenderServer {
+    struct Connection {
+        int socket = -1;
+        std::vector<unsigned char> input;
+        std::vector<unsigned char> output;
+    };
+    struct QueuedJob {
+        int connection = -1;
+        RenderJob job;
+    };
+
+    std::string socket_path;
+    int listen_socket = -1;
+    // closed connections are reset to socket -1, such that their indices remain valid
+    std::vector<Connection> connections;
+    std::deque<QueuedJob> queue;
+
+    RenderServer(std::string const& socket_path);
+    ~RenderServer();
+    RenderServer(RenderServer const&) = delete;
+    RenderServer& operator=(RenderServer const&) = delete;
+
+    // accepts connections, receives jobs and sends pending results, waits up to
+    // the given time for any of these if there is nothing to do
+    void poll(int timeout_ms);
+    // removes the oldest queued job of a connected client
+    bool next_job(QueuedJob* job);
+    // queues the result for sending, dropped if the client disconnected
+    void send_result(int connection, RenderJobResult const& result);
+    int pending_output_bytes() const;
+
+private:
+    void close_connection(int connection);
+    void flush(int connection);
+};
+
+// Blocking client end
+struct RenderClient {
+    int socket = -1;
+    std::vector<unsigned char> input;
+
+    RenderClient(std::string const& socket_path);
+    ~RenderClient();
+    RenderClient(RenderClient const&) = delete;
+    RenderClient& operator=(RenderClient const&) = delete;
+
+    void submit(RenderJob const& job);
+    // waits for the next result, returns false if the server closed the connection
+    bool receive(RenderJobResult* result);
+};
@@ -314,12 +314,22 @@ bool launch_sibling_process(const std::vector<std::string>& args) {
 void send_launch_signal(int i) { }
 void wait_for_signal(int i) { }
 
+// todo: distributed rendering support?
+long long launch_child_process(const std::vector<std::string>& args) {
+    return -1;
+}
+bool wait_for_child_process(long long* pid, int* exit_code) {
+    return false;
+}
+
 #else
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <signal.h>
+#include <cerrno>
 
 unsigned long long get_last_modified(char const* fname) {
     struct stat mstat;
@@ -379,6 +389,41 @@ void wait_for_signal(int i) {
         printf("Failed to wait for signal %i!\n", i);
 }
 
+long long launch_child_process(const std::vector<std::string>& args) {
+    std::vector<char const*> argv;
+    for (auto& a : args)
+        argv.push_back(a.c_str());
+    argv.push_back(nullptr);
+    fflush(stdout);
+    pid_t child_proc = fork();
+    if (child_proc < 0) {
+        printf("Fork failed, cannot launch %s!\n", args[0].c_str());
+        return -1;
+    }
+    if (child_proc == 0) {
+        execv(args[0].c_str(), (char* const*) argv.data());
+        printf("Launching child %s failed!\n", args[0].c_str());
+        _exit(127);
+    }
+    return (long long) child_proc;
+}
+
+bool wait_for_child_process(long long* pid, int* exit_code) {
+    int status = 0;
+    pid_t child_proc;
+    do {
+        child_proc = waitpid(-1, &status, 0);
+    } while (child_proc < 0 && errno == EINTR);
+    if (child_proc < 0)
+        return false;
+    *pid = (long long) child_proc;
+    if (WIFEXITED(status))
+        *exit_code = WEXITSTATUS(status);
+    else
+        *exit_code = WIFSIGNALED(status) ? -WTERMSIG(status) : -1;
+    return true;
+}
+
 #endif
 
 bool in_stack_unwind() { return std::uncaught_exceptions() != 0; }
@@ -61,6 +61,12 @@ bool launch_sibling_process(const std::vector<std::string>& args);
 void send_launch_signal(int i);
 void wait_for_signal(int i);
 
+// starts args[0] with the given arguments as a child process, returns its id or -1
+long long launch_child_process(const std::vector<std::string>& args);
+// waits for any child process to exit, returns false if there are none;
+// the exit code is negative if the child was terminated by a signal
+bool wait_for_child_process(long long* pid, int* exit_code);
+
 void chrono_sleep(int milliseconds);
 
 std::string get_cpu_brand();
@@ -7,6 +7,7 @@
 #include "error_io.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
@@ -98,7 +99,8 @@ std::vector<T> separate_interleaved_channels(size_t num_pixels, size_t num_chann
 template <class T>
 static bool write_exr_generic(const char *filename, size_t width,
         size_t height, size_t channels,
-        const T *pixels, ExrCompression compression)
+        const T *pixels, ExrCompression compression,
+        std::vector<unsigned char> *memory = nullptr)
 {
     constexpr size_t num_channels = 4;
     if (width == 0 || height == 0 || channels != num_channels || !pixels) {
@@ -165,6 +167,18 @@ static bool write_exr_generic(const char *filename, size_t width,
     image.width = width;
     image.height = height;
 
+    if (memory) {
+        unsigned char *data = nullptr;
+        const size_t size = SaveEXRImageToMemory(&image, &header, &data, nullptr);
+        if (size == 0) {
+            print(CLL::CRITICAL, "Failed to encode %s\n", path.c_str());
+            return false;
+        }
+        memory->assign(data, data + size);
+        free(data);
+        return true;
+    }
+
     const int ret = SaveEXRImageToFile(&image, &header, path.c_str(), nullptr);
     if (ret != TINYEXR_SUCCESS) {
         print(CLL::CRITICAL, "Failed to write %s\n", path.c_str());
@@ -185,3 +199,17 @@ bool WriteImage::write_exr(const char *filename,
 {
     return write_exr_generic(filename, width, height, channels, pixels, compression);
 }
+
+bool WriteImage::encode_exr(std::vector<unsigned char> &exr,
+    unsigned width, unsigned height, unsigned channels,
+    const float *pixels, ExrCompression compression)
+{
+    return write_exr_generic("<memory>", width, height, channels, pixels, compression, &exr);
+}
+
+bool WriteImage::encode_exr(std::vector<unsigned char> &exr,
+    unsigned width, unsigned height, unsigned channels,
+    const uint16_t *pixels, ExrCompression compression)
+{
+    return write_exr_generic("<memory>", width, height, channels, pixels, compression, &exr);
+}
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 enum OutputImageFormat {
   OUTPUT_IMAGE_FORMAT_PNG,
@@ -39,4 +40,14 @@ struct WriteImage
     static bool write_exr(const char *filename,
         unsigned width, unsigned height, unsigned channels,
         const uint16_t *pixels, ExrCompression compression);
+
+    // EXR file contents in memory, 32 bit float
+    static bool encode_exr(std::vector<unsigned char> &exr,
+        unsigned width, unsigned height, unsigned channels,
+        const float *pixels, ExrCompression compression);
+
+    // EXR file contents in memory, 16 bit float
+    static bool encode_exr(std::vector<unsigned char> &exr,
+        unsigned width, unsigned height, unsigned channels,
+        const uint16_t *pixels, ExrCompression compression);
 };
@@ -16,6 +16,9 @@ layout(binding = ATOMIC_ACCUMBUFFER_BIND_POINT, set = 0, r32f) uniform volatile
 layout(binding = ATOMIC_ACCUMBUFFER_BIND_POINT, set = 0, r32ui) uniform volatile uimage2DArray atomic_accum_buffer;
 #endif
 
+#include "../librender/adaptive_sampling.glsl"
+layout(binding = ADAPTIVE_SAMPLING_STATS_BIND_POINT, set = 0, rgba32f) uniform image2D adaptive_sampling_stats;
+
 #ifdef ENABLE_AOV_BUFFERS
 layout(binding = AOV_ALBEDO_ROUGHNESS_BIND_POINT, set = 0, rgba16f) uniform writeonly image2D aov_albedo_roughness_buffer;
 layout(binding = AOV_NORMAL_DEPTH_BIND_POINT, set = 0, rgba16f) uniform writeonly image2D aov_normal_depth_buffer;
@@ -73,6 +76,15 @@ void accumulate(ivec2 fb_pixel, vec4 new_result, uint sample_index, bool accumul
     }
 }
 
+AdaptivePixelStats load_adaptive_stats(ivec2 fb_pixel) {
+    vec4 stats = imageLoad(adaptive_sampling_stats, fb_pixel);
+    return AdaptivePixelStats(stats.x, stats.y, stats.z, stats.w);
+}
+
+void store_adaptive_stats(ivec2 fb_pixel, AdaptivePixelStats stats) {
+    imageStore(adaptive_sampling_stats, fb_pixel, vec4(stats.mean, stats.second_moment, stats.count, stats.spp));
+}
+
 void store_motion_jitter_aovs(vec3 position, vec3 motion_vector) {
 #ifdef ENABLE_AOV_BUFFERS
     ivec2 fb_pixel = AOV_TARGET_PIXEL;
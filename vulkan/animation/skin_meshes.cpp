@@ -0,0 +1,324 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "skin_meshes.h"
+#include "../render_vulkan.h"
+
+#include <librender/scene.h>
+
+#include "types.h"
+#include "util.h"
+#include "error_io.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace glsl {
+    using namespace glm;
+    #include "../../rendering/language.hpp"
+    #include "../gpu_params.glsl"
+}
+
+#ifndef QUANTIZED_POSITIONS
+#error "Skinning reads the rest pose from quantized vertex buffers"
+#endif
+
+extern "C" { extern struct GpuProgram const vulkan_program_SKIN_MESHES; }
+
+namespace {
+
+// matches the push constants in skin_meshes.comp
+struct SkinMeshesPushConstants {
+    uint64_t rest_vertices;
+    uint64_t rest_normals;
+    uint64_t blend_attributes;
+    uint64_t bone_index_tuples;
+    uint64_t bone_transforms;
+    uint64_t vertices;
+    uint64_t normals;
+    uint32_t vertex_count;
+    uint32_t first_bone;
+    glm::vec3 quantized_scaling;
+    uint32_t tuple_count;
+    glm::vec3 quantized_offset;
+    uint32_t flags;
+};
+static_assert(sizeof(SkinMeshesPushConstants) == 96, "push constants out of sync with skin_meshes.comp");
+
+uint32_t const SKIN_MESHES_NORMALS = 0x1;
+
+VkBufferUsageFlags const SKINNING_BUFFER_USAGE = VK_BUFFER_USAGE_TRANSFER_DST_BIT
+    | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+    | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+} // namespace
+
+SkinMeshesVulkan::SkinMeshesVulkan(RenderVulkan* backend)
+    : device(backend->device)
+    , backend(backend)
+{
+    try { // need to handle all exceptions from here for manual multi-resource cleanup!
+        vkrt::RenderPipelineOptions options;
+        options.default_push_constant_size = sizeof(SkinMeshesPushConstants);
+        skinning_pipeline.reset( new ComputeRenderPipelineVulkan(backend
+                , &vulkan_program_SKIN_MESHES
+                , options, false, this
+            ) );
+    } catch (...) {
+        internal_release_resources();
+        throw;
+    }
+}
+
+SkinMeshesVulkan::~SkinMeshesVulkan() {
+    internal_release_resources();
+}
+
+void SkinMeshesVulkan::internal_release_resources() {
+    vkDeviceWaitIdle(device->logical_device());
+
+    skinned_instances.clear();
+    bone_index_tuples = nullptr;
+    bone_transforms = nullptr;
+}
+
+std::string SkinMeshesVulkan::name() const {
+    return "Vulkan Skinned Mesh Animation Extension";
+}
+
+void SkinMeshesVulkan::initialize(const int fb_width, const int fb_height) {
+}
+
+bool SkinMeshesVulkan::is_active_for(RenderBackendOptions const& rbo) const {
+    return !skinned_instances.empty();
+}
+
+void SkinMeshesVulkan::update_scene_from_backend(const Scene &scene) {
+    bool new_scene = this->unique_scene_id != scene.unqiue_id;
+
+    if (new_scene || this->meshes_revision != scene.meshes_revision || this->instances_revision != scene.instances_revision)
+        upload_skinned_meshes(scene);
+
+    device->flush_sync_and_async_device_copies();
+
+    unique_scene_id = scene.unqiue_id;
+    meshes_revision = scene.meshes_revision;
+    instances_revision = scene.instances_revision;
+}
+
+void SkinMeshesVulkan::upload_skinned_meshes(const Scene &scene) {
+    skinned_instances.clear();
+    animation_data.clear();
+    bone_index_tuples = nullptr;
+    bone_transforms = nullptr;
+
+    vkrt::MemorySource static_memory_arena(*device, backend->base_arena_idx + backend->StaticArenaOffset);
+    vkrt::MemorySource scratch_memory_arena(*device, vkrt::Device::ScratchArena);
+    auto async_commands = device.async_command_stream();
+    async_commands->begin_record();
+
+    uint32_t palette_size = 0;
+    for (auto& instance : scene.instances) {
+        int mesh_id = scene.parameterized_meshes[instance.parameterized_mesh_id].mesh_id;
+        Mesh const& mesh = scene.meshes[mesh_id];
+        if (!(mesh.flags & Mesh::Skinned))
+            continue;
+        vkrt::TriangleMesh& vkmesh = *backend->meshes[mesh_id];
+        if (!vkmesh.is_dynamic())
+            throw_error("Skinned mesh %s requires an updatable BLAS", mesh.mesh_name.c_str());
+
+        SkinnedInstance skinned;
+        skinned.instance = instance;
+        skinned.mesh_id = mesh_id;
+        skinned.vertex_count = skinned_vertex_count(mesh);
+        skinned.palette.initialize(scene, instance);
+        skinned.palette_offset = palette_size;
+        palette_size += uint32_t(skinned.palette.bone_transforms.size());
+
+        // blend attributes of all geometries, in the order of the mesh vertex buffers
+        skinned.blend_attributes = vkrt::Buffer::device(static_memory_arena
+            , sizeof(uint32_t) * std::max(skinned.vertex_count, 1)
+            , SKINNING_BUFFER_USAGE);
+        {
+            auto upload_attributes = skinned.blend_attributes->for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, scratch_memory_arena);
+            uint32_t* map = (uint32_t*) upload_attributes->map();
+            for (auto& geom : mesh.geometries) {
+                int vertex_count = geom.num_verts();
+                if (int_cast(geom.blend_attributes.size()) == vertex_count)
+                    std::memcpy(map, geom.blend_attributes.data(), geom.blend_attributes.nbytes());
+                else if (geom.blend_attributes.empty())
+                    std::fill(map, map + vertex_count, UNSKINNED_BLEND_ATTRIBUTES);
+                else
+                    throw_error("Skinned mesh %s has %d blend attributes for %d vertices"
+                        , mesh.mesh_name.c_str(), int_cast(geom.blend_attributes.size()), vertex_count);
+                map += vertex_count;
+            }
+            upload_attributes->unmap();
+
+            VkBufferCopy copy_cmd = {};
+            copy_cmd.size = upload_attributes->size();
+            vkCmdCopyBuffer(async_commands->current_buffer,
+                            upload_attributes->handle(),
+                            skinned.blend_attributes->handle(),
+                            1,
+                            &copy_cmd);
+            async_commands->hold_buffer(upload_attributes);
+        }
+
+        // the skinning pass overwrites the normals, keep those of the rest pose
+        vkrt::Buffer normal_buf = nullptr;
+        for (auto& geom : vkmesh.geometries)
+            if (geom.normal_buf) {
+                normal_buf = geom.normal_buf;
+                break;
+            }
+        if (normal_buf) {
+            skinned.rest_normals = vkrt::Buffer::device(static_memory_arena, normal_buf->size(), SKINNING_BUFFER_USAGE);
+
+            VkBufferCopy copy_cmd = {};
+            copy_cmd.size = normal_buf->size();
+            vkCmdCopyBuffer(async_commands->current_buffer,
+                            normal_buf->handle(),
+                            skinned.rest_normals->handle(),
+                            1,
+                            &copy_cmd);
+        }
+
+        skinned_instances.push_back(std::move(skinned));
+    }
+
+    if (!skinned_instances.empty()) {
+        animation_data = scene.animation_data;
+
+        // tuple tables of all animation data entries, six 16-bit transform indices per tuple
+        std::vector<uint16_t> tuples;
+        bone_index_tuple_offsets.clear();
+        for (auto& anim : animation_data) {
+            bone_index_tuple_offsets.push_back(uint32_t(tuples.size() / SKINNING_MAX_INFLUENCES));
+            tuples.insert(tuples.end(), anim.bone_index_tuples.begin(), anim.bone_index_tuples.end());
+        }
+        if (tuples.empty())
+            tuples.resize(SKINNING_MAX_INFLUENCES, 0);
+
+        bone_index_tuples = vkrt::Buffer::device(static_memory_arena, sizeof(uint16_t) * tuples.size(), SKINNING_BUFFER_USAGE);
+        auto upload_tuples = bone_index_tuples->for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, scratch_memory_arena);
+        std::memcpy(upload_tuples->map(), tuples.data(), sizeof(uint16_t) * tuples.size());
+        upload_tuples->unmap();
+
+        VkBufferCopy copy_cmd = {};
+        copy_cmd.size = upload_tuples->size();
+        vkCmdCopyBuffer(async_commands->current_buffer,
+                        upload_tuples->handle(),
+                        bone_index_tuples->handle(),
+                        1,
+                        &copy_cmd);
+        async_commands->hold_buffer(upload_tuples);
+
+        // updated by the host in every frame that changes the pose
+        bone_transforms = vkrt::Buffer::device(*device,
+                                               sizeof(glm::mat4) * std::max(palette_size, 1u),
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                               backend->swap_buffer_count);
+
+        println(CLL::VERBOSE, "Skinning %d mesh instances with %u bone transforms", ilen(skinned_instances), palette_size);
+    }
+
+    async_commands->end_submit();
+}
+
+// processing pipeline
+void SkinMeshesVulkan::register_custom_descriptors(vkrt::BindingLayoutCollector collector, vkrt::RenderPipelineOptions const& options) const {
+    // all data is accessed through buffer device addresses
+}
+// processing pipeline
+void SkinMeshesVulkan::update_custom_shader_descriptor_table(vkrt::BindingCollector collector, vkrt::RenderPipelineOptions const& options, VkDescriptorSet desc_set) {
+}
+
+void SkinMeshesVulkan::preprocess(CommandStream* cmd_stream_, int variant_idx) {
+    bool pose_changed = false;
+    for (auto& skinned : skinned_instances) {
+        auto& anim = animation_data[skinned.instance.animation_data_index];
+        skinned.deform = skinned.palette.update(anim, skinned.instance, anim.frame_at_time(backend->time));
+        pose_changed |= skinned.deform;
+    }
+    if (!pose_changed)
+        return;
+
+    auto cmd_stream = dynamic_cast<vkrt::CommandStream*>(cmd_stream_);
+    if (!cmd_stream)
+        cmd_stream = device.sync_command_stream();
+
+    if (!cmd_stream_)
+        cmd_stream->begin_record();
+    VkCommandBuffer render_cmd_buf = cmd_stream->current_buffer;
+
+    // all palettes are written, as the buffer cycles through the swap chain
+    bone_transforms.cycle_swap(backend->active_swap_buffer_count);
+    glm::mat4* palette_map = (glm::mat4*) bone_transforms->map();
+    for (auto& skinned : skinned_instances)
+        std::copy(skinned.palette.bone_transforms.begin(), skinned.palette.bone_transforms.end(), palette_map + skinned.palette_offset);
+    bone_transforms->unmap();
+    VkDeviceAddress palette_address = bone_transforms->device_address() + bone_transforms->swap_offset();
+
+    backend->lazy_update_shader_descriptor_table(skinning_pipeline.get(), backend->swap_index, this);
+
+    for (auto& skinned : skinned_instances) {
+        if (!skinned.deform)
+            continue;
+        uint32_t anim_idx = skinned.instance.animation_data_index;
+        vkrt::TriangleMesh& vkmesh = *backend->meshes[skinned.mesh_id];
+        for (auto& geom : vkmesh.geometries) {
+            SkinMeshesPushConstants push_const = { };
+            push_const.rest_vertices = geom.vertex_buf->device_address() + sizeof(uint64_t) * geom.vertex_offset;
+            push_const.blend_attributes = skinned.blend_attributes->device_address() + sizeof(uint32_t) * geom.vertex_offset;
+            push_const.bone_index_tuples = bone_index_tuples->device_address()
+                + sizeof(uint16_t) * SKINNING_MAX_INFLUENCES * bone_index_tuple_offsets[anim_idx];
+            push_const.bone_transforms = palette_address + sizeof(glm::mat4) * skinned.palette_offset;
+            push_const.vertices = geom.float_vertex_buf->device_address() + sizeof(glm::vec3) * geom.vertex_offset;
+            if (geom.normal_buf && skinned.rest_normals) {
+                push_const.rest_normals = skinned.rest_normals->device_address() + sizeof(uint64_t) * geom.vertex_offset;
+                push_const.normals = geom.normal_buf->device_address() + sizeof(uint64_t) * geom.vertex_offset;
+                push_const.flags |= SKIN_MESHES_NORMALS;
+            }
+            push_const.vertex_count = uint32_t(geom.num_active_vertices);
+            push_const.first_bone = skinned.palette.first_bone;
+            push_const.tuple_count = uint32_t(animation_data[anim_idx].bone_index_tuples.size() / SKINNING_MAX_INFLUENCES);
+            push_const.quantized_scaling = geom.quantized_scaling;
+            push_const.quantized_offset = geom.quantized_offset;
+
+            skinning_pipeline->bind_pipeline(render_cmd_buf
+                , &push_const, sizeof(push_const)
+                , backend->swap_index, this);
+            skinning_pipeline->dispatch_rays(render_cmd_buf, geom.num_active_vertices, 1, 1);
+        }
+    }
+
+    // deformed normals are read by all subsequent passes, refits wait on their own
+    {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(render_cmd_buf,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             1, &barrier,
+                             0, nullptr,
+                             0, nullptr);
+    }
+    for (auto& skinned : skinned_instances)
+        if (skinned.deform)
+            backend->meshes[skinned.mesh_id]->enqueue_refit(render_cmd_buf);
+    backend->request_tlas_operation(RenderVulkan::BVHOperation::Refit);
+
+    if (!cmd_stream_)
+        cmd_stream->end_submit();
+}
+
+namespace vkrt {
+    void create_default_skinning_extensions(std::vector<std::unique_ptr<RenderExtension>>& extensions, RenderVulkan* backend) {
+        extensions.push_back( std::unique_ptr<RenderExtension>(new SkinMeshesVulkan(backend)) );
+    }
+} // namespace
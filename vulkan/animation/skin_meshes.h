@@ -0,0 +1,54 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../render_pipeline_vulkan.h"
+#include <librender/skinning.h>
+
+// Deforms skinned meshes into their dynamic vertex buffers on the GPU and refits
+// the affected BLAS, see librender/skinning.h for the CPU reference.
+struct SkinMeshesVulkan : ProcessingPipelineExtensionVulkan {
+    vkrt::Device device;
+    RenderVulkan* backend;
+
+    std::unique_ptr<RenderPipelineVulkan> skinning_pipeline;
+
+    struct SkinnedInstance {
+        Instance instance;
+        int mesh_id = -1;
+        int vertex_count = 0;
+        SkinningPalette palette;
+        uint32_t palette_offset = 0; // in bone transforms
+        vkrt::Buffer blend_attributes = nullptr;
+        vkrt::Buffer rest_normals = nullptr; // copy of the quantized normals and uvs
+        bool deform = false; // pose changed in the current frame
+    };
+    std::vector<SkinnedInstance> skinned_instances;
+    std::vector<AnimationData> animation_data;
+    vkrt::Buffer bone_index_tuples = nullptr; // per animation data entry, concatenated
+    std::vector<uint32_t> bone_index_tuple_offsets;
+    vkrt::Buffer bone_transforms = nullptr; // host-visible, cycled with the swap chain
+
+    unsigned unique_scene_id = 0;
+    unsigned meshes_revision = ~0;
+    unsigned instances_revision = ~0;
+
+    SkinMeshesVulkan(RenderVulkan* backend);
+    virtual ~SkinMeshesVulkan();
+    void internal_release_resources();
+
+    std::string name() const override;
+
+    bool is_active_for(RenderBackendOptions const& rbo) const override;
+    void preprocess(CommandStream* cmd_stream, int variant_idx) override;
+
+    void initialize(const int fb_width, const int fb_height) override;
+    void update_scene_from_backend(const Scene& scene) override;
+
+    void register_custom_descriptors(vkrt::BindingLayoutCollector collector, vkrt::RenderPipelineOptions const& options) const override;
+    void update_custom_shader_descriptor_table(vkrt::BindingCollector collector, vkrt::RenderPipelineOptions const& options, VkDescriptorSet desc_set) override;
+
+private:
+    void upload_skinned_meshes(const Scene& scene);
+};
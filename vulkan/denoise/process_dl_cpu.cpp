@@ -0,0 +1,220 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#include "process_dl_cpu.h"
+#include "../render_vulkan.h"
+
+#include "types.h"
+#include "util.h"
+#include "error_io.h"
+#include "compute_util.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace glsl {
+    using namespace glm;
+    #include "../../rendering/language.hpp"
+    #include "../gpu_params.glsl"
+}
+
+template <> std::unique_ptr<RenderExtension> create_render_extension<ProcessDLDenoisingVulkan>(RenderBackend* backend) {
+    return std::unique_ptr<RenderExtension>( new ProcessDLDenoisingVulkan(&dynamic_cast<RenderVulkan&>(*backend)) );
+}
+
+namespace {
+
+void record_image_copy(VkCommandBuffer cmd_buf, vkrt::Texture2D& texture, vkrt::Buffer& buffer, bool to_buffer) {
+    BUFFER_BARRIER(buf_barrier);
+    buf_barrier.buffer = buffer;
+    buf_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_HOST_READ_BIT;
+    buf_barrier.dstAccessMask = to_buffer ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+    auto img_barrier = texture->transition_color(VK_IMAGE_LAYOUT_GENERAL
+        , to_buffer ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdPipelineBarrier(cmd_buf,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0, nullptr,
+                         1, &buf_barrier,
+                         1, &img_barrier);
+
+    VkBufferImageCopy img_copy = {};
+    img_copy.imageSubresource = texture->color_subresource();
+    img_copy.imageExtent.width = texture->dims().x;
+    img_copy.imageExtent.height = texture->dims().y;
+    img_copy.imageExtent.depth = 1;
+    if (to_buffer)
+        vkCmdCopyImageToBuffer(cmd_buf, texture, VK_IMAGE_LAYOUT_GENERAL, buffer->handle(), 1, &img_copy);
+    else
+        vkCmdCopyBufferToImage(cmd_buf, buffer->handle(), texture, VK_IMAGE_LAYOUT_GENERAL, 1, &img_copy);
+
+    if (to_buffer) {
+        buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        buf_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                             0,
+                             0, nullptr,
+                             1, &buf_barrier,
+                             0, nullptr);
+    } else {
+        img_barrier = texture->transition_color(VK_IMAGE_LAYOUT_GENERAL);
+        img_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &img_barrier);
+    }
+}
+
+// 4 channels of half or float pixels
+void read_pixels(vkrt::Buffer& buffer, size_t pixel_size, std::vector<float>& pixels) {
+    void const* data = buffer->map();
+    buffer->invalidate_all();
+    if (pixel_size == 4 * sizeof(float))
+        std::memcpy(pixels.data(), data, sizeof(float) * pixels.size());
+    else {
+        FP16 const* halfs = (FP16 const*) data;
+        for (size_t i = 0, count = pixels.size(); i < count; ++i)
+            pixels[i] = half_to_float(halfs[i]).f;
+    }
+    buffer->unmap();
+}
+
+void write_pixels(vkrt::Buffer& buffer, size_t pixel_size, std::vector<float> const& pixels) {
+    void* data = buffer->map();
+    if (pixel_size == 4 * sizeof(float))
+        std::memcpy(data, pixels.data(), sizeof(float) * pixels.size());
+    else {
+        FP16* halfs = (FP16*) data;
+        for (size_t i = 0, count = pixels.size(); i < count; ++i) {
+            FP32 f;
+            f.f = pixels[i];
+            halfs[i] = float_to_half(f);
+        }
+    }
+    buffer->flush_all();
+    buffer->unmap();
+}
+
+} // namespace
+
+ProcessDLDenoisingVulkan::ProcessDLDenoisingVulkan(RenderVulkan* backend)
+    : device(backend->device)
+    , backend(backend)
+{
+    try { // need to handle all exceptions from here for manual multi-resource cleanup!
+        std::string network_file = default_denoiser_network_file();
+        if (file_exists(network_file)) {
+            denoiser.reset( new NeuralDenoiser(load_neural_network(network_file)) );
+            println(CLL::INFORMATION, "Loaded denoising network %s: %d layers, %dx%d window%s"
+                , network_file.c_str(), ilen(denoiser->network.layers), denoiser->window, denoiser->window
+                , denoiser->network.quantized ? ", int8" : "");
+            profile.reset(denoiser->network.layers.size());
+        } else
+            warning("No denoising network found at %s, denoising disabled", network_file.c_str());
+    } catch (...) {
+        internal_release_resources();
+        throw;
+    }
+}
+
+ProcessDLDenoisingVulkan::~ProcessDLDenoisingVulkan() {
+    internal_release_resources();
+}
+
+void ProcessDLDenoisingVulkan::internal_release_resources() {
+    vkDeviceWaitIdle(device->logical_device());
+}
+
+std::string ProcessDLDenoisingVulkan::name() const {
+    return "Vulkan CPU DL Denoising Extension";
+}
+
+void ProcessDLDenoisingVulkan::initialize(const int fb_width, const int fb_height) {
+    // buffers follow the dimensions found in process, which depend on upscaling
+    buffer_dims = glm::ivec2(0);
+    warned_mismatch = false;
+}
+
+void ProcessDLDenoisingVulkan::update_scene_from_backend(const Scene &scene) {
+}
+
+void ProcessDLDenoisingVulkan::process(CommandStream* cmd_stream_, int variant_idx) {
+    if (!denoiser)
+        return;
+    if (cmd_stream_)
+        throw_error("CPU denoising requires synchronous rendering");
+
+    vkrt::Texture2D& color_buffer = backend->current_color_buffer;
+    vkrt::Texture2D& albedo_buffer = backend->aov_buffer(RenderVulkan::AOVAlbedoRoughnessIndex);
+    vkrt::Texture2D& normal_buffer = backend->aov_buffer(RenderVulkan::AOVNormalDepthIndex);
+    glm::ivec2 dims = color_buffer->dims();
+    if (albedo_buffer->dims() != dims || normal_buffer->dims() != dims) {
+        if (!warned_mismatch)
+            warning("CPU denoising skipped, color (%dx%d) and feature buffers (%dx%d) differ in size"
+                , dims.x, dims.y, albedo_buffer->dims().x, albedo_buffer->dims().y);
+        warned_mismatch = true;
+        return;
+    }
+
+    if (dims != buffer_dims || color_buffer->pixel_size() != color_pixel_size) {
+        vkDeviceWaitIdle(device->logical_device());
+        buffer_dims = dims;
+        color_pixel_size = color_buffer->pixel_size();
+        size_t pixel_count = size_t(dims.x) * dims.y;
+        vkrt::MemorySource memory_arena(*device, backend->base_arena_idx + backend->StaticArenaOffset);
+        color_readback = vkrt::Buffer::host(memory_arena, pixel_count * color_pixel_size
+            , VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        albedo_readback = vkrt::Buffer::host(memory_arena, pixel_count * albedo_buffer->pixel_size()
+            , VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        normal_readback = vkrt::Buffer::host(memory_arena, pixel_count * normal_buffer->pixel_size()
+            , VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        color_upload = vkrt::Buffer::host(memory_arena, pixel_count * color_pixel_size
+            , VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        for (auto* pixels : { &color, &albedo, &normal, &denoised })
+            pixels->resize(4 * pixel_count);
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto cmd_stream = device.sync_command_stream();
+    cmd_stream->begin_record();
+    record_image_copy(cmd_stream->current_buffer, color_buffer, color_readback, true);
+    record_image_copy(cmd_stream->current_buffer, albedo_buffer, albedo_readback, true);
+    record_image_copy(cmd_stream->current_buffer, normal_buffer, normal_readback, true);
+    cmd_stream->end_submit();
+
+    read_pixels(color_readback, color_pixel_size, color);
+    read_pixels(albedo_readback, albedo_buffer->pixel_size(), albedo);
+    read_pixels(normal_readback, normal_buffer->pixel_size(), normal);
+
+    DenoiserImages images;
+    images.width = dims.x;
+    images.height = dims.y;
+    images.color = color.data();
+    images.albedo = albedo.data();
+    images.normal = normal.data();
+    denoiser->denoise(images, denoised.data(), 0, &profile);
+
+    write_pixels(color_upload, color_pixel_size, denoised);
+    cmd_stream->begin_record();
+    record_image_copy(cmd_stream->current_buffer, color_buffer, color_upload, false);
+    cmd_stream->end_submit();
+
+    profile_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (++profile_frames == PROFILE_INTERVAL) {
+        double megapixels = double(dims.x) * dims.y * 1.e-6 * profile_frames;
+        println(CLL::INFORMATION, "CPU denoising: %.2f ms per frame, %.2f MP/s including transfers"
+            , profile_seconds * 1.e3 / profile_frames, megapixels / profile_seconds);
+        denoiser->network.print_profile(profile, "CPU denoising");
+        profile.reset(denoiser->network.layers.size());
+        profile_seconds = 0.0;
+        profile_frames = 0;
+    }
+}
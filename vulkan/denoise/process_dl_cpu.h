@@ -0,0 +1,43 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "../render_pipeline_vulkan.h"
+#include <librender/neural_denoiser.h>
+
+// Runs a VkrTensor denoising network on the CPU (see librender/neural_denoiser.h),
+// reading back color, albedo and normal buffers and replacing the linear HDR color.
+// Requires synchronous rendering.
+struct ProcessDLDenoisingVulkan : RenderExtension {
+    static int const PROFILE_INTERVAL = 64; // frames between profile reports
+
+    vkrt::Device device;
+    RenderVulkan* backend;
+
+    std::unique_ptr<NeuralDenoiser> denoiser;
+
+    glm::ivec2 buffer_dims = glm::ivec2(0);
+    size_t color_pixel_size = 0;
+    vkrt::Buffer color_readback = nullptr;
+    vkrt::Buffer albedo_readback = nullptr;
+    vkrt::Buffer normal_readback = nullptr;
+    vkrt::Buffer color_upload = nullptr;
+    std::vector<float> color, albedo, normal, denoised;
+
+    NeuralProfile profile;
+    double profile_seconds = 0.0;
+    int profile_frames = 0;
+    bool warned_mismatch = false;
+
+    ProcessDLDenoisingVulkan(RenderVulkan* backend);
+    virtual ~ProcessDLDenoisingVulkan();
+    void internal_release_resources();
+
+    std::string name() const override;
+
+    void initialize(const int fb_width, const int fb_height) override;
+    void update_scene_from_backend(const Scene& scene) override;
+
+    void process(CommandStream* cmd_stream, int variant_idx) override;
+};
@@ -0,0 +1,83 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef VULKAN_ENVIRONMENT_MAP_GLSL
+#define VULKAN_ENVIRONMENT_MAP_GLSL
+
+// Evaluation and importance sampling of the environment map built on the CPU
+// (librender/environment_map.h). If scene_params.environment_map is set, the map replaces
+// sky and sun as the distant light: it is sampled by NEE in place of the sun, and
+// vec3(scene_params.sun_radiance) holds the intensity it is scaled by.
+#define ENABLE_ENVIRONMENT_MAP
+
+#include "../librender/environment_map.glsl"
+
+layout(binding = ENVIRONMENT_MAP_BIND_POINT, set = 0, std430) buffer EnvironmentMapBuf {
+    EnvironmentMapHeader environment_map_header;
+    float environment_map_data[];
+};
+
+vec3 environment_map_radiance(vec3 dir) {
+    int width = int(environment_map_header.width), height = int(environment_map_header.height);
+    uint t = 3 * uint(environment_map_texel(dir.x, dir.y, dir.z, width, height, scene_params.environment_rotation));
+    return vec3(environment_map_data[t], environment_map_data[t + 1], environment_map_data[t + 2]);
+}
+
+float environment_map_power(int col, int row) {
+    return environment_map_data[environment_map_header.level_offsets[0] + uint(row) * environment_map_header.pyramid_width + uint(col)];
+}
+
+float environment_map_pdf(vec3 dir) {
+    int width = int(environment_map_header.width), height = int(environment_map_header.height);
+    int t = environment_map_texel(dir.x, dir.y, dir.z, width, height, scene_params.environment_rotation);
+    int row = t / width;
+    return environment_map_texel_density(environment_map_power(t - row * width, row), environment_map_header.total_power, row, width, height);
+}
+
+// as EnvironmentMap::sample(), descends the pyramid choosing the row by u.y and the
+// column by u.x, then places the direction within the texel
+vec3 environment_map_sample(vec2 u, out float pdf) {
+    int x = 0, y = 0;
+    int pw = int(environment_map_header.pyramid_width), ph = int(environment_map_header.pyramid_height);
+    for (int l = int(environment_map_header.level_count) - 2; l >= 0; --l) {
+        int w = environment_map_level_dim(pw, l);
+        int h = environment_map_level_dim(ph, l);
+        uint level = environment_map_header.level_offsets[l];
+        bool split_x = w > environment_map_level_dim(pw, l + 1);
+        bool split_y = h > environment_map_level_dim(ph, l + 1);
+        x = split_x ? 2 * x : x;
+        y = split_y ? 2 * y : y;
+        if (split_y) {
+            uint upper_texel = level + uint(y * w + x);
+            uint lower_texel = upper_texel + uint(w);
+            float upper = environment_map_data[upper_texel] + (split_x ? environment_map_data[upper_texel + 1] : 0.0f);
+            float lower = environment_map_data[lower_texel] + (split_x ? environment_map_data[lower_texel + 1] : 0.0f);
+            float p = upper / (upper + lower);
+            if (u.y < p || lower <= 0.0f)
+                u.y = min(u.y / p, 1.0f);
+            else {
+                u.y = min((u.y - p) / (1.0f - p), 1.0f);
+                ++y;
+            }
+        }
+        if (split_x) {
+            float left = environment_map_data[level + uint(y * w + x)];
+            float right = environment_map_data[level + uint(y * w + x + 1)];
+            float p = left / (left + right);
+            if (u.x < p || right <= 0.0f)
+                u.x = min(u.x / p, 1.0f);
+            else {
+                u.x = min((u.x - p) / (1.0f - p), 1.0f);
+                ++x;
+            }
+        }
+    }
+    int width = int(environment_map_header.width), height = int(environment_map_header.height);
+    float cos_theta = environment_map_texel_cos_theta(y, height, u.y);
+    float sin_theta = sqrt(max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = environment_map_texel_phi(x, width, u.x, scene_params.environment_rotation);
+    pdf = environment_map_texel_density(environment_map_power(x, y), environment_map_header.total_power, y, width, height);
+    return vec3(sin_theta * cos(phi), cos_theta, sin_theta * sin(phi));
+}
+
+#endif
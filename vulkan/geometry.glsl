@@ -42,6 +42,10 @@ layout(buffer_reference, buffer_reference_align=4, scalar) buffer MotionVectorBu
 #endif
 };
 
+layout(buffer_reference, buffer_reference_align=4, scalar) buffer OpacityStateBuffer {
+    uint32_t packed[];
+};
+
 #define VERTEX_BUFFER_TYPE VertexBuffer
 
 #ifdef QUANTIZED_POSITIONS
@@ -70,6 +74,7 @@ layout(buffer_reference, buffer_reference_align=4, scalar) buffer DynamicVertexB
 #define MATERIAL_ID_BUFFER_TYPE MaterialBuffer
 #define INDEX_BUFFER_TYPE IndexBuffer
 #define MOTION_VECTOR_BUFFER_TYPE MotionVectorBuffer
+#define OPACITY_STATE_BUFFER_TYPE OpacityStateBuffer
 
 #include "rt/geometry.h.glsl"
 
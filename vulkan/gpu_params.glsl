@@ -35,6 +35,8 @@
 #define ACCUMULATION_FLAGS_ATOMIC 0x1
 #define ACCUMULATION_FLAGS_AOVS 0x2
 #define ACCUMULATION_FLAGS_SEPARATE_REFLECTIONS 0x4
+#define ACCUMULATION_FLAGS_ADAPTIVE 0x8
+#define ACCUMULATION_FLAGS_PATH_GUIDING 0x10
 
 #ifdef PIXEL_FILTER_TENT_WINDOW
 #define SAMPLE_PIXEL_FILTER(urand) (PIXEL_FILTER_TENT_WINDOW * sample_tent(urand))
@@ -64,7 +66,8 @@ struct ViewParams {
     uvec2 frame_dims;
 
     vec2 screen_jitter;
-    vec2 _pad1;
+    uint32_t accumulation_frame; // frames since frame_id was reset, frame_id counts samples
+    uint32_t _pad1;
 
     // pinhole camera currently used by RT
     vec3 cam_pos;
@@ -114,7 +117,11 @@ struct LightSamplingSceneParams {
     int32_t light_count;
     int32_t optimized_bin_size;
     int32_t optimized_light_bin_count;
+    int32_t quad_light_count; // quad lights are stored after light_count tri lights
+    float quad_light_probability; // of selecting quad lights over tri lights
     int32_t _pad1;
+    int32_t _pad2;
+    int32_t _pad3;
 };
 
 struct SceneParams {
@@ -124,8 +131,10 @@ struct SceneParams {
 
     float normal_z_scale;
     uint32_t num_local_lights;
-    int32_t _pad2;
-    int32_t _pad3;
+    // nonzero if the environment map (environment_map.glsl) replaces sky and sun
+    uint32_t environment_map;
+    // rotation of the environment map around the y axis, in radians
+    float environment_rotation;
 
     LightSamplingSceneParams light_sampling;
 };
@@ -178,10 +187,19 @@ struct RasterUniformParams {
 
 #define DENOISE_BUFFER_BIND_POINT 20
 
+#define ADAPTIVE_SAMPLING_STATS_BIND_POINT 21
+#define ADAPTIVE_SAMPLING_TOTALS_BIND_POINT 22
+
+#define PATH_GUIDING_FIELD_BIND_POINT 23
+
 #define DEBUG_MODE_BUFFER 24
 
+#define PATH_GUIDING_SAMPLES_BIND_POINT 25
+
+#define ENVIRONMENT_MAP_BIND_POINT 26
+
 // First available slot that can be used by extensions.
-#define EMPTY_BIND_POINT 25
+#define EMPTY_BIND_POINT 27
 
 #define QUERY_BIND_SET 0
 
@@ -77,6 +77,7 @@ void RenderBinnedLightsVulkan::update_scene_from_backend(const Scene &scene) {
         if (!lights)
             lights = std::make_unique<LightSamplingSetup>();
         lights->emitters = collect_emitters(scene);
+        lights->quad_emitters = collect_quad_emitters(scene);
         update_lights(backend->lighting_params);
         this->lights_revision = scene.lights_revision;
     }
@@ -107,20 +108,24 @@ void RenderBinnedLightsVulkan::update_lights(LightSamplingConfig const& params)
 
     auto async_commands = device.async_command_stream();
 
+    // quad lights follow the (binned) tri lights in the same buffer
+    size_t quadLightCount = lights->quad_emitters.size();
     size_t lightBufferSize = std::max(size_t(1), lights->emitters.size());
-    lightBufferSize = std::max(lightBufferSize, lights->binned.emitters.size());
+    lightBufferSize = std::max(lightBufferSize, lights->binned.emitters.size() + quadLightCount);
     if (!light_params || light_params.size() / sizeof(TriLightData) < lightBufferSize) {
         light_params = vkrt::Buffer::device(reuse(vkrt::MemorySource(*device, backend->base_arena_idx + backend->StaticArenaOffset), light_params),
             sizeof(TriLightData) * lightBufferSize,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     }
-    if (!lights->binned.emitters.empty())
+    if (!lights->binned.emitters.empty() || quadLightCount > 0)
     {
         auto upload_light_params = light_params->secondary_for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        void *map = upload_light_params->map();
+        char *map = (char*) upload_light_params->map();
 
         // todo: support quantization
-        std::memcpy(map, lights->binned.emitters.data(), lights->binned.emitters.size() * sizeof(TriLightData));
+        size_t triLightBytes = lights->binned.emitters.size() * sizeof(TriLightData);
+        std::memcpy(map, lights->binned.emitters.data(), triLightBytes);
+        std::memcpy(map + triLightBytes, lights->quad_emitters.data(), quadLightCount * sizeof(TriLightData));
         
         upload_light_params->unmap();
 
@@ -143,6 +148,8 @@ void RenderBinnedLightsVulkan::update_lights(LightSamplingConfig const& params)
     sceneParams.light_sampling.light_count = lights->binned.emitters.size();
     sceneParams.light_sampling.optimized_bin_size = lights->binned.params.bin_size;
     sceneParams.light_sampling.optimized_light_bin_count = lights->binned.bin_count();
+    sceneParams.light_sampling.quad_light_count = int_cast(quadLightCount);
+    sceneParams.light_sampling.quad_light_probability = quad_light_selection_probability(lights->quad_emitters, lights->binned.emitters);
 
     // export for interop extensions
     backend->binned_light_params = light_params;
@@ -0,0 +1,96 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+#ifndef VULKAN_PATH_GUIDING_GLSL
+#define VULKAN_PATH_GUIDING_GLSL
+
+// Sampling of the guiding field and recording of training samples in the megakernel
+// integrators. The field is fitted on the CPU between frames (librender/path_guiding.h),
+// guiding and training are active if ACCUMULATION_FLAGS_PATH_GUIDING is set.
+#define ENABLE_PATH_GUIDING
+
+#include "../librender/path_guiding.glsl"
+
+layout(binding = PATH_GUIDING_FIELD_BIND_POINT, set = 0, std430) buffer PathGuidingFieldBuf {
+    PathGuidingFieldHeader path_guiding_header;
+    PathGuidingNode path_guiding_nodes[PATH_GUIDING_MAX_NODES];
+    float path_guiding_cdfs[];
+};
+layout(binding = PATH_GUIDING_SAMPLES_BIND_POINT, set = 0, std430) buffer PathGuidingSampleBuf {
+    PathGuidingSampleHeader path_guiding_sample_header;
+    PathGuidingSample path_guiding_samples[];
+};
+
+// lobes of smoother BSDFs are narrower than the bins, these are not guided
+#define PATH_GUIDING_MIN_ROUGHNESS 0.1f
+
+int path_guiding_lookup_cell(vec3 p) {
+    if (path_guiding_header.node_count == 0)
+        return -1;
+    int node = 0;
+    for (int depth = 0; depth <= PATH_GUIDING_MAX_DEPTH; ++depth) {
+        PathGuidingNode n = path_guiding_nodes[node];
+        if (n.axis < 0)
+            return n.cell;
+        node = path_guiding_child(n, p.x, p.y, p.z);
+    }
+    return -1;
+}
+
+float path_guiding_pdf(int cell, vec3 dir) {
+    uint base = uint(cell) * PATH_GUIDING_BINS;
+    int bin = path_guiding_direction_bin(dir.x, dir.y, dir.z);
+    float p = path_guiding_cdfs[base + bin] - (bin > 0 ? path_guiding_cdfs[base + bin - 1] : 0.0f);
+    return path_guiding_bin_density(p);
+}
+
+// note: the density of sampled directions is path_guiding_pdf(), which is evaluated
+// the same way for directions sampled from the BSDF
+vec3 path_guiding_sample(int cell, float u_bin, vec2 u) {
+    uint base = uint(cell) * PATH_GUIDING_BINS;
+    // first bin whose cumulative probability exceeds u_bin
+    int first = 0, count = PATH_GUIDING_BINS;
+    while (count > 0) {
+        int step = count / 2;
+        if (path_guiding_cdfs[base + first + step] <= u_bin) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    int bin = min(first, PATH_GUIDING_BINS - 1);
+    float cos_theta = path_guiding_bin_cos_theta(bin, u.x);
+    float sin_theta = sqrt(max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = path_guiding_bin_phi(bin, u.y);
+    return vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+// Guided path vertex, the radiance arriving along the sampled direction is everything
+// the path gathers afterwards, relative to the throughput of the continued path
+struct PathGuidingVertex {
+    vec3 position;
+    float pdf;
+    vec3 direction;
+    vec3 illum;
+    vec3 throughput;
+};
+
+void path_guiding_record(PathGuidingVertex vertices[PATH_GUIDING_PATH_VERTICES], int vertex_count, vec3 illum) {
+    uint index = atomicAdd(path_guiding_sample_header.count, uint(vertex_count));
+    for (int i = 0; i < vertex_count && index < PATH_GUIDING_MAX_SAMPLES; ++i, ++index) {
+        PathGuidingVertex v = vertices[i];
+        vec3 incident = max(illum - v.illum, vec3(0.0f));
+        vec3 radiance = vec3(
+              v.throughput.x > 0.0f ? incident.x / v.throughput.x : 0.0f
+            , v.throughput.y > 0.0f ? incident.y / v.throughput.y : 0.0f
+            , v.throughput.z > 0.0f ? incident.z / v.throughput.z : 0.0f);
+        path_guiding_samples[index] = PathGuidingSample(
+              v.position.x, v.position.y, v.position.z
+            , v.direction.x, v.direction.y, v.direction.z
+            , dot(radiance, vec3(0.2126f, 0.7152f, 0.0722f))
+            , v.pdf);
+    }
+}
+
+#endif
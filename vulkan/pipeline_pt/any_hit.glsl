@@ -61,6 +61,15 @@ void main()
       payload.any_hit_count += 1.0f;
 #endif
 
+    // baked opacity states skip the material evaluation for known triangles
+    if ((geom.flags & GEOMETRY_FLAGS_OPACITY_STATES) != 0) {
+      uint32_t opacity_state = calc_hit_opacity_state(geom.opacity_states, gl_PrimitiveID);
+      if (opacity_state == OPACITY_STATE_OPAQUE)
+        return;
+      if (opacity_state == OPACITY_STATE_TRANSPARENT)
+        ignoreIntersectionEXT;
+    }
+
     const uvec3 primIdx = 
 #ifndef REQUIRE_UNROLLED_VERTICES
        ((geom.flags & GEOMETRY_FLAGS_IMPLICIT_INDICES) == 0) ? geom.indices.i[gl_PrimitiveID] :
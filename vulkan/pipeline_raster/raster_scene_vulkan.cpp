@@ -347,9 +347,36 @@ void RasterScenePipelineVulkan::update_shader_descriptor_table(vkrt::DescriptorS
         this->framebuffer_targets.push_back(framebuffer_targets[i]);
 }
 
+// Appends the triangle ranges of meshlets that are inside the view frustum of any instance,
+// neighboring meshlets are merged into one range
+static void visible_meshlet_ranges(Meshlet const* meshlets, int meshlet_count
+    , std::vector<MeshletFrustum> const& frustums, std::vector<glm::ivec2>& ranges) {
+    for (int i = 0; i < meshlet_count; ++i) {
+        auto const& m = meshlets[i];
+        bool visible = false;
+        for (auto const& frustum : frustums)
+            if (!frustum.culls(m.bounds)) {
+                visible = true;
+                break;
+            }
+        if (!visible)
+            continue;
+        if (!ranges.empty() && ranges.back().x + ranges.back().y == int(m.triangle_offset))
+            ranges.back().y += int(m.triangle_count);
+        else
+            ranges.push_back(glm::ivec2(m.triangle_offset, m.triangle_count));
+    }
+}
+
 void RasterScenePipelineVulkan::record_raster_commands(VkCommandBuffer render_cmd_buf) {
     VkPipeline currentPipeline = this->pipeline_handle;
 
+    // meshlets are culled per instance, larger instance counts are drawn without culling
+    int const max_culled_instances = 16;
+    glsl::ViewParams const& view_params = *backend->view_params();
+    std::vector<MeshletFrustum> instance_frustums;
+    std::vector<glm::ivec2> triangle_ranges;
+
     int totalInstanceCount = 0;
     for (int pm_idx = 0, pm_idx_end = int_cast(backend->parameterized_instances.size()); pm_idx < pm_idx_end; ++pm_idx) {
         auto const& pmi = backend->parameterized_instances[pm_idx];
@@ -364,6 +391,14 @@ void RasterScenePipelineVulkan::record_raster_commands(VkCommandBuffer render_cm
         VkDeviceSize instanceOffsets[] = { totalInstanceCount * sizeof(uint32_t) };
         vkCmdBindVertexBuffers(render_cmd_buf, 4, 1, instanceBuffers, instanceOffsets);
 
+        instance_frustums.clear();
+        if (instanceCount <= max_culled_instances) {
+            // widen the frustum by the sub-pixel jitter applied in the vertex shader
+            glm::vec2 clip_slack = glm::abs(view_params.screen_jitter);
+            for (uint32_t instance_idx : pmi)
+                instance_frustums.push_back(MeshletFrustum(view_params.VP * backend->instances[instance_idx].transform, clip_slack));
+        }
+
         // all geometries of the current instanced mesh
         for (int j = 0, je = int_cast(mesh->geometries.size()); j < je; ++j) {
             auto const& hit_group_params = mesh_params[j];
@@ -384,10 +419,28 @@ void RasterScenePipelineVulkan::record_raster_commands(VkCommandBuffer render_cm
             vkCmdBindVertexBuffers(render_cmd_buf, 0, vertexBuffers[2] && vertexBuffers[2] != vertexBuffers[1] ? 3 : 2, vertexBuffers, vertexOffsets);
 
             bool use_indices = !geom.indices_are_implicit && geom.index_buf;
+
+            // meshlets are triangle ranges of the index stream, or of unrolled vertices
+            triangle_ranges.clear();
+            bool cull_meshlets = !instance_frustums.empty() && !geom.meshlets.empty()
+                && (use_indices || geom.num_vertices() == geom.num_triangles() * 3);
+            if (cull_meshlets) {
+                visible_meshlet_ranges(geom.meshlets.data(), int_cast(geom.meshlets.size()), instance_frustums, triangle_ranges);
+                if (triangle_ranges.empty())
+                    continue;
+            }
+            else
+                triangle_ranges.push_back(glm::ivec2(0, geom.num_triangles()));
+
             if (use_indices) {
                 vkCmdBindIndexBuffer(render_cmd_buf, geom.index_buf, geom.triangle_offset * 3 * sizeof(uint32_t), VK_INDEX_TYPE_UINT32);
 
-                vkCmdDrawIndexed(render_cmd_buf, geom.num_triangles() * 3, instanceCount, 0, geom.index_offset, 0);
+                for (auto const& range : triangle_ranges)
+                    vkCmdDrawIndexed(render_cmd_buf, range.y * 3, instanceCount, range.x * 3, geom.index_offset, 0);
+            }
+            else if (cull_meshlets) {
+                for (auto const& range : triangle_ranges)
+                    vkCmdDraw(render_cmd_buf, range.y * 3, instanceCount, range.x * 3, 0);
             }
             else
                 vkCmdDraw(render_cmd_buf, geom.num_vertices(), instanceCount, 0, 0);
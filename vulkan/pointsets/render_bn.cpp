@@ -7,12 +7,13 @@
 #include "types.h"
 #include "util.h"
 #include "profiling.h"
+#include "error_io.h"
+#include "bn_tables.h"
 
 #include <algorithm>
 #include <numeric>
 
 #include "../rendering/pointsets/bn_data.h"
-#include "../rendering/pointsets/bn_tables.h"
 
 namespace glsl {
     using namespace glm;
@@ -76,6 +77,16 @@ void RenderBNPointsVulkan::update_shader_descriptor_table(vkrt::BindingCollector
 
 void RenderBNPointsVulkan::update_random_buf()
 {
+    std::string tables_file = default_bn_tables_file();
+    BNTables tables = read_bn_tables(tables_file);
+    // table layout is compiled into the shaders, see rendering/pointsets/bn_data.h
+    if (tables.sample_count != BNData_SampleCount || tables.dimensions != BNData_Dimensions
+     || tables.tile_size != BNData_TileSize || tables.scrambling_dimensions != BNData_ScramblingDimensions)
+        throw_error("Blue-noise tables \"%s\" hold %d spp x %d dimensions with %dx%dx%d tiles, shaders expect %d spp x %d dimensions with %dx%dx%d tiles"
+            , tables_file.c_str()
+            , tables.sample_count, tables.dimensions, tables.tile_size, tables.tile_size, tables.scrambling_dimensions
+            , BNData_SampleCount, BNData_Dimensions, BNData_TileSize, BNData_TileSize, BNData_ScramblingDimensions);
+
     auto async_commands = device.async_command_stream();
 
     random_numbers_buf = vkrt::Buffer::device(
@@ -85,25 +96,23 @@ void RenderBNPointsVulkan::update_random_buf()
     {
         auto upload_random_numbers = random_numbers_buf.for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vkrt::MemorySource(*device, vkrt::Device::ScratchArena));
         BNData* map = (BNData*) upload_random_numbers->map();
-        static_assert(sizeof(map->sobol_spp_d) == sizeof(sobol_256spp_256d), "Sobol sample array misconfigured");
-        std::memcpy(&map->sobol_spp_d, sobol_256spp_256d, sizeof(map->sobol_spp_d));
-        static_assert(sizeof(map->tile_scrambling_yx_d_1spp) == sizeof(scramblingTile_yx_d_1spp), "Scrambling tile size misconfigured");
-        //static_assert(sizeof(map->tile_ranking_yx_d_1spp) == sizeof(rankingTile_yx_d_1spp), "Ranking tile size misconfigured");
-        std::memcpy(&map->tile_scrambling_yx_d_1spp, scramblingTile_yx_d_1spp, sizeof(map->tile_scrambling_yx_d_1spp));
-        //std::memcpy(&map->tile_ranking_yx_d_1spp, rankingTile_yx_d_1spp, sizeof(map->tile_ranking_yx_d_1spp)); // omitting all zeros:
-        assert(rankingTile_yx_d_1spp[0] == 0 && 0 == memcmp(rankingTile_yx_d_1spp, &rankingTile_yx_d_1spp[1], sizeof(rankingTile_yx_d_1spp)-sizeof(rankingTile_yx_d_1spp[0])));
-        static_assert(sizeof(map->tile_scrambling_yx_d_4spp) == sizeof(scramblingTile_yx_d_4spp), "Scrambling tile size misconfigured");
-        static_assert(sizeof(map->tile_ranking_yx_d_4spp) == sizeof(rankingTile_yx_d_4spp), "Ranking tile size misconfigured");
-        std::memcpy(&map->tile_scrambling_yx_d_4spp, scramblingTile_yx_d_4spp, sizeof(map->tile_scrambling_yx_d_4spp));
-        std::memcpy(&map->tile_ranking_yx_d_4spp, rankingTile_yx_d_4spp, sizeof(map->tile_ranking_yx_d_4spp));
-        static_assert(sizeof(map->tile_scrambling_yx_d_16spp) == sizeof(scramblingTile_yx_d_16spp), "Scrambling tile size misconfigured");
-        static_assert(sizeof(map->tile_ranking_yx_d_16spp) == sizeof(rankingTile_yx_d_16spp), "Ranking tile size misconfigured");
-        std::memcpy(&map->tile_scrambling_yx_d_16spp, scramblingTile_yx_d_16spp, sizeof(map->tile_scrambling_yx_d_16spp));
-        std::memcpy(&map->tile_ranking_yx_d_16spp, rankingTile_yx_d_16spp, sizeof(map->tile_ranking_yx_d_16spp));
-        static_assert(sizeof(map->tile_scrambling_yx_d_256spp) == sizeof(scramblingTile_yx_d_256spp), "Scrambling tile size misconfigured");
-        static_assert(sizeof(map->tile_ranking_yx_d_256spp) == sizeof(rankingTile_yx_d_256spp), "Ranking tile size misconfigured");
-        std::memcpy(&map->tile_scrambling_yx_d_256spp, scramblingTile_yx_d_256spp, sizeof(map->tile_scrambling_yx_d_256spp));
-        std::memcpy(&map->tile_ranking_yx_d_256spp, rankingTile_yx_d_256spp, sizeof(map->tile_ranking_yx_d_256spp));
+        static_assert(sizeof(map->sobol_spp_d) == sizeof(uint32_t) * BNData_SampleCount * BNData_Dimensions, "Sobol sample array misconfigured");
+        std::memcpy(&map->sobol_spp_d, tables.sequence_spp_d.data(), sizeof(map->sobol_spp_d));
+        static_assert(sizeof(map->tile_scrambling_yx_d_1spp) == sizeof(uint32_t) * BNData_TileSize * BNData_TileSize * BNData_ScramblingDimensions, "Scrambling tile size misconfigured");
+        static_assert(sizeof(map->tile_ranking_yx_d_4spp) == sizeof(map->tile_scrambling_yx_d_1spp), "Ranking tile size misconfigured");
+        auto copy_tile = [&](uint32_t* scrambling, uint32_t* ranking, int spp) {
+            auto* tile = tables.find_tile(spp);
+            if (!tile)
+                throw_error("Blue-noise tables \"%s\" are missing the tile optimized for %d spp", tables_file.c_str(), spp);
+            std::memcpy(scrambling, tile->scrambling_yx_d.data(), sizeof(map->tile_scrambling_yx_d_1spp));
+            if (ranking)
+                std::memcpy(ranking, tile->ranking_yx_d.data(), sizeof(map->tile_ranking_yx_d_4spp));
+        };
+        // ranking keys are all zero at 1 spp and omitted from the buffer
+        copy_tile(map->tile_scrambling_yx_d_1spp, nullptr, 1);
+        copy_tile(map->tile_scrambling_yx_d_4spp, map->tile_ranking_yx_d_4spp, 4);
+        copy_tile(map->tile_scrambling_yx_d_16spp, map->tile_ranking_yx_d_16spp, 16);
+        copy_tile(map->tile_scrambling_yx_d_256spp, map->tile_ranking_yx_d_256spp, 256);
         upload_random_numbers->unmap();
 
         async_commands->begin_record();
@@ -91,6 +91,8 @@ layout(push_constant) uniform PushConstants {
 
 #define AOV_TARGET_PIXEL ivec2(gl_GlobalInvocationID.xy)
 #include "accumulate.glsl"
+#include "path_guiding.glsl"
+#include "environment_map.glsl"
 
 // assemble light transport algorithm
 #define SCENE_GET_TEXTURE(tex_id) textures[nonuniformEXT(tex_id)]
@@ -98,6 +100,8 @@ layout(push_constant) uniform PushConstants {
 
 #define SCENE_GET_LIGHT_SOURCE(light_id) decode_tri_light(global_lights[nonuniformEXT(light_id)])
 #define SCENE_GET_LIGHT_SOURCE_COUNT()   int(scene_params.light_sampling.light_count)
+#define SCENE_GET_QUAD_LIGHT_SOURCE(light_id) decode_tri_light(global_lights[nonuniformEXT(scene_params.light_sampling.light_count + light_id)])
+#define SCENE_GET_QUAD_LIGHT_SOURCE_COUNT() int(scene_params.light_sampling.quad_light_count)
 
 #define BINNED_LIGHTS_BIN_SIZE int(view_params.light_sampling.bin_size)
 #define SCENE_GET_BINNED_LIGHTS_BIN_COUNT() (int(scene_params.light_sampling.light_count + (view_params.light_sampling.bin_size - 1)) / int(view_params.light_sampling.bin_size))
@@ -114,18 +118,27 @@ vec3 compute_sky_illum(vec3 ray_origin, vec3 ray_dir, float prev_bsdf_pdf) {
     vec3 atmosphere_illum;
     vec3 sun_illum;
 
-    vec3 dir = ray_dir;
-    float ocean_coeff = 1.0f;
-    if (dir.y <= 0.0f) {
-        dir.y = -dir.y;
-        ocean_coeff = 0.7 * pow(max(1.0 - abs(dir.y), 0.0), 5);
-    }
+#ifdef ENABLE_ENVIRONMENT_MAP
+    // the environment map is MIS-weighted as a whole, like the sun
+    if (scene_params.environment_map != 0) {
+        atmosphere_illum = vec3(0.0f);
+        sun_illum = environment_map_radiance(ray_dir) * vec3(scene_params.sun_radiance);
+    } else
+#endif
+    {
+        vec3 dir = ray_dir;
+        float ocean_coeff = 1.0f;
+        if (dir.y <= 0.0f) {
+            dir.y = -dir.y;
+            ocean_coeff = 0.7 * pow(max(1.0 - abs(dir.y), 0.0), 5);
+        }
 
-    atmosphere_illum = max( skymodel_radiance(scene_params.sky_params, scene_params.sun_dir, dir), vec3(0.0f) ) * ocean_coeff;
-    if (dot(dir, scene_params.sun_dir) >= scene_params.sun_cos_angle)
-        sun_illum = vec3(scene_params.sun_radiance) * ocean_coeff;
-    else
-        sun_illum = vec3(0.0f);
+        atmosphere_illum = max( skymodel_radiance(scene_params.sky_params, scene_params.sun_dir, dir), vec3(0.0f) ) * ocean_coeff;
+        if (dot(dir, scene_params.sun_dir) >= scene_params.sun_cos_angle)
+            sun_illum = vec3(scene_params.sun_radiance) * ocean_coeff;
+        else
+            sun_illum = vec3(0.0f);
+    }
 
     vec3 illum = vec3(0.0f);
 
@@ -168,6 +181,16 @@ bool generate_candidate_hit(float dist, vec2 attrib, int instanceIdx, int geomet
             return false;
     }
 
+    // baked opacity states decide known triangles without evaluating material alpha
+    uint32_t opacity_state = OPACITY_STATE_UNKNOWN;
+    if ((geom.flags & GEOMETRY_FLAGS_OPACITY_STATES) != 0) {
+        opacity_state = calc_hit_opacity_state(geom.opacity_states, primitiveIdx);
+        if (opacity_state == OPACITY_STATE_TRANSPARENT)
+            return true;
+        if (visibility_only && opacity_state == OPACITY_STATE_OPAQUE)
+            return false;
+    }
+
     const uvec3 idx =
 #ifndef REQUIRE_UNROLLED_VERTICES
        ((geom.flags & GEOMETRY_FLAGS_IMPLICIT_INDICES) == 0) ? geom.indices.i[primitiveIdx] :
@@ -201,7 +224,7 @@ bool generate_candidate_hit(float dist, vec2 attrib, int instanceIdx, int geomet
     #undef geom
 
     MATERIAL_PARAMS mat_params = material_params[nonuniformEXT(hit.material_id)];
-    if ((mat_params.flags & BASE_MATERIAL_NOALPHA) == 0) {
+    if ((mat_params.flags & BASE_MATERIAL_NOALPHA) == 0 && opacity_state != OPACITY_STATE_OPAQUE) {
         float alpha = get_material_alpha(hit.material_id, mat_params, HitPoint(local_ray_orig + dist * local_ray_dir, hit.uv, mat2x2(0.0), local_ray_dir));
         if (!(alpha > 0.0f) || alpha < 1.0f && lcg_randomf(alpha_rng) > alpha)
             return true;
@@ -272,6 +295,7 @@ bool raytrace_test_visibility(const vec3 from, const vec3 dir, float dist) {
 }
 
 vec4 main_spp(uint sample_index, uint rnd_offset);
+void main_adaptive();
 void main() {
 #ifdef ENABLE_RAYQUERIES
     // note: this forbids any warp-wide collaborative work
@@ -281,6 +305,10 @@ void main() {
             return;
     }
 #endif
+    if ((accumulation_flags & ACCUMULATION_FLAGS_ADAPTIVE) != 0) {
+        main_adaptive();
+        return;
+    }
 
     vec4 final_color;
     {
@@ -307,6 +335,43 @@ void main() {
         accumulate(fb_pixel, final_color, sample_index, (accumulation_flags & ACCUMULATION_FLAGS_ATOMIC) != 0);
 }
 
+// adaptive sampling: one thread per pixel traces the number of samples that sample
+// processing allocated to the pixel, see adaptive_sampling.glsl
+void main_adaptive() {
+    ivec2 fb_pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 fb_dims = ivec2(view_params.frame_dims);
+    if (fb_pixel.x >= fb_dims.x || fb_pixel.y >= fb_dims.y)
+        return;
+
+    AdaptivePixelStats stats;
+    if (view_params.frame_id == 0)
+        stats = AdaptivePixelStats(0.0f, 0.0f, 0.0f, float(render_params.batch_spp));
+    else
+        stats = load_adaptive_stats(fb_pixel);
+
+    uint spp = uint(stats.spp);
+    uint sample_base_index = uint(stats.count);
+    vec4 frame_color = vec4(0.0f);
+    float frame_mean = 0.0f;
+    float frame_second_moment = 0.0f;
+    for (uint i = 0; i < spp; ++i) {
+        vec4 color = main_spp(sample_base_index + i, view_params.frame_offset);
+        float luminance = adaptive_luminance(color.x, color.y, color.z);
+        frame_mean += luminance;
+        frame_second_moment += luminance * luminance;
+        frame_color += color;
+    }
+    if (spp > 0) {
+        float inv_spp = 1.0f / float(spp);
+        frame_mean *= inv_spp;
+        frame_second_moment *= inv_spp;
+        frame_color *= inv_spp;
+    }
+
+    store_adaptive_stats(fb_pixel, adaptive_merge_frame(stats, frame_mean, frame_second_moment, spp));
+    accumulate(fb_pixel, frame_color, sample_base_index, false);
+}
+
 vec4 main_spp(uint sample_index, uint rnd_offset) {
     ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
     const vec2 dims = view_params.frame_dims;
@@ -363,6 +428,14 @@ vec4 main_spp(uint sample_index, uint rnd_offset) {
     // data for emitter MIS
     ShadingSampleState shading_state = init_shading_sample_state();
     shading_state.output_channel = render_params.output_channel;
+#ifdef ENABLE_PATH_GUIDING
+    // a random subset of paths is recorded for training, such that the sample buffer suffices
+    bool guiding_training = (accumulation_flags & ACCUMULATION_FLAGS_PATH_GUIDING) != 0
+        && path_guiding_training_random(sample_index, uint(pixel.y) * view_params.frame_dims.x + uint(pixel.x))
+            < render_params.path_guiding_training_probability;
+    PathGuidingVertex guiding_vertices[PATH_GUIDING_PATH_VERTICES];
+    int guiding_vertex_count = 0;
+#endif
     //vec3 prev_wo = vec3(-ray_dir);
     //vec3 prev_n = ray_dir;
 
@@ -683,6 +756,9 @@ EXPLICIT_MASK_END
             nee_area.approx_solid_angle = approx_tri_solid_angle;
             vec3 w_i;
             ShadingQueryAux aux;
+#ifdef ENABLE_PATH_GUIDING
+            aux.guided_vertex = false;
+#endif
             int shading_result = shade_megakernel(shading_state
                 , illum, path_throughput
                 , hit.material_id, material_params[nonuniformEXT(hit.material_id)]
@@ -702,6 +778,12 @@ EXPLICIT_MASK_BEGIN
 #endif
             ray_dir = w_i;
             ray_origin = interaction.p;
+#ifdef ENABLE_PATH_GUIDING
+            if (guiding_training && aux.guided_vertex && guiding_vertex_count < PATH_GUIDING_PATH_VERTICES) {
+                guiding_vertices[guiding_vertex_count] = PathGuidingVertex(interaction.p, aux.sampling_pdf, w_i, illum, path_throughput);
+                ++guiding_vertex_count;
+            }
+#endif
             if (shading_result > SHADING_RESULT_NULL)
                 t_min = geometry_scale_to_tmin(ray_origin, total_t);
             else
@@ -733,6 +815,11 @@ EXPLICIT_MASK_END
 #endif // not RECURSIVE_MEGAKERNEL_UNROLL
 #ifndef RECURSIVE_MEGAKERNEL_UNROLL
 
+#ifdef ENABLE_PATH_GUIDING
+    if (guiding_vertex_count > 0)
+        path_guiding_record(guiding_vertices, guiding_vertex_count, illum);
+#endif
+
     return vec4(illum, shading_state.bounce == 0 ? 0.0f : 1.0f);
 }
 
@@ -0,0 +1,920 @@
+// Copyright 2023 Intel Corporation.
+// SPDX-License-Identifier: MIT
+
+// Wavefront variant of the megakernel path tracer (pt_megakernel.glsl). Each stage of a
+// path is a separate kernel, selected by WAVEFRONT_STAGE, and stages communicate through
+// per-path state and queues of path indices in device memory:
+//   generate, then per bounce: extend, sort (count, scan, scatter), shade, shadow,
+//   and finally resolve.
+// Shading runs on the hits of a bounce sorted by material, which keeps material evaluation
+// coherent, and shadow rays of next event estimation are traced in their own stage.
+// The host schedule is in WavefrontRenderPipelineVulkan, a CPU reference of the queue and
+// sort logic in librender/wavefront_queues.h.
+
+#ifndef WAVEFRONT_STAGE
+#error "WAVEFRONT_STAGE selects the stage of the wavefront path tracer"
+#endif
+
+#include "setup_iterative_pt.glsl"
+#include "language.glsl"
+#include "gpu_params.glsl"
+#include "../librender/wavefront_queues.glsl"
+
+#if WORKGROUP_SIZE_X != WAVEFRONT_WORKGROUP_SIZE || WORKGROUP_SIZE_Y != 1
+#error "Queue dispatch sizes are counted in one-dimensional workgroups of WAVEFRONT_WORKGROUP_SIZE"
+#endif
+#if WAVEFRONT_SORT_BINS % WAVEFRONT_WORKGROUP_SIZE != 0
+#error "The scan stage assigns the same number of sort bins to each thread"
+#endif
+
+#include "pathspace.h"
+
+#define MAKE_RANDOM_TABLE(TYPE, NAME) \
+layout(binding = RANDOM_NUMBERS_BIND_POINT, set = 0, std430) buffer RNBuf {\
+    TYPE NAME;\
+};
+#include "pointsets/selected_rng.glsl"
+#include "pointsets/lcg_rng.glsl" // for alpha
+
+#include "geometry.glsl"
+#include "rt/hit.glsl"
+#include "rt/footprint.glsl"
+
+#include "rt/materials.glsl"
+#include "bsdfs/gltf_bsdf.glsl"
+
+#include "lights/tri.glsl"
+
+#extension GL_EXT_ray_query : require
+layout(local_size_x=WORKGROUP_SIZE_X, local_size_y=1, local_size_z=1) in;
+
+layout(binding = SCENE_BIND_POINT, set = 0) uniform accelerationStructureEXT scene;
+layout(binding = FRAMEBUFFER_BIND_POINT, set = 0, rgba8) uniform writeonly image2D framebuffer;
+
+layout(binding = VIEW_PARAMS_BIND_POINT, set = 0, std140) uniform VPBuf {
+    LOCAL_CONSTANT_PARAMETERS
+};
+layout(binding = SCENE_PARAMS_BIND_POINT, set = 0, std140) uniform GPBuf {
+    GLOBAL_CONSTANT_PARAMETERS
+};
+
+layout(binding = INSTANCES_BIND_POINT, set = 0, std430) buffer GeometryParamsBuffer {
+#ifdef IMPLICIT_INSTANCE_PARAMS
+    RenderMeshParams instanced_geometry[];
+#else
+    InstancedGeometry instances[];
+#endif
+};
+
+layout(binding = MATERIALS_BIND_POINT, set = 0, scalar) buffer MaterialParamsBuffer {
+    MATERIAL_PARAMS material_params[];
+};
+
+layout(binding = LIGHTS_BIND_POINT, set = 0, std430) buffer LightParamsBuffer {
+    TriLightData global_lights[];
+};
+
+layout(binding = 0, set = TEXTURE_BIND_SET) uniform sampler2D textures[];
+#ifdef STANDARD_TEXTURE_BIND_SET
+layout(binding = 0, set = STANDARD_TEXTURE_BIND_SET) uniform sampler2D standard_textures[];
+#endif
+
+layout(binding = RAYQUERIES_BIND_POINT, set = QUERY_BIND_SET, std430) buffer RayQueryBuf {
+    RenderRayQuery ray_queries[];
+};
+
+// state of a path between stages
+struct WavefrontPath {
+    vec3 ray_origin;
+    float t_min;
+    vec3 ray_dir;
+    float t_max;
+    vec3 throughput;
+    float prev_bounce_pdf;
+    vec3 illum;
+    int bounce;
+    COMPRESSED_RANDOM_STATE
+    // closest hit, written by the extend stage
+    RTHit hit;
+    vec3 local_ray_orig;
+    int instance_id;
+    vec3 local_ray_dir;
+    int primitive_id;
+    vec3 motion_vector;
+    float total_t;
+#ifdef USE_MIPMAPPING
+    mat2 texture_footprint;
+#endif
+    // unoccluded light sample, written by the shade stage
+    vec3 shadow_origin;
+    float shadow_dist;
+    vec3 shadow_dir;
+    vec3 shadow_illum;
+};
+
+// scalar layout size of WavefrontPath, assuming the larger two-word random state,
+// mirrored by WavefrontPathLayout in wavefront_queues.h
+#if NEED_MESH_ID_FOR_VISUALIZATION
+    #define WAVEFRONT_PATH_HIT_BYTES 60
+#else
+    #define WAVEFRONT_PATH_HIT_BYTES 56
+#endif
+#ifdef USE_MIPMAPPING
+    #define WAVEFRONT_PATH_FOOTPRINT_BYTES 16
+#else
+    #define WAVEFRONT_PATH_FOOTPRINT_BYTES 0
+#endif
+#define WAVEFRONT_PATH_BYTES (64 + 8 + WAVEFRONT_PATH_HIT_BYTES + 48 + WAVEFRONT_PATH_FOOTPRINT_BYTES + 40)
+#if WAVEFRONT_PATH_BYTES > WAVEFRONT_PATH_STATE_BYTES
+#error "Wavefront path state exceeds its buffer stride, raise WAVEFRONT_PATH_STATE_BYTES"
+#endif
+
+layout(buffer_reference, buffer_reference_align=16, scalar) buffer WavefrontHeaderBuffer {
+    WavefrontQueueHeader header;
+};
+layout(buffer_reference, buffer_reference_align=16, scalar) buffer WavefrontPathBuffer {
+    WavefrontPath p[];
+};
+layout(buffer_reference, buffer_reference_align=4, scalar) buffer WavefrontIndexBuffer {
+    uint32_t i[];
+};
+// material ID and path index
+layout(buffer_reference, buffer_reference_align=8, scalar) buffer WavefrontHitBuffer {
+    uvec2 h[];
+};
+
+// matches WavefrontPushConstants in render_pipeline_vulkan.cpp
+layout(push_constant, scalar) uniform PushConstants {
+    PUSH_CONSTANT_PARAMETERS
+    WavefrontHeaderBuffer wavefront_header;
+    WavefrontPathBuffer wavefront_paths;
+    // extend queues of the current and the next bounce
+    WavefrontIndexBuffer wavefront_ray_queue;
+    WavefrontIndexBuffer wavefront_next_ray_queue;
+    WavefrontHitBuffer wavefront_hits;
+    WavefrontIndexBuffer wavefront_sorted_hits;
+    WavefrontIndexBuffer wavefront_shadow_queue;
+    uint32_t wavefront_path_count;
+    uint32_t wavefront_pixel_offset; // of the first path in the wave
+    uint32_t wavefront_width;
+    uint32_t wavefront_sample;
+    uint32_t wavefront_bounce;
+    uint32_t _wavefront_pad;
+};
+
+ivec2 wavefront_pixel;
+#define AOV_TARGET_PIXEL wavefront_pixel
+#include "accumulate.glsl"
+#include "environment_map.glsl"
+
+// assemble light transport algorithm
+#define SCENE_GET_TEXTURE(tex_id) textures[nonuniformEXT(tex_id)]
+#define SCENE_GET_STANDARD_TEXTURE(tex_id) standard_textures[nonuniformEXT(tex_id)]
+
+#define SCENE_GET_LIGHT_SOURCE(light_id) decode_tri_light(global_lights[nonuniformEXT(light_id)])
+#define SCENE_GET_LIGHT_SOURCE_COUNT()   int(scene_params.light_sampling.light_count)
+#define SCENE_GET_QUAD_LIGHT_SOURCE(light_id) decode_tri_light(global_lights[nonuniformEXT(scene_params.light_sampling.light_count + light_id)])
+#define SCENE_GET_QUAD_LIGHT_SOURCE_COUNT() int(scene_params.light_sampling.quad_light_count)
+
+#define BINNED_LIGHTS_BIN_SIZE int(view_params.light_sampling.bin_size)
+#define SCENE_GET_BINNED_LIGHTS_BIN_COUNT() (int(scene_params.light_sampling.light_count + (view_params.light_sampling.bin_size - 1)) / int(view_params.light_sampling.bin_size))
+
+#define CUSTOM_MATERIAL_ALPHA
+#include "rt/material_textures.glsl"
+#include "mc/nee.glsl"
+
+#include "mc/shade_megakernel.glsl"
+
+#include "lights/sky_model_arhosek/sky_model.glsl"
+
+uint wavefront_thread_index() {
+    return gl_WorkGroupID.x * uint(WAVEFRONT_WORKGROUP_SIZE) + gl_LocalInvocationID.x;
+}
+
+// ray queries are dispatched in a virtual square that may exceed the query count
+bool wavefront_path_valid(uint path_id) {
+#ifdef ENABLE_RAYQUERIES
+    if (num_rayqueries > 0)
+        return path_id < wavefront_path_count && wavefront_pixel_offset + path_id < uint(num_rayqueries);
+#endif
+    return path_id < wavefront_path_count;
+}
+
+ivec2 wavefront_path_pixel(uint path_id) {
+    uint linear = wavefront_pixel_offset + path_id;
+    return ivec2(linear % wavefront_width, linear / wavefront_width);
+}
+
+uint wavefront_sample_index() {
+    uint sample_batch_offset = accumulation_frame_offset >= 0 ? uint(accumulation_frame_offset) : view_params.frame_id;
+    return sample_batch_offset + wavefront_sample;
+}
+
+// appends the calling invocations to a queue with one atomic per subgroup, returns their slots
+uint wavefront_append(uint queue) {
+    uvec4 ballot = subgroupBallot(true);
+    uint count = subgroupBallotBitCount(ballot);
+    uint offset = 0;
+    if (subgroupElect()) {
+        offset = atomicAdd(wavefront_header.header.queues[queue].count, count);
+        uint groups = wavefront_append_groups(offset, count);
+        if (groups != 0)
+            atomicAdd(wavefront_header.header.queues[queue].groups_x, groups);
+    }
+    return subgroupBroadcastFirst(offset) + subgroupBallotExclusiveBitCount(ballot);
+}
+
+// as in pt_megakernel.glsl
+vec3 compute_sky_illum(vec3 ray_origin, vec3 ray_dir, float prev_bsdf_pdf) {
+    vec3 atmosphere_illum;
+    vec3 sun_illum;
+
+#ifdef ENABLE_ENVIRONMENT_MAP
+    if (scene_params.environment_map != 0) {
+        atmosphere_illum = vec3(0.0f);
+        sun_illum = environment_map_radiance(ray_dir) * vec3(scene_params.sun_radiance);
+    } else
+#endif
+    {
+        vec3 dir = ray_dir;
+        float ocean_coeff = 1.0f;
+        if (dir.y <= 0.0f) {
+            dir.y = -dir.y;
+            ocean_coeff = 0.7 * pow(max(1.0 - abs(dir.y), 0.0), 5);
+        }
+
+        atmosphere_illum = max( skymodel_radiance(scene_params.sky_params, scene_params.sun_dir, dir), vec3(0.0f) ) * ocean_coeff;
+        if (dot(dir, scene_params.sun_dir) >= scene_params.sun_cos_angle)
+            sun_illum = vec3(scene_params.sun_radiance) * ocean_coeff;
+        else
+            sun_illum = vec3(0.0f);
+    }
+
+    vec3 illum = abs(atmosphere_illum);
+    {
+        NEEQueryPoint query;
+        query.point = ray_origin;
+        query.normal = vec3(0.0f);
+        query.w_o = vec3(0.0f);
+        query.info = NEEQueryInfo(0);
+#ifndef PT_DISABLE_NEE
+        float light_pdf = eval_direct_sun_light_pdf(query, ray_dir);
+        float w = nee_mis_heuristic(1.f, prev_bsdf_pdf, 1.f, light_pdf);
+#else
+        float w = 1.0f;
+#endif
+        illum += w * abs(sun_illum);
+    }
+    return illum;
+}
+
+// as in pt_megakernel.glsl, returns true if traversal needs to continue
+bool generate_candidate_hit(float dist, vec2 attrib, int instanceIdx, int geometryIdx, int primitiveIdx
+    , vec3 local_ray_orig, vec3 local_ray_dir, inout RTHit hit, inout LCGRand alpha_rng, bool visibility_only) {
+#ifdef IMPLICIT_INSTANCE_PARAMS
+    #define geom instanced_geometry[geometryIdx]
+#else
+    #define instance instances[instanceIdx + geometryIdx]
+    #define geom instances[instanceIdx + geometryIdx].geometry
+#endif
+
+    if (visibility_only) {
+        if ((geom.flags & GEOMETRY_FLAGS_NOALPHA) != 0)
+            return false;
+    }
+
+    // baked opacity states decide known triangles without evaluating material alpha
+    uint32_t opacity_state = OPACITY_STATE_UNKNOWN;
+    if ((geom.flags & GEOMETRY_FLAGS_OPACITY_STATES) != 0) {
+        opacity_state = calc_hit_opacity_state(geom.opacity_states, primitiveIdx);
+        if (opacity_state == OPACITY_STATE_TRANSPARENT)
+            return true;
+        if (visibility_only && opacity_state == OPACITY_STATE_OPAQUE)
+            return false;
+    }
+
+    const uvec3 idx =
+#ifndef REQUIRE_UNROLLED_VERTICES
+       ((geom.flags & GEOMETRY_FLAGS_IMPLICIT_INDICES) == 0) ? geom.indices.i[primitiveIdx] :
+#endif
+    uvec3(primitiveIdx * 3) + uvec3(0, 1, 2);
+
+    mat3 vertices = calc_hit_vertices(geom.vertices,
+#ifdef QUANTIZED_POSITIONS
+        geom.quantized_scaling, geom.quantized_offset,
+#endif
+    idx);
+    hit = calc_hit_attributes(dist, primitiveIdx, attrib,
+        vertices, idx,
+#ifdef IMPLICIT_INSTANCE_PARAMS
+        mat3(0.0),
+#else
+        transpose(mat3(instance.world_to_instance)),
+#endif
+        geom.normals, geom.num_normals > 0,
+#ifndef QUANTIZED_NORMALS_AND_UVS
+        geom.uvs,
+#endif
+        geom.num_uvs > 0,
+        geom.material_id, geom.materials
+        );
+
+    #undef instance
+    #undef geom
+
+    MATERIAL_PARAMS mat_params = material_params[nonuniformEXT(hit.material_id)];
+    if ((mat_params.flags & BASE_MATERIAL_NOALPHA) == 0 && opacity_state != OPACITY_STATE_OPAQUE) {
+        float alpha = get_material_alpha(hit.material_id, mat_params, HitPoint(local_ray_orig + dist * local_ray_dir, hit.uv, mat2x2(0.0), local_ray_dir));
+        if (!(alpha > 0.0f) || alpha < 1.0f && lcg_randomf(alpha_rng) > alpha)
+            return true;
+    }
+
+    return false;
+}
+
+float geometry_scale = 0.0f;
+
+// next event estimation in the shade stage only samples lights, occlusion is tested in the shadow stage
+bool raytrace_test_visibility(const vec3 from, const vec3 dir, float dist) {
+    return true;
+}
+
+bool wavefront_test_visibility(const vec3 from, const vec3 dir, float dist) {
+    const uint32_t occlusion_flags = gl_RayFlagsTerminateOnFirstHitEXT
+        | gl_RayFlagsSkipClosestHitShaderEXT;
+    float epsilon = geometry_scale_to_tmin(from, geometry_scale);
+    if (!(dist - 2.f * epsilon > 0.0f))
+        return true;
+
+    rayQueryEXT rayQuery;
+    rayQueryInitializeEXT(rayQuery, scene, occlusion_flags, 0xff,
+        from, epsilon, dir, dist - epsilon);
+
+    while (rayQueryProceedEXT(rayQuery)) {
+        if (rayQueryGetIntersectionTypeEXT(rayQuery, false) != gl_RayQueryCandidateIntersectionTriangleEXT)
+            continue;
+
+        float dist = rayQueryGetIntersectionTEXT(rayQuery, false);
+        vec2 attrib = rayQueryGetIntersectionBarycentricsEXT(rayQuery, false);
+
+#ifdef IMPLICIT_INSTANCE_PARAMS
+        int instanceIdx = rayQueryGetIntersectionInstanceIdEXT(rayQuery, false);
+        int geometryIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false) + rayQueryGetIntersectionGeometryIndexEXT(rayQuery, false);
+#else
+        int instanceIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false);
+        int geometryIdx = rayQueryGetIntersectionGeometryIndexEXT(rayQuery, false);
+#endif
+        int primitiveIdx = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, false);
+
+        vec3 local_orig = rayQueryGetIntersectionObjectRayOriginEXT(rayQuery, false);
+        vec3 local_dir = rayQueryGetIntersectionObjectRayDirectionEXT(rayQuery, false);
+
+#ifdef OPAQUE_SHADOWS
+        rayQueryTerminateEXT(rayQuery);
+        return false;
+#else
+        const uint32_t index = primitiveIdx ^ view_params.frame_id;
+        const uint32_t frame = instanceIdx ^ view_params.frame_offset;
+        LCGRand alpha_rng = get_lcg_rng(index, frame, uvec4(wavefront_pixel, view_params.frame_dims.xy));
+
+        RTHit hit;
+        if (!generate_candidate_hit(dist, attrib, instanceIdx, geometryIdx, primitiveIdx
+            , local_orig, local_dir, hit, alpha_rng, true)) {
+            rayQueryTerminateEXT(rayQuery);
+            return false;
+        }
+#endif
+    }
+    return rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCandidateIntersectionTriangleEXT;
+}
+
+// shade_base_material (mc/shade_base_material.glsl) with the light sample of next event
+// estimation returned for the shadow stage instead of being added to the path
+int shade_wavefront(inout ShadingSampleState state
+    , inout vec3 illum, inout vec3 path_throughput
+    , int material_id, BaseMaterial params, HitPoint lookup_point
+    , NEESampledArea nee_area
+    , vec3 w_o, InteractionPoint interaction
+    , inout RANDOM_STATE rng, inout vec3 w_i, inout ShadingQueryAux aux
+    , out vec3 shadow_illum, out NEEQueryAux nee_aux) {
+    MATERIAL_TYPE mat;
+    EmitterParams emit;
+    unpack_material(mat, emit
+        , material_id, params
+        , lookup_point);
+    vec3 scatter_throughput = path_throughput;
+    shadow_illum = vec3(0.0f);
+    nee_aux.mis_pdf = 0.0f;
+
+#ifdef ENABLE_AOV_BUFFERS
+    if (state.bounce == 0 && (accumulation_flags & ACCUMULATION_FLAGS_AOVS) != 0)
+        store_material_aovs(path_throughput * mat.base_color, mat.roughness, mat.ior);
+#endif
+
+    // direct emitter hit
+    if (state.output_channel == 0 && emit.radiance != vec3(0.0f))
+    {
+        float light_pdf = wpdf_direct_light(nee_area);
+        float w = nee_mis_heuristic(1.f, state.prev_bounce_pdf, 1.f, light_pdf);
+        illum += w * scatter_throughput * emit.radiance;
+    }
+
+    // AOVs
+    if (state.output_channel != 0) {
+        float reliability = pow(0.25f, float(state.bounce));
+        if (state.output_channel == 1)
+            illum += scatter_throughput * mat.base_color * reliability;
+        else if (state.output_channel == 2)
+            illum += interaction.n * reliability;
+        else if (state.output_channel == 3)
+            illum += interaction.p * reliability;
+    }
+
+    if (state.bounce+1 >= render_params.max_path_depth)
+        return SHADING_RESULT_TERMINATE;
+
+    if (state.output_channel == 0) {
+        vec4 nee_rng_sample = vec4(RANDOM_FLOAT2(rng, DIM_POSITION_X), RANDOM_FLOAT2(rng, DIM_LIGHT_SEL_1));
+        shadow_illum = scatter_throughput * sample_direct_light(mat, interaction, w_o, nee_rng_sample.xy, nee_rng_sample.zw, nee_aux);
+    }
+    RANDOM_SHIFT_DIM(rng, DIM_LIGHT_END);
+
+    if (render_params.glossy_only_mode != 0 && !(mat.roughness < GLOSSY_MODE_ROUGHNESS_THRESHOLD && mat.ior != 1.0f))
+        return SHADING_RESULT_TERMINATE;
+
+    vec2 bsdfLobeSample = RANDOM_FLOAT2(rng, DIM_LOBE);
+    vec2 bsdfDirSample = RANDOM_FLOAT2(rng, DIM_DIRECTION_X);
+
+    vec3 bsdf = sample_bsdf(mat, interaction, w_o, w_i, aux.sampling_pdf, aux.mis_pdf, bsdfDirSample, bsdfLobeSample, rng);
+    RANDOM_SHIFT_DIM(rng, DIM_VERTEX_END);
+    // increment before terminating, alpha is accumulated from the bounce count
+    ++state.bounce;
+    if (aux.mis_pdf == 0.f || bsdf == vec3(0.f) || !(dot(w_i, interaction.n) * dot(w_i, interaction.gn) > 0.0f))
+        return SHADING_RESULT_TERMINATE;
+
+    path_throughput *= bsdf;
+    state.prev_bounce_pdf = aux.mis_pdf;
+    return SHADING_RESULT_BOUNCE;
+}
+
+#if WAVEFRONT_STAGE == WAVEFRONT_STAGE_GENERATE
+
+void main() {
+    uint path_id = wavefront_thread_index();
+    if (!wavefront_path_valid(path_id))
+        return;
+    wavefront_pixel = wavefront_path_pixel(path_id);
+    ivec2 pixel = wavefront_pixel;
+    const vec2 dims = view_params.frame_dims;
+
+    RANDOM_STATE rng = GET_RNG(wavefront_sample_index(), view_params.frame_offset, uvec4(pixel, view_params.frame_dims.xy));
+    vec2 point = vec2(pixel.x + 0.5f, pixel.y + 0.5f);
+    if (render_params.enable_raster_taa == 0)
+        point += SAMPLE_PIXEL_FILTER(RANDOM_FLOAT2(rng, DIM_PIXEL_X));
+    point /= dims;
+    if (render_params.enable_raster_taa != 0)
+        point += 0.5f * view_params.screen_jitter;
+
+    vec3 ray_origin = view_params.cam_pos.xyz;
+    vec3 ray_dir = normalize(point.x * view_params.cam_du.xyz + point.y * view_params.cam_dv.xyz + view_params.cam_dir_top_left.xyz);
+    float t_max = 2.e32f;
+#ifdef ENABLE_RAYQUERIES
+    if (num_rayqueries > 0) {
+        uint query_id = wavefront_pixel_offset + path_id;
+        ray_origin = ray_queries[query_id].origin;
+        ray_dir = ray_queries[query_id].dir;
+        t_max = ray_queries[query_id].t_max;
+    }
+#endif
+
+#if defined(USE_MIPMAPPING)
+    {
+        vec3 dpdx = view_params.cam_du.xyz / dims.x;
+        vec3 dpdy = view_params.cam_dv.xyz / dims.y;
+        dpdx *= render_params.pixel_radius;
+        dpdy *= render_params.pixel_radius;
+        wavefront_paths.p[path_id].texture_footprint = dpdxy_to_footprint(ray_dir, dpdx, dpdy);
+    }
+#endif
+
+    ShadingSampleState shading_state = init_shading_sample_state();
+    wavefront_paths.p[path_id].ray_origin = ray_origin;
+    wavefront_paths.p[path_id].t_min = 0.0f;
+    wavefront_paths.p[path_id].ray_dir = ray_dir;
+    wavefront_paths.p[path_id].t_max = t_max;
+    wavefront_paths.p[path_id].throughput = vec3(1.0f);
+    wavefront_paths.p[path_id].prev_bounce_pdf = shading_state.prev_bounce_pdf;
+    wavefront_paths.p[path_id].illum = vec3(0.0f);
+    wavefront_paths.p[path_id].bounce = shading_state.bounce;
+    wavefront_paths.p[path_id].total_t = 0.0f;
+    PACK_RNG(rng, wavefront_paths.p[path_id]);
+
+    // identity order, appended to maintain the dispatch size of the queue
+    uint slot = wavefront_append(WAVEFRONT_QUEUE_RAYS);
+    wavefront_ray_queue.i[slot] = path_id;
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_EXTEND
+
+void main() {
+    uint queue_index = wavefront_thread_index();
+    if (queue_index >= wavefront_header.header.queues[WAVEFRONT_QUEUE_RAYS + (wavefront_bounce & 1)].count)
+        return;
+    uint path_id = wavefront_ray_queue.i[queue_index];
+    wavefront_pixel = wavefront_path_pixel(path_id);
+
+    vec3 ray_origin = wavefront_paths.p[path_id].ray_origin;
+    vec3 ray_dir = wavefront_paths.p[path_id].ray_dir;
+    LCGRand alpha_rng = get_lcg_rng(wavefront_sample_index() * uint(MAX_PATH_DEPTH) + wavefront_bounce
+        , view_params.frame_offset, uvec4(wavefront_pixel, view_params.frame_dims.xy));
+
+    rayQueryEXT rayQuery;
+    rayQueryInitializeEXT(rayQuery, scene, 0, 0xff,
+        ray_origin, wavefront_paths.p[path_id].t_min, ray_dir, wavefront_paths.p[path_id].t_max);
+
+    while (rayQueryProceedEXT(rayQuery)) {
+        if (rayQueryGetIntersectionTypeEXT(rayQuery, false) != gl_RayQueryCandidateIntersectionTriangleEXT)
+            continue;
+
+        float dist = rayQueryGetIntersectionTEXT(rayQuery, false);
+        vec2 attrib = rayQueryGetIntersectionBarycentricsEXT(rayQuery, false);
+
+#ifdef IMPLICIT_INSTANCE_PARAMS
+        int instanceIdx = rayQueryGetIntersectionInstanceIdEXT(rayQuery, false);
+        int geometryIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false) + rayQueryGetIntersectionGeometryIndexEXT(rayQuery, false);
+#else
+        int instanceIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false);
+        int geometryIdx = rayQueryGetIntersectionGeometryIndexEXT(rayQuery, false);
+#endif
+        int primitiveIdx = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, false);
+
+        vec3 local_orig = rayQueryGetIntersectionObjectRayOriginEXT(rayQuery, false);
+        vec3 local_dir = rayQueryGetIntersectionObjectRayDirectionEXT(rayQuery, false);
+
+        RTHit tentative_hit;
+        if (!generate_candidate_hit(dist, attrib, instanceIdx, geometryIdx, primitiveIdx
+            , local_orig, local_dir, tentative_hit, alpha_rng, false))
+            rayQueryConfirmIntersectionEXT(rayQuery);
+    }
+
+    // misses end the path
+    if (rayQueryGetIntersectionTypeEXT(rayQuery, true) != gl_RayQueryCommittedIntersectionTriangleEXT) {
+        wavefront_paths.p[path_id].illum += wavefront_paths.p[path_id].throughput
+            * compute_sky_illum(ray_origin, ray_dir, wavefront_paths.p[path_id].prev_bounce_pdf);
+#ifdef ENABLE_AOV_BUFFERS
+        if (wavefront_paths.p[path_id].bounce == 0 && (accumulation_flags & ACCUMULATION_FLAGS_AOVS) != 0) {
+            store_geometry_aovs(vec3(0.0f), vec3(2.e32f), vec3(0.0f));
+            store_material_aovs(vec3(0.0f), 1.0f, 1.0f);
+        }
+#endif
+        return;
+    }
+
+    float dist = rayQueryGetIntersectionTEXT(rayQuery, true);
+    vec2 attrib = rayQueryGetIntersectionBarycentricsEXT(rayQuery, true);
+
+#ifdef IMPLICIT_INSTANCE_PARAMS
+    int instanceIdx = rayQueryGetIntersectionInstanceIdEXT(rayQuery, true);
+    int geometryIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, true) + rayQueryGetIntersectionGeometryIndexEXT(rayQuery, true);
+    #define geom instanced_geometry[geometryIdx]
+#else
+    int instanceIdx = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, true);
+    int geometryIdx = rayQueryGetIntersectionGeometryIndexEXT(rayQuery, true);
+    #define instance instances[instanceIdx + geometryIdx]
+    #define geom instances[instanceIdx + geometryIdx].geometry
+#endif
+    int primitiveIdx = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true);
+
+    const uvec3 idx =
+#ifndef REQUIRE_UNROLLED_VERTICES
+        ((geom.flags & GEOMETRY_FLAGS_IMPLICIT_INDICES) == 0) ? geom.indices.i[primitiveIdx] :
+#endif
+        uvec3(primitiveIdx * 3) + uvec3(0, 1, 2);
+
+    mat3 vertices;
+#ifdef ENABLE_DYNAMIC_MESHES
+    if ((geom.flags & GEOMETRY_FLAGS_DYNAMIC) != 0) {
+        vertices = calc_hit_vertices(geom.dynamic_vertices, idx);
+    } else
+#endif
+    {
+        vertices = calc_hit_vertices(geom.vertices,
+#ifdef QUANTIZED_POSITIONS
+            geom.quantized_scaling, geom.quantized_offset,
+#endif
+            idx);
+    }
+    RTHit hit = calc_hit_attributes(dist, primitiveIdx, attrib,
+        vertices, idx,
+#ifdef IMPLICIT_INSTANCE_PARAMS
+        transpose(mat3(rayQueryGetIntersectionWorldToObjectEXT(rayQuery, true))),
+#else
+        transpose(mat3(instance.world_to_instance)),
+#endif
+        geom.normals, geom.num_normals > 0,
+#ifndef QUANTIZED_NORMALS_AND_UVS
+        geom.uvs,
+#endif
+        geom.num_uvs > 0,
+        geom.material_id, geom.materials
+        );
+
+    vec3 motion_vector = vec3(0.0f);
+#if defined(ENABLE_REALTIME_RESOLVE) && defined(ENABLE_DYNAMIC_MESHES)
+    if ((geom.flags & GEOMETRY_FLAGS_DYNAMIC) != 0) {
+        motion_vector = vec3(
+#ifdef IMPLICIT_INSTANCE_PARAMS
+          rayQueryGetIntersectionObjectToWorldEXT(rayQuery, true) * vec4(
+#else
+          instance.instance_to_world * vec4(
+#endif
+          calc_hit_motion_vectors(geom.motion_vectors, idx)
+        * vec3(1.f - attrib.x - attrib.y, attrib.x, attrib.y)
+        , 0.0f) );
+    }
+#endif
+
+    #undef instance
+    #undef geom
+
+    wavefront_paths.p[path_id].hit = hit;
+    wavefront_paths.p[path_id].local_ray_orig = rayQueryGetIntersectionObjectRayOriginEXT(rayQuery, true);
+    wavefront_paths.p[path_id].instance_id = instanceIdx;
+    wavefront_paths.p[path_id].local_ray_dir = rayQueryGetIntersectionObjectRayDirectionEXT(rayQuery, true);
+    wavefront_paths.p[path_id].primitive_id = primitiveIdx;
+    wavefront_paths.p[path_id].motion_vector = motion_vector;
+
+    uint slot = wavefront_append(WAVEFRONT_QUEUE_HITS);
+    wavefront_hits.h[slot] = uvec2(hit.material_id, path_id);
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_SORT_COUNT
+
+void main() {
+    uint queue_index = wavefront_thread_index();
+    if (queue_index >= wavefront_header.header.queues[WAVEFRONT_QUEUE_HITS].count)
+        return;
+    uint bin = wavefront_sort_bin(wavefront_hits.h[queue_index].x);
+    atomicAdd(wavefront_header.header.sort_bins[bin], 1);
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_SORT_SCAN
+
+#define WAVEFRONT_BINS_PER_THREAD (WAVEFRONT_SORT_BINS / WAVEFRONT_WORKGROUP_SIZE)
+shared uint32_t scan_sums[WAVEFRONT_WORKGROUP_SIZE];
+
+// exclusive prefix sum of the bin counts, dispatched as a single workgroup
+void main() {
+    uint t = gl_LocalInvocationID.x;
+    uint counts[WAVEFRONT_BINS_PER_THREAD];
+    uint sum = 0;
+    for (int i = 0; i < WAVEFRONT_BINS_PER_THREAD; ++i) {
+        counts[i] = wavefront_header.header.sort_bins[t * WAVEFRONT_BINS_PER_THREAD + i];
+        sum += counts[i];
+    }
+    scan_sums[t] = sum;
+    barrier();
+    for (uint stride = 1; stride < WAVEFRONT_WORKGROUP_SIZE; stride *= 2) {
+        uint prev = t >= stride ? scan_sums[t - stride] : 0;
+        barrier();
+        scan_sums[t] += prev;
+        barrier();
+    }
+    uint offset = scan_sums[t] - sum;
+    for (int i = 0; i < WAVEFRONT_BINS_PER_THREAD; ++i) {
+        wavefront_header.header.sort_bins[t * WAVEFRONT_BINS_PER_THREAD + i] = offset;
+        offset += counts[i];
+    }
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_SORT_SCATTER
+
+// order within bins is arbitrary, only grouping matters for coherence
+void main() {
+    uint queue_index = wavefront_thread_index();
+    if (queue_index >= wavefront_header.header.queues[WAVEFRONT_QUEUE_HITS].count)
+        return;
+    uvec2 hit = wavefront_hits.h[queue_index];
+    uint slot = atomicAdd(wavefront_header.header.sort_bins[wavefront_sort_bin(hit.x)], 1);
+    wavefront_sorted_hits.i[slot] = hit.y;
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_SHADE
+
+void main() {
+    uint queue_index = wavefront_thread_index();
+    if (queue_index >= wavefront_header.header.queues[WAVEFRONT_QUEUE_HITS].count)
+        return;
+    uint path_id = wavefront_sorted_hits.i[queue_index];
+    wavefront_pixel = wavefront_path_pixel(path_id);
+
+    vec3 ray_origin = wavefront_paths.p[path_id].ray_origin;
+    vec3 ray_dir = wavefront_paths.p[path_id].ray_dir;
+    vec3 path_throughput = wavefront_paths.p[path_id].throughput;
+    vec3 illum = wavefront_paths.p[path_id].illum;
+    ShadingSampleState shading_state;
+    shading_state.bounce = wavefront_paths.p[path_id].bounce;
+    shading_state.output_channel = render_params.output_channel;
+    shading_state.prev_bounce_pdf = wavefront_paths.p[path_id].prev_bounce_pdf;
+    float total_t = wavefront_paths.p[path_id].total_t;
+
+    RANDOM_STATE rng = UNPACK_RNG(wavefront_paths.p[path_id]);
+    RANDOM_SET_DIM(rng, DIM_CAMERA_END + wavefront_bounce * (DIM_VERTEX_END + DIM_LIGHT_END));
+
+    RTHit hit = wavefront_paths.p[path_id].hit;
+    vec3 local_ray_orig = wavefront_paths.p[path_id].local_ray_orig;
+    vec3 local_ray_dir = wavefront_paths.p[path_id].local_ray_dir;
+
+    float approx_tri_solid_angle = length(hit.geo_normal);
+    hit.geo_normal /= approx_tri_solid_angle;
+    approx_tri_solid_angle *= abs(dot(hit.geo_normal, ray_dir)) / (hit.dist * hit.dist);
+
+    total_t += hit.dist;
+#ifdef USE_MIPMAPPING
+    mat2 texture_footprint = wavefront_paths.p[path_id].texture_footprint;
+    mat2 duvdxy;
+    {
+        vec3 dpdx, dpdy;
+        footprint_to_dpdxy(dpdx, dpdy, ray_dir, texture_footprint);
+        vec3 dir_tangent_un = ray_dir - hit.geo_normal * dot(ray_dir, hit.geo_normal);
+        float cosTheta2 = max(1.0f - dot(dir_tangent_un, dir_tangent_un), 0.0f);
+        vec3 dir_tangent_elong = dir_tangent_un / (sqrt(cosTheta2) + cosTheta2);
+        vec3 dpdx_ = dpdx + dir_tangent_elong * dot(dpdx, dir_tangent_un);
+        vec3 dpdy_ = dpdy + dir_tangent_elong * dot(dpdy, dir_tangent_un);
+        vec3 bitangent = hit.bitangent_l * cross(hit.geo_normal, normalize(hit.tangent));
+        duvdxy = mat2x2(
+                dot(hit.tangent, dpdx_), dot(bitangent, dpdx_),
+                dot(hit.tangent, dpdy_), dot(bitangent, dpdy_)
+            ) * total_t;
+    }
+#else
+    mat2 duvdxy = mat2(0.0f);
+#endif
+    geometry_scale = total_t;
+
+    #define w_o (-ray_dir)
+    InteractionPoint interaction;
+    interaction.p = ray_origin + hit.dist * ray_dir;
+    interaction.instanceId = wavefront_paths.p[path_id].instance_id;
+    interaction.primitiveId = wavefront_paths.p[path_id].primitive_id;
+
+    interaction.gn = hit.geo_normal;
+    interaction.n = hit.normal;
+
+    uint32_t material_flags = material_params[nonuniformEXT(hit.material_id)].flags;
+    // For opaque objects (or in the future, thin ones) make the normal face forward
+    if (dot(w_o, interaction.gn) < 0.0) {
+        if ((material_flags & BASE_MATERIAL_VOLUME) != 0) {
+            interaction.p = ray_origin;
+            hit.dist = 0.0f;
+        }
+        else if ((material_flags & BASE_MATERIAL_ONESIDED) == 0) {
+            interaction.n = -interaction.n;
+            interaction.gn = -interaction.gn;
+        }
+    }
+    int normal_map = material_params[nonuniformEXT(hit.material_id)].normal_map;
+    // apply normal mapping
+    if (normal_map != -1) {
+        vec3 v_y = normalize( cross(hit.normal, hit.tangent) );
+        vec3 v_x = cross(v_y, hit.normal);
+        v_x *= length(hit.tangent);
+        v_y *= hit.bitangent_l;
+
+#ifdef USE_MIPMAPPING
+        float normal_lod = float(shading_state.bounce);
+#else
+        float normal_lod = 0.0f;
+#endif
+        vec3 map_nrm = textureLod(get_standard_texture_sampler(normal_map, hit.material_id, STANDARD_TEXTURE_NORMAL_SLOT), hit.uv, normal_lod).rgb;
+        map_nrm = vec3(2.0f, 2.0f, 1.0f) * map_nrm - vec3(1.0f, 1.0f, 0.0f);
+        map_nrm.z = sqrt(max(1.0f - map_nrm.x * map_nrm.x - map_nrm.y * map_nrm.y, 0.0f));
+        mat3 iT_shframe = mat3(v_x, v_y, scene_params.normal_z_scale * interaction.n);
+        interaction.n = normalize(iT_shframe * map_nrm);
+    }
+
+    // fix incident directions under geo hemisphere
+    {
+        float nw = dot(w_o, interaction.n);
+        float gnw = dot(w_o, interaction.gn);
+        if (nw * gnw <= 0.0f) {
+            float blend = gnw / (gnw - nw);
+            interaction.n = normalize( mix(interaction.gn, interaction.n, blend - EPSILON) );
+        }
+    }
+
+#ifdef ENABLE_AOV_BUFFERS
+    if (shading_state.bounce == 0 && (accumulation_flags & ACCUMULATION_FLAGS_AOVS) != 0)
+        store_geometry_aovs(interaction.n, interaction.p, wavefront_paths.p[path_id].motion_vector);
+#endif
+
+    interaction.v_y = normalize( cross(interaction.n, hit.tangent) );
+    interaction.v_x = cross(interaction.v_y, interaction.n);
+
+    NEESampledArea nee_area;
+    nee_area.type = LIGHT_TYPE_TRIANGLE;
+    nee_area.approx_solid_angle = approx_tri_solid_angle;
+    vec3 w_i;
+    ShadingQueryAux aux;
+    vec3 shadow_illum;
+    NEEQueryAux nee_aux;
+    int shading_result = shade_wavefront(shading_state
+        , illum, path_throughput
+        , hit.material_id, material_params[nonuniformEXT(hit.material_id)]
+        , HitPoint(local_ray_orig + hit.dist * local_ray_dir, hit.uv, duvdxy, local_ray_dir)
+        , nee_area
+        , w_o, interaction
+        , rng, w_i, aux, shadow_illum, nee_aux);
+
+    if (shadow_illum != vec3(0.0f)) {
+        wavefront_paths.p[path_id].shadow_origin = interaction.p;
+        wavefront_paths.p[path_id].shadow_dist = nee_aux.light_dist;
+        wavefront_paths.p[path_id].shadow_dir = nee_aux.light_dir;
+        wavefront_paths.p[path_id].shadow_illum = shadow_illum;
+        uint slot = wavefront_append(WAVEFRONT_QUEUE_SHADOW_RAYS);
+        wavefront_shadow_queue.i[slot] = path_id;
+    }
+
+    bool continue_path = shading_result != SHADING_RESULT_TERMINATE;
+    if (continue_path) {
+#ifdef USE_MIPMAPPING
+        if (dot(w_i, interaction.n) * dot(w_o, interaction.n) > -0.999f)
+            texture_footprint = reflect_footprint(w_i, ray_dir, texture_footprint);
+        wavefront_paths.p[path_id].texture_footprint = texture_footprint;
+#endif
+        wavefront_paths.p[path_id].t_min = shading_result > SHADING_RESULT_NULL
+            ? geometry_scale_to_tmin(interaction.p, total_t) : 0.0f;
+        wavefront_paths.p[path_id].t_max = 1e20f;
+        wavefront_paths.p[path_id].ray_origin = interaction.p;
+        wavefront_paths.p[path_id].ray_dir = w_i;
+    }
+    #undef w_o
+
+    // Russian roulette termination
+    if (continue_path && shading_state.bounce >= render_params.rr_path_depth) {
+        float prefix_weight = max(path_throughput.x, max(path_throughput.y, path_throughput.z));
+
+        float rr_prob = prefix_weight;
+        float rr_sample = RANDOM_FLOAT1(rng, DIM_RR);
+        if (shading_state.bounce > 6)
+            rr_prob = min(0.95f, rr_prob);
+        else
+            rr_prob = min(1.0f, rr_prob);
+
+        if (rr_sample < rr_prob)
+            path_throughput /= rr_prob;
+        else
+            continue_path = false;
+    }
+
+    wavefront_paths.p[path_id].throughput = path_throughput;
+    wavefront_paths.p[path_id].illum = illum;
+    wavefront_paths.p[path_id].bounce = shading_state.bounce;
+    wavefront_paths.p[path_id].prev_bounce_pdf = shading_state.prev_bounce_pdf;
+    wavefront_paths.p[path_id].total_t = total_t;
+    PACK_RNG(rng, wavefront_paths.p[path_id]);
+
+    if (continue_path) {
+        uint slot = wavefront_append(WAVEFRONT_QUEUE_RAYS + ((wavefront_bounce + 1) & 1));
+        wavefront_next_ray_queue.i[slot] = path_id;
+    }
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_SHADOW
+
+void main() {
+    uint queue_index = wavefront_thread_index();
+    if (queue_index >= wavefront_header.header.queues[WAVEFRONT_QUEUE_SHADOW_RAYS].count)
+        return;
+    uint path_id = wavefront_shadow_queue.i[queue_index];
+    wavefront_pixel = wavefront_path_pixel(path_id);
+    geometry_scale = wavefront_paths.p[path_id].total_t;
+
+    if (wavefront_test_visibility(wavefront_paths.p[path_id].shadow_origin
+        , wavefront_paths.p[path_id].shadow_dir, wavefront_paths.p[path_id].shadow_dist))
+        wavefront_paths.p[path_id].illum += wavefront_paths.p[path_id].shadow_illum;
+}
+
+#elif WAVEFRONT_STAGE == WAVEFRONT_STAGE_RESOLVE
+
+void main() {
+    uint path_id = wavefront_thread_index();
+    if (!wavefront_path_valid(path_id))
+        return;
+    wavefront_pixel = wavefront_path_pixel(path_id);
+    vec4 final_color = vec4(wavefront_paths.p[path_id].illum, wavefront_paths.p[path_id].bounce == 0 ? 0.0f : 1.0f);
+    uint sample_index = wavefront_sample_index();
+
+#ifdef ENABLE_RAYQUERIES
+    if (num_rayqueries > 0) {
+        accumulate_query(wavefront_pixel_offset + path_id, final_color, sample_index);
+        return;
+    }
+#endif
+
+    ivec2 fb_dims = ivec2(view_params.frame_dims);
+    if (wavefront_pixel.x < fb_dims.x && wavefront_pixel.y < fb_dims.y)
+        accumulate(wavefront_pixel, final_color, sample_index, (accumulation_flags & ACCUMULATION_FLAGS_ATOMIC) != 0);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "render_vulkan.h"
 #include "render_pipeline_vulkan.h"
 #include "../librender/gpu_programs.h"
+#include "../librender/wavefront_queues.h"
 #include <algorithm>
 #include <array>
 #include <numeric>
@@ -261,6 +262,254 @@ void ComputeRenderPipelineVulkan::dispatch_rays(VkCommandBuffer render_cmd_buf,
 }
 
 
+// matches the push constant block of pt_wavefront.glsl
+struct WavefrontPushConstants {
+    glsl::PushConstantParams kernel_params; // pushed by bind_pipeline
+    uint64_t header;
+    uint64_t paths;
+    uint64_t ray_queue;
+    uint64_t next_ray_queue;
+    uint64_t hits;
+    uint64_t sorted_hits;
+    uint64_t shadow_queue;
+    uint32_t path_count;
+    uint32_t pixel_offset;
+    uint32_t width;
+    uint32_t sample;
+    uint32_t bounce;
+    uint32_t pad;
+};
+static_assert(sizeof(WavefrontPushConstants) == 96, "Wavefront push constants out of sync with pt_wavefront.glsl");
+
+static_assert(WavefrontRenderPipelineVulkan::STAGE_COUNT == WAVEFRONT_STAGE_COUNT, "Wavefront stage count out of sync");
+static char const* const WAVEFRONT_STAGE_MODULES[WAVEFRONT_STAGE_COUNT] = {
+    "generate", "extend", "sort_count", "sort_scan", "sort_scatter", "shade", "shadow", "resolve"
+};
+
+// byte offsets of the sections of the wavefront buffer
+struct WavefrontBufferLayout {
+    size_t header, paths, ray_queues[2], hits, sorted_hits, shadow_queue, size;
+
+    WavefrontBufferLayout(uint32_t path_capacity) {
+        auto align = [](size_t offset) { return (offset + 255) & ~size_t(255); };
+        header = 0;
+        paths = align(sizeof(glsl::WavefrontQueueHeader));
+        ray_queues[0] = align(paths + size_t(path_capacity) * WAVEFRONT_PATH_STATE_BYTES);
+        ray_queues[1] = align(ray_queues[0] + sizeof(uint32_t) * path_capacity);
+        hits = align(ray_queues[1] + sizeof(uint32_t) * path_capacity);
+        sorted_hits = align(hits + sizeof(uint32_t) * 2 * path_capacity);
+        shadow_queue = align(sorted_hits + sizeof(uint32_t) * path_capacity);
+        size = align(shadow_queue + sizeof(uint32_t) * path_capacity);
+    }
+};
+
+static size_t wavefront_counter_offset(int queue) {
+    return offsetof(glsl::WavefrontQueueHeader, queues) + sizeof(glsl::WavefrontQueueCounter) * queue;
+}
+
+WavefrontRenderPipelineVulkan::WavefrontRenderPipelineVulkan(RenderVulkan* backend, GpuProgram const* program
+    , vkrt::RenderPipelineOptions const& pipeline_options
+    , bool defer)
+    : RenderPipelineVulkan(backend, pipeline_options) {
+    this->source_program = program;
+    this->pipeline_bindpoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    this->pipeline_options.default_push_constant_size = sizeof(WavefrontPushConstants);
+    try {
+        build_shader_descriptor_table(nullptr);
+        build_layout(VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+        build_pipeline(program, defer);
+    }
+    catch (...) {
+        internal_release_resources();
+        throw;
+    }
+}
+
+WavefrontRenderPipelineVulkan::~WavefrontRenderPipelineVulkan() {
+    internal_release_resources();
+}
+
+void WavefrontRenderPipelineVulkan::internal_release_resources() {
+    for (auto& pipeline : stage_pipelines) {
+        vkDestroyPipeline(device->logical_device(), pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+    // alias of the generate stage
+    pipeline_handle = VK_NULL_HANDLE;
+    deferred_modules.clear();
+    wavefront_buffer = nullptr;
+}
+
+bool WavefrontRenderPipelineVulkan::hot_reload(std::unique_ptr<RenderPipelineVulkan>& next_pipeline, unsigned for_generation) {
+    if (for_generation == this->hot_reload_generation)
+        return false;
+
+    bool needs_rebuild = source_program && gpu_program_binary_changed(source_program, pipeline_options);
+    this->hot_reload_generation = for_generation;
+
+    if (needs_rebuild) {
+        std::unique_ptr<RenderPipelineVulkan> new_pipeline{
+            new WavefrontRenderPipelineVulkan(backend, source_program, pipeline_options, false)
+        };
+        new_pipeline->hot_reload_generation = for_generation;
+        next_pipeline = std::move(new_pipeline);
+        return true;
+    }
+    return false;
+}
+
+std::string WavefrontRenderPipelineVulkan::name() {
+    return "Wavefront Render Pipeline";
+}
+
+void WavefrontRenderPipelineVulkan::wait_for_construction() {
+    if (!deferred_modules.empty()) {
+        for (int i = 0; i < STAGE_COUNT; ++i)
+            CHECK_VULKAN( build_compute_pipeline(*device, &stage_pipelines[i], pipeline_layout, deferred_modules[i]) );
+        deferred_modules.clear();
+        pipeline_handle = stage_pipelines[WAVEFRONT_STAGE_GENERATE];
+    }
+}
+
+bool WavefrontRenderPipelineVulkan::build_pipeline(GpuProgram const* program, bool defer) {
+    make_gpu_program_binaries(program, pipeline_options);
+
+    std::vector<vkrt::ShaderModule> stage_modules;
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        auto stage_unit = gpu_module_single_unit(program, WAVEFRONT_STAGE_MODULES[i]);
+        stage_modules.push_back(vkrt::ShaderModule(*device
+            , read_gpu_shader_binary(stage_unit, pipeline_options)));
+    }
+
+    if (defer) {
+        deferred_modules = std::move(stage_modules);
+        return false;
+    }
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        CHECK_VULKAN( build_compute_pipeline(*device, &stage_pipelines[i], pipeline_layout, stage_modules[i]) );
+    pipeline_handle = stage_pipelines[WAVEFRONT_STAGE_GENERATE];
+    return true;
+}
+
+void WavefrontRenderPipelineVulkan::reserve_paths(uint32_t path_count) {
+    if (path_count <= path_capacity && wavefront_buffer)
+        return;
+    // previous frames may still be tracing with the old buffer
+    if (wavefront_buffer)
+        CHECK_VULKAN( vkDeviceWaitIdle(device->logical_device()) );
+
+    WavefrontBufferLayout layout(path_count);
+    wavefront_buffer = vkrt::Buffer::device(vkrt::MemorySource(*device)
+        , layout.size
+        , VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+        | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    path_capacity = path_count;
+}
+
+void WavefrontRenderPipelineVulkan::dispatch_rays(VkCommandBuffer render_cmd_buf, int width, int height, int batch_spp) {
+    uint32_t pixel_count = uint32_t(width) * uint32_t(height);
+    reserve_paths(std::min(pixel_count, uint32_t(WAVEFRONT_MAX_PATHS)));
+
+    WavefrontBufferLayout layout(path_capacity);
+    VkDeviceAddress base = wavefront_buffer->device_address();
+    WavefrontPushConstants push_constants = { };
+    push_constants.header = base + layout.header;
+    push_constants.paths = base + layout.paths;
+    push_constants.hits = base + layout.hits;
+    push_constants.sorted_hits = base + layout.sorted_hits;
+    push_constants.shadow_queue = base + layout.shadow_queue;
+    push_constants.width = uint32_t(width);
+
+    size_t const push_offset = offsetof(WavefrontPushConstants, header);
+    auto push = [&]() {
+        vkCmdPushConstants(render_cmd_buf, pipeline_layout, push_constant_stages
+            , uint32_t(push_offset), uint32_t(sizeof(push_constants) - push_offset)
+            , reinterpret_cast<char const*>(&push_constants) + push_offset);
+    };
+    // all stages communicate through the buffer, indirect dispatches read the counters
+    auto barrier = [&]() {
+        VkMemoryBarrier mem_barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        mem_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        mem_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+            | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(render_cmd_buf
+            , VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+            , VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+            , 0, 1, &mem_barrier, 0, nullptr, 0, nullptr);
+    };
+    auto bind_stage = [&](int stage) {
+        vkCmdBindPipeline(render_cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, stage_pipelines[stage]);
+    };
+    auto dispatch_queue = [&](int stage, int queue) {
+        bind_stage(stage);
+        vkCmdDispatchIndirect(render_cmd_buf, wavefront_buffer
+            , layout.header + wavefront_counter_offset(queue) + offsetof(glsl::WavefrontQueueCounter, groups_x));
+        barrier();
+    };
+    glsl::WavefrontQueueCounter const empty_counter = { 0, 0, 1, 1 };
+    auto reset_queue = [&](int queue) {
+        vkCmdUpdateBuffer(render_cmd_buf, wavefront_buffer, layout.header + wavefront_counter_offset(queue)
+            , sizeof(empty_counter), &empty_counter);
+    };
+
+    glsl::WavefrontQueueHeader empty_header = { };
+    for (auto& counter : empty_header.queues)
+        counter = empty_counter;
+
+    int max_path_depth = backend->params.max_path_depth;
+    for (int sample = 0; sample < batch_spp; ++sample) {
+        for (uint32_t pixel_offset = 0; pixel_offset < pixel_count; pixel_offset += path_capacity) {
+            uint32_t path_count = std::min(path_capacity, pixel_count - pixel_offset);
+            uint32_t path_groups = (path_count + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+            push_constants.path_count = path_count;
+            push_constants.pixel_offset = pixel_offset;
+            push_constants.sample = uint32_t(sample);
+
+            barrier();
+            vkCmdUpdateBuffer(render_cmd_buf, wavefront_buffer, layout.header, sizeof(empty_header), &empty_header);
+            barrier();
+
+            push_constants.bounce = 0;
+            push_constants.ray_queue = base + layout.ray_queues[0];
+            push();
+            bind_stage(WAVEFRONT_STAGE_GENERATE);
+            vkCmdDispatch(render_cmd_buf, path_groups, 1, 1);
+            barrier();
+
+            // bounces without active paths result in empty indirect dispatches
+            for (int bounce = 0; bounce < max_path_depth; ++bounce) {
+                int ray_queue = WAVEFRONT_QUEUE_RAYS + bounce % 2;
+                push_constants.bounce = uint32_t(bounce);
+                push_constants.ray_queue = base + layout.ray_queues[bounce % 2];
+                push_constants.next_ray_queue = base + layout.ray_queues[(bounce + 1) % 2];
+                push();
+
+                dispatch_queue(WAVEFRONT_STAGE_EXTEND, ray_queue);
+                dispatch_queue(WAVEFRONT_STAGE_SORT_COUNT, WAVEFRONT_QUEUE_HITS);
+                bind_stage(WAVEFRONT_STAGE_SORT_SCAN);
+                vkCmdDispatch(render_cmd_buf, 1, 1, 1);
+                barrier();
+                dispatch_queue(WAVEFRONT_STAGE_SORT_SCATTER, WAVEFRONT_QUEUE_HITS);
+                dispatch_queue(WAVEFRONT_STAGE_SHADE, WAVEFRONT_QUEUE_HITS);
+                dispatch_queue(WAVEFRONT_STAGE_SHADOW, WAVEFRONT_QUEUE_SHADOW_RAYS);
+
+                // consumed queues are reset for the next bounce
+                reset_queue(ray_queue);
+                reset_queue(WAVEFRONT_QUEUE_HITS);
+                reset_queue(WAVEFRONT_QUEUE_SHADOW_RAYS);
+                vkCmdFillBuffer(render_cmd_buf, wavefront_buffer, layout.header + offsetof(glsl::WavefrontQueueHeader, sort_bins)
+                    , sizeof(empty_header.sort_bins), 0);
+                barrier();
+            }
+
+            bind_stage(WAVEFRONT_STAGE_RESOLVE);
+            vkCmdDispatch(render_cmd_buf, path_groups, 1, 1);
+        }
+    }
+    barrier();
+}
+
+
 RayTracingPipelineVulkan::RayTracingPipelineVulkan(RenderVulkan* backend, GpuProgram const* program
     , VkShaderStageFlags push_constant_stages, vkrt::RenderPipelineOptions const& pipeline_options
     , bool defer
@@ -137,6 +137,39 @@ struct ComputeRenderPipelineVulkan : RenderPipelineVulkan {
     void build_shader_binding_table() override { }
 };
 
+// Wavefront path tracer (pt_wavefront.glsl), one compute pipeline per stage that
+// are dispatched per bounce with sizes read from the queue counters on the GPU
+struct WavefrontRenderPipelineVulkan : RenderPipelineVulkan {
+    static const int STAGE_COUNT = 8;
+    VkPipeline stage_pipelines[STAGE_COUNT] = { VK_NULL_HANDLE };
+    std::vector<vkrt::ShaderModule> deferred_modules;
+
+    GpuProgram const* source_program = nullptr;
+
+    // queue header, path state and queues, grown to the largest wave
+    vkrt::Buffer wavefront_buffer;
+    uint32_t path_capacity = 0;
+
+    WavefrontRenderPipelineVulkan(RenderVulkan* backend, GpuProgram const* program
+        , vkrt::RenderPipelineOptions const& pipeline_options
+        , bool defer = false);
+    ~WavefrontRenderPipelineVulkan();
+    void internal_release_resources();
+    void wait_for_construction() override;
+
+    void dispatch_rays(VkCommandBuffer render_cmd_buf, int width, int height, int batch_spp) override;
+
+    std::string name() override;
+    bool hot_reload(std::unique_ptr<RenderPipelineVulkan>& next_pipeline, unsigned for_generation) override;
+
+    void update_shader_binding_table() override { }
+
+    // internal
+    bool build_pipeline(GpuProgram const* program, bool defer); // returns false if deferred
+    void build_shader_binding_table() override { }
+    void reserve_paths(uint32_t path_count);
+};
+
 struct RayTracingPipelineVulkan : RenderPipelineVulkan {
     vkrt::RTPipeline rt_pipeline;
 
@@ -31,6 +31,7 @@ void RenderVulkan::update_sky_light(SceneConfig const& config) {
     glsl::SceneParams& sceneParams = global_params(true)->scene_params;
     sceneParams.sun_dir = sun_dir;
     sceneParams.sun_cos_angle = std::cos(glm::radians(0.53f) / 2.0f);
+    sceneParams.environment_rotation = glm::radians(config.environment_rotation);
 
     glsl::SkyModelParams& skyParams = sceneParams.sky_params;
     for (int i = 0; i < 9; ++i)
@@ -63,8 +64,11 @@ void RenderVulkan::update_sky_light(SceneConfig const& config) {
             sceneParams.sun_radiance = glm::vec4(0.01f * glsl::xyz_to_srgb(xyz_radiance), 1.0f);
         else
             sceneParams.sun_radiance = glm::vec4(0.0f);
+        // the environment map takes the place of the sun, scaled by its radiance
+        if (sceneParams.environment_map)
+            sceneParams.sun_radiance = glm::vec4(glm::vec3(config.environment_intensity), 1.0f);
 
-        if (sceneParams.light_sampling.light_count > 0)
+        if (sceneParams.light_sampling.light_count > 0 || sceneParams.light_sampling.quad_light_count > 0)
             sceneParams.sun_radiance.w *= 0.5f;
         else
             sceneParams.sun_radiance.w = 1.0f;
@@ -9,14 +9,18 @@
 
 #include <librender/scene.h>
 #include <librender/halton.h>
+#include <librender/quantization.h>
 
 #include "types.h"
 #include "util.h"
+#include "parallel.h"
 #include "profiling.h"
 #include "resource_utils.h"
 
 #include <algorithm>
+#include <chrono>
 #include <numeric>
+#include <unordered_map>
 
 #include <glm/ext.hpp>
 #include <cstdlib>
@@ -36,6 +40,8 @@ extern "C" { extern struct GpuProgram const* const vulkan_raytracers[]; } // tod
 extern "C" { extern struct GpuProgram const vulkan_program_PROCESS_SAMPLES; }
 
 #include "../librender/gpu_programs.h"
+#include "../librender/adaptive_sampling.h"
+#include "../librender/opacity_baker.h"
 const int GPU_INTEGRATOR_COUNT = []() -> int {
     int i = 0;
     while (vulkan_integrators[i])
@@ -102,6 +108,33 @@ RenderVulkan::RenderVulkan(vkrt::Device const& dev)
 
     cached_gpu_params.reset(new ParameterCache());
 
+    path_guiding_field_buf = vkrt::Buffer::device(*device,
+                                        PathGuidingField::gpu_buffer_size(),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        swap_buffer_count);
+    path_guiding_samples_buf = vkrt::Buffer::host(*device,
+                                        sizeof(glsl::PathGuidingSampleHeader) + sizeof(glsl::PathGuidingSample) * PATH_GUIDING_MAX_SAMPLES,
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        swap_buffer_count);
+    for (int i = 0; i < swap_buffer_count; ++i) {
+        path_guiding_field_buf.cycle_swap(swap_buffer_count);
+        path_guiding.write_gpu_buffer(path_guiding_field_buf->map());
+        path_guiding_field_buf->unmap();
+        path_guiding_samples_buf.cycle_swap(swap_buffer_count);
+        *(glsl::PathGuidingSampleHeader*) path_guiding_samples_buf->map() = glsl::PathGuidingSampleHeader();
+        path_guiding_samples_buf->unmap();
+    }
+
+    // header of an empty map, until a scene brings its own
+    environment_map_buf = vkrt::Buffer::device(*device,
+                                        EnvironmentMap().gpu_buffer_size(),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    EnvironmentMap().write_gpu_buffer(environment_map_buf->map());
+    environment_map_buf->unmap();
+
     null_buffer = vkrt::Buffer::device(*device, sizeof(uint64_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
     null_texture = vkrt::Texture2D::device(*device
         , glm::ivec4(1, 1, 1, 0)
@@ -166,6 +199,12 @@ void RenderVulkan::internal_release_resources()
         if (pipeline_preparation.build.valid())
             pipeline_preparation.build.wait();
     pipeline_store.prepared.clear();
+    for (auto& async_build : pipeline_store.async_builds)
+        if (async_build.build.valid())
+            async_build.build.wait();
+    pipeline_store.async_builds.clear();
+    pipeline_store.last_used.clear();
+    pipeline_store.last_rendered_variant = -1;
     pipeline_store.pipelines.release_resources();
     sample_processing_pipeline = nullptr;
 
@@ -246,6 +285,7 @@ static const VkFormat DEPTH_STENCIL_BUFFER_FORMAT = VK_FORMAT_D32_SFLOAT;
 void RenderVulkan::initialize(const int render_width, const int render_height)
 {
     frame_id = 0;
+    accumulation_frame = 0;
     frame_offset = 0;
 
     CHECK_VULKAN(vkDeviceWaitIdle(device->logical_device()));
@@ -313,6 +353,14 @@ void RenderVulkan::initialize(const int render_width, const int render_height)
 );
     }
 
+    adaptive_sampling_stats = vkrt::Texture2D::device(memory_arena,
+                                            glm::ivec4(render_width, render_height, 0, 0),
+                                            VK_FORMAT_R32G32B32A32_SFLOAT,
+                                            VK_IMAGE_USAGE_STORAGE_BIT);
+    adaptive_sampling_totals = vkrt::Buffer::device(memory_arena
+        , sizeof(glsl::AdaptiveSamplingTotals)
+        , VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
     img_readback_buf = vkrt::Buffer::host(memory_arena
         , render_width * render_height * render_upscale_factor * render_upscale_factor * sizeof(float) * 4
         , VK_BUFFER_USAGE_TRANSFER_DST_BIT
@@ -453,7 +501,7 @@ void RenderVulkan::enable_ray_queries(int max_queries, const int max_queries_per
         | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 }
 
-void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& rebuild_tlas) {
+void RenderVulkan::update_geometry(const std::vector<Mesh> &scene_meshes, bool& update_sbt, bool& rebuild_tlas) {
     vkrt::MemorySource static_memory_arena(device, base_arena_idx + StaticArenaOffset);
     vkrt::MemorySource scratch_memory_arena(device, vkrt::Device::ScratchArena);
 
@@ -467,7 +515,11 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
     // much build + scratch that we run out of GPU memory.
     // Some helpers for managing the temp upload heap buf allocation and queuing of
     // the commands would help to make it easier to write the parallel load version
-    meshes.resize(scene.meshes.size());
+    meshes.resize(scene_meshes.size());
+    blas_refit_heuristics.resize(scene_meshes.size());
+    blas_paged_out.resize(scene_meshes.size());
+    // dynamic meshes whose BLAS is updated in place rather than rebuilt
+    std::vector<char> refit_pending(scene_meshes.size());
 
     const int max_pending_bvh_tris = 5000000;
     const int upload_batch_min_tri_count = max_pending_bvh_tris/4;
@@ -489,15 +541,22 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
             ProfilingScope build_bvh("Build BLAS");
             sync_commands->begin_record();
             for (int mesh_idx = mesh_idx_begin; mesh_idx < mesh_idx_end; ++mesh_idx) {
-                // todo: respect optimization flag to check if a refit is enough?
+                bool enqueue_barriers = mesh_idx == mesh_idx_begin || mesh_idx == mesh_idx_end-1; // barriers in the beginning and end
+                if (refit_pending[mesh_idx]) {
+                    meshes[mesh_idx]->enqueue_refit(sync_commands->current_buffer, enqueue_barriers);
+                    continue;
+                }
+                if (blas_paged_out[mesh_idx])
+                    continue;
                 meshes[mesh_idx]->enqueue_build(sync_commands->current_buffer, static_memory_arena, scratch_memory_arena
-                    , mesh_idx == mesh_idx_begin || mesh_idx == mesh_idx_end-1); // barriers in the beginning and end
+                    , enqueue_barriers);
                 totalBVHBytes += meshes[mesh_idx]->cached_build_size;
             }
             sync_commands->end_submit();
             sync_commands->begin_record();
             for (int mesh_idx = mesh_idx_begin; mesh_idx < mesh_idx_end; ++mesh_idx)
-                meshes[mesh_idx]->enqueue_post_build_async(sync_commands->current_buffer);
+                if (!refit_pending[mesh_idx] && !blas_paged_out[mesh_idx])
+                    meshes[mesh_idx]->enqueue_post_build_async(sync_commands->current_buffer);
             sync_commands->end_submit();
             build_bvh.end();
 
@@ -505,7 +564,8 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
             ProfilingScope compact_bvh("Compact BLAS");
             sync_commands->begin_record();
             for (int mesh_idx = mesh_idx_begin; mesh_idx < mesh_idx_end; ++mesh_idx)
-                meshes[mesh_idx]->enqueue_compaction(sync_commands->current_buffer, static_memory_arena);
+                if (!refit_pending[mesh_idx] && !blas_paged_out[mesh_idx])
+                    meshes[mesh_idx]->enqueue_compaction(sync_commands->current_buffer, static_memory_arena);
             sync_commands->end_submit();
         }
 
@@ -514,11 +574,20 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
         sync_commands->begin_record();
         for (int mesh_idx = mesh_idx_begin; mesh_idx < mesh_idx_end; ++mesh_idx) {
             auto& bvh = meshes[mesh_idx];
-            auto& mesh = scene.meshes[mesh_idx];
+            auto& mesh = scene_meshes[mesh_idx];
+            bool refitted = refit_pending[mesh_idx] != 0;
+            refit_pending[mesh_idx] = 0;
             // Retrieve handles
-            if (vkrt::CmdTraceRaysKHR) {
+            if (blas_paged_out[mesh_idx]) {
+                // uploads are complete, the BLAS is built once its page is requested
+                bvh->evict();
+                advise_mesh_residency(mesh, false);
+            }
+            else if (vkrt::CmdTraceRaysKHR && !refitted) {
                 bvh->finalize();
                 totalCompactBVHBytes += meshes[mesh_idx]->bvh_buf->size();
+                if (geometry_pager.enabled() && mesh_idx < ilen(geometry_pager.mesh_pages))
+                    geometry_pager.set_mesh_bytes(mesh_idx, bvh->bvh_buf->size());
             }
 
             bool model_changed = bvh->model_revision != mesh.model_revision;
@@ -530,7 +599,8 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
             bvh->optimize_revision = mesh.model_optimize_revision();
 
             rebuild_tlas |= model_changed;
-            blas_changed |= vertices_changed;
+            blas_changed |= vertices_changed && !refitted;
+            blas_content_changed |= refitted;
         }
         sync_commands->end_submit();
 
@@ -547,8 +617,8 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
 
     ProfilingScope profile_geometry("Upload geometry");
 
-    for (int mesh_idx = 0; mesh_idx < (int) scene.meshes.size(); ++mesh_idx) {
-        const auto &mesh = scene.meshes[mesh_idx];
+    for (int mesh_idx = 0; mesh_idx < (int) scene_meshes.size(); ++mesh_idx) {
+        const auto &mesh = scene_meshes[mesh_idx];
 
         bool model_changed = true, vertices_changed = true, attributes_changed = true, optimize_changed = true;
         vkrt::TriangleMesh* cached_mesh = meshes[mesh_idx].get();
@@ -650,7 +720,8 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
 #else
             mesh_vertex_count * sizeof(glm::vec3),
 #endif
-            geometry_usage_flags);
+            geometry_usage_flags
+            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT); // skinning keeps a copy of the rest pose
         vkrt::Buffer mesh_uv_buf = nullptr;
 #ifdef QUANTIZED_NORMALS_AND_UVS
         mesh_uv_buf = mesh_normal_buf; // quantized uvs share the same buffer if present
@@ -927,7 +998,46 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
             update_sbt = true;
         }
 
-        bool need_new_bvh = model_changed || /* todo: remove */ vertices_changed;
+        // meshlet bounds follow the vertices of dynamic meshes, deformations on the GPU are not tracked
+        if (model_changed || vertices_changed) {
+            bool gpu_deformed = (mesh.flags & Mesh::Skinned) || !mesh.mesh_shader_names.empty();
+            for (int geo_idx = 0; geo_idx < (int) mesh.geometries.size(); ++geo_idx) {
+                const auto &geom = mesh.geometries[geo_idx];
+                vkrt::Geometry& vkgeo = geometries[geo_idx];
+                if (gpu_deformed)
+                    vkgeo.meshlets = mapped_vector<Meshlet>();
+                else if (dynamic_vertices && !geom.meshlets.empty())
+                    vkgeo.meshlets = mapped_vector<Meshlet>(refit_meshlets(geom, geom.meshlets.data(), ilen(geom.meshlets)));
+                else
+                    vkgeo.meshlets = geom.meshlets;
+            }
+        }
+
+        // Dynamic meshes update their BLAS in place as long as the meshlets did not move apart
+        // too far from where they were at build time, meshlets approximate the BLAS leaves
+        bool refit_bvh = false;
+        if (dynamic_vertices && vertices_changed && !optimize_changed) {
+            std::vector<Box> meshlet_bounds;
+            for (int geo_idx = 0; geo_idx < (int) mesh.geometries.size(); ++geo_idx) {
+                if (geometries[geo_idx].meshlets.empty() && mesh.geometries[geo_idx].num_tris() > 0) {
+                    meshlet_bounds.clear();
+                    break;
+                }
+                for (auto& m : geometries[geo_idx].meshlets)
+                    meshlet_bounds.push_back(Box(m.bounds.origin - m.bounds.radius, m.bounds.origin + m.bounds.radius));
+            }
+
+            auto& heuristic = blas_refit_heuristics[mesh_idx];
+            refit_bvh = !model_changed && cached_mesh->bvh != VK_NULL_HANDLE
+                && (cached_mesh->build_flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR)
+                && !meshlet_bounds.empty() && !heuristic.needs_rebuild(meshlet_bounds);
+            if (refit_bvh)
+                heuristic.refitted();
+            else
+                heuristic.rebuilt(meshlet_bounds);
+        }
+
+        bool need_new_bvh = model_changed || (vertices_changed && !refit_bvh);
 
         if (!need_new_bvh) {
             cached_mesh->geometries = std::move(geometries);
@@ -956,6 +1066,9 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
         }
 
         meshes[mesh_idx] = std::move(bvh);
+        refit_pending[mesh_idx] = refit_bvh;
+        // static meshes on pages that are not resident only upload their vertex data
+        blas_paged_out[mesh_idx] = geometry_pager.enabled() && !geometry_pager.mesh_resident(mesh_idx);
         pending_bvh_tris += mesh_tri_count;
         pending_bvh_end = mesh_idx + 1;
     }
@@ -992,7 +1105,7 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
         int mc = ilen(meshes[i]->geometries);
         mesh_shader_names[i].resize(mc);
 
-        auto& custom_shader_names = scene.meshes[i].mesh_shader_names;
+        auto& custom_shader_names = scene_meshes[i].mesh_shader_names;
         int num_custom_shader_names = std::min((int) custom_shader_names.size(), mc);
         int j = 0;
         for (; j < num_custom_shader_names; ++j)
@@ -1002,11 +1115,82 @@ void RenderVulkan::update_geometry(const Scene &scene, bool& update_sbt, bool& r
     }
 }
 
+void RenderVulkan::update_geometry_pages(glm::vec3 camera_position, float fov_y) {
+    // rebuilds need the geometry, which is only retained for scenes set with a budget
+    if (paged_meshes.empty() || !vkrt::CmdTraceRaysKHR)
+        return;
+    size_t budget_bytes = size_t(std::max(this->RenderBackend::options.blas_budget_mb, 0)) << 20;
+    // after a reset or budget change, BLAS built before may need to be evicted
+    bool reconcile = budget_bytes != geometry_pager.params.budget_bytes || geometry_pager.update_count == 0;
+    geometry_pager.params.budget_bytes = budget_bytes;
+    if (!geometry_pager.update(camera_position, fov_y, tlas_lod_offset) && !reconcile)
+        return;
+
+    // bring the BLAS in line with the pages selected by the pager
+    std::vector<int> load_meshes, evict_meshes;
+    for (int mesh_idx = 0, mesh_count = std::min(ilen(paged_meshes), ilen(meshes)); mesh_idx < mesh_count; ++mesh_idx) {
+        bool resident = geometry_pager.mesh_resident(mesh_idx);
+        if (resident && blas_paged_out[mesh_idx])
+            load_meshes.push_back(mesh_idx);
+        else if (!resident && !blas_paged_out[mesh_idx])
+            evict_meshes.push_back(mesh_idx);
+    }
+    if (load_meshes.empty() && evict_meshes.empty())
+        return;
+
+    ProfilingScope profile_paging("Page geometry");
+    // evicted BLAS may still be referenced by frames in flight
+    CHECK_VULKAN(vkDeviceWaitIdle(device->logical_device()));
+
+    for (int mesh_idx : evict_meshes) {
+        meshes[mesh_idx]->evict();
+        blas_paged_out[mesh_idx] = 1;
+        advise_mesh_residency(paged_meshes[mesh_idx], false);
+    }
+    if (!evict_meshes.empty()) {
+        ++blas_generation;
+        ++blas_content_generation;
+    }
+
+    if (!load_meshes.empty()) {
+        for (int mesh_idx : load_meshes) {
+            advise_mesh_residency(paged_meshes[mesh_idx], true);
+            // forces a re-upload of the build inputs and a new BLAS
+            meshes[mesh_idx]->vertex_revision = ~0u;
+        }
+        bool update_sbt = false;
+        bool rebuild_tlas = false;
+        update_geometry(paged_meshes, update_sbt, rebuild_tlas);
+        // reloaded meshes live in new buffers, hit groups need their addresses
+        if (update_sbt) {
+            for (int pm_idx = 0, pm_count = std::min(ilen(parameterized_meshes), ilen(render_meshes)); pm_idx < pm_count; ++pm_idx) {
+                int mesh_idx = parameterized_meshes[pm_idx].mesh_id;
+                if (mesh_idx < 0 || !std::binary_search(load_meshes.begin(), load_meshes.end(), mesh_idx))
+                    continue;
+                auto const& geometries = meshes[mesh_idx]->geometries;
+                for (int j = 0, je = std::min(ilen(geometries), ilen(render_meshes[pm_idx])); j < je; ++j)
+                    write_render_mesh_buffers(render_meshes[pm_idx][j], geometries[j]);
+            }
+            ++render_meshes_generation;
+            update_instance_params();
+        }
+    }
+
+    println(CLL::VERBOSE, "Paged in %d and out %d meshes, %sB of %sB BLAS budget resident, %d pages missing"
+        , ilen(load_meshes), ilen(evict_meshes)
+        , pretty_print_count(geometry_pager.resident_bytes).c_str()
+        , pretty_print_count(budget_bytes).c_str()
+        , geometry_pager.missing_pages);
+
+    // instances of evicted meshes are inactive with a null BLAS reference
+    update_tlas(true);
+}
+
 void RenderVulkan::update_lights(const Scene &scene)
 {
     uint32_t numPointLights = scene.pointLights.size();
     uint32_t numQuadLights = scene.quadLights.size();
-    lightData.resize(numPointLights/* + numQuadLights*/);
+    lightData.resize(numPointLights + numQuadLights);
 
     // Add the point lights
     for (uint32_t lightIdx = 0; lightIdx < numPointLights; ++lightIdx)
@@ -1026,7 +1210,6 @@ void RenderVulkan::update_lights(const Scene &scene)
         lightData[lightIdx] = data;
     }
 
-    /*
     // Add the quad lights
     for (uint32_t lightIdx = 0; lightIdx < numQuadLights; ++lightIdx)
     {
@@ -1044,25 +1227,59 @@ void RenderVulkan::update_lights(const Scene &scene)
         data.range = 10.0f;
         data.falloff = 1.0f;
 
+        data.forward = light.normal;
+        data.right = light.v_x;
         data.width = light.width;
+        data.up = light.v_y;
         data.height = light.height;
 
         // Export to the buffer
-        lightData[lightIdx] = data;
+        lightData[numPointLights + lightIdx] = data;
     }
-    */
     // Add the tri lights
 
     // Upload to the GPU
     upload_light_data();
 }
 
+void RenderVulkan::update_environment_map(const Scene &scene)
+{
+    vkrt::MemorySource static_memory_arena(device, base_arena_idx + StaticArenaOffset);
+    vkrt::MemorySource scratch_memory_arena(device, vkrt::Device::ScratchArena);
+    auto async_commands = device.async_command_stream();
+
+    EnvironmentMap const& map = scene.environment_map;
+    size_t map_size = map.gpu_buffer_size();
+    if (environment_map_buf->size() < map_size)
+        environment_map_buf = vkrt::Buffer::device(static_memory_arena, map_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    auto upload_map = environment_map_buf->for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, scratch_memory_arena);
+    map.write_gpu_buffer(upload_map->map());
+    upload_map->unmap();
+
+    async_commands->begin_record();
+    VkBufferCopy copy_cmd = {};
+    copy_cmd.size = map_size;
+    vkCmdCopyBuffer(async_commands->current_buffer, upload_map->handle(), environment_map_buf->handle(), 1, &copy_cmd);
+    async_commands->hold_buffer(upload_map);
+    async_commands->end_submit();
+
+    global_params(true)->scene_params.environment_map = map.empty() ? 0 : 1;
+    update_sky_light(scene_config);
+}
+
 void RenderVulkan::update_meshes(const Scene &scene, bool& update_sbt, bool& rebuild_sbt) {
     vkrt::MemorySource static_memory_arena(device, base_arena_idx + StaticArenaOffset);
     vkrt::MemorySource scratch_memory_arena(device, vkrt::Device::ScratchArena);
 
     auto async_commands = device.async_command_stream();
 
+    // alpha ranges of base color textures, shared by the meshes baked in this update
+    std::unordered_map<uint32_t, AlphaRangeTexture> alpha_textures;
+    OpacityBakeParams opacity_bake_params;
+    // any-hit biases texture lookups by up to 5 mip levels
+    opacity_bake_params.max_mip_level = 5;
+
     // Compute the offsets each parameterized mesh will be written too in the SBT,
     // these are then the instance SBT offsets shared by each instance
     len_t unrolled_geometry_offset = 0;
@@ -1110,22 +1327,7 @@ void RenderVulkan::update_meshes(const Scene &scene, bool& update_sbt, bool& reb
                 upload_materials = materials_buf->secondary_for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
 
                 uint8_t *map = (uint8_t*) upload_materials->map();
-                uint8_t *mapped_id = map;
-                switch (pm.material_id_bitcount) {
-                case 8:
-                    memcpy(mapped_id, pm.triangle_material_ids.data(), upload_materials->size());
-                    break;
-                case 16:
-                    for (unsigned id : pm.triangle_material_ids.as_range<uint16_t>())
-                        *mapped_id++ = static_cast<uint8_t>(id);
-                    break;
-                case 32:
-                    for (unsigned id : pm.triangle_material_ids.as_range<uint32_t>())
-                        *mapped_id++ = static_cast<uint8_t>(id);
-                    break;
-                default:
-                    assert(false);
-                }
+                dequantize_material_ids(map, size_t(pm.num_triangle_material_ids()), pm.triangle_material_ids.data(), pm.material_id_bitcount);
 
                 pm_no_alpha = true;
                 len_t i = 0;
@@ -1153,6 +1355,135 @@ void RenderVulkan::update_meshes(const Scene &scene, bool& update_sbt, bool& reb
                 pm_no_alpha &= (scene.materials[pm.material_offset(i)].flags & BASE_MATERIAL_NOALPHA) != 0;
         }
 
+        // classify the triangles of alpha-tested materials, known triangles skip the alpha evaluation
+        vkrt::Buffer opacity_state_buf = nullptr;
+        std::vector<int> opacity_state_offsets;
+        std::vector<uint8_t> geometry_opacity;
+        if (materials_changed && !pm_no_alpha && this->RenderBackend::options.bake_opacity_states) {
+            ProfilingScope profile_opacity("Bake opacity states");
+            auto const& mesh = scene.meshes[pm.mesh_id];
+
+            std::vector<uint8_t> triangle_materials;
+            if (pm.per_triangle_materials()) {
+                triangle_materials.resize(pm.num_triangle_material_ids());
+                dequantize_material_ids(triangle_materials.data(), triangle_materials.size(), pm.triangle_material_ids.data(), pm.material_id_bitcount);
+            }
+
+            // textured alpha, or -1 if the state of triangles with this material is known up front
+            auto alpha_texture = [&](Geometry const& geom, int material_id, uint8_t& state) -> int {
+                auto const& material = scene.materials[material_id];
+                state = OPACITY_STATE_UNKNOWN;
+                if (material.flags & BASE_MATERIAL_NOALPHA) {
+                    state = OPACITY_STATE_OPAQUE;
+                    return -1;
+                }
+                uint32_t tex_mask;
+                memcpy(&tex_mask, (char*) &material.base_color, sizeof(uint32_t));
+                if ((material.flags & BASE_MATERIAL_NEURAL) || !IS_TEXTURED_PARAM(tex_mask) || geom.uvs.empty())
+                    return -1;
+                uint32_t tex_id = GET_TEXTURE_ID(tex_mask);
+                Image const& image = scene.textures[tex_id];
+                if (image.bcFormat < 0 || (image.bcFormat == 0 && image.channels != 4))
+                    return -1;
+                if (alpha_textures.find(tex_id) == alpha_textures.end()) {
+                    auto texels = image.decompressBytes();
+                    alpha_textures.emplace(tex_id, AlphaRangeTexture(image.width, image.height, image.mip_levels()
+                        , texels.data(), opacity_bake_params.max_mip_level));
+                }
+                return int(tex_id);
+            };
+
+            // gather the uvs of all triangles of the mesh that sample the same alpha texture
+            struct AlphaTriangles {
+                std::vector<len_t> triangles;
+                std::vector<float> uvs;
+            };
+            std::unordered_map<int, AlphaTriangles> alpha_triangles;
+            std::vector<uint8_t> states(mesh.num_tris());
+            len_t triangle_offset = 0;
+            for (int j = 0, je = mesh.num_geometries(); j < je; ++j) {
+                auto const& geom = mesh.geometries[j];
+                for (int i = 0, ie = geom.num_tris(); i < ie; ++i) {
+                    int material_id = pm.material_offset(j);
+                    if (!triangle_materials.empty())
+                        material_id += triangle_materials[triangle_offset + i];
+                    int tex_id = alpha_texture(geom, material_id, states[triangle_offset + i]);
+                    if (tex_id < 0)
+                        continue;
+                    auto& tris = alpha_triangles[tex_id];
+                    tris.triangles.push_back(triangle_offset + i);
+                    glm::vec2 uvs[3];
+                    geom.tri_uvs(i, uvs[0], uvs[1], uvs[2]);
+                    tris.uvs.insert(tris.uvs.end(), &uvs[0].x, &uvs[0].x + 6);
+                }
+                triangle_offset += geom.num_tris();
+            }
+
+            // bake all gathered triangles in parallel, in chunks of one texture each
+            struct BakeChunk {
+                int tex_id;
+                len_t begin, end;
+            };
+            len_t const bake_chunk_size = 1024;
+            std::vector<BakeChunk> bake_chunks;
+            for (auto const& tris : alpha_triangles) {
+                len_t count = len(tris.second.triangles);
+                for (len_t begin = 0; begin < count; begin += bake_chunk_size)
+                    bake_chunks.push_back({ tris.first, begin, std::min(begin + bake_chunk_size, count) });
+            }
+            parallel_for(int_cast(bake_chunks.size()), [&](int c) {
+                auto const& chunk = bake_chunks[c];
+                auto const& tris = alpha_triangles.at(chunk.tex_id);
+                auto chunk_states = bake_opacity_states(alpha_textures.at(chunk.tex_id), &tris.uvs[6 * chunk.begin]
+                    , chunk.end - chunk.begin, opacity_bake_params);
+                for (len_t i = chunk.begin; i < chunk.end; ++i)
+                    states[tris.triangles[i]] = chunk_states[i - chunk.begin];
+            });
+
+            std::vector<uint32_t> packed_states;
+            opacity_state_offsets.resize(mesh.num_geometries(), -1);
+            geometry_opacity.resize(mesh.num_geometries(), OPACITY_STATE_UNKNOWN);
+            bool all_opaque = true;
+            triangle_offset = 0;
+            for (int j = 0, je = mesh.num_geometries(); j < je; ++j) {
+                uint8_t const* geometry_states = states.data() + triangle_offset;
+                int triangle_count = mesh.geometries[j].num_tris();
+                triangle_offset += triangle_count;
+                bool geometry_opaque = std::all_of(geometry_states, geometry_states + triangle_count
+                    , [](uint8_t state) { return state == OPACITY_STATE_OPAQUE; });
+                all_opaque &= geometry_opaque;
+                if (geometry_opaque) {
+                    geometry_opacity[j] = OPACITY_STATE_OPAQUE;
+                    continue;
+                }
+                auto packed = pack_opacity_states(geometry_states, triangle_count);
+                opacity_state_offsets[j] = int_cast(packed_states.size());
+                packed_states.insert(packed_states.end(), packed.begin(), packed.end());
+            }
+            // fully opaque meshes are forced opaque in the TLAS
+            pm_no_alpha = all_opaque;
+
+            if (!packed_states.empty()) {
+                opacity_state_buf = vkrt::Buffer::device(reuse(static_memory_arena, cached_mesh->opacity_state_buf),
+                    packed_states.size() * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                    | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                    | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+                auto upload_states = opacity_state_buf->secondary_for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+                std::memcpy(upload_states->map(), packed_states.data(), packed_states.size() * sizeof(uint32_t));
+                upload_states->unmap();
+
+                VkBufferCopy copy_cmd = {};
+                copy_cmd.size = packed_states.size() * sizeof(uint32_t);
+                vkCmdCopyBuffer(async_commands->current_buffer,
+                                upload_states->handle(),
+                                opacity_state_buf->handle(),
+                                1,
+                                &copy_cmd);
+                async_commands->hold_buffer(upload_states);
+            }
+        }
+
         async_commands->end_submit();
 
         auto& vkpm = parameterized_meshes[pm_idx];
@@ -1164,6 +1495,9 @@ void RenderVulkan::update_meshes(const Scene &scene, bool& update_sbt, bool& reb
         if (materials_changed) {
             vkpm.per_triangle_material_buf = materials_buf;
             vkpm.no_alpha = pm_no_alpha;
+            vkpm.opacity_state_buf = opacity_state_buf;
+            vkpm.opacity_state_offsets = std::move(opacity_state_offsets);
+            vkpm.geometry_opacity = std::move(geometry_opacity);
             vkpm.material_revision = pm.model_material_revision();
         }
 
@@ -1230,46 +1564,12 @@ void RenderVulkan::default_update_tlas(std::unique_ptr<vkrt::TopLevelBVH>& scene
         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
-    uint32_t instancedGeometryCount = 0;
-    bool have_procedural_instances = false;
     {
         auto upload_instances = instance_buf->secondary_for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
 
         VkAccelerationStructureInstanceKHR *map =
             reinterpret_cast<VkAccelerationStructureInstanceKHR *>(upload_instances->map());
-
-        for (int i = 0, ie = int_cast(instances.size()); i < ie; ++i) {
-            const auto &inst = instances[i];
-            VkAccelerationStructureInstanceKHR vkinst = { };
-            int parameterized_mesh_id = inst.parameterized_mesh_id;
-            auto& lodGroup = this->lod_groups[parameterized_mesh_id];
-            if (!lodGroup.mesh_ids.empty())
-                parameterized_mesh_id = lodGroup.mesh_ids[std::min(lod_offset, (int) lodGroup.mesh_ids.size() -1)];
-#ifdef IMPLICIT_INSTANCE_PARAMS
-            vkinst.instanceCustomIndex = parameterized_meshes[parameterized_mesh_id].render_mesh_base_offset;
-#else
-            vkinst.instanceCustomIndex = instancedGeometryCount;
-#endif
-            vkinst.instanceShaderBindingTableRecordOffset =
-                parameterized_meshes[parameterized_mesh_id].render_mesh_base_offset;
-            vkinst.flags = parameterized_meshes[parameterized_mesh_id].no_alpha ? VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR : 0;
-            int mesh_id = parameterized_meshes[parameterized_mesh_id].mesh_id;
-            vkinst.accelerationStructureReference = meshes[mesh_id]->device_address;
-            vkinst.mask = instance_mask;
-
-            // Note: 4x3 row major
-            const glm::mat4 m = glm::transpose(inst.transform);
-            for (int r = 0; r < 3; ++r) {
-                for (int c = 0; c < 4; ++c) {
-                    vkinst.transform.matrix[r][c] = m[r][c];
-                }
-            }
-
-            map[i] = vkinst;
-
-            instancedGeometryCount += parameterized_meshes[parameterized_mesh_id].render_mesh_count;
-        }
-
+        write_tlas_instances(map, lod_offset, instance_mask);
         upload_instances->unmap();
 
         async_commands->begin_record();
@@ -1315,11 +1615,196 @@ void RenderVulkan::default_update_tlas(std::unique_ptr<vkrt::TopLevelBVH>& scene
         scene_bvh->finalize();
     }
 
+    if (&scene_bvh == &this->scene_bvh) {
+        tlas_lod_offset = lod_offset;
+        tlas_instance_mask = instance_mask;
+        // instances of the previous hierarchy are superseded
+        pending_instance_upload = nullptr;
+        tlas_refit_heuristic.rebuilt(instance_bounds.world_bounds);
+        // a rebuild supersedes any refit requested for the previous hierarchy
+        pending_tlas_request = BVHOperation::None;
+    }
+
     // todo: make more selective?
     ++tlas_generation;
     ++tlas_content_generation;
 }
 
+uint32_t RenderVulkan::write_tlas_instances(VkAccelerationStructureInstanceKHR* map, int lod_offset, uint32_t instance_mask) {
+    uint32_t instancedGeometryCount = 0;
+    for (int i = 0, ie = int_cast(instances.size()); i < ie; ++i) {
+        const auto &inst = instances[i];
+        VkAccelerationStructureInstanceKHR vkinst = { };
+        int parameterized_mesh_id = active_lod_member(this->lod_groups[inst.parameterized_mesh_id], inst.parameterized_mesh_id, lod_offset);
+#ifdef IMPLICIT_INSTANCE_PARAMS
+        vkinst.instanceCustomIndex = parameterized_meshes[parameterized_mesh_id].render_mesh_base_offset;
+#else
+        vkinst.instanceCustomIndex = instancedGeometryCount;
+#endif
+        vkinst.instanceShaderBindingTableRecordOffset =
+            parameterized_meshes[parameterized_mesh_id].render_mesh_base_offset;
+        vkinst.flags = parameterized_meshes[parameterized_mesh_id].no_alpha ? VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR : 0;
+        int mesh_id = parameterized_meshes[parameterized_mesh_id].mesh_id;
+        vkinst.accelerationStructureReference = meshes[mesh_id]->device_address;
+        vkinst.mask = instance_mask;
+
+        // Note: 4x3 row major
+        const glm::mat4 m = glm::transpose(inst.transform);
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                vkinst.transform.matrix[r][c] = m[r][c];
+            }
+        }
+
+        map[i] = vkinst;
+
+        instancedGeometryCount += parameterized_meshes[parameterized_mesh_id].render_mesh_count;
+    }
+    return instancedGeometryCount;
+}
+
+void RenderVulkan::update_animated_instances() {
+    if (!scene_bvh || !vkrt::CmdTraceRaysKHR || !instance_bounds.has_animation())
+        return;
+    if (instance_bounds.update(this->time, tlas_lod_offset) == 0)
+        return;
+
+    for (int i = 0, ie = int_cast(instances.size()); i < ie; ++i)
+        instances[i].transform = instance_bounds.transforms[i];
+
+    // the copy is recorded into the frame's command stream ahead of the TLAS update, see record_instance_upload
+    pending_instance_upload = scene_bvh->instance_buf->secondary_for_host(VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    {
+        VkAccelerationStructureInstanceKHR *map =
+            reinterpret_cast<VkAccelerationStructureInstanceKHR *>(pending_instance_upload->map());
+        write_tlas_instances(map, tlas_lod_offset, tlas_instance_mask);
+        pending_instance_upload->unmap();
+    }
+
+    // refits keep the hierarchy built for the old transforms, rebuild once it degrades too much
+    if (tlas_refit_heuristic.needs_rebuild(instance_bounds.world_bounds)) {
+        request_tlas_operation(BVHOperation::Rebuild);
+        tlas_refit_heuristic.rebuilt(instance_bounds.world_bounds);
+    } else {
+        request_tlas_operation(BVHOperation::Refit);
+        tlas_refit_heuristic.refitted();
+    }
+    ++tlas_content_generation;
+
+#ifndef IMPLICIT_INSTANCE_PARAMS
+    // instance transforms are baked into the per-geometry instance parameters
+    instance_params_generation = ~0;
+    update_instance_params(true);
+#endif
+}
+
+void RenderVulkan::record_instance_upload(vkrt::CommandStream* cmd_stream) {
+    if (!pending_instance_upload && !pending_instance_params_upload)
+        return;
+    VkCommandBuffer cmd_buf = cmd_stream->current_buffer;
+    bool params_uploaded = pending_instance_params_upload != nullptr;
+
+    struct Upload {
+        vkrt::Buffer& src;
+        VkBuffer dst;
+    } uploads[] = {
+        { pending_instance_upload, scene_bvh->instance_buf->handle() },
+        { pending_instance_params_upload, instance_param_buf ? instance_param_buf->handle() : VK_NULL_HANDLE },
+    };
+
+    // previous TLAS updates and frames are done reading the instances and their parameters
+    BUFFER_BARRIER(buf_barrier);
+    buf_barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    for (auto& upload : uploads) {
+        if (!upload.src)
+            continue;
+        buf_barrier.buffer = upload.dst;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             1, &buf_barrier,
+                             0, nullptr);
+
+        VkBufferCopy copy_cmd = {};
+        copy_cmd.size = upload.src->size();
+        vkCmdCopyBuffer(cmd_buf,
+                        upload.src->handle(),
+                        upload.dst,
+                        1,
+                        &copy_cmd);
+        cmd_stream->hold_buffer(upload.src);
+        upload.src = nullptr;
+    }
+
+    // note: the TLAS update that follows waits for all prior writes, shaders need a barrier
+    buf_barrier.buffer = uploads[1].dst;
+    buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    if (params_uploaded)
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0, nullptr,
+                             1, &buf_barrier,
+                             0, nullptr);
+}
+
+void RenderVulkan::reset_path_guiding() {
+    Box scene_bounds;
+    for (auto const& b : instance_bounds.world_bounds)
+        scene_bounds += b;
+    if (scene_bounds.empty())
+        scene_bounds = Box(glm::vec3(-1.0f), glm::vec3(1.0f));
+    float lower[3] = { scene_bounds.lower.x, scene_bounds.lower.y, scene_bounds.lower.z };
+    float upper[3] = { scene_bounds.upper.x, scene_bounds.upper.y, scene_bounds.upper.z };
+    path_guiding.reset(lower, upper);
+    path_guiding_pending_uploads = swap_buffer_count;
+    path_guiding_training_probability = 1.0f;
+    // samples of frames still in flight belong to the previous field
+    for (int i = 0; i < MAX_SWAP_BUFFERS; ++i)
+        path_guiding_slot_stale[i] = path_guiding_slot_trained[i];
+}
+
+void RenderVulkan::update_path_guiding() {
+    // note: slots cycle in lockstep with the swap index
+    path_guiding_field_buf.cycle_swap(active_swap_buffer_count);
+    path_guiding_samples_buf.cycle_swap(active_swap_buffer_count);
+
+    // only frames that guided paths recorded training samples into their slot
+    bool trained = path_guiding_slot_trained[swap_index];
+    bool stale = path_guiding_slot_stale[swap_index];
+    path_guiding_slot_trained[swap_index] = false;
+    path_guiding_slot_stale[swap_index] = false;
+    if (trained) {
+        auto header = (glsl::PathGuidingSampleHeader*) path_guiding_samples_buf->map();
+        uint32_t recorded = header->count;
+        if (recorded > 0 && !stale && !path_guiding.nodes.empty()) {
+            path_guiding.add_samples((glsl::PathGuidingSample const*) (header + 1)
+                , std::min(recorded, uint32_t(PATH_GUIDING_MAX_SAMPLES)));
+            // record paths such that the sample buffer is filled to about 80%
+            float requested = float(recorded) / path_guiding_training_probability;
+            path_guiding_training_probability = std::min(0.8f * float(PATH_GUIDING_MAX_SAMPLES) / requested, 1.0f);
+        }
+        header->count = 0;
+        path_guiding_samples_buf->unmap();
+
+        // refit once enough samples arrived, each fit is uploaded into all slots in turn
+        if (path_guiding.iteration_samples >= PATH_GUIDING_MAX_SAMPLES / 2) {
+            path_guiding.refine_and_fit();
+            path_guiding_pending_uploads = swap_buffer_count;
+        }
+    }
+    if (path_guiding_pending_uploads > 0) {
+        path_guiding.write_gpu_buffer(path_guiding_field_buf->map());
+        path_guiding_field_buf->unmap();
+        --path_guiding_pending_uploads;
+    }
+}
+
 void RenderVulkan::request_tlas_operation(BVHOperation op) {
     if (op == BVHOperation::Rebuild)
         pending_tlas_request = BVHOperation::Rebuild;
@@ -1374,6 +1859,7 @@ void RenderVulkan::update_instances(const Scene &scene, bool rebuild_tlas) {
     auto sync_commands = device.sync_command_stream();
 
     instances.resize(scene.instances.size());
+    instance_bounds.reset(scene, this->time, tlas_lod_offset);
     parameterized_instances.resize(parameterized_meshes.size());
     for (auto& pi : parameterized_instances)
         pi.clear();
@@ -1391,28 +1877,19 @@ void RenderVulkan::update_instances(const Scene &scene, bool rebuild_tlas) {
 
             vkrt::Instance vkinst;
             vkinst.parameterized_mesh_id = inst.parameterized_mesh_id;
-
-            const auto &animData = scene.animation_data.at(inst.animation_data_index);
-            constexpr uint32_t frame = 0;
-            vkinst.transform = animData.dequantize(inst.transform_index, frame);
+            vkinst.transform = instance_bounds.transforms[i];
 
             instances[i] = vkinst;
 
-            // todo: incorporate lod groups
-            glm::vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
-            glm::vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-            for (auto& geo : scene.meshes[scene.parameterized_meshes[vkinst.parameterized_mesh_id].mesh_id].geometries) {
-                aabbMin = min(geo.base, aabbMin);
-                aabbMax = max(geo.base + geo.extent, aabbMax);
-            }
-
-            map[i].minX = aabbMin.x;
-            map[i].minY = aabbMin.y;
-            map[i].minZ = aabbMin.z;
-            map[i].maxX = aabbMax.x;
-            map[i].maxY = aabbMax.y;
-            map[i].maxZ = aabbMax.z;
+            // local bounds of the LoD member that is currently active
+            const Box& aabb = instance_bounds.local_bounds[instance_bounds.active_meshes[i]];
 
+            map[i].minX = aabb.lower.x;
+            map[i].minY = aabb.lower.y;
+            map[i].minZ = aabb.lower.z;
+            map[i].maxX = aabb.upper.x;
+            map[i].maxY = aabb.upper.y;
+            map[i].maxZ = aabb.upper.z;
 
             parameterized_instances[vkinst.parameterized_mesh_id].push_back(i);
             instanced_geometry_count += parameterized_meshes[vkinst.parameterized_mesh_id].render_mesh_count;
@@ -1468,7 +1945,7 @@ void RenderVulkan::update_instances(const Scene &scene, bool rebuild_tlas) {
     }
 }
 
-void RenderVulkan::update_instance_params() {
+void RenderVulkan::update_instance_params(bool in_frame_stream) {
     if (instance_params_generation == render_meshes_generation)
         return;
 
@@ -1486,13 +1963,19 @@ void RenderVulkan::update_instance_params() {
         instanced_geometry_count += parameterized_meshes[inst.parameterized_mesh_id].render_mesh_count;
 #endif
 
-    instance_param_buf = vkrt::Buffer::device(reuse(static_memory_arena, instance_param_buf),
 #ifdef IMPLICIT_INSTANCE_PARAMS
-        instanced_geometry_count * sizeof(RenderMeshParams),
+    size_t instance_params_size = instanced_geometry_count * sizeof(RenderMeshParams);
 #else
-        instanced_geometry_count * sizeof(InstancedGeometry),
+    size_t instance_params_size = instanced_geometry_count * sizeof(InstancedGeometry);
 #endif
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    // same-sized updates can be copied in the frame's command stream, in place of the parameters the previous frames read
+    in_frame_stream &= instance_param_buf && instance_param_buf->size() == instance_params_size;
+    if (!in_frame_stream) {
+        instance_param_buf = vkrt::Buffer::device(reuse(static_memory_arena, instance_param_buf),
+            instance_params_size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        pending_instance_params_upload = nullptr;
+    }
     {
 #ifdef IMPLICIT_INSTANCE_PARAMS
         std::vector<RenderMeshParams> geo_instances;
@@ -1536,6 +2019,13 @@ void RenderVulkan::update_instance_params() {
         std::memcpy(map, geo_instances.data(), upload_params->size());
         upload_params->unmap();
 
+        if (in_frame_stream) {
+            // recorded ahead of the next frame, see record_instance_upload
+            pending_instance_params_upload = upload_params;
+            instance_params_generation = render_meshes_generation;
+            return;
+        }
+
         sync_commands->begin_record();
 
         VkBufferCopy copy_cmd = {};
@@ -1554,6 +2044,7 @@ void RenderVulkan::update_instance_params() {
 void RenderVulkan::set_scene(const Scene &scene)
 {
     frame_id = 0;
+    accumulation_frame = 0;
 
     // currently any kind of reallocation may occur
     CHECK_VULKAN(vkDeviceWaitIdle(device->logical_device()));
@@ -1573,6 +2064,7 @@ void RenderVulkan::set_scene(const Scene &scene)
 
     if (new_scene) {
         meshes.clear();
+        blas_paged_out.clear();
         this->meshes_revision = ~0;
         parameterized_meshes.clear();
         this->parameterized_meshes_revision = ~0;
@@ -1583,13 +2075,23 @@ void RenderVulkan::set_scene(const Scene &scene)
         this->tlas_content_generation = 0;
     }
 
-    if (this->meshes_revision != scene.meshes_revision)
-        update_geometry(scene, update_sbt, rebuild_tlas);
+    bool meshes_changed = this->meshes_revision != scene.meshes_revision;
+    if (meshes_changed || this->instances_revision != scene.instances_revision) {
+        // pages follow the placement of instances, BLAS are reconciled on the next frame
+        GeometryPagingParams paging_params;
+        paging_params.budget_bytes = size_t(std::max(this->RenderBackend::options.blas_budget_mb, 0)) << 20;
+        geometry_pager.reset(scene, paging_params, this->time);
+        paged_meshes = geometry_pager.enabled() ? scene.meshes : std::vector<Mesh>();
+    }
+    if (meshes_changed)
+        update_geometry(scene.meshes, update_sbt, rebuild_tlas);
     if (this->parameterized_meshes_revision != scene.parameterized_meshes_revision)
         update_meshes(scene, update_sbt, rebuild_sbt);
 
-    if (this->lights_revision != scene.lights_revision)
+    if (this->lights_revision != scene.lights_revision) {
         update_lights(scene);
+        update_environment_map(scene);
+    }
 
     this->meshes_revision = scene.meshes_revision;
     this->parameterized_meshes_revision = scene.parameterized_meshes_revision;
@@ -1604,6 +2106,7 @@ void RenderVulkan::set_scene(const Scene &scene)
     if (rebuild_tlas || this->instances_revision != scene.instances_revision) {
         update_instances(scene, rebuild_tlas);
         this->instances_revision = scene.instances_revision;
+        reset_path_guiding();
     }
 
     if (new_scene) {
@@ -1875,6 +2378,160 @@ bool RenderVulkan::render_ray_queries(int num_queries, const RenderParams &param
     return true;
 }
 
+namespace {
+
+// Each slot stages its queries and reads back its results through own host buffers, the query
+// and result device buffers of the backend are shared, so the traces of consecutive slots
+// serialize on the device while staging and readback of other slots overlap with them.
+struct RayQuerySlotsVulkan : RayQuerySlots {
+    struct Slot {
+        vkrt::Buffer upload = nullptr;
+        vkrt::Buffer readback = nullptr;
+        int cursor = -1;
+    };
+    RenderVulkan* backend;
+    int variant_idx;
+    int capacity;
+    vkrt::AsyncCommandStream cmd_stream;
+    std::vector<Slot> slots;
+
+    RayQuerySlotsVulkan(RenderVulkan* backend, int variant_idx, int slot_count, int slot_capacity)
+        : backend(backend)
+        , variant_idx(variant_idx)
+        , capacity(slot_capacity)
+        , cmd_stream(backend->device, vkrt::CommandQueueType::Main, slot_count)
+        , slots(slot_count) {
+        vkrt::MemorySource memory_arena(backend->device, vkrt::Device::DisplayArena);
+        for (auto& slot : slots) {
+            slot.upload = vkrt::Buffer::host(memory_arena
+                , size_t(capacity) * sizeof(RenderRayQuery)
+                , VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+            slot.readback = vkrt::Buffer::host(memory_arena
+                , size_t(capacity) * sizeof(glm::vec4)
+                , VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                , VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }
+    }
+    ~RayQuerySlotsVulkan() {
+        cmd_stream.wait_complete();
+    }
+
+    int slot_count() const override { return (int) slots.size(); }
+    int slot_capacity() const override { return capacity; }
+
+    void submit(int slot_idx, RenderRayQuery const* queries, int num_queries) override {
+        assert(num_queries <= capacity);
+        Slot& slot = slots[slot_idx];
+        if (slot.cursor >= 0)
+            cmd_stream.wait_complete(slot.cursor);
+
+        void* upload_data = slot.upload->map();
+        std::memcpy(upload_data, queries, sizeof(RenderRayQuery) * num_queries);
+        slot.upload->unmap();
+
+        cmd_stream.begin_record();
+        VkCommandBuffer cmd_buf = cmd_stream.current_buffer;
+
+        // previous traces and result copies are done with the shared device buffers
+        BUFFER_BARRIER(buf_barrier);
+        buf_barrier.buffer = backend->ray_query_buffer;
+        buf_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        buf_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             1, &buf_barrier,
+                             0, nullptr);
+
+        VkBufferCopy query_copy = {};
+        query_copy.size = sizeof(RenderRayQuery) * num_queries;
+        vkCmdCopyBuffer(cmd_buf, slot.upload->handle(), backend->ray_query_buffer->handle(), 1, &query_copy);
+
+        BUFFER_BARRIER(result_barrier);
+        result_barrier.buffer = backend->ray_result_buffer;
+        result_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        result_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        VkBufferMemoryBarrier trace_barriers[] = { buf_barrier, result_barrier };
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0, nullptr,
+                             2, trace_barriers,
+                             0, nullptr);
+
+        backend->record_frame(cmd_buf, variant_idx, num_queries, 1);
+
+        result_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        result_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             1, &result_barrier,
+                             0, nullptr);
+
+        VkBufferCopy result_copy = {};
+        result_copy.size = sizeof(glm::vec4) * num_queries;
+        vkCmdCopyBuffer(cmd_buf, backend->ray_result_buffer->handle(), slot.readback->handle(), 1, &result_copy);
+
+        BUFFER_BARRIER(readback_barrier);
+        readback_barrier.buffer = slot.readback;
+        readback_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd_buf,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                             0,
+                             0, nullptr,
+                             1, &readback_barrier,
+                             0, nullptr);
+
+        cmd_stream.end_submit();
+        slot.cursor = cmd_stream.next_cursor() - 1;
+    }
+
+    bool poll(int slot_idx, bool wait) override {
+        Slot const& slot = slots[slot_idx];
+        if (slot.cursor < 0)
+            return true;
+        if (wait) {
+            cmd_stream.wait_complete(slot.cursor);
+            return true;
+        }
+        return cmd_stream.is_complete(slot.cursor);
+    }
+
+    void read_results(int slot_idx, glm::vec4* results, int num_queries) override {
+        Slot& slot = slots[slot_idx];
+        if (slot.cursor >= 0)
+            cmd_stream.wait_complete(slot.cursor);
+        void* readback_data = slot.readback->map();
+        slot.readback->invalidate_all();
+        std::memcpy(results, readback_data, sizeof(glm::vec4) * num_queries);
+        slot.readback->unmap();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<RayQuerySlots> RenderVulkan::create_ray_query_slots(int slot_count, int slot_capacity) {
+    if (!ray_query_buffer || !ray_result_buffer)
+        throw_error("Ray queries need to be enabled on an initialized renderer before creating query slots");
+    int variant_idx = variant_index("RQ_CLOSEST");
+    if (variant_idx < 0)
+        return nullptr;
+    slot_count = std::min(std::max(slot_count, 1), (int) vkrt::AsyncCommandStream::MAX_ASYNC_COMMAND_BUFFERS);
+    // all slots share the device buffers allocated by enable_ray_queries
+    slot_capacity = (int) std::min(size_t(std::max(slot_capacity, 1)), ray_query_buffer->size() / sizeof(RenderRayQuery));
+    return std::unique_ptr<RayQuerySlots>(new RayQuerySlotsVulkan(this, variant_idx, slot_count, slot_capacity));
+}
+
 void RenderVulkan::normalize_options(RenderBackendOptions& rbo, int variant_idx) const {
     GpuProgram const* active_program = nullptr;
     if (variant_idx >= 0 && variant_idx < (int) GPU_RAYTRACER_NAMES.size())
@@ -1902,8 +2559,9 @@ bool RenderVulkan::configure_for(RenderBackendOptions const& rbo, int variant_id
     // pre-load/compile required GPU programs before new frame / profiling begins
     bool fallback_exists = false;
     try {
+        poll_async_pipeline_builds(!allow_fallback_pipelines);
         if (variant_idx >= 0 && variant_idx < (int) GPU_RAYTRACER_NAMES.size())
-            build_raytracing_pipeline(variant_idx, rbo, false, &fallback_exists);
+            build_raytracing_pipeline(variant_idx, rbo, false, &fallback_exists, allow_fallback_pipelines);
         sample_processing_pipeline->hot_reload(sample_processing_pipeline, pipeline_store.hot_reload_generation);
     } catch (logged_exception const&) {
         return fallback_exists;
@@ -1935,9 +2593,15 @@ void RenderVulkan::begin_frame(CommandStream* cmd_stream_, const RenderConfigura
     swap_index = (swap_index + 1) % active_swap_buffer_count;
 
     if (config.reset_accumulation) {
-        if (!config.freeze_frame)
+        if (config.sample_sequence_offset >= 0)
+            frame_offset = size_t(config.sample_sequence_offset);
+        else if (!config.freeze_frame)
             frame_offset += frame_id;
         frame_id = 0;
+        accumulation_frame = 0;
+        // offline frames do not learn from the frames rendered before them
+        if (config.sample_sequence_offset >= 0)
+            reset_path_guiding();
     }
 
     if (frame_id == 0) {
@@ -1978,6 +2642,13 @@ void RenderVulkan::begin_frame(CommandStream* cmd_stream_, const RenderConfigura
 
     RenderBackend::begin_frame(cmd_stream_, config); // update params
 
+    // animated instances follow the current time
+    update_animated_instances();
+    // training samples of the frame that last used this swap index are complete
+    update_path_guiding();
+    // BLAS of static geometry follow the camera
+    update_geometry_pages(config.camera.pos, config.camera.fovy);
+
     // note: if needed:
     //if (!cmd_stream_)
     //    cmd_stream->begin_record();
@@ -2029,11 +2700,21 @@ void RenderVulkan::end_frame(CommandStream* cmd_stream_, int variant_index) {
 
         auto dst_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
         // todo: should these barriers go somewhere else?
-        vkrt::MemoryBarriers<1, 1 + 2 * (1 + AOVBufferCount)> mem_barriers;
+        vkrt::MemoryBarriers<1, 2 + 2 * (1 + AOVBufferCount)> mem_barriers;
 
         auto& current_accum_buffer = accumulate_atomically ? atomic_accum_buffers[active_accum_buffer] : accum_buffers[active_accum_buffer];
         mem_barriers.add(dst_stages, current_accum_buffer->transition_color(VK_IMAGE_LAYOUT_GENERAL
             , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+        if (sample_adaptively) {
+            mem_barriers.add(dst_stages, adaptive_sampling_stats->transition_color(VK_IMAGE_LAYOUT_GENERAL
+                , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+            // importance sums of the last frame
+            BUFFER_BARRIER(buf_barrier);
+            buf_barrier.buffer = adaptive_sampling_totals;
+            buf_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            mem_barriers.add(dst_stages, buf_barrier);
+        }
         mem_barriers.add(dst_stages, render_targets[active_render_target]->transition_color(VK_IMAGE_LAYOUT_GENERAL
             , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
 #ifdef ENABLE_AOV_BUFFERS
@@ -2067,6 +2748,8 @@ void RenderVulkan::end_frame(CommandStream* cmd_stream_, int variant_index) {
         push_constants.accumulation_batch_size = this->params.batch_spp;
         if (accumulate_atomically)
             push_constants.accumulation_flags |= ACCUMULATION_FLAGS_ATOMIC;
+        if (sample_adaptively)
+            push_constants.accumulation_flags |= ACCUMULATION_FLAGS_ADAPTIVE;
 #ifdef ENABLE_AOV_BUFFERS
         if (true)
             push_constants.accumulation_flags |= ACCUMULATION_FLAGS_AOVS;
@@ -2150,8 +2833,10 @@ void RenderVulkan::end_frame(CommandStream* cmd_stream_, int variant_index) {
         cmd_stream->end_submit();
 
     accumulated_spp = unsigned(frame_id + this->params.batch_spp);
-    if (!freeze_frame)
+    if (!freeze_frame) {
         frame_id += this->params.batch_spp;
+        ++accumulation_frame;
+    }
 }
 
 void RenderVulkan::draw_frame(CommandStream* cmd_stream_, int variant_idx) {
@@ -2162,6 +2847,7 @@ void RenderVulkan::draw_frame(CommandStream* cmd_stream_, int variant_idx) {
     if (!cmd_stream_)
         cmd_stream->begin_record();
 
+    record_instance_upload(cmd_stream);
     execute_pending_tlas_operations(cmd_stream->current_buffer);
 
     auto md = profiling_data.start_timing(cmd_stream->current_buffer, ProfilingMarker::Rendering, swap_index);
@@ -2314,6 +3000,12 @@ void RenderVulkan::register_descriptors(vkrt::BindingLayoutCollector collector,
             MATERIALS_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL)
         .add_binding(
             INSTANCES_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL)
+        .add_binding(
+            PATH_GUIDING_FIELD_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, RECURSE_AND_SINK_SHADER_STAGES)
+        .add_binding(
+            PATH_GUIDING_SAMPLES_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, RECURSE_AND_SINK_SHADER_STAGES)
+        .add_binding(
+            ENVIRONMENT_MAP_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, RECURSE_AND_SINK_SHADER_STAGES)
         ;
 
     if (options.enable_rayqueries) {
@@ -2349,6 +3041,10 @@ void RenderVulkan::register_descriptors(vkrt::BindingLayoutCollector collector,
             .add_binding(
                 ATOMIC_ACCUMBUFFER_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, RECURSE_AND_SINK_SHADER_STAGES | PROCESSING_SHADER_STAGES)
 #endif
+            .add_binding(
+                ADAPTIVE_SAMPLING_STATS_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, RECURSE_AND_SINK_SHADER_STAGES | PROCESSING_SHADER_STAGES)
+            .add_binding(
+                ADAPTIVE_SAMPLING_TOTALS_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, PROCESSING_SHADER_STAGES)
             .add_binding(
                 HISTORY_BUFFER_BIND_POINT, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, PROCESSING_SHADER_STAGES)
             .add_binding(
@@ -2405,6 +3101,9 @@ void RenderVulkan::update_shader_descriptor_table(vkrt::BindingCollector collect
         .write_ubo(desc_set, SCENE_PARAMS_BIND_POINT, global_param_buf)
         .write_ssbo(desc_set, MATERIALS_BIND_POINT, mat_params)
         .write_ssbo(desc_set, INSTANCES_BIND_POINT, instance_param_buf)
+        .write_ssbo(desc_set, PATH_GUIDING_FIELD_BIND_POINT, path_guiding_field_buf)
+        .write_ssbo(desc_set, PATH_GUIDING_SAMPLES_BIND_POINT, path_guiding_samples_buf)
+        .write_ssbo(desc_set, ENVIRONMENT_MAP_BIND_POINT, environment_map_buf)
     ;
 
     if (options.enable_rayqueries) {
@@ -2435,6 +3134,8 @@ void RenderVulkan::update_shader_descriptor_table(vkrt::BindingCollector collect
 #ifdef ATOMIC_ACCUMULATE
             .write_storage_image(desc_set, ATOMIC_ACCUMBUFFER_BIND_POINT, atomic_accum_buffers[active_accum_buffer])
 #endif
+            .write_storage_image(desc_set, ADAPTIVE_SAMPLING_STATS_BIND_POINT, adaptive_sampling_stats)
+            .write_ssbo(desc_set, ADAPTIVE_SAMPLING_TOTALS_BIND_POINT, adaptive_sampling_totals)
             .write_combined_sampler(desc_set, HISTORY_BUFFER_BIND_POINT, accum_buffers[!active_accum_buffer], screen_sampler)
             .write_combined_sampler(desc_set, HISTORY_AOV_BUFFER_BIND_POINT + 0, aov_buffers[(!active_accum_buffer) * AOVBufferCount + AOVNormalDepthIndex], screen_sampler)
             .write_combined_sampler(desc_set, HISTORY_AOV_BUFFER_BIND_POINT + 1, aov_buffers[(!active_accum_buffer) * AOVBufferCount + AOVAlbedoRoughnessIndex], screen_sampler)
@@ -2474,8 +3175,9 @@ void RenderVulkan::update_shader_descriptor_table(vkrt::BindingCollector collect
 }
 
 int RenderVulkan::register_descriptor_sets(VkDescriptorSetLayout sets[], uint32_t& push_constants_size, vkrt::RenderPipelineOptions const& options) const {
+    // pipelines may append their own push constants to the kernel parameters
     if (!push_constants_size || options.access_targets || (int) options.raster_target)
-        push_constants_size = sizeof(glsl::PushConstantParams);
+        push_constants_size = std::max(push_constants_size, (uint32_t) sizeof(glsl::PushConstantParams));
 
 #ifdef UNROLL_STANDARD_TEXTURES
     sets[STANDARD_TEXTURE_BIND_SET] = standard_textures_desc_layout;
@@ -2648,8 +3350,10 @@ void RenderVulkan::hot_reload() {
 }
 
 RenderPipelineVulkan* RenderVulkan::build_raytracing_pipeline(int variant_index, const RenderBackendOptions& for_options
-    , bool defer_initialization, bool* set_if_fallback_exists) {
+    , bool defer_initialization, bool* set_if_fallback_exists, bool async_with_fallback, int* rendered_variant_index) {
     auto* gpu_program = vulkan_raytracers[variant_index];
+    if (rendered_variant_index)
+        *rendered_variant_index = variant_index;
     bool is_integrator = (variant_index < GPU_INTEGRATOR_COUNT);
     auto& pipelines = pipeline_store.pipelines;
 
@@ -2671,68 +3375,46 @@ RenderPipelineVulkan* RenderVulkan::build_raytracing_pipeline(int variant_index,
         *set_if_fallback_exists = (current_pipeline != nullptr);
 
     if (!current_pipeline || needs_rebuild) {
-        char const* variant_name = GPU_RAYTRACER_NAMES[variant_index];
-        bool defer_build = defer_initialization;
-    // Todo: Some issue in the validation layers prevents us from doing the work asynchronously (version 1.3.211)
-    // Make sure to remove this when a new version comes out
-#if defined(_DEBUG)
-        defer_build = false;
-#endif
-        std::unique_ptr<RenderPipelineVulkan> new_pipeline;
-
-        if (gpu_program->type == GPU_PROGRAM_TYPE_RASTERIZATION) {
-#ifndef ENABLE_RASTER
-            throw_error("Built without raster support, refusing to build raster pipeline %s", variant_name);
-#else
-            println(CLL::VERBOSE, "Building raster pipeline %s", variant_name);
-
-            vkrt::RenderPipelineOptions pipeline_options;
-            (RenderBackendOptions&) pipeline_options = options;
-            pipeline_options.raster_target = vkrt::RenderPipelineTarget::AccumulationAndAOV;
-            pipeline_options.raster_depth = true;
-            new_pipeline.reset( new RasterScenePipelineVulkan(
-                this, gpu_program, pipeline_options, defer_build
-            ) );
-#endif
+        // keep rendering with the outdated pipeline or the last one used for this variant
+        // until the requested pipeline has been compiled in the background
+        RenderPipelineVulkan* fallback_pipeline = current_pipeline;
+        if (!fallback_pipeline && variant_index < (int) pipeline_store.last_used.size())
+            fallback_pipeline = pipeline_store.last_used[variant_index];
+        // variants that were never built fall back to an integrator of the same program type,
+        // preferring the one rendered last
+        int fallback_variant_index = variant_index;
+        if (!fallback_pipeline && async_with_fallback && is_integrator) {
+            auto is_candidate = [&](int v) {
+                return v >= 0 && v < (int) pipeline_store.last_used.size() && v < GPU_INTEGRATOR_COUNT
+                    && pipeline_store.last_used[v] && vulkan_raytracers[v]->type == gpu_program->type;
+            };
+            int candidate = pipeline_store.last_rendered_variant;
+            for (int v = 0, ve = (int) pipeline_store.last_used.size(); v < ve && !is_candidate(candidate); ++v)
+                candidate = v;
+            if (is_candidate(candidate)) {
+                fallback_pipeline = pipeline_store.last_used[candidate];
+                fallback_variant_index = candidate;
+            }
+        }
+        if (async_with_fallback && fallback_pipeline) {
+            queue_async_pipeline_build(variant_index, options);
+            if (set_if_fallback_exists)
+                *set_if_fallback_exists = true;
+            if (rendered_variant_index)
+                *rendered_variant_index = fallback_variant_index;
+            current_pipeline = fallback_pipeline;
         }
         else {
-            if (!vkrt::CmdTraceRaysKHR)
-                throw_error("Refusing to build potentially unsupported RT/RQ pipeline %s", variant_name);
-
-            vkrt::RenderPipelineOptions pipeline_options;
-            (RenderBackendOptions&) pipeline_options = options;
-            pipeline_options.enable_raytracing = true;
-            // todo: this needs to be adjusted to only be in research variants?
-            pipeline_options.enable_rayqueries = true;
-            // todo: this should ultimately not be necessary anymore
-            get_defined_backend_options(pipeline_options, gpu_program->modules[0]->units[0]->defines);
-            pipeline_options.access_targets = (uint16_t) vkrt::RenderPipelineUAVTarget::Accumulation
-                | (uint16_t) vkrt::RenderPipelineUAVTarget::AOV;
-
-            // allow pure ray query / compute-based RT pipelines
-            if (gpu_program->type == GPU_PROGRAM_TYPE_COMPUTE) {
-                println(CLL::VERBOSE, "Building RQ compute pipeline %s", variant_name);
-
-                new_pipeline.reset( new ComputeRenderPipelineVulkan(
-                    this, gpu_program, pipeline_options, defer_build
-                ) );
-            } else {
-                println(CLL::VERBOSE, "Building RT pipeline %s", variant_name);
-
-                new_pipeline.reset( new RayTracingPipelineVulkan(
-                    this, gpu_program, SHARED_PIPELINE_SHADER_STAGES, pipeline_options, defer_build
-                ) );
+            std::unique_ptr<RenderPipelineVulkan> new_pipeline = create_raytracing_pipeline(variant_index, options, defer_initialization);
+            if (current_pipeline) {
+                pipelines.remove(gpu_program, options);
+                std::replace(pipeline_store.last_used.begin(), pipeline_store.last_used.end(), current_pipeline, (RenderPipelineVulkan*) nullptr);
+                current_pipeline = nullptr;
             }
+            current_pipeline = pipelines.add(std::move(new_pipeline), gpu_program, options);
+            // todo: combine into a nicer wrapper? how to enable only where supported? SFINAE/enable_if? :/
+            current_pipeline->hot_reload_generation = pipeline_store.hot_reload_generation;
         }
-        assert(new_pipeline.get());
-
-        if (current_pipeline) {
-            pipelines.remove(gpu_program, options);
-            current_pipeline = nullptr;
-        }
-        current_pipeline = pipelines.add(std::move(new_pipeline), gpu_program, options);
-        // todo: combine into a nicer wrapper? how to enable only where supported? SFINAE/enable_if? :/
-        current_pipeline->hot_reload_generation = pipeline_store.hot_reload_generation;
     }
     // only initialize up to this point on startup
     assert(current_pipeline);
@@ -2745,70 +3427,224 @@ RenderPipelineVulkan* RenderVulkan::build_raytracing_pipeline(int variant_index,
     return current_pipeline;
 }
 
-std::vector<RenderMeshParams> RenderVulkan::collect_render_mesh_params(int parameterized_mesh, Scene const& scene) const {
-    const auto &pm = scene.parameterized_meshes[parameterized_mesh];
-    const auto &vkpm = parameterized_meshes[parameterized_mesh];
-    std::vector<RenderMeshParams> hit_params( meshes[pm.mesh_id]->geometries.size() );
-    len_t primOffset = 0;
-    for (int j = 0; j < (int) meshes[pm.mesh_id]->geometries.size(); ++j) {
-        auto &geom = meshes[pm.mesh_id]->geometries[j];
-        RenderMeshParams *params = hit_params.data() + j;
+std::unique_ptr<RenderPipelineVulkan> RenderVulkan::create_raytracing_pipeline(int variant_index, const RenderBackendOptions& options
+    , bool defer_build) {
+    auto* gpu_program = vulkan_raytracers[variant_index];
+    char const* variant_name = GPU_RAYTRACER_NAMES[variant_index];
+    // Todo: Some issue in the validation layers prevents us from doing the work asynchronously (version 1.3.211)
+    // Make sure to remove this when a new version comes out
+#if defined(_DEBUG)
+    defer_build = false;
+#endif
+    std::unique_ptr<RenderPipelineVulkan> new_pipeline;
+
+    if (gpu_program->type == GPU_PROGRAM_TYPE_RASTERIZATION) {
+#ifndef ENABLE_RASTER
+        throw_error("Built without raster support, refusing to build raster pipeline %s", variant_name);
+#else
+        println(CLL::VERBOSE, "Building raster pipeline %s", variant_name);
+
+        vkrt::RenderPipelineOptions pipeline_options;
+        (RenderBackendOptions&) pipeline_options = options;
+        pipeline_options.raster_target = vkrt::RenderPipelineTarget::AccumulationAndAOV;
+        pipeline_options.raster_depth = true;
+        new_pipeline.reset( new RasterScenePipelineVulkan(
+            this, gpu_program, pipeline_options, defer_build
+        ) );
+#endif
+    }
+    else {
+        if (!vkrt::CmdTraceRaysKHR)
+            throw_error("Refusing to build potentially unsupported RT/RQ pipeline %s", variant_name);
+
+        vkrt::RenderPipelineOptions pipeline_options;
+        (RenderBackendOptions&) pipeline_options = options;
+        pipeline_options.enable_raytracing = true;
+        // todo: this needs to be adjusted to only be in research variants?
+        pipeline_options.enable_rayqueries = true;
+        // todo: this should ultimately not be necessary anymore
+        get_defined_backend_options(pipeline_options, gpu_program->modules[0]->units[0]->defines);
+        pipeline_options.access_targets = (uint16_t) vkrt::RenderPipelineUAVTarget::Accumulation
+            | (uint16_t) vkrt::RenderPipelineUAVTarget::AOV;
+
+        // allow pure ray query / compute-based RT pipelines
+        if (gpu_program->type == GPU_PROGRAM_TYPE_COMPUTE && (gpu_program->feature_flags & GPU_PROGRAM_FEATURE_WAVEFRONT)) {
+            println(CLL::VERBOSE, "Building wavefront compute pipeline %s", variant_name);
+
+            new_pipeline.reset( new WavefrontRenderPipelineVulkan(
+                this, gpu_program, pipeline_options, defer_build
+            ) );
+        } else if (gpu_program->type == GPU_PROGRAM_TYPE_COMPUTE) {
+            println(CLL::VERBOSE, "Building RQ compute pipeline %s", variant_name);
+
+            new_pipeline.reset( new ComputeRenderPipelineVulkan(
+                this, gpu_program, pipeline_options, defer_build
+            ) );
+        } else {
+            println(CLL::VERBOSE, "Building RT pipeline %s", variant_name);
+
+            new_pipeline.reset( new RayTracingPipelineVulkan(
+                this, gpu_program, SHARED_PIPELINE_SHADER_STAGES, pipeline_options, defer_build
+            ) );
+        }
+    }
+    assert(new_pipeline.get());
+    return new_pipeline;
+}
 
+void RenderVulkan::queue_async_pipeline_build(int variant_index, const RenderBackendOptions& options) {
+    auto matches_request = [&](PipelineStore::AsyncBuild const& async_build) {
+        return async_build.variant_index == variant_index && equal_options(async_build.options, options);
+    };
+    for (auto& async_build : pipeline_store.async_builds) {
+        // pending, or failed builds that are only retried after the next hot reload
+        if (matches_request(async_build) && (async_build.build.valid()
+         || async_build.failed_generation == pipeline_store.hot_reload_generation))
+            return;
+    }
+    pipeline_store.async_builds.erase(std::remove_if(pipeline_store.async_builds.begin(), pipeline_store.async_builds.end()
+        , matches_request), pipeline_store.async_builds.end());
+
+    println(CLL::INFORMATION, "Compiling %s in the background, rendering with fallback pipeline", GPU_RAYTRACER_NAMES[variant_index]);
+    PipelineStore::AsyncBuild async_build;
+    async_build.variant_index = variant_index;
+    async_build.options = options;
+    // note: pipeline construction only reads the backend's layout state, scene-dependent
+    // shader binding tables are built lazily on the render thread after the swap
+    async_build.build = std::async(std::launch::async, [this, variant_index, options]() {
+        ProfilingScope profile_pipeline("Build pipeline (background)");
+        return create_raytracing_pipeline(variant_index, options, false);
+    });
+    pipeline_store.async_builds.push_back(std::move(async_build));
+}
+
+bool RenderVulkan::poll_async_pipeline_builds(bool wait) {
+    auto& pipelines = pipeline_store.pipelines;
+    bool swapped = false;
+    for (auto& async_build : pipeline_store.async_builds) {
+        if (!async_build.build.valid())
+            continue;
+        if (!wait && async_build.build.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        auto* gpu_program = vulkan_raytracers[async_build.variant_index];
+        std::unique_ptr<RenderPipelineVulkan> new_pipeline;
+        try {
+            new_pipeline = async_build.build.get();
+        } catch (std::exception const& e) {
+            warning("Background build of %s failed, keeping fallback pipeline (%s)", GPU_RAYTRACER_NAMES[async_build.variant_index], e.what());
+            async_build.failed_generation = pipeline_store.hot_reload_generation;
+            continue;
+        }
+
+        if (auto* stale_pipeline = pipelines.find(gpu_program, async_build.options)) {
+            // stale pipeline may still be in flight
+            CHECK_VULKAN(vkDeviceWaitIdle(device.logical_device()));
+            std::replace(pipeline_store.last_used.begin(), pipeline_store.last_used.end(), stale_pipeline, (RenderPipelineVulkan*) nullptr);
+            pipelines.remove(gpu_program, async_build.options);
+        }
+        auto* added = pipelines.add(std::move(new_pipeline), gpu_program, async_build.options);
+        added->hot_reload_generation = pipeline_store.hot_reload_generation;
+        println(CLL::INFORMATION, "Swapped in background-compiled %s", GPU_RAYTRACER_NAMES[async_build.variant_index]);
+        swapped = true;
+    }
+    // keep failed builds around to suppress retries within the same hot reload generation
+    pipeline_store.async_builds.erase(std::remove_if(pipeline_store.async_builds.begin(), pipeline_store.async_builds.end()
+        , [&](PipelineStore::AsyncBuild const& async_build) {
+            return !async_build.build.valid() && async_build.failed_generation != pipeline_store.hot_reload_generation;
+        }), pipeline_store.async_builds.end());
+
+    if (swapped) {
+        device->update_pipeline_cache();
+        // results of the fallback pipeline must not be mixed with the requested configuration
+        frame_offset += frame_id;
+        frame_id = 0;
+        accumulation_frame = 0;
+    }
+    return swapped;
+}
+
+int RenderVulkan::write_render_mesh_buffers(RenderMeshParams& params, vkrt::Geometry const& geom) const {
 #ifdef QUANTIZED_POSITIONS
-        int vertex_stride = sizeof(uint64_t);
+    int vertex_stride = sizeof(uint64_t);
 #else
-        int vertex_stride = sizeof(float) * 3;
+    int vertex_stride = sizeof(float) * 3;
 #endif
 #ifdef QUANTIZED_NORMALS_AND_UVS
-        int normal_stride = sizeof(uint64_t);
-        int uv_stride = sizeof(uint64_t);
+    int normal_stride = sizeof(uint64_t);
+    int uv_stride = sizeof(uint64_t);
 #else
-        int normal_stride = sizeof(float) * 3;
-        int uv_stride = sizeof(float) * 2;
+    int normal_stride = sizeof(float) * 3;
+    int uv_stride = sizeof(float) * 2;
 #endif
 
-        int vertex_count = geom.num_vertices();
-        int triangle_count = geom.num_triangles();
-        int vertex_offset = geom.vertex_offset;
+    int vertex_count = geom.num_vertices();
+    int triangle_count = geom.num_triangles();
+    int vertex_offset = geom.vertex_offset;
 
-        if (geom.index_buf && !geom.indices_are_implicit) {
-            params->indices.i = (decltype(params->indices.i)) geom.index_buf->device_address() + geom.triangle_offset;
-            params->num_indices = triangle_count * 3;
+    if (geom.index_buf && !geom.indices_are_implicit) {
+        params.indices.i = (decltype(params.indices.i)) geom.index_buf->device_address() + geom.triangle_offset;
+        params.num_indices = triangle_count * 3;
 
-            vertex_offset += geom.index_offset;
-        }
-        else {
-            params->indices.i = 0;
-            params->num_indices = 0;
-            params->flags |= GEOMETRY_FLAGS_IMPLICIT_INDICES;
-        }
+        vertex_offset += geom.index_offset;
+    }
+    else {
+        params.indices.i = 0;
+        params.num_indices = 0;
+        params.flags |= GEOMETRY_FLAGS_IMPLICIT_INDICES;
+    }
 
-        params->vertices.v = decltype(params->vertices.v)(
-            geom.vertex_buf->device_address() + vertex_offset * vertex_stride);
-        params->num_vertices = vertex_count;
+    params.vertices.v = decltype(params.vertices.v)(
+        geom.vertex_buf->device_address() + vertex_offset * vertex_stride);
+    params.num_vertices = vertex_count;
 
-        params->quantized_offset = glm::vec4(geom.quantized_offset, 1.0f);
-        params->quantized_scaling = glm::vec4(geom.quantized_scaling, 1.0f);
+    params.quantized_offset = glm::vec4(geom.quantized_offset, 1.0f);
+    params.quantized_scaling = glm::vec4(geom.quantized_scaling, 1.0f);
 
-        if (geom.normal_buf) {
-            params->normals.n = decltype(params->normals.n)(
-                geom.normal_buf->device_address() + vertex_offset * normal_stride);
-            params->num_normals = 1;
-        } else {
-            params->num_normals = 0;
-        }
+    if (geom.normal_buf) {
+        params.normals.n = decltype(params.normals.n)(
+            geom.normal_buf->device_address() + vertex_offset * normal_stride);
+        params.num_normals = 1;
+    } else {
+        params.num_normals = 0;
+    }
+
+    if (geom.uv_buf) {
+        params.uvs.uv = decltype(params.uvs.uv)(
+            geom.uv_buf->device_address() + vertex_offset * uv_stride);
+        params.num_uvs = 1;
+    } else {
+        params.num_uvs = 0;
+    }
+    return vertex_offset;
+}
+
+std::vector<RenderMeshParams> RenderVulkan::collect_render_mesh_params(int parameterized_mesh, Scene const& scene) const {
+    const auto &pm = scene.parameterized_meshes[parameterized_mesh];
+    const auto &vkpm = parameterized_meshes[parameterized_mesh];
+    std::vector<RenderMeshParams> hit_params( meshes[pm.mesh_id]->geometries.size() );
+    // geometries sorted into a single material run are shaded without per-triangle lookups
+    std::vector<int> uniform_material_ids(hit_params.size(), -1);
+    for (auto const& range : pm.triangle_material_ranges) {
+        if (range.geometry < 0 || range.geometry >= ilen(uniform_material_ids))
+            continue;
+        int& uniform_id = uniform_material_ids[range.geometry];
+        uniform_id = (uniform_id == -1) ? pm.material_offset(range.geometry) + range.material_id : -2;
+        if (uniform_id >= ilen(scene.materials))
+            uniform_id = -2;
+    }
+    len_t primOffset = 0;
+    for (int j = 0; j < (int) meshes[pm.mesh_id]->geometries.size(); ++j) {
+        auto &geom = meshes[pm.mesh_id]->geometries[j];
+        RenderMeshParams *params = hit_params.data() + j;
+
+        int vertex_offset = write_render_mesh_buffers(*params, geom);
+        int triangle_count = geom.num_triangles();
 
-        if (geom.uv_buf) {
-            params->uvs.uv = decltype(params->uvs.uv)(
-                geom.uv_buf->device_address() + vertex_offset * uv_stride);
-            params->num_uvs = 1;
-        } else {
-            params->num_uvs = 0;
-        }
         bool no_alpha = vkpm.no_alpha;
         bool extended_shader = false;
         bool is_thin = false;
-        if (vkpm.per_triangle_material_buf) {
+        if (vkpm.per_triangle_material_buf && uniform_material_ids[j] < 0) {
             params->materials.id_4pack = (decltype(params->materials.id_4pack))
                 (vkpm.per_triangle_material_buf->device_address() + primOffset);
             // mark with negative offset, as 64 bit pointer checks not always supported
@@ -2816,14 +3652,21 @@ std::vector<RenderMeshParams> RenderVulkan::collect_render_mesh_params(int param
             extended_shader = true;
         }
         else {
-            assert(pm.material_id_bitcount == 32);
-            params->material_id = pm.material_offset(j);
+            assert(pm.material_id_bitcount == 32 || uniform_material_ids[j] >= 0);
+            params->material_id = uniform_material_ids[j] >= 0 ? uniform_material_ids[j] : pm.material_offset(j);
             if (!no_alpha)
                 no_alpha = (scene.materials[params->material_id].flags & BASE_MATERIAL_NOALPHA) != 0;
             if (!extended_shader)
                 extended_shader = (scene.materials[params->material_id].flags & BASE_MATERIAL_EXTENDED) != 0;
             is_thin = (scene.materials[params->material_id].flags & BASE_MATERIAL_ONESIDED) == 0;
         }
+        if (j < ilen(vkpm.geometry_opacity) && vkpm.geometry_opacity[j] == OPACITY_STATE_OPAQUE)
+            no_alpha = true;
+        if (vkpm.opacity_state_buf && j < ilen(vkpm.opacity_state_offsets) && vkpm.opacity_state_offsets[j] >= 0) {
+            params->opacity_states.packed = (decltype(params->opacity_states.packed))
+                (vkpm.opacity_state_buf->device_address() + vkpm.opacity_state_offsets[j] * sizeof(uint32_t));
+            params->flags |= GEOMETRY_FLAGS_OPACITY_STATES;
+        }
         if (no_alpha)
             params->flags |= GEOMETRY_FLAGS_NOALPHA;
         if (extended_shader)
@@ -2831,7 +3674,9 @@ std::vector<RenderMeshParams> RenderVulkan::collect_render_mesh_params(int param
         if (is_thin)
             params->flags |= GEOMETRY_FLAGS_THIN;
 
-        if (meshes[pm.mesh_id]->is_dynamic() && !mesh_shader_names[pm.mesh_id].empty())
+        // skinned meshes are deformed by an extension, not by mesh shaders
+        if (meshes[pm.mesh_id]->is_dynamic()
+         && (!mesh_shader_names[pm.mesh_id].empty() || (scene.meshes[pm.mesh_id].flags & Mesh::Skinned)))
             params->flags |= GEOMETRY_FLAGS_DYNAMIC;
 
         // for access to dynamic geometry
@@ -2912,6 +3757,7 @@ void RenderVulkan::update_view_parameters(const glm::vec3 &pos,
 
     viewParams.frame_id = frame_id;
     viewParams.frame_offset = frame_offset;
+    viewParams.accumulation_frame = accumulation_frame;
     viewParams.frame_dims = accum_buffers[0]->dims();
     viewParams.light_sampling = this->lighting_params;
     if (this->params.enable_raster_taa > 0) {
@@ -2946,6 +3792,7 @@ void RenderVulkan::async_refresh_global_parameters() {
         cached_gpu_params->globals.render_params.aperture_radius = 0.0f;
         cached_gpu_params->globals.render_params.focal_length = 0.0f;
     }
+    cached_gpu_params->globals.render_params.path_guiding_training_probability = path_guiding_training_probability;
     auto gp = (glsl::GlobalParams*) global_param_buf->map();
     memcpy(gp, &cached_gpu_params->globals, sizeof(*gp));
     global_param_buf->unmap();
@@ -2955,26 +3802,43 @@ void RenderVulkan::update_config(SceneConfig const& config) {
     glsl::SceneParams& sceneParams = cached_gpu_params->globals.scene_params;
     sceneParams.normal_z_scale = 1.0f / config.bump_scale;
 
+    scene_config = config;
     update_sky_light(config);
 }
 
 void RenderVulkan::record_frame(VkCommandBuffer render_cmd_buf, int variant_index, int num_rayqueries, int samples_per_query) {
-    auto& variant_pipeline = *build_raytracing_pipeline(variant_index, this->active_options);
+    // note: sampling, guiding and bind point follow the program that is actually rendered, which is
+    // that of another integrator while a never-built variant compiles in the background
+    auto& variant_pipeline = *build_raytracing_pipeline(variant_index, this->active_options, false, nullptr, allow_fallback_pipelines, &variant_index);
+    if (variant_index >= (int) pipeline_store.last_used.size())
+        pipeline_store.last_used.resize(variant_index + 1, nullptr);
+    pipeline_store.last_used[variant_index] = &variant_pipeline;
+    pipeline_store.last_rendered_variant = variant_index;
     auto pipeline_bind_point = variant_pipeline.pipeline_bindpoint;
     auto pipeline_stage = (pipeline_bind_point == VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR) ? VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
     int batch_spp = samples_per_query > 0 ? samples_per_query : this->params.batch_spp;
     bool render_ray_queries = num_rayqueries > 0;
     if (!render_ray_queries) {
+        // note: don't switch sampling mid-accumulation, the per-pixel statistics would be incomplete
+        if (frame_id == 0)
+            sample_adaptively = this->params.adaptive_sampling
+                && (vulkan_raytracers[variant_index]->feature_flags & GPU_PROGRAM_FEATURE_ADAPTIVE_SAMPLING);
 #ifdef ATOMIC_ACCUMULATE
         // note: don't switch accumulation method mid-accumulation
         // as this may change the data layout
         if (frame_id == 0)
-            accumulate_atomically = (batch_spp > 1);
+            accumulate_atomically = (batch_spp > 1) && !sample_adaptively;
 #else
         accumulate_atomically = false;
 #endif
     }
+    // adaptive sampling traces all samples of a pixel in one thread
+    bool render_adaptively = sample_adaptively && !render_ray_queries;
+    guide_paths = !render_ray_queries && this->params.path_guiding
+        && (vulkan_raytracers[variant_index]->feature_flags & GPU_PROGRAM_FEATURE_PATH_GUIDING);
+    if (guide_paths)
+        path_guiding_slot_trained[swap_index] = true;
 
     glsl::PushConstantParams push_constants = { };
     //push_constants.local_params = cached_gpu_params->locals;
@@ -2983,6 +3847,10 @@ void RenderVulkan::record_frame(VkCommandBuffer render_cmd_buf, int variant_inde
     push_constants.accumulation_batch_size = samples_per_query;
     if (accumulate_atomically)
         push_constants.accumulation_flags |= ACCUMULATION_FLAGS_ATOMIC;
+    if (render_adaptively)
+        push_constants.accumulation_flags |= ACCUMULATION_FLAGS_ADAPTIVE;
+    if (guide_paths)
+        push_constants.accumulation_flags |= ACCUMULATION_FLAGS_PATH_GUIDING;
 #ifdef ENABLE_AOV_BUFFERS
     if (true)
         push_constants.accumulation_flags |= ACCUMULATION_FLAGS_AOVS;
@@ -3000,13 +3868,19 @@ void RenderVulkan::record_frame(VkCommandBuffer render_cmd_buf, int variant_inde
         VkPipelineStageFlags dst_stages = pipeline_stage;
 
         // todo: should these barriers go somewhere else?
-        vkrt::MemoryBarriers<1, 2 + AOVBufferCount> mem_barriers;
+        vkrt::MemoryBarriers<1, 3 + AOVBufferCount> mem_barriers;
 
         auto& current_accum_buffer = accumulate_atomically ? atomic_accum_buffers[active_accum_buffer] : accum_buffers[active_accum_buffer];
         current_accum_buffer->layout_invalidate();
         mem_barriers.add(dst_stages, current_accum_buffer->transition_color(VK_IMAGE_LAYOUT_GENERAL
             , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
 
+        // sample counts allocated by the last sample processing
+        if (render_adaptively && frame_id == 0)
+            adaptive_sampling_stats->layout_invalidate();
+        mem_barriers.add(dst_stages, adaptive_sampling_stats->transition_color(VK_IMAGE_LAYOUT_GENERAL
+            , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+
         render_targets[active_render_target]->layout_invalidate();
         mem_barriers.add(dst_stages, render_targets[active_render_target]->transition_color(VK_IMAGE_LAYOUT_GENERAL
             , VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
@@ -3044,10 +3918,33 @@ void RenderVulkan::record_frame(VkCommandBuffer render_cmd_buf, int variant_inde
             mem_barriers.image_barriers[0].oldLayout = img_mem_barrier.newLayout;
         }
 
+        // reset importance sums, read and written by sample processing only
+        if (render_adaptively && frame_id == 0) {
+            BUFFER_BARRIER(buf_barrier);
+            buf_barrier.buffer = adaptive_sampling_totals;
+            buf_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(render_cmd_buf,
+                                 src_stages,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0,
+                                 0, nullptr,
+                                 1, &buf_barrier,
+                                 0, nullptr);
+
+            vkCmdFillBuffer(render_cmd_buf, adaptive_sampling_totals, 0, VK_WHOLE_SIZE, 0);
+
+            src_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+            buf_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            buf_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            mem_barriers.add(PROCESSING_PIPELINE_STAGES, buf_barrier);
+        }
+
         mem_barriers.set(render_cmd_buf, src_stages);
     }
 
     glm::ivec2 dispatch_dim = accum_buffers[active_accum_buffer]->dims();
+    if (render_adaptively)
+        batch_spp = 1;
     // dispatch ray queries into a virtual screen square to allow for 2D locality if required
     if (render_ray_queries) {
         int dispatch_size = (int) std::abs(num_rayqueries);
@@ -3056,6 +3953,21 @@ void RenderVulkan::record_frame(VkCommandBuffer render_cmd_buf, int variant_inde
     }
 
     variant_pipeline.dispatch_rays(render_cmd_buf, dispatch_dim.x, dispatch_dim.y, batch_spp);
+
+    // training samples are read by the host once the frame is done, see update_path_guiding
+    if (guide_paths) {
+        BUFFER_BARRIER(buf_barrier);
+        buf_barrier.buffer = path_guiding_samples_buf;
+        buf_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        buf_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(render_cmd_buf,
+                             pipeline_stage,
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                             0,
+                             0, nullptr,
+                             1, &buf_barrier,
+                             0, nullptr);
+    }
 }
 
 void RenderVulkan::record_readback(VkCommandBuffer cmd_buf, vkrt::Texture2D* target)
@@ -14,6 +14,9 @@
 #include "../librender/render_data.h"
 #include "../librender/gpu_programs.h"
 #include "../librender/lights.h"
+#include "../librender/instance_bounds.h"
+#include "../librender/geometry_paging.h"
+#include "../librender/path_guiding.h"
 
 namespace glsl {
     struct ViewParams;
@@ -79,6 +82,21 @@ struct RenderVulkan : RenderBackend {
     int active_render_target = 0;
     vkrt::Texture2D half_post_processing_buffers[2];
     vkrt::Texture2D current_color_buffer;
+    // per-pixel luminance moments and sample counts, and per-frame importance sums
+    vkrt::Texture2D adaptive_sampling_stats = nullptr;
+    vkrt::Buffer adaptive_sampling_totals = nullptr;
+    // guiding field fitted on the CPU and training samples recorded by the megakernel integrators,
+    // one slot per swap buffer, such that slots are read and written once their frame is done
+    PathGuidingField path_guiding;
+    vkrt::Buffer path_guiding_field_buf = nullptr;
+    vkrt::Buffer path_guiding_samples_buf = nullptr;
+    int path_guiding_pending_uploads = 0;
+    bool path_guiding_slot_trained[MAX_SWAP_BUFFERS] = { false }; // frame that last used the swap index recorded samples
+    bool path_guiding_slot_stale[MAX_SWAP_BUFFERS] = { false }; // samples were recorded before the last reset
+    float path_guiding_training_probability = 1.0f;
+    // environment map and its sampling pyramid, replaces sky and sun if the scene has one
+    vkrt::Buffer environment_map_buf = nullptr;
+    SceneConfig scene_config;
     VkSampler screen_sampler = VK_NULL_HANDLE;
 
     using RenderGraphic::AOVBufferIndex;
@@ -104,6 +122,21 @@ struct RenderVulkan : RenderBackend {
     unsigned parameterized_meshes_revision = ~0;
     unsigned instances_revision = ~0;
 
+    // per-frame instance transforms and bounds for animated TLAS refits
+    InstanceBoundsTracker instance_bounds;
+    TlasRefitHeuristic tlas_refit_heuristic;
+    std::vector<TlasRefitHeuristic> blas_refit_heuristics; // note: indexed by mesh id, over meshlet bounds
+    int tlas_lod_offset = 0;
+    uint32_t tlas_instance_mask = 0xff;
+    vkrt::Buffer pending_instance_upload = nullptr; // animated instances, copied at the start of the next draw
+    vkrt::Buffer pending_instance_params_upload = nullptr; // their instance parameters, copied along with them
+
+    // BLAS of static meshes are built and evicted in pages under the blas_budget_mb option,
+    // rebuilds read the geometry views shared with the scene (zero-copy for file mappings)
+    GeometryPager geometry_pager;
+    std::vector<Mesh> paged_meshes;
+    std::vector<char> blas_paged_out; // note: indexed by mesh id
+
     unsigned blas_generation = 0;
     unsigned blas_content_generation = 0;
     unsigned tlas_generation = 0;
@@ -154,6 +187,16 @@ struct RenderVulkan : RenderBackend {
         };
         std::vector<DeferredBuild> prepared;
         unsigned hot_reload_generation = 0;
+        // requested pipelines compiled in the background while a fallback keeps rendering
+        struct AsyncBuild {
+            int variant_index;
+            RenderBackendOptions options; // normalized
+            std::future<std::unique_ptr<RenderPipelineVulkan>> build;
+            unsigned failed_generation = ~0u; // not retried until the next hot reload
+        };
+        std::vector<AsyncBuild> async_builds;
+        std::vector<RenderPipelineVulkan*> last_used; // per variant, fallback candidates
+        int last_rendered_variant = -1; // preferred fallback for variants that were never built
     } pipeline_store;
 
     vkrt::DescriptorSetUpdater desc_set_updater;
@@ -163,10 +206,13 @@ struct RenderVulkan : RenderBackend {
     vkrt::ProfilingData profiling_data;
     float rendering_time_ms = 0;
 
-    size_t frame_id = 0;
+    size_t frame_id = 0; // samples accumulated since the last reset
+    unsigned accumulation_frame = 0; // frames accumulated since the last reset, independent of batch_spp
     size_t frame_offset = 0;
     unsigned accumulated_spp = 0;
     bool accumulate_atomically = false;
+    bool sample_adaptively = false;
+    bool guide_paths = false;
 
     vkrt::Buffer ray_query_buffer = nullptr, ray_result_buffer = nullptr;
     int fixed_ray_query_budget = 0, per_pixel_ray_query_budget = 0;
@@ -199,6 +245,7 @@ struct RenderVulkan : RenderBackend {
     RenderStats render(const RenderConfiguration &config) override;
     RenderStats render(CommandStream* cmd_stream, const RenderConfiguration &config) override;
     bool render_ray_queries(int num_queries, const RenderParams &params, int variant_idx = 0, CommandStream* cmd_stream = nullptr) override;
+    std::unique_ptr<RayQuerySlots> create_ray_query_slots(int slot_count, int slot_capacity) override;
 
     RenderStats stats() override;
     void flush_pipeline() override;
@@ -234,12 +281,17 @@ struct RenderVulkan : RenderBackend {
 
     void update_shader_descriptor_table(vkrt::BindingCollector collector, vkrt::RenderPipelineOptions const& options, VkDescriptorSet desc_set);
     std::vector<RenderMeshParams> collect_render_mesh_params(int parameterized_mesh, Scene const& scene) const;
+    int write_render_mesh_buffers(RenderMeshParams& params, vkrt::Geometry const& geom) const; // returns the vertex offset
     void update_shader_binding_table(void* sbt_mapped, vkrt::ShaderBindingTable& table);
 
 // internal:
     void prepare_raytracing_pipelines(bool defer_build);
     RenderPipelineVulkan* build_raytracing_pipeline(int variant_idx, const RenderBackendOptions& for_options
-        , bool defer = false, bool* fallback_exists = nullptr);
+        , bool defer = false, bool* fallback_exists = nullptr, bool async_with_fallback = false, int* rendered_variant_idx = nullptr);
+    std::unique_ptr<RenderPipelineVulkan> create_raytracing_pipeline(int variant_idx, const RenderBackendOptions& options, bool defer);
+    void queue_async_pipeline_build(int variant_idx, const RenderBackendOptions& options);
+    // swaps in finished background builds, returns true if any pipeline was replaced
+    bool poll_async_pipeline_builds(bool wait);
     void lazy_update_shader_descriptor_table(RenderPipelineVulkan* pipeline, int swap_index
         , CustomPipelineExtensionVulkan* optional_managing_extension = nullptr);
 
@@ -252,17 +304,24 @@ struct RenderVulkan : RenderBackend {
 
     void async_refresh_global_parameters();
 
-    void update_geometry(const Scene &scene, bool& update_sbt, bool& rebuild_tlas);
+    void update_geometry(const std::vector<Mesh> &scene_meshes, bool& update_sbt, bool& rebuild_tlas);
+    void update_geometry_pages(glm::vec3 camera_position, float fov_y);
     void update_meshes(const Scene &scene, bool &update_sbt, bool &rebuild_sbt);
     void update_lights(const Scene &scene);
+    void update_environment_map(const Scene &scene);
     void update_instances(const Scene &scene, bool rebuild_tlas);
     void default_update_tlas(std::unique_ptr<vkrt::TopLevelBVH>& scene_bvh, bool rebuild_tlas
         , int lod_offset, uint32_t instance_mask);
+    uint32_t write_tlas_instances(VkAccelerationStructureInstanceKHR* map, int lod_offset, uint32_t instance_mask);
+    void update_animated_instances();
+    void record_instance_upload(vkrt::CommandStream* cmd_stream);
+    void reset_path_guiding();
+    void update_path_guiding();
     void request_tlas_operation(BVHOperation op);
     bool has_pending_tlas_operations();
     void execute_pending_tlas_operations(VkCommandBuffer command_buffer);
     void update_tlas(bool rebuild_tlas);
-    void update_instance_params();
+    void update_instance_params(bool in_frame_stream = false);
 
     void update_textures(const Scene &scene);
     void update_materials(const Scene &scene);
@@ -11,10 +11,17 @@ namespace vkrt {
 #ifdef ENABLE_DEBUG_VIEWS
     void create_default_debug_extensions(std::vector<std::unique_ptr<RenderExtension>> &extensions, RenderVulkan* backend);
 #endif
+#ifdef ENABLE_DYNAMIC_MESHES
+    void create_default_skinning_extensions(std::vector<std::unique_ptr<RenderExtension>> &extensions, RenderVulkan* backend);
+#endif
 } // namespace
 
 std::vector<std::unique_ptr<RenderExtension>> RenderVulkan::create_default_extensions() {
     std::vector<std::unique_ptr<RenderExtension>> extensions;
+#ifdef ENABLE_DYNAMIC_MESHES
+    // deforms geometry before any other extension sees the frame
+    vkrt::create_default_skinning_extensions(extensions, this);
+#endif
     vkrt::create_default_pointset_extensions(extensions, this);
 #ifdef ENABLE_DEBUG_VIEWS
     vkrt::create_default_debug_extensions(extensions, this);
@@ -51,7 +58,7 @@ std::unique_ptr<RenderExtension> RenderVulkan::create_processing_step(RenderProc
     case RenderProcessingStep::ProfilingTools:
         return create_render_extension<ProcessProfilingToolsVulkan>(this);
 #endif
-#ifdef ENABLE_OIDN
+#if defined(ENABLE_OIDN) || defined(ENABLE_DL_DENOISING)
     case RenderProcessingStep::DLDenoising:
         return create_render_extension<ProcessDLDenoisingVulkan>(this);
 #endif
@@ -9,6 +9,10 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <thread>
 #include "error_io.h"
 #include "util.h"
 #include "types.h"
@@ -162,6 +166,56 @@ PFN_vkGetPhysicalDeviceCooperativeMatrixPropertiesNV GetPhysicalDeviceCooperativ
 static char const pipeline_cache_file[] = "vulkan_cache";
 static char const shader_cache_file[] = "vulkan_shader_cache";
 
+static std::vector<uint8_t> read_cache_file(std::string const& filename) {
+    std::vector<uint8_t> cache_data;
+    FILE* cache_file = fopen(filename.c_str(), "rb");
+    if (cache_file) {
+        fseek(cache_file, 0, SEEK_END);
+        size_t cache_size = int_cast<size_t>(ftell(cache_file));
+        fseek(cache_file, 0, SEEK_SET);
+        cache_data.resize(cache_size);
+        if (fread(cache_data.data(), 1, cache_size, cache_file) != cache_size)
+            cache_data.clear();
+        fclose(cache_file);
+    }
+    return cache_data;
+}
+
+// writes to a unique temporary file that is then renamed over the target, such that
+// concurrent instances and interrupted writes never leave a truncated cache behind
+static void write_cache_file_atomically(std::string const& filename, std::vector<uint8_t> const& cache_data) {
+    size_t unique_id = std::hash<std::thread::id>()(std::this_thread::get_id())
+        ^ size_t(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::string temp_filename = filename + ".tmp" + std::to_string(unique_id);
+    FILE* cache_file = fopen(temp_filename.c_str(), "wb");
+    if (!cache_file) {
+        warning("Failed to open \"%s\" for writing", temp_filename.c_str());
+        return;
+    }
+    bool failure = fwrite(cache_data.data(), 1, cache_data.size(), cache_file) != cache_data.size();
+    failure |= fclose(cache_file) != 0;
+    std::error_code ec;
+    if (!failure)
+        std::filesystem::rename(temp_filename, filename, ec);
+    if (failure || ec) {
+        std::filesystem::remove(temp_filename, ec);
+        warning("Failed to write cache file \"%s\"", filename.c_str());
+    }
+}
+
+// drivers are not required to reject pipeline cache data of other devices gracefully
+static bool pipeline_cache_matches_device(std::vector<uint8_t> const& cache_data, VkPhysicalDeviceProperties const& props) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (cache_data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, cache_data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerSize <= cache_data.size()
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == props.vendorID
+        && header.deviceID == props.deviceID
+        && std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
 #ifdef _DEBUG
 static VkResult create_debug_utils_messenger_EXT(
     VkInstance instance,
@@ -358,43 +412,60 @@ Device::Device(const std::vector<std::string> &instance_extensions,
 #endif
 
     {
-        std::vector<uint8_t> cache_data;
-        FILE* cache_file = fopen(binary_path(pipeline_cache_file).c_str(), "rb");
-        if (cache_file) {
-            fseek(cache_file, 0, SEEK_END);
-            size_t cache_size = int_cast<size_t>(ftell(cache_file));
-            fseek(cache_file, 0, SEEK_SET);
-            cache_data.resize(cache_size);
-            if (fread(cache_data.data(), 1, cache_size, cache_file) != cache_size)
-                cache_data.clear();
-            fclose(cache_file);
+        // caches are keyed by device and driver, such that multiple GPUs and driver updates
+        // do not keep overwriting (or feeding foreign data to) each other's caches
+        VkPhysicalDeviceIDProperties id_props = {};
+        id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2 props2 = {};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &id_props;
+        vkGetPhysicalDeviceProperties2(ref_data->vk_physical_device, &props2);
+        VkPhysicalDeviceProperties const& properties = props2.properties;
+
+        std::vector<char> cache_key;
+        auto append_key = [&cache_key](void const* data, size_t size) {
+            cache_key.insert(cache_key.end(), (char const*) data, (char const*) data + size);
+        };
+        append_key(id_props.deviceUUID, VK_UUID_SIZE);
+        append_key(id_props.driverUUID, VK_UUID_SIZE);
+        append_key(properties.pipelineCacheUUID, VK_UUID_SIZE);
+        append_key(&properties.driverVersion, sizeof(properties.driverVersion));
+        std::string cache_suffix = "_" + sha1_hash(cache_key.data(), cache_key.size()).substr(0, 16);
+        ref_data->pipeline_cache_file = binary_path(pipeline_cache_file + cache_suffix);
+        ref_data->shader_cache_file = binary_path(shader_cache_file + cache_suffix);
+
+        std::vector<uint8_t> cache_data = read_cache_file(ref_data->pipeline_cache_file);
+        if (!cache_data.empty() && !pipeline_cache_matches_device(cache_data, properties)) {
+            println(CLL::WARNING, "Discarding pipeline cache \"%s\" that does not match the device", ref_data->pipeline_cache_file.c_str());
+            cache_data.clear();
         }
 
         VkPipelineCacheCreateInfo info = { };
         info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
         info.initialDataSize = cache_data.size();
         info.pInitialData = cache_data.data();
-        vkCreatePipelineCache(device, &info, nullptr, &ref_data->pipeline_cache);
+        if (vkCreatePipelineCache(device, &info, nullptr, &ref_data->pipeline_cache) != VK_SUCCESS && !cache_data.empty()) {
+            println(CLL::WARNING, "Pipeline cache \"%s\" was rejected, starting with an empty cache", ref_data->pipeline_cache_file.c_str());
+            ref_data->pipeline_cache = VK_NULL_HANDLE;
+            info.initialDataSize = 0;
+            info.pInitialData = nullptr;
+            CHECK_VULKAN(vkCreatePipelineCache(device, &info, nullptr, &ref_data->pipeline_cache));
+        }
     }
     if (CreateValidationCacheEXT)
     {
-        std::vector<uint8_t> cache_data;
-        FILE* cache_file = fopen(binary_path(shader_cache_file).c_str(), "rb");
-        if (cache_file) {
-            fseek(cache_file, 0, SEEK_END);
-            size_t cache_size = int_cast<size_t>(ftell(cache_file));
-            fseek(cache_file, 0, SEEK_SET);
-            cache_data.resize(cache_size);
-            if (fread(cache_data.data(), 1, cache_size, cache_file) != cache_size)
-                cache_data.clear();
-            fclose(cache_file);
-        }
+        std::vector<uint8_t> cache_data = read_cache_file(ref_data->shader_cache_file);
 
         VkValidationCacheCreateInfoEXT info = { };
         info.sType = VK_STRUCTURE_TYPE_VALIDATION_CACHE_CREATE_INFO_EXT;
         info.initialDataSize = cache_data.size();
         info.pInitialData = cache_data.data();
-        CreateValidationCacheEXT(device, &info, nullptr, &ref_data->validation_cache);
+        if (CreateValidationCacheEXT(device, &info, nullptr, &ref_data->validation_cache) != VK_SUCCESS && !cache_data.empty()) {
+            ref_data->validation_cache = VK_NULL_HANDLE;
+            info.initialDataSize = 0;
+            info.pInitialData = nullptr;
+            CreateValidationCacheEXT(device, &info, nullptr, &ref_data->validation_cache);
+        }
     }
 
     // mult-resource management cleanup
@@ -546,11 +617,7 @@ void Device::update_pipeline_cache() {
             break;
         }
         cache_data.resize(cache_size);
-        FILE* cache_file = fopen(binary_path(pipeline_cache_file).c_str(), "wb");
-        if (cache_file) {
-            fwrite(cache_data.data(), 1, cache_data.size(), cache_file);
-            fclose(cache_file);
-        }
+        write_cache_file_atomically(ref_data->pipeline_cache_file, cache_data);
     }
     while (false);
     do
@@ -567,11 +634,7 @@ void Device::update_pipeline_cache() {
             break;
         }
         cache_data.resize(cache_size);
-        FILE* cache_file = fopen(binary_path(shader_cache_file).c_str(), "wb");
-        if (cache_file) {
-            fwrite(cache_data.data(), 1, cache_data.size(), cache_file);
-            fclose(cache_file);
-        }
+        write_cache_file_atomically(ref_data->shader_cache_file, cache_data);
     }
     while (false);
 }
@@ -2520,6 +2583,13 @@ void AsyncCommandStream::wait_complete(int cursor) {
     }
 }
 
+bool AsyncCommandStream::is_complete(int cursor) const {
+    uint64_t value = 0;
+    CHECK_VULKAN(
+        vkGetSemaphoreCounterValue(ref_data->vkdevice, ref_data->async_command_timeline, &value));
+    return value >= uint64_t(cursor) + 1;
+}
+
 void AsyncCommandStream::hold_buffer(Buffer const& buf) {
     int current_idx = ref_data->async_command_buffer_cursor % ref_data->async_command_buffer_count;
     assert(current_buffer == ref_data->async_command_buffers[current_idx]);
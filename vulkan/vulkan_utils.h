@@ -134,6 +134,8 @@ class Device : public ref_counted<Device> {
 
         VkValidationCacheEXT validation_cache = VK_NULL_HANDLE;
         VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+        std::string pipeline_cache_file;
+        std::string shader_cache_file;
 
         VkInstance vk_instance = VK_NULL_HANDLE;
         VkPhysicalDevice vk_physical_device = VK_NULL_HANDLE;
@@ -311,6 +313,10 @@ struct AsyncCommandStream : CommandStream, ref_counted<AsyncCommandStream> {
     void end_submit(bool only_manual_wait = false) override final;
     void end_submit(const SubmitParameters* submit_params) override;
     void wait_complete(int cursor = -1) override final;
+    // non-blocking check whether the submission at the given cursor has finished
+    bool is_complete(int cursor) const;
+    // cursor of the next submission, the last one is next_cursor() - 1
+    int next_cursor() const { return ref_data->async_command_buffer_cursor; }
     void release_command_buffers() override final;
 
     void hold_buffer(Buffer const& buf) override final;
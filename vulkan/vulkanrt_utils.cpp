@@ -402,7 +402,7 @@ VkAccelerationStructureBuildSizesInfoKHR TriangleMesh::compute_build_size(VkAcce
     return build_size_info;
 }
 
-void TriangleMesh::finalize()
+void TriangleMesh::release_build_inputs()
 {
     // Release resources that are no longer needed when no rebuilds are requested
     if (!is_dynamic()) {
@@ -414,6 +414,11 @@ void TriangleMesh::finalize()
         }
         #endif
     }
+}
+
+void TriangleMesh::finalize()
+{
+    release_build_inputs();
 
     BVH::finalize();
 
@@ -423,6 +428,27 @@ void TriangleMesh::finalize()
     device_address = GetAccelerationStructureDeviceAddressKHR(device->logical_device(), &addr_info);
 }
 
+void TriangleMesh::evict()
+{
+    release_build_inputs();
+
+    if (staging_bvh != VK_NULL_HANDLE && staging_bvh != bvh)
+        DestroyAccelerationStructureKHR(device->logical_device(), staging_bvh, nullptr);
+    if (bvh != VK_NULL_HANDLE)
+        DestroyAccelerationStructureKHR(device->logical_device(), bvh, nullptr);
+    staging_bvh = VK_NULL_HANDLE;
+    bvh = VK_NULL_HANDLE;
+    if (query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device->logical_device(), query_pool, nullptr);
+        query_pool = VK_NULL_HANDLE;
+    }
+
+    bvh_buf = nullptr;
+    staging_bvh_buf = nullptr;
+    scratch_buf = nullptr;
+    device_address = 0;
+}
+
 TopLevelBVH::TopLevelBVH(Device &dev,
                          Buffer const& inst_buf,
                          uint32_t instance_count,
@@ -27,6 +27,9 @@ struct Geometry {
     uint32_t triangle_offset = 0, vertex_offset = 0;
     bool indices_are_implicit = false;
 
+    // meshlets bounding the uploaded vertices, empty if vertices are deformed on the GPU
+    mapped_vector<Meshlet> meshlets;
+
     int num_vertices() const;
     int num_triangles() const;
 
@@ -40,6 +43,10 @@ struct ParameterizedMesh {
     int32_t mesh_id = -1; // link back to source data (e.g. shaders)
     int32_t lod_group_id;
     bool no_alpha = false;
+    // baked opacity states of alpha-tested geometries (librender/opacity_baker.h)
+    Buffer opacity_state_buf = nullptr;
+    std::vector<int> opacity_state_offsets; // per geometry, in words, -1 if not baked
+    std::vector<uint8_t> geometry_opacity; // per geometry, state shared by all triangles
 
     unsigned material_revision = ~0;
     unsigned shader_revision = ~0;
@@ -152,6 +159,12 @@ struct TriangleMesh : BVH {
 
     void finalize() override;
 
+    // Releases the acceleration structure, instances referencing the zero device address
+    // are inactive. Vertex data used for shading is kept, a rebuild re-uploads build inputs.
+    void evict();
+    // Releases vertex data that static meshes only need for BLAS builds
+    void release_build_inputs();
+
     int triangle_count() const {
         return cached_triangle_count;
     }